@@ -0,0 +1,376 @@
+/* -LICENSE-START-
+ ** Copyright (c) 2019 Blackmagic Design
+ **
+ ** Permission is hereby granted, free of charge, to any person or organization
+ ** obtaining a copy of the software and accompanying documentation covered by
+ ** this license (the "Software") to use, reproduce, display, distribute,
+ ** execute, and transmit the Software, and to prepare derivative works of the
+ ** Software, and to permit third-parties to whom the Software is furnished to
+ ** do so, all subject to the following:
+ **
+ ** The copyright notices in the Software and this entire statement, including
+ ** the above license grant, this restriction and the following disclaimer,
+ ** must be included in all copies of the Software, in whole or in part, and
+ ** all derivative works of the Software, unless such copies or derivative
+ ** works are solely in the form of machine-executable object code generated by
+ ** a source language processor.
+ **
+ ** THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ ** IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ ** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+ ** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+ ** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+ ** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+ ** DEALINGS IN THE SOFTWARE.
+ ** -LICENSE-END-
+ */
+
+#pragma once
+
+#include <string.h>
+#include <utility>
+#include "platform.h"
+
+/* Capture-side ancillary data engine.
+ *
+ * Each frame's packets are iterated once.  Every packet is hashed and compared with the packet carrying the same
+ * line, DID and SDID in the previous frame, so that only new, changed or removed packets are reported, and packets
+ * with a DID/SDID in the decoder table are decoded:
+ * - SMPTE 334-2 caption distribution packets (DID 0x61, SDID 0x01), as emitted by the ClosedCaptions sample,
+ *   yielding CEA-608 byte pairs and CEA-708 (DTVCC) service blocks
+ * - SMPTE 334-1 CEA-608 packets (DID 0x61, SDID 0x02)
+ *
+ * DTVCC packets may span several CDPs, so partially received packets are carried between frames.
+ * No memory is allocated once the decoder has been constructed.
+ */
+
+class AncillaryDecoderListener
+{
+public:
+	virtual ~AncillaryDecoderListener() = default;
+
+	// A packet which is new, or whose data differs from the previous frame.  The data is only valid for the call.
+	virtual void	packetChanged(INT32_UNSIGNED lineNumber, INT8_UNSIGNED DID, INT8_UNSIGNED SDID, const INT8_UNSIGNED* data, INT32_UNSIGNED size) = 0;
+	// A packet which was present in the previous frame is no longer present
+	virtual void	packetRemoved(INT32_UNSIGNED lineNumber, INT8_UNSIGNED DID, INT8_UNSIGNED SDID) = 0;
+	// A valid, non-null CEA-608 byte pair, with parity removed.  Field is 1 or 2.
+	virtual void	cea608Data(INT8_UNSIGNED field, INT8_UNSIGNED data1, INT8_UNSIGNED data2) = 0;
+	// A CEA-708 service block from a completed DTVCC packet (CEA-708 6.2 Service Blocks)
+	virtual void	cea708ServiceBlock(INT8_UNSIGNED serviceNumber, const INT8_UNSIGNED* data, INT8_UNSIGNED size) = 0;
+};
+
+class AncillaryDecoder
+{
+public:
+	explicit AncillaryDecoder(AncillaryDecoderListener* listener) :
+		m_listener(listener),
+		m_previousPackets(m_packetRecords[0]),
+		m_currentPackets(m_packetRecords[1]),
+		m_previousPacketCount(0),
+		m_currentPacketCount(0),
+		m_dtvccPacketSize(0),
+		m_dtvccPacketLength(0)
+	{
+	}
+
+	// Iterate the packets of a captured frame, reporting changes and decoded caption data to the listener
+	HRESULT decodeFrame(IDeckLinkVideoFrameAncillaryPackets* videoFrameAncillaryPackets)
+	{
+		IDeckLinkAncillaryPacketIterator*	ancillaryPacketIterator	= nullptr;
+		IDeckLinkAncillaryPacket*			ancillaryPacket			= nullptr;
+
+		HRESULT result = videoFrameAncillaryPackets->GetPacketIterator(&ancillaryPacketIterator);
+		if (result != S_OK)
+			return result;
+
+		m_currentPacketCount = 0;
+
+		while (ancillaryPacketIterator->Next(&ancillaryPacket) == S_OK)
+		{
+			const INT8_UNSIGNED*	data;
+			INT32_UNSIGNED			size;
+
+			// The caption decoders parse the user data words as bytes, so packets are always read as UInt8
+			if (ancillaryPacket->GetBytes(bmdAncillaryPacketFormatUInt8, (const void**)&data, &size) == S_OK)
+				decodePacket(ancillaryPacket->GetLineNumber(), ancillaryPacket->GetDID(), ancillaryPacket->GetSDID(), data, size);
+
+			ancillaryPacket->Release();
+		}
+
+		ancillaryPacketIterator->Release();
+
+		// Anything left unmatched from the previous frame has gone
+		for (INT32_UNSIGNED i = 0; i < m_previousPacketCount; i++)
+		{
+			if (!m_previousPackets[i].matched)
+				m_listener->packetRemoved(m_previousPackets[i].lineNumber, m_previousPackets[i].DID, m_previousPackets[i].SDID);
+		}
+
+		std::swap(m_previousPackets, m_currentPackets);
+		m_previousPacketCount = m_currentPacketCount;
+
+		return S_OK;
+	}
+
+	// Decode a single packet of the current frame
+	void decodePacket(INT32_UNSIGNED lineNumber, INT8_UNSIGNED DID, INT8_UNSIGNED SDID, const INT8_UNSIGNED* data, INT32_UNSIGNED size)
+	{
+		typedef void (AncillaryDecoder::*DecodeFunction)(const INT8_UNSIGNED* data, INT32_UNSIGNED size);
+		struct DecoderEntry
+		{
+			INT8_UNSIGNED	DID;
+			INT8_UNSIGNED	SDID;
+			DecodeFunction	decode;
+		};
+
+		// ITU-R BT.1364 / SMPTE 334-1 Table 1 - Data identification words
+		static constexpr DecoderEntry kDecoders[] =
+		{
+			{ 0x61, 0x01, &AncillaryDecoder::decodeCaptionDistributionPacket },
+			{ 0x61, 0x02, &AncillaryDecoder::decodeCEA608Packet },
+		};
+
+		if (packetHasChanged(lineNumber, DID, SDID, data, size))
+			m_listener->packetChanged(lineNumber, DID, SDID, data, size);
+
+		// Caption data is decoded even when repeated, as CEA-608 control codes are sent twice in consecutive frames
+		for (const DecoderEntry& entry : kDecoders)
+		{
+			if (entry.DID == DID && entry.SDID == SDID)
+			{
+				(this->*entry.decode)(data, size);
+				break;
+			}
+		}
+	}
+
+	// Hash of the packet data, mixing 8 bytes per step
+	static INT64_UNSIGNED hashData(const INT8_UNSIGNED* data, INT32_UNSIGNED size)
+	{
+		const INT64_UNSIGNED	kMultiplier	= 0x9E3779B97F4A7C15ULL;
+		INT64_UNSIGNED			hash		= (size + 1) * kMultiplier;
+		INT64_UNSIGNED			word;
+
+		for (; size >= sizeof(word); size -= sizeof(word), data += sizeof(word))
+		{
+			memcpy(&word, data, sizeof(word));
+			hash = (hash ^ word) * kMultiplier;
+			hash ^= hash >> 29;
+		}
+
+		if (size > 0)
+		{
+			word = 0;
+			memcpy(&word, data, size);
+			hash = (hash ^ word) * kMultiplier;
+			hash ^= hash >> 29;
+		}
+
+		return hash;
+	}
+
+private:
+	enum
+	{
+		kMaximumPackets		= 64,		// Packets per frame compared with the previous frame, any more are always reported
+		kMaximumDTVCCPacket	= 128		// CEA-708 5 DTVCC Packet Layer
+	};
+
+	struct PacketRecord
+	{
+		INT32_UNSIGNED	lineNumber;
+		INT8_UNSIGNED	DID;
+		INT8_UNSIGNED	SDID;
+		bool			matched;
+		INT64_UNSIGNED	hash;
+	};
+
+	AncillaryDecoderListener*	m_listener;
+	PacketRecord				m_packetRecords[2][kMaximumPackets];
+	PacketRecord*				m_previousPackets;
+	PacketRecord*				m_currentPackets;
+	INT32_UNSIGNED				m_previousPacketCount;
+	INT32_UNSIGNED				m_currentPacketCount;
+	INT8_UNSIGNED				m_dtvccPacket[kMaximumDTVCCPacket];
+	INT32_UNSIGNED				m_dtvccPacketSize;		// Expected size from the packet header, zero while waiting for a packet start
+	INT32_UNSIGNED				m_dtvccPacketLength;
+
+	bool packetHasChanged(INT32_UNSIGNED lineNumber, INT8_UNSIGNED DID, INT8_UNSIGNED SDID, const INT8_UNSIGNED* data, INT32_UNSIGNED size)
+	{
+		INT64_UNSIGNED	hash	= hashData(data, size);
+		bool			changed	= true;
+
+		for (INT32_UNSIGNED i = 0; i < m_previousPacketCount; i++)
+		{
+			PacketRecord& previous = m_previousPackets[i];
+			if (!previous.matched && previous.lineNumber == lineNumber && previous.DID == DID && previous.SDID == SDID)
+			{
+				previous.matched = true;
+				changed = previous.hash != hash;
+				break;
+			}
+		}
+
+		if (m_currentPacketCount < kMaximumPackets)
+			m_currentPackets[m_currentPacketCount++] = { lineNumber, DID, SDID, false, hash };
+
+		return changed;
+	}
+
+	// SMPTE 334-2 5 CDP Detailed Specification
+	void decodeCaptionDistributionPacket(const INT8_UNSIGNED* data, INT32_UNSIGNED size)
+	{
+		enum
+		{
+			kCDPHeaderLength	= 7,
+			kTimeCodeLength		= 5,
+			kCCDataID			= 0x72,
+			kTimeCodeID			= 0x71,
+			kTimeCodePresent	= 1 << 7,
+			kCCDataPresent		= 1 << 6
+		};
+
+		if (size < kCDPHeaderLength || data[0] != 0x96 || data[1] != 0x69)
+			return;
+
+		INT32_UNSIGNED cdpLength = data[2];
+		if (cdpLength < kCDPHeaderLength || cdpLength > size)
+			return;
+
+		// The checksum makes the sum of all bytes of the packet zero
+		INT8_UNSIGNED sum = 0;
+		for (INT32_UNSIGNED i = 0; i < cdpLength; i++)
+			sum += data[i];
+		if (sum != 0)
+			return;
+
+		INT8_UNSIGNED	flags	= data[4];
+		INT32_UNSIGNED	offset	= kCDPHeaderLength;
+
+		if (flags & kTimeCodePresent)
+		{
+			if (offset >= cdpLength || data[offset] != kTimeCodeID)
+				return;
+			offset += kTimeCodeLength;
+		}
+
+		if (!(flags & kCCDataPresent) || offset + 2 > cdpLength || data[offset] != kCCDataID)
+			return;
+
+		INT32_UNSIGNED ccCount = data[offset + 1] & 0x1F;
+		offset += 2;
+		if (offset + ccCount * 3 > cdpLength)
+			return;
+
+		for (const INT8_UNSIGNED* ccData = data + offset; ccCount > 0; ccCount--, ccData += 3)
+			decodeCCData(ccData[0], ccData[1], ccData[2]);
+	}
+
+	// SMPTE 334-1 4.1 - the first word holds the field flag and line offset, followed by a CEA-608 byte pair
+	void decodeCEA608Packet(const INT8_UNSIGNED* data, INT32_UNSIGNED size)
+	{
+		if (size < 3)
+			return;
+
+		reportCEA608(data[0] & 0x80 ? 1 : 2, data[1], data[2]);
+	}
+
+	// CEA-708 4.4 Caption Data Packet - cc_data() construct
+	void decodeCCData(INT8_UNSIGNED header, INT8_UNSIGNED data1, INT8_UNSIGNED data2)
+	{
+		const INT8_UNSIGNED kCCValid = 1 << 2;
+
+		enum CCType
+		{
+			ccType608Field1 = 0,
+			ccType608Field2,
+			ccTypeDTVCCData,
+			ccTypeDTVCCStart
+		};
+
+		if (!(header & kCCValid))
+			return;
+
+		switch (header & 0x3)
+		{
+			case ccType608Field1:
+				reportCEA608(1, data1, data2);
+				break;
+
+			case ccType608Field2:
+				reportCEA608(2, data1, data2);
+				break;
+
+			case ccTypeDTVCCStart:
+			{
+				// CEA-708 5 - the packet header gives a sequence number and the size, including the header, in pairs
+				INT8_UNSIGNED sizeCode = data1 & 0x3F;
+				m_dtvccPacketSize = (sizeCode == 0) ? kMaximumDTVCCPacket : sizeCode * 2;
+				m_dtvccPacketLength = 0;
+				appendDTVCCData(data1, data2);
+				break;
+			}
+
+			case ccTypeDTVCCData:
+				// Data without a preceding start is the tail of a packet whose start was missed
+				if (m_dtvccPacketSize != 0)
+					appendDTVCCData(data1, data2);
+				break;
+		}
+	}
+
+	void appendDTVCCData(INT8_UNSIGNED data1, INT8_UNSIGNED data2)
+	{
+		m_dtvccPacket[m_dtvccPacketLength++] = data1;
+		m_dtvccPacket[m_dtvccPacketLength++] = data2;
+
+		if (m_dtvccPacketLength >= m_dtvccPacketSize)
+		{
+			decodeDTVCCPacket(m_dtvccPacket, m_dtvccPacketSize);
+			m_dtvccPacketSize = 0;
+			m_dtvccPacketLength = 0;
+		}
+	}
+
+	// CEA-708 6.2 Service Blocks
+	void decodeDTVCCPacket(const INT8_UNSIGNED* packet, INT32_UNSIGNED size)
+	{
+		INT32_UNSIGNED offset = 1;
+
+		while (offset < size)
+		{
+			INT8_UNSIGNED serviceNumber	= packet[offset] >> 5;
+			INT8_UNSIGNED blockSize		= packet[offset] & 0x1F;
+			offset++;
+
+			// A null block header ends the service data, the rest of the packet is padding
+			if (serviceNumber == 0)
+				break;
+
+			// 6.2.2 Extended Service Block Header
+			if (serviceNumber == 7 && blockSize != 0)
+			{
+				if (offset >= size)
+					break;
+				serviceNumber = packet[offset++] & 0x3F;
+			}
+
+			if (offset + blockSize > size)
+				break;
+
+			if (blockSize != 0)
+				m_listener->cea708ServiceBlock(serviceNumber, packet + offset, blockSize);
+
+			offset += blockSize;
+		}
+	}
+
+	void reportCEA608(INT8_UNSIGNED field, INT8_UNSIGNED data1, INT8_UNSIGNED data2)
+	{
+		// Strip the odd parity bit, and skip null padding pairs
+		data1 &= 0x7F;
+		data2 &= 0x7F;
+		if (data1 != 0 || data2 != 0)
+			m_listener->cea608Data(field, data1, data2);
+	}
+};
@@ -26,23 +26,61 @@
  */
 
 #include <atomic>
-#include <map>
-#include <vector>
+#include <ctype.h>
 #include "platform.h"
+#include "AncillaryDecoder.h"
 
  // Video mode parameters
 const BMDDisplayMode			kDisplayMode = bmdModeHD1080i50;
 const BMDPixelFormat			kPixelFormat = bmdFormat10BitYUV;
-const BMDAncillaryPacketFormat	kAncillaryFormat = bmdAncillaryPacketFormatUInt8;
 
-struct AncillaryPacket
+// Prints the ancillary packets which change between frames, and the caption data decoded from them
+class AncillaryPrinter : public AncillaryDecoderListener
 {
-	INT8_UNSIGNED				m_DID;
-	INT8_UNSIGNED				m_SDID;
-	std::vector<INT8_UNSIGNED>	m_data;
-	bool operator!=(const AncillaryPacket& other) const
+public:
+	void packetChanged(INT32_UNSIGNED lineNumber, INT8_UNSIGNED DID, INT8_UNSIGNED SDID, const INT8_UNSIGNED* data, INT32_UNSIGNED size) override
+	{
+		printf("Line %d:\t", lineNumber);
+		printf("DID: %02x; ", DID);
+		printf("SDID: %02x; ", SDID);
+		printf("Data:");
+		for (INT32_UNSIGNED i = 0; i < size; i++)
+			printf(" %02x", data[i]);
+		printf("\n");
+	}
+
+	void packetRemoved(INT32_UNSIGNED lineNumber, INT8_UNSIGNED DID, INT8_UNSIGNED SDID) override
+	{
+		printf("Line %d:\tDID: %02x; SDID: %02x; <empty>\n", lineNumber, DID, SDID);
+	}
+
+	void cea608Data(INT8_UNSIGNED field, INT8_UNSIGNED data1, INT8_UNSIGNED data2) override
+	{
+		// Control codes have a first byte of 0x10 - 0x1F, otherwise each byte is a character
+		if (data1 >= 0x10 && data1 < 0x20)
+			printf("CEA-608 field %d:\tcontrol %02x %02x\n", field, data1, data2);
+		else
+			printf("CEA-608 field %d:\t\"%c%c\"\n", field, printable(data1), printable(data2));
+	}
+
+	void cea708ServiceBlock(INT8_UNSIGNED serviceNumber, const INT8_UNSIGNED* data, INT8_UNSIGNED size) override
 	{
-		return std::tie(m_DID, m_SDID, m_data) != std::tie(other.m_DID, other.m_SDID, other.m_data);
+		// G0 characters are printed as text, and commands in hex
+		printf("CEA-708 service %d:\t", serviceNumber);
+		for (INT8_UNSIGNED i = 0; i < size; i++)
+		{
+			if (data[i] >= 0x20 && data[i] < 0x7F)
+				putchar(data[i]);
+			else
+				printf("[%02x]", data[i]);
+		}
+		printf("\n");
+	}
+
+private:
+	static char printable(INT8_UNSIGNED c)
+	{
+		return isprint(c) ? (char)c : '.';
 	}
 };
 
@@ -52,6 +90,7 @@ class InputCallback : public IDeckLinkInputCallback
 public:
 	InputCallback(IDeckLinkInput *deckLinkInput) :
 		m_deckLinkInput(deckLinkInput),
+		m_ancillaryDecoder(&m_ancillaryPrinter),
 		m_refCount(1)
 	{
 	}
@@ -104,9 +143,10 @@ public:
 	}
 
 private:
-	IDeckLinkInput*								m_deckLinkInput;
-	std::map<INT32_UNSIGNED, AncillaryPacket>	m_prevAncillaryPackets;
-	std::atomic<ULONG>							m_refCount;
+	IDeckLinkInput*			m_deckLinkInput;
+	AncillaryPrinter		m_ancillaryPrinter;
+	AncillaryDecoder		m_ancillaryDecoder;
+	std::atomic<ULONG>		m_refCount;
 };
 
 HRESULT InputCallback::VideoInputFormatChanged(BMDVideoInputFormatChangedEvents notificationEvents, IDeckLinkDisplayMode *newDisplayMode, BMDDetectedVideoInputFormatFlags detectedSignalFlags)
@@ -116,10 +156,7 @@ HRESULT InputCallback::VideoInputFormatChanged(BMDVideoInputFormatChangedEvents
 
 HRESULT InputCallback::VideoInputFrameArrived(IDeckLinkVideoInputFrame* videoFrame, IDeckLinkAudioInputPacket* audioPacket)
 {
-	std::map<INT32_UNSIGNED, AncillaryPacket>	capturedAncillaryPackets;
 	IDeckLinkVideoFrameAncillaryPackets*		videoFrameAncillaryPackets	= nullptr;
-	IDeckLinkAncillaryPacketIterator*			ancillaryPacketIterator		= nullptr;
-	IDeckLinkAncillaryPacket*					ancillaryPacket				= nullptr;
 	HRESULT										result;
 
 	if (!videoFrame || (videoFrame->GetFlags() & bmdFrameHasNoInputSource))
@@ -132,58 +169,14 @@ HRESULT InputCallback::VideoInputFrameArrived(IDeckLinkVideoInputFrame* videoFra
 		goto bail;
 	}
 
-	if (videoFrameAncillaryPackets->GetPacketIterator(&ancillaryPacketIterator) != S_OK)
+	// Iterate the packets once, reporting the lines with new, modified or removed data, and any captions
+	if (m_ancillaryDecoder.decodeFrame(videoFrameAncillaryPackets) != S_OK)
 	{
 		fprintf(stderr, "Could not get ancillary packet iterator\n");
 		goto bail;
 	}
 
-	while (ancillaryPacketIterator->Next(&ancillaryPacket) == S_OK)
-	{
-		INT32_UNSIGNED	ancillaryBufferSize;
-		INT8_UNSIGNED*	ancillaryBufferPtr;
-
-		if (ancillaryPacket->GetBytes(kAncillaryFormat, (const void**)&ancillaryBufferPtr, &ancillaryBufferSize) == S_OK)
-		{
-			std::vector<INT8_UNSIGNED> ancillaryBuffer(ancillaryBufferPtr, ancillaryBufferPtr + ancillaryBufferSize);
-			capturedAncillaryPackets[ancillaryPacket->GetLineNumber()] = { ancillaryPacket->GetDID(), ancillaryPacket->GetSDID(), std::move(ancillaryBuffer) };
-		}
-
-		ancillaryPacket->Release();
-	}
-
-	// Check any VANC lines that no longer have data
-	for (auto& ancillaryPacketIter : m_prevAncillaryPackets)
-	{
-		auto vancLineSearch = capturedAncillaryPackets.find(ancillaryPacketIter.first);
-		if (vancLineSearch == capturedAncillaryPackets.end())
-		{
-			printf("Line %d:\t<empty>\n", ancillaryPacketIter.first);
-		}
-	}
-
-	// Check VANC lines that have new or modified data 
-	for (auto& ancillaryPacketIter : capturedAncillaryPackets)
-	{
-		auto vancLineSearch = m_prevAncillaryPackets.find(ancillaryPacketIter.first);
-		if ((vancLineSearch == m_prevAncillaryPackets.end()) || (vancLineSearch->second != ancillaryPacketIter.second))
-		{
-			printf("Line %d:\t", ancillaryPacketIter.first);
-			printf("DID: %02x; ", ancillaryPacketIter.second.m_DID);
-			printf("SDID: %02x; ", ancillaryPacketIter.second.m_SDID);
-			printf("Data:");
-			for (int i = 0; i < (int)ancillaryPacketIter.second.m_data.size(); i++)
-				printf(" %02x", ancillaryPacketIter.second.m_data[i]);
-			printf("\n");
-		}
-	}
-
-	m_prevAncillaryPackets = std::move(capturedAncillaryPackets);
-
 bail:
-	if (ancillaryPacketIterator != nullptr)
-		ancillaryPacketIterator->Release();
-
 	if (videoFrameAncillaryPackets != nullptr)
 		videoFrameAncillaryPackets->Release();
 
@@ -0,0 +1,655 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include <errno.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <sys/sysmacros.h>
+#include <time.h>
+#include <unistd.h>
+#include <linux/io_uring.h>
+
+#include "AsyncFileWriter.h"
+
+// user_data of the no-op submitted by Close() to stop the completion thread
+static const uint64_t kStopRequest = 0;
+
+static inline int io_uring_setup(uint32_t entries, struct io_uring_params* params)
+{
+	return (int)syscall(__NR_io_uring_setup, entries, params);
+}
+
+static inline int io_uring_enter(int ringFd, uint32_t toSubmit, uint32_t minComplete, uint32_t flags)
+{
+	return (int)syscall(__NR_io_uring_enter, ringFd, toSubmit, minComplete, flags, NULL, 0);
+}
+
+static uint64_t GetTimeNanoseconds()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+AsyncFileWriter::AsyncFileWriter() :
+	m_fd(-1),
+	m_directFd(-1),
+	m_directAlignment(0),
+	m_directActive(false),
+	m_directInFlight(0),
+	m_fileOffset(0),
+	m_preallocated(false),
+	m_ringFd(-1),
+	m_sqRing(MAP_FAILED),
+	m_sqRingSize(0),
+	m_cqRing(MAP_FAILED),
+	m_cqRingSize(0),
+	m_sqes(MAP_FAILED),
+	m_sqesSize(0),
+	m_sqHead(NULL),
+	m_sqTail(NULL),
+	m_sqMask(0),
+	m_sqArray(NULL),
+	m_cqHead(NULL),
+	m_cqTail(NULL),
+	m_cqMask(0),
+	m_cqes(NULL),
+	m_threadRunning(false),
+	m_stopping(false),
+	m_requests(NULL),
+	m_freeRequests(NULL),
+	m_pendingHead(NULL),
+	m_pendingTail(NULL),
+	m_completedOwners(NULL),
+	m_totalLatency(0),
+	m_errorReported(false)
+{
+	memset(&m_statistics, 0, sizeof(m_statistics));
+	pthread_mutex_init(&m_mutex, NULL);
+	pthread_cond_init(&m_condition, NULL);
+}
+
+AsyncFileWriter::~AsyncFileWriter()
+{
+	Close();
+
+	pthread_cond_destroy(&m_condition);
+	pthread_mutex_destroy(&m_mutex);
+}
+
+bool AsyncFileWriter::Open(const char* filename, uint32_t queueDepth, bool directIO, uint64_t preallocateBytes)
+{
+	if (m_fd >= 0 || queueDepth == 0)
+		return false;
+
+	m_fd = open(filename, O_WRONLY|O_CREAT|O_TRUNC, 0664);
+	if (m_fd < 0)
+		return false;
+
+	if (directIO)
+	{
+		// A second descriptor on the same file, so unaligned writes can still go through the page cache
+		m_directFd = open(filename, O_WRONLY|O_DIRECT);
+		if (m_directFd >= 0)
+		{
+			m_directAlignment = GetDirectIOAlignment(m_fd);
+			m_directActive = true;
+		}
+		else
+			fprintf(stderr, "Direct I/O is not supported for \"%s\", writing through the page cache\n", filename);
+	}
+
+	if (preallocateBytes > 0)
+	{
+		if (fallocate(m_fd, 0, 0, preallocateBytes) == 0)
+			m_preallocated = true;
+		else
+			fprintf(stderr, "Unable to preallocate %llu bytes for \"%s\": %s\n", (unsigned long long)preallocateBytes, filename, strerror(errno));
+	}
+
+	m_requests = (WriteRequest*)calloc(queueDepth, sizeof(WriteRequest));
+	m_completedOwners = (IUnknown**)calloc(queueDepth, sizeof(IUnknown*));
+	for (uint32_t i = 0; i < queueDepth; i++)
+	{
+		m_requests[i].next = m_freeRequests;
+		m_freeRequests = &m_requests[i];
+	}
+
+	if (!SetupRing(queueDepth))
+		fprintf(stderr, "io_uring is not available (%s), writing \"%s\" from a worker thread\n", strerror(errno), filename);
+
+	m_stopping = false;
+	if (pthread_create(&m_completionThread, NULL, CompletionThread, this) != 0)
+	{
+		Close();
+		return false;
+	}
+
+	m_threadRunning = true;
+	return true;
+}
+
+bool AsyncFileWriter::Write(IUnknown* owner, const void* bytes, uint32_t length)
+{
+	WriteRequest*	request;
+	bool			aligned;
+
+	if (m_fd < 0 || length == 0)
+		return false;
+
+	pthread_mutex_lock(&m_mutex);
+
+	if (m_directActive)
+	{
+		aligned = ((uintptr_t)bytes % m_directAlignment == 0) && (length % m_directAlignment == 0) && (m_fileOffset % m_directAlignment == 0);
+		if (!aligned)
+		{
+			// Switch to the page cache once direct writes have drained, as a buffered write may
+			// read back the page shared with the preceding direct write
+			while (m_directInFlight > 0)
+				pthread_cond_wait(&m_condition, &m_mutex);
+
+			m_directActive = false;
+		}
+	}
+
+	if (m_freeRequests == NULL)
+	{
+		// The disk is not keeping up; wait for a write to complete
+		m_statistics.stallCount++;
+		while (m_freeRequests == NULL)
+			pthread_cond_wait(&m_condition, &m_mutex);
+	}
+
+	request = m_freeRequests;
+	m_freeRequests = request->next;
+
+	if (owner != NULL)
+		owner->AddRef();
+
+	request->owner = owner;
+	request->bytes = (const uint8_t*)bytes;
+	request->length = length;
+	request->written = 0;
+	request->offset = m_fileOffset;
+	request->submitTime = GetTimeNanoseconds();
+	request->direct = m_directActive;
+	request->next = NULL;
+
+	m_fileOffset += length;
+
+	if (request->direct)
+		m_directInFlight++;
+
+	if (++m_statistics.queueDepth > m_statistics.maxQueueDepth)
+		m_statistics.maxQueueDepth = m_statistics.queueDepth;
+
+	bool submitted = Submit(request);
+
+	pthread_mutex_unlock(&m_mutex);
+
+	// A write that could not be submitted has already been written and completed
+	if (!submitted && owner != NULL)
+		owner->Release();
+
+	return true;
+}
+
+void AsyncFileWriter::Close()
+{
+	if (m_fd < 0)
+		return;
+
+	if (m_threadRunning)
+	{
+		pthread_mutex_lock(&m_mutex);
+
+		while (m_statistics.queueDepth > 0)
+			pthread_cond_wait(&m_condition, &m_mutex);
+
+		m_stopping = true;
+
+		if (m_ringFd >= 0)
+		{
+			// Wake the completion thread, which is waiting in io_uring_enter()
+			uint32_t tail = *m_sqTail;
+			uint32_t index = tail & m_sqMask;
+			struct io_uring_sqe* sqe = &((struct io_uring_sqe*)m_sqes)[index];
+
+			memset(sqe, 0, sizeof(*sqe));
+			sqe->opcode = IORING_OP_NOP;
+			sqe->user_data = kStopRequest;
+			m_sqArray[index] = index;
+			__atomic_store_n(m_sqTail, tail + 1, __ATOMIC_RELEASE);
+
+			while (io_uring_enter(m_ringFd, 1, 0, 0) < 0 && errno == EINTR)
+				;
+		}
+
+		pthread_cond_broadcast(&m_condition);
+		pthread_mutex_unlock(&m_mutex);
+
+		pthread_join(m_completionThread, NULL);
+		m_threadRunning = false;
+	}
+
+	DestroyRing();
+
+	// Release the preallocated space beyond the data written
+	if (m_preallocated && ftruncate(m_fd, m_fileOffset) != 0)
+		fprintf(stderr, "Unable to truncate output file: %s\n", strerror(errno));
+
+	if (m_directFd >= 0)
+		close(m_directFd);
+
+	close(m_fd);
+
+	free(m_requests);
+	free(m_completedOwners);
+
+	m_fd = -1;
+	m_directFd = -1;
+	m_directActive = false;
+	m_preallocated = false;
+	m_requests = NULL;
+	m_freeRequests = NULL;
+	m_pendingHead = NULL;
+	m_pendingTail = NULL;
+	m_completedOwners = NULL;
+}
+
+void AsyncFileWriter::GetStatistics(AsyncFileWriterStatistics* statistics)
+{
+	pthread_mutex_lock(&m_mutex);
+
+	*statistics = m_statistics;
+	statistics->meanLatency = (m_statistics.writeCount > 0) ? m_totalLatency / m_statistics.writeCount : 0;
+
+	pthread_mutex_unlock(&m_mutex);
+}
+
+bool AsyncFileWriter::SetupRing(uint32_t entries)
+{
+	struct io_uring_params	params;
+
+	memset(&params, 0, sizeof(params));
+
+	m_ringFd = io_uring_setup(entries, &params);
+	if (m_ringFd < 0)
+		return false;
+
+	m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(uint32_t);
+	m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+
+	if (params.features & IORING_FEAT_SINGLE_MMAP)
+	{
+		if (m_cqRingSize > m_sqRingSize)
+			m_sqRingSize = m_cqRingSize;
+		m_cqRingSize = 0;
+	}
+
+	m_sqRing = mmap(NULL, m_sqRingSize, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, m_ringFd, IORING_OFF_SQ_RING);
+	if (m_sqRing == MAP_FAILED)
+		goto bail;
+
+	if (m_cqRingSize > 0)
+	{
+		m_cqRing = mmap(NULL, m_cqRingSize, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, m_ringFd, IORING_OFF_CQ_RING);
+		if (m_cqRing == MAP_FAILED)
+			goto bail;
+	}
+
+	m_sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+	m_sqes = mmap(NULL, m_sqesSize, PROT_READ|PROT_WRITE, MAP_SHARED|MAP_POPULATE, m_ringFd, IORING_OFF_SQES);
+	if (m_sqes == MAP_FAILED)
+		goto bail;
+
+	{
+		uint8_t* sqRing = (uint8_t*)m_sqRing;
+		uint8_t* cqRing = (m_cqRingSize > 0) ? (uint8_t*)m_cqRing : sqRing;
+
+		m_sqHead = (uint32_t*)(sqRing + params.sq_off.head);
+		m_sqTail = (uint32_t*)(sqRing + params.sq_off.tail);
+		m_sqMask = *(uint32_t*)(sqRing + params.sq_off.ring_mask);
+		m_sqArray = (uint32_t*)(sqRing + params.sq_off.array);
+		m_cqHead = (uint32_t*)(cqRing + params.cq_off.head);
+		m_cqTail = (uint32_t*)(cqRing + params.cq_off.tail);
+		m_cqMask = *(uint32_t*)(cqRing + params.cq_off.ring_mask);
+		m_cqes = cqRing + params.cq_off.cqes;
+	}
+
+	return true;
+
+bail:
+	int error = errno;
+	DestroyRing();
+	errno = error;
+	return false;
+}
+
+void AsyncFileWriter::DestroyRing()
+{
+	if (m_sqes != MAP_FAILED)
+		munmap(m_sqes, m_sqesSize);
+
+	if (m_cqRing != MAP_FAILED)
+		munmap(m_cqRing, m_cqRingSize);
+
+	if (m_sqRing != MAP_FAILED)
+		munmap(m_sqRing, m_sqRingSize);
+
+	if (m_ringFd >= 0)
+		close(m_ringFd);
+
+	m_sqes = MAP_FAILED;
+	m_cqRing = MAP_FAILED;
+	m_sqRing = MAP_FAILED;
+	m_ringFd = -1;
+}
+
+bool AsyncFileWriter::Submit(WriteRequest* request)
+{
+	// Called with m_mutex held, returns false when the request could not be queued and has been
+	// completed, in which case the caller releases its owner
+	if (m_ringFd < 0)
+	{
+		if (m_pendingTail != NULL)
+			m_pendingTail->next = request;
+		else
+			m_pendingHead = request;
+		m_pendingTail = request;
+		request->next = NULL;
+
+		pthread_cond_broadcast(&m_condition);
+		return true;
+	}
+
+	uint32_t tail = *m_sqTail;
+	uint32_t index = tail & m_sqMask;
+	struct io_uring_sqe* sqe = &((struct io_uring_sqe*)m_sqes)[index];
+
+	memset(sqe, 0, sizeof(*sqe));
+	sqe->opcode = IORING_OP_WRITE;
+	sqe->fd = request->direct ? m_directFd : m_fd;
+	sqe->addr = (uint64_t)(uintptr_t)(request->bytes + request->written);
+	sqe->len = request->length - request->written;
+	sqe->off = request->offset + request->written;
+	sqe->user_data = (uint64_t)(uintptr_t)request;
+	m_sqArray[index] = index;
+	__atomic_store_n(m_sqTail, tail + 1, __ATOMIC_RELEASE);
+
+	int submitted;
+	while ((submitted = io_uring_enter(m_ringFd, 1, 0, 0)) < 0 && errno == EINTR)
+		;
+
+	if (submitted == 1)
+		return true;
+
+	// The kernel did not consume the entry, so withdraw it rather than leave it for a later submission
+	// that may never come, and write the request from this thread instead
+	__atomic_store_n(m_sqTail, tail, __ATOMIC_RELEASE);
+
+	if (!m_errorReported)
+	{
+		fprintf(stderr, "Unable to submit write, writing synchronously: %s\n", (submitted < 0) ? strerror(errno) : "not consumed");
+		m_errorReported = true;
+	}
+
+	Complete(request, WriteSynchronously(request));
+	pthread_cond_broadcast(&m_condition);
+	return false;
+}
+
+int AsyncFileWriter::WriteSynchronously(WriteRequest* request)
+{
+	// Called with m_mutex held, writes the rest of the request and returns the result for Complete()
+	uint32_t written = request->written;
+
+	while (written < request->length)
+	{
+		ssize_t result = pwrite(request->direct ? m_directFd : m_fd, request->bytes + written, request->length - written, request->offset + written);
+		if (result < 0 && errno == EINTR)
+			continue;
+
+		if (result < 0 && errno == EINVAL && request->direct)
+		{
+			// As in Complete(), continue through the page cache
+			request->direct = false;
+			m_directActive = false;
+			m_directInFlight--;
+			continue;
+		}
+
+		if (result <= 0)
+			return (result < 0) ? -errno : 0;
+
+		written += (uint32_t)result;
+	}
+
+	return (int)(written - request->written);
+}
+
+bool AsyncFileWriter::Complete(WriteRequest* request, int result)
+{
+	// Called with m_mutex held, returns false when the request has been resubmitted and is still in flight
+	if (result == -EINVAL && request->direct)
+	{
+		// The device needs a stricter alignment than detected, continue through the page cache
+		request->direct = false;
+		m_directActive = false;
+		m_directInFlight--;
+		return !Submit(request);
+	}
+
+	if (result > 0 && request->written + result < request->length)
+	{
+		request->written += result;
+		return !Submit(request);
+	}
+
+	if (result <= 0)
+	{
+		m_statistics.errorCount++;
+		if (!m_errorReported)
+		{
+			fprintf(stderr, "Write failed: %s\n", (result < 0) ? strerror(-result) : "no space left");
+			m_errorReported = true;
+		}
+	}
+	else
+	{
+		double latency = (GetTimeNanoseconds() - request->submitTime) / 1000000.0;
+
+		if (m_statistics.writeCount == 0 || latency < m_statistics.minLatency)
+			m_statistics.minLatency = latency;
+		if (latency > m_statistics.maxLatency)
+			m_statistics.maxLatency = latency;
+
+		m_totalLatency += latency;
+		m_statistics.writeCount++;
+		m_statistics.bytesWritten += request->length;
+		if (request->direct)
+			m_statistics.directWriteCount++;
+	}
+
+	if (request->direct)
+		m_directInFlight--;
+
+	m_statistics.queueDepth--;
+
+	request->next = m_freeRequests;
+	m_freeRequests = request;
+	return true;
+}
+
+void AsyncFileWriter::ProcessRingCompletions()
+{
+	bool stop = false;
+
+	while (!stop)
+	{
+		uint32_t completedCount = 0;
+		uint32_t reapedCount = 0;
+
+		pthread_mutex_lock(&m_mutex);
+
+		uint32_t head = *m_cqHead;
+		uint32_t tail = __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE);
+
+		for (; head != tail; head++, reapedCount++)
+		{
+			struct io_uring_cqe* cqe = &((struct io_uring_cqe*)m_cqes)[head & m_cqMask];
+
+			if (cqe->user_data == kStopRequest)
+			{
+				stop = true;
+				continue;
+			}
+
+			WriteRequest* request = (WriteRequest*)(uintptr_t)cqe->user_data;
+			IUnknown* owner = request->owner;
+
+			if (Complete(request, cqe->res) && owner != NULL)
+				m_completedOwners[completedCount++] = owner;
+		}
+
+		__atomic_store_n(m_cqHead, head, __ATOMIC_RELEASE);
+
+		if (reapedCount > 0)
+			pthread_cond_broadcast(&m_condition);
+
+		pthread_mutex_unlock(&m_mutex);
+
+		// Releasing a frame may return its buffer to the driver, so do not hold the lock
+		for (uint32_t i = 0; i < completedCount; i++)
+			m_completedOwners[i]->Release();
+
+		if (reapedCount == 0 && io_uring_enter(m_ringFd, 0, 1, IORING_ENTER_GETEVENTS) < 0 && errno != EINTR)
+		{
+			fprintf(stderr, "Unable to wait for write completion: %s\n", strerror(errno));
+			break;
+		}
+	}
+}
+
+void AsyncFileWriter::ProcessPendingWrites()
+{
+	pthread_mutex_lock(&m_mutex);
+
+	while (true)
+	{
+		while (m_pendingHead == NULL && !m_stopping)
+			pthread_cond_wait(&m_condition, &m_mutex);
+
+		WriteRequest* request = m_pendingHead;
+		if (request == NULL)
+			break;
+
+		m_pendingHead = request->next;
+		if (m_pendingHead == NULL)
+			m_pendingTail = NULL;
+
+		pthread_mutex_unlock(&m_mutex);
+
+		ssize_t result = pwrite(request->direct ? m_directFd : m_fd, request->bytes + request->written, request->length - request->written, request->offset + request->written);
+		if (result < 0)
+			result = -errno;
+
+		pthread_mutex_lock(&m_mutex);
+
+		IUnknown* owner = request->owner;
+		if (Complete(request, (int)result))
+		{
+			pthread_cond_broadcast(&m_condition);
+			pthread_mutex_unlock(&m_mutex);
+
+			if (owner != NULL)
+				owner->Release();
+
+			pthread_mutex_lock(&m_mutex);
+		}
+	}
+
+	pthread_mutex_unlock(&m_mutex);
+}
+
+void* AsyncFileWriter::CompletionThread(void* context)
+{
+	AsyncFileWriter* writer = (AsyncFileWriter*)context;
+
+	if (writer->m_ringFd >= 0)
+		writer->ProcessRingCompletions();
+	else
+		writer->ProcessPendingWrites();
+
+	return NULL;
+}
+
+uint32_t AsyncFileWriter::GetDirectIOAlignment(int fd)
+{
+	struct stat		fileStat;
+	char			path[128];
+	unsigned int	blockSize = 0;
+
+	if (fstat(fd, &fileStat) != 0)
+		return 4096;
+
+	// Logical block size of the device, or of its parent device when the file is on a partition
+	const char* formats[] = { "/sys/dev/block/%u:%u/queue/logical_block_size", "/sys/dev/block/%u:%u/../queue/logical_block_size" };
+	for (size_t i = 0; i < sizeof(formats) / sizeof(formats[0]) && blockSize == 0; i++)
+	{
+		snprintf(path, sizeof(path), formats[i], major(fileStat.st_dev), minor(fileStat.st_dev));
+
+		FILE* file = fopen(path, "r");
+		if (file != NULL)
+		{
+			if (fscanf(file, "%u", &blockSize) != 1)
+				blockSize = 0;
+			fclose(file);
+		}
+	}
+
+	return (blockSize > 0) ? blockSize : 4096;
+}
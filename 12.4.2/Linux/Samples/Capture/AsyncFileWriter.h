@@ -0,0 +1,154 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#ifndef __ASYNC_FILE_WRITER_H__
+#define __ASYNC_FILE_WRITER_H__
+
+#include <pthread.h>
+#include <stdint.h>
+#include "DeckLinkAPI.h"
+
+struct AsyncFileWriterStatistics
+{
+	uint64_t	writeCount;
+	uint64_t	bytesWritten;
+	uint64_t	directWriteCount;		// Writes that bypassed the page cache
+	uint64_t	stallCount;				// Writes that had to wait for a free queue entry
+	uint64_t	errorCount;
+	uint32_t	queueDepth;				// Writes currently in flight
+	uint32_t	maxQueueDepth;
+	double		minLatency;				// Submission to completion, in milliseconds
+	double		meanLatency;
+	double		maxLatency;
+};
+
+// Appends buffers to a file without blocking or copying.  Each write keeps a reference on the object
+// that owns the buffer (the captured video frame or audio packet) and is submitted to an io_uring
+// queue; the reference is released by a completion thread once the data is on its way to disk, so a
+// disk stall holds frames rather than stalling the capture callback.  The owner may be NULL for
+// buffers that outlive the writer.  When io_uring is unavailable, writes are performed by the
+// completion thread with pwrite(), and a write that cannot be submitted to the ring is written with
+// pwrite() by the submitting thread.
+//
+// With direct I/O the file is also opened with O_DIRECT, and writes bypass the page cache for as long
+// as their buffer, length and file offset are aligned to the device's logical block size.  After the
+// first unaligned write, the writer waits for direct writes in flight and continues through the page
+// cache, so the two never touch the same page concurrently.  Preallocation reserves space with
+// fallocate() and the file is truncated to the length written when it is closed.
+class AsyncFileWriter
+{
+public:
+	AsyncFileWriter();
+	virtual ~AsyncFileWriter();
+
+	bool	Open(const char* filename, uint32_t queueDepth, bool directIO, uint64_t preallocateBytes);
+	bool	Write(IUnknown* owner, const void* bytes, uint32_t length);
+	void	Close();
+
+	void	GetStatistics(AsyncFileWriterStatistics* statistics);
+
+private:
+	struct WriteRequest
+	{
+		IUnknown*		owner;
+		const uint8_t*	bytes;
+		uint32_t		length;
+		uint32_t		written;
+		uint64_t		offset;
+		uint64_t		submitTime;
+		bool			direct;
+		WriteRequest*	next;
+	};
+
+	int					m_fd;
+	int					m_directFd;
+	uint32_t			m_directAlignment;
+	bool				m_directActive;
+	uint32_t			m_directInFlight;
+	uint64_t			m_fileOffset;
+	bool				m_preallocated;
+
+	// io_uring rings, m_ringFd < 0 when writes are performed with pwrite()
+	int					m_ringFd;
+	void*				m_sqRing;
+	size_t				m_sqRingSize;
+	void*				m_cqRing;
+	size_t				m_cqRingSize;
+	void*				m_sqes;
+	size_t				m_sqesSize;
+	uint32_t*			m_sqHead;
+	uint32_t*			m_sqTail;
+	uint32_t			m_sqMask;
+	uint32_t*			m_sqArray;
+	uint32_t*			m_cqHead;
+	uint32_t*			m_cqTail;
+	uint32_t			m_cqMask;
+	void*				m_cqes;
+
+	// Protects the request lists, the submission queue and the statistics
+	pthread_mutex_t		m_mutex;
+	pthread_cond_t		m_condition;
+	pthread_t			m_completionThread;
+	bool				m_threadRunning;
+	bool				m_stopping;
+
+	WriteRequest*		m_requests;
+	WriteRequest*		m_freeRequests;
+	WriteRequest*		m_pendingHead;		// Queued for pwrite() when io_uring is unavailable
+	WriteRequest*		m_pendingTail;
+	IUnknown**			m_completedOwners;	// Released by the completion thread outside the lock
+
+	AsyncFileWriterStatistics	m_statistics;
+	double				m_totalLatency;
+	bool				m_errorReported;
+
+	bool	SetupRing(uint32_t entries);
+	void	DestroyRing();
+	bool	Submit(WriteRequest* request);
+	int		WriteSynchronously(WriteRequest* request);
+	bool	Complete(WriteRequest* request, int result);
+	void	ProcessRingCompletions();
+	void	ProcessPendingWrites();
+
+	static void*	CompletionThread(void* context);
+	static uint32_t	GetDirectIOAlignment(int fd);
+};
+
+#endif
@@ -49,22 +49,41 @@
 #include "DeckLinkAPI.h"
 #include "Capture.h"
 #include "Config.h"
+#include "AsyncFileWriter.h"
+#include "CaptureFileWriter.h"
+#include "PooledMemoryAllocator.h"
+#include "DeckLinkTelemetry.h"
+#include "FrameWatermark.h"
+#include "PixelFormatTraits.h"
 
 static pthread_mutex_t	g_sleepMutex;
 static pthread_cond_t	g_sleepCond;
-static int				g_videoOutputFile = -1;
-static int				g_audioOutputFile = -1;
+static AsyncFileWriter*	g_videoWriter = NULL;
+static AsyncFileWriter*	g_audioWriter = NULL;
+static CaptureFileWriter*	g_captureWriter = NULL;
+static WatermarkChecker*	g_watermarkChecker = NULL;
 static bool				g_do_exit = false;
 
 static BMDConfig		g_config;
 
 static IDeckLinkInput*	g_deckLinkInput = NULL;
+static PooledMemoryAllocator*	g_frameAllocator = NULL;
 
 static unsigned long	g_frameCount = 0;
 
+// Size of the frame buffers the driver allocates for the display mode and pixel format
+static uint32_t GetFrameBufferSize(IDeckLinkDisplayMode* mode, BMDPixelFormat pixelFormat)
+{
+	return (uint32_t)(GetPixelFormatRowBytes(pixelFormat, mode->GetWidth()) * mode->GetHeight());
+}
+
+static TelemetryPublisher					g_telemetryPublisher;
+static std::shared_ptr<TelemetryStream>		g_captureTelemetry = std::make_shared<TelemetryStream>();
+
 DeckLinkCaptureDelegate::DeckLinkCaptureDelegate() : 
 	m_refCount(1),
-	m_pixelFormat(g_config.m_pixelFormat)
+	m_pixelFormat(g_config.m_pixelFormat),
+	m_lastStreamFrame(-1)
 {
 }
 
@@ -94,6 +113,8 @@ HRESULT DeckLinkCaptureDelegate::VideoInputFrameArrived(IDeckLinkVideoInputFrame
 	// Handle Video Frame
 	if (videoFrame)
 	{
+		UpdateTelemetry(videoFrame);
+
 		// If 3D mode is enabled we retreive the 3D extensions interface which gives.
 		// us access to the right eye frame by calling GetFrameForRightEye() .
 		if ( (videoFrame->QueryInterface(IID_IDeckLinkVideoFrame3DExtensions, (void **) &threeDExtensions) != S_OK) ||
@@ -130,19 +151,37 @@ HRESULT DeckLinkCaptureDelegate::VideoInputFrameArrived(IDeckLinkVideoInputFrame
 			if (timecodeString)
 				free((void*)timecodeString);
 
-			if (g_videoOutputFile != -1)
+			// Frames are referenced until written, so the callback does not wait for the disk
+			if (g_videoWriter != NULL)
 			{
 				videoFrame->GetBytes(&frameBytes);
-				write(g_videoOutputFile, frameBytes, videoFrame->GetRowBytes() * videoFrame->GetHeight());
+				g_videoWriter->Write(videoFrame, frameBytes, videoFrame->GetRowBytes() * videoFrame->GetHeight());
 
 				if (rightEyeFrame)
 				{
 					rightEyeFrame->GetBytes(&frameBytes);
-					write(g_videoOutputFile, frameBytes, videoFrame->GetRowBytes() * videoFrame->GetHeight());
+					g_videoWriter->Write(rightEyeFrame, frameBytes, videoFrame->GetRowBytes() * videoFrame->GetHeight());
 				}
 			}
+
+			if (g_watermarkChecker != NULL)
+			{
+				BMDTimeValue	frameTime;
+				BMDTimeValue	frameDuration;
+				BMDTimeValue	arrivalTime = kWatermarkNoTime;
+
+				// The hardware timestamp is the end of the frame on the wire, the watermark send time its start
+				if (videoFrame->GetHardwareReferenceTimestamp(kWatermarkTimeScale, &frameTime, &frameDuration) == S_OK)
+					arrivalTime = frameTime - frameDuration;
+
+				g_watermarkChecker->checkFrame(videoFrame, arrivalTime);
+			}
 		}
 
+		// Frames without an input signal are recorded too, so frame numbers follow stream time
+		if (g_captureWriter != NULL)
+			g_captureWriter->WriteVideoFrame(videoFrame, rightEyeFrame, g_config.m_timecodeFormat);
+
 		if (rightEyeFrame)
 			rightEyeFrame->Release();
 
@@ -152,11 +191,14 @@ HRESULT DeckLinkCaptureDelegate::VideoInputFrameArrived(IDeckLinkVideoInputFrame
 	// Handle Audio Frame
 	if (audioFrame)
 	{
-		if (g_audioOutputFile != -1)
+		if (g_audioWriter != NULL)
 		{
 			audioFrame->GetBytes(&audioFrameBytes);
-			write(g_audioOutputFile, audioFrameBytes, audioFrame->GetSampleFrameCount() * g_config.m_audioChannels * (g_config.m_audioSampleDepth / 8));
+			g_audioWriter->Write(audioFrame, audioFrameBytes, audioFrame->GetSampleFrameCount() * g_config.m_audioChannels * (g_config.m_audioSampleDepth / 8));
 		}
+
+		if (g_captureWriter != NULL)
+			g_captureWriter->WriteAudioPacket(audioFrame);
 	}
 
 	if (g_config.m_maxFrames > 0 && videoFrame && g_frameCount >= g_config.m_maxFrames)
@@ -168,6 +210,36 @@ HRESULT DeckLinkCaptureDelegate::VideoInputFrameArrived(IDeckLinkVideoInputFrame
 	return S_OK;
 }
 
+void DeckLinkCaptureDelegate::UpdateTelemetry(IDeckLinkVideoInputFrame* videoFrame)
+{
+	BMDTimeValue	streamTime;
+	BMDTimeValue	frameDuration;
+	BMDTimeValue	frameStartTime;
+	BMDTimeValue	hardwareTime;
+	BMDTimeValue	timeInFrame;
+	BMDTimeValue	ticksPerFrame;
+
+	g_captureTelemetry->addFramesIn();
+
+	// Frames missing from the stream were dropped by the driver, before reaching this callback
+	if (videoFrame->GetStreamTime(&streamTime, &frameDuration, 1000000) == S_OK && frameDuration > 0)
+	{
+		int64_t streamFrame = streamTime / frameDuration;
+
+		if (m_lastStreamFrame >= 0 && streamFrame > m_lastStreamFrame + 1)
+			g_captureTelemetry->addDroppedFrames(streamFrame - m_lastStreamFrame - 1);
+
+		m_lastStreamFrame = streamFrame;
+	}
+
+	// Input latency, from the start of the frame on the wire to this callback
+	if ((videoFrame->GetHardwareReferenceTimestamp(1000000, &frameStartTime, &frameDuration) == S_OK) &&
+		(g_deckLinkInput->GetHardwareReferenceClock(1000000, &hardwareTime, &timeInFrame, &ticksPerFrame) == S_OK))
+	{
+		g_captureTelemetry->addLatencySample(hardwareTime - frameStartTime);
+	}
+}
+
 HRESULT DeckLinkCaptureDelegate::VideoInputFormatChanged(BMDVideoInputFormatChangedEvents events, IDeckLinkDisplayMode *mode, BMDDetectedVideoInputFormatFlags formatFlags)
 {
 	// This only gets called if bmdVideoInputEnableFormatDetection was set
@@ -200,6 +272,10 @@ HRESULT DeckLinkCaptureDelegate::VideoInputFormatChanged(BMDVideoInputFormatChan
 		{
 			g_deckLinkInput->StopStreams();
 
+			// Size the frame buffer pool for the new format before the driver commits the allocator
+			if (g_frameAllocator != NULL)
+				g_frameAllocator->SetBufferSize(GetFrameBufferSize(mode, pixelFormat));
+
 			result = g_deckLinkInput->EnableVideoInput(mode->GetDisplayMode(), pixelFormat, g_config.m_inputFlags);
 			if (result != S_OK)
 			{
@@ -208,6 +284,8 @@ HRESULT DeckLinkCaptureDelegate::VideoInputFormatChanged(BMDVideoInputFormatChan
 			}
 
 			g_deckLinkInput->StartStreams();
+			g_captureTelemetry->setFormat(mode->GetDisplayMode(), pixelFormat);
+			m_lastStreamFrame = -1;
 		}
 
 		m_pixelFormat = pixelFormat;
@@ -217,6 +295,78 @@ bail:
 	return S_OK;
 }
 
+static void DisplayWriterStatistics(const char* name, const AsyncFileWriterStatistics& statistics)
+{
+	fprintf(stderr, "%s file: %llu writes (%llu direct), %.1f MB, max queue depth %u, %llu stalls, %llu errors\n",
+		name,
+		(unsigned long long)statistics.writeCount,
+		(unsigned long long)statistics.directWriteCount,
+		statistics.bytesWritten / (1024.0 * 1024.0),
+		statistics.maxQueueDepth,
+		(unsigned long long)statistics.stallCount,
+		(unsigned long long)statistics.errorCount
+	);
+	fprintf(stderr, "%s write latency: Minimum = %.2f ms, Maximum = %.2f ms, Mean = %.2f ms\n",
+		name,
+		statistics.minLatency,
+		statistics.maxLatency,
+		statistics.meanLatency
+	);
+}
+
+static void DisplayWatermarkStatistics(const WatermarkStatistics& statistics)
+{
+	fprintf(stderr, "Watermark: %llu frames checked, %llu unmarked, %llu dropped, %llu repeated, %llu reordered, %llu corrupted, %llu not CRC checked\n",
+		(unsigned long long)statistics.framesChecked,
+		(unsigned long long)statistics.framesUnmarked,
+		(unsigned long long)statistics.framesDropped,
+		(unsigned long long)statistics.framesRepeated,
+		(unsigned long long)statistics.framesReordered,
+		(unsigned long long)statistics.framesCorrupted,
+		(unsigned long long)statistics.framesUnverified
+	);
+
+	if (statistics.latencySampleCount > 0)
+	{
+		fprintf(stderr, "Watermark glass-to-glass latency: Minimum = %.2f ms, Maximum = %.2f ms, Mean = %.2f ms\n",
+			statistics.latencyMin * 1000.0 / kWatermarkTimeScale,
+			statistics.latencyMax * 1000.0 / kWatermarkTimeScale,
+			(double)statistics.latencyTotal * 1000.0 / kWatermarkTimeScale / statistics.latencySampleCount
+		);
+	}
+}
+
+static void SampleCaptureTelemetry(TelemetryStream& stream)
+{
+	AsyncFileWriterStatistics	statistics;
+	uint32_t					availableFrameCount;
+	uint64_t					queueDepth = 0;
+
+	if (g_deckLinkInput->GetAvailableVideoFrameCount(&availableFrameCount) == S_OK)
+		stream.setBufferedVideoFrames(availableFrameCount);
+
+	// Writes in flight, which hold their captured frames
+	if (g_videoWriter != NULL)
+	{
+		g_videoWriter->GetStatistics(&statistics);
+		queueDepth += statistics.queueDepth;
+	}
+
+	if (g_audioWriter != NULL)
+	{
+		g_audioWriter->GetStatistics(&statistics);
+		queueDepth += statistics.queueDepth;
+	}
+
+	if (g_captureWriter != NULL)
+	{
+		g_captureWriter->GetStatistics(&statistics);
+		queueDepth += statistics.queueDepth;
+	}
+
+	stream.setQueueDepth(queueDepth);
+}
+
 static void sigfunc(int signum)
 {
 	if (signum == SIGINT || signum == SIGTERM)
@@ -242,6 +392,7 @@ int main(int argc, char *argv[])
 	bool							supported;
 
 	DeckLinkCaptureDelegate*		delegate = NULL;
+	AsyncFileWriterStatistics		writerStatistics;
 
 	pthread_mutex_init(&g_sleepMutex, NULL);
 	pthread_cond_init(&g_sleepCond, NULL);
@@ -345,11 +496,22 @@ int main(int argc, char *argv[])
 	delegate = new DeckLinkCaptureDelegate();
 	g_deckLinkInput->SetCallback(delegate);
 
+	// Capture into a pool of pre-allocated frame buffers, located on the NUMA node nearest the device
+	if (g_config.m_frameBufferCount > 0)
+	{
+		int numaNode = (g_config.m_numaNode >= 0) ? g_config.m_numaNode : PooledMemoryAllocator::GetDeckLinkNumaNode(deckLink);
+
+		g_frameAllocator = new PooledMemoryAllocator(g_config.m_frameBufferCount, GetFrameBufferSize(displayMode, g_config.m_pixelFormat), numaNode);
+		result = g_deckLinkInput->SetVideoInputFrameMemoryAllocator(g_frameAllocator);
+		if (result != S_OK)
+			fprintf(stderr, "Unable to set pooled frame memory allocator, using default allocator\n");
+	}
+
 	// Open output files
 	if (g_config.m_videoOutputFile != NULL)
 	{
-		g_videoOutputFile = open(g_config.m_videoOutputFile, O_WRONLY|O_CREAT|O_TRUNC, 0664);
-		if (g_videoOutputFile < 0)
+		g_videoWriter = new AsyncFileWriter();
+		if (!g_videoWriter->Open(g_config.m_videoOutputFile, g_config.m_writeQueueDepth, g_config.m_directIO, g_config.m_preallocateSize))
 		{
 			fprintf(stderr, "Could not open video output file \"%s\"\n", g_config.m_videoOutputFile);
 			goto bail;
@@ -358,14 +520,47 @@ int main(int argc, char *argv[])
 
 	if (g_config.m_audioOutputFile != NULL)
 	{
-		g_audioOutputFile = open(g_config.m_audioOutputFile, O_WRONLY|O_CREAT|O_TRUNC, 0664);
-		if (g_audioOutputFile < 0)
+		g_audioWriter = new AsyncFileWriter();
+		if (!g_audioWriter->Open(g_config.m_audioOutputFile, g_config.m_writeQueueDepth, false, 0))
 		{
 			fprintf(stderr, "Could not open audio output file \"%s\"\n", g_config.m_audioOutputFile);
 			goto bail;
 		}
 	}
 
+	if (g_config.m_captureOutputFile != NULL)
+	{
+		g_captureWriter = new CaptureFileWriter();
+		if (!g_captureWriter->Open(g_config.m_captureOutputFile, g_config.m_writeQueueDepth, g_config.m_directIO, g_config.m_preallocateSize, g_config.m_audioChannels, g_config.m_audioSampleDepth))
+		{
+			fprintf(stderr, "Could not open indexed output file \"%s\"\n", g_config.m_captureOutputFile);
+			goto bail;
+		}
+	}
+
+	if (g_config.m_watermark)
+	{
+		if (!IsWatermarkPixelFormat(g_config.m_pixelFormat))
+		{
+			fprintf(stderr, "The selected pixel format cannot carry a watermark\n");
+			goto bail;
+		}
+
+		g_watermarkChecker = new WatermarkChecker();
+		fprintf(stderr, "Checking watermarks with %s CRC\n", GetWatermarkCRCKernelName());
+	}
+
+	// Publish telemetry for monitors; the sampler is called on the publisher thread
+	if (g_telemetryPublisher.open("Capture"))
+	{
+		g_captureTelemetry = g_telemetryPublisher.addStream(deckLink, Telemetry::StreamDirection::Capture);
+		g_captureTelemetry->setSampler(SampleCaptureTelemetry);
+	}
+	else
+	{
+		fprintf(stderr, "Unable to create telemetry segment, telemetry will not be published\n");
+	}
+
 	// Block main thread until signal occurs
 	while (!g_do_exit)
 	{
@@ -385,6 +580,8 @@ int main(int argc, char *argv[])
 		if (result != S_OK)
 			goto bail;
 
+		g_captureTelemetry->setFormat(displayMode->GetDisplayMode(), g_config.m_pixelFormat);
+
 		// All Okay.
 		exitStatus = 0;
 
@@ -399,11 +596,46 @@ int main(int argc, char *argv[])
 	}
 
 bail:
-	if (g_videoOutputFile != 0)
-		close(g_videoOutputFile);
+	// Stop the sampler before the writers and input it polls are released
+	g_captureTelemetry->setSampler(nullptr);
+	g_telemetryPublisher.close();
 
-	if (g_audioOutputFile != 0)
-		close(g_audioOutputFile);
+	// Wait for queued writes, releasing the frames they reference
+	if (g_videoWriter != NULL)
+	{
+		g_videoWriter->Close();
+		g_videoWriter->GetStatistics(&writerStatistics);
+		DisplayWriterStatistics("Video", writerStatistics);
+		delete g_videoWriter;
+		g_videoWriter = NULL;
+	}
+
+	if (g_audioWriter != NULL)
+	{
+		g_audioWriter->Close();
+		g_audioWriter->GetStatistics(&writerStatistics);
+		DisplayWriterStatistics("Audio", writerStatistics);
+		delete g_audioWriter;
+		g_audioWriter = NULL;
+	}
+
+	if (g_captureWriter != NULL)
+	{
+		g_captureWriter->Close();
+		g_captureWriter->GetStatistics(&writerStatistics);
+		DisplayWriterStatistics("Indexed", writerStatistics);
+		delete g_captureWriter;
+		g_captureWriter = NULL;
+	}
+
+	// Input is stopped, so no more frames are queued for checking
+	if (g_watermarkChecker != NULL)
+	{
+		g_watermarkChecker->flush();
+		DisplayWatermarkStatistics(g_watermarkChecker->getStatistics());
+		delete g_watermarkChecker;
+		g_watermarkChecker = NULL;
+	}
 
 	if (displayModeName != NULL)
 		free(displayModeName);
@@ -420,6 +652,12 @@ bail:
 		g_deckLinkInput = NULL;
 	}
 
+	if (g_frameAllocator != NULL)
+	{
+		g_frameAllocator->Release();
+		g_frameAllocator = NULL;
+	}
+
 	if (deckLinkAttributes != NULL)
 		deckLinkAttributes->Release();
 
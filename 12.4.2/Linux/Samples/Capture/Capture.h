@@ -57,6 +57,9 @@ public:
 private:
 	int32_t				m_refCount;
 	BMDPixelFormat		m_pixelFormat;
+	int64_t				m_lastStreamFrame;
+
+	void	UpdateTelemetry(IDeckLinkVideoInputFrame* videoFrame);
 };
 
 #endif
@@ -0,0 +1,144 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#ifndef __CAPTURE_FILE_FORMAT_H__
+#define __CAPTURE_FILE_FORMAT_H__
+
+#include <stdint.h>
+
+// Layout of the indexed capture file written by Capture -o and read by CaptureFileReader.
+//
+// The file is a sequence of blocks aligned to kCaptureFileAlignment, so every payload can be mapped or
+// read with direct I/O in place:
+//
+//     CaptureFileHeader                     one block
+//     CaptureFileRecord + payload           one block of record header, payload padded to a block,
+//     ...                                   repeated for each video frame and audio packet
+//     CaptureFileIndexEntry[indexCount]     padded to a block
+//     CaptureFileTrailer                    last block of the file
+//
+// Each video record carries its own pixel format and dimensions, so a format change during capture
+// starts a new run of frames rather than corrupting the file.  A file without a valid trailer (from an
+// interrupted capture) is recovered by walking the records from the start.  Fields are little-endian.
+
+const uint32_t	kCaptureFileAlignment		= 4096;
+const uint32_t	kCaptureFileVersion			= 1;
+const uint32_t	kCaptureFileTimeScale		= 240000;		// Exact for all DeckLink frame rates
+
+const uint64_t	kCaptureFileMagic			= 0x5254504143444D42ULL;	// "BMDCAPTR"
+const uint32_t	kCaptureFileRecordMagic		= 0x44434552;				// "RECD"
+const uint32_t	kCaptureFileTrailerMagic	= 0x58444E49;				// "INDX"
+
+enum CaptureFileRecordType
+{
+	kCaptureFileRecordVideo		= 1,
+	kCaptureFileRecordAudio		= 2
+};
+
+enum CaptureFileRecordFlags
+{
+	kCaptureFileHasTimecode					= 1 << 0,
+	kCaptureFileHasHardwareReferenceTime	= 1 << 1,
+	kCaptureFileHasRightEye					= 1 << 2
+};
+
+struct CaptureFileHeader
+{
+	uint64_t	magic;
+	uint32_t	version;
+	uint32_t	alignment;
+	uint32_t	timeScale;				// Of all times and durations in the file
+	uint32_t	audioSampleRate;
+	uint32_t	audioChannelCount;
+	uint32_t	audioSampleDepth;
+};
+
+struct CaptureFileRecord
+{
+	uint32_t	magic;
+	uint32_t	type;					// CaptureFileRecordType
+	uint64_t	number;					// Video frame or audio packet number, from 0
+	uint64_t	recordSize;				// Including this block and payload padding
+	uint64_t	payloadSize;
+	uint32_t	recordFlags;			// CaptureFileRecordFlags
+	uint32_t	frameFlags;				// BMDFrameFlags
+	int64_t		streamTime;				// Video stream time or audio packet time
+	int64_t		streamDuration;
+	int64_t		hardwareReferenceTime;
+	int64_t		hardwareReferenceDuration;
+	// Video
+	uint32_t	pixelFormat;			// BMDPixelFormat
+	uint32_t	width;
+	uint32_t	height;
+	uint32_t	rowBytes;
+	uint64_t	rightEyeOffset;			// Of the right eye image within the payload, when kCaptureFileHasRightEye
+	uint32_t	timecodeBCD;			// BMDTimecodeBCD, when kCaptureFileHasTimecode
+	uint32_t	timecodeFlags;			// BMDTimecodeFlags
+	// Audio
+	uint32_t	sampleFrameCount;
+	uint32_t	reserved;
+};
+
+struct CaptureFileIndexEntry
+{
+	uint64_t	offset;					// Of the record header
+	int64_t		streamTime;
+	uint32_t	type;
+	uint32_t	recordFlags;
+	uint32_t	timecodeBCD;
+	uint32_t	timecodeFlags;
+};
+
+struct CaptureFileTrailer
+{
+	uint32_t	magic;
+	uint32_t	version;
+	uint64_t	indexOffset;
+	uint64_t	indexCount;
+	uint64_t	videoFrameCount;
+	uint64_t	audioPacketCount;
+};
+
+static inline uint64_t CaptureFileAlign(uint64_t size)
+{
+	return (size + kCaptureFileAlignment - 1) & ~(uint64_t)(kCaptureFileAlignment - 1);
+}
+
+#endif
@@ -0,0 +1,238 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "DeckLinkAPI.h"
+#include "CaptureFileReader.h"
+
+static inline uint64_t TimecodeKey(uint32_t timecodeBCD, bool fieldMark)
+{
+	return ((uint64_t)fieldMark << 32) | timecodeBCD;
+}
+
+CaptureFileReader::CaptureFileReader() :
+	m_fd(-1),
+	m_base(NULL),
+	m_size(0),
+	m_recovered(false)
+{
+}
+
+CaptureFileReader::~CaptureFileReader()
+{
+	Close();
+}
+
+bool CaptureFileReader::Open(const char* filename)
+{
+	struct stat			fileStat;
+	void*				base;
+
+	Close();
+
+	m_fd = open(filename, O_RDONLY);
+	if (m_fd < 0)
+		return false;
+
+	if (fstat(m_fd, &fileStat) != 0 || (uint64_t)fileStat.st_size < kCaptureFileAlignment)
+		goto bail;
+
+	m_size = fileStat.st_size;
+
+	base = mmap(NULL, m_size, PROT_READ, MAP_SHARED, m_fd, 0);
+	if (base == MAP_FAILED)
+		goto bail;
+
+	m_base = (const uint8_t*)base;
+
+	if (GetHeader()->magic != kCaptureFileMagic || GetHeader()->version > kCaptureFileVersion || GetHeader()->alignment != kCaptureFileAlignment)
+	{
+		fprintf(stderr, "%s is not a capture file\n", filename);
+		goto bail;
+	}
+
+	if (!LoadIndex())
+	{
+		m_recovered = true;
+		if (!RecoverIndex())
+			goto bail;
+	}
+
+	return true;
+
+bail:
+	Close();
+	return false;
+}
+
+void CaptureFileReader::Close()
+{
+	if (m_base != NULL)
+		munmap((void*)m_base, m_size);
+
+	if (m_fd >= 0)
+		close(m_fd);
+
+	m_fd = -1;
+	m_base = NULL;
+	m_size = 0;
+	m_recovered = false;
+	m_videoOffsets.clear();
+	m_audioOffsets.clear();
+	m_timecodeFrames.clear();
+}
+
+bool CaptureFileReader::GetVideoFrame(uint64_t frameNumber, CaptureFileFrame* frame) const
+{
+	if (frameNumber >= m_videoOffsets.size())
+		return false;
+
+	return GetRecord(m_videoOffsets[frameNumber], frame);
+}
+
+bool CaptureFileReader::GetAudioPacket(uint64_t packetNumber, CaptureFileFrame* packet) const
+{
+	if (packetNumber >= m_audioOffsets.size())
+		return false;
+
+	return GetRecord(m_audioOffsets[packetNumber], packet);
+}
+
+bool CaptureFileReader::FindVideoFrame(uint32_t timecodeBCD, bool fieldMark, uint64_t* frameNumber) const
+{
+	std::unordered_map<uint64_t, uint64_t>::const_iterator iter = m_timecodeFrames.find(TimecodeKey(timecodeBCD, fieldMark));
+
+	if (iter == m_timecodeFrames.end())
+		return false;
+
+	*frameNumber = iter->second;
+	return true;
+}
+
+bool CaptureFileReader::LoadIndex()
+{
+	const CaptureFileTrailer*		trailer = (const CaptureFileTrailer*)(m_base + m_size - kCaptureFileAlignment);
+	const CaptureFileIndexEntry*	entries;
+
+	if (m_size % kCaptureFileAlignment != 0 || m_size < 2 * kCaptureFileAlignment || trailer->magic != kCaptureFileTrailerMagic)
+		return false;
+
+	if (trailer->indexOffset < kCaptureFileAlignment || trailer->indexOffset > m_size - kCaptureFileAlignment ||
+		trailer->indexCount > (m_size - trailer->indexOffset) / sizeof(CaptureFileIndexEntry))
+		return false;
+
+	entries = (const CaptureFileIndexEntry*)(m_base + trailer->indexOffset);
+
+	m_videoOffsets.reserve(trailer->videoFrameCount);
+	m_audioOffsets.reserve(trailer->audioPacketCount);
+
+	for (uint64_t i = 0; i < trailer->indexCount; i++)
+		AddRecord(entries[i].offset, entries[i].type, entries[i].recordFlags, entries[i].timecodeBCD, entries[i].timecodeFlags);
+
+	return true;
+}
+
+bool CaptureFileReader::RecoverIndex()
+{
+	uint64_t offset = kCaptureFileAlignment;
+
+	// Walk the records until the first that is incomplete or is not a record (the index)
+	while (offset + kCaptureFileAlignment <= m_size)
+	{
+		const CaptureFileRecord* record = (const CaptureFileRecord*)(m_base + offset);
+
+		if (record->magic != kCaptureFileRecordMagic || record->recordSize < kCaptureFileAlignment ||
+			record->recordSize % kCaptureFileAlignment != 0 || record->recordSize > m_size - offset)
+			break;
+
+		AddRecord(offset, record->type, record->recordFlags, record->timecodeBCD, record->timecodeFlags);
+		offset += record->recordSize;
+	}
+
+	fprintf(stderr, "Recovered %llu video frames and %llu audio packets from capture file without an index\n",
+		(unsigned long long)m_videoOffsets.size(), (unsigned long long)m_audioOffsets.size());
+
+	return offset > kCaptureFileAlignment;
+}
+
+void CaptureFileReader::AddRecord(uint64_t offset, uint32_t type, uint32_t recordFlags, uint32_t timecodeBCD, uint32_t timecodeFlags)
+{
+	if (type == kCaptureFileRecordAudio)
+	{
+		m_audioOffsets.push_back(offset);
+		return;
+	}
+
+	if (type != kCaptureFileRecordVideo)
+		return;
+
+	if (recordFlags & kCaptureFileHasTimecode)
+		m_timecodeFrames.insert(std::make_pair(TimecodeKey(timecodeBCD, (timecodeFlags & bmdTimecodeFieldMark) != 0), (uint64_t)m_videoOffsets.size()));
+
+	m_videoOffsets.push_back(offset);
+}
+
+bool CaptureFileReader::GetRecord(uint64_t offset, CaptureFileFrame* frame) const
+{
+	const CaptureFileRecord* record;
+
+	// Records are validated when they are accessed, so opening a file does not read every record header
+	if (offset < kCaptureFileAlignment || offset % kCaptureFileAlignment != 0 || offset > m_size - kCaptureFileAlignment)
+		return false;
+
+	record = (const CaptureFileRecord*)(m_base + offset);
+	if (record->magic != kCaptureFileRecordMagic || record->payloadSize > m_size - offset - kCaptureFileAlignment)
+		return false;
+
+	frame->record = record;
+	frame->bytes = m_base + offset + kCaptureFileAlignment;
+	frame->rightEyeBytes = NULL;
+
+	if ((record->recordFlags & kCaptureFileHasRightEye) && record->rightEyeOffset < record->payloadSize)
+		frame->rightEyeBytes = frame->bytes + record->rightEyeOffset;
+
+	return true;
+}
@@ -0,0 +1,97 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#ifndef __CAPTURE_FILE_READER_H__
+#define __CAPTURE_FILE_READER_H__
+
+#include <stdint.h>
+#include <unordered_map>
+#include <vector>
+#include "CaptureFileFormat.h"
+
+struct CaptureFileFrame
+{
+	const CaptureFileRecord*	record;
+	const uint8_t*				bytes;				// Payload, aligned to kCaptureFileAlignment
+	const uint8_t*				rightEyeBytes;		// NULL unless the record has a right eye image
+};
+
+// Random access to the records of a capture file written by CaptureFileWriter.  The file is mapped
+// read-only and the index is loaded when it is opened, so looking up a frame by number or timecode
+// is constant time and only the pages of the frames that are accessed are read from disk.
+//
+// A file without an index, left by an interrupted capture, is recovered by walking the record
+// headers up to the last complete record.
+class CaptureFileReader
+{
+public:
+	CaptureFileReader();
+	virtual ~CaptureFileReader();
+
+	bool	Open(const char* filename);
+	void	Close();
+
+	const CaptureFileHeader*	GetHeader() const				{ return (const CaptureFileHeader*)m_base; }
+	bool						IsRecovered() const				{ return m_recovered; }
+	uint64_t					GetVideoFrameCount() const		{ return m_videoOffsets.size(); }
+	uint64_t					GetAudioPacketCount() const		{ return m_audioOffsets.size(); }
+
+	bool	GetVideoFrame(uint64_t frameNumber, CaptureFileFrame* frame) const;
+	bool	GetAudioPacket(uint64_t packetNumber, CaptureFileFrame* packet) const;
+
+	// Finds the first frame with a timecode; the field mark distinguishes frame pairs at high frame rates
+	bool	FindVideoFrame(uint32_t timecodeBCD, bool fieldMark, uint64_t* frameNumber) const;
+
+private:
+	int										m_fd;
+	const uint8_t*							m_base;
+	uint64_t								m_size;
+	bool									m_recovered;
+	std::vector<uint64_t>					m_videoOffsets;
+	std::vector<uint64_t>					m_audioOffsets;
+	std::unordered_map<uint64_t, uint64_t>	m_timecodeFrames;
+
+	bool	LoadIndex();
+	bool	RecoverIndex();
+	void	AddRecord(uint64_t offset, uint32_t type, uint32_t recordFlags, uint32_t timecodeBCD, uint32_t timecodeFlags);
+	bool	GetRecord(uint64_t offset, CaptureFileFrame* frame) const;
+};
+
+#endif
@@ -0,0 +1,309 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "CaptureFileWriter.h"
+
+// Reference counted, block aligned buffer for the headers and index written alongside frames
+class CaptureFileBlock : public IUnknown
+{
+public:
+	static CaptureFileBlock* Create(uint32_t size)
+	{
+		void* bytes;
+
+		if (posix_memalign(&bytes, kCaptureFileAlignment, size) != 0)
+			return NULL;
+
+		memset(bytes, 0, size);
+		return new CaptureFileBlock(bytes);
+	}
+
+	virtual HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, LPVOID *ppv) { return E_NOINTERFACE; }
+
+	virtual ULONG STDMETHODCALLTYPE AddRef(void)
+	{
+		return __sync_add_and_fetch(&m_refCount, 1);
+	}
+
+	virtual ULONG STDMETHODCALLTYPE Release(void)
+	{
+		int32_t newRefValue = __sync_sub_and_fetch(&m_refCount, 1);
+		if (newRefValue == 0)
+		{
+			delete this;
+			return 0;
+		}
+		return newRefValue;
+	}
+
+	void* GetBytes() { return m_bytes; }
+
+private:
+	CaptureFileBlock(void* bytes) : m_refCount(1), m_bytes(bytes) { }
+	virtual ~CaptureFileBlock() { free(m_bytes); }
+
+	int32_t		m_refCount;
+	void*		m_bytes;
+};
+
+CaptureFileWriter::CaptureFileWriter() :
+	m_open(false),
+	m_offset(0),
+	m_videoFrameCount(0),
+	m_audioPacketCount(0),
+	m_audioChannelCount(0),
+	m_audioSampleDepth(0)
+{
+}
+
+CaptureFileWriter::~CaptureFileWriter()
+{
+	Close();
+}
+
+bool CaptureFileWriter::Open(const char* filename, uint32_t queueDepth, bool directIO, uint64_t preallocateBytes, uint32_t audioChannelCount, uint32_t audioSampleDepth)
+{
+	CaptureFileHeader header;
+
+	if (m_open || !m_writer.Open(filename, queueDepth, directIO, preallocateBytes))
+		return false;
+
+	m_open = true;
+	m_offset = 0;
+	m_videoFrameCount = 0;
+	m_audioPacketCount = 0;
+	m_audioChannelCount = audioChannelCount;
+	m_audioSampleDepth = audioSampleDepth;
+	m_index.clear();
+
+	memset(&header, 0, sizeof(header));
+	header.magic = kCaptureFileMagic;
+	header.version = kCaptureFileVersion;
+	header.alignment = kCaptureFileAlignment;
+	header.timeScale = kCaptureFileTimeScale;
+	header.audioSampleRate = bmdAudioSampleRate48kHz;
+	header.audioChannelCount = audioChannelCount;
+	header.audioSampleDepth = audioSampleDepth;
+
+	return WriteBlock(&header, sizeof(header));
+}
+
+bool CaptureFileWriter::WriteVideoFrame(IDeckLinkVideoInputFrame* videoFrame, IDeckLinkVideoFrame* rightEyeFrame, BMDTimecodeFormat timecodeFormat)
+{
+	CaptureFileRecord	record;
+	IDeckLinkTimecode*	timecode = NULL;
+	void*				frameBytes;
+	uint64_t			imageSize;
+
+	if (!m_open)
+		return false;
+
+	imageSize = (uint64_t)videoFrame->GetRowBytes() * videoFrame->GetHeight();
+
+	memset(&record, 0, sizeof(record));
+	record.magic = kCaptureFileRecordMagic;
+	record.type = kCaptureFileRecordVideo;
+	record.number = m_videoFrameCount;
+	record.frameFlags = videoFrame->GetFlags();
+	record.pixelFormat = videoFrame->GetPixelFormat();
+	record.width = videoFrame->GetWidth();
+	record.height = videoFrame->GetHeight();
+	record.rowBytes = videoFrame->GetRowBytes();
+	record.payloadSize = imageSize;
+
+	videoFrame->GetStreamTime(&record.streamTime, &record.streamDuration, kCaptureFileTimeScale);
+
+	if (videoFrame->GetHardwareReferenceTimestamp(kCaptureFileTimeScale, &record.hardwareReferenceTime, &record.hardwareReferenceDuration) == S_OK)
+		record.recordFlags |= kCaptureFileHasHardwareReferenceTime;
+
+	// Record the requested timecode, or RP188 when none was requested
+	if (videoFrame->GetTimecode(timecodeFormat ? timecodeFormat : bmdTimecodeRP188Any, &timecode) == S_OK && timecode != NULL)
+	{
+		record.timecodeBCD = timecode->GetBCD();
+		record.timecodeFlags = timecode->GetFlags();
+		record.recordFlags |= kCaptureFileHasTimecode;
+		timecode->Release();
+	}
+
+	if (rightEyeFrame != NULL)
+	{
+		record.rightEyeOffset = CaptureFileAlign(imageSize);
+		record.payloadSize = record.rightEyeOffset + imageSize;
+		record.recordFlags |= kCaptureFileHasRightEye;
+	}
+
+	record.recordSize = kCaptureFileAlignment + CaptureFileAlign(record.payloadSize);
+
+	AddIndexEntry(&record);
+	m_videoFrameCount++;
+
+	if (!WriteBlock(&record, sizeof(record)))
+		return false;
+
+	videoFrame->GetBytes(&frameBytes);
+	if (!WritePayload(videoFrame, frameBytes, imageSize))
+		return false;
+
+	if (rightEyeFrame != NULL)
+	{
+		rightEyeFrame->GetBytes(&frameBytes);
+		if (!WritePayload(rightEyeFrame, frameBytes, imageSize))
+			return false;
+	}
+
+	return true;
+}
+
+bool CaptureFileWriter::WriteAudioPacket(IDeckLinkAudioInputPacket* audioPacket)
+{
+	CaptureFileRecord	record;
+	CaptureFileBlock*	block;
+	void*				audioBytes;
+	bool				result;
+
+	if (!m_open)
+		return false;
+
+	memset(&record, 0, sizeof(record));
+	record.magic = kCaptureFileRecordMagic;
+	record.type = kCaptureFileRecordAudio;
+	record.number = m_audioPacketCount;
+	record.sampleFrameCount = audioPacket->GetSampleFrameCount();
+	record.payloadSize = (uint64_t)record.sampleFrameCount * m_audioChannelCount * (m_audioSampleDepth / 8);
+	record.recordSize = kCaptureFileAlignment + CaptureFileAlign(record.payloadSize);
+
+	audioPacket->GetPacketTime(&record.streamTime, kCaptureFileTimeScale);
+	record.streamDuration = (int64_t)record.sampleFrameCount * kCaptureFileTimeScale / bmdAudioSampleRate48kHz;
+
+	AddIndexEntry(&record);
+	m_audioPacketCount++;
+
+	// Audio packets are small, so they are copied in after the record header and written in a single
+	// aligned block, which keeps the following writes eligible for direct I/O
+	block = CaptureFileBlock::Create(record.recordSize);
+	if (block == NULL)
+		return false;
+
+	audioPacket->GetBytes(&audioBytes);
+	memcpy(block->GetBytes(), &record, sizeof(record));
+	memcpy((uint8_t*)block->GetBytes() + kCaptureFileAlignment, audioBytes, record.payloadSize);
+
+	result = m_writer.Write(block, block->GetBytes(), record.recordSize);
+	block->Release();
+
+	m_offset += record.recordSize;
+	return result;
+}
+
+void CaptureFileWriter::Close()
+{
+	CaptureFileTrailer trailer;
+
+	if (!m_open)
+		return;
+
+	memset(&trailer, 0, sizeof(trailer));
+	trailer.magic = kCaptureFileTrailerMagic;
+	trailer.version = kCaptureFileVersion;
+	trailer.indexOffset = m_offset;
+	trailer.indexCount = m_index.size();
+	trailer.videoFrameCount = m_videoFrameCount;
+	trailer.audioPacketCount = m_audioPacketCount;
+
+	if (!m_index.empty())
+		WriteBlock(m_index.data(), m_index.size() * sizeof(CaptureFileIndexEntry));
+
+	WriteBlock(&trailer, sizeof(trailer));
+
+	m_writer.Close();
+	m_open = false;
+}
+
+bool CaptureFileWriter::WriteBlock(const void* bytes, uint32_t size)
+{
+	uint32_t			blockSize = CaptureFileAlign(size);
+	CaptureFileBlock*	block = CaptureFileBlock::Create(blockSize);
+	bool				result;
+
+	if (block == NULL)
+		return false;
+
+	memcpy(block->GetBytes(), bytes, size);
+
+	result = m_writer.Write(block, block->GetBytes(), blockSize);
+	block->Release();
+
+	m_offset += blockSize;
+	return result;
+}
+
+bool CaptureFileWriter::WritePayload(IUnknown* owner, const void* bytes, uint32_t size)
+{
+	// The payload is written in place up to its last whole block, and the remainder is copied into a
+	// zero padded block, so both writes keep the length and file offset aligned for direct I/O
+	uint32_t alignedSize = size & ~(kCaptureFileAlignment - 1);
+	uint32_t remainderSize = size - alignedSize;
+
+	m_offset += alignedSize;
+
+	if (alignedSize > 0 && !m_writer.Write(owner, bytes, alignedSize))
+		return false;
+
+	return (remainderSize == 0) || WriteBlock((const uint8_t*)bytes + alignedSize, remainderSize);
+}
+
+void CaptureFileWriter::AddIndexEntry(const CaptureFileRecord* record)
+{
+	CaptureFileIndexEntry entry;
+
+	memset(&entry, 0, sizeof(entry));
+	entry.offset = m_offset;
+	entry.streamTime = record->streamTime;
+	entry.type = record->type;
+	entry.recordFlags = record->recordFlags;
+	entry.timecodeBCD = record->timecodeBCD;
+	entry.timecodeFlags = record->timecodeFlags;
+
+	m_index.push_back(entry);
+}
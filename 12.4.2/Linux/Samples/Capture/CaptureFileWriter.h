@@ -0,0 +1,84 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#ifndef __CAPTURE_FILE_WRITER_H__
+#define __CAPTURE_FILE_WRITER_H__
+
+#include <vector>
+#include "DeckLinkAPI.h"
+#include "AsyncFileWriter.h"
+#include "CaptureFileFormat.h"
+
+// Writes video frames and audio packets to an indexed capture file (see CaptureFileFormat.h).
+// Record headers are written alongside the frame payloads through an AsyncFileWriter, so frames
+// are not copied other than the part of their last block, and the index and trailer are appended
+// when the file is closed.
+//
+// WriteVideoFrame() and WriteAudioPacket() must be called from a single thread, as they are from
+// the input callback.
+class CaptureFileWriter
+{
+public:
+	CaptureFileWriter();
+	virtual ~CaptureFileWriter();
+
+	bool	Open(const char* filename, uint32_t queueDepth, bool directIO, uint64_t preallocateBytes, uint32_t audioChannelCount, uint32_t audioSampleDepth);
+	bool	WriteVideoFrame(IDeckLinkVideoInputFrame* videoFrame, IDeckLinkVideoFrame* rightEyeFrame, BMDTimecodeFormat timecodeFormat);
+	bool	WriteAudioPacket(IDeckLinkAudioInputPacket* audioPacket);
+	void	Close();
+
+	void	GetStatistics(AsyncFileWriterStatistics* statistics)	{ m_writer.GetStatistics(statistics); }
+
+private:
+	AsyncFileWriter						m_writer;
+	bool								m_open;
+	uint64_t							m_offset;
+	uint64_t							m_videoFrameCount;
+	uint64_t							m_audioPacketCount;
+	uint32_t							m_audioChannelCount;
+	uint32_t							m_audioSampleDepth;
+	std::vector<CaptureFileIndexEntry>	m_index;
+
+	bool	WriteBlock(const void* bytes, uint32_t size);
+	bool	WritePayload(IUnknown* owner, const void* bytes, uint32_t size);
+	void	AddIndexEntry(const CaptureFileRecord* record);
+};
+
+#endif
@@ -0,0 +1,260 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+#include "DeckLinkAPI.h"
+#include "CaptureFileReader.h"
+
+static void DisplayUsage(int status)
+{
+	fprintf(stderr,
+		"Usage: CaptureReader -i <filename> [OPTIONS]\n"
+		"\n"
+		"    -i <filename>        Capture file written by Capture -o\n"
+		"    -l                   List video frames\n"
+		"    -f <frame>           First video frame to extract (default is 0)\n"
+		"    -t <hh:mm:ss:ff>     First video frame to extract, by timecode (append '.' for the second field)\n"
+		"    -n <frames>          Number of video frames to extract (default is 1)\n"
+		"    -v <filename>        Filename raw video of the extracted frames will be written to\n"
+		"\n"
+		"Show, list or extract frames from an indexed capture file eg:\n"
+		"\n"
+		"    CaptureReader -i capture.dlc -t 01:00:10:00 -n 50 -v video.raw\n"
+	);
+
+	exit(status);
+}
+
+static bool ParseTimecode(const char* string, uint32_t* timecodeBCD, bool* fieldMark)
+{
+	unsigned int	components[4];
+	char			separator = '\0';
+
+	if (sscanf(string, "%u:%u:%u%*[:;]%u%c", &components[0], &components[1], &components[2], &components[3], &separator) < 4)
+		return false;
+
+	*timecodeBCD = 0;
+	for (int i = 0; i < 4; i++)
+	{
+		if (components[i] > 99)
+			return false;
+		*timecodeBCD = (*timecodeBCD << 8) | ((components[i] / 10) << 4) | (components[i] % 10);
+	}
+
+	*fieldMark = (separator == '.');
+	return true;
+}
+
+static void FormatTimecode(const CaptureFileRecord* record, char* string, size_t size)
+{
+	uint32_t bcd = record->timecodeBCD;
+
+	if (!(record->recordFlags & kCaptureFileHasTimecode))
+	{
+		snprintf(string, size, "No timecode");
+		return;
+	}
+
+	snprintf(string, size, "%02x:%02x:%02x%c%02x%s",
+		(bcd >> 24) & 0xff,
+		(bcd >> 16) & 0xff,
+		(bcd >> 8) & 0xff,
+		(record->timecodeFlags & bmdTimecodeIsDropFrame) ? ';' : ':',
+		bcd & 0xff,
+		(record->timecodeFlags & bmdTimecodeFieldMark) ? "." : ""
+	);
+}
+
+static void DisplayFrame(uint64_t frameNumber, const CaptureFileFrame* frame, uint32_t timeScale)
+{
+	char				timecodeString[32];
+	const CaptureFileRecord* record = frame->record;
+
+	FormatTimecode(record, timecodeString, sizeof(timecodeString));
+
+	printf("Frame #%llu [%s] - Stream time: %.3f s - %c%c%c%c %ux%u%s%s\n",
+		(unsigned long long)frameNumber,
+		timecodeString,
+		(double)record->streamTime / timeScale,
+		(char)(record->pixelFormat >> 24), (char)(record->pixelFormat >> 16), (char)(record->pixelFormat >> 8), (char)record->pixelFormat,
+		record->width,
+		record->height,
+		(record->recordFlags & kCaptureFileHasRightEye) ? " 3D" : "",
+		(record->frameFlags & bmdFrameHasNoInputSource) ? " - No input signal" : ""
+	);
+}
+
+int main(int argc, char *argv[])
+{
+	CaptureFileReader	reader;
+	CaptureFileFrame	frame;
+	const char*			inputFile = NULL;
+	const char*			videoOutputFile = NULL;
+	bool				listFrames = false;
+	uint64_t			firstFrame = 0;
+	uint64_t			frameCount = 1;
+	uint32_t			timecodeBCD = 0;
+	bool				fieldMark = false;
+	bool				findTimecode = false;
+	int					videoFile = -1;
+	int					exitStatus = 1;
+	int					ch;
+
+	while ((ch = getopt(argc, argv, "?hi:lf:t:n:v:")) != -1)
+	{
+		switch (ch)
+		{
+			case 'i':
+				inputFile = optarg;
+				break;
+
+			case 'l':
+				listFrames = true;
+				break;
+
+			case 'f':
+				firstFrame = strtoull(optarg, NULL, 10);
+				break;
+
+			case 't':
+				if (!ParseTimecode(optarg, &timecodeBCD, &fieldMark))
+				{
+					fprintf(stderr, "Invalid argument: Timecode \"%s\" is invalid\n", optarg);
+					DisplayUsage(1);
+				}
+				findTimecode = true;
+				break;
+
+			case 'n':
+				frameCount = strtoull(optarg, NULL, 10);
+				break;
+
+			case 'v':
+				videoOutputFile = optarg;
+				break;
+
+			case '?':
+			case 'h':
+				DisplayUsage(0);
+		}
+	}
+
+	if (inputFile == NULL)
+	{
+		fprintf(stderr, "You must select a capture file\n");
+		DisplayUsage(1);
+	}
+
+	if (!reader.Open(inputFile))
+	{
+		fprintf(stderr, "Could not open capture file \"%s\"\n", inputFile);
+		goto bail;
+	}
+
+	fprintf(stderr, "%s: %llu video frames, %llu audio packets (%u channels, %u bit)%s\n",
+		inputFile,
+		(unsigned long long)reader.GetVideoFrameCount(),
+		(unsigned long long)reader.GetAudioPacketCount(),
+		reader.GetHeader()->audioChannelCount,
+		reader.GetHeader()->audioSampleDepth,
+		reader.IsRecovered() ? ", recovered" : ""
+	);
+
+	if (listFrames)
+	{
+		for (uint64_t i = 0; i < reader.GetVideoFrameCount(); i++)
+		{
+			if (reader.GetVideoFrame(i, &frame))
+				DisplayFrame(i, &frame, reader.GetHeader()->timeScale);
+		}
+	}
+
+	if (findTimecode && !reader.FindVideoFrame(timecodeBCD, fieldMark, &firstFrame))
+	{
+		fprintf(stderr, "No frame with the requested timecode\n");
+		goto bail;
+	}
+
+	if (videoOutputFile != NULL)
+	{
+		videoFile = open(videoOutputFile, O_WRONLY|O_CREAT|O_TRUNC, 0664);
+		if (videoFile < 0)
+		{
+			fprintf(stderr, "Could not open video output file \"%s\"\n", videoOutputFile);
+			goto bail;
+		}
+
+		// Frames are written straight from the mapping, so only the pages of extracted frames are read
+		for (uint64_t i = firstFrame; i < firstFrame + frameCount && i < reader.GetVideoFrameCount(); i++)
+		{
+			if (!reader.GetVideoFrame(i, &frame))
+			{
+				fprintf(stderr, "Frame #%llu is invalid\n", (unsigned long long)i);
+				goto bail;
+			}
+
+			DisplayFrame(i, &frame, reader.GetHeader()->timeScale);
+
+			if (write(videoFile, frame.bytes, (size_t)frame.record->rowBytes * frame.record->height) < 0 ||
+				(frame.rightEyeBytes != NULL && write(videoFile, frame.rightEyeBytes, (size_t)frame.record->rowBytes * frame.record->height) < 0))
+			{
+				fprintf(stderr, "Could not write video output file \"%s\"\n", videoOutputFile);
+				goto bail;
+			}
+		}
+	}
+	else if (findTimecode && reader.GetVideoFrame(firstFrame, &frame))
+	{
+		DisplayFrame(firstFrame, &frame, reader.GetHeader()->timeScale);
+	}
+
+	exitStatus = 0;
+
+bail:
+	if (videoFile >= 0)
+		close(videoFile);
+
+	return exitStatus;
+}
@@ -51,11 +51,18 @@ BMDConfig::BMDConfig() :
 	m_audioChannels(2),
 	m_audioSampleDepth(16),
 	m_maxFrames(-1),
+	m_frameBufferCount(0),
+	m_numaNode(-1),
 	m_inputFlags(bmdVideoInputFlagDefault),
 	m_pixelFormat(bmdFormat8BitYUV),
 	m_timecodeFormat(),
 	m_videoOutputFile(),
 	m_audioOutputFile(),
+	m_captureOutputFile(),
+	m_writeQueueDepth(16),
+	m_directIO(false),
+	m_preallocateSize(0),
+	m_watermark(false),
 	m_deckLinkName(),
 	m_displayModeName()
 {
@@ -75,7 +82,7 @@ bool BMDConfig::ParseArguments(int argc,  char** argv)
 	int		ch;
 	bool	displayHelp = false;
 
-	while ((ch = getopt(argc, argv, "d:?h3c:s:v:a:m:n:p:t:")) != -1)
+	while ((ch = getopt(argc, argv, "d:?h3c:s:v:a:o:m:n:p:t:b:u:DP:Q:w")) != -1)
 	{
 		switch (ch)
 		{
@@ -115,20 +122,54 @@ bool BMDConfig::ParseArguments(int argc,  char** argv)
 				m_audioOutputFile = optarg;
 				break;
 
+			case 'o':
+				m_captureOutputFile = optarg;
+				break;
+
+			case 'D':
+				m_directIO = true;
+				break;
+
+			case 'P':
+				m_preallocateSize = strtoull(optarg, NULL, 10) * 1024 * 1024;
+				break;
+
+			case 'Q':
+				m_writeQueueDepth = atoi(optarg);
+				if (m_writeQueueDepth <= 0)
+				{
+					fprintf(stderr, "Invalid argument: Write queue depth must be greater than 0\n");
+					return false;
+				}
+				break;
+
 			case 'n':
 				m_maxFrames = atoi(optarg);
 				break;
 
+			case 'b':
+				m_frameBufferCount = atoi(optarg);
+				break;
+
+			case 'u':
+				m_numaNode = atoi(optarg);
+				break;
+
 			case '3':
 				m_inputFlags |= bmdVideoInputDualStream3D;
 				break;
 
+			case 'w':
+				m_watermark = true;
+				break;
+
 			case 'p':
 				switch(atoi(optarg))
 				{
 					case 0: m_pixelFormat = bmdFormat8BitYUV; break;
 					case 1: m_pixelFormat = bmdFormat10BitYUV; break;
 					case 2: m_pixelFormat = bmdFormat10BitRGB; break;
+					case 3: m_pixelFormat = bmdFormat12BitRGB; break;
 					default:
 						fprintf(stderr, "Invalid argument: Pixel format %d is not valid", atoi(optarg));
 						return false;
@@ -438,16 +479,26 @@ bail:
 		"         0:  8 bit YUV (4:2:2) (default)\n"
 		"         1:  10 bit YUV (4:2:2)\n"
 		"         2:  10 bit RGB (4:4:4)\n"
+		"         3:  12 bit RGB (4:4:4)\n"
 		"    -t <format>          Print timecode\n"
 		"         rp188:  RP 188\n"
 		"         vitc:   VITC\n"
 		"         serial: Serial Timecode\n"
 		"    -v <filename>        Filename raw video will be written to\n"
 		"    -a <filename>        Filename raw audio will be written to\n"
+		"    -o <filename>        Filename indexed video and audio will be written to, readable with CaptureReader\n"
+		"    -D                   Write video and indexed files with direct I/O (O_DIRECT), bypassing the page cache\n"
+		"    -P <megabytes>       Preallocate space for the video and indexed files\n"
+		"    -Q <depth>           Number of writes queued to each file before capture waits (default is 16)\n"
 		"    -c <channels>        Audio Channels (2, 8 or 16 - default is 2)\n"
 		"    -s <depth>           Audio Sample Depth (16 or 32 - default is 16)\n"
 		"    -n <frames>          Number of frames to capture (default is unlimited)\n"
 		"    -3                   Capture Stereoscopic 3D (Requires 3D Hardware support)\n"
+		"    -b <buffers>         Capture into a pool of <buffers> pre-allocated frame buffers, backed by\n"
+		"                         hugepages where available and locked into memory (default is driver allocator)\n"
+		"    -u <node>            NUMA node for pooled frame buffers (default is the node nearest the device)\n"
+		"    -w                   Check the frame watermark stamped by TestPattern -w, reporting dropped, repeated,\n"
+		"                         reordered and corrupted frames and glass-to-glass latency\n"
 		"\n"
 		"Capture video and/or audio to a file. Raw video and/or audio can be viewed with mplayer eg:\n"
 		"\n"
@@ -488,6 +539,18 @@ void BMDConfig::DisplayConfiguration()
 		m_audioChannels,
 		m_audioSampleDepth
 	);
+
+	if (m_frameBufferCount > 0)
+		fprintf(stderr, " - Frame buffer pool: %d buffers\n", m_frameBufferCount);
+
+	if (m_videoOutputFile != NULL)
+		fprintf(stderr, " - Video file: %s%s\n", m_videoOutputFile, m_directIO ? " (direct I/O)" : "");
+
+	if (m_captureOutputFile != NULL)
+		fprintf(stderr, " - Indexed file: %s%s\n", m_captureOutputFile, m_directIO ? " (direct I/O)" : "");
+
+	if (m_watermark)
+		fprintf(stderr, " - Watermark check\n");
 }
 
 const char* BMDConfig::GetPixelFormatName(BMDPixelFormat pixelFormat)
@@ -500,6 +563,8 @@ const char* BMDConfig::GetPixelFormatName(BMDPixelFormat pixelFormat)
 			return "10 bit YUV (4:2:2)";
 		case bmdFormat10BitRGB:
 			return "10 bit RGB (4:4:4)";
+		case bmdFormat12BitRGB:
+			return "12 bit RGB (4:4:4)";
 	}
 	return "unknown";
 }
@@ -61,12 +61,22 @@ public:
 
 	int						m_maxFrames;
 
+	int						m_frameBufferCount;
+	int						m_numaNode;
+
 	BMDVideoInputFlags		m_inputFlags;
 	BMDPixelFormat			m_pixelFormat;
 	BMDTimecodeFormat		m_timecodeFormat;
 
 	const char*				m_videoOutputFile;
 	const char*				m_audioOutputFile;
+	const char*				m_captureOutputFile;
+
+	int						m_writeQueueDepth;
+	bool					m_directIO;
+	uint64_t				m_preallocateSize;
+
+	bool					m_watermark;
 
 	IDeckLink* GetSelectedDeckLink(void);
 	IDeckLinkDisplayMode* GetSelectedDeckLinkDisplayMode(IDeckLink* deckLink);
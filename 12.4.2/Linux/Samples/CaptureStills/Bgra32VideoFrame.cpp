@@ -101,3 +101,46 @@ ULONG STDMETHODCALLTYPE Bgra32VideoFrame::Release(void)
 
 	return newRefValue;
 }
+
+/* Bgra32VideoFramePool class */
+
+Bgra32VideoFramePool::~Bgra32VideoFramePool()
+{
+	while (!m_freeFrames.empty())
+	{
+		m_freeFrames.back()->Release();
+		m_freeFrames.pop_back();
+	}
+}
+
+Bgra32VideoFrame* Bgra32VideoFramePool::AcquireFrame(long width, long height, BMDFrameFlags flags)
+{
+	Bgra32VideoFrame* frame = NULL;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		while (!m_freeFrames.empty() && (frame == NULL))
+		{
+			frame = m_freeFrames.back();
+			m_freeFrames.pop_back();
+
+			if ((frame->GetWidth() != width) || (frame->GetHeight() != height))
+			{
+				frame->Release();
+				frame = NULL;
+			}
+		}
+	}
+
+	if (frame == NULL)
+		return new Bgra32VideoFrame(width, height, flags);
+
+	frame->SetFlags(flags);
+	return frame;
+}
+
+void Bgra32VideoFramePool::ReturnFrame(Bgra32VideoFrame* frame)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_freeFrames.push_back(frame);
+}
@@ -41,6 +41,7 @@
 #pragma once
 
 #include <atomic>
+#include <mutex>
 #include <vector>
 #include "DeckLinkAPI.h"
 
@@ -64,6 +65,7 @@ public:
 	virtual long			STDMETHODCALLTYPE	GetRowBytes(void)		{ return m_width * 4; };
 	virtual HRESULT			STDMETHODCALLTYPE	GetBytes(void** buffer);
 	virtual BMDFrameFlags	STDMETHODCALLTYPE	GetFlags(void)			{ return m_flags; };
+	void										SetFlags(BMDFrameFlags flags)	{ m_flags = flags; };
 	virtual BMDPixelFormat	STDMETHODCALLTYPE	GetPixelFormat(void)	{ return bmdFormat8BitBGRA; };
 	
 	// Dummy implementations of remaining methods in IDeckLinkVideoFrame
@@ -76,3 +78,19 @@ public:
 	virtual ULONG			STDMETHODCALLTYPE	Release();
 };
 
+// Frames that are reused for each still, rather than allocating a new pixel buffer every time.
+// Frames of a different size, after a format change, are freed as they are returned.
+class Bgra32VideoFramePool
+{
+private:
+	std::mutex						m_mutex;
+	std::vector<Bgra32VideoFrame*>	m_freeFrames;
+
+public:
+	Bgra32VideoFramePool() = default;
+	virtual ~Bgra32VideoFramePool();
+
+	// The caller owns a reference to the frame until it is handed back with ReturnFrame
+	Bgra32VideoFrame*	AcquireFrame(long width, long height, BMDFrameFlags flags);
+	void				ReturnFrame(Bgra32VideoFrame* frame);
+};
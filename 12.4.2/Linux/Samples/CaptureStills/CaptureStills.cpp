@@ -53,6 +53,7 @@
 #include "DeckLinkInputDevice.h"
 #include "DeckLinkAPI.h"
 #include "ImageWriter.h"
+#include "StillEncoder.h"
 
 // Pixel format tuple encoding {BMDPixelFormat enum, Pixel format display name}
 const std::vector<std::tuple<BMDPixelFormat, std::string>> kSupportedPixelFormats
@@ -72,21 +73,16 @@ enum {
 	kPixelFormatString
 };
 
-void CaptureStills(DeckLinkInputDevice* deckLinkInput, const int captureInterval, const int framesToCapture,
+void CaptureStills(DeckLinkInputDevice* deckLinkInput, StillEncoder* stillEncoder, const int captureInterval, const int framesToCapture,
 				   const std::string& captureDirectory, const std::string& filenamePrefix)
 {
 	int							captureFrameCount		= 0;
+	int							stillsQueued			= 0;
 	HRESULT						result					= S_OK;
 	bool						captureRunning			= true;
+	std::string					outputFileName;
 	
 	IDeckLinkVideoFrame*		receivedVideoFrame		= NULL;
-	IDeckLinkVideoConversion*	deckLinkFrameConverter	= NULL;
-	IDeckLinkVideoFrame*		bgra32Frame				= NULL;
-
-	// Create frame conversion instance
-	result = GetDeckLinkVideoConversion(&deckLinkFrameConverter);
-	if (result != S_OK)
-		return;
 
 	while (captureRunning)
 	{
@@ -100,47 +96,27 @@ void CaptureStills(DeckLinkInputDevice* deckLinkInput, const int captureInterval
 		else if (captureCancelled)
 			captureRunning = false;
 
+		else if (stillEncoder->HasFailed())
+			captureRunning = false;
+
 		else if ((++captureFrameCount % captureInterval) == 0)
 		{
-			std::string outputFileName;
-			result = ImageWriter::GetNextFilenameWithPrefix(captureDirectory, filenamePrefix, outputFileName);
+			// The filename is kept for the next frame when a frame is skipped
+			if (outputFileName.empty())
+				result = ImageWriter::GetNextFilenameWithPrefix(captureDirectory, filenamePrefix, outputFileName);
+
 			if (result != S_OK)
 			{
 				fprintf(stderr, "Unable to get filename\n");
 				captureRunning = false;
 			}
-			else
+			// Conversion and encoding happen on the encoder's threads; when they are all busy the frame is skipped
+			else if (stillEncoder->QueueFrame(receivedVideoFrame, captureFrameCount, outputFileName))
 			{
 				fprintf(stderr, "Capturing frame #%d to %s\n", captureFrameCount, outputFileName.c_str());
+				outputFileName.clear();
 
-				if (receivedVideoFrame->GetPixelFormat() == bmdFormat8BitBGRA)
-				{
-					// Frame is already 8-bit BGRA - no conversion required
-					bgra32Frame = receivedVideoFrame;
-					bgra32Frame->AddRef();
-				}
-				else
-				{
-					bgra32Frame = new Bgra32VideoFrame(receivedVideoFrame->GetWidth(), receivedVideoFrame->GetHeight(), receivedVideoFrame->GetFlags());
-
-					result = deckLinkFrameConverter->ConvertFrame(receivedVideoFrame, bgra32Frame);
-					if (FAILED(result))
-					{
-						fprintf(stderr, "Frame conversion to BGRA was unsuccessful\n");
-						captureRunning = false;
-					}
-				}
-
-				result = ImageWriter::WriteBgra32VideoFrameToPNG(bgra32Frame, outputFileName);
-				if (FAILED(result))
-				{
-					fprintf(stderr, "Image encoding to file was unsuccessful\n");
-					captureRunning = false;
-				}
-
-				bgra32Frame->Release();
-				
-				if ((captureFrameCount / captureInterval) >= framesToCapture)
+				if (++stillsQueued >= framesToCapture)
 				{
 					fprintf(stderr, "Completed Capture\n");
 					captureRunning = false;
@@ -155,11 +131,23 @@ void CaptureStills(DeckLinkInputDevice* deckLinkInput, const int captureInterval
 		}
 	}
 
-	if (deckLinkFrameConverter != NULL)
-	{
-		deckLinkFrameConverter->Release();
-		deckLinkFrameConverter = NULL;
-	}
+	// Wait for the queued stills to be written
+	stillEncoder->Stop();
+}
+
+void DisplayStillEncoderStatistics(StillEncoder* stillEncoder)
+{
+	StillEncoderStatistics statistics;
+
+	stillEncoder->GetStatistics(&statistics);
+
+	fprintf(stderr, "Wrote %llu stills in %.2f seconds (%.2f stills/sec sustained), %llu failed, %llu frames skipped while encoding\n",
+		(unsigned long long)statistics.stillsWritten,
+		statistics.elapsedSeconds,
+		(statistics.elapsedSeconds > 0) ? statistics.stillsWritten / statistics.elapsedSeconds : 0.0,
+		(unsigned long long)statistics.stillsFailed,
+		(unsigned long long)statistics.framesSkipped
+		);
 }
 
 void DisplayUsage(DeckLinkInputDevice* selectedDeckLinkInput, const std::vector<std::string>& deviceNames,
@@ -286,6 +274,10 @@ void DisplayUsage(DeckLinkInputDevice* selectedDeckLinkInput, const std::vector<
 		"    -n <frames>          Number of frames to capture (default is 1)\n"
 		"    -i <interval>        Capture frame interval rate (default is 1 - every frame)\n"
 		"    -f <prefix>          Filename prefix (default is \"image_\")\n"
+		"    -t <threads>         Threads converting and encoding stills (default is one per CPU)\n"
+		"    -q <depth>           Frames waiting to be encoded before frames are skipped (default is one per thread)\n"
+		"    -z <level>           PNG compression level, 0 (fastest) to 9 (smallest) (default is the zlib default, 6)\n"
+		"    -F <filters>         PNG row filters, comma separated from none, sub, up, avg, paeth and all (default is libpng's choice)\n"
 		"    <capturedirectory>\n"
 		"\n"
 		"Capture image stills to a specified directory. eg:\n"
@@ -304,6 +296,9 @@ int main(int argc, char* argv[])
 	int							framesToCapture			= 1;
 	int							captureInterval			= 1;
 	int							pixelFormatIndex		= 0;
+	int							encoderThreadCount		= 0;
+	int							encoderQueueDepth		= 0;
+	PNGEncodingOptions			pngOptions;
 	bool						enableFormatDetection	= false;
 	std::string					filenamePrefix;
 	std::string					captureDirectory;
@@ -319,6 +314,7 @@ int main(int argc, char* argv[])
 	IDeckLinkIterator*			deckLinkIterator		= NULL;
 	IDeckLink*					deckLink				= NULL;
 	DeckLinkInputDevice*		selectedDeckLinkInput	= NULL;
+	StillEncoder*				stillEncoder			= NULL;
 
 	BMDDisplayMode				selectedDisplayMode		= bmdModeNTSC;
 	std::string					selectedDisplayModeName;
@@ -349,6 +345,24 @@ int main(int argc, char* argv[])
 		else if (strcmp(argv[i], "-f") == 0)
 			filenamePrefix = argv[++i];
 
+		else if (strcmp(argv[i], "-t") == 0)
+			encoderThreadCount = atoi(argv[++i]);
+
+		else if (strcmp(argv[i], "-q") == 0)
+			encoderQueueDepth = atoi(argv[++i]);
+
+		else if (strcmp(argv[i], "-z") == 0)
+			pngOptions.compressionLevel = atoi(argv[++i]);
+
+		else if (strcmp(argv[i], "-F") == 0)
+		{
+			if (!ImageWriter::ParsePNGFilters(argv[++i], pngOptions.filters))
+			{
+				fprintf(stderr, "Invalid PNG filters specified\n");
+				displayHelp = true;
+			}
+		}
+
 		else if ((strcmp(argv[i], "?") == 0) || (strcmp(argv[i], "-h") == 0))
 			displayHelp = true;
 
@@ -504,6 +518,18 @@ int main(int argc, char* argv[])
 		displayHelp = true;
 	}
 
+	if ((encoderThreadCount < 0) || (encoderQueueDepth < 0))
+	{
+		fprintf(stderr, "Invalid encoder thread count or queue depth specified\n");
+		displayHelp = true;
+	}
+
+	if ((pngOptions.compressionLevel < -1) || (pngOptions.compressionLevel > 9))
+	{
+		fprintf(stderr, "PNG compression level must be between 0 and 9\n");
+		displayHelp = true;
+	}
+
 	if (filenamePrefix.empty())
 	{
 		filenamePrefix = "image_";
@@ -515,6 +541,12 @@ int main(int argc, char* argv[])
 		goto bail;
 	}
 
+	// Start the encoder before capture, so no frames are held waiting for it
+	stillEncoder = new StillEncoder(pngOptions);
+	result = stillEncoder->Start(encoderThreadCount, encoderQueueDepth);
+	if (result != S_OK)
+		goto bail;
+
 	// Start capturing
 	result = selectedDeckLinkInput->StartCapture(selectedDisplayMode, std::get<kPixelFormatValue>(kSupportedPixelFormats[pixelFormatIndex]), enableFormatDetection);
 	if (result != S_OK)
@@ -542,7 +574,7 @@ int main(int argc, char* argv[])
 
 	// Start thread for capture processing
 	captureStillsThread = std::thread([&]{
-		CaptureStills(selectedDeckLinkInput, captureInterval, framesToCapture, captureDirectory, filenamePrefix);
+		CaptureStills(selectedDeckLinkInput, stillEncoder, captureInterval, framesToCapture, captureDirectory, filenamePrefix);
 	});
 
 	keyPressThread = std::thread([&]{
@@ -556,10 +588,18 @@ int main(int argc, char* argv[])
 
 	keyPressThread.join();
 
+	DisplayStillEncoderStatistics(stillEncoder);
+
 	// All Okay.
 	exitStatus = 0;
 
 bail:
+	if (stillEncoder != NULL)
+	{
+		delete stillEncoder;
+		stillEncoder = NULL;
+	}
+
 	if (selectedDeckLinkInput != NULL)
 	{
 		selectedDeckLinkInput->Release();
@@ -45,8 +45,21 @@
 #include <stdint.h>
 #include "DeckLinkAPI.h"
 
+// Settings for the PNG encoder, which default to those of libpng.  Lower compression levels and a
+// single filter encode much faster, for larger files.
+struct PNGEncodingOptions
+{
+	int		compressionLevel;	// zlib level 0-9, or -1 for the zlib default
+	int		filters;			// Set of row filters to choose from, or -1 for the libpng default
+
+	PNGEncodingOptions() : compressionLevel(-1), filters(-1) { }
+};
+
 namespace ImageWriter
 {
 	HRESULT GetNextFilenameWithPrefix(const std::string& path, const std::string& filenamePrefix, std::string& nextFileName);
-	HRESULT WriteBgra32VideoFrameToPNG(IDeckLinkVideoFrame* bgra32VideoFrame, const std::string& pngFilename);
+	HRESULT WriteBgra32VideoFrameToPNG(IDeckLinkVideoFrame* bgra32VideoFrame, const std::string& pngFilename, const PNGEncodingOptions& options = PNGEncodingOptions());
+
+	// Parses a comma separated list of filter names (none, sub, up, avg, paeth or all) into PNGEncodingOptions::filters
+	bool	ParsePNGFilters(const std::string& filterNames, int& filters);
 };
\ No newline at end of file
@@ -69,9 +69,9 @@ HRESULT ImageWriter::GetNextFilenameWithPrefix(const std::string& path, const st
 	return result;
 }
 
-HRESULT ImageWriter::WriteBgra32VideoFrameToPNG(IDeckLinkVideoFrame* bgra32VideoFrame, const std::string& pngFilename)
+HRESULT ImageWriter::WriteBgra32VideoFrameToPNG(IDeckLinkVideoFrame* bgra32VideoFrame, const std::string& pngFilename, const PNGEncodingOptions& options)
 {
-	bool        result         = E_FAIL;
+	HRESULT     result         = E_FAIL;
 	png_structp pngDataPtr     = nullptr;
 	png_infop   pngInfoPtr     = nullptr;
 	png_bytep   deckLinkBuffer = nullptr;
@@ -88,7 +88,7 @@ HRESULT ImageWriter::WriteBgra32VideoFrameToPNG(IDeckLinkVideoFrame* bgra32Video
 	if (!pngFile)
 	{
 		fprintf(stderr, "Could not open PNG file %s for writing\n", pngFilename.c_str());
-		return false;
+		return E_FAIL;
 	}
 
 	pngDataPtr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
@@ -113,6 +113,12 @@ HRESULT ImageWriter::WriteBgra32VideoFrameToPNG(IDeckLinkVideoFrame* bgra32Video
 
 	png_init_io(pngDataPtr, pngFile);
 
+	if (options.compressionLevel >= 0)
+		png_set_compression_level(pngDataPtr, options.compressionLevel);
+
+	if (options.filters >= 0)
+		png_set_filter(pngDataPtr, PNG_FILTER_TYPE_BASE, options.filters);
+
 	png_set_IHDR(pngDataPtr, pngInfoPtr, bgra32VideoFrame->GetWidth(), bgra32VideoFrame->GetHeight(),
 					8, PNG_COLOR_TYPE_RGB_ALPHA, PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_BASE, 
 					PNG_FILTER_TYPE_BASE);
@@ -144,3 +150,31 @@ bail:
 	
 	return result;
 }
+
+bool ImageWriter::ParsePNGFilters(const std::string& filterNames, int& filters)
+{
+	std::stringstream	filterNamesStream(filterNames);
+	std::string			filterName;
+
+	filters = 0;
+
+	while (std::getline(filterNamesStream, filterName, ','))
+	{
+		if (filterName == "none")
+			filters |= PNG_FILTER_NONE;
+		else if (filterName == "sub")
+			filters |= PNG_FILTER_SUB;
+		else if (filterName == "up")
+			filters |= PNG_FILTER_UP;
+		else if (filterName == "avg")
+			filters |= PNG_FILTER_AVG;
+		else if (filterName == "paeth")
+			filters |= PNG_FILTER_PAETH;
+		else if (filterName == "all")
+			filters |= PNG_ALL_FILTERS;
+		else
+			return false;
+	}
+
+	return filters != 0;
+}
@@ -0,0 +1,216 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include <stdio.h>
+#include <algorithm>
+#include "platform.h"
+#include "StillEncoder.h"
+
+StillEncoder::StillEncoder(const PNGEncodingOptions& options) :
+	m_options(options),
+	m_queueDepth(0),
+	m_stopping(false),
+	m_stillsWritten(0),
+	m_stillsFailed(0),
+	m_framesSkipped(0),
+	m_started(false)
+{
+}
+
+StillEncoder::~StillEncoder()
+{
+	Stop();
+}
+
+HRESULT StillEncoder::Start(unsigned threadCount, unsigned queueDepth)
+{
+	if (threadCount == 0)
+		threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+
+	m_queueDepth = (queueDepth > 0) ? queueDepth : threadCount;
+
+	// Each worker has its own conversion instance, so conversions are not serialised
+	for (unsigned i = 0; i < threadCount; i++)
+	{
+		IDeckLinkVideoConversion* frameConverter = NULL;
+
+		HRESULT result = GetDeckLinkVideoConversion(&frameConverter);
+		if (result != S_OK)
+		{
+			Stop();
+			return result;
+		}
+
+		m_frameConverters.push_back(frameConverter);
+		m_workers.push_back(std::thread(&StillEncoder::WorkerThread, this, frameConverter));
+	}
+
+	return S_OK;
+}
+
+bool StillEncoder::QueueFrame(IDeckLinkVideoFrame* frame, int frameNumber, const std::string& filename)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		if (m_requests.size() >= m_queueDepth)
+		{
+			++m_framesSkipped;
+			return false;
+		}
+
+		if (!m_started)
+		{
+			m_firstQueueTime = std::chrono::steady_clock::now();
+			m_started = true;
+		}
+
+		frame->AddRef();
+		m_requests.push({ frame, frameNumber, filename });
+	}
+	m_requestCondition.notify_one();
+
+	return true;
+}
+
+void StillEncoder::Stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_requestCondition.notify_all();
+
+	// Workers finish the queued stills before exiting
+	for (std::thread& worker : m_workers)
+		worker.join();
+	m_workers.clear();
+
+	while (!m_frameConverters.empty())
+	{
+		m_frameConverters.back()->Release();
+		m_frameConverters.pop_back();
+	}
+}
+
+void StillEncoder::GetStatistics(StillEncoderStatistics* statistics)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	statistics->stillsWritten	= m_stillsWritten;
+	statistics->stillsFailed	= m_stillsFailed;
+	statistics->framesSkipped	= m_framesSkipped;
+	statistics->elapsedSeconds	= (m_stillsWritten > 0) ? std::chrono::duration<double>(m_lastWriteTime - m_firstQueueTime).count() : 0.0;
+}
+
+void StillEncoder::WorkerThread(IDeckLinkVideoConversion* frameConverter)
+{
+	while (true)
+	{
+		StillRequest request;
+
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_requestCondition.wait(lock, [&]{ return !m_requests.empty() || m_stopping; });
+
+			if (m_requests.empty())
+				return;
+
+			request = m_requests.front();
+			m_requests.pop();
+		}
+
+		bool written = WriteStill(frameConverter, request);
+
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (written)
+		{
+			++m_stillsWritten;
+			m_lastWriteTime = std::chrono::steady_clock::now();
+		}
+		else
+			++m_stillsFailed;
+	}
+}
+
+bool StillEncoder::WriteStill(IDeckLinkVideoConversion* frameConverter, const StillRequest& request)
+{
+	IDeckLinkVideoFrame*	capturedFrame	= request.frame;
+	Bgra32VideoFrame*		pooledFrame		= NULL;
+	IDeckLinkVideoFrame*	bgra32Frame		= NULL;
+	HRESULT					result;
+
+	if (capturedFrame->GetPixelFormat() == bmdFormat8BitBGRA)
+	{
+		// Frame is already 8-bit BGRA - no conversion required
+		bgra32Frame = capturedFrame;
+	}
+	else
+	{
+		pooledFrame = m_framePool.AcquireFrame(capturedFrame->GetWidth(), capturedFrame->GetHeight(), capturedFrame->GetFlags());
+
+		result = frameConverter->ConvertFrame(capturedFrame, pooledFrame);
+
+		// The captured frame is no longer needed, so return its buffer to the driver before encoding
+		capturedFrame->Release();
+
+		if (FAILED(result))
+		{
+			fprintf(stderr, "Frame conversion to BGRA was unsuccessful\n");
+			m_framePool.ReturnFrame(pooledFrame);
+			return false;
+		}
+
+		bgra32Frame = pooledFrame;
+	}
+
+	result = ImageWriter::WriteBgra32VideoFrameToPNG(bgra32Frame, request.filename, m_options);
+	if (FAILED(result))
+		fprintf(stderr, "Image encoding to file %s was unsuccessful\n", request.filename.c_str());
+	else
+		fprintf(stderr, "Wrote frame #%d to %s\n", request.frameNumber, request.filename.c_str());
+
+	if (pooledFrame != NULL)
+		m_framePool.ReturnFrame(pooledFrame);
+	else
+		capturedFrame->Release();
+
+	return SUCCEEDED(result);
+}
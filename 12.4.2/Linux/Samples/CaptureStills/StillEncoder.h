@@ -0,0 +1,112 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#pragma once
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <queue>
+#include <string>
+#include <thread>
+#include <vector>
+#include "DeckLinkAPI.h"
+#include "Bgra32VideoFrame.h"
+#include "ImageWriter.h"
+
+struct StillEncoderStatistics
+{
+	uint64_t	stillsWritten;
+	uint64_t	stillsFailed;
+	uint64_t	framesSkipped;		// Frames not queued because the workers were all busy
+	double		elapsedSeconds;		// From the first frame queued to the last still written
+};
+
+// Converts captured frames to BGRA and writes them as PNG files on a pool of worker threads, so the
+// capture thread only queues each frame.  The queue is bounded, as the frames hold the driver's
+// capture buffers; a frame is released as soon as it has been converted, before it is encoded.
+class StillEncoder
+{
+private:
+	struct StillRequest
+	{
+		IDeckLinkVideoFrame*	frame;
+		int						frameNumber;
+		std::string				filename;
+	};
+
+	PNGEncodingOptions						m_options;
+	unsigned								m_queueDepth;
+	std::vector<std::thread>				m_workers;
+	std::vector<IDeckLinkVideoConversion*>	m_frameConverters;
+	Bgra32VideoFramePool					m_framePool;
+
+	std::mutex								m_mutex;
+	std::condition_variable					m_requestCondition;
+	std::queue<StillRequest>				m_requests;
+	bool									m_stopping;
+
+	std::atomic<uint64_t>					m_stillsWritten;
+	std::atomic<uint64_t>					m_stillsFailed;
+	std::atomic<uint64_t>					m_framesSkipped;
+	bool									m_started;
+	std::chrono::steady_clock::time_point	m_firstQueueTime;
+	std::chrono::steady_clock::time_point	m_lastWriteTime;
+
+	void	WorkerThread(IDeckLinkVideoConversion* frameConverter);
+	bool	WriteStill(IDeckLinkVideoConversion* frameConverter, const StillRequest& request);
+
+public:
+	explicit StillEncoder(const PNGEncodingOptions& options);
+	virtual ~StillEncoder();
+
+	// A threadCount of 0 uses one thread per CPU; a queueDepth of 0 allows one waiting frame per thread
+	HRESULT	Start(unsigned threadCount, unsigned queueDepth);
+
+	// Takes a reference to the frame and queues it, or returns false if the queue is full
+	bool	QueueFrame(IDeckLinkVideoFrame* frame, int frameNumber, const std::string& filename);
+
+	// Waits for the queued stills to be written, then stops the workers
+	void	Stop(void);
+
+	bool	HasFailed(void) const		{ return m_stillsFailed > 0; };
+	void	GetStatistics(StillEncoderStatistics* statistics);
+};
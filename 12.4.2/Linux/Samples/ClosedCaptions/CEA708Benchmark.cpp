@@ -0,0 +1,235 @@
+/* -LICENSE-START-
+ ** Copyright (c) 2022 Blackmagic Design
+ **  
+ ** Permission is hereby granted, free of charge, to any person or organization 
+ ** obtaining a copy of the software and accompanying documentation (the 
+ ** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+ ** and transmit the Software, and to prepare derivative works of the Software, 
+ ** and to permit third-parties to whom the Software is furnished to do so, in 
+ ** accordance with:
+ ** 
+ ** (1) if the Software is obtained from Blackmagic Design, the End User License 
+ ** Agreement for the Software Development Kit (“EULA”) available at 
+ ** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+ ** 
+ ** (2) if the Software is obtained from any third party, such licensing terms 
+ ** as notified by that third party,
+ ** 
+ ** and all subject to the following:
+ ** 
+ ** (3) the copyright notices in the Software and this entire statement, 
+ ** including the above license grant, this restriction and the following 
+ ** disclaimer, must be included in all copies of the Software, in whole or in 
+ ** part, and all derivative works of the Software, unless such copies or 
+ ** derivative works are solely in the form of machine-executable object code 
+ ** generated by a source language processor.
+ ** 
+ ** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+ ** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ ** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+ ** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+ ** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+ ** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+ ** DEALINGS IN THE SOFTWARE.
+ ** 
+ ** A copy of the Software is available free of charge at 
+ ** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+ ** 
+ ** -LICENSE-END-
+ */
+
+// Measures the CEA-708 encoder stack on the path ClosedCaptions takes for each output frame: captions are
+// written every kCaptionInterval frames as in ScheduleNextFrame, a pad CDP is encoded for the frames
+// between, and each CDP is held by a recycled stand-in for CaptionAncillaryPacket until the frame it was
+// scheduled with completes, kFramesInFlight frames later.  Heap allocations are counted by replacing
+// operator new, after a warm-up that lets the pools reach their working size.
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <vector>
+#include <unistd.h>
+#include "CEA708_Encoder.h"
+
+namespace
+{
+	const uint32_t	kFrameDuration		= 1000;
+	const uint32_t	kTimeScale			= 25000;
+	const uint32_t	kCaptionInterval	= 25;
+	const uint32_t	kFramesInFlight		= 3;
+	const uint32_t	kWarmUpFrameCount	= 100;
+
+	std::atomic<uint64_t>	g_allocationCount(0);
+
+	typedef std::chrono::steady_clock	Clock;
+
+	// Stands in for CaptionAncillaryPacket, which borrows the CDP and is recycled by a pool in main.cpp
+	struct BenchmarkAncillaryPacket
+	{
+		CEA708::CDPReference	userData;
+	};
+
+	struct BenchmarkResult
+	{
+		double		elapsed;
+		uint64_t	allocationCount;
+		uint64_t	byteCount;
+		uint64_t	checksum;
+	};
+
+	void writeCaptions(CEA708::Encoder& cc)
+	{
+		using namespace CEA708;
+
+		cc << DeleteWindows();
+		cc << DefineWindow(window_0, priority_Highest, anchor_BottomCenter, false, 27, 44, 2, 22, true, true, true, windowStyle_NTSCPopup, penStyle_NTSCProportionalSans);
+		cc << SetWindowAttributes(justify_Left, printDirection_LeftToRight, scrollDirection_BottomToTop, false, displayEffect_Snap, effectDirection_LeftToRight, 0, colour_Black, opacity_Translucent, borderType_None, colour_Black);
+		cc << SetPenLocation(0, 0) << "\r";
+		cc << SetPenAttributes(penSize_Standard, font_ProportionalSans, textTag_Dialog, textOffset_Normal, false, false, edgeType_None);
+		cc << SetPenLocation(0, 0) << "CEA-708 Closed Captions";
+		cc << SetPenLocation(1, 0) << "Second line of text!";
+		cc << EndOfText();
+		cc << DisplayWindows(1 << window_0);
+		cc.flush();
+	}
+
+	BenchmarkResult runEncoder(uint32_t frameCount)
+	{
+		CEA708::Encoder							cc(kFrameDuration, kTimeScale);
+		std::vector<BenchmarkAncillaryPacket*>	freePackets;
+		BenchmarkAncillaryPacket*				scheduledPackets[kFramesInFlight] = {};
+		BenchmarkResult							result = {};
+		Clock::time_point						startTime;
+
+		freePackets.reserve(kFramesInFlight + 1);
+
+		for (uint32_t frame = 0; frame < kWarmUpFrameCount + frameCount; frame++)
+		{
+			if (frame == kWarmUpFrameCount)
+			{
+				result.allocationCount = g_allocationCount.load();
+				startTime = Clock::now();
+			}
+
+			if (frame % kCaptionInterval == 0)
+				writeCaptions(cc);
+
+			// Pad packets keep the caption channel continuous when there is no caption data
+			if (cc.empty())
+				cc.flush();
+
+			// The frame scheduled kFramesInFlight frames ago has completed, releasing its packet
+			BenchmarkAncillaryPacket*& scheduledPacket = scheduledPackets[frame % kFramesInFlight];
+			if (scheduledPacket != nullptr)
+			{
+				scheduledPacket->userData.reset();
+				freePackets.push_back(scheduledPacket);
+				scheduledPacket = nullptr;
+			}
+
+			CEA708::CDPReference packet;
+			if (!cc.pop(&packet))
+				continue;
+
+			if (freePackets.empty())
+			{
+				scheduledPacket = new BenchmarkAncillaryPacket();
+			}
+			else
+			{
+				scheduledPacket = freePackets.back();
+				freePackets.pop_back();
+			}
+			scheduledPacket->userData = std::move(packet);
+
+			// Read the packet as the driver would when it is output
+			const uint8_t*	data = scheduledPacket->userData->data();
+			size_t			size = scheduledPacket->userData->size();
+
+			if (frame >= kWarmUpFrameCount)
+			{
+				result.byteCount += size;
+				for (size_t i = 0; i < size; i++)
+					result.checksum = result.checksum * 131 + data[i];
+			}
+		}
+
+		result.elapsed			= std::chrono::duration<double>(Clock::now() - startTime).count();
+		result.allocationCount	= g_allocationCount.load() - result.allocationCount;
+
+		for (BenchmarkAncillaryPacket* packet : scheduledPackets)
+			delete packet;
+		for (BenchmarkAncillaryPacket* packet : freePackets)
+			delete packet;
+
+		return result;
+	}
+
+	void displayUsage(const char* program)
+	{
+		fprintf(stderr,
+			"Usage: %s [options]\n"
+			"    -n <frames>        Frames encoded (default is 2000000)\n",
+			program);
+	}
+}
+
+void* operator new(size_t size)
+{
+	g_allocationCount.fetch_add(1, std::memory_order_relaxed);
+
+	void* memory = malloc(size ? size : 1);
+	if (memory == nullptr)
+		throw std::bad_alloc();
+
+	return memory;
+}
+
+void operator delete(void* memory) noexcept
+{
+	free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept
+{
+	free(memory);
+}
+
+int main(int argc, char* argv[])
+{
+	int		frameCount = 2000000;
+	int		ch;
+
+	while ((ch = getopt(argc, argv, "n:h")) != -1)
+	{
+		switch (ch)
+		{
+			case 'n':
+				frameCount = atoi(optarg);
+				break;
+			case 'h':
+			default:
+				displayUsage(argv[0]);
+				return 1;
+		}
+	}
+
+	if (frameCount <= 0)
+	{
+		displayUsage(argv[0]);
+		return 1;
+	}
+
+	BenchmarkResult result = runEncoder((uint32_t)frameCount);
+
+	printf("CEA-708 at 25 fps, captions every %u frames, %d frames\n", kCaptionInterval, frameCount);
+	printf("%14s%12s%20s%12s\n", "packets/s", "ns/frame", "allocations/frame", "bytes");
+	printf("%14.0f%12.1f%20.3f%12llu\n",
+		frameCount / result.elapsed, (result.elapsed * 1e9) / frameCount,
+		(double)result.allocationCount / frameCount, (unsigned long long)result.byteCount);
+	printf("Checksum of packets output: %016llx\n", (unsigned long long)result.checksum);
+
+	return 0;
+}
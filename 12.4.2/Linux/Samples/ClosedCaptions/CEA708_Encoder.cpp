@@ -39,6 +39,7 @@
  */
 
 #include "CEA708_Encoder.h"
+#include <algorithm>
 #include <cstring>
 
 namespace CEA708
@@ -80,6 +81,144 @@ static CDPFrameRate FrameRateToCDPFrameRate(int64_t frameDuration, int64_t timeS
 
 //=====================================================================
 
+EncodedCaptionDistributionPacket::EncodedCaptionDistributionPacket()
+: m_pool(nullptr), m_refCount(0), m_size(0)
+{
+}
+
+void EncodedCaptionDistributionPacket::retain()
+{
+	m_refCount.fetch_add(1, std::memory_order_relaxed);
+}
+
+void EncodedCaptionDistributionPacket::release()
+{
+	if (m_refCount.fetch_sub(1, std::memory_order_acq_rel) == 1)
+		m_pool->recycle(this);
+}
+
+//=====================================================================
+
+CDPReference::CDPReference(const CDPReference& other)
+: m_packet(other.m_packet)
+{
+	if (m_packet)
+		m_packet->retain();
+}
+
+CDPReference::~CDPReference()
+{
+	reset();
+}
+
+CDPReference& CDPReference::operator=(CDPReference other)
+{
+	std::swap(m_packet, other.m_packet);
+	return *this;
+}
+
+void CDPReference::reset()
+{
+	if (m_packet)
+	{
+		m_packet->release();
+		m_packet = nullptr;
+	}
+}
+
+//=====================================================================
+
+CaptionDistributionPacketPool::CaptionDistributionPacketPool(std::size_t initialCapacity)
+: m_capacity(0)
+{
+	grow(std::max<std::size_t>(initialCapacity, 1));
+}
+
+void CaptionDistributionPacketPool::grow(std::size_t count)
+{
+	std::unique_ptr<EncodedCaptionDistributionPacket[]> block(new EncodedCaptionDistributionPacket[count]);
+	
+	// Reserve for every packet up front, so that recycling never reallocates the free list
+	m_capacity += count;
+	m_freePackets.reserve(m_capacity);
+	for (std::size_t i = 0; i < count; ++i)
+	{
+		block[i].m_pool = this;
+		m_freePackets.push_back(&block[i]);
+	}
+	m_blocks.push_back(std::move(block));
+}
+
+EncodedCaptionDistributionPacket* CaptionDistributionPacketPool::acquire()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	
+	// Only reached when more packets are in flight than ever before
+	if (m_freePackets.empty())
+		grow(m_capacity);
+	
+	EncodedCaptionDistributionPacket* packet = m_freePackets.back();
+	m_freePackets.pop_back();
+	
+	packet->m_size = 0;
+	packet->m_refCount.store(1, std::memory_order_relaxed);
+	return packet;
+}
+
+void CaptionDistributionPacketPool::recycle(EncodedCaptionDistributionPacket* packet)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_freePackets.push_back(packet);
+}
+
+std::size_t CaptionDistributionPacketPool::capacity()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_capacity;
+}
+
+//=====================================================================
+
+CDPQueue::CDPQueue()
+: m_slots(8, nullptr), m_head(0), m_count(0)
+{
+}
+
+CDPQueue::~CDPQueue()
+{
+	while (!empty())
+		pop()->release();
+}
+
+void CDPQueue::push(EncodedCaptionDistributionPacket* packet)
+{
+	if (m_count == m_slots.size())
+	{
+		// Unwrap the ring into a larger one
+		std::vector<EncodedCaptionDistributionPacket*> slots(m_slots.size() * 2, nullptr);
+		for (std::size_t i = 0; i < m_count; ++i)
+			slots[i] = m_slots[(m_head + i) % m_slots.size()];
+		m_slots.swap(slots);
+		m_head = 0;
+	}
+	
+	m_slots[(m_head + m_count) % m_slots.size()] = packet;
+	++m_count;
+}
+
+EncodedCaptionDistributionPacket* CDPQueue::pop()
+{
+	if (m_count == 0)
+		return nullptr;
+	
+	EncodedCaptionDistributionPacket* packet = m_slots[m_head];
+	m_head = (m_head + 1) % m_slots.size();
+	--m_count;
+	return packet;
+}
+
+//=====================================================================
+
 ServiceBlockEncoder::ServiceBlockEncoder(CaptionChannelPacketEncoder& packetEncoder, uint8_t serviceNumber)
 : m_packetEncoder(packetEncoder), m_serviceNumber(serviceNumber)
 {
@@ -164,8 +303,9 @@ void CaptionChannelPacketEncoder::push(const uint8_t* block, uint8_t blockLength
 {
 	/* As service block data and caption packets cannot be fragmented,
 	   the maximum data which can be packed depends on the cc_count of the 
-	   cdp packet into which this caption packet will be encoded. */
-	std::size_t maxDataLength = std::min(m_CDPEncoder.maxPayloadSize(), static_cast<std::size_t>(kMaximumData));
+	   cdp packet into which this caption packet will be encoded.
+	   The header and padding byte must fit in the cdp payload alongside the data. */
+	std::size_t maxDataLength = std::min(m_CDPEncoder.maxPayloadSize() - kHeaderSize, static_cast<std::size_t>(kMaximumData));
 	
 	if (blockLength > maxDataLength)
 		return;	// service block cannot be larger than caption channel packet.
@@ -193,10 +333,10 @@ void CaptionChannelPacketEncoder::flush()
 
 //=====================================================================
 
-CaptionDistributionPacketEncoder::CaptionDistributionPacketEncoder(CDPQueue& cdpQueue, int64_t frameDuration, int64_t timeScale)
-: m_cdpQueue(cdpQueue), m_sequence(0), m_CCCount(FrameRateToCDPCCCount(frameDuration, timeScale)), m_frameRate(FrameRateToCDPFrameRate(frameDuration, timeScale))
+CaptionDistributionPacketEncoder::CaptionDistributionPacketEncoder(CDPQueue& cdpQueue, CaptionDistributionPacketPool& cdpPool, int64_t frameDuration, int64_t timeScale)
+: m_cdpQueue(cdpQueue), m_cdpPool(cdpPool), m_sequence(0), m_CCCount(FrameRateToCDPCCCount(frameDuration, timeScale)), m_frameRate(FrameRateToCDPFrameRate(frameDuration, timeScale)), m_payloadSize(0)
 {
-
+	m_CCCount = std::min<uint8_t>(m_CCCount, kMaximumPayload / 2);
 }
 
 void CaptionDistributionPacketEncoder::encode_ccdata(uint8_t*& buffer)
@@ -211,7 +351,7 @@ void CaptionDistributionPacketEncoder::encode_ccdata(uint8_t*& buffer)
 		cc_type_708_start
 	};
 	
-	unsigned payloadPackets = static_cast<unsigned>(m_payload.size() / 2);
+	unsigned payloadPackets = m_payloadSize / 2;
 	unsigned padPackets = m_CCCount - payloadPackets;
 	
 	if (payloadPackets > m_CCCount)
@@ -219,11 +359,11 @@ void CaptionDistributionPacketEncoder::encode_ccdata(uint8_t*& buffer)
 	
 	uint8_t* ccdata_header = buffer;
 	ccdata_header[0] = CCDATA_ID;
-	ccdata_header[1] |= 0x7 << 5;		// marker
+	ccdata_header[1] = 0x7 << 5;		// marker
 	ccdata_header[1] |= m_CCCount & 0x1F;
 	buffer += 2;
 	
-	uint8_t* cc_data_x = m_payload.data();
+	const uint8_t* cc_data_x = m_payload;
 	for (unsigned i = 0; i < payloadPackets; ++i)
 	{
 		uint8_t* ccdata = buffer;
@@ -281,7 +421,7 @@ void CaptionDistributionPacketEncoder::encode_svcinfo(uint8_t*& buffer)
 	buffer += kServiceDataLength;
 }
 
-EncodedCaptionDistributionPacket CaptionDistributionPacketEncoder::encode()
+void CaptionDistributionPacketEncoder::encode()
 {
 	static const uint16_t	CDP_IDENTIFIER = 0x9669;
 	static const uint8_t	CDP_FOOTER_ID = 0x74;
@@ -293,15 +433,19 @@ EncodedCaptionDistributionPacket CaptionDistributionPacketEncoder::encode()
 		kCDPFooterLength = 4
 	};
 	
+	EncodedCaptionDistributionPacket* encoded = m_cdpPool.acquire();
 	if (m_frameRate == cdpFrameRate_Forbidden)
-		return EncodedCaptionDistributionPacket();
+	{
+		// Queue an empty packet, as for any other flush
+		m_cdpQueue.push(encoded);
+		return;
+	}
 	
 	uint8_t cc_data_length = 2 + 3 * m_CCCount;
 	uint8_t cdp_length = kCDPHeaderLength + cc_data_length + kServiceInfoLength + kCDPFooterLength;
 	
-	EncodedCaptionDistributionPacket encoded;
-	encoded.resize(cdp_length);
-	uint8_t* buffer = encoded.data();
+	encoded->m_size = cdp_length;
+	uint8_t* buffer = encoded->m_data;
 	
 	enum cdp_flags
 	{
@@ -318,9 +462,9 @@ EncodedCaptionDistributionPacket CaptionDistributionPacketEncoder::encode()
 	cdp_header[0] = (CDP_IDENTIFIER & 0xFF00) >> 8;
 	cdp_header[1] = (CDP_IDENTIFIER & 0x00FF);
 	cdp_header[2] = cdp_length;
-	cdp_header[3] |= m_frameRate << 4;
+	cdp_header[3] = m_frameRate << 4;
 	cdp_header[3] |= 0x0F;		// reserved
-	cdp_header[4] |= ccdata_present | caption_service_active | svcinfo_present | svc_info_start | svc_info_complete;
+	cdp_header[4] = ccdata_present | caption_service_active | svcinfo_present | svc_info_start | svc_info_complete;
 	cdp_header[4] |= 1 << 0;	// reserved
 	cdp_header[5] = (m_sequence & 0xFF00) >> 8;
 	cdp_header[6] = (m_sequence & 0x00FF);
@@ -335,45 +479,47 @@ EncodedCaptionDistributionPacket CaptionDistributionPacketEncoder::encode()
 	cdp_footer[2] = (m_sequence & 0x00FF);
 	cdp_footer[3] = 0 /* checksum filled below */;
 	
-	for (unsigned i = 0; i < encoded.size()-1; ++i)
-		cdp_footer[3] += encoded[i];
+	for (unsigned i = 0; i < encoded->m_size-1u; ++i)
+		cdp_footer[3] += encoded->m_data[i];
 	cdp_footer[3] = cdp_footer[3] ? 256 - cdp_footer[3] : 0;
 	
 	buffer += kCDPFooterLength;
 	
 	++m_sequence;
 	
-	return encoded;
+	m_cdpQueue.push(encoded);
 }
 
 void CaptionDistributionPacketEncoder::reset()
 {
-	m_payload.clear();
+	m_payloadSize = 0;
 }
 
 void CaptionDistributionPacketEncoder::push(const uint8_t* packet, uint8_t packetLength)
 {
-	if (m_payload.size() + packetLength > maxPayloadSize())
+	if (m_payloadSize + packetLength > maxPayloadSize())
 	{
-		EncodedCaptionDistributionPacket packet = encode();
-		m_cdpQueue.push(packet);
+		encode();
 		reset();
 	}
 	
-	m_payload.insert(m_payload.end(), packet, packet + packetLength);
+	if (m_payloadSize + packetLength > maxPayloadSize())
+		return;	// caption channel packet cannot be larger than the cdp payload.
+	
+	std::memcpy(m_payload + m_payloadSize, packet, packetLength);
+	m_payloadSize += packetLength;
 }
 
 void CaptionDistributionPacketEncoder::flush()
 {
-	EncodedCaptionDistributionPacket packet = encode();
-	m_cdpQueue.push(packet);
+	encode();
 	reset();
 }
 
 //=====================================================================
 
 Encoder::Encoder(int64_t frameDuration, int64_t timeScale)
-: m_cdpQueue(), m_cdpEncoder(m_cdpQueue, frameDuration, timeScale), m_packetEncoder(m_cdpEncoder), m_serviceBlockEncoder(m_packetEncoder, serviceNumber_PrimaryCaptionService)
+: m_cdpPool(), m_cdpQueue(), m_cdpEncoder(m_cdpQueue, m_cdpPool, frameDuration, timeScale), m_packetEncoder(m_cdpEncoder), m_serviceBlockEncoder(m_packetEncoder, serviceNumber_PrimaryCaptionService)
 {
 }
 
@@ -401,12 +547,12 @@ bool Encoder::empty() const
 	return m_cdpQueue.empty();
 }
 
-bool Encoder::pop(EncodedCaptionDistributionPacket* packet)
+bool Encoder::pop(CDPReference* packet)
 {
 	if (!m_cdpQueue.empty())
 	{
-		*packet = m_cdpQueue.front();
-		m_cdpQueue.pop();
+		// Hand the queue's reference over to the caller
+		*packet = CDPReference(m_cdpQueue.pop());
 		return true;
 	}
 	return false;
@@ -40,7 +40,9 @@
 
 #ifndef __CEA708_ENCODER_H__
 #define __CEA708_ENCODER_H__
-#include <queue>
+#include <atomic>
+#include <memory>
+#include <mutex>
 #include <vector>
 #include <stdint.h>
 #include "CEA708_Commands.h"
@@ -73,13 +75,118 @@ enum CDPFrameRate
 	cdpFrameRate_60				// '0b1000'
 };
 
-typedef std::vector<uint8_t> EncodedCaptionDistributionPacket;
-typedef std::queue<EncodedCaptionDistributionPacket> CDPQueue;
+// SMPTE 334-2 5.1 CDP Header - cdp_length is an 8-bit count of the bytes in the whole packet
+enum
+{
+	kMaximumCDPLength = 255
+};
+
+class CaptionDistributionPacketPool;
 class ServiceBlockEncoder;
 class CaptionChannelPacketEncoder;
 class CaptionDistributionPacketEncoder;
 
 
+/* A fully-encoded CDP in a fixed-size buffer owned by a CaptionDistributionPacketPool.
+ * Packets are reference counted so they can be lent, rather than copied, to whatever carries them to the
+ * output.  The last release() returns the buffer to its pool, which must outlive every borrowed packet. */
+class EncodedCaptionDistributionPacket
+{
+private:
+	CaptionDistributionPacketPool*	m_pool;
+	std::atomic<uint32_t>			m_refCount;
+	uint8_t							m_size;
+	uint8_t							m_data[kMaximumCDPLength];
+	
+	friend class CaptionDistributionPacketPool;
+	friend class CaptionDistributionPacketEncoder;
+	
+public:
+	EncodedCaptionDistributionPacket();
+	
+	const uint8_t*	data() const	{ return m_data; }
+	std::size_t		size() const	{ return m_size; }
+	bool			empty() const	{ return m_size == 0; }
+	
+	void retain();
+	void release();
+};
+
+
+/* Holds one reference on a pooled CDP for as long as it is in scope */
+class CDPReference
+{
+private:
+	EncodedCaptionDistributionPacket*	m_packet;
+	
+public:
+	CDPReference() : m_packet(nullptr) { }
+	explicit CDPReference(EncodedCaptionDistributionPacket* packet) : m_packet(packet) { }	// Adopts a reference
+	CDPReference(const CDPReference& other);
+	CDPReference(CDPReference&& other) : m_packet(other.m_packet) { other.m_packet = nullptr; }
+	~CDPReference();
+	
+	CDPReference& operator=(CDPReference other);
+	
+	const EncodedCaptionDistributionPacket*	get() const			{ return m_packet; }
+	const EncodedCaptionDistributionPacket*	operator->() const	{ return m_packet; }
+	explicit operator bool() const								{ return m_packet != nullptr; }
+	
+	void reset();
+};
+
+
+/* Free list of CDP buffers.  Buffers are allocated in blocks and never freed while the pool exists, so
+ * once the pool has grown to cover the packets in flight, encoding and releasing CDPs do not allocate.
+ * Packets may be released from any thread, typically the one on which the output releases its frames. */
+class CaptionDistributionPacketPool
+{
+private:
+	enum
+	{
+		kDefaultCapacity = 16
+	};
+	
+	std::mutex											m_mutex;
+	std::vector<std::unique_ptr<EncodedCaptionDistributionPacket[]>>	m_blocks;
+	std::vector<EncodedCaptionDistributionPacket*>		m_freePackets;
+	std::size_t											m_capacity;
+	
+	void grow(std::size_t count);
+	
+	friend class EncodedCaptionDistributionPacket;
+	void recycle(EncodedCaptionDistributionPacket* packet);
+	
+public:
+	explicit CaptionDistributionPacketPool(std::size_t initialCapacity = kDefaultCapacity);
+	
+	// Returns an empty packet holding a single reference
+	EncodedCaptionDistributionPacket* acquire();
+	
+	std::size_t capacity();
+};
+
+
+/* FIFO of encoded CDPs waiting to be popped, in a ring that only grows if more packets are queued than
+ * have been queued before.  Each queued packet holds the reference taken when it was acquired. */
+class CDPQueue
+{
+private:
+	std::vector<EncodedCaptionDistributionPacket*>	m_slots;
+	std::size_t										m_head;
+	std::size_t										m_count;
+	
+public:
+	CDPQueue();
+	~CDPQueue();
+	
+	bool empty() const	{ return m_count == 0; }
+	
+	void push(EncodedCaptionDistributionPacket* packet);
+	EncodedCaptionDistributionPacket* pop();
+};
+
+
 // CEA-708 6 DTVCC Service Layer
 // Note: Extended Service Block Header not shown
 class ServiceBlockEncoder
@@ -151,21 +258,29 @@ public:
 class CaptionDistributionPacketEncoder
 {
 private:
-	CDPQueue&				m_cdpQueue;
-	uint16_t				m_sequence;
-	uint8_t					m_CCCount;
-	CDPFrameRate			m_frameRate;
-	std::vector<uint8_t>	m_payload;
+	enum
+	{
+		kMaximumPayload = 31 * 2	// cc_count is a 5-bit field of 2 byte cc_data
+	};
+	
+	CDPQueue&						m_cdpQueue;
+	CaptionDistributionPacketPool&	m_cdpPool;
+	uint16_t						m_sequence;
+	uint8_t							m_CCCount;
+	CDPFrameRate					m_frameRate;
+	uint8_t							m_payload[kMaximumPayload];
+	uint8_t							m_payloadSize;
 	
 	void encode_ccdata(uint8_t*& buffer);
 	void encode_svcinfo(uint8_t*& buffer);
 	
-	EncodedCaptionDistributionPacket encode();
+	/* Encodes the payload into a pooled packet and pushes it onto the CDPQueue */
+	void encode();
 	
 	void reset();
 	
 public:
-	CaptionDistributionPacketEncoder(CDPQueue& cdpQueue, int64_t frameDuration, int64_t timeScale);
+	CaptionDistributionPacketEncoder(CDPQueue& cdpQueue, CaptionDistributionPacketPool& cdpPool, int64_t frameDuration, int64_t timeScale);
 	
 	inline std::size_t maxPayloadSize() const
 	{
@@ -186,6 +301,7 @@ public:
 class Encoder
 {
 private:
+	CaptionDistributionPacketPool		m_cdpPool;
 	CDPQueue							m_cdpQueue;
 	CaptionDistributionPacketEncoder	m_cdpEncoder;
 	CaptionChannelPacketEncoder			m_packetEncoder;
@@ -201,8 +317,9 @@ public:
 	// True if there are no fully-encoded packets in the queue.
 	bool empty() const;
 	
-	// Pop an encoded CDP from the queue
-	bool pop(EncodedCaptionDistributionPacket* packet);
+	// Pop an encoded CDP from the queue.  The packet is borrowed from the encoder's pool, and is returned
+	// to it when the last reference is dropped; the encoder must outlive the packet.
+	bool pop(CDPReference* packet);
 	
 	// Flush any remaining data through the encoder stack.
 	// If there was no partial data a pad packet is generated.
@@ -44,6 +44,7 @@
 #include <cstdio>
 #include <functional>
 #include <mutex>
+#include <vector>
 
 // The DeckLinkAPI enables the insertion of arbitrary data into the vertical blanking of the SDI. This sample implements
 // basic encoding of caption data using the CEA 708 spec, before passing that data to the DeckLinkAPI. Other caption
@@ -92,13 +93,39 @@ static void FillBlue(IDeckLinkMutableVideoFrame* theFrame)
 	}
 }
 
+class CaptionAncillaryPacket;
+
+// Recycles caption packets once DeckLink has released them, so that captioning a frame does not allocate
+class CaptionAncillaryPacketPool
+{
+public:
+	~CaptionAncillaryPacketPool();
+	
+	// Returns a packet holding a single reference, which borrows the encoded CDP
+	CaptionAncillaryPacket* acquire(CEA708::CDPReference userData);
+	void recycle(CaptionAncillaryPacket* packet);
+	
+private:
+	std::mutex								m_mutex;
+	std::vector<CaptionAncillaryPacket*>	m_freePackets;
+};
+
+CaptionAncillaryPacketPool gCaptionPacketPool;
+
 class CaptionAncillaryPacket: public IDeckLinkAncillaryPacket
 {
 public:
-	CaptionAncillaryPacket(const CEA708::EncodedCaptionDistributionPacket& userData)
+	CaptionAncillaryPacket(CaptionAncillaryPacketPool* pool, CEA708::CDPReference userData)
 	{
 		m_refCount = 1;
-		m_userData = userData;
+		m_pool = pool;
+		m_userData = std::move(userData);
+	}
+	
+	void reuse(CEA708::CDPReference userData)
+	{
+		m_refCount = 1;
+		m_userData = std::move(userData);
 	}
 	
 	// IDeckLinkAncillaryPacket
@@ -111,9 +138,9 @@ public:
 			return E_NOTIMPL;
 		}
 		if (size) // Optional
-			*size = (uint32_t)m_userData.size();
+			*size = (uint32_t)m_userData->size();
 		if (data) // Optional
-			*data = m_userData.data();
+			*data = m_userData->data();
 		return S_OK;
 	}
 	
@@ -161,16 +188,49 @@ public:
 	{
 		ULONG newRefValue = --m_refCount;
 		if (newRefValue == 0)
-			delete this;
+		{
+			// Return the CDP to the encoder's pool and this packet to ours
+			m_userData.reset();
+			m_pool->recycle(this);
+		}
 		
 		return newRefValue;
 	}
 
 private:
 	std::atomic<ULONG> m_refCount;
-	CEA708::EncodedCaptionDistributionPacket m_userData;
+	CaptionAncillaryPacketPool* m_pool;
+	CEA708::CDPReference m_userData;
 };
 
+CaptionAncillaryPacketPool::~CaptionAncillaryPacketPool()
+{
+	for (CaptionAncillaryPacket* packet : m_freePackets)
+		delete packet;
+}
+
+CaptionAncillaryPacket* CaptionAncillaryPacketPool::acquire(CEA708::CDPReference userData)
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (!m_freePackets.empty())
+		{
+			CaptionAncillaryPacket* packet = m_freePackets.back();
+			m_freePackets.pop_back();
+			packet->reuse(std::move(userData));
+			return packet;
+		}
+	}
+	
+	return new CaptionAncillaryPacket(this, std::move(userData));
+}
+
+void CaptionAncillaryPacketPool::recycle(CaptionAncillaryPacket* packet)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_freePackets.push_back(packet);
+}
+
 class OutputCallback: public IDeckLinkVideoOutputCallback
 {
 	using ScheduledFrameCompletedCallback = std::function<void(IDeckLinkVideoFrame*)>;
@@ -273,7 +333,7 @@ HRESULT ScheduleNextFrame(CEA708::Encoder& CC708Encoder, IDeckLinkOutput* deckLi
 	HRESULT										result = S_OK;
 	IDeckLinkVideoFrameAncillaryPackets*		frameAncillaryPackets = NULL;
 	IDeckLinkAncillaryPacket*					ancillaryPacket = NULL;
-	CEA708::EncodedCaptionDistributionPacket	packet;
+	CEA708::CDPReference						packet;
 	
 	// Resend the given caption data every second.
 	unsigned fps = kTimeScale / kFrameDuration;
@@ -325,7 +385,11 @@ HRESULT ScheduleNextFrame(CEA708::Encoder& CC708Encoder, IDeckLinkOutput* deckLi
 			ancillaryPacket = NULL;
 		}
 		
-		result = frameAncillaryPackets->AttachPacket(new CaptionAncillaryPacket(packet));
+		// The ancillary packet borrows the encoded CDP, AttachPacket() takes its own reference
+		ancillaryPacket = gCaptionPacketPool.acquire(std::move(packet));
+		result = frameAncillaryPackets->AttachPacket(ancillaryPacket);
+		ancillaryPacket->Release();
+		ancillaryPacket = NULL;
 		if (result != S_OK)
 		{
 			fprintf(stderr, "Could not attach packet = %08x\n", result);
@@ -45,6 +45,10 @@ using namespace std::placeholders;
 
 using GetStatusDataFunc = std::function<QString(com_ptr<IDeckLinkStatus>&)>;
 
+#if defined(__linux__)
+static const int kTelemetryUpdateIntervalMs = 1000;
+#endif
+
 // Map of status IDs against getter function and display name
 static const std::map<BMDDeckLinkStatusID, std::pair<GetStatusDataFunc, QString>> kStatusItems =
 {
@@ -134,11 +138,19 @@ HRESULT DeckLinkNotificationCallback::Notify(BMDNotifications topic, uint64_t pa
 }
 
 DeckLinkStatusDataTableModel::DeckLinkStatusDataTableModel(QObject* parent) :
-	QAbstractTableModel(parent)
+	QAbstractTableModel(parent),
+	m_telemetryTimer(nullptr),
+	m_persistentID(0)
 {
 	m_delegate = make_com_ptr<DeckLinkNotificationCallback>();
 
 	connect(m_delegate.get(), &DeckLinkNotificationCallback::statusChanged, this, &DeckLinkStatusDataTableModel::statusChanged, Qt::QueuedConnection);
+
+#if defined(__linux__)
+	m_telemetryTimer = new QTimer(this);
+	connect(m_telemetryTimer, &QTimer::timeout, this, &DeckLinkStatusDataTableModel::telemetryTimeout);
+	m_telemetryTimer->start(kTelemetryUpdateIntervalMs);
+#endif
 }
 
 IDeckLinkNotificationCallback* DeckLinkStatusDataTableModel::delegate()
@@ -151,6 +163,23 @@ void DeckLinkStatusDataTableModel::reset(com_ptr<IDeckLink>& deckLink)
 	// Called whenever new device is selected
 	beginResetModel();
 	m_statusData.clear();
+	m_telemetryData.clear();
+
+	// Telemetry streams are matched to the device by persistent ID, or by name when it has none
+	com_ptr<IDeckLinkProfileAttributes> deckLinkAttributes(IID_IDeckLinkProfileAttributes, deckLink);
+	if (!deckLinkAttributes || deckLinkAttributes->GetInt(BMDDeckLinkPersistentID, &m_persistentID) != S_OK)
+		m_persistentID = 0;
+
+	dlstring_t displayName;
+	if (deckLink && deckLink->GetDisplayName(&displayName) == S_OK)
+	{
+		m_displayName = QString::fromStdString(DlToStdString(displayName));
+		DeleteString(displayName);
+	}
+	else
+	{
+		m_displayName.clear();
+	}
 
 	m_deckLinkStatus = com_ptr<IDeckLinkStatus>(IID_IDeckLinkStatus, deckLink);
 	if (!m_deckLinkStatus)
@@ -172,13 +201,15 @@ void DeckLinkStatusDataTableModel::reset(com_ptr<IDeckLink>& deckLink)
 	}
 
 	endResetModel();
+
+	telemetryTimeout();
 }
 
 
 int DeckLinkStatusDataTableModel::rowCount(const QModelIndex& parent) const
 {
 	Q_UNUSED(parent)
-	return static_cast<int>(m_statusData.size());
+	return static_cast<int>(m_statusData.size() + m_telemetryData.size());
 }
 
 int DeckLinkStatusDataTableModel::columnCount(const QModelIndex& parent) const
@@ -212,6 +243,15 @@ QVariant DeckLinkStatusDataTableModel::data(const QModelIndex& index, int role)
 				}
 			}
 		}
+
+		size_t telemetryIndex = static_cast<size_t>(index.row()) - m_statusData.size();
+		if (static_cast<size_t>(index.row()) >= m_statusData.size() && telemetryIndex < m_telemetryData.size())
+		{
+			if (index.column() == static_cast<int>(StatusDataTableHeader::Item))
+				return m_telemetryData[telemetryIndex].first;
+			else if (index.column() == static_cast<int>(StatusDataTableHeader::Value))
+				return m_telemetryData[telemetryIndex].second;
+		}
 	}
 
 	return QVariant();
@@ -284,6 +324,80 @@ void DeckLinkStatusDataTableModel::statusChanged(BMDDeckLinkStatusID statusID)
 	}
 }
 
+void DeckLinkStatusDataTableModel::updateTelemetryRows(std::vector<std::pair<QString, QString>>& telemetryData)
+{
+	int firstRow = static_cast<int>(m_statusData.size());
+
+	if (telemetryData.size() == m_telemetryData.size())
+	{
+		if (telemetryData.empty())
+			return;
+
+		m_telemetryData.swap(telemetryData);
+		emit dataChanged(index(firstRow, 0), index(firstRow + static_cast<int>(m_telemetryData.size()) - 1, static_cast<int>(StatusDataTableHeader::Count) - 1));
+		return;
+	}
+
+	// Processes started or stopped, replace the telemetry rows
+	if (!m_telemetryData.empty())
+	{
+		beginRemoveRows(QModelIndex(), firstRow, firstRow + static_cast<int>(m_telemetryData.size()) - 1);
+		m_telemetryData.clear();
+		endRemoveRows();
+	}
+
+	if (!telemetryData.empty())
+	{
+		beginInsertRows(QModelIndex(), firstRow, firstRow + static_cast<int>(telemetryData.size()) - 1);
+		m_telemetryData.swap(telemetryData);
+		endInsertRows();
+	}
+}
+
+void DeckLinkStatusDataTableModel::telemetryTimeout()
+{
+#if defined(__linux__)
+	std::vector<TelemetryStreamSnapshot>		streams;
+	std::vector<std::pair<QString, QString>>	telemetryData;
+
+	if (!m_deckLinkStatus)
+		return;
+
+	m_telemetryReader.refresh();
+	m_telemetryReader.readStreams(streams);
+
+	for (auto& stream : streams)
+	{
+		bool isDevice = (m_persistentID != 0) ? (stream.persistentID == m_persistentID) : (QString::fromStdString(stream.deviceName) == m_displayName);
+		if (!isDevice || !stream.processRunning)
+			continue;
+
+		bool isCapture = (stream.direction == Telemetry::StreamDirection::Capture);
+
+		QString item = QString("%1 (%2) %3").arg(QString::fromStdString(stream.processName)).arg(stream.processID).arg(isCapture ? "capture" : "playback");
+		QString value = QString("%1 frames, %2 dropped, %3 late")
+			.arg(stream.values[isCapture ? Telemetry::kCounterFramesIn : Telemetry::kCounterFramesOut])
+			.arg(stream.values[Telemetry::kCounterDroppedFrames])
+			.arg(stream.values[Telemetry::kCounterLateFrames]);
+
+		if (isCapture)
+			value += QString(", %1 available").arg(stream.values[Telemetry::kCounterBufferedVideoFrames]);
+		else
+			value += QString(", %1 buffered").arg(stream.values[Telemetry::kCounterBufferedVideoFrames]);
+
+		if (stream.values[Telemetry::kCounterLatencySampleCount] > 0)
+		{
+			value += QString(", latency p99 %1 ms")
+				.arg(Telemetry::getLatencyPercentile(&stream.values[Telemetry::kCounterLatencyBucket0], 99.0) / 1000.0, 0, 'f', 2);
+		}
+
+		telemetryData.push_back(std::make_pair(item, value));
+	}
+
+	updateTelemetryRows(telemetryData);
+#endif
+}
+
 // Status data getter functions
 
 QString getStatusFlag(com_ptr<IDeckLinkStatus>& deckLinkStatus, const BMDDeckLinkStatusID id)
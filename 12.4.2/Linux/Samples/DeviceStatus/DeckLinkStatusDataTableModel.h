@@ -41,6 +41,7 @@
 #pragma once
 
 #include <QAbstractTableModel>
+#include <QTimer>
 
 #include <atomic>
 #include <vector>
@@ -48,6 +49,9 @@
 #include "com_ptr.h"
 #include "platform.h"
 #include "DeckLinkAPI.h"
+#if defined(__linux__)
+#include "DeckLinkTelemetry.h"
+#endif
 
 class DeckLinkNotificationCallback : public QObject, public IDeckLinkNotificationCallback
 {
@@ -93,12 +97,25 @@ public:
 
 private slots:
 	void								statusChanged(BMDDeckLinkStatusID statusID);
+	void								telemetryTimeout(void);
 
 private:
 	com_ptr<IDeckLinkStatus>								m_deckLinkStatus;
 	com_ptr<DeckLinkNotificationCallback>					m_delegate;
 
 	std::vector<std::pair<BMDDeckLinkStatusID, QString>>	m_statusData;
+
+	// Streams of capture and playout processes using the device, published through shared memory
+	// telemetry, are listed after the status items.  Telemetry is only published on Linux
+#if defined(__linux__)
+	TelemetryReader											m_telemetryReader;
+#endif
+	QTimer*													m_telemetryTimer;
+	int64_t													m_persistentID;
+	QString													m_displayName;
+	std::vector<std::pair<QString, QString>>				m_telemetryData;
+
+	void								updateTelemetryRows(std::vector<std::pair<QString, QString>>& telemetryData);
 };
 
 // Status item getter functions
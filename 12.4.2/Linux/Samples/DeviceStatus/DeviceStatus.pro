@@ -50,9 +50,10 @@ INCLUDEPATH += .
 macx:INCLUDEPATH += ../../../Mac/include
 win32:INCLUDEPATH += ../../../Win/include
 unix:!mac:INCLUDEPATH += ../../../Linux/include
+unix:!mac:INCLUDEPATH += ../Telemetry
 
 macx:LIBS += -framework CoreFoundation
-unix:!mac:LIBS += -ldl
+unix:!mac:LIBS += -ldl -lrt
 win32:LIBS += -lole32 -lopengl32
 
 # The following define makes your compiler emit warnings if you use
@@ -74,6 +75,8 @@ SOURCES += main.cpp \
     platform.cpp
 
 unix:!macx:SOURCES += ../../../Linux/include/DeckLinkAPIDispatch.cpp
+unix:!macx:SOURCES += ../Telemetry/DeckLinkTelemetry.cpp
+unix:!macx:HEADERS += ../Telemetry/DeckLinkTelemetry.h
 macx:SOURCES += ../../../Mac/include/DeckLinkAPIDispatch.cpp
 
 HEADERS += \
@@ -41,6 +41,7 @@ QT += core gui
 
 INCLUDEPATH += .\
                src\
+               ../Pipeline\
                ../../include
 
 !versionAtLeast(QT_VERSION, 5.10) {
@@ -57,6 +58,8 @@ SOURCES += "src/main.cpp"\
            "src/ControllerImp.cpp"\
            "src/ControllerWidget.cpp"\
            "src/VideoWriter.cpp"\
+           "src/FragmentedMP4Writer.cpp"\
+           "src/NALIndex.cpp"\
            "src/DeckLinkDevice.cpp"\
            "src/CommonGui.cpp"\
            "src/ColourPalette.cpp"\
@@ -67,11 +70,14 @@ HEADERS += "src/MainWindow.h"\
            "src/ControllerImp.h"\
            "src/ControllerWidget.h"\
            "src/VideoWriter.h"\
+           "src/FragmentedMP4Writer.h"\
+           "src/NALIndex.h"\
            "src/DeckLinkDevice.h"\
            "src/CommonGui.h"\
            "src/ColourPalette.h"\
            "src/CommonGui.h"\
-           "src/CommonWidgets.h"
+           "src/CommonWidgets.h"\
+           "../Pipeline/SampleQueue.h"
 
 RC_FILE = H265TestEncoder.rc
 ICON    = Encoder_icon.icns
@@ -167,24 +167,21 @@ bool DeckLinkDevice::startCapture(int videoModeIndex, uint32_t bitrate)
 		return false;
 	}
 
+	IDeckLinkDisplayMode* displayMode = m_modeList[videoModeIndex];
+
 	BMDTimeValue duration, timeScale;
-	m_modeList[videoModeIndex]->GetFrameRate(&duration, &timeScale);
+	displayMode->GetFrameRate(&duration, &timeScale);
 
-	QString filePath = QStandardPaths::writableLocation(QStandardPaths::MoviesLocation);
-	QString fileName = filePath + "/BlackmagicDesign_Recording " + QDateTime::currentDateTime().toString("yyyy-MM-dd HH.mm.ss") + ".hevc";
+	FragmentedMP4Writer::VideoFormat videoFormat;
+	videoFormat.timeScale = timeScale;
+	videoFormat.frameDuration = duration;
+	videoFormat.width = (uint32_t)displayMode->GetWidth();
+	videoFormat.height = (uint32_t)displayMode->GetHeight();
 
-	m_videoWriter = new VideoWriter(fileName);
-	if (!m_videoWriter)
-	{
-		m_uiDelegate->showErrorMessage("Error starting recording", "Failed to allocate video writer");
-		return false;
-	}
-
-	if (!m_videoWriter->open())
-	{
-		m_uiDelegate->showErrorMessage("Error starting recording", "Failed to open output file");
-		return false;
-	}
+	FragmentedMP4Writer::AudioFormat audioFormat;
+	audioFormat.sampleRate = bmdAudioSampleRate48kHz;
+	audioFormat.channelCount = kAudioChannelCount;
+	audioFormat.bitsPerSample = bmdAudioSampleType16bitInteger;
 
 	if (m_deckLinkEncoderConfiguration->SetInt(bmdDeckLinkEncoderConfigPreferredBitDepth, 10) != S_OK)
 	{
@@ -220,9 +217,28 @@ bool DeckLinkDevice::startCapture(int videoModeIndex, uint32_t bitrate)
 		return false;
 	}
 
+	// Record without an audio track if the encoder can not capture audio
+	if (m_deckLinkEncoderInput->EnableAudioInput(bmdAudioFormatPCM, bmdAudioSampleRate48kHz, bmdAudioSampleType16bitInteger, kAudioChannelCount) != S_OK)
+		audioFormat.channelCount = 0;
+
+	QString filePath = QStandardPaths::writableLocation(QStandardPaths::MoviesLocation);
+	QString fileName = filePath + "/BlackmagicDesign_Recording " + QDateTime::currentDateTime().toString("yyyy-MM-dd HH.mm.ss") + ".mp4";
+
+	m_videoWriter = new VideoWriter(fileName, videoFormat, audioFormat);
+	if (!m_videoWriter->open())
+	{
+		m_uiDelegate->showErrorMessage("Error starting recording", "Failed to open output file");
+		delete m_videoWriter;
+		m_videoWriter = NULL;
+		return false;
+	}
+
 	if (m_deckLinkEncoderInput->StartStreams() != S_OK)
 	{
 		m_uiDelegate->showErrorMessage("Error starting the capture", "This application was unable to start the capture. Perhaps, the selected device is currently in-use.");
+		m_videoWriter->close(true);
+		delete m_videoWriter;
+		m_videoWriter = NULL;
 		return false;
 	}
 
@@ -236,6 +252,7 @@ void DeckLinkDevice::stopCapture(bool deleteFile)
 	m_deckLinkEncoderInput->StopStreams();
 	m_deckLinkEncoderInput->SetCallback(NULL);
 	m_deckLinkEncoderInput->DisableVideoInput();
+	m_deckLinkEncoderInput->DisableAudioInput();
 
 	if (m_videoWriter)
 	{
@@ -293,20 +310,17 @@ QString DeckLinkDevice::getDisplayModeName(int displayModeIndex)
 
 HRESULT DeckLinkDevice::VideoPacketArrived(IDeckLinkEncoderVideoPacket* videoPacket)
 {
-	void* buffer = NULL;
-	videoPacket->GetBytes(&buffer);
-
-	if (buffer && m_videoWriter)
-	{
-		if (videoPacket->GetPacketType() == bmdPacketTypeStreamData)
-			m_videoWriter->writeVideo((uint8_t*)buffer, videoPacket->GetSize());
-	}
+	if (m_videoWriter)
+		m_videoWriter->queueVideoPacket(videoPacket);
 
 	return S_OK;
 }
 
-HRESULT DeckLinkDevice::AudioPacketArrived(IDeckLinkEncoderAudioPacket*)
+HRESULT DeckLinkDevice::AudioPacketArrived(IDeckLinkEncoderAudioPacket* audioPacket)
 {
+	if (m_videoWriter)
+		m_videoWriter->queueAudioPacket(audioPacket);
+
 	return S_OK;
 }
 
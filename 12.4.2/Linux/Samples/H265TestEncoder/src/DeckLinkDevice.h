@@ -89,6 +89,7 @@ public:
 
 	
 private:
+	static const uint32_t	kAudioChannelCount = 2;
 
 	ControllerImp*			m_uiDelegate;
 	std::vector<IDeckLinkDisplayMode*>	m_modeList;
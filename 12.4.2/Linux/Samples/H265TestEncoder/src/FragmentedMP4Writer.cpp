@@ -0,0 +1,805 @@
+/* -LICENSE-START-
+ ** Copyright (c) 2015 Blackmagic Design
+ **  
+ ** Permission is hereby granted, free of charge, to any person or organization 
+ ** obtaining a copy of the software and accompanying documentation (the 
+ ** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+ ** and transmit the Software, and to prepare derivative works of the Software, 
+ ** and to permit third-parties to whom the Software is furnished to do so, in 
+ ** accordance with:
+ ** 
+ ** (1) if the Software is obtained from Blackmagic Design, the End User License 
+ ** Agreement for the Software Development Kit (“EULA”) available at 
+ ** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+ ** 
+ ** (2) if the Software is obtained from any third party, such licensing terms 
+ ** as notified by that third party,
+ ** 
+ ** and all subject to the following:
+ ** 
+ ** (3) the copyright notices in the Software and this entire statement, 
+ ** including the above license grant, this restriction and the following 
+ ** disclaimer, must be included in all copies of the Software, in whole or in 
+ ** part, and all derivative works of the Software, unless such copies or 
+ ** derivative works are solely in the form of machine-executable object code 
+ ** generated by a source language processor.
+ ** 
+ ** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+ ** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ ** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+ ** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+ ** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+ ** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+ ** DEALINGS IN THE SOFTWARE.
+ ** 
+ ** A copy of the Software is available free of charge at 
+ ** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+ ** 
+ ** -LICENSE-END-
+ */
+
+#include "FragmentedMP4Writer.h"
+#include <algorithm>
+#include <cstring>
+
+namespace
+{
+	// Fragment lengths in seconds
+	const int64_t	kFragmentDuration			= 1;
+	const int64_t	kMaximumFragmentDuration	= 2;
+	// Longest gap in the audio stream that is filled with silence to keep it in sync with video
+	const int64_t	kMaximumAudioGap			= 1;
+
+	// ITU-T H.265 Table 7-1 NAL unit type codes
+	enum NALUnitType
+	{
+		nalUnitTypeBLA_W_LP			= 16,
+		nalUnitTypeRSV_IRAP_VCL23	= 23,
+		nalUnitTypeVPS				= 32,
+		nalUnitTypeSPS				= 33,
+		nalUnitTypePPS				= 34,
+		nalUnitTypeAUD				= 35,
+		nalUnitTypePrefixSEI		= 39,
+		nalUnitTypeRSV_NVCL41		= 41,
+		nalUnitTypeRSV_NVCL44		= 44,
+		nalUnitTypeUNSPEC48			= 48,
+		nalUnitTypeUNSPEC55			= 55
+	};
+
+	// ISO/IEC 14496-12 8.8.3.1 sample flags
+	const uint32_t	kSyncSampleFlags	= 0x02000000;		// sample_depends_on = 2
+	const uint32_t	kNonSyncSampleFlags	= 0x01010000;		// sample_depends_on = 1, sample_is_non_sync_sample
+
+	// Appends big-endian fields and boxes to a buffer, patching box sizes when each box ends
+	class BoxWriter
+	{
+	public:
+		explicit BoxWriter(std::vector<uint8_t>& buffer) : m_buffer(buffer) { }
+
+		void u8(uint32_t value)		{ m_buffer.push_back((uint8_t)value); }
+		void u16(uint32_t value)	{ u8(value >> 8); u8(value); }
+		void u32(uint32_t value)	{ u16(value >> 16); u16(value); }
+		void u64(uint64_t value)	{ u32((uint32_t)(value >> 32)); u32((uint32_t)value); }
+		void fourcc(const char* code)	{ bytes((const uint8_t*)code, 4); }
+		void bytes(const uint8_t* data, size_t size)	{ m_buffer.insert(m_buffer.end(), data, data + size); }
+		void zeros(size_t count)	{ m_buffer.insert(m_buffer.end(), count, 0); }
+
+		size_t beginBox(const char* type)
+		{
+			size_t offset = m_buffer.size();
+			u32(0);
+			fourcc(type);
+			return offset;
+		}
+
+		size_t beginFullBox(const char* type, uint8_t version, uint32_t flags)
+		{
+			size_t offset = beginBox(type);
+			u32(((uint32_t)version << 24) | (flags & 0xFFFFFF));
+			return offset;
+		}
+
+		void endBox(size_t offset)
+		{
+			patch32(offset, (uint32_t)(m_buffer.size() - offset));
+		}
+
+		void patch32(size_t offset, uint32_t value)
+		{
+			m_buffer[offset]		= (uint8_t)(value >> 24);
+			m_buffer[offset + 1]	= (uint8_t)(value >> 16);
+			m_buffer[offset + 2]	= (uint8_t)(value >> 8);
+			m_buffer[offset + 3]	= (uint8_t)value;
+		}
+
+		size_t size() const			{ return m_buffer.size(); }
+
+		// Unity matrix of tkhd and mvhd
+		void matrix()
+		{
+			static const uint32_t kUnityMatrix[9] = { 0x00010000, 0, 0, 0, 0x00010000, 0, 0, 0, 0x40000000 };
+			for (uint32_t value : kUnityMatrix)
+				u32(value);
+		}
+
+	private:
+		std::vector<uint8_t>&	m_buffer;
+	};
+
+	// Reads an RBSP, with emulation prevention bytes removed, for the SPS fields the sample description needs
+	class BitReader
+	{
+	public:
+		BitReader(const std::vector<uint8_t>& nal) : m_position(0)
+		{
+			// Skip the 2 byte NAL unit header
+			for (size_t i = 2; i < nal.size(); i++)
+			{
+				if (i >= 4 && nal[i] == 3 && nal[i - 1] == 0 && nal[i - 2] == 0 && m_rbsp.size() >= 2 && m_rbsp[m_rbsp.size() - 1] == 0 && m_rbsp[m_rbsp.size() - 2] == 0)
+					continue;
+				m_rbsp.push_back(nal[i]);
+			}
+		}
+
+		uint32_t bits(uint32_t count)
+		{
+			uint32_t value = 0;
+			while (count-- > 0)
+			{
+				size_t byte = m_position / 8;
+				uint32_t bit = (byte < m_rbsp.size()) ? (m_rbsp[byte] >> (7 - (m_position % 8))) & 1 : 0;
+				value = (value << 1) | bit;
+				m_position++;
+			}
+			return value;
+		}
+
+		// Exp-Golomb unsigned integer, ITU-T H.265 9.2
+		uint32_t ue()
+		{
+			uint32_t leadingZeroBits = 0;
+			while (bits(1) == 0 && leadingZeroBits < 32)
+				leadingZeroBits++;
+			return ((1u << leadingZeroBits) - 1) + bits(leadingZeroBits);
+		}
+
+		void skip(uint32_t count)	{ m_position += count; }
+		bool isValid() const		{ return m_position <= m_rbsp.size() * 8; }
+		const std::vector<uint8_t>&	rbsp() const { return m_rbsp; }
+
+	private:
+		std::vector<uint8_t>	m_rbsp;
+		size_t					m_position;
+	};
+
+	bool isIRAP(uint8_t nalUnitType)
+	{
+		return nalUnitType >= nalUnitTypeBLA_W_LP && nalUnitType <= nalUnitTypeRSV_IRAP_VCL23;
+	}
+
+	// ITU-T H.265 7.4.2.4.4 - NAL units which, after a VCL NAL unit, begin the next access unit
+	bool startsAccessUnit(uint8_t nalUnitType)
+	{
+		return nalUnitType == nalUnitTypeVPS || nalUnitType == nalUnitTypeSPS || nalUnitType == nalUnitTypePPS ||
+			nalUnitType == nalUnitTypeAUD || nalUnitType == nalUnitTypePrefixSEI ||
+			(nalUnitType >= nalUnitTypeRSV_NVCL41 && nalUnitType <= nalUnitTypeRSV_NVCL44) ||
+			(nalUnitType >= nalUnitTypeUNSPEC48 && nalUnitType <= nalUnitTypeUNSPEC55);
+	}
+
+	void writeParameterSetArray(BoxWriter& box, uint8_t nalUnitType, const std::vector<uint8_t>& nal)
+	{
+		box.u8(nalUnitType & 0x3F);			// array_completeness = 0, parameter sets may also be in-band
+		box.u16(1);							// numNalus
+		box.u16((uint32_t)nal.size());
+		box.bytes(nal.data(), nal.size());
+	}
+
+	// ISO/IEC 14496-15 8.3.3.1 HEVCDecoderConfigurationRecord
+	void writeHEVCConfiguration(BoxWriter& box, const std::vector<uint8_t>& vps, const std::vector<uint8_t>& sps, const std::vector<uint8_t>& pps)
+	{
+		BitReader reader(sps);
+
+		reader.skip(4);												// sps_video_parameter_set_id
+		uint32_t maxSubLayersMinus1 = reader.bits(3);
+		uint32_t temporalIdNesting = reader.bits(1);
+
+		// The general profile_tier_level fields are copied as they are, 12 bytes from the second RBSP byte
+		uint8_t generalProfileTierLevel[12] = { 0 };
+		const std::vector<uint8_t>& rbsp = reader.rbsp();
+		if (rbsp.size() > 12)
+			memcpy(generalProfileTierLevel, &rbsp[1], sizeof(generalProfileTierLevel));
+		reader.skip(96);
+
+		// 7.3.3 profile_tier_level( 1, sps_max_sub_layers_minus1 ) - sub-layer fields
+		uint32_t subLayerProfilePresent = 0;
+		uint32_t subLayerLevelPresent = 0;
+		for (uint32_t i = 0; i < maxSubLayersMinus1; i++)
+		{
+			subLayerProfilePresent |= reader.bits(1) << i;
+			subLayerLevelPresent |= reader.bits(1) << i;
+		}
+		if (maxSubLayersMinus1 > 0)
+			reader.skip(2 * (8 - maxSubLayersMinus1));
+		for (uint32_t i = 0; i < maxSubLayersMinus1; i++)
+		{
+			if (subLayerProfilePresent & (1 << i))
+				reader.skip(88);
+			if (subLayerLevelPresent & (1 << i))
+				reader.skip(8);
+		}
+
+		reader.ue();												// sps_seq_parameter_set_id
+		uint32_t chromaFormat = reader.ue();
+		if (chromaFormat == 3)
+			reader.skip(1);											// separate_colour_plane_flag
+		reader.ue();												// pic_width_in_luma_samples
+		reader.ue();												// pic_height_in_luma_samples
+		if (reader.bits(1))											// conformance_window_flag
+		{
+			for (int i = 0; i < 4; i++)
+				reader.ue();
+		}
+		uint32_t bitDepthLumaMinus8 = reader.ue();
+		uint32_t bitDepthChromaMinus8 = reader.ue();
+
+		box.u8(1);													// configurationVersion
+		box.bytes(generalProfileTierLevel, sizeof(generalProfileTierLevel));
+		box.u16(0xF000);											// min_spatial_segmentation_idc = 0
+		box.u8(0xFC);												// parallelismType = 0
+		box.u8(0xFC | (chromaFormat & 0x3));
+		box.u8(0xF8 | (bitDepthLumaMinus8 & 0x7));
+		box.u8(0xF8 | (bitDepthChromaMinus8 & 0x7));
+		box.u16(0);													// avgFrameRate
+		box.u8(((maxSubLayersMinus1 + 1) << 3) | (temporalIdNesting << 2) | 3);	// lengthSizeMinusOne = 3
+		box.u8(3);													// numOfArrays
+		writeParameterSetArray(box, nalUnitTypeVPS, vps);
+		writeParameterSetArray(box, nalUnitTypeSPS, sps);
+		writeParameterSetArray(box, nalUnitTypePPS, pps);
+	}
+
+	void writeDataInformation(BoxWriter& box)
+	{
+		size_t dinf = box.beginBox("dinf");
+		size_t dref = box.beginFullBox("dref", 0, 0);
+		box.u32(1);
+		size_t url = box.beginFullBox("url ", 0, 1);				// Media data is in this file
+		box.endBox(url);
+		box.endBox(dref);
+		box.endBox(dinf);
+	}
+
+	// Sample tables are empty, samples are described by the movie fragments
+	void writeEmptySampleTables(BoxWriter& box)
+	{
+		size_t stts = box.beginFullBox("stts", 0, 0);
+		box.u32(0);
+		box.endBox(stts);
+		size_t stsc = box.beginFullBox("stsc", 0, 0);
+		box.u32(0);
+		box.endBox(stsc);
+		size_t stsz = box.beginFullBox("stsz", 0, 0);
+		box.u32(0);
+		box.u32(0);
+		box.endBox(stsz);
+		size_t stco = box.beginFullBox("stco", 0, 0);
+		box.u32(0);
+		box.endBox(stco);
+	}
+
+	void writeTrackHeader(BoxWriter& box, uint32_t trackID, bool isAudio, uint32_t width, uint32_t height)
+	{
+		size_t tkhd = box.beginFullBox("tkhd", 0, 0x3);				// track_enabled | track_in_movie
+		box.u32(0);													// creation_time
+		box.u32(0);													// modification_time
+		box.u32(trackID);
+		box.u32(0);
+		box.u32(0);													// duration, given by the fragments
+		box.zeros(8);
+		box.u16(0);													// layer
+		box.u16(0);													// alternate_group
+		box.u16(isAudio ? 0x0100 : 0);								// volume
+		box.u16(0);
+		box.matrix();
+		box.u32(width << 16);
+		box.u32(height << 16);
+		box.endBox(tkhd);
+	}
+
+	void writeMediaHeader(BoxWriter& box, uint32_t timeScale, const char* handlerType, const char* handlerName)
+	{
+		size_t mdhd = box.beginFullBox("mdhd", 0, 0);
+		box.u32(0);
+		box.u32(0);
+		box.u32(timeScale);
+		box.u32(0);
+		box.u16(0x55C4);											// 'und'
+		box.u16(0);
+		box.endBox(mdhd);
+
+		size_t hdlr = box.beginFullBox("hdlr", 0, 0);
+		box.u32(0);
+		box.fourcc(handlerType);
+		box.zeros(12);
+		box.bytes((const uint8_t*)handlerName, strlen(handlerName) + 1);
+		box.endBox(hdlr);
+	}
+
+	void writeTrackExtends(BoxWriter& box, uint32_t trackID, uint32_t defaultDuration, uint32_t defaultSize, uint32_t defaultFlags)
+	{
+		size_t trex = box.beginFullBox("trex", 0, 0);
+		box.u32(trackID);
+		box.u32(1);													// default_sample_description_index
+		box.u32(defaultDuration);
+		box.u32(defaultSize);
+		box.u32(defaultFlags);
+		box.endBox(trex);
+	}
+}
+
+FragmentedMP4Writer::FragmentedMP4Writer(FILE* file, const VideoFormat& videoFormat, const AudioFormat& audioFormat) :
+	m_file(file),
+	m_fileOffset(0),
+	m_indexWriter(NULL),
+	m_videoFormat(videoFormat),
+	m_audioFormat(audioFormat),
+	m_audioFrameSize(audioFormat.channelCount * (audioFormat.bitsPerSample / 8)),
+	m_failed(false),
+	m_headerWritten(false),
+	m_waitForIRAP(true),
+	m_accessUnitTime(0),
+	m_accessUnitHasVCL(false),
+	m_accessUnitIsIRAP(false),
+	m_audioFragmentStart(0),
+	m_audioPendingTime(0),
+	m_videoOrigin(0),
+	m_audioOrigin(0),
+	m_audioNextTime(0),
+	m_sequenceNumber(0)
+{
+}
+
+void FragmentedMP4Writer::addVideoNAL(const uint8_t* nal, uint32_t size, int64_t streamTime, uint32_t timecode)
+{
+	if (size < 2)
+		return;
+
+	uint8_t	nalUnitType			= (nal[0] >> 1) & 0x3F;
+	bool	isVCL				= nalUnitType < nalUnitTypeVPS;
+	bool	firstSliceInPicture	= isVCL && size > 2 && (nal[2] & 0x80);
+
+	// A new picture, or a non-VCL unit that precedes one, ends the current access unit
+	if (m_accessUnitHasVCL && (firstSliceInPicture || startsAccessUnit(nalUnitType) || streamTime != m_accessUnitTime))
+		completeAccessUnit(streamTime, true);
+
+	if (nalUnitType == nalUnitTypeVPS)
+		m_vps.assign(nal, nal + size);
+	else if (nalUnitType == nalUnitTypeSPS)
+		m_sps.assign(nal, nal + size);
+	else if (nalUnitType == nalUnitTypePPS)
+		m_pps.assign(nal, nal + size);
+
+	if (m_accessUnit.empty())
+		m_accessUnitTime = streamTime;
+
+	if (isVCL)
+	{
+		m_accessUnitHasVCL = true;
+		m_accessUnitIsIRAP |= isIRAP(nalUnitType);
+	}
+
+	if (m_indexWriter && (isIRAP(nalUnitType) || nalUnitType == nalUnitTypeVPS || nalUnitType == nalUnitTypeSPS || nalUnitType == nalUnitTypePPS))
+	{
+		NALIndexEntry entry = {};
+		entry.fileOffset	= m_accessUnit.size() + 4;
+		entry.streamTime	= streamTime;
+		entry.size			= size;
+		entry.timecode		= timecode;
+		entry.unitType		= nalUnitType;
+		m_accessUnitIndex.push_back(entry);
+	}
+
+	const uint8_t lengthPrefix[4] = { (uint8_t)(size >> 24), (uint8_t)(size >> 16), (uint8_t)(size >> 8), (uint8_t)size };
+	m_accessUnit.insert(m_accessUnit.end(), lengthPrefix, lengthPrefix + sizeof(lengthPrefix));
+	m_accessUnit.insert(m_accessUnit.end(), nal, nal + size);
+}
+
+void FragmentedMP4Writer::completeAccessUnit(int64_t nextStreamTime, bool haveNextStreamTime)
+{
+	if (!m_accessUnitHasVCL)
+		return;
+
+	bool	isSync	= m_accessUnitIsIRAP;
+	int64_t	time	= m_accessUnitTime;
+
+	// Decoding can only resume at an IRAP access unit, and the sample description needs its parameter sets
+	bool	keep	= !m_waitForIRAP || (isSync && !m_vps.empty() && !m_sps.empty() && !m_pps.empty());
+
+	if (keep)
+	{
+		m_waitForIRAP = false;
+
+		if (!m_headerWritten)
+		{
+			m_videoOrigin = time;
+			m_audioOrigin = (time * m_audioFormat.sampleRate) / m_videoFormat.timeScale;
+			writeHeader();
+			alignPendingAudio();
+		}
+
+		if (!m_videoSamples.empty())
+		{
+			int64_t fragmentLength = time - m_videoSamples.front().streamTime;
+			if ((isSync && fragmentLength >= kFragmentDuration * m_videoFormat.timeScale) || fragmentLength >= kMaximumFragmentDuration * m_videoFormat.timeScale)
+				writeFragment();
+		}
+
+		VideoSample sample;
+		sample.size			= (uint32_t)m_accessUnit.size();
+		sample.streamTime	= time;
+		sample.isSync		= isSync;
+
+		// Samples are in presentation order, so each lasts until the next begins
+		int64_t duration	= haveNextStreamTime ? nextStreamTime - time : 0;
+		sample.duration		= (duration > 0 && duration < 0x7FFFFFFF) ? (uint32_t)duration : (uint32_t)m_videoFormat.frameDuration;
+
+		m_videoSamples.push_back(sample);
+
+		for (NALIndexEntry& entry : m_accessUnitIndex)
+		{
+			entry.fileOffset += m_videoPayload.size();
+			m_fragmentIndex.push_back(entry);
+		}
+
+		m_videoPayload.insert(m_videoPayload.end(), m_accessUnit.begin(), m_accessUnit.end());
+	}
+
+	m_accessUnit.clear();
+	m_accessUnitIndex.clear();
+	m_accessUnitHasVCL = false;
+	m_accessUnitIsIRAP = false;
+}
+
+void FragmentedMP4Writer::addAudio(const uint8_t* data, uint32_t size, int64_t streamTime)
+{
+	if (m_audioFrameSize == 0)
+		return;
+
+	int64_t frameCount = size / m_audioFrameSize;
+
+	if (!m_headerWritten)
+	{
+		// Hold the most recent contiguous audio until the first video sample sets the origin
+		int64_t pendingFrameCount = m_audioPayload.size() / m_audioFrameSize;
+		if (m_audioPayload.empty() || streamTime != m_audioPendingTime + pendingFrameCount)
+		{
+			m_audioPayload.clear();
+			m_audioPendingTime = streamTime;
+		}
+		m_audioPayload.insert(m_audioPayload.end(), data, data + frameCount * m_audioFrameSize);
+
+		int64_t excess = (int64_t)(m_audioPayload.size() / m_audioFrameSize) - kMaximumAudioGap * m_audioFormat.sampleRate;
+		if (excess > 0)
+		{
+			m_audioPayload.erase(m_audioPayload.begin(), m_audioPayload.begin() + excess * m_audioFrameSize);
+			m_audioPendingTime += excess;
+		}
+		return;
+	}
+
+	int64_t startTime = streamTime - m_audioOrigin;
+
+	if (m_audioPayload.empty())
+		m_audioFragmentStart = m_audioNextTime;
+
+	if (startTime > m_audioNextTime && startTime - m_audioNextTime <= kMaximumAudioGap * m_audioFormat.sampleRate)
+	{
+		// Fill a gap with silence, so that audio stays in sync with video
+		m_audioPayload.insert(m_audioPayload.end(), (startTime - m_audioNextTime) * m_audioFrameSize, 0);
+		m_audioNextTime = startTime;
+	}
+	else if (startTime < m_audioNextTime)
+	{
+		// Trim frames that overlap audio already written
+		int64_t overlap = std::min(m_audioNextTime - startTime, frameCount);
+		data += overlap * m_audioFrameSize;
+		frameCount -= overlap;
+	}
+
+	m_audioPayload.insert(m_audioPayload.end(), data, data + frameCount * m_audioFrameSize);
+	m_audioNextTime += frameCount;
+}
+
+void FragmentedMP4Writer::alignPendingAudio()
+{
+	if (m_audioFrameSize == 0 || m_audioPayload.empty())
+		return;
+
+	// Audio held before the header starts the first fragment, trimmed or padded to the first video sample
+	int64_t offset = m_audioPendingTime - m_audioOrigin;
+	if (offset < 0)
+		m_audioPayload.erase(m_audioPayload.begin(), m_audioPayload.begin() + std::min((size_t)-offset * m_audioFrameSize, m_audioPayload.size()));
+	else if (offset <= kMaximumAudioGap * m_audioFormat.sampleRate)
+		m_audioPayload.insert(m_audioPayload.begin(), offset * m_audioFrameSize, 0);
+	else
+		m_audioPayload.clear();
+
+	m_audioFragmentStart = 0;
+	m_audioNextTime = m_audioPayload.size() / m_audioFrameSize;
+}
+
+void FragmentedMP4Writer::discontinuity()
+{
+	completeAccessUnit(0, false);
+	writeFragment();
+
+	m_accessUnit.clear();
+	m_accessUnitIndex.clear();
+	m_accessUnitHasVCL = false;
+	m_accessUnitIsIRAP = false;
+	m_waitForIRAP = true;
+}
+
+bool FragmentedMP4Writer::finish()
+{
+	completeAccessUnit(0, false);
+	writeFragment();
+
+	if (m_file && fflush(m_file) != 0)
+		m_failed = true;
+
+	return !m_failed;
+}
+
+void FragmentedMP4Writer::writeHeader()
+{
+	std::vector<uint8_t>	header;
+	BoxWriter				box(header);
+	bool					hasAudio = m_audioFrameSize != 0;
+
+	size_t ftyp = box.beginBox("ftyp");
+	box.fourcc("isom");
+	box.u32(0x200);
+	box.fourcc("isom");
+	box.fourcc("iso6");
+	box.fourcc("mp41");
+	box.endBox(ftyp);
+
+	size_t moov = box.beginBox("moov");
+
+	size_t mvhd = box.beginFullBox("mvhd", 0, 0);
+	box.u32(0);
+	box.u32(0);
+	box.u32(1000);												// timescale
+	box.u32(0);													// duration, given by the fragments
+	box.u32(0x00010000);										// rate
+	box.u16(0x0100);											// volume
+	box.zeros(10);
+	box.matrix();
+	box.zeros(24);
+	box.u32(hasAudio ? 3 : 2);									// next_track_ID
+	box.endBox(mvhd);
+
+	// Video track
+	{
+		size_t trak = box.beginBox("trak");
+		writeTrackHeader(box, 1, false, m_videoFormat.width, m_videoFormat.height);
+
+		size_t mdia = box.beginBox("mdia");
+		writeMediaHeader(box, (uint32_t)m_videoFormat.timeScale, "vide", "VideoHandler");
+
+		size_t minf = box.beginBox("minf");
+		size_t vmhd = box.beginFullBox("vmhd", 0, 1);
+		box.zeros(8);												// graphicsmode, opcolor
+		box.endBox(vmhd);
+		writeDataInformation(box);
+
+		size_t stbl = box.beginBox("stbl");
+		size_t stsd = box.beginFullBox("stsd", 0, 0);
+		box.u32(1);
+
+		// ISO/IEC 14496-15 8.4.1 - parameter sets are also kept in-band, so the entry is 'hev1'
+		size_t hev1 = box.beginBox("hev1");
+		box.zeros(6);
+		box.u16(1);													// data_reference_index
+		box.zeros(16);
+		box.u16(m_videoFormat.width);
+		box.u16(m_videoFormat.height);
+		box.u32(0x00480000);										// 72 dpi
+		box.u32(0x00480000);
+		box.u32(0);
+		box.u16(1);													// frame_count
+		box.zeros(32);												// compressorname
+		box.u16(0x0018);											// depth
+		box.u16(0xFFFF);											// pre_defined = -1
+
+		size_t hvcC = box.beginBox("hvcC");
+		writeHEVCConfiguration(box, m_vps, m_sps, m_pps);
+		box.endBox(hvcC);
+		box.endBox(hev1);
+		box.endBox(stsd);
+
+		writeEmptySampleTables(box);
+		box.endBox(stbl);
+		box.endBox(minf);
+		box.endBox(mdia);
+		box.endBox(trak);
+	}
+
+	// Audio track
+	if (hasAudio)
+	{
+		size_t trak = box.beginBox("trak");
+		writeTrackHeader(box, 2, true, 0, 0);
+
+		size_t mdia = box.beginBox("mdia");
+		writeMediaHeader(box, m_audioFormat.sampleRate, "soun", "SoundHandler");
+
+		size_t minf = box.beginBox("minf");
+		size_t smhd = box.beginFullBox("smhd", 0, 0);
+		box.u32(0);													// balance, reserved
+		box.endBox(smhd);
+		writeDataInformation(box);
+
+		size_t stbl = box.beginBox("stbl");
+		size_t stsd = box.beginFullBox("stsd", 0, 0);
+		box.u32(1);
+
+		// ISO/IEC 23003-5 uncompressed integer PCM
+		size_t ipcm = box.beginBox("ipcm");
+		box.zeros(6);
+		box.u16(1);													// data_reference_index
+		box.zeros(8);
+		box.u16(m_audioFormat.channelCount);
+		box.u16(m_audioFormat.bitsPerSample);
+		box.u32(0);													// pre_defined, reserved
+		box.u32(m_audioFormat.sampleRate << 16);
+
+		size_t pcmC = box.beginFullBox("pcmC", 0, 0);
+		box.u8(1);													// format_flags, little endian
+		box.u8(m_audioFormat.bitsPerSample);
+		box.endBox(pcmC);
+		box.endBox(ipcm);
+		box.endBox(stsd);
+
+		writeEmptySampleTables(box);
+		box.endBox(stbl);
+		box.endBox(minf);
+		box.endBox(mdia);
+		box.endBox(trak);
+	}
+
+	size_t mvex = box.beginBox("mvex");
+	writeTrackExtends(box, 1, (uint32_t)m_videoFormat.frameDuration, 0, kNonSyncSampleFlags);
+	if (hasAudio)
+		writeTrackExtends(box, 2, 1, m_audioFrameSize, kSyncSampleFlags);
+	box.endBox(mvex);
+
+	box.endBox(moov);
+
+	write(header);
+	if (m_file && fflush(m_file) != 0)
+		m_failed = true;
+
+	m_headerWritten = true;
+}
+
+void FragmentedMP4Writer::writeFragment()
+{
+	if (!m_headerWritten || (m_videoSamples.empty() && m_audioPayload.empty()))
+		return;
+
+	const uint32_t	kDefaultBaseIsMoof	= 0x020000;
+	const uint32_t	kDataOffsetPresent	= 0x000001;
+	const uint32_t	kSampleFieldFlags	= 0x000100 | 0x000200 | 0x000400;	// duration, size and flags per sample
+
+	size_t			videoDataOffset		= 0;
+	size_t			audioDataOffset		= 0;
+
+	m_moof.clear();
+	BoxWriter box(m_moof);
+
+	size_t moof = box.beginBox("moof");
+
+	size_t mfhd = box.beginFullBox("mfhd", 0, 0);
+	box.u32(++m_sequenceNumber);
+	box.endBox(mfhd);
+
+	if (!m_videoSamples.empty())
+	{
+		size_t traf = box.beginBox("traf");
+		size_t tfhd = box.beginFullBox("tfhd", 0, kDefaultBaseIsMoof);
+		box.u32(1);
+		box.endBox(tfhd);
+
+		size_t tfdt = box.beginFullBox("tfdt", 1, 0);
+		box.u64(m_videoSamples.front().streamTime - m_videoOrigin);
+		box.endBox(tfdt);
+
+		size_t trun = box.beginFullBox("trun", 0, kDataOffsetPresent | kSampleFieldFlags);
+		box.u32((uint32_t)m_videoSamples.size());
+		videoDataOffset = box.size();
+		box.u32(0);
+		for (const VideoSample& sample : m_videoSamples)
+		{
+			box.u32(sample.duration);
+			box.u32(sample.size);
+			box.u32(sample.isSync ? kSyncSampleFlags : kNonSyncSampleFlags);
+		}
+		box.endBox(trun);
+		box.endBox(traf);
+	}
+
+	if (!m_audioPayload.empty())
+	{
+		size_t traf = box.beginBox("traf");
+		size_t tfhd = box.beginFullBox("tfhd", 0, kDefaultBaseIsMoof);
+		box.u32(2);
+		box.endBox(tfhd);
+
+		size_t tfdt = box.beginFullBox("tfdt", 1, 0);
+		box.u64(m_audioFragmentStart);
+		box.endBox(tfdt);
+
+		// Each PCM frame is a sample, with the duration and size given by trex
+		size_t trun = box.beginFullBox("trun", 0, kDataOffsetPresent);
+		box.u32((uint32_t)(m_audioPayload.size() / m_audioFrameSize));
+		audioDataOffset = box.size();
+		box.u32(0);
+		box.endBox(trun);
+		box.endBox(traf);
+	}
+
+	box.endBox(moof);
+
+	// Data offsets are relative to the start of the moof, the mdat follows it
+	size_t mdatHeaderSize = 8;
+	if (videoDataOffset)
+		box.patch32(videoDataOffset, (uint32_t)(m_moof.size() + mdatHeaderSize));
+	if (audioDataOffset)
+		box.patch32(audioDataOffset, (uint32_t)(m_moof.size() + mdatHeaderSize + m_videoPayload.size()));
+
+	box.u32((uint32_t)(mdatHeaderSize + m_videoPayload.size() + m_audioPayload.size()));
+	box.fourcc("mdat");
+
+	uint64_t videoPayloadOffset = m_fileOffset + m_moof.size();
+
+	write(m_moof);
+	write(m_videoPayload.data(), m_videoPayload.size());
+	write(m_audioPayload.data(), m_audioPayload.size());
+
+	// Hand the complete fragment to the operating system, so it survives the process
+	if (m_file && fflush(m_file) != 0)
+		m_failed = true;
+
+	// The index only refers to media already in the file
+	if (m_indexWriter && !m_failed)
+	{
+		for (NALIndexEntry& entry : m_fragmentIndex)
+		{
+			entry.fileOffset += videoPayloadOffset;
+			m_indexWriter->addEntry(entry);
+		}
+		m_indexWriter->flush();
+	}
+
+	m_videoSamples.clear();
+	m_videoPayload.clear();
+	m_fragmentIndex.clear();
+	m_audioPayload.clear();
+}
+
+void FragmentedMP4Writer::write(const std::vector<uint8_t>& buffer)
+{
+	write(buffer.data(), buffer.size());
+}
+
+void FragmentedMP4Writer::write(const uint8_t* data, size_t size)
+{
+	if (m_failed || !m_file || size == 0)
+		return;
+
+	if (fwrite(data, 1, size, m_file) != size)
+		m_failed = true;
+	else
+		m_fileOffset += size;
+}
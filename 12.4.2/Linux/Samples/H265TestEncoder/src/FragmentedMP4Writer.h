@@ -0,0 +1,143 @@
+/* -LICENSE-START-
+ ** Copyright (c) 2015 Blackmagic Design
+ **  
+ ** Permission is hereby granted, free of charge, to any person or organization 
+ ** obtaining a copy of the software and accompanying documentation (the 
+ ** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+ ** and transmit the Software, and to prepare derivative works of the Software, 
+ ** and to permit third-parties to whom the Software is furnished to do so, in 
+ ** accordance with:
+ ** 
+ ** (1) if the Software is obtained from Blackmagic Design, the End User License 
+ ** Agreement for the Software Development Kit (“EULA”) available at 
+ ** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+ ** 
+ ** (2) if the Software is obtained from any third party, such licensing terms 
+ ** as notified by that third party,
+ ** 
+ ** and all subject to the following:
+ ** 
+ ** (3) the copyright notices in the Software and this entire statement, 
+ ** including the above license grant, this restriction and the following 
+ ** disclaimer, must be included in all copies of the Software, in whole or in 
+ ** part, and all derivative works of the Software, unless such copies or 
+ ** derivative works are solely in the form of machine-executable object code 
+ ** generated by a source language processor.
+ ** 
+ ** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+ ** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ ** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+ ** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+ ** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+ ** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+ ** DEALINGS IN THE SOFTWARE.
+ ** 
+ ** A copy of the Software is available free of charge at 
+ ** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+ ** 
+ ** -LICENSE-END-
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <cstdio>
+#include <vector>
+#include "NALIndex.h"
+
+// Muxes H.265 NAL units and PCM audio into a fragmented MP4 file (ISO/IEC 14496-12, 14496-15 and 23003-5).
+//
+// NAL units are grouped into access units and stored length-prefixed as 'hev1' samples.  The movie header is
+// written once the first IRAP access unit and its parameter sets have arrived.  After that each fragment
+// (moof + mdat) carries its own sample table, and is written in full and flushed as soon as it closes.  A
+// recording therefore stays playable up to its last complete fragment if the process is killed.  Fragments
+// close at the first IRAP access unit after one second, or after two seconds regardless.
+class FragmentedMP4Writer
+{
+public:
+	struct VideoFormat
+	{
+		int64_t		timeScale;
+		int64_t		frameDuration;
+		uint32_t	width;
+		uint32_t	height;
+	};
+
+	struct AudioFormat
+	{
+		uint32_t	sampleRate;
+		uint32_t	channelCount;			// Zero when there is no audio track
+		uint32_t	bitsPerSample;			// Interleaved little-endian signed integer samples
+	};
+
+	FragmentedMP4Writer(FILE* file, const VideoFormat& videoFormat, const AudioFormat& audioFormat);
+
+	// Index parameter sets and IRAP pictures as their fragments are written
+	void					setIndexWriter(NALIndexWriter* indexWriter) { m_indexWriter = indexWriter; }
+
+	// Add an H.265 NAL unit without its start code prefix, with its stream time in the video time scale and
+	// the BCD timecode of its picture
+	void					addVideoNAL(const uint8_t* nal, uint32_t size, int64_t streamTime, uint32_t timecode = kNALIndexNoTimecode);
+	// Add PCM sample frames, with the stream time of the first frame in the audio sample rate.  Audio that
+	// arrives before the first video sample is held, up to one second of it, and aligned to that sample.
+	void					addAudio(const uint8_t* data, uint32_t size, int64_t streamTime);
+	// The stream was interrupted or packets were lost; close the fragment and resume at the next IRAP
+	void					discontinuity();
+	// Write the buffered access unit and fragment
+	bool					finish();
+
+	bool					hasFailed() const { return m_failed; }
+	uint32_t				getFragmentCount() const { return m_sequenceNumber; }
+
+private:
+	struct VideoSample
+	{
+		uint32_t			size;
+		int64_t				streamTime;
+		uint32_t			duration;
+		bool				isSync;
+	};
+
+	void					completeAccessUnit(int64_t nextStreamTime, bool haveNextStreamTime);
+	void					writeHeader();
+	void					alignPendingAudio();
+	void					writeFragment();
+	void					write(const std::vector<uint8_t>& buffer);
+	void					write(const uint8_t* data, size_t size);
+
+	FILE*					m_file;
+	uint64_t				m_fileOffset;
+	NALIndexWriter*			m_indexWriter;
+	VideoFormat				m_videoFormat;
+	AudioFormat				m_audioFormat;
+	uint32_t				m_audioFrameSize;
+	bool					m_failed;
+	bool					m_headerWritten;
+	bool					m_waitForIRAP;
+
+	// Most recent parameter sets, the first complete set is written to the sample description
+	std::vector<uint8_t>	m_vps;
+	std::vector<uint8_t>	m_sps;
+	std::vector<uint8_t>	m_pps;
+
+	// Access unit being assembled, as length-prefixed NAL units
+	std::vector<uint8_t>	m_accessUnit;
+	int64_t					m_accessUnitTime;
+	bool					m_accessUnitHasVCL;
+	bool					m_accessUnitIsIRAP;
+	std::vector<NALIndexEntry>	m_accessUnitIndex;		// File offsets are relative to the access unit
+
+	// Fragment being assembled
+	std::vector<VideoSample>	m_videoSamples;
+	std::vector<uint8_t>	m_videoPayload;
+	std::vector<NALIndexEntry>	m_fragmentIndex;		// File offsets are relative to the video payload
+	std::vector<uint8_t>	m_audioPayload;
+	int64_t					m_audioFragmentStart;
+	int64_t					m_audioPendingTime;		// Stream time of audio held before the header is written
+	std::vector<uint8_t>	m_moof;
+
+	int64_t					m_videoOrigin;			// Stream time of the first sample, in the video time scale
+	int64_t					m_audioOrigin;			// The same instant in the audio sample rate
+	int64_t					m_audioNextTime;		// Decode time of the next audio frame, relative to the origin
+	uint32_t				m_sequenceNumber;
+};
@@ -0,0 +1,305 @@
+/* -LICENSE-START-
+ ** Copyright (c) 2015 Blackmagic Design
+ **  
+ ** Permission is hereby granted, free of charge, to any person or organization 
+ ** obtaining a copy of the software and accompanying documentation (the 
+ ** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+ ** and transmit the Software, and to prepare derivative works of the Software, 
+ ** and to permit third-parties to whom the Software is furnished to do so, in 
+ ** accordance with:
+ ** 
+ ** (1) if the Software is obtained from Blackmagic Design, the End User License 
+ ** Agreement for the Software Development Kit (“EULA”) available at 
+ ** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+ ** 
+ ** (2) if the Software is obtained from any third party, such licensing terms 
+ ** as notified by that third party,
+ ** 
+ ** and all subject to the following:
+ ** 
+ ** (3) the copyright notices in the Software and this entire statement, 
+ ** including the above license grant, this restriction and the following 
+ ** disclaimer, must be included in all copies of the Software, in whole or in 
+ ** part, and all derivative works of the Software, unless such copies or 
+ ** derivative works are solely in the form of machine-executable object code 
+ ** generated by a source language processor.
+ ** 
+ ** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+ ** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ ** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+ ** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+ ** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+ ** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+ ** DEALINGS IN THE SOFTWARE.
+ ** 
+ ** A copy of the Software is available free of charge at 
+ ** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+ ** 
+ ** -LICENSE-END-
+ */
+
+#include "NALIndex.h"
+#include <cstring>
+
+namespace
+{
+	const char		kIndexMagic[8]		= { 'H', '2', '6', '5', 'N', 'I', 'D', 'X' };
+	const uint32_t	kIndexVersion		= 1;
+	const uint32_t	kIndexHeaderSize	= 32;
+	const uint32_t	kIndexRecordSize	= 40;
+
+	// ITU-T H.265 Table 7-1
+	const uint8_t	kNalUnitTypeIRAPFirst	= 16;
+	const uint8_t	kNalUnitTypeIRAPLast	= 23;
+	const uint8_t	kNalUnitTypeVPS			= 32;
+	const uint8_t	kNalUnitTypeSPS			= 33;
+	const uint8_t	kNalUnitTypePPS			= 34;
+
+	void putLE(uint8_t* buffer, uint64_t value, int size)
+	{
+		for (int i = 0; i < size; i++)
+			buffer[i] = (uint8_t)(value >> (8 * i));
+	}
+
+	uint64_t getLE(const uint8_t* buffer, int size)
+	{
+		uint64_t value = 0;
+		for (int i = size - 1; i >= 0; i--)
+			value = (value << 8) | buffer[i];
+		return value;
+	}
+
+	bool isIRAP(uint8_t unitType)
+	{
+		return unitType >= kNalUnitTypeIRAPFirst && unitType <= kNalUnitTypeIRAPLast;
+	}
+}
+
+NALIndexWriter::NALIndexWriter(FILE* file, int64_t timeScale) :
+	m_file(file),
+	m_recordCount(0),
+	m_vpsRecord(kNALIndexNoRecord),
+	m_spsRecord(kNALIndexNoRecord),
+	m_ppsRecord(kNALIndexNoRecord),
+	m_failed(false)
+{
+	uint8_t header[kIndexHeaderSize] = { 0 };
+	memcpy(header, kIndexMagic, sizeof(kIndexMagic));
+	putLE(header + 8, kIndexVersion, 4);
+	putLE(header + 12, kIndexRecordSize, 4);
+	putLE(header + 16, (uint64_t)timeScale, 8);
+	m_buffer.assign(header, header + sizeof(header));
+}
+
+void NALIndexWriter::addEntry(NALIndexEntry entry)
+{
+	uint32_t record = m_recordCount++;
+
+	if (entry.unitType == kNalUnitTypeVPS)
+		m_vpsRecord = record;
+	else if (entry.unitType == kNalUnitTypeSPS)
+		m_spsRecord = record;
+	else if (entry.unitType == kNalUnitTypePPS)
+		m_ppsRecord = record;
+
+	uint8_t buffer[kIndexRecordSize] = { 0 };
+	putLE(buffer, entry.fileOffset, 8);
+	putLE(buffer + 8, (uint64_t)entry.streamTime, 8);
+	putLE(buffer + 16, entry.size, 4);
+	putLE(buffer + 20, entry.timecode, 4);
+	putLE(buffer + 24, m_vpsRecord, 4);
+	putLE(buffer + 28, m_spsRecord, 4);
+	putLE(buffer + 32, m_ppsRecord, 4);
+	buffer[36] = entry.unitType;
+
+	m_buffer.insert(m_buffer.end(), buffer, buffer + sizeof(buffer));
+}
+
+bool NALIndexWriter::flush()
+{
+	if (m_failed || !m_file)
+		return false;
+
+	if (!m_buffer.empty())
+	{
+		if (fwrite(m_buffer.data(), 1, m_buffer.size(), m_file) != m_buffer.size() || fflush(m_file) != 0)
+			m_failed = true;
+		m_buffer.clear();
+	}
+
+	return !m_failed;
+}
+
+NALIndexReader::NALIndexReader() :
+	m_file(NULL),
+	m_recordCount(0),
+	m_timeScale(0)
+{
+}
+
+NALIndexReader::~NALIndexReader()
+{
+	close();
+}
+
+bool NALIndexReader::open(const char* filename)
+{
+	close();
+
+	m_file = fopen(filename, "rb");
+	if (!m_file)
+		return false;
+
+	uint8_t header[kIndexHeaderSize];
+	if (fread(header, 1, sizeof(header), m_file) != sizeof(header) ||
+		memcmp(header, kIndexMagic, sizeof(kIndexMagic)) != 0 ||
+		getLE(header + 8, 4) != kIndexVersion ||
+		getLE(header + 12, 4) != kIndexRecordSize)
+	{
+		close();
+		return false;
+	}
+
+	m_timeScale = (int64_t)getLE(header + 16, 8);
+
+	// A partial record at the end of an interrupted recording is ignored
+	if (fseeko(m_file, 0, SEEK_END) != 0)
+	{
+		close();
+		return false;
+	}
+	m_recordCount = (uint32_t)((ftello(m_file) - kIndexHeaderSize) / kIndexRecordSize);
+
+	return true;
+}
+
+void NALIndexReader::close()
+{
+	if (m_file)
+	{
+		fclose(m_file);
+		m_file = NULL;
+	}
+	m_recordCount = 0;
+}
+
+bool NALIndexReader::readEntry(uint32_t record, NALIndexEntry& entry)
+{
+	uint8_t buffer[kIndexRecordSize];
+
+	if (!m_file || record >= m_recordCount)
+		return false;
+
+	if (fseeko(m_file, kIndexHeaderSize + (off_t)record * kIndexRecordSize, SEEK_SET) != 0 ||
+		fread(buffer, 1, sizeof(buffer), m_file) != sizeof(buffer))
+		return false;
+
+	entry.fileOffset	= getLE(buffer, 8);
+	entry.streamTime	= (int64_t)getLE(buffer + 8, 8);
+	entry.size			= (uint32_t)getLE(buffer + 16, 4);
+	entry.timecode		= (uint32_t)getLE(buffer + 20, 4);
+	entry.vpsRecord		= (uint32_t)getLE(buffer + 24, 4);
+	entry.spsRecord		= (uint32_t)getLE(buffer + 28, 4);
+	entry.ppsRecord		= (uint32_t)getLE(buffer + 32, 4);
+	entry.unitType		= buffer[36];
+
+	return true;
+}
+
+bool NALIndexReader::seekToTimecode(uint32_t timecodeBCD, NALIndexSeekPoint& seekPoint)
+{
+	NALIndexEntry	first;
+	NALIndexEntry	last;
+	uint32_t		record;
+
+	if (timecodeBCD == kNALIndexNoTimecode)
+		return false;
+
+	// The first and last IRAP pictures with a timecode; pictures captured without one are never seek points
+	for (record = 0; ; record++)
+	{
+		if (!readEntry(record, first))
+			return false;
+		if (isIRAP(first.unitType) && first.timecode != kNALIndexNoTimecode)
+			break;
+	}
+
+	for (record = m_recordCount; ; )
+	{
+		if (!readEntry(--record, last))
+			return false;
+		if (isIRAP(last.unitType) && last.timecode != kNALIndexNoTimecode)
+			break;
+	}
+
+	// Packed BCD hours, minutes, seconds and frames order the same way as the timecodes they encode.  A
+	// recording that ends with an earlier timecode than it starts with has passed midnight, so timecodes
+	// before the first are a day later; recordings are taken to be shorter than a day.
+	const uint32_t	firstTimecode	= first.timecode;
+	const bool		passesMidnight	= last.timecode < firstTimecode;
+	auto			dayTimecode		= [firstTimecode, passesMidnight](uint32_t timecode)
+	{
+		return (int64_t)timecode + ((passesMidnight && timecode < firstTimecode) ? (1LL << 32) : 0);
+	};
+
+	return seek([&dayTimecode](const NALIndexEntry& entry, int64_t& key)
+	{
+		if (entry.timecode == kNALIndexNoTimecode)
+			return false;
+
+		key = dayTimecode(entry.timecode);
+		return true;
+	}, dayTimecode(timecodeBCD), seekPoint);
+}
+
+bool NALIndexReader::seekToStreamTime(int64_t streamTime, NALIndexSeekPoint& seekPoint)
+{
+	return seek([](const NALIndexEntry& entry, int64_t& key)
+	{
+		key = entry.streamTime;
+		return true;
+	}, streamTime, seekPoint);
+}
+
+template<typename KeyFunction>
+bool NALIndexReader::seek(KeyFunction key, int64_t target, NALIndexSeekPoint& seekPoint)
+{
+	NALIndexEntry	entry;
+	int64_t			entryKey;
+	uint32_t		low = 0;
+	uint32_t		high = m_recordCount;
+	bool			found = false;
+
+	// Binary search for the last IRAP picture with a key at or before the target.  Only IRAP pictures with
+	// a key are compared, so each probe steps forward from the middle to the next one; parameter sets sent
+	// with a picture precede it, so this is usually a few records.
+	while (low < high)
+	{
+		uint32_t middle = low + (high - low) / 2;
+		uint32_t record = middle;
+
+		for (; record < high; record++)
+		{
+			if (!readEntry(record, entry))
+				return false;
+			if (isIRAP(entry.unitType) && key(entry, entryKey))
+				break;
+		}
+
+		if (record < high && entryKey <= target)
+		{
+			seekPoint.irap	= entry;
+			found			= true;
+			low				= record + 1;
+		}
+		else
+		{
+			high = middle;
+		}
+	}
+
+	return found &&
+		readEntry(seekPoint.irap.vpsRecord, seekPoint.vps) &&
+		readEntry(seekPoint.irap.spsRecord, seekPoint.sps) &&
+		readEntry(seekPoint.irap.ppsRecord, seekPoint.pps);
+}
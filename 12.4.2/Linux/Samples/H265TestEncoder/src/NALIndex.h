@@ -0,0 +1,128 @@
+/* -LICENSE-START-
+ ** Copyright (c) 2015 Blackmagic Design
+ **  
+ ** Permission is hereby granted, free of charge, to any person or organization 
+ ** obtaining a copy of the software and accompanying documentation (the 
+ ** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+ ** and transmit the Software, and to prepare derivative works of the Software, 
+ ** and to permit third-parties to whom the Software is furnished to do so, in 
+ ** accordance with:
+ ** 
+ ** (1) if the Software is obtained from Blackmagic Design, the End User License 
+ ** Agreement for the Software Development Kit (“EULA”) available at 
+ ** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+ ** 
+ ** (2) if the Software is obtained from any third party, such licensing terms 
+ ** as notified by that third party,
+ ** 
+ ** and all subject to the following:
+ ** 
+ ** (3) the copyright notices in the Software and this entire statement, 
+ ** including the above license grant, this restriction and the following 
+ ** disclaimer, must be included in all copies of the Software, in whole or in 
+ ** part, and all derivative works of the Software, unless such copies or 
+ ** derivative works are solely in the form of machine-executable object code 
+ ** generated by a source language processor.
+ ** 
+ ** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+ ** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ ** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+ ** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+ ** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+ ** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+ ** DEALINGS IN THE SOFTWARE.
+ ** 
+ ** A copy of the Software is available free of charge at 
+ ** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+ ** 
+ ** -LICENSE-END-
+ */
+
+#pragma once
+
+#include <stdint.h>
+#include <cstdio>
+#include <vector>
+
+// Sidecar index of the NAL units a decoder needs to start playback of an H.265 recording: the VPS, SPS,
+// PPS and every IRAP picture.  The index is a fixed size header followed by fixed size little-endian
+// records in file order, so a reader can binary search it with a handful of reads however long the
+// recording is.  Records are only appended once the media they refer to has been written, so the index of
+// an interrupted recording is valid up to its last complete record.
+
+static const uint32_t	kNALIndexNoTimecode	= 0xFFFFFFFF;		// Not a valid BCD timecode
+static const uint32_t	kNALIndexNoRecord	= 0xFFFFFFFF;
+
+struct NALIndexEntry
+{
+	uint64_t	fileOffset;			// Offset of the NAL unit in the recording, after its length prefix
+	int64_t		streamTime;			// Stream time in the index time scale
+	uint32_t	size;				// NAL unit size without start code or length prefix
+	uint32_t	timecode;			// BMDTimecodeBCD of the picture, or kNALIndexNoTimecode
+	uint8_t		unitType;
+	uint32_t	vpsRecord;			// Records of the parameter sets in effect, or kNALIndexNoRecord
+	uint32_t	spsRecord;
+	uint32_t	ppsRecord;
+};
+
+// Appends index records while recording; called from the writer thread only
+class NALIndexWriter
+{
+public:
+	NALIndexWriter(FILE* file, int64_t timeScale);
+
+	// Queue a record; the parameter set record numbers are filled in by the writer
+	void					addEntry(NALIndexEntry entry);
+	// Write queued records once the media they refer to is in the recording
+	bool					flush();
+
+	uint32_t				getRecordCount() const { return m_recordCount; }
+
+private:
+	FILE*					m_file;
+	std::vector<uint8_t>	m_buffer;
+	uint32_t				m_recordCount;
+	uint32_t				m_vpsRecord;
+	uint32_t				m_spsRecord;
+	uint32_t				m_ppsRecord;
+	bool					m_failed;
+};
+
+// Everything needed to start decoding at an IRAP picture
+struct NALIndexSeekPoint
+{
+	NALIndexEntry			irap;
+	NALIndexEntry			vps;
+	NALIndexEntry			sps;
+	NALIndexEntry			pps;
+};
+
+// Finds seek points in a recording's index without reading the recording itself
+class NALIndexReader
+{
+public:
+	NALIndexReader();
+	~NALIndexReader();
+
+	bool					open(const char* filename);
+	void					close();
+
+	uint32_t				getRecordCount() const { return m_recordCount; }
+	int64_t					getTimeScale() const { return m_timeScale; }
+	bool					readEntry(uint32_t record, NALIndexEntry& entry);
+
+	// The last IRAP picture at or before the timecode.  Pictures without a timecode are skipped, and the
+	// other timecodes must increase through the recording, except for one pass through midnight.
+	bool					seekToTimecode(uint32_t timecodeBCD, NALIndexSeekPoint& seekPoint);
+	// The last IRAP picture at or before the stream time, in the index time scale
+	bool					seekToStreamTime(int64_t streamTime, NALIndexSeekPoint& seekPoint);
+
+private:
+	// KeyFunction returns false for records without a key, which are skipped
+	template<typename KeyFunction>
+	bool					seek(KeyFunction key, int64_t target, NALIndexSeekPoint& seekPoint);
+
+	FILE*					m_file;
+	uint32_t				m_recordCount;
+	int64_t					m_timeScale;
+};
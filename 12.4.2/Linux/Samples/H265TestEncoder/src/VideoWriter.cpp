@@ -41,50 +41,221 @@
 #include "VideoWriter.h"
 #include <fcntl.h>
 
-VideoWriter::VideoWriter(const QString& filename)
+const char* const VideoWriter::kIndexFileExtension = ".nalidx";
+
+namespace
+{
+	bool needsIndexTimecode(uint8_t nalUnitType)
+	{
+		// IRAP pictures and parameter sets, ITU-T H.265 Table 7-1
+		return (nalUnitType >= 16 && nalUnitType <= 23) || (nalUnitType >= 32 && nalUnitType <= 34);
+	}
+
+	uint32_t getTimecode(IDeckLinkEncoderVideoPacket* videoPacket)
+	{
+		IDeckLinkTimecode*	timecode = NULL;
+		uint32_t			timecodeBCD = kNALIndexNoTimecode;
+
+		if (videoPacket->GetTimecode(bmdTimecodeRP188Any, &timecode) == S_OK && timecode)
+		{
+			timecodeBCD = timecode->GetBCD();
+			timecode->Release();
+		}
+
+		return timecodeBCD;
+	}
+}
+
+VideoWriter::VideoWriter(const QString& filename, const FragmentedMP4Writer::VideoFormat& videoFormat, const FragmentedMP4Writer::AudioFormat& audioFormat)
 :
-	m_filename(filename)
+	m_filename(filename),
+	m_file(NULL),
+	m_indexFilename(filename.toStdString() + kIndexFileExtension),
+	m_indexFile(NULL),
+	m_indexWriter(NULL),
+	m_videoFormat(videoFormat),
+	m_audioFormat(audioFormat),
+	m_muxer(NULL),
+	m_packetQueue(kPacketQueueCapacity, SampleQueueOverflowPolicy::DropNewest),
+	m_droppedPacketCount(0)
 {
 }
 
 VideoWriter::~VideoWriter()
-{	
+{
+	close();
 }
 
-bool VideoWriter::writeVideo(uint8_t* buffer, uint32_t length)
+bool VideoWriter::open()
 {
-	fwrite(buffer, 1, length, m_file);
+	m_file = fopen(m_filename.toStdString().c_str(), "wb");
+	if (!m_file)
+		return false;
+
+	m_indexFile = fopen(m_indexFilename.c_str(), "wb");
+	if (!m_indexFile)
+	{
+		fclose(m_file);
+		m_file = NULL;
+		return false;
+	}
+
+	m_indexWriter = new NALIndexWriter(m_indexFile, m_videoFormat.timeScale);
+	m_muxer = new FragmentedMP4Writer(m_file, m_videoFormat, m_audioFormat);
+	m_muxer->setIndexWriter(m_indexWriter);
+	m_packetQueue.reset();
+	m_droppedPacketCount = 0;
+	m_writerThread = std::thread(&VideoWriter::writerThread, this);
+
 	return true;
 }
 
-bool VideoWriter::writeAudio(uint64_t)
+void VideoWriter::close(bool deleteFile)
 {
-	return true;
+	if (m_writerThread.joinable())
+	{
+		// The writer thread drains the queue and completes the last fragment before it exits
+		m_packetQueue.cancelWaiters();
+		m_writerThread.join();
+	}
+
+	delete m_muxer;
+	m_muxer = NULL;
+	delete m_indexWriter;
+	m_indexWriter = NULL;
+
+	if (m_indexFile)
+	{
+		fclose(m_indexFile);
+		if (deleteFile)
+			remove(m_indexFilename.c_str());
+		m_indexFile = NULL;
+	}
+
+	if (m_file)
+	{
+		fclose(m_file);
+		if (deleteFile)
+			remove(m_filename.toStdString().c_str());
+		m_file = NULL;
+	}
 }
 
-bool VideoWriter::addVideoStream()
+void VideoWriter::queueVideoPacket(IDeckLinkEncoderVideoPacket* videoPacket)
 {
-	return true;
+	m_packetQueue.pushSample(EncoderPacketReference(videoPacket, false));
 }
 
-bool VideoWriter::addAudioStream()
+void VideoWriter::queueAudioPacket(IDeckLinkEncoderAudioPacket* audioPacket)
 {
-	return true;
+	m_packetQueue.pushSample(EncoderPacketReference(audioPacket, true));
 }
 
-bool VideoWriter::open()
+void VideoWriter::writerThread()
 {
-	m_file = fopen(m_filename.toStdString().c_str(), "wb");
-	if (!m_file)
-		return false;
-	
-	return true;
+	EncoderPacketReference packet;
+
+	while (m_packetQueue.waitForSample(packet))
+		writePacket(packet);
+
+	while (m_packetQueue.popSample(packet))
+		writePacket(packet);
+
+	// Release the last packet before the device stops streams
+	packet = EncoderPacketReference();
+
+	m_muxer->finish();
 }
 
-void VideoWriter::close(bool deleteFile)
+void VideoWriter::writePacket(const EncoderPacketReference& packet)
 {
-	fclose(m_file);
-	if (deleteFile)
-		remove(m_filename.toStdString().c_str());
-	m_file = 0;
+	// Packets were dropped while the queue was full, resume the recording at the next IRAP picture
+	uint64_t droppedPacketCount = m_packetQueue.getDroppedCount();
+	if (droppedPacketCount != m_droppedPacketCount)
+	{
+		m_droppedPacketCount = droppedPacketCount;
+		m_muxer->discontinuity();
+	}
+
+	if (packet.get()->GetPacketType() == bmdPacketTypeStreamInterruptedMarker)
+	{
+		m_muxer->discontinuity();
+		return;
+	}
+
+	if (packet.isAudio())
+		writeAudioPacket(packet.get());
+	else
+		writeVideoPacket(static_cast<IDeckLinkEncoderVideoPacket*>(packet.get()));
+}
+
+void VideoWriter::writeVideoPacket(IDeckLinkEncoderVideoPacket* packet)
+{
+	BMDTimeValue streamTime = 0;
+	if (packet->GetStreamTime(&streamTime, m_videoFormat.timeScale) != S_OK)
+		return;
+
+	IDeckLinkH265NALPacket* nalPacket = NULL;
+	if (packet->QueryInterface(IID_IDeckLinkH265NALPacket, (void**)&nalPacket) == S_OK)
+	{
+		void*		nal = NULL;
+		uint8_t		nalUnitType = 0;
+		uint32_t	timecode = kNALIndexNoTimecode;
+
+		// Only NAL units that go in the index need the picture's timecode
+		if (nalPacket->GetUnitType(&nalUnitType) == S_OK && needsIndexTimecode(nalUnitType))
+			timecode = getTimecode(packet);
+
+		if (nalPacket->GetBytesNoPrefix(&nal) == S_OK && nal)
+			m_muxer->addVideoNAL((const uint8_t*)nal, (uint32_t)nalPacket->GetSizeNoPrefix(), streamTime, timecode);
+		nalPacket->Release();
+		return;
+	}
+
+	// Otherwise the packet is an Annex B byte stream, split it at each start code
+	void* buffer = NULL;
+	if (packet->GetBytes(&buffer) != S_OK || !buffer)
+		return;
+
+	const uint8_t*	bytes = (const uint8_t*)buffer;
+	long			size = packet->GetSize();
+	uint32_t		timecode = getTimecode(packet);
+	long			nalStart = -1;
+	long			i = 0;
+
+	while (i + 2 < size)
+	{
+		if (bytes[i] == 0 && bytes[i + 1] == 0 && bytes[i + 2] == 1)
+		{
+			if (nalStart >= 0)
+			{
+				// Trailing zero bytes belong to the next start code
+				long nalEnd = i;
+				while (nalEnd > nalStart && bytes[nalEnd - 1] == 0)
+					nalEnd--;
+				m_muxer->addVideoNAL(bytes + nalStart, (uint32_t)(nalEnd - nalStart), streamTime, timecode);
+			}
+			i += 3;
+			nalStart = i;
+		}
+		else
+			i++;
+	}
+
+	if (nalStart >= 0 && nalStart < size)
+		m_muxer->addVideoNAL(bytes + nalStart, (uint32_t)(size - nalStart), streamTime, timecode);
+}
+
+void VideoWriter::writeAudioPacket(IDeckLinkEncoderPacket* packet)
+{
+	BMDTimeValue streamTime = 0;
+	void* buffer = NULL;
+
+	if (packet->GetStreamTime(&streamTime, m_audioFormat.sampleRate) != S_OK)
+		return;
+
+	if (packet->GetBytes(&buffer) != S_OK || !buffer)
+		return;
+
+	m_muxer->addAudio((const uint8_t*)buffer, (uint32_t)packet->GetSize(), streamTime);
 }
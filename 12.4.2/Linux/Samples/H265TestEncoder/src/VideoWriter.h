@@ -42,26 +42,86 @@
 
 #include <stdint.h>
 #include <cstdio>
+#include <string>
+#include <thread>
 #include <QString>
 
+#include "DeckLinkAPI.h"
+#include "FragmentedMP4Writer.h"
+#include "NALIndex.h"
+#include "SampleQueue.h"
+
+// Reference to an encoder packet held by the queue between the capture callback and the writer thread.
+// A packet dropped by a full queue is released when its reference goes out of scope.
+class EncoderPacketReference
+{
+public:
+	EncoderPacketReference() : m_packet(NULL), m_isAudio(false) { }
+	EncoderPacketReference(IDeckLinkEncoderPacket* packet, bool isAudio) : m_packet(packet), m_isAudio(isAudio) { m_packet->AddRef(); }
+	EncoderPacketReference(EncoderPacketReference&& other) : m_packet(other.m_packet), m_isAudio(other.m_isAudio) { other.m_packet = NULL; }
+	~EncoderPacketReference() { if (m_packet) m_packet->Release(); }
+
+	EncoderPacketReference& operator=(EncoderPacketReference&& other)
+	{
+		if (this != &other)
+		{
+			if (m_packet)
+				m_packet->Release();
+			m_packet = other.m_packet;
+			m_isAudio = other.m_isAudio;
+			other.m_packet = NULL;
+		}
+		return *this;
+	}
+
+	EncoderPacketReference(const EncoderPacketReference&) = delete;
+	EncoderPacketReference& operator=(const EncoderPacketReference&) = delete;
+
+	IDeckLinkEncoderPacket*	get() const { return m_packet; }
+	bool					isAudio() const { return m_isAudio; }
+
+private:
+	IDeckLinkEncoderPacket*	m_packet;
+	bool					m_isAudio;
+};
+
+// Records encoded packets to a fragmented MP4 file, with a sidecar NAL index (the recording's name with
+// kIndexFileExtension appended) for seeking by timecode.  The capture callbacks only queue a reference to
+// each packet; muxing and file I/O run on a writer thread, so a slow disk never stalls the encoder.
 class VideoWriter
 {
 public:
-	VideoWriter(const QString& filename);
+	VideoWriter(const QString& filename, const FragmentedMP4Writer::VideoFormat& videoFormat, const FragmentedMP4Writer::AudioFormat& audioFormat);
 	~VideoWriter();
 
 	bool					open();
 	void					close(bool deleteFile = false);
 
-	bool					writeVideo(uint8_t* buffer, uint32_t length);
-	bool					writeAudio(uint64_t seq);
+	// Called from the encoder callbacks, never block
+	void					queueVideoPacket(IDeckLinkEncoderVideoPacket* videoPacket);
+	void					queueAudioPacket(IDeckLinkEncoderAudioPacket* audioPacket);
+
+	uint64_t				getDroppedPacketCount() const { return m_packetQueue.getDroppedCount(); }
 
 private:
+	static const size_t		kPacketQueueCapacity = 1024;
+	static const char* const	kIndexFileExtension;
 
-	bool					addVideoStream();
-	bool					addAudioStream();
+	void					writerThread();
+	void					writePacket(const EncoderPacketReference& packet);
+	void					writeVideoPacket(IDeckLinkEncoderVideoPacket* packet);
+	void					writeAudioPacket(IDeckLinkEncoderPacket* packet);
 
 	QString					m_filename;
 	FILE*					m_file;
-};
+	std::string				m_indexFilename;
+	FILE*					m_indexFile;
+	NALIndexWriter*			m_indexWriter;
+	FragmentedMP4Writer::VideoFormat	m_videoFormat;
+	FragmentedMP4Writer::AudioFormat	m_audioFormat;
+	FragmentedMP4Writer*	m_muxer;
 
+	SampleQueue<EncoderPacketReference>	m_packetQueue;
+	std::thread				m_writerThread;
+	uint64_t				m_droppedPacketCount;		// Drops already signalled to the muxer, writer thread only
+};
@@ -0,0 +1,246 @@
+/* -LICENSE-START-
+ ** Copyright (c) 2022 Blackmagic Design
+ **  
+ ** Permission is hereby granted, free of charge, to any person or organization 
+ ** obtaining a copy of the software and accompanying documentation (the 
+ ** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+ ** and transmit the Software, and to prepare derivative works of the Software, 
+ ** and to permit third-parties to whom the Software is furnished to do so, in 
+ ** accordance with:
+ ** 
+ ** (1) if the Software is obtained from Blackmagic Design, the End User License 
+ ** Agreement for the Software Development Kit (“EULA”) available at 
+ ** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+ ** 
+ ** (2) if the Software is obtained from any third party, such licensing terms 
+ ** as notified by that third party,
+ ** 
+ ** and all subject to the following:
+ ** 
+ ** (3) the copyright notices in the Software and this entire statement, 
+ ** including the above license grant, this restriction and the following 
+ ** disclaimer, must be included in all copies of the Software, in whole or in 
+ ** part, and all derivative works of the Software, unless such copies or 
+ ** derivative works are solely in the form of machine-executable object code 
+ ** generated by a source language processor.
+ ** 
+ ** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+ ** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ ** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+ ** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+ ** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+ ** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+ ** DEALINGS IN THE SOFTWARE.
+ ** 
+ ** A copy of the Software is available free of charge at 
+ ** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+ ** 
+ ** -LICENSE-END-
+ */
+
+#include <algorithm>
+#include "AdaptivePreroll.h"
+#include "ReferenceTime.h"
+
+const uint32_t		AdaptivePrerollController::kWindowFrames;
+constexpr double	AdaptivePrerollController::kDelayPercentile;
+constexpr double	AdaptivePrerollController::kGrowMargin;
+constexpr double	AdaptivePrerollController::kShrinkMargin;
+const uint32_t		AdaptivePrerollController::kMaximumShrinkWindows;
+
+AdaptivePrerollController::AdaptivePrerollController() :
+	m_enabled(false),
+	m_minimumDelay(0),
+	m_maximumDelay(0),
+	m_frameDuration(0),
+	m_frameDurationTicks(0),
+	m_adjustment(0),
+	m_streamTimeOffset(0),
+	m_previousStreamTimeOffset(0),
+	m_discardStreamTime(0),
+	m_changeStreamTime(0),
+	m_seenFirstFrame(false),
+	m_requestedChange(0),
+	m_requestReason(nullptr),
+	m_settledStreamTime(0),
+	m_lastDelay(0),
+	m_shrinkWindows(1),
+	m_spareWindowCount(0),
+	m_prerollChangedCallback(nullptr)
+{
+}
+
+void AdaptivePrerollController::setLatencyBounds(BMDTimeValue minimumDelay, BMDTimeValue maximumDelay)
+{
+	m_enabled		= true;
+	m_minimumDelay	= std::max(minimumDelay, (BMDTimeValue)0);
+	m_maximumDelay	= std::max(maximumDelay, m_minimumDelay);
+}
+
+uint32_t AdaptivePrerollController::start(BMDTimeValue frameDuration, BMDTimeScale timeScale, uint32_t minimumPrerollFrames)
+{
+	uint32_t prerollFrames = minimumPrerollFrames;
+
+	m_frameDuration			= frameDuration;
+	m_frameDurationTicks	= (timeScale > 0) ? (frameDuration * ReferenceTime::kTimescale) / timeScale : 0;
+
+	if (m_enabled && (m_frameDurationTicks > 0))
+		prerollFrames = std::max(prerollFrames, (uint32_t)((m_minimumDelay + m_frameDurationTicks - 1) / m_frameDurationTicks));
+
+	m_adjustment				= 0;
+	m_streamTimeOffset			= 0;
+	m_previousStreamTimeOffset	= 0;
+	m_discardStreamTime			= 0;
+	m_changeStreamTime			= 0;
+	m_seenFirstFrame			= false;
+	m_requestedChange			= 0;
+	m_requestReason				= nullptr;
+	m_settledStreamTime			= 0;
+	m_delayWindow.reset();
+	m_lastDelay					= 0;
+	m_shrinkWindows				= 1;
+	m_spareWindowCount			= 0;
+
+	return prerollFrames;
+}
+
+bool AdaptivePrerollController::retimeVideoFrame(LoopThroughVideoFrame& videoFrame)
+{
+	BMDTimeValue	streamTime	= videoFrame.getVideoStreamTime();
+	int				change		= m_requestedChange;
+
+	if (!m_seenFirstFrame)
+	{
+		// Playback starts from the first frame, so frames completed before it are not of this session
+		m_settledStreamTime = streamTime;
+		m_seenFirstFrame = true;
+	}
+
+	if (change != 0)
+	{
+		m_previousStreamTimeOffset = m_streamTimeOffset;
+		m_discardStreamTime = streamTime;
+
+		if (change > 0)
+		{
+			// Leave a frame's gap on output before this frame
+			m_streamTimeOffset += m_frameDuration;
+			m_changeStreamTime = streamTime;
+		}
+		else
+		{
+			// Discard this frame and close the gap with the next one
+			m_streamTimeOffset -= m_frameDuration;
+			m_changeStreamTime = streamTime + m_frameDuration;
+		}
+
+		m_adjustment += change;
+
+		// Publish the new timing before accepting further requests
+		m_settledStreamTime = m_changeStreamTime;
+		m_requestedChange = 0;
+
+		if (m_prerollChangedCallback)
+			m_prerollChangedCallback(m_adjustment, m_requestReason);
+
+		if (change < 0)
+			return false;
+	}
+
+	videoFrame.setOutputStreamTime(streamTime + m_streamTimeOffset);
+	return true;
+}
+
+bool AdaptivePrerollController::retimeAudioPacket(LoopThroughAudioPacket& audioPacket)
+{
+	BMDTimeValue streamTime = audioPacket.getAudioStreamTime();
+
+	if (streamTime < m_discardStreamTime)
+	{
+		audioPacket.setOutputStreamTime(streamTime + m_previousStreamTimeOffset);
+		return true;
+	}
+
+	if (streamTime < m_changeStreamTime)
+		return false;
+
+	// The first packet after the output was delayed is preceded by silence, to fill the gap
+	if ((m_streamTimeOffset > m_previousStreamTimeOffset) && (streamTime == m_changeStreamTime))
+		audioPacket.setOutputSilenceDuration(m_streamTimeOffset - m_previousStreamTimeOffset);
+
+	audioPacket.setOutputStreamTime(streamTime + m_streamTimeOffset);
+	return true;
+}
+
+void AdaptivePrerollController::addCompletedFrame(const LoopThroughVideoFrame& completedFrame)
+{
+	if (!m_enabled || (m_requestedChange != 0) || (completedFrame.getVideoStreamTime() < m_settledStreamTime))
+		return;
+
+	if (completedFrame.getOutputCompletionResult() != bmdOutputFrameFlushed)
+		m_lastDelay = completedFrame.getOutputLatency();
+
+	switch (completedFrame.getOutputCompletionResult())
+	{
+		case bmdOutputFrameDisplayedLate:
+			m_shrinkWindows = std::min(m_shrinkWindows * 2, kMaximumShrinkWindows);
+			requestGrow("frame displayed late");
+			return;
+
+		case bmdOutputFrameDropped:
+			m_shrinkWindows = std::min(m_shrinkWindows * 2, kMaximumShrinkWindows);
+			requestGrow("frame dropped");
+			return;
+
+		case bmdOutputFrameFlushed:
+			return;
+
+		default:
+			break;
+	}
+
+	m_delayWindow.addSample(std::max(m_lastDelay, (BMDTimeValue)0));
+
+	if (m_delayWindow.getSampleCount() < kWindowFrames)
+		return;
+
+	BMDTimeValue lowDelay = m_delayWindow.getValueAtPercentile(kDelayPercentile);
+	m_delayWindow.reset();
+
+	if (lowDelay < (BMDTimeValue)(m_frameDurationTicks * kGrowMargin))
+	{
+		requestGrow("output delay too low");
+	}
+	else if ((lowDelay <= (BMDTimeValue)(m_frameDurationTicks * (1.0 + kShrinkMargin))) || (lowDelay - m_frameDurationTicks < m_minimumDelay))
+	{
+		m_spareWindowCount = 0;
+	}
+	else if (++m_spareWindowCount >= m_shrinkWindows)
+	{
+		m_shrinkWindows = std::max(m_shrinkWindows / 2, (uint32_t)1);
+		requestShrink("output delay above a frame");
+	}
+}
+
+void AdaptivePrerollController::requestGrow(const char* reason)
+{
+	m_delayWindow.reset();
+	m_spareWindowCount = 0;
+
+	// The delay of the most recent frame stands for the current delay, growing further if frames are
+	// late for another reason than the delay
+	if (m_lastDelay + m_frameDurationTicks > m_maximumDelay)
+		return;
+
+	m_requestReason = reason;
+	m_requestedChange = 1;
+}
+
+void AdaptivePrerollController::requestShrink(const char* reason)
+{
+	m_delayWindow.reset();
+	m_spareWindowCount = 0;
+
+	m_requestReason = reason;
+	m_requestedChange = -1;
+}
@@ -0,0 +1,137 @@
+/* -LICENSE-START-
+ ** Copyright (c) 2022 Blackmagic Design
+ **  
+ ** Permission is hereby granted, free of charge, to any person or organization 
+ ** obtaining a copy of the software and accompanying documentation (the 
+ ** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+ ** and transmit the Software, and to prepare derivative works of the Software, 
+ ** and to permit third-parties to whom the Software is furnished to do so, in 
+ ** accordance with:
+ ** 
+ ** (1) if the Software is obtained from Blackmagic Design, the End User License 
+ ** Agreement for the Software Development Kit (“EULA”) available at 
+ ** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+ ** 
+ ** (2) if the Software is obtained from any third party, such licensing terms 
+ ** as notified by that third party,
+ ** 
+ ** and all subject to the following:
+ ** 
+ ** (3) the copyright notices in the Software and this entire statement, 
+ ** including the above license grant, this restriction and the following 
+ ** disclaimer, must be included in all copies of the Software, in whole or in 
+ ** part, and all derivative works of the Software, unless such copies or 
+ ** derivative works are solely in the form of machine-executable object code 
+ ** generated by a source language processor.
+ ** 
+ ** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+ ** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ ** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+ ** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+ ** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+ ** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+ ** DEALINGS IN THE SOFTWARE.
+ ** 
+ ** A copy of the Software is available free of charge at 
+ ** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+ ** 
+ ** -LICENSE-END-
+ */
+
+#pragma once
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include "DeckLinkAPI.h"
+#include "LatencyStatistics.h"
+#include "LoopThroughAudioPacket.h"
+#include "LoopThroughVideoFrame.h"
+
+// Closed-loop control of the output delay, the time by which frames are scheduled ahead of their output.
+// Frames are output at their input stream time plus an offset, so the delay grows by a frame when the
+// offset is increased by a frame duration, and shrinks by a frame when one captured frame and its audio
+// are discarded and the offset is reduced.  The output repeats a frame (and plays a frame of silence)
+// while growing; nothing is repeated or skipped on output while shrinking.
+//
+// The output callback thread measures the output delay of each completed frame, from scheduling to the
+// start of its output, which is the margin left by the input and processing latency.  It requests a
+// frame more delay when a frame is displayed late or dropped, or when the low percentile of the delay
+// over a window of frames falls below kGrowMargin of a frame; and a frame less when the low percentile
+// leaves a frame and kShrinkMargin to spare.  Each late or dropped frame doubles the number of
+// consecutive windows with time to spare that are needed before shrinking, up to kMaximumShrinkWindows,
+// and each shrink halves it, so that a load with occasional spikes does not cycle between dropping a
+// frame and shrinking.  Requests are applied by the input callback thread, which owns the offset, at the
+// next captured frame.  Until the frames re-timed by a change are completed, no further change is
+// requested.
+//
+// The delay is kept within the bounds given to setLatencyBounds(), and playback is started with enough
+// preroll for the lower bound.  When not enabled, frames are output at their input stream time.
+class AdaptivePrerollController
+{
+public:
+	using PrerollChangedCallback = std::function<void(int adjustment, const char* reason)>;
+
+	static const uint32_t	kWindowFrames			= 60;		// Frames completed on time before the delay is assessed
+	static constexpr double	kDelayPercentile		= 1.0;		// Low percentile of the delay that is compared
+	static constexpr double	kGrowMargin				= 0.1;		// Fractions of a frame duration
+	static constexpr double	kShrinkMargin			= 0.5;
+	static const uint32_t	kMaximumShrinkWindows	= 64;
+
+	AdaptivePrerollController();
+	virtual ~AdaptivePrerollController() = default;
+
+	// Enables the controller, with bounds on the output delay in reference time ticks
+	void		setLatencyBounds(BMDTimeValue minimumDelay, BMDTimeValue maximumDelay);
+	bool		isEnabled(void) const { return m_enabled; }
+
+	// Resets the controller for a new session, returning the preroll size to start playback with
+	uint32_t	start(BMDTimeValue frameDuration, BMDTimeScale timeScale, uint32_t minimumPrerollFrames);
+
+	// Frames added to, or when negative removed from, the preroll since playback started
+	int			getAdjustment(void) const { return m_adjustment; }
+
+	// Called by the input callback thread; set the output stream time, or return false if the frame or
+	// packet is to be discarded.  Audio must be re-timed after the video of the same callback.
+	bool		retimeVideoFrame(LoopThroughVideoFrame& videoFrame);
+	bool		retimeAudioPacket(LoopThroughAudioPacket& audioPacket);
+
+	// Called by the output callback thread with each completed frame
+	void		addCompletedFrame(const LoopThroughVideoFrame& completedFrame);
+
+	// Called by the input callback thread when a change is applied
+	void		onPrerollChanged(const PrerollChangedCallback& callback) { m_prerollChangedCallback = callback; }
+
+private:
+	bool						m_enabled;
+	BMDTimeValue				m_minimumDelay;
+	BMDTimeValue				m_maximumDelay;
+	//
+	BMDTimeValue				m_frameDuration;				// In stream time units
+	BMDTimeValue				m_frameDurationTicks;			// In reference time ticks
+	std::atomic<int>			m_adjustment;
+	//
+	// Owned by the input callback thread.  Audio before m_discardStreamTime keeps the previous offset,
+	// audio from m_changeStreamTime has the current offset, and audio in between is discarded.
+	BMDTimeValue				m_streamTimeOffset;
+	BMDTimeValue				m_previousStreamTimeOffset;
+	BMDTimeValue				m_discardStreamTime;
+	BMDTimeValue				m_changeStreamTime;
+	bool						m_seenFirstFrame;
+	//
+	// Handed from the output callback thread to the input callback thread
+	std::atomic<int>			m_requestedChange;
+	std::atomic<const char*>	m_requestReason;
+	std::atomic<BMDTimeValue>	m_settledStreamTime;			// Input stream time of the first frame re-timed by the last change
+	//
+	// Owned by the output callback thread
+	LatencyHistogram			m_delayWindow;
+	BMDTimeValue				m_lastDelay;
+	uint32_t					m_shrinkWindows;				// Windows with time to spare needed to shrink
+	uint32_t					m_spareWindowCount;
+	//
+	PrerollChangedCallback		m_prerollChangedCallback;
+
+	void		requestGrow(const char* reason);
+	void		requestShrink(const char* reason);
+};
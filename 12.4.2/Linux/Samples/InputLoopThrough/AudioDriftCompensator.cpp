@@ -0,0 +1,259 @@
+/* -LICENSE-START-
+ ** Copyright (c) 2022 Blackmagic Design
+ **  
+ ** Permission is hereby granted, free of charge, to any person or organization 
+ ** obtaining a copy of the software and accompanying documentation (the 
+ ** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+ ** and transmit the Software, and to prepare derivative works of the Software, 
+ ** and to permit third-parties to whom the Software is furnished to do so, in 
+ ** accordance with:
+ ** 
+ ** (1) if the Software is obtained from Blackmagic Design, the End User License 
+ ** Agreement for the Software Development Kit (“EULA”) available at 
+ ** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+ ** 
+ ** (2) if the Software is obtained from any third party, such licensing terms 
+ ** as notified by that third party,
+ ** 
+ ** and all subject to the following:
+ ** 
+ ** (3) the copyright notices in the Software and this entire statement, 
+ ** including the above license grant, this restriction and the following 
+ ** disclaimer, must be included in all copies of the Software, in whole or in 
+ ** part, and all derivative works of the Software, unless such copies or 
+ ** derivative works are solely in the form of machine-executable object code 
+ ** generated by a source language processor.
+ ** 
+ ** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+ ** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ ** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+ ** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+ ** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+ ** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+ ** DEALINGS IN THE SOFTWARE.
+ ** 
+ ** A copy of the Software is available free of charge at 
+ ** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+ ** 
+ ** -LICENSE-END-
+ */
+
+#include <algorithm>
+#include "AudioDriftCompensator.h"
+#include "ReferenceTime.h"
+
+constexpr double	AudioDriftCompensator::kSettleTime;
+constexpr double	AudioDriftCompensator::kRateTimeConstant;
+constexpr double	AudioDriftCompensator::kLevelSmoothingTime;
+constexpr double	AudioDriftCompensator::kLevelTimeConstant;
+constexpr double	AudioDriftCompensator::kMaximumCorrection;
+constexpr double	AudioDriftCompensator::kMaximumClockOffset;
+const uint32_t		AudioDriftCompensator::kGapToleranceFrames;
+const size_t		AudioDriftCompensator::kMaximumBuffers;
+
+static const BMDTimeScale kSampleRate = bmdAudioSampleRate48kHz;
+
+AudioDriftCompensator::AudioDriftCompensator() :
+	m_enabled(false),
+	m_requestedTargetLevel(0),
+	m_frameTimescale(1),
+	m_seenFirstPacket(false),
+	m_elapsedTime(0.0),
+	m_outputTime(0),
+	m_expectedNominalTime(0),
+	m_initialPrerollOffset(0),
+	m_targetLevel(-1.0),
+	m_smoothedLevel(0.0),
+	m_rateSampleCount(0),
+	m_firstHardwareTime(0.0),
+	m_firstInputTime(0.0),
+	m_meanX(0.0),
+	m_meanY(0.0),
+	m_covarianceXX(0.0),
+	m_covarianceXY(0.0),
+	m_clockRatio(1.0),
+	m_levelCorrection(0.0),
+	m_status(),
+	m_freeBuffers(kMaximumBuffers, SampleQueueOverflowPolicy::DropNewest)
+{
+}
+
+void AudioDriftCompensator::setTargetLevel(BMDTimeValue targetLevel)
+{
+	m_enabled				= true;
+	m_requestedTargetLevel	= targetLevel;
+}
+
+void AudioDriftCompensator::start(com_ptr<IDeckLinkOutput> deckLinkOutput, BMDTimeScale frameTimescale, uint32_t channelCount)
+{
+	m_deckLinkOutput	= deckLinkOutput;
+	m_frameTimescale	= frameTimescale;
+
+	if (m_enabled && channelCount <= AudioResampler::kMaximumChannels)
+		m_resampler.reset(new AudioResampler(channelCount));
+	else
+		m_resampler.reset();
+
+	m_seenFirstPacket		= false;
+	m_elapsedTime			= 0.0;
+	m_outputTime			= 0;
+	m_expectedNominalTime	= 0;
+	m_initialPrerollOffset	= 0;
+	m_targetLevel			= -1.0;
+	m_smoothedLevel			= 0.0;
+	m_rateSampleCount		= 0;
+	m_meanX					= 0.0;
+	m_meanY					= 0.0;
+	m_covarianceXX			= 0.0;
+	m_covarianceXY			= 0.0;
+	m_clockRatio			= 1.0;
+	m_levelCorrection		= 0.0;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_status = Status();
+}
+
+void AudioDriftCompensator::processAudioPacket(LoopThroughAudioPacket& audioPacket)
+{
+	if (!m_resampler)
+		return;
+
+	// Every buffer is still held by the output, so leave the packet as it is rather than allocate
+	SampleBuffer* buffer = acquireBuffer();
+	if (buffer == nullptr)
+		return;
+
+	uint32_t		sampleFrameCount	= (uint32_t)audioPacket.getSampleFrameCount();
+	BMDTimeValue	inputTime			= (audioPacket.getAudioStreamTime() * kSampleRate) / m_frameTimescale;
+	BMDTimeValue	nominalTime			= (audioPacket.getOutputStreamTime() * kSampleRate) / audioPacket.getOutputTimeScale();
+	BMDTimeValue	hardwareTime;
+	BMDTimeValue	timeInFrame;
+	BMDTimeValue	ticksPerFrame;
+	uint32_t		bufferedSampleFrameCount;
+
+	if (!m_seenFirstPacket)
+	{
+		m_outputTime			= nominalTime;
+		m_expectedNominalTime	= nominalTime;
+		m_initialPrerollOffset	= nominalTime - inputTime;
+		m_seenFirstPacket		= true;
+	}
+
+	if (m_deckLinkOutput->GetHardwareReferenceClock(kSampleRate, &hardwareTime, &timeInFrame, &ticksPerFrame) == S_OK)
+		updateRateEstimate(hardwareTime, ((double)audioPacket.getAudioStreamTime() * kSampleRate) / m_frameTimescale, sampleFrameCount);
+
+	if (m_deckLinkOutput->GetBufferedAudioSampleFrameCount(&bufferedSampleFrameCount) == S_OK)
+		updateLevel(bufferedSampleFrameCount, sampleFrameCount);
+
+	m_elapsedTime += (double)sampleFrameCount / kSampleRate;
+
+	// Fill gaps in the re-timed input with silence, so the packet is output with its video
+	BMDTimeValue gap = nominalTime - m_expectedNominalTime;
+	if (gap > kGapToleranceFrames)
+	{
+		audioPacket.setOutputSilenceDuration(gap);
+		m_outputTime += gap;
+	}
+	else
+	{
+		audioPacket.setOutputSilenceDuration(0);
+	}
+	m_expectedNominalTime = nominalTime + sampleFrameCount;
+
+	// The preroll adds or removes whole frames of output delay, which the target follows
+	double	prerollChange	= (double)((nominalTime - inputTime) - m_initialPrerollOffset);
+	double	step			= 1.0;
+
+	if (m_elapsedTime >= kSettleTime)
+	{
+		if (m_targetLevel < 0.0)
+		{
+			if (m_requestedTargetLevel > 0)
+				m_targetLevel = ((double)m_requestedTargetLevel * kSampleRate) / ReferenceTime::kTimescale;
+			else
+				m_targetLevel = m_smoothedLevel - prerollChange;
+		}
+
+		// Consume more input for each output frame when the level is above the target
+		double levelError = m_smoothedLevel - (m_targetLevel + prerollChange);
+
+		m_levelCorrection	= std::min(std::max(levelError / (kLevelTimeConstant * kSampleRate), -kMaximumCorrection), kMaximumCorrection);
+		step				= m_clockRatio * (1.0 + m_levelCorrection);
+	}
+
+	// Recycled buffers keep their capacity, so a buffer only allocates the first times it is used
+	buffer->resize((size_t)AudioResampler::getMaximumOutputFrameCount(sampleFrameCount) * m_resampler->getChannelCount());
+
+	uint32_t outputFrameCount = m_resampler->process((const int32_t*)audioPacket.getBuffer(), sampleFrameCount, step, buffer->data());
+
+	// Replacing the buffer releases the input packet.  The release hook captures two pointers, which
+	// std::function stores without allocating.
+	audioPacket.setAudioPacket(buffer->data(), outputFrameCount, [this, buffer]()
+	{
+		m_freeBuffers.pushSample(buffer);
+	});
+	audioPacket.setOutputStreamTime(m_outputTime);
+	audioPacket.setOutputTimeScale(kSampleRate);
+	m_outputTime += outputFrameCount;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_status.bufferedLevel		= (m_smoothedLevel * 1000.0) / kSampleRate;
+	m_status.targetLevel		= (m_targetLevel < 0.0) ? 0.0 : ((m_targetLevel + prerollChange) * 1000.0) / kSampleRate;
+	m_status.clockOffset		= (m_clockRatio - 1.0) * 1e6;
+	m_status.levelCorrection	= m_levelCorrection * 1e6;
+}
+
+AudioDriftCompensator::Status AudioDriftCompensator::getStatus(void)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_status;
+}
+
+void AudioDriftCompensator::updateRateEstimate(BMDTimeValue hardwareTime, double inputTime, uint32_t sampleFrameCount)
+{
+	if (m_rateSampleCount == 0)
+	{
+		m_firstHardwareTime	= (double)hardwareTime;
+		m_firstInputTime	= inputTime;
+	}
+
+	// Weighted equally until the samples span the time constant, then exponentially
+	double	weight	= std::max(1.0 / ++m_rateSampleCount, sampleFrameCount / (kRateTimeConstant * kSampleRate));
+	double	dx		= ((double)hardwareTime - m_firstHardwareTime) - m_meanX;
+	double	dy		= (inputTime - m_firstInputTime) - m_meanY;
+
+	m_meanX			+= weight * dx;
+	m_meanY			+= weight * dy;
+	m_covarianceXX	= (1.0 - weight) * (m_covarianceXX + weight * dx * dx);
+	m_covarianceXY	= (1.0 - weight) * (m_covarianceXY + weight * dx * dy);
+
+	if (m_elapsedTime >= kSettleTime && m_covarianceXX > 0.0)
+		m_clockRatio = std::min(std::max(m_covarianceXY / m_covarianceXX, 1.0 - kMaximumClockOffset), 1.0 + kMaximumClockOffset);
+}
+
+void AudioDriftCompensator::updateLevel(uint32_t bufferedSampleFrameCount, uint32_t sampleFrameCount)
+{
+	if (m_elapsedTime == 0.0)
+	{
+		m_smoothedLevel = bufferedSampleFrameCount;
+		return;
+	}
+
+	double weight = std::min(sampleFrameCount / (kLevelSmoothingTime * kSampleRate), 1.0);
+	m_smoothedLevel += weight * ((double)bufferedSampleFrameCount - m_smoothedLevel);
+}
+
+AudioDriftCompensator::SampleBuffer* AudioDriftCompensator::acquireBuffer(void)
+{
+	SampleBuffer* buffer;
+
+	if (m_freeBuffers.popSample(buffer))
+		return buffer;
+
+	// More packets are in flight than ever before; the free list has room for every buffer created
+	if (m_buffers.size() == kMaximumBuffers)
+		return nullptr;
+
+	m_buffers.emplace_back(new SampleBuffer());
+	return m_buffers.back().get();
+}
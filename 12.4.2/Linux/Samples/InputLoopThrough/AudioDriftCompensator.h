@@ -0,0 +1,147 @@
+/* -LICENSE-START-
+ ** Copyright (c) 2022 Blackmagic Design
+ **  
+ ** Permission is hereby granted, free of charge, to any person or organization 
+ ** obtaining a copy of the software and accompanying documentation (the 
+ ** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+ ** and transmit the Software, and to prepare derivative works of the Software, 
+ ** and to permit third-parties to whom the Software is furnished to do so, in 
+ ** accordance with:
+ ** 
+ ** (1) if the Software is obtained from Blackmagic Design, the End User License 
+ ** Agreement for the Software Development Kit (“EULA”) available at 
+ ** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+ ** 
+ ** (2) if the Software is obtained from any third party, such licensing terms 
+ ** as notified by that third party,
+ ** 
+ ** and all subject to the following:
+ ** 
+ ** (3) the copyright notices in the Software and this entire statement, 
+ ** including the above license grant, this restriction and the following 
+ ** disclaimer, must be included in all copies of the Software, in whole or in 
+ ** part, and all derivative works of the Software, unless such copies or 
+ ** derivative works are solely in the form of machine-executable object code 
+ ** generated by a source language processor.
+ ** 
+ ** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+ ** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ ** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+ ** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+ ** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+ ** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+ ** DEALINGS IN THE SOFTWARE.
+ ** 
+ ** A copy of the Software is available free of charge at 
+ ** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+ ** 
+ ** -LICENSE-END-
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "AudioResampler.h"
+#include "DeckLinkAPI.h"
+#include "LoopThroughAudioPacket.h"
+#include "SampleQueue.h"
+#include "com_ptr.h"
+
+// Holds the audio buffered by the output at a target level when the input and output are not locked to a
+// common reference, so that their sample clocks drift apart.  The input audio is scheduled at the input's
+// stream time, which the output plays against its own clock, so without compensation the buffered audio
+// grows or shrinks with the drift until the output underruns or overflows.
+//
+// With each packet, the input callback thread reads the output's hardware reference clock and buffered
+// audio sample frame count.  The ratio of the input and output sample rates is estimated by a least
+// squares fit of the input stream time against the hardware clock at each arrival, exponentially weighted
+// over kRateTimeConstant; and the buffered level, smoothed over kLevelSmoothingTime, is pulled towards the
+// target over kLevelTimeConstant by a correction of at most kMaximumCorrection.  The packet is resampled by
+// the estimated ratio and the correction, and scheduled contiguously with the previous packet on the
+// output's time line, with silence filling gaps in the input such as dropped frames or a preroll increase.
+// Changes to the preroll move the target with the video, so audio stays in step with it.
+//
+// The level is sampled as each packet arrives, so it is the margin left for the packets that follow; a
+// target shorter than the delays of the input and audio processing leaves the output to underrun.  Audio
+// must be 32-bit, and the correction starts after kSettleTime, once playback is running.
+class AudioDriftCompensator
+{
+public:
+	struct Status
+	{
+		double		bufferedLevel;			// Milliseconds
+		double		targetLevel;
+		double		clockOffset;			// Estimated input rate relative to the output, parts per million
+		double		levelCorrection;		// Rate change applied to correct the level, parts per million
+	};
+
+	static constexpr double	kSettleTime				= 4.0;		// Seconds
+	static constexpr double	kRateTimeConstant		= 30.0;
+	static constexpr double	kLevelSmoothingTime		= 0.5;
+	static constexpr double	kLevelTimeConstant		= 10.0;
+	static constexpr double	kMaximumCorrection		= 0.002;
+	static constexpr double	kMaximumClockOffset		= 0.005;	// Largest drift that is followed
+	static const uint32_t	kGapToleranceFrames		= 8;		// Rounding of packet times that is not a gap
+	static const size_t		kMaximumBuffers			= 128;		// Resampled packets in flight, beyond which packets are not compensated
+
+	AudioDriftCompensator();
+	virtual ~AudioDriftCompensator() = default;
+
+	// Enables compensation, with the level in reference time ticks, or 0 to hold the level reached after kSettleTime
+	void		setTargetLevel(BMDTimeValue targetLevel);
+	bool		isEnabled(void) const { return m_enabled; }
+
+	// Resets the compensator for a new session
+	void		start(com_ptr<IDeckLinkOutput> deckLinkOutput, BMDTimeScale frameTimescale, uint32_t channelCount);
+
+	// Called by the input callback thread with each packet in stream order, after it is re-timed for the
+	// preroll; replaces the samples with the resampled audio and sets the output stream time
+	void		processAudioPacket(LoopThroughAudioPacket& audioPacket);
+
+	Status		getStatus(void);
+
+private:
+	using SampleBuffer = std::vector<int32_t>;
+
+	bool							m_enabled;
+	BMDTimeValue					m_requestedTargetLevel;			// Reference time ticks
+	//
+	com_ptr<IDeckLinkOutput>		m_deckLinkOutput;
+	BMDTimeScale					m_frameTimescale;
+	std::unique_ptr<AudioResampler>	m_resampler;
+	//
+	// Owned by the input callback thread, in sample frames
+	bool							m_seenFirstPacket;
+	double							m_elapsedTime;					// Seconds of input since start
+	BMDTimeValue					m_outputTime;					// Output stream time of the next packet
+	BMDTimeValue					m_expectedNominalTime;			// Re-timed stream time expected of the next packet
+	BMDTimeValue					m_initialPrerollOffset;			// Re-timed less input stream time, at start
+	double							m_targetLevel;
+	double							m_smoothedLevel;
+	//
+	// Rate estimate; means and covariances of the hardware time (x) and input stream time (y), relative to the first packet
+	uint64_t						m_rateSampleCount;
+	double							m_firstHardwareTime;
+	double							m_firstInputTime;
+	double							m_meanX;
+	double							m_meanY;
+	double							m_covarianceXX;
+	double							m_covarianceXY;
+	double							m_clockRatio;
+	double							m_levelCorrection;
+	//
+	std::mutex						m_mutex;						// Guards the status
+	Status							m_status;
+	//
+	// Buffers of resampled packets, created by the input callback thread.  A packet's buffer is returned to
+	// the lock-free free list by whichever thread releases the packet, so neither path waits on the status.
+	std::vector<std::unique_ptr<SampleBuffer>>	m_buffers;
+	SampleQueue<SampleBuffer*>					m_freeBuffers;
+
+	void			updateRateEstimate(BMDTimeValue hardwareTime, double inputTime, uint32_t sampleFrameCount);
+	void			updateLevel(uint32_t bufferedSampleFrameCount, uint32_t sampleFrameCount);
+	SampleBuffer*	acquireBuffer(void);
+};
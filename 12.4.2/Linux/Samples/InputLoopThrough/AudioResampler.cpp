@@ -0,0 +1,226 @@
+/* -LICENSE-START-
+ ** Copyright (c) 2022 Blackmagic Design
+ **  
+ ** Permission is hereby granted, free of charge, to any person or organization 
+ ** obtaining a copy of the software and accompanying documentation (the 
+ ** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+ ** and transmit the Software, and to prepare derivative works of the Software, 
+ ** and to permit third-parties to whom the Software is furnished to do so, in 
+ ** accordance with:
+ ** 
+ ** (1) if the Software is obtained from Blackmagic Design, the End User License 
+ ** Agreement for the Software Development Kit (“EULA”) available at 
+ ** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+ ** 
+ ** (2) if the Software is obtained from any third party, such licensing terms 
+ ** as notified by that third party,
+ ** 
+ ** and all subject to the following:
+ ** 
+ ** (3) the copyright notices in the Software and this entire statement, 
+ ** including the above license grant, this restriction and the following 
+ ** disclaimer, must be included in all copies of the Software, in whole or in 
+ ** part, and all derivative works of the Software, unless such copies or 
+ ** derivative works are solely in the form of machine-executable object code 
+ ** generated by a source language processor.
+ ** 
+ ** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+ ** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ ** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+ ** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+ ** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+ ** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+ ** DEALINGS IN THE SOFTWARE.
+ ** 
+ ** A copy of the Software is available free of charge at 
+ ** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+ ** 
+ ** -LICENSE-END-
+ */
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include "AudioResamplerKernels.h"
+
+const uint32_t AudioResampler::kMaximumChannels;
+const uint32_t AudioResampler::kTaps;
+const uint32_t AudioResampler::kPhases;
+const uint32_t AudioResampler::kBlockFrames;
+
+namespace
+{
+	// Filter design: cutoff at 0.45 of the sample rate (21.6 kHz at 48 kHz), and a Kaiser window with
+	// about 80 dB of stop band attenuation
+	const double kCutoff		= 0.45;
+	const double kKaiserBeta	= 8.0;
+
+	// Zeroth order modified Bessel function of the first kind, for the Kaiser window
+	double besselI0(double x)
+	{
+		double sum	= 1.0;
+		double term	= 1.0;
+
+		for (int k = 1; k < 50; k++)
+		{
+			term *= (x / (2.0 * k)) * (x / (2.0 * k));
+			sum += term;
+			if (term < sum * 1e-12)
+				break;
+		}
+
+		return sum;
+	}
+
+	// Table of kPhases + 1 phases of kTaps coefficients.  Phase p interpolates at p/kPhases of a frame after
+	// the input frame at tap kTaps/2 - 1; the last phase is one whole frame after it, so the taps of the
+	// phase after any fraction can be read from the next row.
+	std::vector<float> designFilter(void)
+	{
+		std::vector<float>	coefficients((AudioResampler::kPhases + 1) * AudioResampler::kTaps);
+		const double		halfLength = AudioResampler::kTaps / 2;
+
+		for (uint32_t phase = 0; phase <= AudioResampler::kPhases; phase++)
+		{
+			float*	taps	= &coefficients[phase * AudioResampler::kTaps];
+			double	sum		= 0.0;
+			double	values[AudioResampler::kTaps];
+
+			for (uint32_t tap = 0; tap < AudioResampler::kTaps; tap++)
+			{
+				double x		= (double)tap - (halfLength - 1) - (double)phase / AudioResampler::kPhases;
+				double ratio	= x / halfLength;
+				double window	= (std::fabs(ratio) < 1.0) ? besselI0(kKaiserBeta * std::sqrt(1.0 - ratio * ratio)) / besselI0(kKaiserBeta) : 0.0;
+				double sinc		= (x == 0.0) ? 1.0 : std::sin(M_PI * 2.0 * kCutoff * x) / (M_PI * 2.0 * kCutoff * x);
+
+				values[tap] = 2.0 * kCutoff * sinc * window;
+				sum += values[tap];
+			}
+
+			// Normalise each phase to unity gain at DC, so that the interpolated taps do not modulate the level
+			for (uint32_t tap = 0; tap < AudioResampler::kTaps; tap++)
+				taps[tap] = (float)(values[tap] / sum);
+		}
+
+		return coefficients;
+	}
+
+	const std::vector<float>& getFilter(void)
+	{
+		static const std::vector<float> filter = designFilter();
+		return filter;
+	}
+
+	// Written so that the compiler vectorises it for the baseline instruction set
+	void filterFrameScalar(const float* input, uint32_t channelStride, const float* phase, const float* nextPhase, float fraction, int32_t* output, uint32_t channelCount)
+	{
+		float taps[kResamplerTaps];
+		float sums[kResamplerMaximumStride] = {};
+
+		for (uint32_t tap = 0; tap < kResamplerTaps; tap++)
+			taps[tap] = phase[tap] + fraction * (nextPhase[tap] - phase[tap]);
+
+		for (uint32_t tap = 0; tap < kResamplerTaps; tap++, input += channelStride)
+		{
+			for (uint32_t channel = 0; channel < channelStride; channel++)
+				sums[channel] += taps[tap] * input[channel];
+		}
+
+		for (uint32_t channel = 0; channel < channelCount; channel++)
+			output[channel] = ResamplerSampleFromFloat(sums[channel]);
+	}
+}
+
+const AudioResamplerKernels* GetAudioResamplerKernelsScalar(void)
+{
+	static const AudioResamplerKernels kernels = { "Scalar", filterFrameScalar };
+	return &kernels;
+}
+
+const AudioResamplerKernels* GetAudioResamplerKernels(void)
+{
+	static const AudioResamplerKernels* bestKernels = []()
+	{
+#if defined(__x86_64__) || defined(__i386__)
+		if (__builtin_cpu_supports("avx2") && __builtin_cpu_supports("fma"))
+			return GetAudioResamplerKernelsAVX2();
+#elif defined(__aarch64__)
+		return GetAudioResamplerKernelsNEON();
+#endif
+		return GetAudioResamplerKernelsScalar();
+	}();
+
+	return bestKernels;
+}
+
+AudioResampler::AudioResampler(uint32_t channelCount, const AudioResamplerKernels* kernels) :
+	m_kernels(kernels ? kernels : GetAudioResamplerKernels()),
+	m_channelCount(std::min(std::max(channelCount, 1u), kMaximumChannels)),
+	m_channelStride((m_channelCount + 7) & ~7u),
+	m_history((size_t)(kTaps - 1 + kBlockFrames) * m_channelStride),
+	m_historyFrameCount(0),
+	m_position(0.0)
+{
+	reset();
+}
+
+void AudioResampler::reset(void)
+{
+	// Start with the filter full of silence, so that each packet is output in full, kTaps/2 frames later
+	m_historyFrameCount	= kTaps - 1;
+	m_position			= 0.0;
+	std::fill(m_history.begin(), m_history.begin() + (size_t)m_historyFrameCount * m_channelStride, 0.0f);
+}
+
+uint32_t AudioResampler::process(const int32_t* input, uint32_t inputFrameCount, double step, int32_t* output)
+{
+	const std::vector<float>&	filter = getFilter();
+	uint32_t					outputFrameCount = 0;
+
+	step = std::min(std::max(step, 0.5), 2.0);
+
+	while (inputFrameCount > 0)
+	{
+		uint32_t blockFrameCount = std::min(inputFrameCount, kBlockFrames);
+
+		// Append a block of input to the history, with the padding channels left as silence
+		float* history = &m_history[(size_t)m_historyFrameCount * m_channelStride];
+		for (uint32_t frame = 0; frame < blockFrameCount; frame++, history += m_channelStride, input += m_channelCount)
+		{
+			for (uint32_t channel = 0; channel < m_channelCount; channel++)
+				history[channel] = (float)input[channel] * (1.0f / kSampleScale);
+			for (uint32_t channel = m_channelCount; channel < m_channelStride; channel++)
+				history[channel] = 0.0f;
+		}
+		m_historyFrameCount	+= blockFrameCount;
+		inputFrameCount		-= blockFrameCount;
+
+		while ((uint32_t)m_position + kTaps <= m_historyFrameCount)
+		{
+			uint32_t	frame	= (uint32_t)m_position;
+			double		phase	= (m_position - frame) * kPhases;
+			uint32_t	index	= std::min((uint32_t)phase, kPhases - 1);
+
+			m_kernels->filterFrame(&m_history[(size_t)frame * m_channelStride], m_channelStride,
+									&filter[index * kTaps], &filter[(index + 1) * kTaps], (float)(phase - index),
+									&output[(size_t)outputFrameCount * m_channelCount], m_channelCount);
+
+			outputFrameCount++;
+			m_position += step;
+		}
+
+		// Move the frames that the next output frame is filtered from, at most kTaps - 1, to the start
+		uint32_t consumedFrameCount = std::min((uint32_t)m_position, m_historyFrameCount);
+
+		m_historyFrameCount	-= consumedFrameCount;
+		m_position			-= consumedFrameCount;
+		std::memmove(&m_history[0], &m_history[(size_t)consumedFrameCount * m_channelStride], (size_t)m_historyFrameCount * m_channelStride * sizeof(float));
+	}
+
+	return outputFrameCount;
+}
+
+const char* AudioResampler::getKernelName(void) const
+{
+	return m_kernels->name;
+}
@@ -0,0 +1,98 @@
+/* -LICENSE-START-
+ ** Copyright (c) 2022 Blackmagic Design
+ **  
+ ** Permission is hereby granted, free of charge, to any person or organization 
+ ** obtaining a copy of the software and accompanying documentation (the 
+ ** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+ ** and transmit the Software, and to prepare derivative works of the Software, 
+ ** and to permit third-parties to whom the Software is furnished to do so, in 
+ ** accordance with:
+ ** 
+ ** (1) if the Software is obtained from Blackmagic Design, the End User License 
+ ** Agreement for the Software Development Kit (“EULA”) available at 
+ ** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+ ** 
+ ** (2) if the Software is obtained from any third party, such licensing terms 
+ ** as notified by that third party,
+ ** 
+ ** and all subject to the following:
+ ** 
+ ** (3) the copyright notices in the Software and this entire statement, 
+ ** including the above license grant, this restriction and the following 
+ ** disclaimer, must be included in all copies of the Software, in whole or in 
+ ** part, and all derivative works of the Software, unless such copies or 
+ ** derivative works are solely in the form of machine-executable object code 
+ ** generated by a source language processor.
+ ** 
+ ** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+ ** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ ** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+ ** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+ ** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+ ** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+ ** DEALINGS IN THE SOFTWARE.
+ ** 
+ ** A copy of the Software is available free of charge at 
+ ** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+ ** 
+ ** -LICENSE-END-
+ */
+
+#pragma once
+
+#include <cstdint>
+#include <vector>
+
+struct AudioResamplerKernels;
+
+// Variable ratio resampler for interleaved 32-bit integer audio of up to kMaximumChannels channels,
+// used to pull the input audio rate to the output's when they are not locked to a common reference.
+//
+// Each output sample frame is interpolated from kTaps input frames by a Kaiser windowed-sinc filter,
+// whose coefficients are tabulated at kPhases fractional positions between input frames and linearly
+// interpolated between phases, so any ratio close to 1 can be followed smoothly from one packet to the
+// next.  Samples are filtered as floats, for all channels at once, by a kernel for the host's instruction
+// set; the work per channel is the same for every ratio, kTaps multiply-adds per output sample.  The
+// output is delayed by kTaps/2 input frames.
+//
+// process is called on the input callback thread, so it does not allocate.  Input is converted in blocks
+// of kBlockFrames into a history buffer sized at construction, after the kTaps - 1 frames kept from the
+// previous block, and written directly to the caller's output.
+class AudioResampler
+{
+public:
+	static const uint32_t	kMaximumChannels	= 16;
+	static const uint32_t	kTaps				= 64;
+	static const uint32_t	kPhases				= 256;
+	static const uint32_t	kBlockFrames		= 512;
+
+	explicit AudioResampler(uint32_t channelCount, const AudioResamplerKernels* kernels = nullptr);
+	virtual ~AudioResampler() = default;
+
+	// Discards buffered input, as at the start of a stream
+	void		reset(void);
+
+	// Resamples inputFrameCount interleaved frames into output, consuming step input frames for each
+	// output frame (from 0.5 to 2), and returns the number of output frames.  Input frames that are still
+	// needed by the filter are kept for the next call.  Output must have room for
+	// getMaximumOutputFrameCount(inputFrameCount) frames.
+	uint32_t	process(const int32_t* input, uint32_t inputFrameCount, double step, int32_t* output);
+
+	// Output frames from inputFrameCount input frames at the smallest step
+	static uint32_t	getMaximumOutputFrameCount(uint32_t inputFrameCount) { return inputFrameCount * 2 + 1; }
+
+	uint32_t	getChannelCount(void) const { return m_channelCount; }
+	const char*	getKernelName(void) const;
+
+private:
+	const AudioResamplerKernels*	m_kernels;
+	uint32_t						m_channelCount;
+	uint32_t						m_channelStride;		// Channels padded to a whole number of vectors
+	std::vector<float>				m_history;				// Input frames not yet consumed, kept as floats; kTaps - 1 + kBlockFrames frames
+	uint32_t						m_historyFrameCount;
+	double							m_position;				// Position of the next output frame in m_history
+};
+
+// Kernels for the host CPU, or nullptr for the default
+const AudioResamplerKernels*	GetAudioResamplerKernels(void);
+const AudioResamplerKernels*	GetAudioResamplerKernelsScalar(void);
@@ -0,0 +1,98 @@
+/* -LICENSE-START-
+ ** Copyright (c) 2022 Blackmagic Design
+ **  
+ ** Permission is hereby granted, free of charge, to any person or organization 
+ ** obtaining a copy of the software and accompanying documentation (the 
+ ** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+ ** and transmit the Software, and to prepare derivative works of the Software, 
+ ** and to permit third-parties to whom the Software is furnished to do so, in 
+ ** accordance with:
+ ** 
+ ** (1) if the Software is obtained from Blackmagic Design, the End User License 
+ ** Agreement for the Software Development Kit (“EULA”) available at 
+ ** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+ ** 
+ ** (2) if the Software is obtained from any third party, such licensing terms 
+ ** as notified by that third party,
+ ** 
+ ** and all subject to the following:
+ ** 
+ ** (3) the copyright notices in the Software and this entire statement, 
+ ** including the above license grant, this restriction and the following 
+ ** disclaimer, must be included in all copies of the Software, in whole or in 
+ ** part, and all derivative works of the Software, unless such copies or 
+ ** derivative works are solely in the form of machine-executable object code 
+ ** generated by a source language processor.
+ ** 
+ ** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+ ** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ ** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+ ** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+ ** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+ ** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+ ** DEALINGS IN THE SOFTWARE.
+ ** 
+ ** A copy of the Software is available free of charge at 
+ ** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+ ** 
+ ** -LICENSE-END-
+ */
+
+// Built with -mavx2 -mfma
+#include <immintrin.h>
+#include "AudioResamplerKernels.h"
+
+namespace
+{
+	// Eight channels to a vector; even and odd taps are summed separately to halve the dependency chain
+	void filterFrameAVX2(const float* input, uint32_t channelStride, const float* phase, const float* nextPhase, float fraction, int32_t* output, uint32_t channelCount)
+	{
+		alignas(32) float	taps[kResamplerTaps];
+		const __m256		fractions	= _mm256_set1_ps(fraction);
+		const __m256		scale		= _mm256_set1_ps(kSampleScale);
+		const __m256		maximum		= _mm256_set1_ps(kMaximumScaledSample);
+
+		for (uint32_t tap = 0; tap < kResamplerTaps; tap += 8)
+		{
+			__m256 first	= _mm256_loadu_ps(phase + tap);
+			__m256 second	= _mm256_loadu_ps(nextPhase + tap);
+			_mm256_store_ps(taps + tap, _mm256_fmadd_ps(fractions, _mm256_sub_ps(second, first), first));
+		}
+
+		for (uint32_t channel = 0; channel < channelStride; channel += 8)
+		{
+			const float*	samples	= input + channel;
+			__m256			even	= _mm256_setzero_ps();
+			__m256			odd		= _mm256_setzero_ps();
+
+			for (uint32_t tap = 0; tap < kResamplerTaps; tap += 2, samples += 2 * channelStride)
+			{
+				even	= _mm256_fmadd_ps(_mm256_broadcast_ss(taps + tap), _mm256_loadu_ps(samples), even);
+				odd		= _mm256_fmadd_ps(_mm256_broadcast_ss(taps + tap + 1), _mm256_loadu_ps(samples + channelStride), odd);
+			}
+
+			// Saturate at full scale; values below -2^31 already convert to INT32_MIN
+			__m256	scaled		= _mm256_min_ps(_mm256_mul_ps(_mm256_add_ps(even, odd), scale), maximum);
+			__m256i	converted	= _mm256_cvtps_epi32(scaled);
+
+			if (channel + 8 <= channelCount)
+			{
+				_mm256_storeu_si256((__m256i*)(output + channel), converted);
+			}
+			else
+			{
+				alignas(32) int32_t remainder[8];
+				_mm256_store_si256((__m256i*)remainder, converted);
+
+				for (uint32_t i = 0; channel + i < channelCount; i++)
+					output[channel + i] = remainder[i];
+			}
+		}
+	}
+}
+
+const AudioResamplerKernels* GetAudioResamplerKernelsAVX2(void)
+{
+	static const AudioResamplerKernels kernels = { "AVX2", filterFrameAVX2 };
+	return &kernels;
+}
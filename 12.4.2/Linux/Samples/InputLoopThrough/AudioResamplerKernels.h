@@ -0,0 +1,81 @@
+/* -LICENSE-START-
+ ** Copyright (c) 2022 Blackmagic Design
+ **  
+ ** Permission is hereby granted, free of charge, to any person or organization 
+ ** obtaining a copy of the software and accompanying documentation (the 
+ ** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+ ** and transmit the Software, and to prepare derivative works of the Software, 
+ ** and to permit third-parties to whom the Software is furnished to do so, in 
+ ** accordance with:
+ ** 
+ ** (1) if the Software is obtained from Blackmagic Design, the End User License 
+ ** Agreement for the Software Development Kit (“EULA”) available at 
+ ** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+ ** 
+ ** (2) if the Software is obtained from any third party, such licensing terms 
+ ** as notified by that third party,
+ ** 
+ ** and all subject to the following:
+ ** 
+ ** (3) the copyright notices in the Software and this entire statement, 
+ ** including the above license grant, this restriction and the following 
+ ** disclaimer, must be included in all copies of the Software, in whole or in 
+ ** part, and all derivative works of the Software, unless such copies or 
+ ** derivative works are solely in the form of machine-executable object code 
+ ** generated by a source language processor.
+ ** 
+ ** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+ ** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ ** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+ ** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+ ** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+ ** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+ ** DEALINGS IN THE SOFTWARE.
+ ** 
+ ** A copy of the Software is available free of charge at 
+ ** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+ ** 
+ ** -LICENSE-END-
+ */
+
+#pragma once
+
+// Filter kernels shared by the instruction set implementations in AudioResampler*.cpp; not part of the API
+
+#include <cstdint>
+#include "AudioResampler.h"
+
+struct AudioResamplerKernels
+{
+	const char*		name;
+
+	// Filters one output frame from AudioResampler::kTaps consecutive input frames, each of channelStride
+	// floats (a multiple of 8), with the taps interpolated between two phases of the filter by fraction,
+	// and writes channelCount 32-bit samples
+	void	(*filterFrame)(const float* input, uint32_t channelStride, const float* phase, const float* nextPhase, float fraction, int32_t* output, uint32_t channelCount);
+};
+
+const AudioResamplerKernels*	GetAudioResamplerKernelsAVX2(void);
+const AudioResamplerKernels*	GetAudioResamplerKernelsNEON(void);
+
+// Each file that includes this header is built for a different instruction set, so everything here has
+// internal linkage, otherwise the linker could pick an AVX2 build of an inline function for the scalar kernel
+namespace
+{
+	const uint32_t	kResamplerTaps			= AudioResampler::kTaps;
+	const uint32_t	kResamplerMaximumStride	= 16;
+	const float		kSampleScale			= 2147483648.0f;		// Full scale of a 32-bit sample
+	const float		kMaximumScaledSample	= 2147483520.0f;		// Largest float below 2^31
+
+	inline int32_t ResamplerSampleFromFloat(float value)
+	{
+		float scaled = value * kSampleScale;
+
+		if (scaled >= kMaximumScaledSample)
+			return INT32_MAX;
+		if (scaled <= -kSampleScale)
+			return INT32_MIN;
+
+		return (int32_t)(scaled >= 0.0f ? scaled + 0.5f : scaled - 0.5f);
+	}
+}
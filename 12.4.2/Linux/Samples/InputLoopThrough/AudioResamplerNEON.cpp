@@ -0,0 +1,86 @@
+/* -LICENSE-START-
+ ** Copyright (c) 2022 Blackmagic Design
+ **  
+ ** Permission is hereby granted, free of charge, to any person or organization 
+ ** obtaining a copy of the software and accompanying documentation (the 
+ ** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+ ** and transmit the Software, and to prepare derivative works of the Software, 
+ ** and to permit third-parties to whom the Software is furnished to do so, in 
+ ** accordance with:
+ ** 
+ ** (1) if the Software is obtained from Blackmagic Design, the End User License 
+ ** Agreement for the Software Development Kit (“EULA”) available at 
+ ** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+ ** 
+ ** (2) if the Software is obtained from any third party, such licensing terms 
+ ** as notified by that third party,
+ ** 
+ ** and all subject to the following:
+ ** 
+ ** (3) the copyright notices in the Software and this entire statement, 
+ ** including the above license grant, this restriction and the following 
+ ** disclaimer, must be included in all copies of the Software, in whole or in 
+ ** part, and all derivative works of the Software, unless such copies or 
+ ** derivative works are solely in the form of machine-executable object code 
+ ** generated by a source language processor.
+ ** 
+ ** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+ ** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ ** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+ ** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+ ** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+ ** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+ ** DEALINGS IN THE SOFTWARE.
+ ** 
+ ** A copy of the Software is available free of charge at 
+ ** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+ ** 
+ ** -LICENSE-END-
+ */
+
+// Built for aarch64, where NEON is always available
+#include <arm_neon.h>
+#include "AudioResamplerKernels.h"
+
+namespace
+{
+	// Eight channels to a pair of vectors, as the AVX2 kernel
+	void filterFrameNEON(const float* input, uint32_t channelStride, const float* phase, const float* nextPhase, float fraction, int32_t* output, uint32_t channelCount)
+	{
+		float taps[kResamplerTaps];
+
+		for (uint32_t tap = 0; tap < kResamplerTaps; tap += 4)
+		{
+			float32x4_t first	= vld1q_f32(phase + tap);
+			float32x4_t second	= vld1q_f32(nextPhase + tap);
+			vst1q_f32(taps + tap, vfmaq_n_f32(first, vsubq_f32(second, first), fraction));
+		}
+
+		for (uint32_t channel = 0; channel < channelStride; channel += 8)
+		{
+			const float*	samples	= input + channel;
+			float32x4_t		low		= vdupq_n_f32(0.0f);
+			float32x4_t		high	= vdupq_n_f32(0.0f);
+
+			for (uint32_t tap = 0; tap < kResamplerTaps; tap++, samples += channelStride)
+			{
+				low		= vfmaq_n_f32(low, vld1q_f32(samples), taps[tap]);
+				high	= vfmaq_n_f32(high, vld1q_f32(samples + 4), taps[tap]);
+			}
+
+			// Conversion rounds to nearest and saturates at full scale
+			int32_t converted[8];
+			vst1q_s32(converted, vcvtnq_s32_f32(vmulq_n_f32(low, kSampleScale)));
+			vst1q_s32(converted + 4, vcvtnq_s32_f32(vmulq_n_f32(high, kSampleScale)));
+
+			for (uint32_t i = 0; i < 8 && channel + i < channelCount; i++)
+				output[channel + i] = converted[i];
+		}
+	}
+}
+
+const AudioResamplerKernels* GetAudioResamplerKernelsNEON(void)
+{
+	static const AudioResamplerKernels kernels = { "NEON", filterFrameNEON };
+	return &kernels;
+}
@@ -42,7 +42,9 @@
 
 #include "platform.h"
 #include "DeckLinkInputDevice.h"
+#include "PixelFormatTraits.h"
 #include "ReferenceTime.h"
+#include "ThreadConfiguration.h"
 
 DeckLinkInputDevice::DeckLinkInputDevice(com_ptr<IDeckLink>& device) :
 	m_refCount(1),
@@ -111,6 +113,8 @@ HRESULT DeckLinkInputDevice::VideoInputFrameArrived(IDeckLinkVideoInputFrame* vi
 {
 	// Get the current timestamp for the entry to callback for latency measurements.
 	BMDTimeValue referenceCount = ReferenceTime::getSteadyClockUptimeCount();
+
+	ThreadConfiguration::applyToCurrentThreadOnce(ThreadRole::InputCallback);
 	
 	if (videoFrame)
 	{
@@ -137,6 +141,19 @@ HRESULT DeckLinkInputDevice::VideoInputFrameArrived(IDeckLinkVideoInputFrame* vi
 
 		m_lastStreamTime = streamTime;
 
+		if (m_readyForCapture && inputFrameValid && m_watermarkChecker)
+		{
+			BMDTimeValue	frameTime;
+			BMDTimeValue	frameDuration;
+			BMDTimeValue	arrivalTime = kWatermarkNoTime;
+
+			// Checked on arrival, before processing, so latency is measured to the start of frame on the input
+			if (videoFrame->GetHardwareReferenceTimestamp(kWatermarkTimeScale, &frameTime, &frameDuration) == S_OK)
+				arrivalTime = frameTime - frameDuration;
+
+			m_watermarkChecker->checkFrame(videoFrame, arrivalTime);
+		}
+
 		if (m_readyForCapture)
 		{
 			if (m_videoInputFrameDroppedCallback && m_seenValidSignal && !inputFrameValid)
@@ -160,6 +177,7 @@ HRESULT DeckLinkInputDevice::VideoInputFrameArrived(IDeckLinkVideoInputFrame* vi
 				loopThroughVideoFrame->setInputFrameStartReferenceTime(referenceFrameTime - referenceFrameDuration);
 
 				loopThroughVideoFrame->setVideoStreamTime(streamTime);
+				loopThroughVideoFrame->setOutputStreamTime(streamTime);
 				loopThroughVideoFrame->setVideoFrameDuration(frameDuration);
 
 				m_videoInputArrivedCallback(std::move(loopThroughVideoFrame));
@@ -188,6 +206,8 @@ HRESULT DeckLinkInputDevice::VideoInputFrameArrived(IDeckLinkVideoInputFrame* vi
 		if (audioPacket->GetPacketTime(&packetTime, m_frameTimescale) != S_OK)
 			return E_FAIL;
 		loopThroughAudioPacket->setAudioStreamTime(packetTime);
+		loopThroughAudioPacket->setOutputStreamTime(packetTime);
+		loopThroughAudioPacket->setOutputTimeScale(m_frameTimescale);
 
 		m_audioInputArrivedCallback(std::move(loopThroughAudioPacket));
 	}
@@ -230,6 +250,10 @@ bool DeckLinkInputDevice::startCapture(BMDDisplayMode displayMode, bool enable3D
 	// Register input callback
 	if (m_deckLinkInput->SetCallback(this) != S_OK)
 		return false;
+
+	// Size the frame buffer pool for the mode, so it is created when the driver commits the allocator
+	if (m_frameAllocator)
+		m_frameAllocator->SetBufferSize((uint32_t)(GetPixelFormatRowBytes(pixelFormat, deckLinkDisplayMode->GetWidth()) * deckLinkDisplayMode->GetHeight()));
 	
 	// Set the video input mode
 	if (m_deckLinkInput->EnableVideoInput(displayMode, pixelFormat, videoInputFlags) != S_OK)
@@ -246,6 +270,15 @@ bool DeckLinkInputDevice::startCapture(BMDDisplayMode displayMode, bool enable3D
 	return true;
 }
 
+bool DeckLinkInputDevice::setVideoInputFrameMemoryAllocator(com_ptr<PooledMemoryAllocator> allocator)
+{
+	if (m_deckLinkInput->SetVideoInputFrameMemoryAllocator(allocator.get()) != S_OK)
+		return false;
+
+	m_frameAllocator = allocator;
+	return true;
+}
+
 void DeckLinkInputDevice::stopCapture()
 {
 	// Stop the capture
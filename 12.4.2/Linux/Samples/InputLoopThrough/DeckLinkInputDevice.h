@@ -44,8 +44,10 @@
 #include <functional>
 #include <memory>
 
+#include "FrameWatermark.h"
 #include "LoopThroughAudioPacket.h"
 #include "LoopThroughVideoFrame.h"
+#include "PooledMemoryAllocator.h"
 #include "DeckLinkAPI.h"
 #include "com_ptr.h"
 
@@ -74,6 +76,8 @@ public:
 	bool	startCapture(BMDDisplayMode displayMode, bool enable3D, BMDPixelFormat pixelFormat, BMDAudioSampleType audioSampleType, uint32_t audioChannelCount);
 	void	stopCapture(void);
 	void	setReadyForCapture(void);
+	bool	setVideoInputFrameMemoryAllocator(com_ptr<PooledMemoryAllocator> allocator);
+	void	setWatermarkChecker(const std::shared_ptr<WatermarkChecker>& checker) { m_watermarkChecker = checker; }
 
 	void	onVideoFormatChange(const VideoFormatChangedCallback& callback) { m_videoFormatChangedCallback = callback; }
 	void	onVideoInputArrived(const VideoInputArrivedCallback& callback) { m_videoInputArrivedCallback = callback; }
@@ -90,6 +94,8 @@ private:
 	BMDTimeScale					m_frameTimescale;
 	bool							m_seenValidSignal;
 	bool							m_readyForCapture;
+	std::shared_ptr<WatermarkChecker>	m_watermarkChecker;
+	com_ptr<PooledMemoryAllocator>	m_frameAllocator;
 	//
 	VideoFormatChangedCallback		m_videoFormatChangedCallback;
 	VideoInputArrivedCallback		m_videoInputArrivedCallback;
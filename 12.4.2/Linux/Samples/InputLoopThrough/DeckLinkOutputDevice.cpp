@@ -41,14 +41,24 @@
 #include <stdexcept>
 
 #include "DeckLinkOutputDevice.h"
+#include "FrameTrace.h"
 #include "ReferenceTime.h"
+#include "ThreadConfiguration.h"
+
+// Samples waiting for the scheduling threads.  When the output falls this far behind, new samples are
+// dropped rather than blocking the input callback, which must not wait on a scheduling thread.
+const size_t kOutputQueueCapacity = 32;
 
 DeckLinkOutputDevice::DeckLinkOutputDevice(com_ptr<IDeckLink>& device, int videoPrerollSize) :
 	m_refCount(1),
 	m_state(PlaybackState::Idle),
 	m_deckLink(device),
 	m_deckLinkOutput(IID_IDeckLinkOutput, device),
+	m_outputVideoFrameQueue(kOutputQueueCapacity, SampleQueueOverflowPolicy::DropNewest),
+	m_outputAudioPacketQueue(kOutputQueueCapacity, SampleQueueOverflowPolicy::DropNewest),
 	m_videoPrerollSize(videoPrerollSize),
+	m_audioWaterLevel(0),
+	m_audioSampleFrameSize(0),
 	m_seenFirstVideoFrame(false),
 	m_seenFirstAudioPacket(false),
 	m_startPlaybackTime(0),
@@ -113,34 +123,47 @@ ULONG DeckLinkOutputDevice::Release(void)
 HRESULT	DeckLinkOutputDevice::ScheduledFrameCompleted(IDeckLinkVideoFrame* completedFrame, BMDOutputFrameCompletionResult result)
 {
 	BMDTimeValue frameCompletionTimestamp;
-	
+	BMDTimeValue callbackReferenceTime = ReferenceTime::getSteadyClockUptimeCount();
+	int64_t traceFrameNumber = FrameTrace::kNoFrame;
+
+	ThreadConfiguration::applyToCurrentThreadOnce(ThreadRole::OutputCallback);
+	FrameTrace::setThreadName("DeckLink output callback");
+
 	// Get frame completion timestamp
 	if (completedFrame)
 	{
 		// Get the time that scheduled frame was completely transmitted by the device
 		if (m_deckLinkOutput->GetFrameCompletionReferenceTimestamp(completedFrame, ReferenceTime::kTimescale, &frameCompletionTimestamp) == S_OK)
 		{
-			std::lock_guard<std::mutex> lock(m_mutex);
+			std::shared_ptr<LoopThroughVideoFrame> loopThroughVideoFrame;
 
-			for (auto iter = m_scheduledFramesList.rbegin(); iter != m_scheduledFramesList.rend(); iter++)
 			{
-				auto loopThroughVideoFrame = iter->get();
-				if (loopThroughVideoFrame->getVideoFramePtr() == completedFrame)
+				std::lock_guard<std::mutex> lock(m_mutex);
+
+				auto iter = m_scheduledFramesMap.find(completedFrame);
+				if (iter != m_scheduledFramesMap.end())
 				{
-					if (m_scheduledFrameCompletedCallback != nullptr)
-					{
-						loopThroughVideoFrame->setOutputCompletionResult(result);
-						loopThroughVideoFrame->setOutputFrameCompletedReferenceTime(frameCompletionTimestamp - loopThroughVideoFrame->getVideoFrameDuration());
-						m_scheduledFrameCompletedCallback(std::move(*iter));
-					}
-					// Erase item from reverse_iterator
-					m_scheduledFramesList.erase(std::next(iter).base());
-					break;
+					loopThroughVideoFrame = std::move(iter->second);
+					m_scheduledFramesMap.erase(iter);
 				}
 			}
+
+			// Frame is no longer shared with the scheduling thread, so complete it without holding the lock
+			if (loopThroughVideoFrame && (m_scheduledFrameCompletedCallback != nullptr))
+			{
+				// The completion timestamp is the end of the frame's output, the frame duration is in stream time units
+				BMDTimeValue frameDurationReferenceTime = (loopThroughVideoFrame->getVideoFrameDuration() * ReferenceTime::kTimescale) / m_frameTimescale;
+
+				loopThroughVideoFrame->setOutputCompletionResult(result);
+				loopThroughVideoFrame->setOutputFrameCompletedReferenceTime(frameCompletionTimestamp - frameDurationReferenceTime);
+				traceFrameNumber = loopThroughVideoFrame->getStreamFrameNumber();
+				m_scheduledFrameCompletedCallback(std::move(loopThroughVideoFrame));
+			}
 		}
 	}
 
+	FrameTrace::addSpan("ScheduledFrameCompleted", callbackReferenceTime, ReferenceTime::getSteadyClockUptimeCount(), traceFrameNumber);
+
 	return S_OK;
 }
 
@@ -191,8 +214,9 @@ bool DeckLinkOutputDevice::startPlayback(BMDDisplayMode displayMode, bool enable
 	if (deckLinkDisplayMode->GetFrameRate(&m_frameDuration, &m_frameTimescale) != S_OK)
 		return false;
 
-	// Get audio water level, based on video preroll size
+	// Get audio water level, based on video preroll size, which may be changed between sessions
 	m_audioWaterLevel = (uint32_t)(((int64_t)(m_videoPrerollSize * m_frameDuration) * bmdAudioSampleRate48kHz) / m_frameTimescale);
+	m_audioSampleFrameSize = audioChannelCount * (audioSampleType / 8);
 	
 	if (enable3D)
 		outputFlags = (BMDVideoOutputFlags)(outputFlags | bmdVideoOutputDualStream3D);
@@ -285,7 +309,7 @@ void DeckLinkOutputDevice::stopPlayback()
 	
 	{
 		std::lock_guard<std::mutex> lock(m_mutex);
-		m_scheduledFramesList.clear();
+		m_scheduledFramesMap.clear();
 		m_state = PlaybackState::Idle;
 	}
 }
@@ -335,33 +359,57 @@ bool DeckLinkOutputDevice::isPlaybackActive()
 
 void DeckLinkOutputDevice::scheduleVideoFramesThread()
 {
+	ThreadConfiguration::applyToCurrentThread(ThreadRole::VideoScheduler);
+	FrameTrace::setThreadName("Video scheduler");
+
 	while (true)
 	{
 		std::shared_ptr<LoopThroughVideoFrame> outputFrame;
 	
 		if (m_outputVideoFrameQueue.waitForSample(outputFrame))
 		{
-			std::lock_guard<std::mutex> lock(m_mutex);
+			BMDTimeValue scheduledReferenceTime;
+			HRESULT result;
 
-			// Record the stream time of the first frame, so we can start playing from that point
-			if (!m_seenFirstVideoFrame)
 			{
-				m_startPlaybackTime = std::max(m_startPlaybackTime, outputFrame->getVideoStreamTime());
-				m_seenFirstVideoFrame = true;
+				std::lock_guard<std::mutex> lock(m_mutex);
+
+				// Record the stream time of the first frame, so we can start playing from that point
+				if (!m_seenFirstVideoFrame)
+				{
+					m_startPlaybackTime = std::max(m_startPlaybackTime, outputFrame->getOutputStreamTime());
+					m_seenFirstVideoFrame = true;
+				}
+				
+				// Get the reference time when video frame was scheduled
+				scheduledReferenceTime = ReferenceTime::getSteadyClockUptimeCount();
+				outputFrame->setOutputFrameScheduledReferenceTime(scheduledReferenceTime);
+
+				result = m_deckLinkOutput->ScheduleVideoFrame(outputFrame->getVideoFramePtr(), outputFrame->getOutputStreamTime(), m_frameDuration, m_frameTimescale);
+
+				if (result == S_OK)
+				{
+					m_scheduledFramesMap[outputFrame->getVideoFramePtr()] = outputFrame;
+					checkEndOfPreroll();
+				}
 			}
-			
-			// Get the reference time when video frame was scheduled
-			outputFrame->setOutputFrameScheduledReferenceTime(ReferenceTime::getSteadyClockUptimeCount());
 
-			if (m_deckLinkOutput->ScheduleVideoFrame(outputFrame->getVideoFramePtr(), outputFrame->getVideoStreamTime(), m_frameDuration, m_frameTimescale) != S_OK)
+			FrameTrace::addSpan("Output queue", outputFrame->getProcessingCompletedReferenceTime(), scheduledReferenceTime, outputFrame->getStreamFrameNumber());
+			FrameTrace::addSpan("ScheduleVideoFrame", scheduledReferenceTime, ReferenceTime::getSteadyClockUptimeCount(), outputFrame->getStreamFrameNumber());
+
+			if (result != S_OK)
 			{
+				// Keep draining the queue, so producers are never held by a frame the device would not take.
+				// The frame is completed as dropped, so it is counted with the other output results
 				fprintf(stderr, "Unable to schedule output video frame\n");
-				break;
-			}
-			
-			m_scheduledFramesList.push_back(outputFrame);
 
-			checkEndOfPreroll();
+				if (m_scheduledFrameCompletedCallback != nullptr)
+				{
+					outputFrame->setOutputCompletionResult(bmdOutputFrameDropped);
+					outputFrame->setOutputFrameCompletedReferenceTime(scheduledReferenceTime);
+					m_scheduledFrameCompletedCallback(std::move(outputFrame));
+				}
+			}
 		}
 		else
 		{
@@ -373,6 +421,8 @@ void DeckLinkOutputDevice::scheduleVideoFramesThread()
 
 void DeckLinkOutputDevice::scheduleAudioPacketsThread()
 {
+	ThreadConfiguration::applyToCurrentThread(ThreadRole::AudioScheduler);
+
 	while (true)
 	{
 		std::shared_ptr<LoopThroughAudioPacket> outputPacket;
@@ -380,20 +430,33 @@ void DeckLinkOutputDevice::scheduleAudioPacketsThread()
 		if (m_outputAudioPacketQueue.waitForSample(outputPacket))
 		{
 			std::lock_guard<std::mutex> lock(m_mutex);
+			BMDTimeScale outputTimeScale = outputPacket->getOutputTimeScale();
+
 			// Record the stream time of the first frame, so we can start playing from that point
 			if (!m_seenFirstAudioPacket)
 			{
-				m_startPlaybackTime = std::max(m_startPlaybackTime, outputPacket->getAudioStreamTime());
+				m_startPlaybackTime = std::max(m_startPlaybackTime, (outputPacket->getOutputStreamTime() * m_frameTimescale) / outputTimeScale);
 				m_seenFirstAudioPacket = true;
 			}
 
 			// Get the reference time when audio packet was scheduled
 			BMDTimeValue scheduleReferenceCount = ReferenceTime::getSteadyClockUptimeCount();
 
-			if (m_deckLinkOutput->ScheduleAudioSamples(outputPacket->getBuffer(), (uint32_t)outputPacket->getSampleFrameCount(), outputPacket->getAudioStreamTime(), m_frameTimescale, nullptr) != S_OK)
+			if (outputPacket->getOutputSilenceDuration() > 0)
+			{
+				// Fill the gap left before the packet when the output was delayed
+				uint32_t silenceSampleFrameCount = (uint32_t)((outputPacket->getOutputSilenceDuration() * bmdAudioSampleRate48kHz) / outputTimeScale);
+				m_silenceBuffer.resize(std::max(m_silenceBuffer.size(), (size_t)silenceSampleFrameCount * m_audioSampleFrameSize));
+
+				if (m_deckLinkOutput->ScheduleAudioSamples(m_silenceBuffer.data(), silenceSampleFrameCount, outputPacket->getOutputStreamTime() - outputPacket->getOutputSilenceDuration(), outputTimeScale, nullptr) != S_OK)
+					fprintf(stderr, "Unable to schedule output audio silence\n");
+			}
+
+			if (m_deckLinkOutput->ScheduleAudioSamples(outputPacket->getBuffer(), (uint32_t)outputPacket->getSampleFrameCount(), outputPacket->getOutputStreamTime(), outputTimeScale, nullptr) != S_OK)
 			{
+				// Packet is released, later packets are still scheduled
 				fprintf(stderr, "Unable to schedule output audio packet\n");
-				break;
+				continue;
 			}
 			
 			if (m_scheduledAudioPacketCallback)
@@ -443,7 +506,7 @@ void DeckLinkOutputDevice::checkEndOfPreroll()
 			return;
 		}
 
-		if ((prerollAudioSampleCount >= m_audioWaterLevel) && (m_scheduledFramesList.size() >= m_videoPrerollSize))
+		if ((prerollAudioSampleCount >= m_audioWaterLevel) && (m_scheduledFramesMap.size() >= m_videoPrerollSize))
 		{
 			m_deckLinkOutput->EndAudioPreroll();
 			if (m_deckLinkOutput->StartScheduledPlayback(m_startPlaybackTime, m_frameTimescale, 1.0) != S_OK)
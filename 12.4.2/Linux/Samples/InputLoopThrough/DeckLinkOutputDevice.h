@@ -43,10 +43,11 @@
 #include <atomic>
 #include <condition_variable>
 #include <functional>
-#include <list>
 #include <memory>
 #include <mutex>
 #include <thread>
+#include <unordered_map>
+#include <vector>
 
 #include "DeckLinkAPI.h"
 #include "LoopThroughAudioPacket.h"
@@ -62,7 +63,7 @@ class DeckLinkOutputDevice : public IDeckLinkVideoOutputCallback, public IDeckLi
 	using ScheduledFrameCompletedCallback	= std::function<void(std::shared_ptr<LoopThroughVideoFrame>)>;
 	using ScheduledAudioPacketCallback		= std::function<void(std::shared_ptr<LoopThroughAudioPacket>)>;
 	
-	using ScheduledFramesList				= std::list<std::shared_ptr<LoopThroughVideoFrame>>;
+	using ScheduledFramesMap				= std::unordered_map<IDeckLinkVideoFrame*, std::shared_ptr<LoopThroughVideoFrame>>;
 
 public:
 	DeckLinkOutputDevice(com_ptr<IDeckLink>& deckLink, int videoPrerollSize);
@@ -89,9 +90,11 @@ public:
 	BMDTimeScale				getFrameTimescale(void) const { return m_frameTimescale; }
 	com_ptr<IDeckLinkOutput>	getDeckLinkOutput(void) const { return m_deckLinkOutput; }
 	bool						getReferenceSignalMode(BMDDisplayMode* mode);
+	void						setVideoPrerollSize(uint32_t videoPrerollSize) { m_videoPrerollSize = videoPrerollSize; }
 	bool						isPlaybackActive(void);
-	void						scheduleVideoFrame(std::shared_ptr<LoopThroughVideoFrame> videoFrame) { m_outputVideoFrameQueue.pushSample(videoFrame); }
-	void						scheduleAudioPacket(std::shared_ptr<LoopThroughAudioPacket> audioPacket) { m_outputAudioPacketQueue.pushSample(audioPacket); }
+	// Return false when the scheduling thread has fallen behind and the sample was dropped
+	bool						scheduleVideoFrame(std::shared_ptr<LoopThroughVideoFrame> videoFrame) { return m_outputVideoFrameQueue.pushSample(std::move(videoFrame)); }
+	bool						scheduleAudioPacket(std::shared_ptr<LoopThroughAudioPacket> audioPacket) { return m_outputAudioPacketQueue.pushSample(std::move(audioPacket)); }
 
 	void						onScheduledFrameCompleted(const ScheduledFrameCompletedCallback& callback) { m_scheduledFrameCompletedCallback = callback; }
 	void						onAudioPacketScheduled(const ScheduledAudioPacketCallback& callback) { m_scheduledAudioPacketCallback = callback; }
@@ -105,10 +108,12 @@ private:
 	//
 	SampleQueue<std::shared_ptr<LoopThroughVideoFrame>>		m_outputVideoFrameQueue;
 	SampleQueue<std::shared_ptr<LoopThroughAudioPacket>>	m_outputAudioPacketQueue;
-	ScheduledFramesList										m_scheduledFramesList;
+	ScheduledFramesMap										m_scheduledFramesMap;
 	//
 	uint32_t												m_videoPrerollSize;
 	uint32_t												m_audioWaterLevel;
+	uint32_t												m_audioSampleFrameSize;
+	std::vector<uint8_t>									m_silenceBuffer;
 	//
 	BMDTimeValue											m_frameDuration;
 	BMDTimeScale											m_frameTimescale;
@@ -40,41 +40,201 @@
 
 #pragma once
 
+#include <atomic>
 #include <condition_variable>
+#include <cstddef>
+#include <deque>
 #include <functional>
+#include <memory>
 #include <mutex>
-#include <queue>
+#include <new>
+#include <thread>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+// Move-only wrapper for a dispatched callable.  Closures of up to kInlineSize bytes are stored
+// within the wrapper, so dispatching a typical bound function does not allocate.
+class DispatchFunction
+{
+	static const size_t kInlineSize = 64;
+
+	struct Operations
+	{
+		void	(*invoke)(void* storage);
+		void	(*move)(void* from, void* to);
+		void	(*destroy)(void* storage);
+	};
+
+	template<class F>
+	using IsInline = std::integral_constant<bool, sizeof(F) <= kInlineSize && alignof(F) <= alignof(std::max_align_t) && std::is_nothrow_move_constructible<F>::value>;
+
+public:
+	DispatchFunction() : m_operations(nullptr) { }
+
+	template<class F, class = typename std::enable_if<!std::is_same<typename std::decay<F>::type, DispatchFunction>::value>::type>
+	DispatchFunction(F&& fn) :
+		m_operations(operations<typename std::decay<F>::type>(IsInline<typename std::decay<F>::type>()))
+	{
+		construct<typename std::decay<F>::type>(std::forward<F>(fn), IsInline<typename std::decay<F>::type>());
+	}
+
+	DispatchFunction(DispatchFunction&& other) :
+		m_operations(other.m_operations)
+	{
+		if (m_operations)
+			m_operations->move(&other.m_storage, &m_storage);
+		other.m_operations = nullptr;
+	}
+
+	DispatchFunction& operator=(DispatchFunction&& other)
+	{
+		if (this != &other)
+		{
+			reset();
+			m_operations = other.m_operations;
+			if (m_operations)
+				m_operations->move(&other.m_storage, &m_storage);
+			other.m_operations = nullptr;
+		}
+		return *this;
+	}
+
+	DispatchFunction(const DispatchFunction&) = delete;
+	DispatchFunction& operator=(const DispatchFunction&) = delete;
+
+	~DispatchFunction()
+	{
+		reset();
+	}
+
+	void operator()()
+	{
+		m_operations->invoke(&m_storage);
+	}
+
+	explicit operator bool() const
+	{
+		return m_operations != nullptr;
+	}
+
+private:
+	typename std::aligned_storage<kInlineSize, alignof(std::max_align_t)>::type	m_storage;
+	const Operations*															m_operations;
+
+	void reset(void)
+	{
+		if (m_operations)
+			m_operations->destroy(&m_storage);
+		m_operations = nullptr;
+	}
+
+	template<class F, class G>
+	void construct(G&& fn, std::true_type)
+	{
+		new (&m_storage) F(std::forward<G>(fn));
+	}
 
+	template<class F, class G>
+	void construct(G&& fn, std::false_type)
+	{
+		// Closure is too large to store inline, keep a pointer to it instead
+		new (&m_storage) F*(new F(std::forward<G>(fn)));
+	}
+
+	template<class F>
+	static const Operations* operations(std::true_type)
+	{
+		static const Operations inlineOperations =
+		{
+			[](void* storage) { (*static_cast<F*>(storage))(); },
+			[](void* from, void* to) { new (to) F(std::move(*static_cast<F*>(from))); static_cast<F*>(from)->~F(); },
+			[](void* storage) { static_cast<F*>(storage)->~F(); }
+		};
+		return &inlineOperations;
+	}
+
+	template<class F>
+	static const Operations* operations(std::false_type)
+	{
+		static const Operations heapOperations =
+		{
+			[](void* storage) { (**static_cast<F**>(storage))(); },
+			[](void* from, void* to) { new (to) F*(*static_cast<F**>(from)); },
+			[](void* storage) { delete *static_cast<F**>(storage); }
+		};
+		return &heapOperations;
+	}
+};
+
+// Work-stealing executor.  Each worker owns a deque of functions, so dispatching and executing
+// only contends on the lock of a single worker.  Functions dispatched from a worker thread are
+// queued to that worker, others are distributed round-robin.  An idle worker takes the oldest
+// function from its own deque, or steals the newest from another worker's deque before sleeping.
+// Functions may complete in a different order to which they were dispatched.
 class DispatchQueue
 {
-	using DispatchFunction = std::function<void(void)>;
+	struct WorkerQueue
+	{
+		std::mutex						mutex;
+		std::deque<DispatchFunction>	functions;
+	};
+
+	struct WorkerContext
+	{
+		DispatchQueue*					dispatchQueue;
+		size_t							index;
+	};
 
 public:
-	DispatchQueue(size_t numThreads);
+	// Called on each worker thread as it starts, before it executes any function
+	using ThreadInitializer = std::function<void(void)>;
+
+	DispatchQueue(size_t numThreads, ThreadInitializer threadInitializer = nullptr);
 	virtual ~DispatchQueue();
 
 	template<class F, class... Args>
 	void dispatch(F&& fn, Args&&... args);
 	
 private:
-	std::vector<std::thread>		m_workerThreads;
-	std::queue<DispatchFunction>	m_functionQueue;
-	std::condition_variable			m_condition;
-	std::mutex						m_mutex;
+	std::vector<std::thread>					m_workerThreads;
+	std::vector<std::unique_ptr<WorkerQueue>>	m_workerQueues;
+	std::atomic<size_t>							m_nextWorkerQueue;
+	std::atomic<int>							m_pendingCount;
+	//
+	std::condition_variable						m_idleCondition;
+	std::mutex									m_idleMutex;
+	std::atomic<int>							m_idleWorkerCount;
+
+	bool										m_cancelWorkers;
+	ThreadInitializer							m_threadInitializer;
 
-	bool							m_cancelWorkers;
+	void			workerThread(size_t index);
+	void			pushFunction(DispatchFunction&& func);
+	bool			popFunction(size_t index, DispatchFunction& func);
+	bool			stealFunction(size_t index, DispatchFunction& func);
 
-	void workerThread(void);
+	static WorkerContext&	currentWorker(void);
 };
 
-DispatchQueue::DispatchQueue(size_t numThreads) :
-	m_cancelWorkers(false)
+DispatchQueue::DispatchQueue(size_t numThreads, ThreadInitializer threadInitializer) :
+	m_nextWorkerQueue(0),
+	m_pendingCount(0),
+	m_idleWorkerCount(0),
+	m_cancelWorkers(false),
+	m_threadInitializer(threadInitializer)
 {
+	if (numThreads == 0)
+		numThreads = 1;
+
+	for (size_t i = 0; i < numThreads; i++)
+	{
+		m_workerQueues.emplace_back(new WorkerQueue());
+	}
+
 	for (size_t i = 0; i < numThreads; i++)
 	{
-		m_workerThreads.emplace_back(&DispatchQueue::workerThread, this);
+		m_workerThreads.emplace_back(&DispatchQueue::workerThread, this, i);
 	}
 }
 
@@ -82,10 +242,10 @@ DispatchQueue::~DispatchQueue()
 {
 	// Stop all threads once they have completed current job
 	{
-		std::lock_guard<std::mutex> lock(m_mutex);
+		std::lock_guard<std::mutex> lock(m_idleMutex);
 		m_cancelWorkers = true;
 	}
-	m_condition.notify_all();
+	m_idleCondition.notify_all();
 
 	for (auto& worker : m_workerThreads)
 	{
@@ -93,43 +253,101 @@ DispatchQueue::~DispatchQueue()
 	}
 }
 
+DispatchQueue::WorkerContext& DispatchQueue::currentWorker(void)
+{
+	static thread_local WorkerContext context = { nullptr, 0 };
+	return context;
+}
+
 template<class F, class... Args>
 void DispatchQueue::dispatch(F&& fn, Args&& ...args)
 {
-	using DispatchFunctionBinding = decltype(std::bind(std::declval<F>(), std::declval<Args>()...));
-	{
-		std::lock_guard<std::mutex> lock(m_mutex);
-		m_functionQueue.push(DispatchFunctionBinding(std::forward<F>(fn), std::forward<Args>(args)...));
-	}
-	m_condition.notify_one();
+	pushFunction(std::bind(std::forward<F>(fn), std::forward<Args>(args)...));
 }
 
-void DispatchQueue::workerThread()
+void DispatchQueue::pushFunction(DispatchFunction&& func)
 {
-	while (true)
+	WorkerContext&	worker = currentWorker();
+	size_t			index;
+
+	if (worker.dispatchQueue == this)
+		index = worker.index;
+	else
+		index = m_nextWorkerQueue.fetch_add(1, std::memory_order_relaxed) % m_workerQueues.size();
+
+	{
+		std::lock_guard<std::mutex> lock(m_workerQueues[index]->mutex);
+		m_workerQueues[index]->functions.push_back(std::move(func));
+	}
+
+	m_pendingCount.fetch_add(1);
+
+	// Only take the idle lock when a worker may be sleeping
+	if (m_idleWorkerCount.load() > 0)
 	{
 		{
-			std::unique_lock<std::mutex> lock(m_mutex);
-			m_condition.wait(lock, [&] { return !m_functionQueue.empty() || m_cancelWorkers; });
+			std::lock_guard<std::mutex> lock(m_idleMutex);
 		}
+		m_idleCondition.notify_one();
+	}
+}
 
-		while (true)
-		{
-			DispatchFunction func;
-			{
-				std::lock_guard<std::mutex> lock(m_mutex);
-				if (m_functionQueue.empty())
-					break;
+bool DispatchQueue::popFunction(size_t index, DispatchFunction& func)
+{
+	std::lock_guard<std::mutex> lock(m_workerQueues[index]->mutex);
+	if (m_workerQueues[index]->functions.empty())
+		return false;
+
+	func = std::move(m_workerQueues[index]->functions.front());
+	m_workerQueues[index]->functions.pop_front();
+	m_pendingCount.fetch_sub(1);
+	return true;
+}
+
+bool DispatchQueue::stealFunction(size_t index, DispatchFunction& func)
+{
+	for (size_t i = 1; i < m_workerQueues.size(); i++)
+	{
+		WorkerQueue& victim = *m_workerQueues[(index + i) % m_workerQueues.size()];
+
+		std::lock_guard<std::mutex> lock(victim.mutex);
+		if (victim.functions.empty())
+			continue;
+
+		func = std::move(victim.functions.back());
+		victim.functions.pop_back();
+		m_pendingCount.fetch_sub(1);
+		return true;
+	}
+
+	return false;
+}
 
-				func = std::move(m_functionQueue.front());
-				m_functionQueue.pop();
-			}
+void DispatchQueue::workerThread(size_t index)
+{
+	currentWorker() = { this, index };
+
+	if (m_threadInitializer)
+		m_threadInitializer();
 
+	while (true)
+	{
+		DispatchFunction func;
+
+		if (popFunction(index, func) || stealFunction(index, func))
+		{
 			func();
+			continue;
 		}
 
-		if (m_cancelWorkers)
+		std::unique_lock<std::mutex> lock(m_idleMutex);
+
+		if (m_cancelWorkers && m_pendingCount.load() <= 0)
 			// Exit thread
 			break;
+
+		m_idleWorkerCount.fetch_add(1);
+		m_idleCondition.wait(lock, [&] { return m_pendingCount.load() > 0 || m_cancelWorkers; });
+		m_idleWorkerCount.fetch_sub(1);
 	}
 }
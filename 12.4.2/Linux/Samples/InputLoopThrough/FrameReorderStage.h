@@ -0,0 +1,154 @@
+/* -LICENSE-START-
+** Copyright (c) 2019 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#pragma once
+
+#include <functional>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+#include "DeckLinkAPI.h"
+#include "LoopThroughVideoFrame.h"
+
+// Restores stream time order to video frames that are processed concurrently.  Each frame is
+// registered in capture order before it is dispatched, and is held once processed until all
+// earlier frames have been released or discarded.  Frames are then passed to the ready callback
+// strictly in order of LoopThroughVideoFrame::getVideoStreamTime().  The callback is made without
+// the lock held, by one releasing thread at a time, so it may block without holding up threads that
+// register or release frames.
+class FrameReorderStage
+{
+	using FrameReadyCallback = std::function<void(std::shared_ptr<LoopThroughVideoFrame>)>;
+
+public:
+	FrameReorderStage() : m_releaseInProgress(false) { }
+	virtual ~FrameReorderStage() = default;
+
+	void	expectFrame(BMDTimeValue streamTime);
+	void	releaseFrame(std::shared_ptr<LoopThroughVideoFrame> videoFrame);
+	void	discardFrame(BMDTimeValue streamTime);
+	void	reset(void);
+
+	void	onFrameReady(const FrameReadyCallback& callback) { m_frameReadyCallback = callback; }
+
+private:
+	// Frames in flight, keyed by stream time; null until the frame has been processed
+	std::map<BMDTimeValue, std::shared_ptr<LoopThroughVideoFrame>>	m_pendingFrames;
+	std::mutex														m_mutex;
+	FrameReadyCallback												m_frameReadyCallback;
+	// Set while a thread is passing frames to the callback; frames that become ready meanwhile are
+	// passed on by that thread, so they cannot overtake the frames it is releasing
+	bool															m_releaseInProgress;
+	std::vector<std::shared_ptr<LoopThroughVideoFrame>>				m_readyFrames;
+
+	void	releaseReadyFrames(std::unique_lock<std::mutex>& lock);
+};
+
+void FrameReorderStage::expectFrame(BMDTimeValue streamTime)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_pendingFrames.emplace(streamTime, nullptr);
+}
+
+void FrameReorderStage::releaseFrame(std::shared_ptr<LoopThroughVideoFrame> videoFrame)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	auto iter = m_pendingFrames.find(videoFrame->getVideoStreamTime());
+	if (iter == m_pendingFrames.end())
+	{
+		// Frame was not registered before dispatch, or was flushed by reset; it can no longer be ordered
+		return;
+	}
+
+	iter->second = std::move(videoFrame);
+	releaseReadyFrames(lock);
+}
+
+void FrameReorderStage::discardFrame(BMDTimeValue streamTime)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	if (m_pendingFrames.erase(streamTime) > 0)
+		releaseReadyFrames(lock);
+}
+
+void FrameReorderStage::reset(void)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_pendingFrames.clear();
+}
+
+void FrameReorderStage::releaseReadyFrames(std::unique_lock<std::mutex>& lock)
+{
+	// Called with lock held.  If another thread is releasing, it will pass on any frames made ready here
+	if (m_releaseInProgress)
+		return;
+
+	m_releaseInProgress = true;
+
+	while (true)
+	{
+		while (!m_pendingFrames.empty() && m_pendingFrames.begin()->second)
+		{
+			m_readyFrames.push_back(std::move(m_pendingFrames.begin()->second));
+			m_pendingFrames.erase(m_pendingFrames.begin());
+		}
+
+		if (m_readyFrames.empty())
+			break;
+
+		// Other threads only touch the ready frames while releasing, so they can be passed on unlocked
+		lock.unlock();
+
+		for (auto& videoFrame : m_readyFrames)
+		{
+			if (m_frameReadyCallback)
+				m_frameReadyCallback(std::move(videoFrame));
+		}
+		m_readyFrames.clear();
+
+		lock.lock();
+	}
+
+	m_releaseInProgress = false;
+}
@@ -0,0 +1,235 @@
+/* -LICENSE-START-
+ ** Copyright (c) 2022 Blackmagic Design
+ **  
+ ** Permission is hereby granted, free of charge, to any person or organization 
+ ** obtaining a copy of the software and accompanying documentation (the 
+ ** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+ ** and transmit the Software, and to prepare derivative works of the Software, 
+ ** and to permit third-parties to whom the Software is furnished to do so, in 
+ ** accordance with:
+ ** 
+ ** (1) if the Software is obtained from Blackmagic Design, the End User License 
+ ** Agreement for the Software Development Kit (“EULA”) available at 
+ ** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+ ** 
+ ** (2) if the Software is obtained from any third party, such licensing terms 
+ ** as notified by that third party,
+ ** 
+ ** and all subject to the following:
+ ** 
+ ** (3) the copyright notices in the Software and this entire statement, 
+ ** including the above license grant, this restriction and the following 
+ ** disclaimer, must be included in all copies of the Software, in whole or in 
+ ** part, and all derivative works of the Software, unless such copies or 
+ ** derivative works are solely in the form of machine-executable object code 
+ ** generated by a source language processor.
+ ** 
+ ** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+ ** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ ** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+ ** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+ ** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+ ** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+ ** DEALINGS IN THE SOFTWARE.
+ ** 
+ ** A copy of the Software is available free of charge at 
+ ** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+ ** 
+ ** -LICENSE-END-
+ */
+
+#include <algorithm>
+#include <atomic>
+#include <cinttypes>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include <sys/syscall.h>
+#include <unistd.h>
+#include "FrameTrace.h"
+
+namespace
+{
+	struct TraceEvent
+	{
+		const char*		name;
+		const char*		detail;
+		BMDTimeValue	time;
+		BMDTimeValue	duration;		// -1 for an instant event
+		int64_t			frame;
+	};
+
+	// Ring of events written only by its owning thread.  A reader copies the events below the write
+	// index, then discards any that the writer may have overwritten while they were being copied.
+	struct ThreadEventRing
+	{
+		ThreadEventRing() :
+			threadId((int)syscall(SYS_gettid)),
+			threadName(nullptr),
+			writeIndex(0),
+			events(new TraceEvent[FrameTrace::kEventsPerThread])
+		{ }
+
+		int								threadId;
+		std::atomic<const char*>		threadName;
+		std::atomic<uint64_t>			writeIndex;
+		std::unique_ptr<TraceEvent[]>	events;
+	};
+
+	std::atomic<bool>								g_traceEnabled(false);
+	std::mutex										g_eventRingsMutex;
+	std::vector<std::shared_ptr<ThreadEventRing>>	g_eventRings;		// Rings are kept after their threads exit, so their events are written
+
+	ThreadEventRing& getThreadEventRing()
+	{
+		static thread_local std::shared_ptr<ThreadEventRing> threadEventRing;
+
+		if (!threadEventRing)
+		{
+			threadEventRing = std::make_shared<ThreadEventRing>();
+
+			std::lock_guard<std::mutex> lock(g_eventRingsMutex);
+			g_eventRings.push_back(threadEventRing);
+		}
+		return *threadEventRing;
+	}
+
+	void addEvent(const char* name, BMDTimeValue time, BMDTimeValue duration, int64_t frame, const char* detail)
+	{
+		ThreadEventRing& ring = getThreadEventRing();
+		uint64_t index = ring.writeIndex.load(std::memory_order_relaxed);
+
+		ring.events[index % FrameTrace::kEventsPerThread] = { name, detail, time, duration, frame };
+		ring.writeIndex.store(index + 1, std::memory_order_release);
+	}
+
+	std::vector<TraceEvent> copyEvents(const ThreadEventRing& ring)
+	{
+		uint64_t endIndex = ring.writeIndex.load(std::memory_order_acquire);
+		uint64_t beginIndex = (endIndex > FrameTrace::kEventsPerThread) ? endIndex - FrameTrace::kEventsPerThread : 0;
+
+		std::vector<TraceEvent> events;
+		events.reserve(endIndex - beginIndex);
+		for (uint64_t index = beginIndex; index < endIndex; index++)
+			events.push_back(ring.events[index % FrameTrace::kEventsPerThread]);
+
+		// Events the writer has since wrapped around onto may have been torn
+		std::atomic_thread_fence(std::memory_order_acquire);
+		uint64_t writeIndex = ring.writeIndex.load(std::memory_order_relaxed);
+		if (writeIndex > beginIndex + FrameTrace::kEventsPerThread)
+		{
+			uint64_t overwrittenCount = std::min<uint64_t>(writeIndex - beginIndex - FrameTrace::kEventsPerThread, events.size());
+			events.erase(events.begin(), events.begin() + overwrittenCount);
+		}
+		return events;
+	}
+
+	void writeJSONString(FILE* file, const char* str)
+	{
+		fputc('"', file);
+		for (; *str; str++)
+		{
+			if (*str == '"' || *str == '\\')
+				fputc('\\', file);
+			fputc(*str, file);
+		}
+		fputc('"', file);
+	}
+}
+
+void FrameTrace::enable(bool enabled)
+{
+	g_traceEnabled.store(enabled, std::memory_order_relaxed);
+}
+
+bool FrameTrace::isEnabled()
+{
+	return g_traceEnabled.load(std::memory_order_relaxed);
+}
+
+void FrameTrace::setThreadName(const char* name)
+{
+	if (isEnabled())
+		getThreadEventRing().threadName.store(name, std::memory_order_relaxed);
+}
+
+void FrameTrace::addSpan(const char* name, BMDTimeValue beginTime, BMDTimeValue endTime, int64_t frame, const char* detail)
+{
+	if (isEnabled())
+		addEvent(name, beginTime, std::max<BMDTimeValue>(endTime - beginTime, 0), frame, detail);
+}
+
+void FrameTrace::addInstant(const char* name, BMDTimeValue time, int64_t frame, const char* detail)
+{
+	if (isEnabled())
+		addEvent(name, time, -1, frame, detail);
+}
+
+bool FrameTrace::writeChromeTrace(const std::string& filename)
+{
+	std::vector<std::shared_ptr<ThreadEventRing>> eventRings;
+	{
+		std::lock_guard<std::mutex> lock(g_eventRingsMutex);
+		eventRings = g_eventRings;
+	}
+
+	// Write to a temporary file and rename it, so a trace being read is never partially written
+	std::string temporaryFilename = filename + ".tmp";
+	FILE* file = fopen(temporaryFilename.c_str(), "w");
+	if (!file)
+		return false;
+
+	int processId = (int)getpid();
+
+	fprintf(file, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n");
+	fprintf(file, "{\"name\":\"process_name\",\"ph\":\"M\",\"pid\":%d,\"args\":{\"name\":\"InputLoopThrough\"}}", processId);
+
+	for (auto& ring : eventRings)
+	{
+		const char* threadName = ring->threadName.load(std::memory_order_relaxed);
+		if (threadName)
+		{
+			fprintf(file, ",\n{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":%d,\"tid\":%d,\"args\":{\"name\":", processId, ring->threadId);
+			writeJSONString(file, threadName);
+			fprintf(file, "}}");
+		}
+
+		for (auto& event : copyEvents(*ring))
+		{
+			fprintf(file, ",\n{\"name\":");
+			writeJSONString(file, event.name);
+			if (event.duration < 0)
+				fprintf(file, ",\"ph\":\"i\",\"s\":\"t\",\"ts\":%" PRId64, (int64_t)event.time);
+			else
+				fprintf(file, ",\"ph\":\"X\",\"ts\":%" PRId64 ",\"dur\":%" PRId64, (int64_t)event.time, (int64_t)event.duration);
+			fprintf(file, ",\"pid\":%d,\"tid\":%d,\"args\":{", processId, ring->threadId);
+
+			bool firstArg = true;
+			if (event.frame != kNoFrame)
+			{
+				fprintf(file, "\"frame\":%" PRId64, event.frame);
+				firstArg = false;
+			}
+			if (event.detail)
+			{
+				fprintf(file, "%s\"detail\":", firstArg ? "" : ",");
+				writeJSONString(file, event.detail);
+			}
+			fprintf(file, "}}");
+		}
+	}
+
+	fprintf(file, "\n]}\n");
+
+	bool success = (fflush(file) == 0) && !ferror(file);
+	if (fclose(file) != 0)
+		success = false;
+
+	if (!success || rename(temporaryFilename.c_str(), filename.c_str()) != 0)
+	{
+		remove(temporaryFilename.c_str());
+		return false;
+	}
+	return true;
+}
@@ -0,0 +1,70 @@
+/* -LICENSE-START-
+ ** Copyright (c) 2022 Blackmagic Design
+ **  
+ ** Permission is hereby granted, free of charge, to any person or organization 
+ ** obtaining a copy of the software and accompanying documentation (the 
+ ** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+ ** and transmit the Software, and to prepare derivative works of the Software, 
+ ** and to permit third-parties to whom the Software is furnished to do so, in 
+ ** accordance with:
+ ** 
+ ** (1) if the Software is obtained from Blackmagic Design, the End User License 
+ ** Agreement for the Software Development Kit (“EULA”) available at 
+ ** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+ ** 
+ ** (2) if the Software is obtained from any third party, such licensing terms 
+ ** as notified by that third party,
+ ** 
+ ** and all subject to the following:
+ ** 
+ ** (3) the copyright notices in the Software and this entire statement, 
+ ** including the above license grant, this restriction and the following 
+ ** disclaimer, must be included in all copies of the Software, in whole or in 
+ ** part, and all derivative works of the Software, unless such copies or 
+ ** derivative works are solely in the form of machine-executable object code 
+ ** generated by a source language processor.
+ ** 
+ ** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+ ** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ ** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+ ** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+ ** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+ ** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+ ** DEALINGS IN THE SOFTWARE.
+ ** 
+ ** A copy of the Software is available free of charge at 
+ ** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+ ** 
+ ** -LICENSE-END-
+ */
+
+#pragma once
+
+#include <string>
+#include "DeckLinkAPI.h"
+
+// Per-frame lifecycle trace, written as Chrome trace event JSON, which chrome://tracing and the
+// Perfetto UI both open.  Each thread records into its own ring of fixed-size events, so recording
+// is a few stores and a release of the ring's write index, without locks; when tracing is disabled
+// it is a single relaxed load.  Each ring keeps the most recent kEventsPerThread events.
+//
+// Times are reference times in microseconds, per ReferenceTime::getSteadyClockUptimeCount().
+// Event names and details must be string literals, as only the pointers are recorded.
+namespace FrameTrace
+{
+	const size_t	kEventsPerThread	= 32768;
+	const int64_t	kNoFrame			= -1;
+
+	void	enable(bool enabled);
+	bool	isEnabled(void);
+
+	// Names the calling thread's track in the trace
+	void	setThreadName(const char* name);
+
+	// Records an event spanning [beginTime, endTime] on the calling thread's track
+	void	addSpan(const char* name, BMDTimeValue beginTime, BMDTimeValue endTime, int64_t frame, const char* detail = nullptr);
+	void	addInstant(const char* name, BMDTimeValue time, int64_t frame, const char* detail = nullptr);
+
+	// Writes the events currently held by all threads, replacing the file atomically
+	bool	writeChromeTrace(const std::string& filename);
+};
@@ -60,9 +60,19 @@
 //     can set your video output preroll size, defined by constant kOutputVideoPreroll
 // * If the video processing pipeline is long, then you will need to increase the number of
 //     worker threads for concurrent processing.  The sample defines a dispatch queue, whose
-//     number of threads is defined by constant kDispatcherThreadCount
+//     number of threads is defined by constant kDispatcherThreadCount.  Processed video frames
+//     pass through a reorder stage, so they are scheduled in stream time order regardless of
+//     the number of threads
 // * If there is large variance in the video processing latency, then it is recommended that
-//     the preroll is increased to reduce the risk of late or dropped frames on output
+//     the preroll is increased to reduce the risk of late or dropped frames on output.  With -a,
+//     the preroll is adjusted while running instead, between the given bounds on output delay:
+//     it grows by a frame when a frame is displayed late or dropped, and shrinks by a frame when
+//     the frames are consistently scheduled more than a frame ahead of their output
+// * If the input and output cannot be locked to the same reference, their audio sample clocks
+//     drift apart and the audio buffered by the output grows or shrinks until it overflows or
+//     underruns.  With -d, the input audio is resampled to hold the buffered audio at a target
+//     level, by the ratio of the input and output clocks estimated from the output's hardware
+//     reference clock, with a correction for the buffered sample frame count
 //
 // Additional considerations:
 // * Ensure that a valid input source is provided with a display mode that is supported by
@@ -71,16 +81,24 @@
 //     injects a random sleep time into the pipeline.  The time's mean and standard
 //     deviation can be adjusted by constants kProcessingAdditionalTimeMean and
 //     kProcessingAdditionalTimeStdDev respectively
-// * The sample has 2 console output modes of operation, defined by constant kPrintRollingAverage
-//   - When set to true, a rolling average of latency is displayed to stdout with ms
-//     interval defined by constant kRollingAverageUpdateRateMs with rolling average
-//     sample could defined by constant kRollingAverageSampleCount
+// * The sample has 2 console output modes of operation, defined by constant kPrintLatencyWindow
+//   - When set to true, the median and 99th percentile latency of the frames output in each
+//     interval, defined by constant kLatencyWindowMs, is displayed to stdout
 //   - When set to false, the latency for every output frame is displayed to stdout
-//   - In both modes or operation, a full statistical summary is displayed when application
-//     completes
+//   - In both modes or operation, a summary of the latency distribution of each stage
+//     (minimum, mean, 50th, 90th, 99th and 99.9th percentiles and maximum) is written as
+//     JSON or CSV when the application completes, to stdout or to the file given with -o
+// * With -w, the frame watermark stamped by TestPattern -w is checked as frames arrive on the input,
+//     reporting dropped, repeated, reordered and corrupted frames and the latency from the start of
+//     the frame on the TestPattern output to its start on the input
+// * With -t, the lifecycle of each frame (input, dispatch queue, processing, output queue,
+//     ScheduleVideoFrame call, output and completion callback) is traced per thread and written
+//     as Chrome trace JSON on SIGUSR1 and on exit, to be viewed in chrome://tracing or Perfetto
 //*************************************************************************************/
 
 
+#include <algorithm>
+#include <atomic>
 #include <chrono>
 #include <condition_variable>
 #include <functional>
@@ -89,13 +107,25 @@
 #include <mutex>
 #include <random>
 #include <thread>
+#include <pthread.h>
+#include <signal.h>
+#include <unistd.h>
 
+#include "AdaptivePreroll.h"
+#include "AudioDriftCompensator.h"
 #include "DeckLinkInputDevice.h"
 #include "DeckLinkOutputDevice.h"
+#include "DeckLinkTelemetry.h"
 #include "DispatchQueue.h"
+#include "FrameReorderStage.h"
+#include "FrameTrace.h"
+#include "FrameWatermark.h"
 #include "SampleQueue.h"
 #include "LatencyStatistics.h"
+#include "PixelFormatTraits.h"
+#include "PooledMemoryAllocator.h"
 #include "ReferenceTime.h"
+#include "ThreadConfiguration.h"
 #include "DeckLinkAPI.h"
 #include "com_ptr.h"
 #include "platform.h"
@@ -111,9 +141,10 @@ const int					kVideoDispatcherThreadCount	= 3;		// number of threads used by vid
 const int					kAudioDispatcherThreadCount	= 2;		// number of threads used by audio processing dispatcher
 const int					kPrintDispatcherThreadCount	= 1;		// number of threads used by print stdout dispatcher
 
-const bool					kPrintRollingAverage		= true;		// If true, display latency as rolling average, if false print latency for each frame
-const int					kRollingAverageSampleCount	= 300;		// Number of samples for calculating rolling average of latency
-const long					kRollingAverageUpdateRateMs	= 2000;		// Print rolling average every 2 seconds
+const long					kDefaultMaximumOutputDelayMs	= 200;	// Upper bound of adaptive preroll, when not given with -a
+
+const bool					kPrintLatencyWindow			= true;		// If true, display latency percentiles for each window, if false print latency for each frame
+const long					kLatencyWindowMs			= 2000;		// Print latency percentiles every 2 seconds
 
 const double				kProcessingAdditionalTimeMean		= 5.0;		// Mean additional time injected into video processing thread (ms)
 const double				kProcessingAdditionalTimeStdDev		= 0.1;		// Standard deviation of time injected into video processing thread (ms)
@@ -127,20 +158,6 @@ const std::map<BMDOutputFrameCompletionResult, std::pair<const char*, bool>> kOu
 	{ bmdOutputFrameFlushed,		std::make_pair("flushed",			false) },
 };
 
-// List of known pixel formats and their matching display names
-const std::map<BMDPixelFormat, const char*> kPixelFormats =
-{
-	{ bmdFormat8BitYUV,		"8-bit YUV" },
-	{ bmdFormat10BitYUV,	"10-bit YUV" },
-	{ bmdFormat8BitARGB,	"8-bit ARGB" },
-	{ bmdFormat8BitBGRA,	"8-bit BGRA" },
-	{ bmdFormat10BitRGB,	"10-bit RGB" },
-	{ bmdFormat12BitRGB,	"12-bit RGB" },
-	{ bmdFormat12BitRGBLE,	"12-bit RGBLE" },
-	{ bmdFormat10BitRGBXLE,	"10-bit RGBXLE" },
-	{ bmdFormat10BitRGBX,	"10-bit RGBX" },
-};
-
 struct ThreadNotifier
 {
 	std::mutex mutex;
@@ -179,20 +196,56 @@ private:
 };
 
 uint32_t														g_audioChannelCount = kDefaultAudioChannelCount;
+uint32_t														g_frameBufferPoolSize = 0;		// Number of pooled input frame buffers, 0 to use the driver's allocator
+int																g_frameBufferNumaNode = -1;		// NUMA node for pooled frame buffers, -1 for the node nearest the input device
 
-LatencyStatistics												g_videoInputLatencyStatistics(kRollingAverageSampleCount);
-LatencyStatistics												g_videoProcessingLatencyStatistics(kRollingAverageSampleCount);
-LatencyStatistics												g_videoOutputLatencyStatistics(kRollingAverageSampleCount);
-LatencyStatistics												g_audioProcessingLatencyStatistics(kRollingAverageSampleCount);
+LatencyStatistics												g_videoInputLatencyStatistics;
+LatencyStatistics												g_videoProcessingLatencyStatistics;
+LatencyStatistics												g_videoOutputLatencyStatistics;
+LatencyStatistics												g_videoTotalLatencyStatistics;		// Input, processing and output latency of each frame
+LatencyStatistics												g_audioProcessingLatencyStatistics;
 
 std::map<BMDOutputFrameCompletionResult, int>					g_frameCompletionResultCount;
 int 															g_outputFrameCount = 0;
 int																g_droppedOnCaptureFrameCount = 0;
 
+enum class SummaryFormat
+{
+	JSON,
+	CSV
+};
+
+// Frame counts and latency distributions of a loop-through session, which ends on exit or on an input format change
+struct SessionSummary
+{
+	std::string										displayModeName;
+	const char*										pixelFormatName;
+	int												droppedOnCaptureFrameCount;
+	std::vector<std::pair<const char*, int>>		frameCompletionResultCounts;
+	std::vector<std::pair<const char*, LatencyHistogram>>	latencyHistograms;
+};
+
+SummaryFormat													g_summaryFormat = SummaryFormat::JSON;
+std::string														g_summaryFilename;				// Latency summary is written to stdout when empty
+std::vector<SessionSummary>										g_sessionSummaries;
+
+// Published for monitors; capture latency is input latency, and playback latency is input to output latency
+TelemetryPublisher												g_telemetryPublisher;
+std::shared_ptr<TelemetryStream>								g_captureTelemetry = std::make_shared<TelemetryStream>();
+std::shared_ptr<TelemetryStream>								g_playbackTelemetry = std::make_shared<TelemetryStream>();
+std::atomic<uint64_t>											g_videoProcessingQueueDepth(0);		// Frames dispatched and waiting for a video processing thread
+
+std::string														g_traceFilename;				// Frame lifecycle trace is disabled when empty
+std::atomic<bool>												g_traceWriterStopping(false);
+
+AdaptivePrerollController										g_prerollController;			// Fixed preroll unless enabled with -a
+AudioDriftCompensator											g_audioDriftCompensator;		// Audio is not resampled unless enabled with -d
+std::shared_ptr<WatermarkChecker>								g_watermarkChecker;				// Watermarks are not checked unless enabled with -w
+
 std::default_random_engine 										g_randomEngine;
 std::normal_distribution<double> 								g_sleepDistribution(kProcessingAdditionalTimeMean, kProcessingAdditionalTimeStdDev);
 
-ThreadNotifier													g_printRollingAverageNotifier;
+ThreadNotifier													g_printLatencyWindowNotifier;
 ThreadNotifier													g_loopThroughSessionNotifier;
 
 struct FormatDescription
@@ -226,19 +279,33 @@ void dispatch_printf(DispatchQueue& dispatchQueue, const char* format, Args... a
 	});
 }
 
-void processVideo(std::shared_ptr<LoopThroughVideoFrame>& videoFrame, com_ptr<DeckLinkOutputDevice>& deckLinkOutput)
+void processVideo(std::shared_ptr<LoopThroughVideoFrame>& videoFrame, com_ptr<DeckLinkOutputDevice>& deckLinkOutput, FrameReorderStage& outputFrameReorderStage)
 {
 	// Main video processing function, it is intended to invoke with DispatchQueue to allow multi-threading of incoming frames
 	// Inputs:	videoFrame - input/output video frame with stream time
 	//			deckLinkOutput - reference to IDeckLinkOutput
-	// At end of function, queue output frame for scheduling by calling deckLinkOutput->scheduleVideoFrame
+	//			outputFrameReorderStage - restores stream time order before frames are scheduled on deckLinkOutput
+	// At end of function, queue output frame for scheduling by calling outputFrameReorderStage.releaseFrame
 	//
 	// Developers are encouraged to insert their own processing test code in this function, by default we will simply forward the LoopThroughVideoFrame object.
 	// The input frame may be replaced by another IDeckLinkVideoFrame object for output by calling LoopThroughVideoFrame::setVideoFrame()
 
+	BMDTimeValue processingStartedReferenceTime = ReferenceTime::getSteadyClockUptimeCount();
+	int64_t frameNumber = videoFrame->getStreamFrameNumber();
+
+	g_captureTelemetry->setQueueDepth(--g_videoProcessingQueueDepth);
+
+	FrameTrace::setThreadName("Video processing");
+	FrameTrace::addSpan("Dispatch queue", videoFrame->getProcessingQueuedReferenceTime(), processingStartedReferenceTime, frameNumber);
+
 	// Check playback is active, if it is inactive, it is likely that the incoming display mode is not supported by output
 	if (!deckLinkOutput->isPlaybackActive())
+	{
+		// Frames that will not be output must still be discarded, so later frames are not held
+		outputFrameReorderStage.discardFrame(videoFrame->getVideoStreamTime());
+		FrameTrace::addSpan("Process", processingStartedReferenceTime, ReferenceTime::getSteadyClockUptimeCount(), frameNumber, "discarded");
 		return;
+	}
 
 	// Simulate doing something by using a busy wait loop
 	// This is more precise than sleeping
@@ -248,16 +315,29 @@ void processVideo(std::shared_ptr<LoopThroughVideoFrame>& videoFrame, com_ptr<De
 	while (std::chrono::steady_clock::now() < target)
 		++i;
 
+	videoFrame->setProcessingCompletedReferenceTime(ReferenceTime::getSteadyClockUptimeCount());
+	FrameTrace::addSpan("Process", processingStartedReferenceTime, videoFrame->getProcessingCompletedReferenceTime(), frameNumber);
+
 	// At end of function, remember to queue your output frame
-	deckLinkOutput->scheduleVideoFrame(std::move(videoFrame));
+	outputFrameReorderStage.releaseFrame(std::move(videoFrame));
 }
 
 
-void processAudio(std::shared_ptr<LoopThroughAudioPacket>& audioPacket, com_ptr<DeckLinkOutputDevice>& deckLinkOutput)
+void printDroppedOutputAudioPacket(std::shared_ptr<LoopThroughAudioPacket> audioPacket, DispatchQueue& printDispatchQueue)
+{
+	// The output queue was full, so the packet was dropped before it was scheduled
+	g_playbackTelemetry->addDroppedAudioPackets();
+
+	if (!kPrintLatencyWindow)
+		dispatch_printf(printDispatchQueue, "Audio packet at stream time %lld (dropped on output queue);\n", (long long)audioPacket->getAudioStreamTime());
+}
+
+void processAudio(std::shared_ptr<LoopThroughAudioPacket>& audioPacket, com_ptr<DeckLinkOutputDevice>& deckLinkOutput, DispatchQueue& printDispatchQueue)
 {
 	// Main audio processing function, it is intended to invoke with DispatchQueue to allow multi-threading of incoming packets
 	// Inputs:	inputAudioPacket - input audio packet with stream time
 	//			deckLinkOutput - reference to IDeckLinkOutput
+	//			printDispatchQueue - reports packets dropped by a full output queue
 	// At end of function, queue output frame for scheduling by calling deckLinkOutput->scheduleAudioBuffer
 	//
 	// Developers are encouraged to insert their own processing test code in this function, by default we will simply forward the LoopThroughAudioPacket object.
@@ -276,7 +356,8 @@ void processAudio(std::shared_ptr<LoopThroughAudioPacket>& audioPacket, com_ptr<
 		++i;
 	
 	// At end of function, remember to queue your output audio packet
-	deckLinkOutput->scheduleAudioPacket(std::move(audioPacket));
+	if (!deckLinkOutput->scheduleAudioPacket(audioPacket))
+		printDroppedOutputAudioPacket(audioPacket, printDispatchQueue);
 }
 
 std::string getDeckLinkDisplayName(com_ptr<IDeckLink> deckLink)
@@ -300,11 +381,21 @@ std::string getDeckLinkDisplayName(com_ptr<IDeckLink> deckLink)
 void printDroppedCaptureFrame(BMDTimeValue streamTime, BMDTimeValue frameDuration, DispatchQueue& printDispatchQueue)
 {
 	++g_droppedOnCaptureFrameCount;
+	g_captureTelemetry->addDroppedFrames();
 
-	if (!kPrintRollingAverage)
+	if (!kPrintLatencyWindow)
 		dispatch_printf(printDispatchQueue, "Frame %d (dropped);\n", streamTime / frameDuration);
 }
 
+void printDroppedOutputFrame(std::shared_ptr<LoopThroughVideoFrame> videoFrame, DispatchQueue& printDispatchQueue)
+{
+	// The output queue was full, so the frame was dropped before it was scheduled
+	g_playbackTelemetry->addDroppedFrames();
+
+	if (!kPrintLatencyWindow)
+		dispatch_printf(printDispatchQueue, "Frame %d (dropped on output queue);\n", videoFrame->getVideoStreamTime() / videoFrame->getVideoFrameDuration());
+}
+
 void printOutputCompletionResult(std::shared_ptr<LoopThroughVideoFrame> completedFrame, DispatchQueue& printDispatchQueue)
 {
 	const char*		completionResultString;
@@ -336,49 +427,124 @@ void printOutputCompletionResult(std::shared_ptr<LoopThroughVideoFrame> complete
 
 void updateCompletedFrameLatency(std::shared_ptr<LoopThroughVideoFrame> completedFrame, DispatchQueue& printDispatchQueue)
 {
-	bool frameDisplayed;
+	const char*		completionResultString;
+	bool			frameDisplayed;
 	try
 	{
-		std::tie(std::ignore, frameDisplayed) = kOutputCompletionResults.at(completedFrame->getOutputCompletionResult());
+		std::tie(completionResultString, frameDisplayed) = kOutputCompletionResults.at(completedFrame->getOutputCompletionResult());
 	}
 	catch (std::out_of_range)
 	{
 		fprintf(stderr, "Unexpected video frame output completion result\n");
 		return;
 	}
+
+	FrameTrace::addSpan("Output", completedFrame->getOutputFrameScheduledReferenceTime(), completedFrame->getOutputFrameCompletedReferenceTime(),
+						completedFrame->getStreamFrameNumber(), completionResultString);
 	
+	switch (completedFrame->getOutputCompletionResult())
+	{
+		case bmdOutputFrameDisplayedLate:
+			g_playbackTelemetry->addLateFrames();
+			break;
+		case bmdOutputFrameDropped:
+			g_playbackTelemetry->addDroppedFrames();
+			break;
+		default:
+			break;
+	}
+
 	if (frameDisplayed)
 	{
+		g_captureTelemetry->addLatencySample(completedFrame->getInputLatency());
+		g_playbackTelemetry->addFramesOut();
+		g_playbackTelemetry->addLatencySample(completedFrame->getInputLatency() + completedFrame->getProcessingLatency() + completedFrame->getOutputLatency());
+
 		g_videoInputLatencyStatistics.addSample(completedFrame->getInputLatency());
 		g_videoProcessingLatencyStatistics.addSample(completedFrame->getProcessingLatency());
 		g_videoOutputLatencyStatistics.addSample(completedFrame->getOutputLatency());
+		g_videoTotalLatencyStatistics.addSample(completedFrame->getInputLatency() + completedFrame->getProcessingLatency() + completedFrame->getOutputLatency());
 	}
 	
 	g_outputFrameCount++;
 	++g_frameCompletionResultCount[completedFrame->getOutputCompletionResult()];
+
+	g_prerollController.addCompletedFrame(*completedFrame);
 	
-	if (!kPrintRollingAverage)
+	if (!kPrintLatencyWindow)
 	{
 		printOutputCompletionResult(std::move(completedFrame), printDispatchQueue);
 	}
 }
 
-void printRollingAverage(DispatchQueue& printDispatchQueue)
+void printWatermarkStatistics(const WatermarkStatistics& statistics, DispatchQueue& printDispatchQueue)
 {
-	std::chrono::milliseconds	printRollingAveragePeriod(kRollingAverageUpdateRateMs);
-	
+	dispatch_printf(printDispatchQueue,
+					"Watermark: %llu checked, %llu unmarked, %llu dropped, %llu repeated, %llu reordered, %llu corrupted, %llu not CRC checked",
+					(unsigned long long)statistics.framesChecked,
+					(unsigned long long)statistics.framesUnmarked,
+					(unsigned long long)statistics.framesDropped,
+					(unsigned long long)statistics.framesRepeated,
+					(unsigned long long)statistics.framesReordered,
+					(unsigned long long)statistics.framesCorrupted,
+					(unsigned long long)statistics.framesUnverified);
+
+	if (statistics.latencySampleCount > 0)
+	{
+		dispatch_printf(printDispatchQueue,
+						"; Glass-to-glass latency min/mean/max = %.2f/%.2f/%.2f ms\n",
+						statistics.latencyMin * 1000.0 / kWatermarkTimeScale,
+						(double)statistics.latencyTotal * 1000.0 / kWatermarkTimeScale / statistics.latencySampleCount,
+						statistics.latencyMax * 1000.0 / kWatermarkTimeScale);
+	}
+	else
+	{
+		dispatch_printf(printDispatchQueue, "\n");
+	}
+}
+
+void printLatencyWindow(DispatchQueue& printDispatchQueue)
+{
+	std::chrono::milliseconds	printLatencyWindowPeriod(kLatencyWindowMs);
+
+	ThreadConfiguration::applyToCurrentThread(ThreadRole::Print);
+
+	// Discard samples from before the first window
+	g_videoInputLatencyStatistics.getWindowSnapshot();
+	g_videoProcessingLatencyStatistics.getWindowSnapshot();
+	g_videoOutputLatencyStatistics.getWindowSnapshot();
+
 	while (true)
 	{
-		std::unique_lock<std::mutex> lock(g_printRollingAverageNotifier.mutex);
-		if (!g_printRollingAverageNotifier.condition.wait_for(lock, printRollingAveragePeriod, [] { return g_printRollingAverageNotifier.isNotifiedLocked(); }))
+		std::unique_lock<std::mutex> lock(g_printLatencyWindowNotifier.mutex);
+		if (!g_printLatencyWindowNotifier.condition.wait_for(lock, printLatencyWindowPeriod, [] { return g_printLatencyWindowNotifier.isNotifiedLocked(); }))
 		{
-			// Timeout, print rolling average
+			// Timeout, print the percentiles of the frames output since the last window
+			LatencyHistogram inputLatency		= g_videoInputLatencyStatistics.getWindowSnapshot();
+			LatencyHistogram processingLatency	= g_videoProcessingLatencyStatistics.getWindowSnapshot();
+			LatencyHistogram outputLatency		= g_videoOutputLatencyStatistics.getWindowSnapshot();
+
 			dispatch_printf(printDispatchQueue,
-							"%d frames output; Average latency: Input = %.2f ms, Processing = %.2f ms, Output = %.2f ms\n",
+							"%d frames output; Latency p50/p99: Input = %.2f/%.2f ms, Processing = %.2f/%.2f ms, Output = %.2f/%.2f ms\n",
 							g_outputFrameCount,
-							(double)g_videoInputLatencyStatistics.getRollingAverage() / ReferenceTime::kTicksPerMilliSec,
-							(double)g_videoProcessingLatencyStatistics.getRollingAverage() / ReferenceTime::kTicksPerMilliSec,
-							(double)g_videoOutputLatencyStatistics.getRollingAverage() / ReferenceTime::kTicksPerMilliSec);
+							(double)inputLatency.getValueAtPercentile(50.0) / ReferenceTime::kTicksPerMilliSec,
+							(double)inputLatency.getValueAtPercentile(99.0) / ReferenceTime::kTicksPerMilliSec,
+							(double)processingLatency.getValueAtPercentile(50.0) / ReferenceTime::kTicksPerMilliSec,
+							(double)processingLatency.getValueAtPercentile(99.0) / ReferenceTime::kTicksPerMilliSec,
+							(double)outputLatency.getValueAtPercentile(50.0) / ReferenceTime::kTicksPerMilliSec,
+							(double)outputLatency.getValueAtPercentile(99.0) / ReferenceTime::kTicksPerMilliSec);
+
+			if (g_audioDriftCompensator.isEnabled())
+			{
+				AudioDriftCompensator::Status status = g_audioDriftCompensator.getStatus();
+
+				dispatch_printf(printDispatchQueue,
+								"Audio buffered = %.2f ms (target %.2f ms); Input clock offset = %+.1f ppm, Level correction = %+.1f ppm\n",
+								status.bufferedLevel, status.targetLevel, status.clockOffset, status.levelCorrection);
+			}
+
+			if (g_watermarkChecker)
+				printWatermarkStatistics(g_watermarkChecker->getStatistics(), printDispatchQueue);
 		}
 		else
 		{
@@ -387,59 +553,162 @@ void printRollingAverage(DispatchQueue& printDispatchQueue)
 	}
 }
 
-void printOutputSummary(DispatchQueue& printDispatchQueue)
+void recordSessionSummary(const std::string& displayModeName, BMDPixelFormat pixelFormat)
 {
-	int displayedFrames = 0;
-	dispatch_printf(printDispatchQueue, "\nFrames dropped on capture: %d\n", g_droppedOnCaptureFrameCount);
+	SessionSummary summary;
+
+	summary.displayModeName				= displayModeName;
+	summary.pixelFormatName				= GetPixelFormatName(pixelFormat);
+	summary.droppedOnCaptureFrameCount	= g_droppedOnCaptureFrameCount;
+
 	for (auto completionResultIter : kOutputCompletionResults)
 	{
-		const char* completionResultString;
-		bool frameDisplayed;
-		
-		std::tie(completionResultString, frameDisplayed) = completionResultIter.second;
-		
 		auto completionCountIter = g_frameCompletionResultCount.find(completionResultIter.first);
 		int frameCount = (completionCountIter != g_frameCompletionResultCount.end()) ? completionCountIter->second : 0;
-		dispatch_printf(printDispatchQueue, "Frames %s: %d\n", completionResultString, frameCount);
-		if (frameDisplayed)
-			displayedFrames += frameCount;
+		summary.frameCompletionResultCounts.push_back(std::make_pair(completionResultIter.second.first, frameCount));
 	}
-	if (displayedFrames > 0)
+
+	summary.latencyHistograms.push_back(std::make_pair("videoInput", g_videoInputLatencyStatistics.getSnapshot()));
+	summary.latencyHistograms.push_back(std::make_pair("videoProcessing", g_videoProcessingLatencyStatistics.getSnapshot()));
+	summary.latencyHistograms.push_back(std::make_pair("videoOutput", g_videoOutputLatencyStatistics.getSnapshot()));
+	summary.latencyHistograms.push_back(std::make_pair("videoTotal", g_videoTotalLatencyStatistics.getSnapshot()));
+	summary.latencyHistograms.push_back(std::make_pair("audioProcessing", g_audioProcessingLatencyStatistics.getSnapshot()));
+
+	g_sessionSummaries.push_back(std::move(summary));
+}
+
+template<typename... Args>
+void appendf(std::string& str, const char* format, Args... args)
+{
+	int size = snprintf(NULL, 0, format, args...);
+	std::vector<char> buf(size + 1);
+	snprintf(buf.data(), size + 1, format, args...);
+	str.append(buf.data(), size);
+}
+
+std::string formatSummaryJSON(void)
+{
+	std::string json = "{\n\t\"unit\": \"us\",\n\t\"sessions\": [";
+
+	for (size_t sessionIndex = 0; sessionIndex < g_sessionSummaries.size(); sessionIndex++)
 	{
-		BMDTimeValue mean;
-		BMDTimeValue stddev;
-		
-		std::tie(mean, stddev) = g_videoInputLatencyStatistics.getMeanAndStdDev();
-		dispatch_printf(printDispatchQueue,
-						"\nVideo Input Latency:\t\tMinimum = %6.2f ms, Maximum = %6.2f ms, Mean = %6.2f ms, StdDev = %.2f ms\n",
-						(double)g_videoInputLatencyStatistics.getMinimum() / ReferenceTime::kTicksPerMilliSec,
-						(double)g_videoInputLatencyStatistics.getMaximum() / ReferenceTime::kTicksPerMilliSec,
-						(double)mean / ReferenceTime::kTicksPerMilliSec,
-						(double)stddev / ReferenceTime::kTicksPerMilliSec);
-		
-		std::tie(mean, stddev) = g_videoProcessingLatencyStatistics.getMeanAndStdDev();
-		dispatch_printf(printDispatchQueue,
-						"Video Processing Latency:\tMinimum = %6.2f ms, Maximum = %6.2f ms, Mean = %6.2f ms, StdDev = %.2f ms\n",
-						(double)g_videoProcessingLatencyStatistics.getMinimum() / ReferenceTime::kTicksPerMilliSec,
-						(double)g_videoProcessingLatencyStatistics.getMaximum() / ReferenceTime::kTicksPerMilliSec,
-						(double)mean / ReferenceTime::kTicksPerMilliSec,
-						(double)stddev / ReferenceTime::kTicksPerMilliSec);
+		const SessionSummary& summary = g_sessionSummaries[sessionIndex];
 
-		std::tie(mean, stddev) = g_videoOutputLatencyStatistics.getMeanAndStdDev();
-		dispatch_printf(printDispatchQueue,
-						"Video Output Latency:\t\tMinimum = %6.2f ms, Maximum = %6.2f ms, Mean = %6.2f ms, StdDev = %.2f ms\n",
-						(double)g_videoOutputLatencyStatistics.getMinimum() / ReferenceTime::kTicksPerMilliSec,
-						(double)g_videoOutputLatencyStatistics.getMaximum() / ReferenceTime::kTicksPerMilliSec,
-						(double)mean / ReferenceTime::kTicksPerMilliSec,
-						(double)stddev / ReferenceTime::kTicksPerMilliSec);
-		
-		std::tie(mean, stddev) = g_audioProcessingLatencyStatistics.getMeanAndStdDev();
-		dispatch_printf(printDispatchQueue,
-						"Audio Processing Latency:\tMinimum = %6.2f ms, Maximum = %6.2f ms, Mean = %6.2f ms, StdDev = %.2f ms\n",
-						(double)g_audioProcessingLatencyStatistics.getMinimum() / ReferenceTime::kTicksPerMilliSec,
-						(double)g_audioProcessingLatencyStatistics.getMaximum() / ReferenceTime::kTicksPerMilliSec,
-						(double)mean / ReferenceTime::kTicksPerMilliSec,
-						(double)stddev / ReferenceTime::kTicksPerMilliSec);	}
+		appendf(json, "%s\n\t\t{\n\t\t\t\"displayMode\": \"%s\",\n\t\t\t\"pixelFormat\": \"%s\",\n\t\t\t\"framesDroppedOnCapture\": %d,\n\t\t\t\"frames\": {",
+				(sessionIndex > 0) ? "," : "", summary.displayModeName.c_str(), summary.pixelFormatName, summary.droppedOnCaptureFrameCount);
+
+		for (size_t i = 0; i < summary.frameCompletionResultCounts.size(); i++)
+			appendf(json, "%s \"%s\": %d", (i > 0) ? "," : "", summary.frameCompletionResultCounts[i].first, summary.frameCompletionResultCounts[i].second);
+
+		json += " },\n\t\t\t\"latency\": {";
+
+		for (size_t i = 0; i < summary.latencyHistograms.size(); i++)
+		{
+			const LatencyHistogram& histogram = summary.latencyHistograms[i].second;
+
+			appendf(json, "%s\n\t\t\t\t\"%s\": { \"samples\": %llu, \"min\": %lld, \"mean\": %.1f, \"p50\": %lld, \"p90\": %lld, \"p99\": %lld, \"p99.9\": %lld, \"max\": %lld }",
+					(i > 0) ? "," : "",
+					summary.latencyHistograms[i].first,
+					(unsigned long long)histogram.getSampleCount(),
+					(long long)histogram.getMinimum(),
+					histogram.getMean(),
+					(long long)histogram.getValueAtPercentile(50.0),
+					(long long)histogram.getValueAtPercentile(90.0),
+					(long long)histogram.getValueAtPercentile(99.0),
+					(long long)histogram.getValueAtPercentile(99.9),
+					(long long)histogram.getMaximum());
+		}
+
+		json += "\n\t\t\t}\n\t\t}";
+	}
+
+	json += "\n\t]\n}\n";
+	return json;
+}
+
+std::string formatSummaryCSV(void)
+{
+	// One row per stage of each session; frame counts are repeated on each row of the session
+	std::string csv = "session,display_mode,pixel_format,frames_dropped_on_capture";
+
+	if (!g_sessionSummaries.empty())
+	{
+		for (auto& frameCount : g_sessionSummaries.front().frameCompletionResultCounts)
+		{
+			std::string columnName = std::string("frames_") + frameCount.first;
+			std::replace(columnName.begin(), columnName.end(), ' ', '_');
+			csv += "," + columnName;
+		}
+	}
+
+	csv += ",stage,samples,min_us,mean_us,p50_us,p90_us,p99_us,p99.9_us,max_us\n";
+
+	for (size_t sessionIndex = 0; sessionIndex < g_sessionSummaries.size(); sessionIndex++)
+	{
+		const SessionSummary& summary = g_sessionSummaries[sessionIndex];
+
+		for (auto& stage : summary.latencyHistograms)
+		{
+			const LatencyHistogram& histogram = stage.second;
+
+			appendf(csv, "%d,%s,%s,%d", (int)sessionIndex, summary.displayModeName.c_str(), summary.pixelFormatName, summary.droppedOnCaptureFrameCount);
+
+			for (auto& frameCount : summary.frameCompletionResultCounts)
+				appendf(csv, ",%d", frameCount.second);
+
+			appendf(csv, ",%s,%llu,%lld,%.1f,%lld,%lld,%lld,%lld,%lld\n",
+					stage.first,
+					(unsigned long long)histogram.getSampleCount(),
+					(long long)histogram.getMinimum(),
+					histogram.getMean(),
+					(long long)histogram.getValueAtPercentile(50.0),
+					(long long)histogram.getValueAtPercentile(90.0),
+					(long long)histogram.getValueAtPercentile(99.0),
+					(long long)histogram.getValueAtPercentile(99.9),
+					(long long)histogram.getMaximum());
+		}
+	}
+
+	return csv;
+}
+
+void writeLatencySummary(DispatchQueue& printDispatchQueue)
+{
+	std::string summary = (g_summaryFormat == SummaryFormat::CSV) ? formatSummaryCSV() : formatSummaryJSON();
+
+	if (g_summaryFilename.empty())
+	{
+		dispatch_printf(printDispatchQueue, "%s", summary.c_str());
+		return;
+	}
+
+	FILE* summaryFile = fopen(g_summaryFilename.c_str(), "w");
+	if (!summaryFile)
+	{
+		fprintf(stderr, "Unable to open latency summary file %s\n", g_summaryFilename.c_str());
+		return;
+	}
+
+	fwrite(summary.data(), 1, summary.size(), summaryFile);
+	fclose(summaryFile);
+
+	dispatch_printf(printDispatchQueue, "Latency summary written to %s\n", g_summaryFilename.c_str());
+}
+
+std::string getDisplayModeName(com_ptr<DeckLinkOutputDevice>& deckLinkOutput, BMDDisplayMode displayMode)
+{
+	com_ptr<IDeckLinkDisplayMode>	deckLinkDisplayMode;
+	dlstring_t						displayModeNameStr;
+	std::string						displayModeName = "Unknown";
+
+	if ((deckLinkOutput->getDeckLinkOutput()->GetDisplayMode(displayMode, deckLinkDisplayMode.releaseAndGetAddressOf()) == S_OK) &&
+		(deckLinkDisplayMode->GetName(&displayModeNameStr) == S_OK))
+	{
+		displayModeName = DlToStdString(displayModeNameStr);
+		DeleteString(displayModeNameStr);
+	}
+
+	return displayModeName;
 }
 
 void printReferenceStatus(com_ptr<DeckLinkOutputDevice>& deckLinkOutput, DispatchQueue& printDispatchQueue)
@@ -479,11 +748,13 @@ HRESULT InputLoopThrough(void)
 	com_ptr<DeckLinkInputDevice>		deckLinkInput;
 	com_ptr<DeckLinkOutputDevice>		deckLinkOutput;
 
-	DispatchQueue 						videoDispatchQueue(kVideoDispatcherThreadCount);
-	DispatchQueue 						audioDispatchQueue(kAudioDispatcherThreadCount);
-	DispatchQueue						printDispatchQueue(kPrintDispatcherThreadCount);
+	DispatchQueue 						videoDispatchQueue(kVideoDispatcherThreadCount, [] { ThreadConfiguration::applyToCurrentThread(ThreadRole::VideoWorker); });
+	DispatchQueue 						audioDispatchQueue(kAudioDispatcherThreadCount, [] { ThreadConfiguration::applyToCurrentThread(ThreadRole::AudioWorker); });
+	DispatchQueue						printDispatchQueue(kPrintDispatcherThreadCount, [] { ThreadConfiguration::applyToCurrentThread(ThreadRole::Print); });
+	FrameReorderStage					outputFrameReorderStage;
+	int									prerollFrames = kOutputVideoPreroll;
 	
-	std::thread							printRollingAverageThread;
+	std::thread							printLatencyWindowThread;
 
 	result = GetDeckLinkIterator(deckLinkIterator.releaseAndGetAddressOf());
 	if (result != S_OK)
@@ -537,7 +808,22 @@ HRESULT InputLoopThrough(void)
 						fprintf(stderr, "%s\n", e.what());
 						continue;
 					}
+
+					if (g_watermarkChecker)
+						deckLinkInput->setWatermarkChecker(g_watermarkChecker);
+
+					if (g_frameBufferPoolSize > 0)
+					{
+						int numaNode = (g_frameBufferNumaNode >= 0) ? g_frameBufferNumaNode : PooledMemoryAllocator::GetDeckLinkNumaNode(deckLink.get());
+						// The buffer size is set for each display mode when capture starts
+						com_ptr<PooledMemoryAllocator> frameAllocator = make_com_ptr<PooledMemoryAllocator>(g_frameBufferPoolSize, 0, numaNode);
+
+						if (!deckLinkInput->setVideoInputFrameMemoryAllocator(frameAllocator))
+							fprintf(stderr, "Unable to set pooled frame memory allocator, using default allocator\n");
+					}
+
 					g_audioChannelCount = std::min((uint32_t)maxAudioChannels, g_audioChannelCount);
+					g_captureTelemetry = g_telemetryPublisher.addStream(deckLink.get(), Telemetry::StreamDirection::Capture);
 					dispatch_printf(printDispatchQueue, "Using input device: %s\n", getDeckLinkDisplayName(deckLink).c_str());
 				}
 
@@ -560,7 +846,7 @@ HRESULT InputLoopThrough(void)
 					dispatch_printf(printDispatchQueue, "Warning: Specified video output preroll size is smaller than the minimum supported size; Changing preroll size from %d to %d.\n", kOutputVideoPreroll, minimumPrerollFrames);
 				}
 				
-				int prerollFrames = std::max((int)minimumPrerollFrames, kOutputVideoPreroll);
+				prerollFrames = std::max((int)minimumPrerollFrames, kOutputVideoPreroll);
 
 				try
 				{
@@ -572,7 +858,20 @@ HRESULT InputLoopThrough(void)
 					continue;
 				}
 				g_audioChannelCount = std::min((uint32_t)maxAudioChannels, g_audioChannelCount);
-				
+
+				// Buffered counts are polled by the telemetry publisher thread, not on the output callbacks
+				g_playbackTelemetry = g_telemetryPublisher.addStream(deckLink.get(), Telemetry::StreamDirection::Playback);
+				g_playbackTelemetry->setSampler([deckLinkOutput](TelemetryStream& stream)
+				{
+					uint32_t bufferedVideoFrameCount;
+					uint32_t bufferedAudioSampleFrameCount;
+
+					if (deckLinkOutput->getDeckLinkOutput()->GetBufferedVideoFrameCount(&bufferedVideoFrameCount) == S_OK)
+						stream.setBufferedVideoFrames(bufferedVideoFrameCount);
+					if (deckLinkOutput->getDeckLinkOutput()->GetBufferedAudioSampleFrameCount(&bufferedAudioSampleFrameCount) == S_OK)
+						stream.setBufferedAudioSampleFrames(bufferedAudioSampleFrameCount);
+				});
+
 				dispatch_printf(printDispatchQueue, "Using output device: %s\n", getDeckLinkDisplayName(deckLink).c_str());
 			}
 		}
@@ -620,14 +919,56 @@ HRESULT InputLoopThrough(void)
 			g_loopThroughSessionNotifier.condition.notify_all();
 		});
 
-		deckLinkInput->onVideoInputArrived([&](std::shared_ptr<LoopThroughVideoFrame> videoFrame) { videoDispatchQueue.dispatch(processVideo, videoFrame, deckLinkOutput); });
-		deckLinkInput->onAudioInputArrived([&](std::shared_ptr<LoopThroughAudioPacket> audioPacket) { audioDispatchQueue.dispatch(processAudio, audioPacket, deckLinkOutput); });
+		deckLinkInput->onVideoInputArrived([&](std::shared_ptr<LoopThroughVideoFrame> videoFrame)
+		{
+			// Set output stream time, or discard the frame to reduce the preroll
+			if (!g_prerollController.retimeVideoFrame(*videoFrame))
+			{
+				FrameTrace::addInstant("Discarded for preroll", ReferenceTime::getSteadyClockUptimeCount(), videoFrame->getStreamFrameNumber());
+				return;
+			}
+
+			// Register frame in capture order, before it can be processed out of order by the dispatcher threads
+			outputFrameReorderStage.expectFrame(videoFrame->getVideoStreamTime());
+
+			videoFrame->setProcessingQueuedReferenceTime(ReferenceTime::getSteadyClockUptimeCount());
+			FrameTrace::setThreadName("DeckLink input callback");
+			FrameTrace::addSpan("Input", videoFrame->getInputFrameStartReferenceTime(), videoFrame->getInputFrameArrivedReferenceTime(), videoFrame->getStreamFrameNumber());
+			FrameTrace::addInstant("Dispatch", videoFrame->getProcessingQueuedReferenceTime(), videoFrame->getStreamFrameNumber());
+
+			g_captureTelemetry->addFramesIn();
+			g_captureTelemetry->setQueueDepth(++g_videoProcessingQueueDepth);
+			videoDispatchQueue.dispatch(processVideo, videoFrame, deckLinkOutput, std::ref(outputFrameReorderStage));
+		});
+		deckLinkInput->onAudioInputArrived([&](std::shared_ptr<LoopThroughAudioPacket> audioPacket)
+		{
+			// Set output stream time, or discard the packet to reduce the preroll
+			if (!g_prerollController.retimeAudioPacket(*audioPacket))
+				return;
+
+			// Resampled here, as the packets must be in stream order
+			g_audioDriftCompensator.processAudioPacket(*audioPacket);
+			audioDispatchQueue.dispatch(processAudio, audioPacket, deckLinkOutput, std::ref(printDispatchQueue));
+		});
 		deckLinkInput->onVideoInputFrameDropped([&](BMDTimeValue streamTime, BMDTimeValue frameDuration, BMDTimeScale) { printDroppedCaptureFrame(streamTime, frameDuration, std::ref(printDispatchQueue)); });
 
 		// Register output callbacks
+		outputFrameReorderStage.onFrameReady([&](std::shared_ptr<LoopThroughVideoFrame> videoFrame)
+		{
+			if (!deckLinkOutput->scheduleVideoFrame(videoFrame))
+				printDroppedOutputFrame(videoFrame, std::ref(printDispatchQueue));
+		});
 		deckLinkOutput->onScheduledFrameCompleted([&](std::shared_ptr<LoopThroughVideoFrame> videoFrame) { updateCompletedFrameLatency(videoFrame, std::ref(printDispatchQueue)); });
 		deckLinkOutput->onAudioPacketScheduled([&](std::shared_ptr<LoopThroughAudioPacket> audioPacket) { g_audioProcessingLatencyStatistics.addSample(audioPacket->getProcessingLatency()); });
 
+		g_prerollController.onPrerollChanged([&](int adjustment, const char* reason)
+		{
+			dispatch_printf(printDispatchQueue, "Output preroll adjustment %+d frames (%s)\n", adjustment, reason);
+		});
+
+		g_captureTelemetry->setFormat(currentFormatDesc.displayMode, currentFormatDesc.pixelFormat);
+		g_playbackTelemetry->setFormat(currentFormatDesc.displayMode, currentFormatDesc.pixelFormat);
+
 		if (!deckLinkInput->startCapture(currentFormatDesc.displayMode, currentFormatDesc.is3D, currentFormatDesc.pixelFormat, kAudioSampleType, g_audioChannelCount))
 		{
 			fprintf(stderr, "Unable to enable input on the selected device\n");
@@ -637,6 +978,19 @@ HRESULT InputLoopThrough(void)
 		if (kWaitForReferenceToLock)
 			dispatch_printf(printDispatchQueue, "Waiting for reference to lock...\n");
 
+		// Adaptive preroll starts from its lower bound, for which the frame rate of the mode is needed
+		{
+			com_ptr<IDeckLinkDisplayMode>	deckLinkDisplayMode;
+			BMDTimeValue					frameDuration = 0;
+			BMDTimeScale					frameTimescale = 1;
+
+			if (deckLinkOutput->getDeckLinkOutput()->GetDisplayMode(currentFormatDesc.displayMode, deckLinkDisplayMode.releaseAndGetAddressOf()) == S_OK)
+				deckLinkDisplayMode->GetFrameRate(&frameDuration, &frameTimescale);
+
+			deckLinkOutput->setVideoPrerollSize(g_prerollController.start(frameDuration, frameTimescale, prerollFrames));
+			g_audioDriftCompensator.start(deckLinkOutput->getDeckLinkOutput(), frameTimescale, g_audioChannelCount);
+		}
+
 		if (!deckLinkOutput->startPlayback(currentFormatDesc.displayMode, currentFormatDesc.is3D, currentFormatDesc.pixelFormat, kAudioSampleType, g_audioChannelCount, kWaitForReferenceToLock))
 		{
 			std::lock_guard<std::mutex> lock(formatDescMutex);
@@ -653,10 +1007,10 @@ HRESULT InputLoopThrough(void)
 
 		dispatch_printf(printDispatchQueue, "Starting input loop-through, press <RETURN> to stop/exit\n");
 
-		if (kPrintRollingAverage)
+		if (kPrintLatencyWindow)
 		{
-			g_printRollingAverageNotifier.reset();
-			printRollingAverageThread = std::thread(printRollingAverage, std::ref(printDispatchQueue));
+			g_printLatencyWindowNotifier.reset();
+			printLatencyWindowThread = std::thread(printLatencyWindow, std::ref(printDispatchQueue));
 		}
 
 		{
@@ -668,23 +1022,33 @@ HRESULT InputLoopThrough(void)
 		}
 
 		// If we are in rolling average mode, cancel thread
-		if (kPrintRollingAverage)
+		if (kPrintLatencyWindow)
 		{
-			g_printRollingAverageNotifier.notify();
+			g_printLatencyWindowNotifier.notify();
 		
-			if (printRollingAverageThread.joinable())
-				printRollingAverageThread.join();
+			if (printLatencyWindowThread.joinable())
+				printLatencyWindowThread.join();
 		}
 	
 		deckLinkInput->stopCapture();
 		deckLinkOutput->stopPlayback();
+		outputFrameReorderStage.reset();
 
-		printOutputSummary(printDispatchQueue);
+		recordSessionSummary(getDisplayModeName(deckLinkOutput, currentFormatDesc.displayMode), currentFormatDesc.pixelFormat);
+
+		// Capture is stopped, so every checked frame is counted
+		if (g_watermarkChecker)
+		{
+			g_watermarkChecker->flush();
+			printWatermarkStatistics(g_watermarkChecker->getStatistics(), printDispatchQueue);
+			g_watermarkChecker->reset();
+		}
 
 		// Reset statistics
 		g_videoInputLatencyStatistics.reset();
 		g_videoProcessingLatencyStatistics.reset();
 		g_videoOutputLatencyStatistics.reset();
+		g_videoTotalLatencyStatistics.reset();
 		g_audioProcessingLatencyStatistics.reset();
 
 		g_frameCompletionResultCount.clear();
@@ -702,15 +1066,11 @@ HRESULT InputLoopThrough(void)
 
 			if (deckLinkDisplayMode->GetName(&displayModeNameStr) == S_OK)
 			{
-				try
-				{
-					dispatch_printf(printDispatchQueue,
-									"\nLoop-through video format changed to %s %s%s\n",
-									DlToCString(displayModeNameStr),
-									formatDesc.is3D ? "3D " : "",
-									kPixelFormats.at(formatDesc.pixelFormat));
-				}
-				catch (std::out_of_range) {}
+				dispatch_printf(printDispatchQueue,
+								"\nLoop-through video format changed to %s %s%s\n",
+								DlToCString(displayModeNameStr),
+								formatDesc.is3D ? "3D " : "",
+								GetPixelFormatName(formatDesc.pixelFormat));
 
 				DeleteString(displayModeNameStr);
 			}
@@ -724,19 +1084,212 @@ HRESULT InputLoopThrough(void)
 	if (userInputThread.joinable())
 		userInputThread.join();
 
+	writeLatencySummary(printDispatchQueue);
+
 	dispatch_printf(printDispatchQueue, "\nInputLoopThrough complete\n\n");
 
 	return result;
 }
 
-int main(int argc, const char * argv[])
+void writeFrameTrace(void)
+{
+	if (FrameTrace::writeChromeTrace(g_traceFilename))
+		fprintf(stderr, "Frame trace written to %s\n", g_traceFilename.c_str());
+	else
+		fprintf(stderr, "Unable to write frame trace to %s\n", g_traceFilename.c_str());
+}
+
+void traceWriterThread(sigset_t signalSet)
+{
+	// SIGUSR1 is blocked in every thread and accepted only here, so the trace is not written from a signal handler
+	while (true)
+	{
+		int signalNumber;
+		if (sigwait(&signalSet, &signalNumber) != 0)
+			break;
+
+		if (g_traceWriterStopping)
+			break;
+
+		writeFrameTrace();
+	}
+}
+
+void printUsage(const char* programName)
+{
+	fprintf(stderr,
+		"Usage: %s [OPTIONS]\n"
+		"\n"
+		"    -b <buffers>         Capture into a pool of <buffers> pre-allocated frame buffers, backed by\n"
+		"                         hugepages where available and locked into memory (default is driver allocator)\n"
+		"    -u <node>            NUMA node for pooled frame buffers (default is the node nearest the input device)\n"
+		"    -o <file>            Write the latency summary to <file> on exit (default is stdout)\n"
+		"    -F <json|csv>        Latency summary format (default is json)\n"
+		"    -t <file>            Record a per-frame trace and write it to <file> as Chrome trace JSON, on\n"
+		"                         SIGUSR1 and on exit.  Open with chrome://tracing or https://ui.perfetto.dev\n"
+		"    -T <setting>         Scheduling policy, priority and CPUs of a thread role, may be repeated:\n"
+		"                           <role>=<policy>[:<priority>][@<cpu list>], e.g. video-scheduler=fifo:80@2\n"
+		"                         Roles are input-callback, output-callback, video-scheduler, audio-scheduler,\n"
+		"                         video-worker, audio-worker, print or all; policies are other, fifo or rr\n"
+		"    -C <file>            Read thread settings from <file>, one per line\n"
+		"    -M                   Lock process memory with mlockall, so real-time threads do not page fault\n"
+		"    -a <min>[:<max>]     Adapt the output preroll while running, keeping the output delay between\n"
+		"                         <min> and <max> ms (default max %ld ms).  The preroll grows when frames\n"
+		"                         are late or dropped and shrinks when frames are output with time to spare\n"
+		"    -d <ms>              Resample the input audio to hold the audio buffered by the output at <ms>,\n"
+		"                         or at the level reached after startup when 0, compensating for drift\n"
+		"                         between input and output clocks that are not locked to a common reference.\n"
+		"                         Up to %u channels are resampled\n"
+		"    -w                   Check the frame watermark stamped by TestPattern -w on the input, reporting\n"
+		"                         dropped, repeated, reordered and corrupted frames and glass-to-glass latency\n",
+		programName,
+		kDefaultMaximumOutputDelayMs,
+		AudioResampler::kMaximumChannels
+	);
+}
+
+int main(int argc, char* argv[])
 {
 	HRESULT		result;
 	int			exitStatus = EXIT_FAILURE;
+	int			ch;
+	bool		lockMemory = false;
+
+	while ((ch = getopt(argc, argv, "b:u:o:F:t:T:C:Ma:d:wh?")) != -1)
+	{
+		switch (ch)
+		{
+			case 'b':
+				g_frameBufferPoolSize = (uint32_t)std::max(atoi(optarg), 0);
+				break;
+
+			case 'u':
+				g_frameBufferNumaNode = atoi(optarg);
+				break;
+
+			case 'o':
+				g_summaryFilename = optarg;
+				break;
+
+			case 't':
+				g_traceFilename = optarg;
+				break;
+
+			case 'T':
+				if (!ThreadConfiguration::parseSetting(optarg))
+				{
+					fprintf(stderr, "Invalid thread setting \"%s\"\n", optarg);
+					printUsage(argv[0]);
+					return EXIT_FAILURE;
+				}
+				break;
+
+			case 'C':
+				if (!ThreadConfiguration::loadFile(optarg))
+					return EXIT_FAILURE;
+				break;
+
+			case 'M':
+				lockMemory = true;
+				break;
+
+			case 'a':
+			{
+				char*	end;
+				long	minimumDelayMs = strtol(optarg, &end, 10);
+				long	maximumDelayMs = kDefaultMaximumOutputDelayMs;
+
+				if (*end == ':')
+					maximumDelayMs = strtol(end + 1, &end, 10);
+
+				if ((end == optarg) || (*end != '\0') || (minimumDelayMs < 0) || (maximumDelayMs < minimumDelayMs))
+				{
+					fprintf(stderr, "Invalid output delay bounds \"%s\"\n", optarg);
+					printUsage(argv[0]);
+					return EXIT_FAILURE;
+				}
+
+				g_prerollController.setLatencyBounds(minimumDelayMs * ReferenceTime::kTicksPerMilliSec, maximumDelayMs * ReferenceTime::kTicksPerMilliSec);
+				break;
+			}
+
+			case 'd':
+			{
+				char*	end;
+				long	targetLevelMs = strtol(optarg, &end, 10);
+
+				if ((end == optarg) || (*end != '\0') || (targetLevelMs < 0))
+				{
+					fprintf(stderr, "Invalid audio buffer level \"%s\"\n", optarg);
+					printUsage(argv[0]);
+					return EXIT_FAILURE;
+				}
+
+				g_audioDriftCompensator.setTargetLevel(targetLevelMs * ReferenceTime::kTicksPerMilliSec);
+				break;
+			}
+
+			case 'w':
+				g_watermarkChecker = std::make_shared<WatermarkChecker>();
+				break;
+
+			case 'F':
+				if (strcmp(optarg, "json") == 0)
+					g_summaryFormat = SummaryFormat::JSON;
+				else if (strcmp(optarg, "csv") == 0)
+					g_summaryFormat = SummaryFormat::CSV;
+				else
+				{
+					printUsage(argv[0]);
+					return EXIT_FAILURE;
+				}
+				break;
+
+			default:
+				printUsage(argv[0]);
+				return (ch == 'h') ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+
+	// Lock memory before threads are created, so their stacks are locked as well
+	if (lockMemory)
+		ThreadConfiguration::lockMemory();
+
+	ThreadConfiguration::printSettings(stdout);
+
+	std::thread traceThread;
+	if (!g_traceFilename.empty())
+	{
+		// Block SIGUSR1 before any other thread is created, so that all threads inherit the mask
+		sigset_t signalSet;
+		sigemptyset(&signalSet);
+		sigaddset(&signalSet, SIGUSR1);
+		pthread_sigmask(SIG_BLOCK, &signalSet, nullptr);
+
+		FrameTrace::enable(true);
+		traceThread = std::thread(traceWriterThread, signalSet);
+	}
+
+	if (!g_telemetryPublisher.open("InputLoopThrough"))
+		fprintf(stderr, "Unable to create telemetry segment, telemetry will not be published\n");
 
 	result = InputLoopThrough();
 	if (result == S_OK)
 		exitStatus = EXIT_SUCCESS;;
 
+	// The output sampler holds a reference to the output device
+	g_telemetryPublisher.close();
+	g_playbackTelemetry->setSampler(nullptr);
+
+	if (traceThread.joinable())
+	{
+		g_traceWriterStopping = true;
+		pthread_kill(traceThread.native_handle(), SIGUSR1);
+		traceThread.join();
+
+		FrameTrace::enable(false);
+		writeFrameTrace();
+	}
+
 	return exitStatus;
 }
@@ -43,85 +43,206 @@
 #include <limits>
 #include "LatencyStatistics.h"
 
-
-LatencyStatistics::LatencyStatistics(int maxRollingSamples) :
-	m_maxRollingSamples(maxRollingSamples)
+LatencyHistogram::LatencyHistogram() :
+	m_counts(kBucketCount)
 {
-	if (m_maxRollingSamples < 1)
-		throw std::invalid_argument("Unexpected value for rolling average size");
-	
 	reset();
 }
 
-void LatencyStatistics::reset()
+void LatencyHistogram::reset()
 {
-	std::lock_guard<std::mutex> lock(m_mutex);
-	
-	m_rollingSamples.clear();
-	m_rollingAggregateLatency = 0;
-	
-	m_maxLatency	= (std::numeric_limits<BMDTimeValue>::min)();
-	m_minLatency	= (std::numeric_limits<BMDTimeValue>::max)();
-	
-	m_mean			= 0;
-	m_m2			= 0;
+	std::fill(m_counts.begin(), m_counts.end(), 0);
 	m_sampleCount	= 0;
+	m_sum			= 0;
+	m_minimum		= (std::numeric_limits<BMDTimeValue>::max)();
+	m_maximum		= 0;
 }
 
-void LatencyStatistics::addSample(const BMDTimeValue latency)
+int LatencyHistogram::bucketIndex(BMDTimeValue value)
+{
+	if (value < kLinearRange)
+		return (int)std::max(value, (BMDTimeValue)0);
+
+	if (value > kMaximumValue)
+		return kBucketCount - 1;
+
+	// Each power of two above the linear range has kSubBucketCount buckets, indexed by the bits below its top bit
+	int topBit		= 63 - __builtin_clzll((unsigned long long)value);
+	int shift		= topBit - kSubBucketBits;
+	int subBucket	= (int)(value >> shift) - kSubBucketCount;
+
+	return kLinearRange + (shift - 1) * kSubBucketCount + subBucket;
+}
+
+BMDTimeValue LatencyHistogram::bucketLowestValue(int index)
+{
+	if (index < kLinearRange)
+		return index;
+
+	int shift		= (index - kLinearRange) / kSubBucketCount + 1;
+	int subBucket	= (index - kLinearRange) % kSubBucketCount + kSubBucketCount;
+
+	return (BMDTimeValue)subBucket << shift;
+}
+
+BMDTimeValue LatencyHistogram::bucketHighestValue(int index)
+{
+	if (index == kBucketCount - 1)
+		return kMaximumValue;
+
+	return bucketLowestValue(index + 1) - 1;
+}
+
+void LatencyHistogram::addSample(BMDTimeValue latency)
+{
+	latency = std::max(latency, (BMDTimeValue)0);
+
+	++m_counts[bucketIndex(latency)];
+	++m_sampleCount;
+	m_sum		+= latency;
+	m_minimum	= std::min(m_minimum, latency);
+	m_maximum	= std::max(m_maximum, latency);
+}
+
+void LatencyHistogram::merge(const LatencyHistogram& other)
+{
+	for (int i = 0; i < kBucketCount; i++)
+		m_counts[i] += other.m_counts[i];
+
+	m_sampleCount	+= other.m_sampleCount;
+	m_sum			+= other.m_sum;
+	m_minimum		= std::min(m_minimum, other.m_minimum);
+	m_maximum		= std::max(m_maximum, other.m_maximum);
+}
+
+void LatencyHistogram::subtract(const LatencyHistogram& earlier)
+{
+	for (int i = 0; i < kBucketCount; i++)
+		m_counts[i] -= std::min(m_counts[i], earlier.m_counts[i]);
+
+	m_sampleCount	-= std::min(m_sampleCount, earlier.m_sampleCount);
+	m_sum			-= std::min(m_sum, earlier.m_sum);
+
+	// The extremes of the remaining samples are only known to the histogram's resolution
+	updateRangeFromCounts();
+}
+
+void LatencyHistogram::updateRangeFromCounts()
+{
+	m_minimum = (std::numeric_limits<BMDTimeValue>::max)();
+	m_maximum = 0;
+
+	for (int i = 0; i < kBucketCount; i++)
+	{
+		if (m_counts[i] == 0)
+			continue;
+
+		m_minimum = std::min(m_minimum, bucketLowestValue(i));
+		m_maximum = bucketHighestValue(i);
+	}
+}
+
+BMDTimeValue LatencyHistogram::getValueAtPercentile(double percentile) const
 {
-	BMDTimeValue delta;
-	BMDTimeValue delta2;
-	
-	std::lock_guard<std::mutex> lock(m_mutex);
-	
-	// Add to rolling average list
-	if (m_rollingSamples.size() >= (size_t)m_maxRollingSamples)
+	if (m_sampleCount == 0)
+		return 0;
+
+	uint64_t targetCount	= std::max((uint64_t)std::ceil(percentile / 100.0 * m_sampleCount), (uint64_t)1);
+	uint64_t count			= 0;
+
+	for (int i = 0; i < kBucketCount; i++)
 	{
-		m_rollingAggregateLatency -= m_rollingSamples.front();
-		m_rollingSamples.pop_front();
+		count += m_counts[i];
+		if (count >= targetCount)
+			return std::min(bucketHighestValue(i), m_maximum);
 	}
-	
-	m_rollingAggregateLatency += latency;
-	m_rollingSamples.push_back(latency);
-	
-	// Check minimum and maximum latency
-	m_maxLatency = std::max(m_maxLatency, latency);
-	m_minLatency = std::min(m_minLatency, latency);
-	
-	// Compute new mean/variance (Welford's algorithm)
-	delta = latency - m_mean;
-	m_mean += delta / ++m_sampleCount;
-	delta2 = latency - m_mean;
-	m_m2 += delta * delta2;
+
+	return m_maximum;
 }
 
-BMDTimeValue LatencyStatistics::getMinimum()
+LatencyStatistics::LatencyStatistics() :
+	m_shards(new Shard[kShardCount])
 {
-	std::lock_guard<std::mutex> lock(m_mutex);
-	return m_minLatency;
+	reset();
+}
+
+int LatencyStatistics::threadShardIndex()
+{
+	// Threads are assigned shards in turn on their first sample
+	static std::atomic<int>	nextShardIndex(0);
+	thread_local int		shardIndex = nextShardIndex++ % kShardCount;
+
+	return shardIndex;
+}
+
+void LatencyStatistics::reset()
+{
+	for (int shardIndex = 0; shardIndex < kShardCount; shardIndex++)
+	{
+		Shard& shard = m_shards[shardIndex];
+
+		for (std::atomic<uint64_t>& count : shard.counts)
+			count.store(0, std::memory_order_relaxed);
+
+		shard.sum.store(0, std::memory_order_relaxed);
+		shard.minimum.store((std::numeric_limits<BMDTimeValue>::max)(), std::memory_order_relaxed);
+		shard.maximum.store(0, std::memory_order_relaxed);
+	}
+
+	std::lock_guard<std::mutex> lock(m_windowMutex);
+	m_windowStart.reset();
 }
 
-BMDTimeValue LatencyStatistics::getMaximum()
+void LatencyStatistics::addSample(const BMDTimeValue latency)
 {
-	std::lock_guard<std::mutex> lock(m_mutex);
-	return m_maxLatency;
+	Shard&			shard	= m_shards[threadShardIndex()];
+	BMDTimeValue	value	= std::max(latency, (BMDTimeValue)0);
+	BMDTimeValue	current;
+
+	shard.sum.fetch_add(value, std::memory_order_relaxed);
+
+	current = shard.minimum.load(std::memory_order_relaxed);
+	while ((value < current) && !shard.minimum.compare_exchange_weak(current, value, std::memory_order_relaxed)) { }
+
+	current = shard.maximum.load(std::memory_order_relaxed);
+	while ((value > current) && !shard.maximum.compare_exchange_weak(current, value, std::memory_order_relaxed)) { }
+
+	shard.counts[LatencyHistogram::bucketIndex(value)].fetch_add(1, std::memory_order_relaxed);
 }
 
-std::pair<BMDTimeValue,BMDTimeValue> LatencyStatistics::getMeanAndStdDev()
+LatencyHistogram LatencyStatistics::getSnapshot() const
 {
-	std::lock_guard<std::mutex> lock(m_mutex);
-	if (m_sampleCount < 2)
-		return std::make_pair((BMDTimeValue)0, (BMDTimeValue)0);
-	
-	return std::make_pair(m_mean, (BMDTimeValue)std::sqrt(m_m2 / (m_sampleCount - 1)));
+	LatencyHistogram snapshot;
+
+	for (int shardIndex = 0; shardIndex < kShardCount; shardIndex++)
+	{
+		const Shard& shard = m_shards[shardIndex];
+
+		// The sample count is taken from the buckets, so it is consistent with them while samples are being added
+		for (int i = 0; i < LatencyHistogram::kBucketCount; i++)
+		{
+			uint64_t count = shard.counts[i].load(std::memory_order_relaxed);
+
+			snapshot.m_counts[i] += count;
+			snapshot.m_sampleCount += count;
+		}
+
+		snapshot.m_sum		+= shard.sum.load(std::memory_order_relaxed);
+		snapshot.m_minimum	= std::min(snapshot.m_minimum, shard.minimum.load(std::memory_order_relaxed));
+		snapshot.m_maximum	= std::max(snapshot.m_maximum, shard.maximum.load(std::memory_order_relaxed));
+	}
+
+	return snapshot;
 }
 
-BMDTimeValue LatencyStatistics::getRollingAverage()
+LatencyHistogram LatencyStatistics::getWindowSnapshot()
 {
-	std::lock_guard<std::mutex> lock(m_mutex);
-	if (m_rollingSamples.empty())
-		return (BMDTimeValue)0;
+	LatencyHistogram snapshot = getSnapshot();
+	LatencyHistogram window = snapshot;
+
+	std::lock_guard<std::mutex> lock(m_windowMutex);
+	window.subtract(m_windowStart);
+	m_windowStart = std::move(snapshot);
 
-	return m_rollingAggregateLatency / m_rollingSamples.size();
+	return window;
 }
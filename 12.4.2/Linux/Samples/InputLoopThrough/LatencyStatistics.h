@@ -40,38 +40,94 @@
 
 #pragma once
 
-#include <deque>
+#include <atomic>
+#include <cstdint>
+#include <memory>
 #include <mutex>
+#include <vector>
 #include "DeckLinkAPI.h"
 
+// Distribution of latency samples in microseconds, as a log-linear (HDR) histogram.  Values below
+// kLinearRange are counted exactly; above that, each power of two is split into kSubBucketCount
+// buckets, so values are resolved to within 1/128 (0.8%) up to kMaximumValue (about 71 minutes).
+// Larger values are counted in the last bucket.  The maximum and mean are exact.
+class LatencyHistogram
+{
+public:
+	static const int			kSubBucketBits		= 7;
+	static const int			kSubBucketCount		= 1 << kSubBucketBits;
+	static const int			kLinearRange		= 2 * kSubBucketCount;
+	static const int			kMaximumValueBits	= 32;
+	static const int			kBucketCount		= kLinearRange + (kMaximumValueBits - kSubBucketBits - 1) * kSubBucketCount;
+	static const BMDTimeValue	kMaximumValue		= ((BMDTimeValue)1 << kMaximumValueBits) - 1;
+
+	LatencyHistogram();
+
+	void			reset(void);
+	void			addSample(BMDTimeValue latency);
+
+	// Adds the samples of another histogram, or removes the samples of an earlier snapshot of this one
+	void			merge(const LatencyHistogram& other);
+	void			subtract(const LatencyHistogram& earlier);
+
+	uint64_t		getSampleCount(void) const		{ return m_sampleCount; }
+	BMDTimeValue	getMinimum(void) const			{ return m_sampleCount ? m_minimum : 0; }
+	BMDTimeValue	getMaximum(void) const			{ return m_sampleCount ? m_maximum : 0; }
+	double			getMean(void) const				{ return m_sampleCount ? (double)m_sum / m_sampleCount : 0.0; }
+
+	// Value, to the histogram's resolution, that the given percentage of samples are at or below
+	BMDTimeValue	getValueAtPercentile(double percentile) const;
+
+	static int			bucketIndex(BMDTimeValue value);
+	static BMDTimeValue	bucketLowestValue(int index);
+	static BMDTimeValue	bucketHighestValue(int index);
+
+private:
+	friend class LatencyStatistics;
+
+	std::vector<uint64_t>	m_counts;
+	uint64_t				m_sampleCount;
+	BMDTimeValue			m_sum;
+	BMDTimeValue			m_minimum;
+	BMDTimeValue			m_maximum;
+
+	void			updateRangeFromCounts(void);
+};
+
+// Latency samples added concurrently by the dispatcher and callback threads.  Each thread records into
+// one of a fixed number of shards with relaxed atomic increments, so adding a sample neither locks nor
+// contends with threads on other shards, and memory is bounded by the shard and bucket counts.
+// Snapshots merge the shards; window snapshots hold the samples added since the previous one.
 class LatencyStatistics
 {
 public:
-	LatencyStatistics(int maxRollingSamples);
+	LatencyStatistics();
 	virtual ~LatencyStatistics() {}
-	
-	void									reset(void);
-	void									addSample(const BMDTimeValue latency);
-	
-	BMDTimeValue							getMinimum(void);
-	BMDTimeValue							getMaximum(void);
-	std::pair<BMDTimeValue,BMDTimeValue>	getMeanAndStdDev(void);
-	BMDTimeValue							getRollingAverage(void);
+
+	void				reset(void);
+	void				addSample(const BMDTimeValue latency);
+
+	// Samples since the last reset
+	LatencyHistogram	getSnapshot(void) const;
+
+	// Samples since the previous call (or the last reset)
+	LatencyHistogram	getWindowSnapshot(void);
 
 private:
-	std::mutex					m_mutex;
-	
-	// For calculating rolling average
-	int 						m_maxRollingSamples;
-	std::deque<BMDTimeValue>	m_rollingSamples;
-	BMDTimeValue				m_rollingAggregateLatency;
-	
-	// Minimum/maximum latency
-	BMDTimeValue				m_maxLatency;
-	BMDTimeValue				m_minLatency;
-	
-	// Welford mean/variance calculations
-	BMDTimeValue				m_mean;
-	BMDTimeValue				m_m2;
-	int							m_sampleCount;
+	static const int kShardCount = 8;
+
+	struct Shard
+	{
+		std::atomic<uint64_t>		counts[LatencyHistogram::kBucketCount];
+		std::atomic<BMDTimeValue>	sum;
+		std::atomic<BMDTimeValue>	minimum;
+		std::atomic<BMDTimeValue>	maximum;
+	};
+
+	std::unique_ptr<Shard[]>	m_shards;
+
+	std::mutex					m_windowMutex;
+	LatencyHistogram			m_windowStart;
+
+	static int					threadShardIndex(void);
 };
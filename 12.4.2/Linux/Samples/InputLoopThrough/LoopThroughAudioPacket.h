@@ -56,6 +56,9 @@ public:
 		m_sampleFrameCount(sampleFrameCount),
 		m_deleter(deleter),
 		m_audioStreamTime(0),
+		m_outputStreamTime(0),
+		m_outputTimeScale(0),
+		m_outputSilenceDuration(0),
 		m_inputPacketArrivedReferenceTime(0),
 		m_outputPacketScheduledReferenceTime(0)
 	{
@@ -83,10 +86,16 @@ public:
 	}
 	
 	void			setAudioStreamTime(const BMDTimeValue time) { m_audioStreamTime = time; }
+	void			setOutputStreamTime(const BMDTimeValue time) { m_outputStreamTime = time; }
+	void			setOutputTimeScale(const BMDTimeScale timeScale) { m_outputTimeScale = timeScale; }
+	void			setOutputSilenceDuration(const BMDTimeValue duration) { m_outputSilenceDuration = duration; }
 	void			setInputPacketArrivedReferenceTime(const BMDTimeValue time) { m_inputPacketArrivedReferenceTime = time; }
 	void			setOutputPacketScheduledReferenceTime(const BMDTimeValue time) { m_outputPacketScheduledReferenceTime = time; }
 
 	BMDTimeValue	getAudioStreamTime(void) const { return m_audioStreamTime; }
+	BMDTimeValue	getOutputStreamTime(void) const { return m_outputStreamTime; }
+	BMDTimeScale	getOutputTimeScale(void) const { return m_outputTimeScale; }
+	BMDTimeValue	getOutputSilenceDuration(void) const { return m_outputSilenceDuration; }
 	BMDTimeValue	getProcessingLatency(void) const { return m_outputPacketScheduledReferenceTime - m_inputPacketArrivedReferenceTime; }
 
 private:
@@ -95,6 +104,9 @@ private:
 	Deleter			m_deleter;
 
 	BMDTimeValue	m_audioStreamTime;
+	BMDTimeValue	m_outputStreamTime;			// Stream time the packet is scheduled at
+	BMDTimeScale	m_outputTimeScale;			// Time scale of the output stream time and silence duration
+	BMDTimeValue	m_outputSilenceDuration;	// Silence scheduled before the packet, to fill a gap in the output
 	BMDTimeValue	m_inputPacketArrivedReferenceTime;
 	BMDTimeValue	m_outputPacketScheduledReferenceTime;
 };
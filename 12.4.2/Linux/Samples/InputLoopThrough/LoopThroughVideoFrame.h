@@ -49,9 +49,12 @@ public:
 	LoopThroughVideoFrame(const com_ptr<IDeckLinkVideoFrame>& videoFrame):
 		m_videoFrame(videoFrame),
 		m_videoStreamTime(0),
+		m_outputStreamTime(0),
 		m_videoFrameDuration(0),
 		m_inputFrameStartReferenceTime(0),
 		m_inputFrameArrivedReferenceTime(0),
+		m_processingQueuedReferenceTime(0),
+		m_processingCompletedReferenceTime(0),
 		m_outputFrameScheduledReferenceTime(0),
 		m_outputFrameCompletedReferenceTime(0),
 		m_outputFrameCompletionResult(bmdOutputFrameDropped)
@@ -61,16 +64,27 @@ public:
 	
 	void	setVideoFrame(const com_ptr<IDeckLinkVideoFrame>& videoFrame) { m_videoFrame = videoFrame; }
 	void	setVideoStreamTime(const BMDTimeValue time) { m_videoStreamTime = time; }
+	void	setOutputStreamTime(const BMDTimeValue time) { m_outputStreamTime = time; }
 	void	setVideoFrameDuration(const BMDTimeValue duration) { m_videoFrameDuration = duration; }
 	void	setInputFrameStartReferenceTime(const BMDTimeValue time) { m_inputFrameStartReferenceTime = time; }
 	void	setInputFrameArrivedReferenceTime(const BMDTimeValue time) { m_inputFrameArrivedReferenceTime = time; }
+	void	setProcessingQueuedReferenceTime(const BMDTimeValue time) { m_processingQueuedReferenceTime = time; }
+	void	setProcessingCompletedReferenceTime(const BMDTimeValue time) { m_processingCompletedReferenceTime = time; }
 	void	setOutputFrameScheduledReferenceTime(const BMDTimeValue time) { m_outputFrameScheduledReferenceTime = time; }
 	void	setOutputFrameCompletedReferenceTime(const BMDTimeValue time) { m_outputFrameCompletedReferenceTime = time; }
 	void	setOutputCompletionResult(const BMDOutputFrameCompletionResult result) { m_outputFrameCompletionResult = result; }
 
 	IDeckLinkVideoFrame*			getVideoFramePtr(void) const { return m_videoFrame.get(); }
 	BMDTimeValue					getVideoStreamTime(void) const { return m_videoStreamTime; }
+	BMDTimeValue					getOutputStreamTime(void) const { return m_outputStreamTime; }
 	BMDTimeValue					getVideoFrameDuration(void) const { return m_videoFrameDuration; }
+	int64_t							getStreamFrameNumber(void) const { return m_videoFrameDuration ? m_videoStreamTime / m_videoFrameDuration : 0; }
+	BMDTimeValue					getInputFrameStartReferenceTime(void) const { return m_inputFrameStartReferenceTime; }
+	BMDTimeValue					getInputFrameArrivedReferenceTime(void) const { return m_inputFrameArrivedReferenceTime; }
+	BMDTimeValue					getProcessingQueuedReferenceTime(void) const { return m_processingQueuedReferenceTime; }
+	BMDTimeValue					getProcessingCompletedReferenceTime(void) const { return m_processingCompletedReferenceTime; }
+	BMDTimeValue					getOutputFrameScheduledReferenceTime(void) const { return m_outputFrameScheduledReferenceTime; }
+	BMDTimeValue					getOutputFrameCompletedReferenceTime(void) const { return m_outputFrameCompletedReferenceTime; }
 	BMDTimeValue					getInputLatency(void) const { return m_inputFrameArrivedReferenceTime - m_inputFrameStartReferenceTime; }
 	BMDTimeValue					getProcessingLatency(void) const { return m_outputFrameScheduledReferenceTime - m_inputFrameArrivedReferenceTime; }
 	BMDTimeValue					getOutputLatency(void) const { return m_outputFrameCompletedReferenceTime - m_outputFrameScheduledReferenceTime; }
@@ -79,11 +93,15 @@ public:
 private:
 	com_ptr<IDeckLinkVideoFrame>	m_videoFrame;
 	BMDTimeValue					m_videoStreamTime;
+	BMDTimeValue					m_outputStreamTime;						// Stream time the frame is scheduled at
 	BMDTimeValue					m_videoFrameDuration;
 	
 	BMDTimeValue					m_inputFrameStartReferenceTime;
 	BMDTimeValue					m_inputFrameArrivedReferenceTime;
 
+	BMDTimeValue					m_processingQueuedReferenceTime;		// Dispatched to the video processing threads
+	BMDTimeValue					m_processingCompletedReferenceTime;		// Released to the output reorder stage
+
 	BMDTimeValue					m_outputFrameScheduledReferenceTime;
 	BMDTimeValue					m_outputFrameCompletedReferenceTime;
 	
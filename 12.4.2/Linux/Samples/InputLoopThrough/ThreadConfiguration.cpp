@@ -0,0 +1,263 @@
+/* -LICENSE-START-
+ ** Copyright (c) 2022 Blackmagic Design
+ **  
+ ** Permission is hereby granted, free of charge, to any person or organization 
+ ** obtaining a copy of the software and accompanying documentation (the 
+ ** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+ ** and transmit the Software, and to prepare derivative works of the Software, 
+ ** and to permit third-parties to whom the Software is furnished to do so, in 
+ ** accordance with:
+ ** 
+ ** (1) if the Software is obtained from Blackmagic Design, the End User License 
+ ** Agreement for the Software Development Kit (“EULA”) available at 
+ ** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+ ** 
+ ** (2) if the Software is obtained from any third party, such licensing terms 
+ ** as notified by that third party,
+ ** 
+ ** and all subject to the following:
+ ** 
+ ** (3) the copyright notices in the Software and this entire statement, 
+ ** including the above license grant, this restriction and the following 
+ ** disclaimer, must be included in all copies of the Software, in whole or in 
+ ** part, and all derivative works of the Software, unless such copies or 
+ ** derivative works are solely in the form of machine-executable object code 
+ ** generated by a source language processor.
+ ** 
+ ** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+ ** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ ** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+ ** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+ ** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+ ** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+ ** DEALINGS IN THE SOFTWARE.
+ ** 
+ ** A copy of the Software is available free of charge at 
+ ** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+ ** 
+ ** -LICENSE-END-
+ */
+
+#include <atomic>
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <pthread.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include "CpuList.h"
+#include "ThreadConfiguration.h"
+
+namespace
+{
+	struct ThreadSettings
+	{
+		bool		configured;
+		int			policy;
+		int			priority;
+		bool		hasAffinity;
+		cpu_set_t	cpus;
+	};
+
+	const char* const kRoleNames[(size_t)ThreadRole::Count] =
+	{
+		"input-callback",
+		"output-callback",
+		"video-scheduler",
+		"audio-scheduler",
+		"video-worker",
+		"audio-worker",
+		"print",
+	};
+
+	static_assert((size_t)ThreadRole::Count <= 32, "applyToCurrentThreadOnce keeps a bit for each role");
+
+	// Written while parsing options, before any of the configured threads start
+	ThreadSettings		g_threadSettings[(size_t)ThreadRole::Count];
+	std::atomic<bool>	g_reportedFailure[(size_t)ThreadRole::Count];
+
+	const char* getPolicyName(int policy)
+	{
+		switch (policy)
+		{
+			case SCHED_FIFO:	return "fifo";
+			case SCHED_RR:		return "rr";
+			default:			return "other";
+		}
+	}
+
+	bool parsePolicy(const std::string& name, int& policy)
+	{
+		if (name == "other")
+			policy = SCHED_OTHER;
+		else if (name == "fifo")
+			policy = SCHED_FIFO;
+		else if (name == "rr")
+			policy = SCHED_RR;
+		else
+			return false;
+
+		return true;
+	}
+
+	void reportFailure(ThreadRole role, const char* operation, int error)
+	{
+		if (!g_reportedFailure[(size_t)role].exchange(true))
+			fprintf(stderr, "Unable to set %s of %s thread: %s\n", operation, kRoleNames[(size_t)role], strerror(error));
+	}
+}
+
+bool ThreadConfiguration::parseSetting(const std::string& setting)
+{
+	ThreadSettings	settings = {};
+	size_t			equals = setting.find('=');
+	size_t			at = setting.find('@');
+	std::string		roleName = setting.substr(0, equals);
+	std::string		policy;
+
+	if (equals == std::string::npos)
+		return false;
+
+	policy = setting.substr(equals + 1, (at == std::string::npos) ? std::string::npos : at - equals - 1);
+
+	size_t colon = policy.find(':');
+	if (colon != std::string::npos)
+	{
+		char* end;
+		settings.priority = (int)strtol(policy.c_str() + colon + 1, &end, 10);
+		if (*end != '\0')
+			return false;
+
+		policy.resize(colon);
+	}
+
+	if (!parsePolicy(policy, settings.policy))
+		return false;
+
+	// Real-time policies need a priority within the range of the policy, others take none
+	if (settings.policy == SCHED_OTHER)
+		settings.priority = 0;
+	else if (colon == std::string::npos)
+		settings.priority = sched_get_priority_min(settings.policy);
+	else if (settings.priority < sched_get_priority_min(settings.policy) || settings.priority > sched_get_priority_max(settings.policy))
+		return false;
+
+	if (at != std::string::npos)
+	{
+		if (!parseCpuList(setting.substr(at + 1), settings.cpus))
+			return false;
+
+		settings.hasAffinity = true;
+	}
+
+	settings.configured = true;
+
+	for (size_t i = 0; i < (size_t)ThreadRole::Count; i++)
+	{
+		if (roleName == "all" || roleName == kRoleNames[i])
+		{
+			g_threadSettings[i] = settings;
+			if (roleName != "all")
+				return true;
+		}
+	}
+
+	return roleName == "all";
+}
+
+bool ThreadConfiguration::loadFile(const std::string& filename)
+{
+	std::ifstream	file(filename);
+	std::string		line;
+	int				lineNumber = 0;
+
+	if (!file)
+	{
+		fprintf(stderr, "Unable to open thread configuration %s\n", filename.c_str());
+		return false;
+	}
+
+	while (std::getline(file, line))
+	{
+		lineNumber++;
+
+		// Trim surrounding whitespace
+		size_t begin = line.find_first_not_of(" \t\r");
+		size_t end = line.find_last_not_of(" \t\r");
+		if (begin == std::string::npos || line[begin] == '#')
+			continue;
+
+		if (!parseSetting(line.substr(begin, end - begin + 1)))
+		{
+			fprintf(stderr, "%s:%d: Invalid thread setting \"%s\"\n", filename.c_str(), lineNumber, line.c_str());
+			return false;
+		}
+	}
+
+	return true;
+}
+
+bool ThreadConfiguration::lockMemory(void)
+{
+	if (mlockall(MCL_CURRENT | MCL_FUTURE) != 0)
+	{
+		fprintf(stderr, "Unable to lock process memory: %s\n", strerror(errno));
+		return false;
+	}
+
+	return true;
+}
+
+void ThreadConfiguration::applyToCurrentThread(ThreadRole role)
+{
+	const ThreadSettings&	settings = g_threadSettings[(size_t)role];
+	struct sched_param		parameters = {};
+	int						result;
+
+	if (!settings.configured)
+		return;
+
+	// Affinity first, so a real-time thread never runs on a CPU it was not given
+	if (settings.hasAffinity)
+	{
+		result = pthread_setaffinity_np(pthread_self(), sizeof(settings.cpus), &settings.cpus);
+		if (result != 0)
+			reportFailure(role, "CPU affinity", result);
+	}
+
+	parameters.sched_priority = settings.priority;
+	result = pthread_setschedparam(pthread_self(), settings.policy, &parameters);
+	if (result != 0)
+		reportFailure(role, "scheduling policy", result);
+}
+
+void ThreadConfiguration::applyToCurrentThreadOnce(ThreadRole role)
+{
+	// One bit for each role, as a driver may deliver input and output callbacks on the same thread
+	static thread_local uint32_t configuredRoles = 0;
+	const uint32_t roleMask = 1u << (size_t)role;
+
+	if ((configuredRoles & roleMask) != 0)
+		return;
+
+	configuredRoles |= roleMask;
+	applyToCurrentThread(role);
+}
+
+void ThreadConfiguration::printSettings(FILE* stream)
+{
+	for (size_t i = 0; i < (size_t)ThreadRole::Count; i++)
+	{
+		const ThreadSettings& settings = g_threadSettings[i];
+
+		if (!settings.configured)
+			continue;
+
+		fprintf(stream, "Thread %s: %s", kRoleNames[i], getPolicyName(settings.policy));
+		if (settings.policy != SCHED_OTHER)
+			fprintf(stream, " priority %d", settings.priority);
+		fprintf(stream, ", CPUs %s\n", settings.hasAffinity ? formatCpuList(settings.cpus).c_str() : "inherited");
+	}
+}
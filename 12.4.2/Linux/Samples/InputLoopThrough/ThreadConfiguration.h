@@ -0,0 +1,88 @@
+/* -LICENSE-START-
+ ** Copyright (c) 2022 Blackmagic Design
+ **  
+ ** Permission is hereby granted, free of charge, to any person or organization 
+ ** obtaining a copy of the software and accompanying documentation (the 
+ ** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+ ** and transmit the Software, and to prepare derivative works of the Software, 
+ ** and to permit third-parties to whom the Software is furnished to do so, in 
+ ** accordance with:
+ ** 
+ ** (1) if the Software is obtained from Blackmagic Design, the End User License 
+ ** Agreement for the Software Development Kit (“EULA”) available at 
+ ** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+ ** 
+ ** (2) if the Software is obtained from any third party, such licensing terms 
+ ** as notified by that third party,
+ ** 
+ ** and all subject to the following:
+ ** 
+ ** (3) the copyright notices in the Software and this entire statement, 
+ ** including the above license grant, this restriction and the following 
+ ** disclaimer, must be included in all copies of the Software, in whole or in 
+ ** part, and all derivative works of the Software, unless such copies or 
+ ** derivative works are solely in the form of machine-executable object code 
+ ** generated by a source language processor.
+ ** 
+ ** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+ ** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ ** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+ ** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+ ** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+ ** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+ ** DEALINGS IN THE SOFTWARE.
+ ** 
+ ** A copy of the Software is available free of charge at 
+ ** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+ ** 
+ ** -LICENSE-END-
+ */
+
+#pragma once
+
+#include <cstdio>
+#include <string>
+
+// Roles of the sample's threads, each of which may be given its own scheduling policy, priority and CPUs
+enum class ThreadRole
+{
+	InputCallback,			// Driver thread delivering captured frames
+	OutputCallback,			// Driver thread completing scheduled frames
+	VideoScheduler,
+	AudioScheduler,
+	VideoWorker,			// Video processing dispatch queue
+	AudioWorker,			// Audio processing dispatch queue
+	Print,					// Print dispatch queue and latency window
+	Count
+};
+
+// Real-time scheduling and CPU affinity for the sample's threads.  Each setting has the form
+//
+//     <role>=<policy>[:<priority>][@<cpu list>]
+//
+// where role is one of input-callback, output-callback, video-scheduler, audio-scheduler, video-worker,
+// audio-worker, print or all; policy is other, fifo or rr; and the CPU list is as in "2,4-7".  For
+// example, "video-scheduler=fifo:80@2" runs the video scheduler at SCHED_FIFO priority 80 on CPU 2.
+// Roles without a setting keep the policy and affinity inherited from the thread that created them.
+//
+// Real-time policies need CAP_SYS_NICE or an RLIMIT_RTPRIO allowance; a thread whose settings cannot
+// be applied continues with its current policy, and the failure is reported once for each role.
+namespace ThreadConfiguration
+{
+	bool	parseSetting(const std::string& setting);
+
+	// Reads one setting per line; blank lines and lines starting with # are ignored
+	bool	loadFile(const std::string& filename);
+
+	// Locks current and future pages of the process into memory, so real-time threads do not fault
+	bool	lockMemory(void);
+
+	// Applies the role's settings to the calling thread
+	void	applyToCurrentThread(ThreadRole role);
+
+	// As above, but only on the first call for the role from each thread.  Driver callback threads are configured
+	// from within their first callback, as they are not created by the application.
+	void	applyToCurrentThreadOnce(ThreadRole role);
+
+	void	printSettings(FILE* stream);
+};
@@ -0,0 +1,565 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <map>
+#include <stdexcept>
+#include <fcntl.h>
+#include <pthread.h>
+#include <time.h>
+#include <unistd.h>
+
+#include "platform.h"
+#include "CaptureEngine.h"
+#include "CpuList.h"
+#include "PixelFormatTraits.h"
+
+namespace
+{
+	// Host time in microseconds, for the latency of frames through the engine
+	BMDTimeValue getHostTime(void)
+	{
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+		return (BMDTimeValue)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+	}
+
+	template<typename T>
+	void updateMaximum(std::atomic<T>& maximum, T value)
+	{
+		T current = maximum.load(std::memory_order_relaxed);
+		while (value > current && !maximum.compare_exchange_weak(current, value, std::memory_order_relaxed))
+			;
+	}
+
+	// Cheap content hash standing in for per-frame analysis.  It reads every byte of the frame, as real
+	// processing would, and is enough to detect a frozen source.
+	uint64_t getFrameChecksum(const void* bytes, size_t length)
+	{
+		const uint64_t*	words = static_cast<const uint64_t*>(bytes);
+		size_t			wordCount = length / sizeof(uint64_t);
+		uint64_t		sum = 0;
+		uint64_t		mix = 0;
+
+		for (size_t i = 0; i < wordCount; i++)
+		{
+			sum += words[i];
+			mix ^= words[i];
+		}
+
+		return sum ^ ((mix << 1) | (mix >> 63));
+	}
+
+	bool pinThread(std::thread& thread, const cpu_set_t& cpus)
+	{
+		return pthread_setaffinity_np(thread.native_handle(), sizeof(cpus), &cpus) == 0;
+	}
+}
+
+CaptureEngineDevice::CaptureEngineDevice(com_ptr<IDeckLink>& deckLink, uint32_t deviceIndex) :
+	m_refCount(1),
+	m_deviceIndex(deviceIndex),
+	m_deckLink(deckLink),
+	m_deckLinkInput(IID_IDeckLinkInput, deckLink),
+	m_numaNode(-1),
+	m_synchronized(false),
+	m_running(false),
+	m_outputFile(-1),
+	m_framesCaptured(0),
+	m_framesProcessed(0),
+	m_framesWritten(0),
+	m_droppedFrames(0),
+	m_repeatedFrames(0),
+	m_bytesWritten(0),
+	m_maxProcessingQueueDepth(0),
+	m_maxWriterQueueDepth(0),
+	m_totalLatency(0),
+	m_maxLatency(0),
+	m_lastStreamFrame(-1),
+	m_frameDuration(0),
+	m_timeScale(1),
+	m_lastChecksum(0),
+	m_reportedWriteError(false)
+{
+	dlstring_t displayName;
+
+	// Check that device has an input interface, this will throw an error if using a playback-only device such as DeckLink Mini Monitor
+	if (!m_deckLinkInput)
+		throw std::runtime_error("DeckLink device does not have an input interface");
+
+	if (m_deckLink->GetDisplayName(&displayName) == S_OK)
+	{
+		m_displayName = DlToStdString(displayName);
+		DeleteString(displayName);
+	}
+	else
+	{
+		m_displayName = "Unknown";
+	}
+
+	m_numaNode = PooledMemoryAllocator::GetDeckLinkNumaNode(m_deckLink.get());
+
+	CPU_ZERO(&m_processingCpus);
+	CPU_ZERO(&m_writerCpus);
+}
+
+CaptureEngineDevice::~CaptureEngineDevice()
+{
+	stopCapture();
+}
+
+// IUnknown methods
+
+HRESULT	CaptureEngineDevice::QueryInterface(REFIID iid, LPVOID *ppv)
+{
+	HRESULT result = S_OK;
+
+	if (ppv == nullptr)
+		return E_INVALIDARG;
+
+	// Obtain the IUnknown interface and compare it the provided REFIID
+	if (iid == IID_IUnknown)
+	{
+		*ppv = this;
+		AddRef();
+	}
+	else if (iid == IID_IDeckLinkInputCallback)
+	{
+		*ppv = (IDeckLinkInputCallback*)this;
+		AddRef();
+	}
+	else
+	{
+		*ppv = nullptr;
+		result = E_NOINTERFACE;
+	}
+
+	return result;
+}
+
+ULONG CaptureEngineDevice::AddRef(void)
+{
+	return ++m_refCount;
+}
+
+ULONG CaptureEngineDevice::Release(void)
+{
+	ULONG newRefValue = --m_refCount;
+
+	if (newRefValue == 0)
+		delete this;
+
+	return newRefValue;
+}
+
+// IDeckLinkInputCallback methods
+
+HRESULT CaptureEngineDevice::VideoInputFrameArrived(IDeckLinkVideoInputFrame* videoFrame, IDeckLinkAudioInputPacket* audioPacket)
+{
+	CapturedFrame	frame;
+	BMDTimeValue	streamTime;
+	BMDTimeValue	frameDuration;
+
+	if (!videoFrame)
+		return S_OK;
+
+	frame.arrivalTime = getHostTime();
+
+	// Gaps in stream time are frames that the driver could not deliver
+	if (videoFrame->GetStreamTime(&streamTime, &frameDuration, m_timeScale) == S_OK && frameDuration > 0)
+	{
+		int64_t streamFrame = streamTime / frameDuration;
+		int64_t lastStreamFrame = m_lastStreamFrame.exchange(streamFrame, std::memory_order_relaxed);
+
+		if (lastStreamFrame >= 0 && streamFrame > lastStreamFrame + 1)
+			m_droppedFrames.fetch_add(streamFrame - lastStreamFrame - 1, std::memory_order_relaxed);
+	}
+
+	frame.videoFrame = videoFrame;
+
+	// Queue depth includes the frame being processed
+	uint64_t framesCaptured = m_framesCaptured.fetch_add(1, std::memory_order_relaxed) + 1;
+	m_processingQueue->pushSample(std::move(frame));
+
+	updateMaximum(m_maxProcessingQueueDepth, (uint32_t)(framesCaptured - m_processingQueue->getDroppedCount() - m_framesProcessed.load(std::memory_order_relaxed)));
+	return S_OK;
+}
+
+HRESULT CaptureEngineDevice::VideoInputFormatChanged(BMDVideoInputFormatChangedEvents notificationEvents, IDeckLinkDisplayMode *newDisplayMode, BMDDetectedVideoInputFormatFlags detectedSignalFlags)
+{
+	// The engine captures a fixed format, frames are flagged without input source until the signal matches
+	return S_OK;
+}
+
+// Other methods
+
+bool CaptureEngineDevice::enableCapture(const CaptureEngineSettings& settings, const cpu_set_t& processingCpus, const cpu_set_t& writerCpus)
+{
+	com_ptr<IDeckLinkDisplayMode>	displayMode;
+	BMDVideoInputFlags				inputFlags = bmdVideoInputFlagDefault;
+
+	if (m_running)
+		return false;
+
+	if (m_deckLinkInput->GetDisplayMode(settings.displayMode, displayMode.releaseAndGetAddressOf()) != S_OK)
+	{
+		fprintf(stderr, "%s: Display mode is not supported\n", m_displayName.c_str());
+		return false;
+	}
+
+	displayMode->GetFrameRate(&m_frameDuration, &m_timeScale);
+
+	// Devices sharing a capture group start streaming together, with their stream times aligned
+	m_synchronized = false;
+	if (settings.captureGroup != 0)
+	{
+		com_ptr<IDeckLinkProfileAttributes>	deckLinkAttributes(IID_IDeckLinkProfileAttributes, m_deckLink);
+		com_ptr<IDeckLinkConfiguration>		deckLinkConfiguration(IID_IDeckLinkConfiguration, m_deckLink);
+		dlbool_t							supported = false;
+
+		if (deckLinkAttributes && deckLinkAttributes->GetFlag(BMDDeckLinkSupportsSynchronizeToCaptureGroup, &supported) == S_OK && supported &&
+			deckLinkConfiguration && deckLinkConfiguration->SetInt(bmdDeckLinkConfigCaptureGroup, settings.captureGroup) == S_OK)
+		{
+			inputFlags |= bmdVideoInputSynchronizeToCaptureGroup;
+			m_synchronized = true;
+		}
+		else
+		{
+			fprintf(stderr, "%s: Synchronized capture is not supported, capturing unsynchronized\n", m_displayName.c_str());
+		}
+	}
+
+	if (!settings.outputDirectory.empty())
+	{
+		std::string filename = settings.outputDirectory + "/device" + std::to_string(m_deviceIndex) + ".raw";
+
+		m_outputFile = open(filename.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+		if (m_outputFile < 0)
+		{
+			fprintf(stderr, "%s: Could not open %s: %s\n", m_displayName.c_str(), filename.c_str(), strerror(errno));
+			return false;
+		}
+	}
+
+	// Frames are captured into a pool on the device's NUMA node, sized to cover both queues.  The engine
+	// captures a fixed format, so the pool is created when the driver commits the allocator
+	uint32_t frameBufferSize = (uint32_t)(GetPixelFormatRowBytes(settings.pixelFormat, displayMode->GetWidth()) * displayMode->GetHeight());
+	m_allocator = make_com_ptr<PooledMemoryAllocator>(settings.bufferCount, frameBufferSize, m_numaNode);
+	if (m_deckLinkInput->SetVideoInputFrameMemoryAllocator(m_allocator.get()) != S_OK)
+		fprintf(stderr, "%s: Could not set frame allocator, using driver allocations\n", m_displayName.c_str());
+
+	m_processingQueue.reset(new SampleQueue<CapturedFrame>(settings.queueDepth, SampleQueueOverflowPolicy::DropNewest));
+	m_writerQueue.reset(new SampleQueue<CapturedFrame>(settings.queueDepth, SampleQueueOverflowPolicy::DropNewest));
+
+	m_framesCaptured = 0;
+	m_framesProcessed = 0;
+	m_framesWritten = 0;
+	m_droppedFrames = 0;
+	m_repeatedFrames = 0;
+	m_bytesWritten = 0;
+	m_maxProcessingQueueDepth = 0;
+	m_maxWriterQueueDepth = 0;
+	m_totalLatency = 0;
+	m_maxLatency = 0;
+	m_lastStreamFrame = -1;
+	m_reportedWriteError = false;
+
+	if (m_deckLinkInput->SetCallback(this) != S_OK ||
+		m_deckLinkInput->EnableVideoInput(settings.displayMode, settings.pixelFormat, inputFlags) != S_OK)
+	{
+		fprintf(stderr, "%s: Unable to enable video input\n", m_displayName.c_str());
+		m_deckLinkInput->SetCallback(nullptr);
+		m_deckLinkInput->SetVideoInputFrameMemoryAllocator(nullptr);
+		m_allocator = nullptr;
+		if (m_outputFile >= 0)
+		{
+			close(m_outputFile);
+			m_outputFile = -1;
+		}
+		return false;
+	}
+
+	m_processingThread = std::thread(&CaptureEngineDevice::processFrames, this);
+	m_writerThread = std::thread(&CaptureEngineDevice::writeFrames, this);
+
+	CPU_ZERO(&m_processingCpus);
+	CPU_ZERO(&m_writerCpus);
+
+	if (settings.pinThreads)
+	{
+		if (pinThread(m_processingThread, processingCpus))
+			m_processingCpus = processingCpus;
+
+		if (pinThread(m_writerThread, writerCpus))
+			m_writerCpus = writerCpus;
+	}
+
+	m_running = true;
+	return true;
+}
+
+bool CaptureEngineDevice::startStreams(void)
+{
+	if (!m_running)
+		return false;
+
+	if (m_deckLinkInput->StartStreams() != S_OK)
+	{
+		fprintf(stderr, "%s: Unable to start capture\n", m_displayName.c_str());
+		return false;
+	}
+
+	return true;
+}
+
+void CaptureEngineDevice::stopCapture(void)
+{
+	if (!m_running)
+		return;
+
+	m_deckLinkInput->StopStreams();
+	m_deckLinkInput->DisableVideoInput();
+	m_deckLinkInput->SetCallback(nullptr);
+
+	// With the driver stopped, each thread completes the frames already queued before it exits
+	m_processingQueue->cancelWaiters();
+	m_processingThread.join();
+
+	m_writerQueue->cancelWaiters();
+	m_writerThread.join();
+
+	if (m_outputFile >= 0)
+	{
+		close(m_outputFile);
+		m_outputFile = -1;
+	}
+
+	m_deckLinkInput->SetVideoInputFrameMemoryAllocator(nullptr);
+	m_allocator = nullptr;
+	m_running = false;
+}
+
+void CaptureEngineDevice::getStatistics(CaptureDeviceStatistics& statistics) const
+{
+	uint64_t framesWritten = m_framesWritten.load(std::memory_order_relaxed);
+	cpu_set_t cpus;
+
+	CPU_OR(&cpus, &m_processingCpus, &m_writerCpus);
+
+	statistics.displayName				= m_displayName;
+	statistics.numaNode					= m_numaNode;
+	statistics.cpuList					= (CPU_COUNT(&cpus) > 0) ? formatCpuList(cpus) : "any";
+	statistics.synchronized				= m_synchronized;
+	statistics.framesCaptured			= m_framesCaptured.load(std::memory_order_relaxed);
+	statistics.framesWritten			= framesWritten;
+	statistics.droppedFrames			= m_droppedFrames.load(std::memory_order_relaxed);
+	statistics.queueOverflows			= (m_processingQueue ? m_processingQueue->getDroppedCount() : 0) + (m_writerQueue ? m_writerQueue->getDroppedCount() : 0);
+	statistics.repeatedFrames			= m_repeatedFrames.load(std::memory_order_relaxed);
+	statistics.bytesWritten				= m_bytesWritten.load(std::memory_order_relaxed);
+	statistics.maxProcessingQueueDepth	= m_maxProcessingQueueDepth.load(std::memory_order_relaxed);
+	statistics.maxWriterQueueDepth		= m_maxWriterQueueDepth.load(std::memory_order_relaxed);
+	statistics.meanLatency				= (framesWritten > 0) ? (double)m_totalLatency.load(std::memory_order_relaxed) / framesWritten / 1000.0 : 0.0;
+	statistics.maxLatency				= (double)m_maxLatency.load(std::memory_order_relaxed) / 1000.0;
+	statistics.lastStreamFrame			= m_lastStreamFrame.load(std::memory_order_relaxed);
+}
+
+void CaptureEngineDevice::processFrames(void)
+{
+	CapturedFrame frame;
+
+	while (m_processingQueue->waitForSample(frame))
+		processFrame(frame);
+
+	while (m_processingQueue->popSample(frame))
+		processFrame(frame);
+}
+
+void CaptureEngineDevice::processFrame(CapturedFrame& frame)
+{
+	void*		bytes;
+	uint64_t	checksum;
+
+	if (frame.videoFrame->GetBytes(&bytes) == S_OK)
+	{
+		checksum = getFrameChecksum(bytes, (size_t)frame.videoFrame->GetRowBytes() * frame.videoFrame->GetHeight());
+		if (m_framesProcessed.load(std::memory_order_relaxed) > 0 && checksum == m_lastChecksum)
+			m_repeatedFrames.fetch_add(1, std::memory_order_relaxed);
+
+		m_lastChecksum = checksum;
+	}
+
+	// Queue depth includes the frame being written
+	uint64_t framesProcessed = m_framesProcessed.fetch_add(1, std::memory_order_relaxed) + 1;
+	m_writerQueue->pushSample(std::move(frame));
+
+	updateMaximum(m_maxWriterQueueDepth, (uint32_t)(framesProcessed - m_writerQueue->getDroppedCount() - m_framesWritten.load(std::memory_order_relaxed)));
+}
+
+void CaptureEngineDevice::writeFrames(void)
+{
+	CapturedFrame frame;
+
+	while (m_writerQueue->waitForSample(frame))
+		writeFrame(frame);
+
+	while (m_writerQueue->popSample(frame))
+		writeFrame(frame);
+}
+
+void CaptureEngineDevice::writeFrame(CapturedFrame& frame)
+{
+	uint8_t*	bytes;
+	size_t		length = (size_t)frame.videoFrame->GetRowBytes() * frame.videoFrame->GetHeight();
+
+	if (m_outputFile >= 0 && frame.videoFrame->GetBytes((void**)&bytes) == S_OK)
+	{
+		size_t written = 0;
+
+		while (written < length)
+		{
+			ssize_t result = write(m_outputFile, bytes + written, length - written);
+			if (result < 0 && errno == EINTR)
+				continue;
+
+			if (result <= 0)
+			{
+				if (!m_reportedWriteError)
+				{
+					fprintf(stderr, "%s: Write failed: %s\n", m_displayName.c_str(), strerror(errno));
+					m_reportedWriteError = true;
+				}
+				break;
+			}
+
+			written += result;
+		}
+	}
+
+	// Return the buffer to the pool before accounting for the frame
+	frame.videoFrame = nullptr;
+
+	uint64_t latency = (uint64_t)(getHostTime() - frame.arrivalTime);
+
+	m_bytesWritten.fetch_add(length, std::memory_order_relaxed);
+	m_totalLatency.fetch_add(latency, std::memory_order_relaxed);
+	updateMaximum(m_maxLatency, latency);
+	m_framesWritten.fetch_add(1, std::memory_order_relaxed);
+}
+
+// CaptureEngine
+
+CaptureEngine::~CaptureEngine()
+{
+	stop();
+}
+
+bool CaptureEngine::addDevice(com_ptr<IDeckLink>& deckLink)
+{
+	try
+	{
+		m_devices.push_back(make_com_ptr<CaptureEngineDevice>(deckLink, (uint32_t)m_devices.size()));
+	}
+	catch (const std::exception&)
+	{
+		return false;
+	}
+
+	return true;
+}
+
+bool CaptureEngine::start(const CaptureEngineSettings& settings)
+{
+	std::map<int, std::vector<int>>	nodeCpus;
+	std::map<int, size_t>			nodeDeviceCount;
+
+	if (!m_runningDevices.empty())
+		return false;
+
+	for (auto& device : m_devices)
+	{
+		int			numaNode = device->getNumaNode();
+		cpu_set_t	writerCpus;
+		cpu_set_t	processingCpus;
+
+		getNumaNodeCpus(numaNode, writerCpus);
+
+		if (nodeCpus.find(numaNode) == nodeCpus.end())
+		{
+			for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+			{
+				if (CPU_ISSET(cpu, &writerCpus))
+					nodeCpus[numaNode].push_back(cpu);
+			}
+		}
+
+		// Processing threads take the node's cores in turn, sharing them only once every core has a device
+		const std::vector<int>& cpus = nodeCpus[numaNode];
+		CPU_ZERO(&processingCpus);
+		if (!cpus.empty())
+			CPU_SET(cpus[nodeDeviceCount[numaNode]++ % cpus.size()], &processingCpus);
+		else
+			processingCpus = writerCpus;
+
+		if (device->enableCapture(settings, processingCpus, writerCpus))
+			m_runningDevices.push_back(device);
+	}
+
+	// Streams start once every device is enabled, so a capture group begins on the same frame
+	for (auto& device : m_runningDevices)
+		device->startStreams();
+
+	return !m_runningDevices.empty();
+}
+
+void CaptureEngine::stop(void)
+{
+	for (auto& device : m_runningDevices)
+		device->stopCapture();
+
+	m_runningDevices.clear();
+}
+
+void CaptureEngine::getStatistics(size_t deviceIndex, CaptureDeviceStatistics& statistics) const
+{
+	if (deviceIndex < m_devices.size())
+		m_devices[deviceIndex]->getStatistics(statistics);
+}
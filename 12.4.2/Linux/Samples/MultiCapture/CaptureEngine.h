@@ -0,0 +1,176 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <string>
+#include <thread>
+#include <vector>
+#include <sched.h>
+#include "DeckLinkAPI.h"
+#include "PooledMemoryAllocator.h"
+#include "SampleQueue.h"
+#include "com_ptr.h"
+
+struct CaptureEngineSettings
+{
+	BMDDisplayMode		displayMode;
+	BMDPixelFormat		pixelFormat;
+	int64_t				captureGroup;		// Devices sharing a non-zero group start together with aligned stream times
+	uint32_t			bufferCount;		// Frames in each device's allocator pool
+	uint32_t			queueDepth;			// Capacity of each device's processing and writer queues
+	std::string			outputDirectory;	// Frames are written to <directory>/device<N>.raw, or discarded when empty
+	bool				pinThreads;
+};
+
+struct CaptureDeviceStatistics
+{
+	std::string			displayName;
+	int					numaNode;
+	std::string			cpuList;					// CPUs running the device's processing and writer threads
+	bool				synchronized;				// Capture is synchronised to the capture group
+	uint64_t			framesCaptured;
+	uint64_t			framesWritten;
+	uint64_t			droppedFrames;				// Gaps in stream time, frames lost before they reached the engine
+	uint64_t			queueOverflows;				// Frames discarded because a processing or writer queue was full
+	uint64_t			repeatedFrames;				// Frames identical to their predecessor, as with a frozen source
+	uint64_t			bytesWritten;				// Frame bytes passed to the writer, whether stored or discarded
+	uint32_t			maxProcessingQueueDepth;
+	uint32_t			maxWriterQueueDepth;
+	double				meanLatency;				// Callback to writer completion, in milliseconds
+	double				maxLatency;
+	BMDTimeValue		lastStreamFrame;			// Stream time of the last captured frame, in frames
+};
+
+// Capture pipeline of a single device.  Frames are delivered by the driver into a pool allocated on the
+// device's NUMA node, then pass through a processing queue and a writer queue, each drained by a
+// thread of its own.  Neither queue blocks the driver's callback; a full queue discards the frame.
+class CaptureEngineDevice : public IDeckLinkInputCallback
+{
+public:
+	CaptureEngineDevice(com_ptr<IDeckLink>& deckLink, uint32_t deviceIndex);
+	virtual ~CaptureEngineDevice();
+
+	// IUnknown interface
+	HRESULT	STDMETHODCALLTYPE QueryInterface(REFIID iid, LPVOID *ppv) override;
+	ULONG	STDMETHODCALLTYPE AddRef() override;
+	ULONG	STDMETHODCALLTYPE Release() override;
+
+	// IDeckLinkInputCallback interface
+	HRESULT	STDMETHODCALLTYPE VideoInputFormatChanged(BMDVideoInputFormatChangedEvents notificationEvents, IDeckLinkDisplayMode *newDisplayMode, BMDDetectedVideoInputFormatFlags detectedSignalFlags) override;
+	HRESULT	STDMETHODCALLTYPE VideoInputFrameArrived(IDeckLinkVideoInputFrame* videoFrame, IDeckLinkAudioInputPacket* audioPacket) override;
+
+	// Other methods
+	bool	enableCapture(const CaptureEngineSettings& settings, const cpu_set_t& processingCpus, const cpu_set_t& writerCpus);
+	bool	startStreams(void);
+	void	stopCapture(void);
+
+	int		getNumaNode(void) const		{ return m_numaNode; }
+	void	getStatistics(CaptureDeviceStatistics& statistics) const;
+
+private:
+	struct CapturedFrame
+	{
+		com_ptr<IDeckLinkVideoInputFrame>	videoFrame;
+		BMDTimeValue						arrivalTime;
+	};
+
+	std::atomic<ULONG>					m_refCount;
+	uint32_t							m_deviceIndex;
+	com_ptr<IDeckLink>					m_deckLink;
+	com_ptr<IDeckLinkInput>				m_deckLinkInput;
+	std::string							m_displayName;
+	int									m_numaNode;
+	com_ptr<PooledMemoryAllocator>		m_allocator;
+	bool								m_synchronized;
+	bool								m_running;
+	cpu_set_t							m_processingCpus;
+	cpu_set_t							m_writerCpus;
+	int									m_outputFile;
+	//
+	std::unique_ptr<SampleQueue<CapturedFrame>>	m_processingQueue;
+	std::unique_ptr<SampleQueue<CapturedFrame>>	m_writerQueue;
+	std::thread							m_processingThread;
+	std::thread							m_writerThread;
+	//
+	std::atomic<uint64_t>				m_framesCaptured;
+	std::atomic<uint64_t>				m_framesProcessed;
+	std::atomic<uint64_t>				m_framesWritten;
+	std::atomic<uint64_t>				m_droppedFrames;
+	std::atomic<uint64_t>				m_repeatedFrames;
+	std::atomic<uint64_t>				m_bytesWritten;
+	std::atomic<uint32_t>				m_maxProcessingQueueDepth;
+	std::atomic<uint32_t>				m_maxWriterQueueDepth;
+	std::atomic<uint64_t>				m_totalLatency;
+	std::atomic<uint64_t>				m_maxLatency;
+	std::atomic<int64_t>				m_lastStreamFrame;
+	BMDTimeValue						m_frameDuration;
+	BMDTimeScale						m_timeScale;
+	uint64_t							m_lastChecksum;
+	bool								m_reportedWriteError;
+
+	void	processFrames(void);
+	void	processFrame(CapturedFrame& frame);
+	void	writeFrames(void);
+	void	writeFrame(CapturedFrame& frame);
+};
+
+// Captures from any number of devices at once.  Each device has its own frame pool, processing queue
+// and writer thread, placed on the NUMA node of the device's PCIe slot.  Processing threads are pinned
+// to cores of their own on that node, while writer threads, which mostly wait on I/O, share the node.
+class CaptureEngine
+{
+public:
+	CaptureEngine() = default;
+	virtual ~CaptureEngine();
+
+	bool		addDevice(com_ptr<IDeckLink>& deckLink);
+	bool		start(const CaptureEngineSettings& settings);
+	void		stop(void);
+
+	size_t		getDeviceCount(void) const		{ return m_devices.size(); }
+	void		getStatistics(size_t deviceIndex, CaptureDeviceStatistics& statistics) const;
+
+private:
+	std::vector<com_ptr<CaptureEngineDevice>>	m_devices;
+	std::vector<com_ptr<CaptureEngineDevice>>	m_runningDevices;
+};
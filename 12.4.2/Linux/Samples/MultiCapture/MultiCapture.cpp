@@ -0,0 +1,421 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include <thread>
+#include <vector>
+#include <poll.h>
+#include <sys/resource.h>
+#include <unistd.h>
+
+#include "platform.h"
+#include "CaptureEngine.h"
+
+// Capture from many devices at once with a CaptureEngine, reporting per-device statistics.  In benchmark
+// mode the capture is repeated with an increasing number of devices to measure how throughput scales.
+
+static const uint32_t	kDefaultBufferCount		= 16;
+static const uint32_t	kDefaultQueueDepth		= 8;
+static const int		kDefaultBenchmarkSeconds	= 10;
+
+struct DeviceTotals
+{
+	uint64_t	framesCaptured;
+	uint64_t	framesWritten;
+	uint64_t	droppedFrames;
+	uint64_t	queueOverflows;
+	uint64_t	bytesWritten;
+	double		maxLatency;
+	double		totalLatency;
+};
+
+static std::vector<com_ptr<IDeckLink>> getInputDevices(void)
+{
+	std::vector<com_ptr<IDeckLink>>	deckLinks;
+	IDeckLinkIterator*				deckLinkIterator = nullptr;
+	IDeckLink*						deckLink = nullptr;
+
+	if (GetDeckLinkIterator(&deckLinkIterator) != S_OK)
+		return deckLinks;
+
+	while (deckLinkIterator->Next(&deckLink) == S_OK)
+	{
+		com_ptr<IDeckLink>					deckLinkPtr(deckLink);
+		com_ptr<IDeckLinkProfileAttributes>	deckLinkAttributes(IID_IDeckLinkProfileAttributes, deckLinkPtr);
+		int64_t								videoIOSupport;
+
+		deckLink->Release();
+
+		if (deckLinkAttributes && deckLinkAttributes->GetInt(BMDDeckLinkVideoIOSupport, &videoIOSupport) == S_OK &&
+			(videoIOSupport & bmdDeviceSupportsCapture) != 0)
+			deckLinks.push_back(deckLinkPtr);
+	}
+
+	deckLinkIterator->Release();
+	return deckLinks;
+}
+
+static BMDDisplayMode getDisplayModeByIndex(com_ptr<IDeckLink>& deckLink, int displayModeIndex)
+{
+	com_ptr<IDeckLinkInput>					deckLinkInput(IID_IDeckLinkInput, deckLink);
+	com_ptr<IDeckLinkDisplayModeIterator>	displayModeIterator;
+	IDeckLinkDisplayMode*					displayMode;
+	BMDDisplayMode							result = bmdModeUnknown;
+	int										index = 0;
+
+	if (!deckLinkInput || deckLinkInput->GetDisplayModeIterator(displayModeIterator.releaseAndGetAddressOf()) != S_OK)
+		return bmdModeUnknown;
+
+	while (displayModeIterator->Next(&displayMode) == S_OK)
+	{
+		if (index++ == displayModeIndex)
+			result = displayMode->GetDisplayMode();
+
+		displayMode->Release();
+	}
+
+	return result;
+}
+
+static void printDisplayModes(com_ptr<IDeckLink>& deckLink)
+{
+	com_ptr<IDeckLinkInput>					deckLinkInput(IID_IDeckLinkInput, deckLink);
+	com_ptr<IDeckLinkDisplayModeIterator>	displayModeIterator;
+	IDeckLinkDisplayMode*					displayMode;
+	int										index = 0;
+
+	if (!deckLinkInput || deckLinkInput->GetDisplayModeIterator(displayModeIterator.releaseAndGetAddressOf()) != S_OK)
+		return;
+
+	while (displayModeIterator->Next(&displayMode) == S_OK)
+	{
+		dlstring_t displayModeName;
+
+		if (displayMode->GetName(&displayModeName) == S_OK)
+		{
+			fprintf(stderr, "        %2d:  %s\n", index, DlToCString(displayModeName));
+			DeleteString(displayModeName);
+		}
+
+		displayMode->Release();
+		index++;
+	}
+}
+
+static void printUsage(const char* programName, std::vector<com_ptr<IDeckLink>>& deckLinks)
+{
+	fprintf(stderr,
+		"Usage: %s [OPTIONS]\n"
+		"\n"
+		"    -n <devices>         Number of input devices to capture from (default is all)\n"
+		"    -m <mode id>         Display mode (default is 1080p30):\n",
+		programName
+	);
+
+	if (!deckLinks.empty())
+		printDisplayModes(deckLinks[0]);
+
+	fprintf(stderr,
+		"    -p <pixelformat>\n"
+		"         0:  8 bit YUV (4:2:2) (default)\n"
+		"         1:  10 bit YUV (4:2:2)\n"
+		"         2:  10 bit RGB (4:4:4)\n"
+		"    -g <group>           Synchronise capture of all devices in capture group <group> (default is unsynchronised)\n"
+		"    -o <directory>       Write the raw video of each device to <directory>/device<N>.raw (default is to discard)\n"
+		"    -b <buffers>         Frame buffers in each device's pool (default is %u)\n"
+		"    -q <depth>           Capacity of each device's processing and writer queues (default is %u)\n"
+		"    -U                   Do not pin processing and writer threads to the device's NUMA node\n"
+		"    -t <seconds>         Capture for <seconds>, otherwise until <RETURN> is pressed\n"
+		"    -B                   Benchmark throughput with 1, 2, 4 ... devices, up to the number selected with -n,\n"
+		"                         for <seconds> each (default is %d)\n"
+		"\n"
+		"%d input devices found\n",
+		kDefaultBufferCount, kDefaultQueueDepth, kDefaultBenchmarkSeconds, (int)deckLinks.size()
+	);
+}
+
+static DeviceTotals getTotals(CaptureEngine& engine)
+{
+	DeviceTotals totals = {};
+
+	for (size_t i = 0; i < engine.getDeviceCount(); i++)
+	{
+		CaptureDeviceStatistics statistics;
+		engine.getStatistics(i, statistics);
+
+		totals.framesCaptured	+= statistics.framesCaptured;
+		totals.framesWritten	+= statistics.framesWritten;
+		totals.droppedFrames	+= statistics.droppedFrames;
+		totals.queueOverflows	+= statistics.queueOverflows;
+		totals.bytesWritten		+= statistics.bytesWritten;
+		totals.totalLatency		+= statistics.meanLatency * statistics.framesWritten;
+		totals.maxLatency		= std::max(totals.maxLatency, statistics.maxLatency);
+	}
+
+	return totals;
+}
+
+static void printDeviceStatistics(CaptureEngine& engine, double seconds)
+{
+	printf("%-3s %-28s %4s %-8s %8s %8s %7s %8s %8s %8s %6s %8s %8s\n",
+			"Dev", "Name", "Node", "CPUs", "Captured", "Written", "Dropped", "Overflow", "Repeated", "MB/s", "Queues", "Mean ms", "Max ms");
+
+	for (size_t i = 0; i < engine.getDeviceCount(); i++)
+	{
+		CaptureDeviceStatistics	statistics;
+		char					queues[16];
+
+		engine.getStatistics(i, statistics);
+		snprintf(queues, sizeof(queues), "%u/%u", statistics.maxProcessingQueueDepth, statistics.maxWriterQueueDepth);
+
+		printf("%-3zu %-28.28s %4d %-8.8s %8llu %8llu %7llu %8llu %8llu %8.1f %6s %8.2f %8.2f%s\n",
+				i, statistics.displayName.c_str(), statistics.numaNode, statistics.cpuList.c_str(),
+				(unsigned long long)statistics.framesCaptured, (unsigned long long)statistics.framesWritten,
+				(unsigned long long)statistics.droppedFrames, (unsigned long long)statistics.queueOverflows,
+				(unsigned long long)statistics.repeatedFrames, statistics.bytesWritten / seconds / 1e6, queues,
+				statistics.meanLatency, statistics.maxLatency, statistics.synchronized ? " (synchronized)" : "");
+	}
+}
+
+static double getProcessCpuTime(void)
+{
+	struct rusage usage;
+	getrusage(RUSAGE_SELF, &usage);
+	return usage.ru_utime.tv_sec + usage.ru_stime.tv_sec + (usage.ru_utime.tv_usec + usage.ru_stime.tv_usec) / 1e6;
+}
+
+// Wait for the capture duration, or for <RETURN> when it is zero, printing progress every second
+static void waitForCapture(CaptureEngine& engine, int seconds, bool quiet)
+{
+	auto startTime = std::chrono::steady_clock::now();
+
+	for (int elapsed = 1; seconds == 0 || elapsed <= seconds; elapsed++)
+	{
+		auto deadline = startTime + std::chrono::seconds(elapsed);
+
+		if (seconds == 0)
+		{
+			struct pollfd	pollDescriptor = { STDIN_FILENO, POLLIN, 0 };
+			int				timeout = (int)std::chrono::duration_cast<std::chrono::milliseconds>(deadline - std::chrono::steady_clock::now()).count();
+
+			if (poll(&pollDescriptor, 1, std::max(timeout, 0)) > 0)
+				break;
+		}
+		else
+		{
+			std::this_thread::sleep_until(deadline);
+		}
+
+		if (!quiet)
+		{
+			DeviceTotals totals = getTotals(engine);
+			printf("%4ds: %llu frames captured, %llu written, %llu dropped, %llu overflowed, %.1f MB/s\n", elapsed,
+					(unsigned long long)totals.framesCaptured, (unsigned long long)totals.framesWritten,
+					(unsigned long long)totals.droppedFrames, (unsigned long long)totals.queueOverflows,
+					totals.bytesWritten / (double)elapsed / 1e6);
+		}
+	}
+}
+
+static bool runBenchmark(std::vector<com_ptr<IDeckLink>>& deckLinks, const CaptureEngineSettings& settings, int seconds)
+{
+	std::vector<size_t> deviceCounts;
+
+	for (size_t deviceCount = 1; deviceCount < deckLinks.size(); deviceCount *= 2)
+		deviceCounts.push_back(deviceCount);
+	deviceCounts.push_back(deckLinks.size());
+
+	printf("%7s %10s %12s %10s %8s %8s %8s %8s %8s\n",
+			"Devices", "Frames/s", "Per device", "MB/s", "Dropped", "Overflow", "Mean ms", "Max ms", "CPU %");
+
+	for (size_t deviceCount : deviceCounts)
+	{
+		CaptureEngine engine;
+
+		for (size_t i = 0; i < deviceCount; i++)
+			engine.addDevice(deckLinks[i]);
+
+		double	cpuTime = getProcessCpuTime();
+		auto	startTime = std::chrono::steady_clock::now();
+
+		if (!engine.start(settings))
+			return false;
+
+		waitForCapture(engine, seconds, true);
+		engine.stop();
+
+		double			elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count();
+		DeviceTotals	totals = getTotals(engine);
+
+		printf("%7zu %10.1f %12.2f %10.1f %8llu %8llu %8.2f %8.2f %8.1f\n",
+				deviceCount, totals.framesWritten / elapsed, totals.framesWritten / elapsed / deviceCount,
+				totals.bytesWritten / elapsed / 1e6, (unsigned long long)totals.droppedFrames,
+				(unsigned long long)totals.queueOverflows,
+				(totals.framesWritten > 0) ? totals.totalLatency / totals.framesWritten : 0.0, totals.maxLatency,
+				(getProcessCpuTime() - cpuTime) / elapsed * 100.0);
+		fflush(stdout);
+	}
+
+	return true;
+}
+
+int main(int argc, char* argv[])
+{
+	std::vector<com_ptr<IDeckLink>>	deckLinks = getInputDevices();
+	CaptureEngineSettings			settings;
+	int								displayModeIndex = -1;
+	int								deviceCount = 0;
+	int								seconds = 0;
+	bool							benchmark = false;
+	int								ch;
+
+	settings.displayMode		= bmdModeHD1080p30;
+	settings.pixelFormat		= bmdFormat8BitYUV;
+	settings.captureGroup		= 0;
+	settings.bufferCount		= kDefaultBufferCount;
+	settings.queueDepth			= kDefaultQueueDepth;
+	settings.pinThreads			= true;
+
+	while ((ch = getopt(argc, argv, "n:m:p:g:o:b:q:Ut:Bh?")) != -1)
+	{
+		switch (ch)
+		{
+			case 'n':
+				deviceCount = std::max(atoi(optarg), 0);
+				break;
+
+			case 'm':
+				displayModeIndex = atoi(optarg);
+				break;
+
+			case 'p':
+				switch (atoi(optarg))
+				{
+					case 0: settings.pixelFormat = bmdFormat8BitYUV; break;
+					case 1: settings.pixelFormat = bmdFormat10BitYUV; break;
+					case 2: settings.pixelFormat = bmdFormat10BitRGB; break;
+					default:
+						printUsage(argv[0], deckLinks);
+						return EXIT_FAILURE;
+				}
+				break;
+
+			case 'g':
+				settings.captureGroup = atoll(optarg);
+				break;
+
+			case 'o':
+				settings.outputDirectory = optarg;
+				break;
+
+			case 'b':
+				settings.bufferCount = (uint32_t)std::max(atoi(optarg), 1);
+				break;
+
+			case 'q':
+				settings.queueDepth = (uint32_t)std::max(atoi(optarg), 1);
+				break;
+
+			case 'U':
+				settings.pinThreads = false;
+				break;
+
+			case 't':
+				seconds = std::max(atoi(optarg), 0);
+				break;
+
+			case 'B':
+				benchmark = true;
+				break;
+
+			default:
+				printUsage(argv[0], deckLinks);
+				return (ch == 'h') ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+
+	if (deckLinks.empty())
+	{
+		fprintf(stderr, "No DeckLink input devices found\n");
+		return EXIT_FAILURE;
+	}
+
+	if (deviceCount > 0 && deviceCount < (int)deckLinks.size())
+		deckLinks.resize(deviceCount);
+
+	if (displayModeIndex >= 0)
+	{
+		settings.displayMode = getDisplayModeByIndex(deckLinks[0], displayModeIndex);
+		if (settings.displayMode == bmdModeUnknown)
+		{
+			fprintf(stderr, "Invalid display mode %d\n", displayModeIndex);
+			return EXIT_FAILURE;
+		}
+	}
+
+	if (benchmark)
+		return runBenchmark(deckLinks, settings, (seconds > 0) ? seconds : kDefaultBenchmarkSeconds) ? EXIT_SUCCESS : EXIT_FAILURE;
+
+	CaptureEngine engine;
+
+	for (auto& deckLink : deckLinks)
+		engine.addDevice(deckLink);
+
+	auto startTime = std::chrono::steady_clock::now();
+
+	if (!engine.start(settings))
+	{
+		fprintf(stderr, "Unable to start capture\n");
+		return EXIT_FAILURE;
+	}
+
+	printf("Capturing from %zu devices%s\n", engine.getDeviceCount(), (seconds == 0) ? ", press <RETURN> to stop" : "");
+	waitForCapture(engine, seconds, false);
+	engine.stop();
+
+	printf("\n");
+	printDeviceStatistics(engine, std::chrono::duration<double>(std::chrono::steady_clock::now() - startTime).count());
+	return EXIT_SUCCESS;
+}
@@ -0,0 +1,130 @@
+/* -LICENSE-START-
+ ** Copyright (c) 2022 Blackmagic Design
+ **  
+ ** Permission is hereby granted, free of charge, to any person or organization 
+ ** obtaining a copy of the software and accompanying documentation (the 
+ ** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+ ** and transmit the Software, and to prepare derivative works of the Software, 
+ ** and to permit third-parties to whom the Software is furnished to do so, in 
+ ** accordance with:
+ ** 
+ ** (1) if the Software is obtained from Blackmagic Design, the End User License 
+ ** Agreement for the Software Development Kit (“EULA”) available at 
+ ** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+ ** 
+ ** (2) if the Software is obtained from any third party, such licensing terms 
+ ** as notified by that third party,
+ ** 
+ ** and all subject to the following:
+ ** 
+ ** (3) the copyright notices in the Software and this entire statement, 
+ ** including the above license grant, this restriction and the following 
+ ** disclaimer, must be included in all copies of the Software, in whole or in 
+ ** part, and all derivative works of the Software, unless such copies or 
+ ** derivative works are solely in the form of machine-executable object code 
+ ** generated by a source language processor.
+ ** 
+ ** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+ ** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+ ** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+ ** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+ ** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+ ** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+ ** DEALINGS IN THE SOFTWARE.
+ ** 
+ ** A copy of the Software is available free of charge at 
+ ** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+ ** 
+ ** -LICENSE-END-
+ */
+
+#include <cstdlib>
+#include <fstream>
+#include "CpuList.h"
+
+bool parseCpuList(const std::string& cpuList, cpu_set_t& cpus)
+{
+	const char* range = cpuList.c_str();
+
+	CPU_ZERO(&cpus);
+	while (*range != '\0')
+	{
+		char*	end;
+		long	first = strtol(range, &end, 10);
+		long	last = first;
+
+		if (end == range || first < 0)
+			return false;
+
+		range = end;
+		if (*range == '-')
+		{
+			last = strtol(range + 1, &end, 10);
+			if (end == range + 1 || last < first)
+				return false;
+			range = end;
+		}
+
+		for (long cpu = first; cpu <= last && cpu < CPU_SETSIZE; cpu++)
+			CPU_SET((int)cpu, &cpus);
+
+		if (*range == ',')
+			range++;
+		else if (*range != '\0')
+			return false;
+	}
+
+	return CPU_COUNT(&cpus) > 0;
+}
+
+std::string formatCpuList(const cpu_set_t& cpus)
+{
+	std::string cpuList;
+
+	for (int cpu = 0; cpu < CPU_SETSIZE; cpu++)
+	{
+		if (!CPU_ISSET(cpu, &cpus))
+			continue;
+
+		int first = cpu;
+		while (cpu + 1 < CPU_SETSIZE && CPU_ISSET(cpu + 1, &cpus))
+			cpu++;
+
+		if (!cpuList.empty())
+			cpuList += ",";
+
+		cpuList += std::to_string(first);
+		if (cpu > first)
+			cpuList += "-" + std::to_string(cpu);
+	}
+
+	return cpuList;
+}
+
+bool getNumaNodeCpus(int numaNode, cpu_set_t& cpus)
+{
+	cpu_set_t	allowedCpus;
+	cpu_set_t	nodeCpus;
+	std::string	cpuList;
+
+	CPU_ZERO(&allowedCpus);
+	if (sched_getaffinity(0, sizeof(allowedCpus), &allowedCpus) != 0)
+		return false;
+
+	cpus = allowedCpus;
+
+	if (numaNode < 0)
+		return false;
+
+	std::ifstream file("/sys/devices/system/node/node" + std::to_string(numaNode) + "/cpulist");
+	if (!std::getline(file, cpuList) || !parseCpuList(cpuList, nodeCpus))
+		return false;
+
+	// Restrict to the CPUs the process may run on, unless that leaves none on the node
+	CPU_AND(&nodeCpus, &nodeCpus, &allowedCpus);
+	if (CPU_COUNT(&nodeCpus) == 0)
+		return false;
+
+	cpus = nodeCpus;
+	return true;
+}
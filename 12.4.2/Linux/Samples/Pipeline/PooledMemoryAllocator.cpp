@@ -0,0 +1,398 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <linux/mempolicy.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include "PooledMemoryAllocator.h"
+
+#ifndef MAP_HUGE_SHIFT
+#define MAP_HUGE_SHIFT	26
+#endif
+
+namespace
+{
+	const size_t	kBufferAlignment	= 4096;
+	const size_t	kHugePageSize2MB	= 2UL << 20;
+	const size_t	kHugePageSize1GB	= 1UL << 30;
+
+	inline size_t roundUp(size_t value, size_t alignment)
+	{
+		return (value + alignment - 1) / alignment * alignment;
+	}
+
+	// Map anonymous memory with the given hugepage size, or regular pages when hugePageSize is 0
+	void* mapMemory(size_t size, size_t hugePageSize)
+	{
+		int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+
+		if (hugePageSize != 0)
+			flags |= MAP_HUGETLB | ((__builtin_ctzl(hugePageSize)) << MAP_HUGE_SHIFT);
+
+		void* address = mmap(nullptr, size, PROT_READ | PROT_WRITE, flags, -1, 0);
+		return (address == MAP_FAILED) ? nullptr : address;
+	}
+}
+
+PooledMemoryAllocator::PooledMemoryAllocator(uint32_t bufferCount, uint32_t bufferSize, int numaNode) :
+	m_refCount(1),
+	m_bufferCount(bufferCount),
+	m_numaNode(numaNode),
+	m_pool(nullptr),
+	m_bufferSize(bufferSize),
+	m_committed(false),
+	m_outstandingCount(0),
+	m_reportedFallback(false)
+{
+}
+
+PooledMemoryAllocator::~PooledMemoryAllocator()
+{
+	destroyPool();
+}
+
+// IUnknown methods
+
+HRESULT PooledMemoryAllocator::QueryInterface(REFIID iid, LPVOID *ppv)
+{
+	if (ppv == nullptr)
+		return E_INVALIDARG;
+
+	CFUUIDBytes iunknown = CFUUIDGetUUIDBytes(IUnknownUUID);
+
+	if (memcmp(&iid, &iunknown, sizeof(REFIID)) == 0 || memcmp(&iid, &IID_IDeckLinkMemoryAllocator, sizeof(REFIID)) == 0)
+	{
+		*ppv = static_cast<IDeckLinkMemoryAllocator*>(this);
+		AddRef();
+		return S_OK;
+	}
+
+	*ppv = nullptr;
+	return E_NOINTERFACE;
+}
+
+ULONG PooledMemoryAllocator::AddRef(void)
+{
+	return ++m_refCount;
+}
+
+ULONG PooledMemoryAllocator::Release(void)
+{
+	ULONG newRefValue = --m_refCount;
+
+	if (newRefValue == 0)
+		delete this;
+
+	return newRefValue;
+}
+
+// IDeckLinkMemoryAllocator methods
+
+HRESULT PooledMemoryAllocator::AllocateBuffer(uint32_t bufferSize, void** allocatedBuffer)
+{
+	Pool*	pool;
+	void*	buffer = nullptr;
+
+	if (allocatedBuffer == nullptr)
+		return E_INVALIDARG;
+
+	pool = m_pool.load(std::memory_order_acquire);
+	if (pool == nullptr || bufferSize > pool->bufferStride)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		// Create the pool on the first allocation, or re-create it for larger frames once all buffers are returned
+		pool = m_pool.load(std::memory_order_acquire);
+		if (pool == nullptr || (bufferSize > pool->bufferStride && m_outstandingCount.load() == 0))
+		{
+			destroyPool();
+			pool = createPool(bufferSize);
+		}
+	}
+
+	if (pool != nullptr && bufferSize <= pool->bufferStride)
+		buffer = popFreeBuffer(pool);
+
+	if (buffer == nullptr)
+	{
+		buffer = allocateFallbackBuffer(bufferSize);
+		if (buffer == nullptr)
+			return E_OUTOFMEMORY;
+	}
+
+	m_outstandingCount++;
+	*allocatedBuffer = buffer;
+	return S_OK;
+}
+
+HRESULT PooledMemoryAllocator::ReleaseBuffer(void* buffer)
+{
+	Pool* pool = m_pool.load(std::memory_order_acquire);
+
+	if (pool != nullptr && buffer >= pool->base && buffer < pool->base + pool->bufferStride * pool->bufferCount)
+		pushFreeBuffer(pool, buffer);
+	else
+		free(buffer);
+
+	// Pool release is deferred by Decommit until the application has released all of its frames
+	if (--m_outstandingCount == 0)
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (!m_committed && m_outstandingCount.load() == 0)
+			destroyPool();
+	}
+
+	return S_OK;
+}
+
+HRESULT PooledMemoryAllocator::Commit()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_committed = true;
+
+	// Re-create a pool that is too small for the expected buffers, once its buffers are all returned
+	Pool* pool = m_pool.load();
+	if (pool != nullptr && m_bufferSize > pool->bufferStride && m_outstandingCount.load() == 0)
+	{
+		destroyPool();
+		pool = nullptr;
+	}
+
+	// Pre-allocate at the expected size, otherwise wait for the first allocation
+	if (pool == nullptr && m_bufferSize != 0)
+		createPool(m_bufferSize);
+
+	return S_OK;
+}
+
+HRESULT PooledMemoryAllocator::Decommit()
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_committed = false;
+
+	if (m_outstandingCount.load() == 0)
+		destroyPool();
+
+	return S_OK;
+}
+
+// Other methods
+
+void PooledMemoryAllocator::SetBufferSize(uint32_t bufferSize)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_bufferSize = bufferSize;
+}
+
+int PooledMemoryAllocator::GetDeckLinkNumaNode(IDeckLink* deckLink)
+{
+	IDeckLinkProfileAttributes*	deckLinkAttributes = nullptr;
+	const char*					deviceHandle = nullptr;
+	int							numaNode = -1;
+
+	if (deckLink == nullptr || deckLink->QueryInterface(IID_IDeckLinkProfileAttributes, (void**)&deckLinkAttributes) != S_OK)
+		return -1;
+
+	if (deckLinkAttributes->GetString(BMDDeckLinkDeviceHandle, &deviceHandle) == S_OK)
+	{
+		unsigned int domain, bus, device, function;
+
+		// Locate the PCI address within the device handle, sysfs then provides its NUMA node
+		for (const char* handle = deviceHandle; *handle != '\0'; handle++)
+		{
+			if (sscanf(handle, "%4x:%2x:%2x.%1x", &domain, &bus, &device, &function) == 4)
+			{
+				char	path[64];
+				FILE*	file;
+
+				snprintf(path, sizeof(path), "/sys/bus/pci/devices/%04x:%02x:%02x.%x/numa_node", domain, bus, device, function);
+				file = fopen(path, "r");
+				if (file != nullptr)
+				{
+					if (fscanf(file, "%d", &numaNode) != 1)
+						numaNode = -1;
+					fclose(file);
+				}
+				break;
+			}
+		}
+
+		free((void*)deviceHandle);
+	}
+
+	deckLinkAttributes->Release();
+	return numaNode;
+}
+
+PooledMemoryAllocator::Pool* PooledMemoryAllocator::createPool(uint32_t bufferSize)
+{
+	size_t			bufferStride = roundUp(bufferSize, kBufferAlignment);
+	size_t			poolSize = bufferStride * m_bufferCount;
+	size_t			pageSize = 0;
+	size_t			mappedSize = 0;
+	void*			base = nullptr;
+	bool			locked;
+	bool			numaBound = false;
+
+	if (m_bufferCount == 0 || bufferSize == 0)
+		return nullptr;
+
+	// Prefer the largest hugepage size that the pool can make use of
+	const size_t pageSizes[] = { kHugePageSize1GB, kHugePageSize2MB };
+	for (size_t hugePageSize : pageSizes)
+	{
+		if (poolSize < hugePageSize / 2)
+			continue;
+
+		mappedSize = roundUp(poolSize, hugePageSize);
+		base = mapMemory(mappedSize, hugePageSize);
+		if (base != nullptr)
+		{
+			pageSize = hugePageSize;
+			break;
+		}
+	}
+
+	if (base == nullptr)
+	{
+		mappedSize = roundUp(poolSize, (size_t)sysconf(_SC_PAGESIZE));
+		base = mapMemory(mappedSize, 0);
+		if (base == nullptr)
+			return nullptr;
+
+		// No hugepages are reserved, ask for transparent hugepages instead
+		madvise(base, mappedSize, MADV_HUGEPAGE);
+		pageSize = (size_t)sysconf(_SC_PAGESIZE);
+	}
+
+	// Bind before the pages are first touched, so they are allocated on the requested node
+	if (m_numaNode >= 0 && m_numaNode < (int)(sizeof(unsigned long) * 8))
+	{
+		unsigned long nodeMask = 1UL << m_numaNode;
+		numaBound = (syscall(SYS_mbind, base, mappedSize, MPOL_BIND, &nodeMask, sizeof(nodeMask) * 8 + 1, 0) == 0);
+	}
+
+	// Locking faults in every page now; if the memlock limit is too low, fault them in by hand
+	locked = (mlock(base, mappedSize) == 0);
+	if (!locked)
+	{
+		for (size_t offset = 0; offset < mappedSize; offset += pageSize)
+			static_cast<volatile uint8_t*>(base)[offset] = 0;
+	}
+
+	Pool* pool = new Pool();
+	pool->base			= static_cast<uint8_t*>(base);
+	pool->mappedSize	= mappedSize;
+	pool->bufferStride	= bufferStride;
+	pool->bufferCount	= m_bufferCount;
+	pool->nextFree.reset(new std::atomic<uint32_t>[m_bufferCount]);
+	pool->freeHead.store(0);
+
+	for (uint32_t i = 0; i < m_bufferCount; i++)
+		pushFreeBuffer(pool, pool->base + bufferStride * i);
+
+	m_bufferSize = bufferSize;
+	m_pool.store(pool, std::memory_order_release);
+
+	fprintf(stderr, "Frame buffer pool: %u x %zu bytes, %zu kB pages, NUMA node %d, %s\n", m_bufferCount, bufferStride, pageSize / 1024,
+			numaBound ? m_numaNode : -1, locked ? "locked" : "not locked (check RLIMIT_MEMLOCK)");
+
+	return pool;
+}
+
+void PooledMemoryAllocator::destroyPool(void)
+{
+	Pool* pool = m_pool.exchange(nullptr);
+	if (pool == nullptr)
+		return;
+
+	munmap(pool->base, pool->mappedSize);
+	delete pool;
+}
+
+void* PooledMemoryAllocator::popFreeBuffer(Pool* pool)
+{
+	uint64_t head = pool->freeHead.load(std::memory_order_acquire);
+
+	while (true)
+	{
+		uint32_t index = (uint32_t)head;
+		if (index == 0)
+			return nullptr;
+
+		uint64_t newHead = (((head >> 32) + 1) << 32) | pool->nextFree[index - 1].load(std::memory_order_relaxed);
+		if (pool->freeHead.compare_exchange_weak(head, newHead, std::memory_order_acquire, std::memory_order_acquire))
+			return pool->base + pool->bufferStride * (index - 1);
+	}
+}
+
+void PooledMemoryAllocator::pushFreeBuffer(Pool* pool, void* buffer)
+{
+	uint32_t	index = (uint32_t)((static_cast<uint8_t*>(buffer) - pool->base) / pool->bufferStride);
+	uint64_t	head = pool->freeHead.load(std::memory_order_relaxed);
+	uint64_t	newHead;
+
+	do
+	{
+		pool->nextFree[index].store((uint32_t)head, std::memory_order_relaxed);
+		newHead = (((head >> 32) + 1) << 32) | (index + 1);
+	}
+	while (!pool->freeHead.compare_exchange_weak(head, newHead, std::memory_order_release, std::memory_order_relaxed));
+}
+
+void* PooledMemoryAllocator::allocateFallbackBuffer(uint32_t bufferSize)
+{
+	void* buffer = nullptr;
+
+	if (!m_reportedFallback.exchange(true, std::memory_order_relaxed))
+		fprintf(stderr, "Frame buffer pool exhausted or too small, allocating additional buffers\n");
+
+	if (posix_memalign(&buffer, kBufferAlignment, bufferSize) != 0)
+		return nullptr;
+
+	return buffer;
+}
@@ -0,0 +1,109 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#pragma once
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include "DeckLinkAPI.h"
+
+// Frame memory allocator backed by a fixed pool of buffers, for use with SetVideoInputFrameMemoryAllocator()
+// or SetVideoOutputFrameMemoryAllocator().
+//
+// The pool is mapped with 1GB or 2MB hugepages when they are available, bound to a NUMA node, and locked
+// into memory when it is created, so capture does not incur page faults or TLB misses on every frame.
+// The pool is created on Commit() at the buffer size given by the application for the display mode and
+// pixel format it enables, so the capture thread does not create it on the first frame.  If no size is
+// given, or the driver asks for larger buffers, the pool is instead created on the first AllocateBuffer.
+// Buffers are handed out and returned through a lock-free free list; requests that cannot be served from
+// the pool fall back to regular allocations.
+//
+// Commit() and Decommit() must not be called concurrently with AllocateBuffer(), as with the driver.
+class PooledMemoryAllocator : public IDeckLinkMemoryAllocator
+{
+public:
+	PooledMemoryAllocator(uint32_t bufferCount, uint32_t bufferSize, int numaNode = -1);
+	virtual ~PooledMemoryAllocator();
+
+	// IUnknown interface
+	HRESULT		STDMETHODCALLTYPE QueryInterface(REFIID iid, LPVOID *ppv) override;
+	ULONG		STDMETHODCALLTYPE AddRef() override;
+	ULONG		STDMETHODCALLTYPE Release() override;
+
+	// IDeckLinkMemoryAllocator interface
+	HRESULT		STDMETHODCALLTYPE AllocateBuffer(uint32_t bufferSize, void** allocatedBuffer) override;
+	HRESULT		STDMETHODCALLTYPE ReleaseBuffer(void* buffer) override;
+	HRESULT		STDMETHODCALLTYPE Commit() override;
+	HRESULT		STDMETHODCALLTYPE Decommit() override;
+
+	// Expected buffer size for the next Commit(), when the input is enabled with a new display mode or pixel format
+	void		SetBufferSize(uint32_t bufferSize);
+
+	// NUMA node of the PCIe slot holding the device, or -1 if it cannot be determined
+	static int	GetDeckLinkNumaNode(IDeckLink* deckLink);
+
+private:
+	struct Pool
+	{
+		uint8_t*								base;
+		size_t									mappedSize;
+		size_t									bufferStride;
+		uint32_t								bufferCount;
+		std::unique_ptr<std::atomic<uint32_t>[]>	nextFree;		// Free list links, as buffer index + 1
+		std::atomic<uint64_t>					freeHead;		// ABA tag in upper 32 bits, buffer index + 1 in lower
+	};
+
+	std::atomic<ULONG>		m_refCount;
+	uint32_t				m_bufferCount;
+	int						m_numaNode;
+	std::mutex				m_mutex;
+	std::atomic<Pool*>		m_pool;
+	uint32_t				m_bufferSize;
+	bool					m_committed;
+	std::atomic<uint32_t>	m_outstandingCount;
+	std::atomic<bool>		m_reportedFallback;
+
+	Pool*		createPool(uint32_t bufferSize);
+	void		destroyPool(void);
+	void*		popFreeBuffer(Pool* pool);
+	void		pushFreeBuffer(Pool* pool, void* buffer);
+	void*		allocateFallbackBuffer(uint32_t bufferSize);
+};
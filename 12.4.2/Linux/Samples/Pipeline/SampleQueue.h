@@ -0,0 +1,363 @@
+/* -LICENSE-START-
+** Copyright (c) 2019 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#pragma once
+
+#include <atomic>
+#include <climits>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <new>
+#include <utility>
+#include <linux/futex.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+// Action taken by pushSample when the queue is full
+enum class SampleQueueOverflowPolicy
+{
+	Block,			// Wait for a consumer to make room, or until waiters are cancelled
+	DropOldest,		// Discard the oldest queued sample
+	DropNewest		// Discard the sample being pushed
+};
+
+// Futex-backed event used for blocking waits on the queue.  The low bit of the futex word is set
+// while a thread may be waiting, so notify only makes the wake system call once per sleep rather
+// than on every sample.
+class SampleQueueEvent
+{
+	static_assert(sizeof(std::atomic<uint32_t>) == sizeof(uint32_t), "futex word must be 32 bits");
+
+public:
+	SampleQueueEvent() :
+		m_state(0)
+	{ }
+
+	// Register as a waiter before re-checking the wait condition; returns the value to pass to wait()
+	uint32_t prepareWait(void)
+	{
+		uint32_t state = m_state.fetch_or(kWaitingFlag) | kWaitingFlag;
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+		return state;
+	}
+
+	void wait(uint32_t state)
+	{
+		syscall(SYS_futex, reinterpret_cast<uint32_t*>(&m_state), FUTEX_WAIT_PRIVATE, state, nullptr, nullptr, 0);
+	}
+
+	void notify(void)
+	{
+		// Orders the caller's publication of the condition before the waiting flag is read
+		std::atomic_thread_fence(std::memory_order_seq_cst);
+
+		uint32_t state = m_state.load(std::memory_order_relaxed);
+		while (state & kWaitingFlag)
+		{
+			// Advance the sequence and clear the flag, so waiters that have not yet slept do not block
+			if (m_state.compare_exchange_weak(state, (state + 2) & ~kWaitingFlag))
+			{
+				syscall(SYS_futex, reinterpret_cast<uint32_t*>(&m_state), FUTEX_WAKE_PRIVATE, INT_MAX, nullptr, nullptr, 0);
+				break;
+			}
+		}
+	}
+
+private:
+	static const uint32_t	kWaitingFlag = 1;
+
+	std::atomic<uint32_t>	m_state;
+};
+
+// Bounded multi-producer queue of samples.  Each slot carries a sequence number, so push and pop
+// each claim a slot with a single compare-exchange and never take a lock; with one producer and
+// one consumer neither operation retries.  Positions and slots are padded to separate cache lines
+// so the producer and consumer do not contend for the same line.
+template<typename T>
+class SampleQueue
+{
+public:
+	static const size_t			kDefaultCapacity = 64;
+
+	explicit SampleQueue(size_t capacity = kDefaultCapacity, SampleQueueOverflowPolicy overflowPolicy = SampleQueueOverflowPolicy::Block);
+	virtual ~SampleQueue();
+
+	bool						pushSample(const T& sample);
+	bool						pushSample(T&& sample);
+	bool						popSample(T& sample);
+	bool						waitForSample(T& sample);
+	void						cancelWaiters(void);
+	void						reset(void);
+
+	size_t						getCapacity(void) const { return m_mask + 1; }
+	uint64_t					getDroppedCount(void) const { return m_droppedCount.load(std::memory_order_relaxed); }
+
+private:
+	static const size_t			kCacheLineSize = 64;
+
+	struct Cell
+	{
+		std::atomic<size_t>		sequence;
+		T						sample;
+		char					padding[kCacheLineSize - (sizeof(std::atomic<size_t>) + sizeof(T)) % kCacheLineSize];
+	};
+
+	bool						tryPush(T& sample);
+	bool						tryPop(T& sample);
+
+	Cell*						m_cells;
+	size_t						m_mask;
+	SampleQueueOverflowPolicy	m_overflowPolicy;
+	char						m_padding0[kCacheLineSize];
+	std::atomic<size_t>			m_enqueuePosition;
+	char						m_padding1[kCacheLineSize - sizeof(std::atomic<size_t>)];
+	std::atomic<size_t>			m_dequeuePosition;
+	char						m_padding2[kCacheLineSize - sizeof(std::atomic<size_t>)];
+	SampleQueueEvent			m_sampleEvent;
+	SampleQueueEvent			m_spaceEvent;
+	std::atomic<bool>			m_waitCancelled;
+	std::atomic<uint64_t>		m_droppedCount;
+};
+
+template<typename T>
+SampleQueue<T>::SampleQueue(size_t capacity, SampleQueueOverflowPolicy overflowPolicy) :
+	m_cells(nullptr),
+	m_mask(0),
+	m_overflowPolicy(overflowPolicy),
+	m_enqueuePosition(0),
+	m_dequeuePosition(0),
+	m_waitCancelled(false),
+	m_droppedCount(0)
+{
+	// Round capacity up to a power of two so positions map to slots with a mask
+	size_t cellCount = 2;
+	while (cellCount < capacity)
+		cellCount <<= 1;
+
+	void* cells = nullptr;
+	if (posix_memalign(&cells, kCacheLineSize, cellCount * sizeof(Cell)) != 0)
+		throw std::bad_alloc();
+
+	m_cells = static_cast<Cell*>(cells);
+	m_mask = cellCount - 1;
+
+	for (size_t i = 0; i < cellCount; i++)
+	{
+		new (&m_cells[i]) Cell();
+		m_cells[i].sequence.store(i, std::memory_order_relaxed);
+	}
+}
+
+template<typename T>
+SampleQueue<T>::~SampleQueue()
+{
+	cancelWaiters();
+
+	for (size_t i = 0; i <= m_mask; i++)
+		m_cells[i].~Cell();
+
+	free(m_cells);
+}
+
+template<typename T>
+bool SampleQueue<T>::tryPush(T& sample)
+{
+	size_t position = m_enqueuePosition.load(std::memory_order_relaxed);
+
+	while (true)
+	{
+		Cell& cell = m_cells[position & m_mask];
+		intptr_t difference = (intptr_t)cell.sequence.load(std::memory_order_acquire) - (intptr_t)position;
+
+		if (difference == 0)
+		{
+			// Slot is free, claim it
+			if (m_enqueuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+			{
+				cell.sample = std::move(sample);
+				cell.sequence.store(position + 1, std::memory_order_release);
+				return true;
+			}
+		}
+		else if (difference < 0)
+		{
+			// Slot still holds a sample from the previous lap, queue is full
+			return false;
+		}
+		else
+		{
+			// Another producer claimed the slot
+			position = m_enqueuePosition.load(std::memory_order_relaxed);
+		}
+	}
+}
+
+template<typename T>
+bool SampleQueue<T>::tryPop(T& sample)
+{
+	size_t position = m_dequeuePosition.load(std::memory_order_relaxed);
+
+	while (true)
+	{
+		Cell& cell = m_cells[position & m_mask];
+		intptr_t difference = (intptr_t)cell.sequence.load(std::memory_order_acquire) - (intptr_t)(position + 1);
+
+		if (difference == 0)
+		{
+			if (m_dequeuePosition.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+			{
+				sample = std::move(cell.sample);
+				cell.sample = T();
+				cell.sequence.store(position + m_mask + 1, std::memory_order_release);
+				return true;
+			}
+		}
+		else if (difference < 0)
+		{
+			// Queue is empty
+			return false;
+		}
+		else
+		{
+			position = m_dequeuePosition.load(std::memory_order_relaxed);
+		}
+	}
+}
+
+template<typename T>
+bool SampleQueue<T>::pushSample(const T& sample)
+{
+	T copy(sample);
+	return pushSample(std::move(copy));
+}
+
+template<typename T>
+bool SampleQueue<T>::pushSample(T&& sample)
+{
+	// Returns false when the sample was discarded rather than queued
+	while (!tryPush(sample))
+	{
+		if (m_overflowPolicy == SampleQueueOverflowPolicy::DropNewest)
+		{
+			m_droppedCount.fetch_add(1, std::memory_order_relaxed);
+			return false;
+		}
+		else if (m_overflowPolicy == SampleQueueOverflowPolicy::DropOldest)
+		{
+			T discarded;
+			if (tryPop(discarded))
+				m_droppedCount.fetch_add(1, std::memory_order_relaxed);
+		}
+		else
+		{
+			// Blocking push, wait for a consumer to pop a sample
+			uint32_t sequence = m_spaceEvent.prepareWait();
+
+			if (tryPush(sample))
+				break;
+			else if (m_waitCancelled.load(std::memory_order_acquire))
+			{
+				m_droppedCount.fetch_add(1, std::memory_order_relaxed);
+				return false;
+			}
+
+			m_spaceEvent.wait(sequence);
+		}
+	}
+
+	m_sampleEvent.notify();
+	return true;
+}
+
+template<typename T>
+bool SampleQueue<T>::popSample(T& sample)
+{
+	// Non-blocking queue pop
+	if (!tryPop(sample))
+		return false;
+
+	if (m_overflowPolicy == SampleQueueOverflowPolicy::Block)
+		m_spaceEvent.notify();
+
+	return true;
+}
+
+template<typename T>
+bool SampleQueue<T>::waitForSample(T& sample)
+{
+	// Blocking wait for sample
+	while (!m_waitCancelled.load(std::memory_order_acquire))
+	{
+		if (popSample(sample))
+			return true;
+
+		uint32_t sequence = m_sampleEvent.prepareWait();
+
+		if (m_waitCancelled.load(std::memory_order_acquire))
+			break;
+		else if (popSample(sample))
+			return true;
+
+		m_sampleEvent.wait(sequence);
+	}
+
+	return false;
+}
+
+template<typename T>
+void SampleQueue<T>::cancelWaiters()
+{
+	// signal cancel flag to terminate wait condition
+	m_waitCancelled.store(true, std::memory_order_release);
+	m_sampleEvent.notify();
+	m_spaceEvent.notify();
+}
+
+template<typename T>
+void SampleQueue<T>::reset(void)
+{
+	T discarded;
+	while (tryPop(discarded))
+		;
+
+	m_droppedCount.store(0, std::memory_order_relaxed);
+	m_waitCancelled.store(false, std::memory_order_release);
+}
@@ -0,0 +1,321 @@
+/* -LICENSE-START-
+** Copyright (c) 2019 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+// Measures SampleQueue against the mutex and condition variable queue it replaced, with the video
+// frame and audio packet cadence of 8K60 loop-through.  Each frame is one video sample and one audio
+// packet of 800 sample frames, pushed by the capture thread and popped by a scheduling thread as in
+// DeckLinkOutputDevice.  The paced run reports the time from push to pop, and the unpaced run the
+// cost of each sample when the producer never waits.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+#include "SampleQueue.h"
+
+namespace
+{
+	const int		kFrameRate				= 60;
+	const uint32_t	kAudioSampleFrames		= 48000 / kFrameRate;
+	const uint32_t	kAudioChannelCount		= 16;
+	const size_t	kQueueCapacity			= 32;
+
+	typedef std::chrono::steady_clock	Clock;
+
+	// Stands in for LoopThroughVideoFrame and LoopThroughAudioPacket, which hold a buffer and timestamps
+	struct BenchmarkSample
+	{
+		explicit BenchmarkSample(size_t bufferSize) :
+			buffer(bufferSize),
+			pushTime(0)
+		{ }
+
+		std::vector<uint8_t>			buffer;
+		std::atomic<Clock::rep>			pushTime;		// Atomic, as the unpaced run may queue a sample again before it is popped
+	};
+
+	typedef std::shared_ptr<BenchmarkSample>	SamplePtr;
+
+	// The queue replaced by SampleQueue, unbounded behind a mutex and condition variable
+	class LockedSampleQueue
+	{
+	public:
+		LockedSampleQueue() :
+			m_waitCancelled(false)
+		{ }
+
+		bool pushSample(SamplePtr&& sample)
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_queue.push(std::move(sample));
+			}
+			m_queueCondition.notify_one();
+			return true;
+		}
+
+		bool waitForSample(SamplePtr& sample)
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_queueCondition.wait(lock, [&] { return !m_queue.empty() || m_waitCancelled; });
+
+			if (m_queue.empty())
+				return false;
+
+			sample = std::move(m_queue.front());
+			m_queue.pop();
+			return true;
+		}
+
+		void cancelWaiters(void)
+		{
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_waitCancelled = true;
+			}
+			m_queueCondition.notify_all();
+		}
+
+		uint64_t getDroppedCount(void) const { return 0; }
+
+	private:
+		std::queue<SamplePtr>		m_queue;
+		std::condition_variable		m_queueCondition;
+		std::mutex					m_mutex;
+		bool						m_waitCancelled;
+	};
+
+	struct RunResult
+	{
+		std::vector<double>	latencies;		// Push to pop, in microseconds
+		double				elapsed;		// Seconds for the producer to push every sample
+		uint64_t			dropped;
+	};
+
+	double getPercentile(std::vector<double>& values, double percentile)
+	{
+		if (values.empty())
+			return 0.0;
+
+		size_t index = std::min(values.size() - 1, (size_t)(percentile / 100.0 * values.size()));
+		std::nth_element(values.begin(), values.begin() + index, values.end());
+		return values[index];
+	}
+
+	// Pushes frameCount frames of video and audio from this thread, popped by one thread per queue.  The
+	// samples are allocated up front and reused, so only the queues are measured
+	template<typename Queue>
+	RunResult runQueues(Queue& videoQueue, Queue& audioQueue, int frameCount, bool paced)
+	{
+		const size_t	audioBufferSize	= kAudioSampleFrames * kAudioChannelCount * sizeof(int32_t);
+		const size_t	poolSize		= kQueueCapacity * 2;
+
+		std::vector<SamplePtr>	videoPool;
+		std::vector<SamplePtr>	audioPool;
+		RunResult				result;
+		std::vector<double>		audioLatencies;
+		std::atomic<uint64_t>	videoPopped(0);
+		std::atomic<uint64_t>	audioPopped(0);
+
+		for (size_t i = 0; i < poolSize; i++)
+		{
+			// The queues pass pointers rather than pixels, so the 8K frames are not allocated
+			videoPool.push_back(std::make_shared<BenchmarkSample>(0));
+			audioPool.push_back(std::make_shared<BenchmarkSample>(audioBufferSize));
+		}
+
+		result.latencies.reserve(frameCount);
+		audioLatencies.reserve(frameCount);
+
+		auto consume = [](Queue& queue, std::vector<double>& latencies, std::atomic<uint64_t>& popped)
+		{
+			SamplePtr sample;
+			while (queue.waitForSample(sample))
+			{
+				Clock::duration latency = Clock::now().time_since_epoch() - Clock::duration(sample->pushTime.load(std::memory_order_relaxed));
+				latencies.push_back(std::chrono::duration<double, std::micro>(latency).count());
+				sample = nullptr;
+				popped.fetch_add(1, std::memory_order_release);
+			}
+		};
+
+		std::thread videoThread(consume, std::ref(videoQueue), std::ref(result.latencies), std::ref(videoPopped));
+		std::thread audioThread(consume, std::ref(audioQueue), std::ref(audioLatencies), std::ref(audioPopped));
+
+		Clock::time_point start = Clock::now();
+		Clock::duration framePeriod = std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(1.0 / kFrameRate));
+
+		for (int frame = 0; frame < frameCount; frame++)
+		{
+			if (paced)
+				std::this_thread::sleep_until(start + framePeriod * frame);
+
+			SamplePtr video = videoPool[frame % poolSize];
+			SamplePtr audio = audioPool[frame % poolSize];
+
+			video->pushTime.store(Clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+			videoQueue.pushSample(std::move(video));
+			audio->pushTime.store(Clock::now().time_since_epoch().count(), std::memory_order_relaxed);
+			audioQueue.pushSample(std::move(audio));
+		}
+
+		result.elapsed = std::chrono::duration<double>(Clock::now() - start).count();
+
+		// Let the consumers empty the queues before they are cancelled, every sample is either popped or dropped
+		while ((videoPopped.load(std::memory_order_acquire) + videoQueue.getDroppedCount() < (uint64_t)frameCount) ||
+			   (audioPopped.load(std::memory_order_acquire) + audioQueue.getDroppedCount() < (uint64_t)frameCount))
+			std::this_thread::sleep_for(std::chrono::milliseconds(1));
+
+		videoQueue.cancelWaiters();
+		audioQueue.cancelWaiters();
+		videoThread.join();
+		audioThread.join();
+
+		result.latencies.insert(result.latencies.end(), audioLatencies.begin(), audioLatencies.end());
+		result.dropped = videoQueue.getDroppedCount() + audioQueue.getDroppedCount();
+		return result;
+	}
+
+	void printResult(const char* name, RunResult result, int frameCount, bool paced)
+	{
+		if (paced)
+		{
+			printf("%-22s%10.1f%10.1f%10.1f%10llu\n", name,
+				getPercentile(result.latencies, 50.0), getPercentile(result.latencies, 99.0), getPercentile(result.latencies, 100.0),
+				(unsigned long long)result.dropped);
+		}
+		else
+		{
+			printf("%-22s%10.1f%10.2f%10llu\n", name,
+				(result.elapsed * 1e9) / (frameCount * 2), (frameCount * 2) / result.elapsed / 1e6,
+				(unsigned long long)result.dropped);
+		}
+	}
+
+	void displayUsage(const char* program)
+	{
+		fprintf(stderr,
+			"Usage: %s [options]\n"
+			"    -f <frames>        Frames pushed at 60 fps in the paced run (default is 300)\n"
+			"    -n <frames>        Frames pushed without waiting in the unpaced run (default is 1000000)\n",
+			program);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	int		pacedFrameCount		= 300;
+	int		unpacedFrameCount	= 1000000;
+	int		ch;
+
+	while ((ch = getopt(argc, argv, "f:n:h")) != -1)
+	{
+		switch (ch)
+		{
+			case 'f':
+				pacedFrameCount = atoi(optarg);
+				break;
+			case 'n':
+				unpacedFrameCount = atoi(optarg);
+				break;
+			case 'h':
+			default:
+				displayUsage(argv[0]);
+				return 1;
+		}
+	}
+
+	if ((pacedFrameCount <= 0) || (unpacedFrameCount <= 0))
+	{
+		displayUsage(argv[0]);
+		return 1;
+	}
+
+	const struct
+	{
+		const char*					name;
+		SampleQueueOverflowPolicy	policy;
+	}
+	kPolicies[] =
+	{
+		{ "SampleQueue Block",		SampleQueueOverflowPolicy::Block },
+		{ "SampleQueue DropOldest",	SampleQueueOverflowPolicy::DropOldest },
+		{ "SampleQueue DropNewest",	SampleQueueOverflowPolicy::DropNewest },
+	};
+
+	for (bool paced : { true, false })
+	{
+		int frameCount = paced ? pacedFrameCount : unpacedFrameCount;
+
+		if (paced)
+		{
+			printf("8K60 paced, %d frames of video and audio, push to pop in us\n", frameCount);
+			printf("%-22s%10s%10s%10s%10s\n", "", "p50", "p99", "max", "dropped");
+		}
+		else
+		{
+			printf("\nUnpaced, %d frames of video and audio\n", frameCount);
+			printf("%-22s%10s%10s%10s\n", "", "ns/sample", "M/s", "dropped");
+		}
+
+		{
+			LockedSampleQueue videoQueue;
+			LockedSampleQueue audioQueue;
+			printResult("Mutex queue", runQueues(videoQueue, audioQueue, frameCount, paced), frameCount, paced);
+		}
+
+		for (const auto& policy : kPolicies)
+		{
+			SampleQueue<SamplePtr> videoQueue(kQueueCapacity, policy.policy);
+			SampleQueue<SamplePtr> audioQueue(kQueueCapacity, policy.policy);
+			printResult(policy.name, runQueues(videoQueue, audioQueue, frameCount, paced), frameCount, paced);
+		}
+	}
+
+	return 0;
+}
@@ -0,0 +1,88 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+// Copies of prepared lines, such as test patterns, to the rows of a video frame.  The frame is handed to the
+// driver without being read back by the CPU, so where possible rows are written with non-temporal stores
+// that bypass the cache rather than evicting the source line.  Follow a run of copies with
+// FinishFrameRowCopies before the frame is handed to the driver.
+
+inline void CopyFrameRow(uint8_t* destination, const uint8_t* source, size_t size)
+{
+#if defined(__SSE2__)
+	size_t head = (16 - ((uintptr_t)destination & 15)) & 15;
+	if (size >= head + 64)
+	{
+		std::memcpy(destination, source, head);
+		destination += head;
+		source += head;
+		size -= head;
+
+		for (; size >= 64; size -= 64, destination += 64, source += 64)
+		{
+			__m128i a = _mm_loadu_si128((const __m128i*)source);
+			__m128i b = _mm_loadu_si128((const __m128i*)(source + 16));
+			__m128i c = _mm_loadu_si128((const __m128i*)(source + 32));
+			__m128i d = _mm_loadu_si128((const __m128i*)(source + 48));
+			_mm_stream_si128((__m128i*)destination, a);
+			_mm_stream_si128((__m128i*)(destination + 16), b);
+			_mm_stream_si128((__m128i*)(destination + 32), c);
+			_mm_stream_si128((__m128i*)(destination + 48), d);
+		}
+	}
+#endif
+	std::memcpy(destination, source, size);
+}
+
+inline void FinishFrameRowCopies(void)
+{
+#if defined(__SSE2__)
+	// Order the non-temporal stores before the frame is handed to the driver
+	_mm_sfence();
+#endif
+}
@@ -0,0 +1,278 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include "DeckLinkAPI.h"
+
+// Compile-time description of each pixel format in DeckLinkAPIModes.h, refer to DeckLink SDK Manual -
+// 2.7.4 Pixel Formats.  Packed formats are a run of fixed size blocks of pixels, each row padded to the
+// row alignment of the format, so row bytes and the packing of a block are known at compile time.
+//
+// Kernels are written once as templates on PixelFormatTraits, so that each format gets an inner loop
+// with its block size and byte order as constants.  DispatchPixelFormat selects the instantiation for a
+// pixel format known only at runtime, and is called once per line or frame rather than per pixel.
+
+enum class PixelByteOrder
+{
+	None,				// Components are whole bytes
+	LittleEndian,		// Packed in 32-bit little-endian words
+	BigEndian			// Packed in 32-bit big-endian words
+};
+
+enum class PixelSampling
+{
+	YCbCr422,
+	RGB444,
+	Compressed
+};
+
+template <BMDPixelFormat Format, uint32_t BlockPixels, uint32_t BlockBytes, uint32_t RowAlignment, uint32_t BitDepth, PixelByteOrder ByteOrder, PixelSampling Sampling, bool FullRange>
+struct PixelFormatLayout
+{
+	static constexpr BMDPixelFormat	kPixelFormat	= Format;
+	static constexpr uint32_t		kBlockPixels	= BlockPixels;		// Pixels packed together in a block
+	static constexpr uint32_t		kBlockBytes		= BlockBytes;		// Bytes of a block, 0 for compressed formats
+	static constexpr uint32_t		kRowAlignment	= RowAlignment;		// Rows are padded to a multiple of this many bytes
+	static constexpr uint32_t		kBitDepth		= BitDepth;
+	static constexpr PixelByteOrder	kByteOrder		= ByteOrder;
+	static constexpr PixelSampling	kSampling		= Sampling;
+	static constexpr bool			kFullRange		= FullRange;		// Full range components rather than video levels
+	static constexpr bool			kPacked			= (BlockBytes != 0);
+	static constexpr bool			kRGB			= (Sampling == PixelSampling::RGB444);
+
+	// Bytes of the blocks covering width pixels, the last block is written whole
+	static constexpr size_t ActiveRowBytes(long width)
+	{
+		return (width <= 0) ? 0 : ((size_t)width + BlockPixels - 1) / BlockPixels * BlockBytes;
+	}
+
+	// Bytes of a row of a frame, including padding to the row alignment
+	static constexpr size_t RowBytes(long width)
+	{
+		return (ActiveRowBytes(width) + RowAlignment - 1) / RowAlignment * RowAlignment;
+	}
+};
+
+template <BMDPixelFormat Format, uint32_t BlockPixels, uint32_t BlockBytes, uint32_t RowAlignment, uint32_t BitDepth, PixelByteOrder ByteOrder, PixelSampling Sampling, bool FullRange>
+constexpr BMDPixelFormat PixelFormatLayout<Format, BlockPixels, BlockBytes, RowAlignment, BitDepth, ByteOrder, Sampling, FullRange>::kPixelFormat;
+template <BMDPixelFormat Format, uint32_t BlockPixels, uint32_t BlockBytes, uint32_t RowAlignment, uint32_t BitDepth, PixelByteOrder ByteOrder, PixelSampling Sampling, bool FullRange>
+constexpr uint32_t PixelFormatLayout<Format, BlockPixels, BlockBytes, RowAlignment, BitDepth, ByteOrder, Sampling, FullRange>::kBlockPixels;
+template <BMDPixelFormat Format, uint32_t BlockPixels, uint32_t BlockBytes, uint32_t RowAlignment, uint32_t BitDepth, PixelByteOrder ByteOrder, PixelSampling Sampling, bool FullRange>
+constexpr uint32_t PixelFormatLayout<Format, BlockPixels, BlockBytes, RowAlignment, BitDepth, ByteOrder, Sampling, FullRange>::kBlockBytes;
+template <BMDPixelFormat Format, uint32_t BlockPixels, uint32_t BlockBytes, uint32_t RowAlignment, uint32_t BitDepth, PixelByteOrder ByteOrder, PixelSampling Sampling, bool FullRange>
+constexpr uint32_t PixelFormatLayout<Format, BlockPixels, BlockBytes, RowAlignment, BitDepth, ByteOrder, Sampling, FullRange>::kRowAlignment;
+template <BMDPixelFormat Format, uint32_t BlockPixels, uint32_t BlockBytes, uint32_t RowAlignment, uint32_t BitDepth, PixelByteOrder ByteOrder, PixelSampling Sampling, bool FullRange>
+constexpr uint32_t PixelFormatLayout<Format, BlockPixels, BlockBytes, RowAlignment, BitDepth, ByteOrder, Sampling, FullRange>::kBitDepth;
+template <BMDPixelFormat Format, uint32_t BlockPixels, uint32_t BlockBytes, uint32_t RowAlignment, uint32_t BitDepth, PixelByteOrder ByteOrder, PixelSampling Sampling, bool FullRange>
+constexpr PixelByteOrder PixelFormatLayout<Format, BlockPixels, BlockBytes, RowAlignment, BitDepth, ByteOrder, Sampling, FullRange>::kByteOrder;
+template <BMDPixelFormat Format, uint32_t BlockPixels, uint32_t BlockBytes, uint32_t RowAlignment, uint32_t BitDepth, PixelByteOrder ByteOrder, PixelSampling Sampling, bool FullRange>
+constexpr PixelSampling PixelFormatLayout<Format, BlockPixels, BlockBytes, RowAlignment, BitDepth, ByteOrder, Sampling, FullRange>::kSampling;
+template <BMDPixelFormat Format, uint32_t BlockPixels, uint32_t BlockBytes, uint32_t RowAlignment, uint32_t BitDepth, PixelByteOrder ByteOrder, PixelSampling Sampling, bool FullRange>
+constexpr bool PixelFormatLayout<Format, BlockPixels, BlockBytes, RowAlignment, BitDepth, ByteOrder, Sampling, FullRange>::kFullRange;
+template <BMDPixelFormat Format, uint32_t BlockPixels, uint32_t BlockBytes, uint32_t RowAlignment, uint32_t BitDepth, PixelByteOrder ByteOrder, PixelSampling Sampling, bool FullRange>
+constexpr bool PixelFormatLayout<Format, BlockPixels, BlockBytes, RowAlignment, BitDepth, ByteOrder, Sampling, FullRange>::kPacked;
+template <BMDPixelFormat Format, uint32_t BlockPixels, uint32_t BlockBytes, uint32_t RowAlignment, uint32_t BitDepth, PixelByteOrder ByteOrder, PixelSampling Sampling, bool FullRange>
+constexpr bool PixelFormatLayout<Format, BlockPixels, BlockBytes, RowAlignment, BitDepth, ByteOrder, Sampling, FullRange>::kRGB;
+
+template <BMDPixelFormat Format>
+struct PixelFormatTraits;
+
+//																	  block	 block	  row	  bit
+//																	pixels	 bytes	align	depth	byte order						sampling					full range
+template <> struct PixelFormatTraits<bmdFormat8BitYUV>		: PixelFormatLayout<bmdFormat8BitYUV,		2,		 4,		  4,	 8,		PixelByteOrder::None,			PixelSampling::YCbCr422,	false>	{ static const char* Name() { return "8-bit YUV"; } };
+template <> struct PixelFormatTraits<bmdFormat10BitYUV>		: PixelFormatLayout<bmdFormat10BitYUV,		6,		16,		128,	10,		PixelByteOrder::LittleEndian,	PixelSampling::YCbCr422,	false>	{ static const char* Name() { return "10-bit YUV"; } };
+template <> struct PixelFormatTraits<bmdFormat8BitARGB>		: PixelFormatLayout<bmdFormat8BitARGB,		1,		 4,		  4,	 8,		PixelByteOrder::None,			PixelSampling::RGB444,		true>	{ static const char* Name() { return "8-bit ARGB"; } };
+template <> struct PixelFormatTraits<bmdFormat8BitBGRA>		: PixelFormatLayout<bmdFormat8BitBGRA,		1,		 4,		  4,	 8,		PixelByteOrder::None,			PixelSampling::RGB444,		true>	{ static const char* Name() { return "8-bit BGRA"; } };
+template <> struct PixelFormatTraits<bmdFormat10BitRGB>		: PixelFormatLayout<bmdFormat10BitRGB,		1,		 4,		256,	10,		PixelByteOrder::BigEndian,		PixelSampling::RGB444,		false>	{ static const char* Name() { return "10-bit RGB"; } };
+template <> struct PixelFormatTraits<bmdFormat12BitRGB>		: PixelFormatLayout<bmdFormat12BitRGB,		8,		36,		 36,	12,		PixelByteOrder::BigEndian,		PixelSampling::RGB444,		true>	{ static const char* Name() { return "12-bit RGB"; } };
+template <> struct PixelFormatTraits<bmdFormat12BitRGBLE>	: PixelFormatLayout<bmdFormat12BitRGBLE,	8,		36,		 36,	12,		PixelByteOrder::LittleEndian,	PixelSampling::RGB444,		true>	{ static const char* Name() { return "12-bit RGBLE"; } };
+template <> struct PixelFormatTraits<bmdFormat10BitRGBXLE>	: PixelFormatLayout<bmdFormat10BitRGBXLE,	1,		 4,		256,	10,		PixelByteOrder::LittleEndian,	PixelSampling::RGB444,		false>	{ static const char* Name() { return "10-bit RGBXLE"; } };
+template <> struct PixelFormatTraits<bmdFormat10BitRGBX>	: PixelFormatLayout<bmdFormat10BitRGBX,		1,		 4,		256,	10,		PixelByteOrder::BigEndian,		PixelSampling::RGB444,		false>	{ static const char* Name() { return "10-bit RGBX"; } };
+template <> struct PixelFormatTraits<bmdFormatH265>			: PixelFormatLayout<bmdFormatH265,			1,		 0,		  1,	 0,		PixelByteOrder::None,			PixelSampling::Compressed,	false>	{ static const char* Name() { return "H.265"; } };
+template <> struct PixelFormatTraits<bmdFormatDNxHR>		: PixelFormatLayout<bmdFormatDNxHR,			1,		 0,		  1,	 0,		PixelByteOrder::None,			PixelSampling::Compressed,	false>	{ static const char* Name() { return "DNxHR"; } };
+template <> struct PixelFormatTraits<bmdFormatUnspecified>	: PixelFormatLayout<bmdFormatUnspecified,	1,		 0,		  1,	 0,		PixelByteOrder::None,			PixelSampling::Compressed,	false>	{ static const char* Name() { return "Unspecified"; } };
+
+// Every pixel format of the SDK, in the order of DeckLinkAPIModes.h
+const BMDPixelFormat kAllPixelFormats[] =
+{
+	bmdFormat8BitYUV,
+	bmdFormat10BitYUV,
+	bmdFormat8BitARGB,
+	bmdFormat8BitBGRA,
+	bmdFormat10BitRGB,
+	bmdFormat12BitRGB,
+	bmdFormat12BitRGBLE,
+	bmdFormat10BitRGBXLE,
+	bmdFormat10BitRGBX,
+	bmdFormatH265,
+	bmdFormatDNxHR
+};
+
+// Call visitor(PixelFormatTraits<pixelFormat>()) and return its result.  Unknown pixel formats are
+// visited as bmdFormatUnspecified, so the visitor must handle the formats that are not packed.
+template <typename Visitor>
+auto DispatchPixelFormat(BMDPixelFormat pixelFormat, Visitor&& visitor) -> decltype(visitor(PixelFormatTraits<bmdFormatUnspecified>()))
+{
+	switch (pixelFormat)
+	{
+		case bmdFormat8BitYUV:		return visitor(PixelFormatTraits<bmdFormat8BitYUV>());
+		case bmdFormat10BitYUV:		return visitor(PixelFormatTraits<bmdFormat10BitYUV>());
+		case bmdFormat8BitARGB:		return visitor(PixelFormatTraits<bmdFormat8BitARGB>());
+		case bmdFormat8BitBGRA:		return visitor(PixelFormatTraits<bmdFormat8BitBGRA>());
+		case bmdFormat10BitRGB:		return visitor(PixelFormatTraits<bmdFormat10BitRGB>());
+		case bmdFormat12BitRGB:		return visitor(PixelFormatTraits<bmdFormat12BitRGB>());
+		case bmdFormat12BitRGBLE:	return visitor(PixelFormatTraits<bmdFormat12BitRGBLE>());
+		case bmdFormat10BitRGBXLE:	return visitor(PixelFormatTraits<bmdFormat10BitRGBXLE>());
+		case bmdFormat10BitRGBX:	return visitor(PixelFormatTraits<bmdFormat10BitRGBX>());
+		case bmdFormatH265:			return visitor(PixelFormatTraits<bmdFormatH265>());
+		case bmdFormatDNxHR:		return visitor(PixelFormatTraits<bmdFormatDNxHR>());
+		default:					return visitor(PixelFormatTraits<bmdFormatUnspecified>());
+	}
+}
+
+// Runtime copy of the traits of a pixel format
+struct PixelFormatInfo
+{
+	BMDPixelFormat	pixelFormat;
+	const char*		name;
+	uint32_t		blockPixels;
+	uint32_t		blockBytes;
+	uint32_t		rowAlignment;
+	uint32_t		bitDepth;
+	PixelByteOrder	byteOrder;
+	PixelSampling	sampling;
+	bool			fullRange;
+	bool			packed;
+	bool			rgb;
+};
+
+struct PixelFormatInfoVisitor
+{
+	template <typename Traits>
+	PixelFormatInfo operator()(Traits) const
+	{
+		return { Traits::kPixelFormat, Traits::Name(), Traits::kBlockPixels, Traits::kBlockBytes, Traits::kRowAlignment, Traits::kBitDepth,
+				Traits::kByteOrder, Traits::kSampling, Traits::kFullRange, Traits::kPacked, Traits::kRGB };
+	}
+};
+
+inline PixelFormatInfo GetPixelFormatInfo(BMDPixelFormat pixelFormat)
+{
+	return DispatchPixelFormat(pixelFormat, PixelFormatInfoVisitor());
+}
+
+inline const char* GetPixelFormatName(BMDPixelFormat pixelFormat)
+{
+	return GetPixelFormatInfo(pixelFormat).name;
+}
+
+inline bool IsPackedPixelFormat(BMDPixelFormat pixelFormat)
+{
+	return GetPixelFormatInfo(pixelFormat).packed;
+}
+
+inline bool IsRGBPixelFormat(BMDPixelFormat pixelFormat)
+{
+	return GetPixelFormatInfo(pixelFormat).rgb;
+}
+
+struct PixelFormatRowBytesVisitor
+{
+	long	width;
+	bool	active;
+
+	template <typename Traits>
+	long operator()(Traits) const
+	{
+		return (long)(active ? Traits::ActiveRowBytes(width) : Traits::RowBytes(width));
+	}
+};
+
+// Row bytes of a frame of packed pixels, or 0 for compressed and unknown pixel formats
+inline long GetPixelFormatRowBytes(BMDPixelFormat pixelFormat, long width)
+{
+	return DispatchPixelFormat(pixelFormat, PixelFormatRowBytesVisitor{ width, false });
+}
+
+// Bytes of a row up to the end of the block holding the last pixel, excluding row padding
+inline long GetPixelFormatActiveRowBytes(BMDPixelFormat pixelFormat, long width)
+{
+	return DispatchPixelFormat(pixelFormat, PixelFormatRowBytesVisitor{ width, true });
+}
+
+// 32-bit words of packed formats in the byte order of the format
+template <PixelByteOrder ByteOrder>
+inline uint32_t LoadPixelWord(const uint8_t* p);
+
+template <>
+inline uint32_t LoadPixelWord<PixelByteOrder::LittleEndian>(const uint8_t* p)
+{
+	return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+template <>
+inline uint32_t LoadPixelWord<PixelByteOrder::BigEndian>(const uint8_t* p)
+{
+	return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+}
+
+template <PixelByteOrder ByteOrder>
+inline void StorePixelWord(uint8_t* p, uint32_t value);
+
+template <>
+inline void StorePixelWord<PixelByteOrder::LittleEndian>(uint8_t* p, uint32_t value)
+{
+	p[0] = (uint8_t)value;
+	p[1] = (uint8_t)(value >> 8);
+	p[2] = (uint8_t)(value >> 16);
+	p[3] = (uint8_t)(value >> 24);
+}
+
+template <>
+inline void StorePixelWord<PixelByteOrder::BigEndian>(uint8_t* p, uint32_t value)
+{
+	p[0] = (uint8_t)(value >> 24);
+	p[1] = (uint8_t)(value >> 16);
+	p[2] = (uint8_t)(value >> 8);
+	p[3] = (uint8_t)value;
+}
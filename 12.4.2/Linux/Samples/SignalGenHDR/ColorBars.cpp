@@ -41,12 +41,20 @@
 //
 
 #include "stdint.h"
+#include <algorithm>
 #include <array>
 #include <cstring>
 #include <functional>
+#include <memory>
+#include <mutex>
 #include <utility>
 #include <vector>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
 #include "ColorBars.h"
+#include "FrameRowCopy.h"
+#include "PixelFormatTraits.h"
 
 struct Color12BitRGB
 {
@@ -58,8 +66,8 @@ struct Color12BitRGB
 typedef std::array<Color12BitRGB, static_cast<size_t>(EOTFColorRange::Size)> EOTFColorArray;
 typedef std::vector<std::pair<EOTFColorArray, uint32_t>> ColorBarsPattern;
 
-static void FillLineBars(ColorBarsPattern& pattern, EOTFColorRange range, std::vector<Color12BitRGB>& lineBuffer);
-static void FillLineRamp(ColorBarsPattern& pattern, EOTFColorRange range, std::vector<Color12BitRGB>& lineBuffer);
+static uint32_t FillLineBars(const ColorBarsPattern& pattern, EOTFColorRange range, uint32_t scale, Color12BitRGB* line);
+static uint32_t FillLineRamp(const ColorBarsPattern& pattern, EOTFColorRange range, uint32_t scale, Color12BitRGB* line);
 
 
 // Refer to BT.2111 specification
@@ -216,121 +224,309 @@ static const ColorBarsPattern kColorBarsPattern5Full = {
 
 // Color bar patterns, heights:
 enum { kColorBarsPatternFillFunction = 0, kColorBarsPatternHeight };
-static const std::vector<std::tuple<std::function<void(EOTFColorRange, std::vector<Color12BitRGB>&)>, uint32_t>> kColorBarPatternsNarrow = {
-	std::make_tuple(std::bind(FillLineBars, kColorBarsPattern1, std::placeholders::_1, std::placeholders::_2), 90),
-	std::make_tuple(std::bind(FillLineBars, kColorBarsPattern2, std::placeholders::_1, std::placeholders::_2), 540),
-	std::make_tuple(std::bind(FillLineBars, kColorBarsPattern3Limited, std::placeholders::_1, std::placeholders::_2), 90),
-	std::make_tuple(std::bind(FillLineRamp, kColorBarsPattern4Limited, std::placeholders::_1, std::placeholders::_2), 90),
-	std::make_tuple(std::bind(FillLineBars, kColorBarsPattern5Limited, std::placeholders::_1, std::placeholders::_2), 270),
+typedef std::function<uint32_t(EOTFColorRange, uint32_t, Color12BitRGB*)> ColorBarsFillFunction;
+static const std::vector<std::tuple<ColorBarsFillFunction, uint32_t>> kColorBarPatternsNarrow = {
+	std::make_tuple(std::bind(FillLineBars, kColorBarsPattern1, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3), 90),
+	std::make_tuple(std::bind(FillLineBars, kColorBarsPattern2, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3), 540),
+	std::make_tuple(std::bind(FillLineBars, kColorBarsPattern3Limited, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3), 90),
+	std::make_tuple(std::bind(FillLineRamp, kColorBarsPattern4Limited, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3), 90),
+	std::make_tuple(std::bind(FillLineBars, kColorBarsPattern5Limited, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3), 270),
 };
-static const std::vector<std::tuple<std::function<void(EOTFColorRange, std::vector<Color12BitRGB>&)>, uint32_t>> kColorBarPatternsFull = {
-	std::make_tuple(std::bind(FillLineBars, kColorBarsPattern1, std::placeholders::_1, std::placeholders::_2), 90),
-	std::make_tuple(std::bind(FillLineBars, kColorBarsPattern2, std::placeholders::_1, std::placeholders::_2), 540),
-	std::make_tuple(std::bind(FillLineBars, kColorBarsPattern3Full, std::placeholders::_1, std::placeholders::_2), 90),
-	std::make_tuple(std::bind(FillLineRamp, kColorBarsPattern4Full, std::placeholders::_1, std::placeholders::_2), 90),
-	std::make_tuple(std::bind(FillLineBars, kColorBarsPattern5Full, std::placeholders::_1, std::placeholders::_2), 270),
+static const std::vector<std::tuple<ColorBarsFillFunction, uint32_t>> kColorBarPatternsFull = {
+	std::make_tuple(std::bind(FillLineBars, kColorBarsPattern1, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3), 90),
+	std::make_tuple(std::bind(FillLineBars, kColorBarsPattern2, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3), 540),
+	std::make_tuple(std::bind(FillLineBars, kColorBarsPattern3Full, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3), 90),
+	std::make_tuple(std::bind(FillLineRamp, kColorBarsPattern4Full, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3), 90),
+	std::make_tuple(std::bind(FillLineBars, kColorBarsPattern5Full, std::placeholders::_1, std::placeholders::_2, std::placeholders::_3), 270),
 };
 
 static const uint32_t kHD1080Width	= 1920;
 static const uint32_t kHD1080Height	= 1080;
 
+// Lines are packed 8 pixels at a time, so pad the line for the last group and for the 64-bit loads of
+// the 10-bit packers
+static const uint32_t kLinePadPixels	= 8;
+
+// Each pattern band of the color bars is a single line, packed in the frame's pixel format and
+// replicated down the band.  The packed lines are cached by frame size, pixel format and EOTF range,
+// so that filling another frame, as when restarting output, only replicates rows.
+struct ColorBarsBand
+{
+	std::vector<uint8_t>	line;
+	uint32_t				height;
+};
+
+struct ColorBarsLines
+{
+	uint32_t					width;
+	uint32_t					height;
+	uint32_t					rowBytes;
+	BMDPixelFormat				pixelFormat;
+	EOTFColorRange				range;
+	std::vector<ColorBarsBand>	bands;
+};
+
+static std::mutex									gColorBarsLinesMutex;
+static std::vector<std::unique_ptr<ColorBarsLines>>	gColorBarsLines;
+
+static inline uint32_t ByteSwap32(uint32_t value)
+{
+	return __builtin_bswap32(value);
+}
+
+#if defined(__SSE2__)
+static inline __m128i ByteSwap32(__m128i value)
+{
+	value = _mm_or_si128(_mm_slli_epi16(value, 8), _mm_srli_epi16(value, 8));
+	value = _mm_shufflelo_epi16(value, _MM_SHUFFLE(2, 3, 0, 1));
+	return _mm_shufflehi_epi16(value, _MM_SHUFFLE(2, 3, 0, 1));
+}
+
+// Pack 8 12-bit components, in the low bits of 16-bit lanes, into 12 bytes of bit stream
+static inline __m128i Pack12BitComponents(__m128i components)
+{
+	const __m128i kComponentMask	= _mm_set1_epi16(0x0FFF);
+	const __m128i kPairWeights		= _mm_set1_epi32(0x10000001);
+	const __m128i kLow24			= _mm_set1_epi64x(0x0000000000FFFFFFLL);
+	const __m128i kHigh24			= _mm_set1_epi64x(0x0000FFFFFF000000LL);
+	const __m128i kLow48			= _mm_set_epi64x(0, 0x0000FFFFFFFFFFFFLL);
+	const __m128i kHigh48			= _mm_set_epi64x(0x00000000FFFFFFFFLL, (long long)0xFFFF000000000000ULL);
+
+	// Pairs of components to 24 bits in each 32-bit lane, c0 + c1 * 4096
+	__m128i pairs = _mm_madd_epi16(_mm_and_si128(components, kComponentMask), kPairWeights);
+
+	// Pairs of 24-bit lanes to 48 bits in each 64-bit lane
+	__m128i quads = _mm_or_si128(_mm_and_si128(pairs, kLow24), _mm_and_si128(_mm_srli_epi64(pairs, 8), kHigh24));
+
+	// Close the 2 byte gap between the 64-bit lanes
+	return _mm_or_si128(_mm_and_si128(quads, kLow48), _mm_and_si128(_mm_srli_si128(quads, 2), kHigh48));
+}
+
+// Pack 2 pixels, given in 16-bit lanes as R, G, B, x, R, G, B, x, to 10:10:10 in the low 30 bits of the
+// first 2 32-bit lanes
+static inline __m128i Pack10BitPixels(__m128i pixels)
+{
+	const __m128i kComponentWeights	= _mm_set_epi16(0, 1, 1, 1024, 0, 1, 1, 1024);
+
+	// R * 1024 + G and B in each pair of 32-bit lanes
+	__m128i pairs = _mm_madd_epi16(_mm_srli_epi16(pixels, 2), kComponentWeights);
+
+	// (R * 1024 + G) << 10 | B in lanes 0 and 2
+	__m128i words = _mm_or_si128(_mm_slli_epi32(pairs, 10), _mm_srli_epi64(pairs, 32));
+	return _mm_shuffle_epi32(words, _MM_SHUFFLE(3, 1, 2, 0));
+}
+#endif
+
+// 12-bit RGB is a little-endian bit stream of R, G, B components, 8 pixels in 9 words.  Refer to DeckLink
+// SDK Manual, section 2.7.4 for packing structure.  The big-endian variant stores each 32-bit word byte swapped.
+template <typename Traits>
+static void Pack12BitRGBLine(const Color12BitRGB* line, uint32_t width, uint8_t* packed)
+{
+	const bool	bigEndian = (Traits::kByteOrder == PixelByteOrder::BigEndian);
+	uint32_t	i = 0;
+
+#if defined(__SSE2__)
+	// Color12BitRGB is already in bit stream order, so 8 pixels are 3 loads of 8 components
+	for (; i < width; i += 8, packed += 36)
+	{
+		const __m128i*	components = (const __m128i*)&line[i];
+		__m128i			block0 = Pack12BitComponents(_mm_loadu_si128(components));
+		__m128i			block1 = Pack12BitComponents(_mm_loadu_si128(components + 1));
+		__m128i			block2 = Pack12BitComponents(_mm_loadu_si128(components + 2));
+		uint32_t		lastWord;
+
+		if (bigEndian)
+		{
+			block0 = ByteSwap32(block0);
+			block1 = ByteSwap32(block1);
+			block2 = ByteSwap32(block2);
+		}
+
+		// Each block is 12 bytes, the next store overwrites the last 4 bytes of the one before
+		_mm_storeu_si128((__m128i*)packed, block0);
+		_mm_storeu_si128((__m128i*)(packed + 12), block1);
+		_mm_storel_epi64((__m128i*)(packed + 24), block2);
+		lastWord = (uint32_t)_mm_cvtsi128_si32(_mm_srli_si128(block2, 8));
+		std::memcpy(packed + 32, &lastWord, sizeof(lastWord));
+	}
+#else
+	for (; i < width; i += 8, packed += 36)
+	{
+		const Color12BitRGB*	pixel = &line[i];
+		uint32_t				words[9];
+
+		words[0] = ((pixel[0].Blue & 0x0FF) << 24) | ((pixel[0].Green & 0xFFF) << 12) | (pixel[0].Red & 0xFFF);
+		words[1] = ((pixel[1].Blue & 0x00F) << 28) | ((pixel[1].Green & 0xFFF) << 16) | ((pixel[1].Red & 0xFFF) << 4) | ((pixel[0].Blue & 0xF00) >> 8);
+		words[2] = ((pixel[2].Green & 0xFFF) << 20) | ((pixel[2].Red & 0xFFF) << 8) | ((pixel[1].Blue & 0xFF0) >> 4);
+		words[3] = ((pixel[3].Green & 0x0FF) << 24) | ((pixel[3].Red & 0xFFF) << 12) | (pixel[2].Blue & 0xFFF);
+		words[4] = ((pixel[4].Green & 0x00F) << 28) | ((pixel[4].Red & 0xFFF) << 16) | ((pixel[3].Blue & 0xFFF) << 4) | ((pixel[3].Green & 0xF00) >> 8);
+		words[5] = ((pixel[5].Red & 0xFFF) << 20) | ((pixel[4].Blue & 0xFFF) << 8) | ((pixel[4].Green & 0xFF0) >> 4);
+		words[6] = ((pixel[6].Red & 0x0FF) << 24) | ((pixel[5].Blue & 0xFFF) << 12) | (pixel[5].Green & 0xFFF);
+		words[7] = ((pixel[7].Red & 0x00F) << 28) | ((pixel[6].Blue & 0xFFF) << 16) | ((pixel[6].Green & 0xFFF) << 4) | ((pixel[6].Red & 0xF00) >> 8);
+		words[8] = ((pixel[7].Blue & 0xFFF) << 20) | ((pixel[7].Green & 0xFFF) << 8) | ((pixel[7].Red & 0xFF0) >> 4);
+
+		if (bigEndian)
+		{
+			for (uint32_t& word : words)
+				word = ByteSwap32(word);
+		}
+
+		std::memcpy(packed, words, sizeof(words));
+	}
+#endif
+}
+
+// 10-bit RGB is a 32-bit word per pixel, with the components in bits 29-0 for r210 and in bits 31-2 for
+// R10b/R10l, given by Shift.  r210 and R10b are big-endian.
+template <typename Traits, int Shift>
+static void Pack10BitRGBLine(const Color12BitRGB* line, uint32_t width, uint8_t* packed)
+{
+	const bool	bigEndian = (Traits::kByteOrder == PixelByteOrder::BigEndian);
+	uint32_t	i = 0;
+
+#if defined(__SSE2__)
+	// Each 64-bit load is the 3 components of a pixel and the red of the next, which the packing ignores
+	for (; i < width; i += 4, packed += 16)
+	{
+		__m128i pixels01	= _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*)&line[i]), _mm_loadl_epi64((const __m128i*)&line[i + 1]));
+		__m128i pixels23	= _mm_unpacklo_epi64(_mm_loadl_epi64((const __m128i*)&line[i + 2]), _mm_loadl_epi64((const __m128i*)&line[i + 3]));
+		__m128i words		= _mm_unpacklo_epi64(Pack10BitPixels(pixels01), Pack10BitPixels(pixels23));
+
+		words = _mm_slli_epi32(words, Shift);
+		if (bigEndian)
+			words = ByteSwap32(words);
+
+		_mm_storeu_si128((__m128i*)packed, words);
+	}
+#else
+	for (; i < width; i++, packed += 4)
+	{
+		uint32_t word = ((((uint32_t)line[i].Red >> 2) << 20) | (((uint32_t)line[i].Green >> 2) << 10) | ((uint32_t)line[i].Blue >> 2)) << Shift;
+		if (bigEndian)
+			word = ByteSwap32(word);
+		std::memcpy(packed, &word, sizeof(word));
+	}
+#endif
+}
+
+typedef void (*ColorBarsPackFunction)(const Color12BitRGB* line, uint32_t width, uint8_t* packed);
+
+// Packer instantiated for each RGB format, bars are not packed in other formats
+struct ColorBarsPackVisitor
+{
+	ColorBarsPackFunction operator()(PixelFormatTraits<bmdFormat12BitRGB>) const		{ return &Pack12BitRGBLine<PixelFormatTraits<bmdFormat12BitRGB>>; }
+	ColorBarsPackFunction operator()(PixelFormatTraits<bmdFormat12BitRGBLE>) const		{ return &Pack12BitRGBLine<PixelFormatTraits<bmdFormat12BitRGBLE>>; }
+	ColorBarsPackFunction operator()(PixelFormatTraits<bmdFormat10BitRGB>) const		{ return &Pack10BitRGBLine<PixelFormatTraits<bmdFormat10BitRGB>, 0>; }
+	ColorBarsPackFunction operator()(PixelFormatTraits<bmdFormat10BitRGBX>) const		{ return &Pack10BitRGBLine<PixelFormatTraits<bmdFormat10BitRGBX>, 2>; }
+	ColorBarsPackFunction operator()(PixelFormatTraits<bmdFormat10BitRGBXLE>) const	{ return &Pack10BitRGBLine<PixelFormatTraits<bmdFormat10BitRGBXLE>, 2>; }
+
+	template <typename Traits>
+	ColorBarsPackFunction operator()(Traits) const										{ return nullptr; }
+};
+
+static const ColorBarsLines* GetColorBarsLines(uint32_t width, uint32_t height, uint32_t rowBytes, BMDPixelFormat pixelFormat, EOTFColorRange range)
+{
+	std::lock_guard<std::mutex> lock(gColorBarsLinesMutex);
+
+	for (const std::unique_ptr<ColorBarsLines>& lines : gColorBarsLines)
+	{
+		if (lines->width == width && lines->height == height && lines->rowBytes == rowBytes && lines->pixelFormat == pixelFormat && lines->range == range)
+			return lines.get();
+	}
+
+	ColorBarsPackFunction packLine = DispatchPixelFormat(pixelFormat, ColorBarsPackVisitor());
+	if (!packLine)
+		return nullptr;
+
+	std::unique_ptr<ColorBarsLines> lines(new ColorBarsLines());
+	lines->width		= width;
+	lines->height		= height;
+	lines->rowBytes		= rowBytes;
+	lines->pixelFormat	= pixelFormat;
+	lines->range		= range;
+
+	// Column widths are based on HD, scale for 4K/8K.  If 2K/4K/8K DCI mode, then pad with 40% grey bars
+	uint32_t scale = width / kHD1080Width;
+	uint32_t padWidth = (width % kHD1080Width) / 2;
+
+	std::vector<Color12BitRGB> colorBarsLine(width + kLinePadPixels);
+
+	for (auto& iter : kColorBarPatternsNarrow)
+	{
+		ColorBarsBand band;
+
+		// Scale pattern for UHD frame height
+		band.height = std::get<kColorBarsPatternHeight>(iter) * (height / kHD1080Height);
+
+		uint32_t column = padWidth;
+		column += std::get<kColorBarsPatternFillFunction>(iter)(range, scale, &colorBarsLine[column]);
+		std::fill(colorBarsLine.begin(), colorBarsLine.begin() + padWidth, k40pcGrey[(int)range]);
+		std::fill(colorBarsLine.begin() + column, colorBarsLine.end(), k40pcGrey[(int)range]);
+
+		// Pixel groups are packed whole, allow for the last group extending past the row
+		band.line.assign(rowBytes + 64, 0);
+		packLine(colorBarsLine.data(), width, band.line.data());
+
+		// Clear anything packed past the last pixel, the padding of r210 rows is zero
+		std::fill(band.line.begin() + std::min(rowBytes, (uint32_t)GetPixelFormatActiveRowBytes(pixelFormat, width)), band.line.end(), 0);
+		band.line.resize(rowBytes);
+
+		lines->bands.push_back(std::move(band));
+	}
+
+	gColorBarsLines.push_back(std::move(lines));
+	return gColorBarsLines.back().get();
+}
+
 void FillBT2111ColorBars(com_ptr<IDeckLinkMutableVideoFrame>& colorBarsFrame, EOTFColorRange range)
 {
-	uint32_t*	nextWord;
+	uint8_t*	nextRow;
 	uint32_t	width;
 	uint32_t	height;
 	uint32_t	rowBytes;
-	std::vector<Color12BitRGB> colorBarsLine;
 
-	colorBarsFrame->GetBytes((void**)&nextWord);
+	colorBarsFrame->GetBytes((void**)&nextRow);
 	width = colorBarsFrame->GetWidth();
 	height = colorBarsFrame->GetHeight();
 	rowBytes = colorBarsFrame->GetRowBytes();
 
-	colorBarsLine.reserve(width);
+	const ColorBarsLines* lines = GetColorBarsLines(width, height, rowBytes, colorBarsFrame->GetPixelFormat(), range);
+	if (!lines)
+		return;
 
-	for (auto& iter : kColorBarPatternsNarrow)
+	for (auto& band : lines->bands)
 	{
-		uint32_t* refLine = nextWord;
-
-		// Scale pattern for UHD frame height
-		uint32_t patternHeight = std::get<kColorBarsPatternHeight>(iter) * (height / kHD1080Height);
-
-		// If 2K/4K/8K DCI mode, then pad with 40% grey bars
-		uint32_t padWidth = (width % kHD1080Width) / 2;
-		
-		for (uint32_t i = 0; i < padWidth; i++)
-			colorBarsLine.push_back(k40pcGrey[(int)range]);
-
-		std::get<kColorBarsPatternFillFunction>(iter)(range, colorBarsLine);
-		
-		for (uint32_t i = 0; i < padWidth; i++)
-			colorBarsLine.push_back(k40pcGrey[(int)range]);
-
-		for (uint32_t j = 0; j < patternHeight; j++)
+		for (uint32_t j = 0; j < band.height; j++)
 		{
-			uint8_t* lineStart = (uint8_t*)nextWord;
-
-			if (j == 0)
-			{
-				if (range == EOTFColorRange::PQFullRange)
-				{
-					// Write out data in full-range 12-bit RGB
-					for (uint32_t i = 0; i < width; i += 8)
-					{
-						// Refer to DeckLink SDK Manual, section 2.7.4 for packing structure
-						*nextWord++ = ((colorBarsLine[i].Blue & 0x0FF) << 24) | ((colorBarsLine[i].Green & 0xFFF) << 12) | (colorBarsLine[i].Red & 0xFFF);
-						*nextWord++ = ((colorBarsLine[i + 1].Blue & 0x00F) << 28) | ((colorBarsLine[i + 1].Green & 0xFFF) << 16) | ((colorBarsLine[i + 1].Red & 0xFFF) << 4) | ((colorBarsLine[i].Blue & 0xF00) >> 8);
-						*nextWord++ = ((colorBarsLine[i + 2].Green & 0xFFF) << 20) | ((colorBarsLine[i + 2].Red & 0xFFF) << 8) | ((colorBarsLine[i + 1].Blue & 0xFF0) >> 4);
-						*nextWord++ = ((colorBarsLine[i + 3].Green & 0x0FF) << 24) | ((colorBarsLine[i + 3].Red & 0xFFF) << 12) | (colorBarsLine[i + 2].Blue & 0xFFF);
-						*nextWord++ = ((colorBarsLine[i + 4].Green & 0x00F) << 28) | ((colorBarsLine[i + 4].Red & 0xFFF) << 16) | ((colorBarsLine[i + 3].Blue & 0xFFF) << 4) | ((colorBarsLine[i + 3].Green & 0xF00) >> 8);
-						*nextWord++ = ((colorBarsLine[i + 5].Red & 0xFFF) << 20) | ((colorBarsLine[i + 4].Blue & 0xFFF) << 8) | ((colorBarsLine[i + 4].Green & 0xFF0) >> 4);
-						*nextWord++ = ((colorBarsLine[i + 6].Red & 0x0FF) << 24) | ((colorBarsLine[i + 5].Blue & 0xFFF) << 12) | (colorBarsLine[i + 5].Green & 0xFFF);
-						*nextWord++ = ((colorBarsLine[i + 7].Red & 0x00F) << 28) | ((colorBarsLine[i + 6].Blue & 0xFFF) << 16) | ((colorBarsLine[i + 6].Green & 0xFFF) << 4) | ((colorBarsLine[i + 6].Red & 0xF00) >> 8);
-						*nextWord++ = ((colorBarsLine[i + 7].Blue & 0xFFF) << 20) | ((colorBarsLine[i + 7].Green & 0xFFF) << 8) | ((colorBarsLine[i + 7].Red & 0xFF0) >> 4);
-					}
-				}
-				else
-				{
-					// Write out data with video-range r210
-					for (uint32_t i = 0; i < width; i++)
-					{
-						// Refer to DeckLink SDK Manual, section 2.7.4 for packing structure
-						*nextWord++ = ((colorBarsLine[i].Blue & 0x3FC) << 22) | ((colorBarsLine[i].Green & 0x0FC) << 16) | ((colorBarsLine[i].Blue & 0xC00) << 6)
-										| ((colorBarsLine[i].Red & 0x03C) << 10) | (colorBarsLine[i].Green & 0xF00) | ((colorBarsLine[i].Red & 0xFC0) >> 6);
-					}
-				}
-			}
-			else
-			{
-				std::memcpy(nextWord, refLine, rowBytes);
-			}
-			nextWord = (uint32_t*)(lineStart + rowBytes);
+			CopyFrameRow(nextRow, band.line.data(), rowBytes);
+			nextRow += rowBytes;
 		}
-
-		colorBarsLine.clear();
 	}
+
+	FinishFrameRowCopies();
 }
 
-void FillLineBars(ColorBarsPattern& pattern, EOTFColorRange colorRange, std::vector<Color12BitRGB>& lineBuffer)
+uint32_t FillLineBars(const ColorBarsPattern& pattern, EOTFColorRange colorRange, uint32_t scale, Color12BitRGB* line)
 {
+	uint32_t column = 0;
+
 	for (auto& iter : pattern)
 	{
 		// Column widths are based on HD, scale for 4K/8K
-		uint32_t barWidth = iter.second * (lineBuffer.capacity() / kHD1080Width);
-
-		for (unsigned i = 0; i < barWidth; i++)
-		{
-			lineBuffer.push_back(iter.first[(int)colorRange]);
-		}
+		uint32_t barWidth = iter.second * scale;
 
+		std::fill_n(line + column, barWidth, iter.first[(int)colorRange]);
+		column += barWidth;
 	}
+
+	return column;
 }
 
-void FillLineRamp(ColorBarsPattern& pattern, EOTFColorRange colorRange, std::vector<Color12BitRGB>& lineBuffer)
+uint32_t FillLineRamp(const ColorBarsPattern& pattern, EOTFColorRange colorRange, uint32_t scale, Color12BitRGB* line)
 {
 	Color12BitRGB	refColor = k0pcBlack[(int)colorRange];
 	uint32_t		refColumn = 0;
+	uint32_t		column = 0;
 
 	for (auto& iter : pattern)
 	{
@@ -338,13 +534,13 @@ void FillLineRamp(ColorBarsPattern& pattern, EOTFColorRange colorRange, std::vec
 		{
 			// Store reference color
 			refColor = iter.first[(int)colorRange];
-			lineBuffer.push_back(refColor);
+			line[column++] = refColor;
 			refColumn = 0;
 		}
 		else 
 		{
 			// Column widths are based on HD, scale for 4K/8K
-			uint32_t endColumn = (iter.second + 1) * (lineBuffer.capacity() / kHD1080Width) - 1;
+			uint32_t endColumn = (iter.second + 1) * scale - 1;
 
 			if (endColumn > refColumn)
 			{
@@ -356,7 +552,7 @@ void FillLineRamp(ColorBarsPattern& pattern, EOTFColorRange colorRange, std::vec
 					rampColor.Red = refColor.Red + (i - refColumn) * (endColor.Red - refColor.Red) / (endColumn - refColumn);
 					rampColor.Green = refColor.Green + (i - refColumn) * (endColor.Green - refColor.Green) / (endColumn - refColumn);
 					rampColor.Blue = refColor.Blue + (i - refColumn) * (endColor.Blue - refColor.Blue) / (endColumn - refColumn);
-					lineBuffer.push_back(rampColor);
+					line[column++] = rampColor;
 				}
 
 				refColor = endColor;
@@ -364,4 +560,6 @@ void FillLineRamp(ColorBarsPattern& pattern, EOTFColorRange colorRange, std::vec
 			}
 		}
 	}
+
+	return column;
 }
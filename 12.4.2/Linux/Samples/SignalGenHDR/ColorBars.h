@@ -47,4 +47,6 @@
 
 enum class EOTFColorRange { HLGVideoRange = 0, PQVideoRange, PQFullRange, Size };
 
+// Fill a frame with BT.2111 color bars in 12-bit RGB (R12B, R12L) or 10-bit RGB (r210, R10b, R10l).  Each band
+// of the pattern is packed once per frame size, pixel format and EOTF range, then replicated down the frame.
 void	FillBT2111ColorBars(com_ptr<IDeckLinkMutableVideoFrame>& colorBarsFrame, EOTFColorRange range);
@@ -11,7 +11,7 @@ QT       += core gui widgets
 
 TARGET = SignalGenHDR
 TEMPLATE = app
-INCLUDEPATH = ../../include
+INCLUDEPATH = ../../include ../PixelFormats
 LIBS += -ldl
 
 # The following define makes your compiler emit warnings if you use
@@ -41,7 +41,9 @@ HEADERS += \
         DeckLinkDeviceDiscovery.h \
         DeckLinkOpenGLWidget.h \
         HDRVideoFrame.h \
-    com_ptr.h
+    com_ptr.h \
+        ../PixelFormats/PixelFormatTraits.h \
+        ../PixelFormats/FrameRowCopy.h
 
 FORMS += \
         SignalGenHDR.ui
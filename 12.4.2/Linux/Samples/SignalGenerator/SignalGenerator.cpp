@@ -43,6 +43,7 @@
 #include "DeckLinkOutputDevice.h"
 #include "DeckLinkDeviceDiscovery.h"
 #include "DeckLinkOpenGLWidget.h"
+#include "PixelFormatTraits.h"
 #include "ProfileCallback.h"
 
 #include <map>
@@ -361,8 +362,8 @@ com_ptr<IDeckLinkMutableVideoFrame> SignalGenerator::CreateOutputFrame(FillFrame
 	int										referenceBytesPerRow;
 	com_ptr<IDeckLinkVideoConversion>		frameConverter;
 
-	bytesPerRow = GetRowBytes(selectedPixelFormat, frameWidth);
-	referenceBytesPerRow = GetRowBytes(bmdFormat8BitYUV, frameWidth);
+	bytesPerRow = GetPixelFormatRowBytes(selectedPixelFormat, frameWidth);
+	referenceBytesPerRow = GetPixelFormatRowBytes(bmdFormat8BitYUV, frameWidth);
 
 	deckLinkOutput = selectedDevice->getDeviceOutput();
 
@@ -791,35 +792,6 @@ void SignalGenerator::videoFormatChanged(int videoFormatIndex)
 
 /*****************************************/
 
-int		GetRowBytes(BMDPixelFormat pixelFormat, uint32_t frameWidth)
-{
-	int bytesPerRow;
-
-	// Refer to DeckLink SDK Manual - 2.7.4 Pixel Formats
-	switch (pixelFormat)
-	{
-	case bmdFormat8BitYUV:
-		bytesPerRow = frameWidth * 2;
-		break;
-
-	case bmdFormat10BitYUV:
-		bytesPerRow = ((frameWidth + 47) / 48) * 128;
-		break;
-
-	case bmdFormat10BitRGB:
-		bytesPerRow = ((frameWidth + 63) / 64) * 256;
-		break;
-
-	case bmdFormat8BitARGB:
-	case bmdFormat8BitBGRA:
-	default:
-		bytesPerRow = frameWidth * 4;
-		break;
-	}
-
-	return bytesPerRow;
-}
-
 void	FillSine (void* audioBuffer, uint32_t samplesToWrite, uint32_t channels, uint32_t sampleDepth)
 {
 	if (sampleDepth == 16)
@@ -194,7 +194,6 @@ private:
 	com_ptr<IDeckLinkMutableVideoFrame> CreateOutputFrame(FillFrameFunction fillFrame);
 };
 
-int		GetRowBytes(BMDPixelFormat pixelFormat, uint32_t frameWidth);
 void	FillSine (void* audioBuffer, uint32_t samplesToWrite, uint32_t channels, uint32_t sampleDepth);
 void	FillColorBars (com_ptr<IDeckLinkMutableVideoFrame>& theFrame);
 void	FillBlack (com_ptr<IDeckLinkMutableVideoFrame>& theFrame);
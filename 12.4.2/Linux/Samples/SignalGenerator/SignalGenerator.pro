@@ -6,7 +6,7 @@ QT       += core gui widgets
 TARGET = SignalGenerator
 TEMPLATE = app
 CONFIG += c++11
-INCLUDEPATH = ../../include
+INCLUDEPATH = ../../include ../PixelFormats
 LIBS += -ldl
 
 # The following define makes your compiler emit warnings if you use
@@ -26,7 +26,8 @@ HEADERS 	=	SignalGenerator.h \
 				DeckLinkDeviceDiscovery.h \
 				DeckLinkOutputDevice.h \
 				DeckLinkOpenGLWidget.h \
-				ProfileCallback.h
+				ProfileCallback.h \
+				../PixelFormats/PixelFormatTraits.h
 
 SOURCES 	= 	main.cpp \
 				../../include/DeckLinkAPIDispatch.cpp \
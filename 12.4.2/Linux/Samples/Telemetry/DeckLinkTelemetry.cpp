@@ -0,0 +1,490 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+#include "DeckLinkTelemetry.h"
+
+namespace
+{
+	// Attempts to copy a stream record before it is skipped as abandoned by its publisher
+	const int kMaxReadAttempts = 1000;
+
+	void copyName(char* dest, const char* src)
+	{
+		strncpy(dest, src ? src : "", Telemetry::kMaxNameLength - 1);
+		dest[Telemetry::kMaxNameLength - 1] = '\0';
+	}
+
+	bool isTelemetrySegmentName(const char* name)
+	{
+		return strncmp(name, Telemetry::kSegmentNamePrefix, strlen(Telemetry::kSegmentNamePrefix)) == 0;
+	}
+
+	bool isProcessRunning(int32_t processID)
+	{
+		return (kill(processID, 0) == 0) || (errno != ESRCH);
+	}
+}
+
+uint64_t Telemetry::getMonotonicTime()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64_t)ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+int Telemetry::getLatencyBucket(uint64_t latency)
+{
+	const uint64_t kSubBucketCount = 1 << kLatencySubBucketBits;
+
+	// Latencies below kSubBucketCount have a bucket each
+	if (latency < kSubBucketCount)
+		return (int)latency;
+
+	int exponent = 63 - __builtin_clzll(latency);
+	int subBucket = (int)(latency >> (exponent - kLatencySubBucketBits)) & (kSubBucketCount - 1);
+	int bucket = ((exponent - kLatencySubBucketBits + 1) << kLatencySubBucketBits) + subBucket;
+	return std::min(bucket, kLatencyBucketCount - 1);
+}
+
+uint64_t Telemetry::getLatencyBucketHighestValue(int bucket)
+{
+	const int kSubBucketCount = 1 << kLatencySubBucketBits;
+
+	if (bucket < kSubBucketCount)
+		return (uint64_t)bucket;
+
+	int exponent = (bucket >> kLatencySubBucketBits) + kLatencySubBucketBits - 1;
+	uint64_t lowestValue = (uint64_t)(kSubBucketCount + (bucket & (kSubBucketCount - 1))) << (exponent - kLatencySubBucketBits);
+	return lowestValue + ((uint64_t)1 << (exponent - kLatencySubBucketBits)) - 1;
+}
+
+uint64_t Telemetry::getLatencyPercentile(const uint64_t* latencyBuckets, double percentile)
+{
+	uint64_t sampleCount = 0;
+	for (int bucket = 0; bucket < kLatencyBucketCount; bucket++)
+		sampleCount += latencyBuckets[bucket];
+
+	if (sampleCount == 0)
+		return 0;
+
+	uint64_t target = std::max<uint64_t>((uint64_t)(sampleCount * percentile / 100.0 + 0.5), 1);
+	uint64_t cumulativeCount = 0;
+	for (int bucket = 0; bucket < kLatencyBucketCount; bucket++)
+	{
+		cumulativeCount += latencyBuckets[bucket];
+		if (cumulativeCount >= target)
+			return getLatencyBucketHighestValue(bucket);
+	}
+	return getLatencyBucketHighestValue(kLatencyBucketCount - 1);
+}
+
+std::string Telemetry::fourCCToString(uint32_t fourCC)
+{
+	char str[16];
+	char chars[4] = { (char)(fourCC >> 24), (char)(fourCC >> 16), (char)(fourCC >> 8), (char)fourCC };
+
+	if (std::all_of(chars, chars + 4, [](char c) { return c >= ' ' && c <= '~'; }))
+		snprintf(str, sizeof(str), "%c%c%c%c", chars[0], chars[1], chars[2], chars[3]);
+	else
+		snprintf(str, sizeof(str), "0x%x", fourCC);
+
+	return str;
+}
+
+// TelemetryStream
+
+TelemetryStream::TelemetryStream()
+{
+	for (auto& value : m_values)
+		value.store(0, std::memory_order_relaxed);
+}
+
+void TelemetryStream::setFormat(BMDDisplayMode displayMode, BMDPixelFormat pixelFormat)
+{
+	set(Telemetry::kCounterDisplayMode, displayMode);
+	set(Telemetry::kCounterPixelFormat, pixelFormat);
+}
+
+void TelemetryStream::addLatencySample(BMDTimeValue latencyMicroseconds)
+{
+	uint64_t latency = (uint64_t)std::max<BMDTimeValue>(latencyMicroseconds, 0);
+
+	add((Telemetry::CounterID)(Telemetry::kCounterLatencyBucket0 + Telemetry::getLatencyBucket(latency)), 1);
+	add(Telemetry::kCounterLatencySum, latency);
+	add(Telemetry::kCounterLatencySampleCount, 1);
+
+	uint64_t maximum = m_values[Telemetry::kCounterLatencyMaximum].load(std::memory_order_relaxed);
+	while (latency > maximum &&
+		   !m_values[Telemetry::kCounterLatencyMaximum].compare_exchange_weak(maximum, latency, std::memory_order_relaxed))
+	{
+	}
+}
+
+void TelemetryStream::setSampler(std::function<void(TelemetryStream&)> sampler)
+{
+	std::lock_guard<std::mutex> lock(m_samplerMutex);
+	m_sampler = sampler;
+}
+
+void TelemetryStream::sample()
+{
+	std::lock_guard<std::mutex> lock(m_samplerMutex);
+	if (m_sampler)
+		m_sampler(*this);
+}
+
+// TelemetryPublisher
+
+TelemetryPublisher::TelemetryPublisher() :
+	m_segment(nullptr),
+	m_publishIntervalMs(Telemetry::kDefaultPublishIntervalMs),
+	m_stopping(false)
+{
+}
+
+TelemetryPublisher::~TelemetryPublisher()
+{
+	close();
+}
+
+bool TelemetryPublisher::open(const char* processName, uint32_t publishIntervalMs)
+{
+	if (m_segment)
+		return false;
+
+	m_segmentName = std::string("/") + Telemetry::kSegmentNamePrefix + std::to_string(getpid());
+
+	// A segment with our name was left by an earlier process with the same ID
+	shm_unlink(m_segmentName.c_str());
+
+	int fd = shm_open(m_segmentName.c_str(), O_CREAT | O_EXCL | O_RDWR, S_IRUSR | S_IWUSR | S_IRGRP | S_IROTH);
+	if (fd < 0)
+		return false;
+
+	if (ftruncate(fd, sizeof(Telemetry::Segment)) != 0)
+	{
+		::close(fd);
+		shm_unlink(m_segmentName.c_str());
+		return false;
+	}
+
+	void* mapping = mmap(nullptr, sizeof(Telemetry::Segment), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (mapping == MAP_FAILED)
+	{
+		shm_unlink(m_segmentName.c_str());
+		return false;
+	}
+
+	// The new segment is zero filled, so only the header needs to be written
+	m_segment = static_cast<Telemetry::Segment*>(mapping);
+	m_segment->version				= Telemetry::kSegmentVersion;
+	m_segment->processID			= (int32_t)getpid();
+	m_segment->publishIntervalMs	= publishIntervalMs;
+	copyName(m_segment->processName, processName);
+	m_segment->publishTime.store(Telemetry::getMonotonicTime(), std::memory_order_relaxed);
+	m_segment->magic.store(Telemetry::kSegmentMagic, std::memory_order_release);
+
+	m_publishIntervalMs = publishIntervalMs;
+	m_stopping = false;
+	m_thread = std::thread(&TelemetryPublisher::publisherThread, this);
+
+	return true;
+}
+
+void TelemetryPublisher::close()
+{
+	if (!m_segment)
+		return;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_stopCondition.notify_all();
+
+	if (m_thread.joinable())
+		m_thread.join();
+
+	munmap(m_segment, sizeof(Telemetry::Segment));
+	shm_unlink(m_segmentName.c_str());
+
+	m_segment = nullptr;
+	m_streams.clear();
+}
+
+std::shared_ptr<TelemetryStream> TelemetryPublisher::addStream(const char* deviceName, int64_t persistentID, Telemetry::StreamDirection direction)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (!m_segment || m_streams.size() >= Telemetry::kMaxStreams)
+		return std::make_shared<TelemetryStream>();
+
+	Telemetry::StreamRecord& record = m_segment->streams[m_streams.size()];
+	record.direction	= (uint32_t)direction;
+	record.persistentID	= persistentID;
+	copyName(record.deviceName, deviceName);
+
+	auto stream = std::make_shared<TelemetryStream>();
+	m_streams.push_back(stream);
+
+	// Readers may copy the record once it is counted
+	m_segment->streamCount.store((uint32_t)m_streams.size(), std::memory_order_release);
+
+	return stream;
+}
+
+std::shared_ptr<TelemetryStream> TelemetryPublisher::addStream(IDeckLink* deckLink, Telemetry::StreamDirection direction)
+{
+	const char*		displayName = nullptr;
+	std::string		deviceName = "Unknown";
+	int64_t			persistentID = 0;
+
+	if (deckLink->GetDisplayName(&displayName) == S_OK)
+	{
+		deviceName = displayName;
+		free((void*)displayName);
+	}
+
+	IDeckLinkProfileAttributes* deckLinkAttributes = nullptr;
+	if (deckLink->QueryInterface(IID_IDeckLinkProfileAttributes, (void**)&deckLinkAttributes) == S_OK)
+	{
+		if (deckLinkAttributes->GetInt(BMDDeckLinkPersistentID, &persistentID) != S_OK)
+			persistentID = 0;
+
+		deckLinkAttributes->Release();
+	}
+
+	return addStream(deviceName.c_str(), persistentID, direction);
+}
+
+void TelemetryPublisher::publisherThread()
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	while (!m_stopping)
+	{
+		m_stopCondition.wait_for(lock, std::chrono::milliseconds(m_publishIntervalMs));
+
+		// Samplers may call into the DeckLink API, so they are not called while holding the lock
+		std::vector<std::shared_ptr<TelemetryStream>> streams = m_streams;
+		lock.unlock();
+
+		for (auto& stream : streams)
+			stream->sample();
+
+		lock.lock();
+		publish();
+	}
+}
+
+void TelemetryPublisher::publish()
+{
+	// Called with m_mutex held, this thread is the only writer of the stream records
+	for (size_t index = 0; index < m_streams.size(); index++)
+	{
+		Telemetry::StreamRecord& record = m_segment->streams[index];
+		uint32_t sequence = record.sequence.load(std::memory_order_relaxed);
+
+		record.sequence.store(sequence + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		for (int id = 0; id < Telemetry::kCounterCount; id++)
+			record.values[id].store(m_streams[index]->m_values[id].load(std::memory_order_relaxed), std::memory_order_relaxed);
+
+		record.sequence.store(sequence + 2, std::memory_order_release);
+	}
+
+	m_segment->publishTime.store(Telemetry::getMonotonicTime(), std::memory_order_release);
+}
+
+// TelemetryReader
+
+TelemetryReader::~TelemetryReader()
+{
+	for (auto& mappedSegment : m_segments)
+		unmapSegment(mappedSegment);
+}
+
+void TelemetryReader::refresh()
+{
+	DIR* directory = opendir(Telemetry::kSegmentDirectory);
+	if (!directory)
+		return;
+
+	for (auto& mappedSegment : m_segments)
+		mappedSegment.seen = false;
+
+	struct dirent* entry;
+	while ((entry = readdir(directory)) != nullptr)
+	{
+		if (!isTelemetrySegmentName(entry->d_name))
+			continue;
+
+		std::string name = std::string("/") + entry->d_name;
+		auto iter = std::find_if(m_segments.begin(), m_segments.end(), [&name](const MappedSegment& mappedSegment) { return mappedSegment.name == name; });
+		if (iter != m_segments.end())
+		{
+			iter->seen = true;
+			continue;
+		}
+
+		int fd = shm_open(name.c_str(), O_RDONLY, 0);
+		if (fd < 0)
+			continue;
+
+		// Segments still being sized by their publisher are picked up on a later refresh
+		struct stat segmentStat;
+		void* mapping = MAP_FAILED;
+		if ((fstat(fd, &segmentStat) == 0) && (segmentStat.st_size >= (off_t)sizeof(Telemetry::Segment)))
+			mapping = mmap(nullptr, sizeof(Telemetry::Segment), PROT_READ, MAP_SHARED, fd, 0);
+		close(fd);
+
+		if (mapping != MAP_FAILED)
+			m_segments.push_back({ name, static_cast<const Telemetry::Segment*>(mapping), true });
+	}
+	closedir(directory);
+
+	// Segments that were removed stay mapped until now, so they are unmapped here
+	for (auto iter = m_segments.begin(); iter != m_segments.end(); )
+	{
+		if (!iter->seen)
+		{
+			unmapSegment(*iter);
+			iter = m_segments.erase(iter);
+		}
+		else
+		{
+			++iter;
+		}
+	}
+}
+
+void TelemetryReader::readStreams(std::vector<TelemetryStreamSnapshot>& streams)
+{
+	streams.clear();
+
+	for (auto& mappedSegment : m_segments)
+	{
+		const Telemetry::Segment* segment = mappedSegment.segment;
+
+		if ((segment->magic.load(std::memory_order_acquire) != Telemetry::kSegmentMagic) || (segment->version != Telemetry::kSegmentVersion))
+			continue;
+
+		bool		processRunning	= isProcessRunning(segment->processID);
+		uint64_t	publishTime		= segment->publishTime.load(std::memory_order_acquire);
+		uint32_t	streamCount		= std::min<uint32_t>(segment->streamCount.load(std::memory_order_acquire), Telemetry::kMaxStreams);
+
+		for (uint32_t index = 0; index < streamCount; index++)
+		{
+			const Telemetry::StreamRecord& record = segment->streams[index];
+			TelemetryStreamSnapshot snapshot;
+			bool consistent = false;
+
+			for (int attempt = 0; attempt < kMaxReadAttempts && !consistent; attempt++)
+			{
+				uint32_t sequence = record.sequence.load(std::memory_order_acquire);
+				if (sequence & 1)
+					continue;
+
+				for (int id = 0; id < Telemetry::kCounterCount; id++)
+					snapshot.values[id] = record.values[id].load(std::memory_order_relaxed);
+
+				std::atomic_thread_fence(std::memory_order_acquire);
+				consistent = (record.sequence.load(std::memory_order_relaxed) == sequence);
+			}
+
+			if (!consistent)
+				continue;
+
+			snapshot.processID			= segment->processID;
+			snapshot.processName		= std::string(segment->processName, strnlen(segment->processName, Telemetry::kMaxNameLength));
+			snapshot.processRunning		= processRunning;
+			snapshot.publishTime		= publishTime;
+			snapshot.publishIntervalMs	= segment->publishIntervalMs;
+			snapshot.streamIndex		= (int)index;
+			snapshot.deviceName			= std::string(record.deviceName, strnlen(record.deviceName, Telemetry::kMaxNameLength));
+			snapshot.persistentID		= record.persistentID;
+			snapshot.direction			= (Telemetry::StreamDirection)record.direction;
+			streams.push_back(std::move(snapshot));
+		}
+	}
+}
+
+int TelemetryReader::removeStaleSegments()
+{
+	int removedCount = 0;
+
+	for (auto iter = m_segments.begin(); iter != m_segments.end(); )
+	{
+		const Telemetry::Segment* segment = iter->segment;
+
+		if ((segment->magic.load(std::memory_order_acquire) == Telemetry::kSegmentMagic) && !isProcessRunning(segment->processID))
+		{
+			shm_unlink(iter->name.c_str());
+			unmapSegment(*iter);
+			iter = m_segments.erase(iter);
+			removedCount++;
+		}
+		else
+		{
+			++iter;
+		}
+	}
+
+	return removedCount;
+}
+
+void TelemetryReader::unmapSegment(MappedSegment& mappedSegment)
+{
+	munmap((void*)mappedSegment.segment, sizeof(Telemetry::Segment));
+	mappedSegment.segment = nullptr;
+}
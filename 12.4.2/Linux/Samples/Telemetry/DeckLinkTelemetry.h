@@ -0,0 +1,249 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include "DeckLinkAPI.h"
+
+// Telemetry published by capture and playout processes through POSIX shared memory, so that
+// monitors can watch many devices and processes without calling into them.  Each process owns one
+// segment, /dev/shm/decklink-telemetry.<pid>, holding a record for each stream, the input or output
+// of a device.
+//
+// Producers update process-local atomic counters, at the cost of one relaxed atomic add.  A publisher
+// thread copies the counters into the segment at a fixed interval, under a seqlock in each stream
+// record, and polls values such as IDeckLinkOutput::GetBufferedVideoFrameCount through a sampler
+// function.  Readers map segments read-only and retry any copy that a publish overlapped, so they
+// never block or slow a producer.
+namespace Telemetry
+{
+	const uint32_t		kSegmentMagic				= 0x4D544C44;		// "DLTM"
+	const uint32_t		kSegmentVersion				= 2;
+	const char* const	kSegmentDirectory			= "/dev/shm";
+	const char* const	kSegmentNamePrefix			= "decklink-telemetry.";
+	const int			kMaxStreams					= 16;
+	const int			kMaxNameLength				= 64;
+	const int			kLatencySubBucketBits		= 2;
+	const int			kLatencyMaximumBits			= 26;		// Latencies to 67 seconds
+	const int			kLatencyBucketCount			= (kLatencyMaximumBits - kLatencySubBucketBits + 1) << kLatencySubBucketBits;
+	const uint32_t		kDefaultPublishIntervalMs	= 50;
+
+	enum class StreamDirection : uint32_t
+	{
+		Capture,
+		Playback
+	};
+
+	// Values held for each stream.  Latencies in microseconds are counted in log-linear buckets, each
+	// power of two split into 2^kLatencySubBucketBits buckets, so percentiles are resolved to within
+	// 25%.  The last bucket also counts all larger latencies.
+	enum CounterID
+	{
+		kCounterFramesIn,
+		kCounterFramesOut,
+		kCounterDroppedFrames,
+		kCounterLateFrames,
+		kCounterDroppedAudioPackets,
+		kCounterBufferedVideoFrames,
+		kCounterBufferedAudioSampleFrames,
+		kCounterQueueDepth,
+		kCounterDisplayMode,
+		kCounterPixelFormat,
+		kCounterLatencySampleCount,
+		kCounterLatencySum,
+		kCounterLatencyMaximum,
+		kCounterLatencyBucket0,
+		kCounterCount = kCounterLatencyBucket0 + kLatencyBucketCount
+	};
+
+	// Shared memory layout.  Names and the stream direction are written before the record is counted
+	// in Segment::streamCount and do not change afterwards; values are only consistent when copied
+	// under the record's sequence number.
+	struct StreamRecord
+	{
+		std::atomic<uint32_t>	sequence;						// Odd while the publisher is writing values
+		uint32_t				direction;
+		int64_t					persistentID;					// BMDDeckLinkPersistentID, or 0 when unavailable
+		char					deviceName[kMaxNameLength];
+		std::atomic<uint64_t>	values[kCounterCount];
+	};
+
+	struct Segment
+	{
+		std::atomic<uint32_t>	magic;							// Set once the rest of the header is valid
+		uint32_t				version;
+		int32_t					processID;
+		uint32_t				publishIntervalMs;
+		char					processName[kMaxNameLength];
+		std::atomic<uint32_t>	streamCount;
+		std::atomic<uint64_t>	publishTime;					// Monotonic clock at the last publish, in microseconds
+		StreamRecord			streams[kMaxStreams];
+	};
+
+	// Monotonic clock, in microseconds, comparable between processes
+	uint64_t	getMonotonicTime(void);
+
+	int			getLatencyBucket(uint64_t latency);
+	uint64_t	getLatencyBucketHighestValue(int bucket);
+
+	// Highest latency of the bucket holding the given percentile of samples in the buckets
+	uint64_t	getLatencyPercentile(const uint64_t* latencyBuckets, double percentile);
+
+	// Four character code of a display mode or pixel format, or its value in hex when not printable
+	std::string	fourCCToString(uint32_t fourCC);
+};
+
+class TelemetryStream
+{
+public:
+	TelemetryStream();
+	virtual ~TelemetryStream() = default;
+
+	void	addFramesIn(uint64_t count = 1)						{ add(Telemetry::kCounterFramesIn, count); }
+	void	addFramesOut(uint64_t count = 1)					{ add(Telemetry::kCounterFramesOut, count); }
+	void	addDroppedFrames(uint64_t count = 1)				{ add(Telemetry::kCounterDroppedFrames, count); }
+	void	addLateFrames(uint64_t count = 1)					{ add(Telemetry::kCounterLateFrames, count); }
+	void	addDroppedAudioPackets(uint64_t count = 1)			{ add(Telemetry::kCounterDroppedAudioPackets, count); }
+	void	setBufferedVideoFrames(uint64_t count)				{ set(Telemetry::kCounterBufferedVideoFrames, count); }
+	void	setBufferedAudioSampleFrames(uint64_t count)		{ set(Telemetry::kCounterBufferedAudioSampleFrames, count); }
+	void	setQueueDepth(uint64_t depth)						{ set(Telemetry::kCounterQueueDepth, depth); }
+	void	setFormat(BMDDisplayMode displayMode, BMDPixelFormat pixelFormat);
+	void	addLatencySample(BMDTimeValue latencyMicroseconds);
+
+	// Called on the publisher thread before each publish, to poll values such as buffered frame
+	// counts.  Clearing the sampler waits for a call in progress, so it may then release what it used.
+	void	setSampler(std::function<void(TelemetryStream&)> sampler);
+
+private:
+	friend class TelemetryPublisher;
+
+	void	add(Telemetry::CounterID id, uint64_t count)	{ m_values[id].fetch_add(count, std::memory_order_relaxed); }
+	void	set(Telemetry::CounterID id, uint64_t value)	{ m_values[id].store(value, std::memory_order_relaxed); }
+	void	sample(void);
+
+	std::atomic<uint64_t>						m_values[Telemetry::kCounterCount];
+	std::mutex									m_samplerMutex;
+	std::function<void(TelemetryStream&)>		m_sampler;
+};
+
+// Owns the telemetry segment of this process and the thread that publishes its streams
+class TelemetryPublisher
+{
+public:
+	TelemetryPublisher();
+	virtual ~TelemetryPublisher();
+
+	bool	open(const char* processName, uint32_t publishIntervalMs = Telemetry::kDefaultPublishIntervalMs);
+	void	close(void);
+	bool	isOpen(void) const		{ return m_segment != nullptr; }
+
+	// When the segment is not open or has no free stream records, the stream is counted but not published
+	std::shared_ptr<TelemetryStream>	addStream(const char* deviceName, int64_t persistentID, Telemetry::StreamDirection direction);
+	std::shared_ptr<TelemetryStream>	addStream(IDeckLink* deckLink, Telemetry::StreamDirection direction);
+
+private:
+	void	publisherThread(void);
+	void	publish(void);
+
+	std::string										m_segmentName;
+	Telemetry::Segment*								m_segment;
+	uint32_t										m_publishIntervalMs;
+	std::vector<std::shared_ptr<TelemetryStream>>	m_streams;
+	std::mutex										m_mutex;
+	std::condition_variable							m_stopCondition;
+	bool											m_stopping;
+	std::thread										m_thread;
+};
+
+// Consistent copy of a stream record and the process that published it
+struct TelemetryStreamSnapshot
+{
+	int32_t						processID;
+	std::string					processName;
+	bool						processRunning;
+	uint64_t					publishTime;
+	uint32_t					publishIntervalMs;
+	int							streamIndex;
+	std::string					deviceName;
+	int64_t						persistentID;
+	Telemetry::StreamDirection	direction;
+	uint64_t					values[Telemetry::kCounterCount];
+};
+
+// Maps the telemetry segments of all processes read-only
+class TelemetryReader
+{
+public:
+	TelemetryReader() = default;
+	virtual ~TelemetryReader();
+
+	// Maps the segments of new processes and unmaps segments that were removed
+	void	refresh(void);
+
+	// Copies every stream; a stream being published is retried, and skipped if its publisher
+	// stopped in the middle of a publish
+	void	readStreams(std::vector<TelemetryStreamSnapshot>& streams);
+
+	// Removes segments left behind by processes that exited without closing them, returning the number removed
+	int		removeStaleSegments(void);
+
+	size_t	getSegmentCount(void) const		{ return m_segments.size(); }
+
+private:
+	struct MappedSegment
+	{
+		std::string					name;
+		const Telemetry::Segment*	segment;
+		bool						seen;
+	};
+
+	void	unmapSegment(MappedSegment& mappedSegment);
+
+	std::vector<MappedSegment>	m_segments;
+};
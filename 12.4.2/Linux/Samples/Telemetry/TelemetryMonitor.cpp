@@ -0,0 +1,232 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+#include <time.h>
+#include <unistd.h>
+#include "DeckLinkTelemetry.h"
+
+// Prints the telemetry of every capture and playout process on the system at a fixed interval.
+// The monitor only reads the processes' shared memory segments, so it can run alongside any
+// number of them without affecting their timing.
+
+// Publishes missed before a running process is reported as stalled
+const int kStalledPublishCount = 10;
+
+struct PreviousValues
+{
+	uint64_t	publishTime;
+	uint64_t	values[Telemetry::kCounterCount];
+};
+
+void printUsage(const char* programName)
+{
+	fprintf(stderr,
+		"Usage: %s [OPTIONS]\n"
+		"\n"
+		"    -i <ms>              Update interval in milliseconds (default is 1000)\n"
+		"    -n <count>           Exit after <count> updates (default is to run until interrupted)\n"
+		"    -p <pid>             Only show streams of process <pid>\n"
+		"    -c                   Remove segments left by processes that exited without removing them\n",
+		programName
+	);
+}
+
+const char* getStreamState(const TelemetryStreamSnapshot& stream, uint64_t now)
+{
+	if (!stream.processRunning)
+		return "exited";
+
+	uint64_t stalledTime = (uint64_t)stream.publishIntervalMs * 1000 * kStalledPublishCount;
+	if (now > stream.publishTime + stalledTime)
+		return "stalled";
+
+	return "running";
+}
+
+void printStream(const TelemetryStreamSnapshot& stream, const PreviousValues* previous, uint64_t now)
+{
+	bool		isCapture = (stream.direction == Telemetry::StreamDirection::Capture);
+	uint64_t	frameCount = stream.values[isCapture ? Telemetry::kCounterFramesIn : Telemetry::kCounterFramesOut];
+	char		frameRate[16] = "-";
+	char		buffered[16] = "-";
+	char		latency[32] = "-";
+
+	if (previous && stream.publishTime > previous->publishTime)
+	{
+		uint64_t previousFrameCount = previous->values[isCapture ? Telemetry::kCounterFramesIn : Telemetry::kCounterFramesOut];
+		snprintf(frameRate, sizeof(frameRate), "%.2f", (double)(frameCount - previousFrameCount) * 1000000.0 / (stream.publishTime - previous->publishTime));
+	}
+
+	if (!isCapture)
+		snprintf(buffered, sizeof(buffered), "%llu", (unsigned long long)stream.values[Telemetry::kCounterBufferedVideoFrames]);
+
+	// Percentiles of the latencies added since the previous update, or since the stream started
+	uint64_t latencyBuckets[Telemetry::kLatencyBucketCount];
+	for (int bucket = 0; bucket < Telemetry::kLatencyBucketCount; bucket++)
+	{
+		latencyBuckets[bucket] = stream.values[Telemetry::kCounterLatencyBucket0 + bucket];
+		if (previous)
+			latencyBuckets[bucket] -= previous->values[Telemetry::kCounterLatencyBucket0 + bucket];
+	}
+
+	uint64_t latencySampleCount = stream.values[Telemetry::kCounterLatencySampleCount] - (previous ? previous->values[Telemetry::kCounterLatencySampleCount] : 0);
+	if (latencySampleCount > 0)
+	{
+		snprintf(latency, sizeof(latency), "%.2f / %.2f / %.2f",
+				 (double)Telemetry::getLatencyPercentile(latencyBuckets, 50.0) / 1000.0,
+				 (double)Telemetry::getLatencyPercentile(latencyBuckets, 99.0) / 1000.0,
+				 (double)stream.values[Telemetry::kCounterLatencyMaximum] / 1000.0);
+	}
+
+	printf("%-7d %-18.18s %-28.28s %-8s %-8s %-4s %-6s %9s %9llu %9llu %9llu %8s %6llu  %s\n",
+		   stream.processID,
+		   stream.processName.c_str(),
+		   stream.deviceName.c_str(),
+		   isCapture ? "capture" : "playback",
+		   getStreamState(stream, now),
+		   Telemetry::fourCCToString((uint32_t)stream.values[Telemetry::kCounterDisplayMode]).c_str(),
+		   Telemetry::fourCCToString((uint32_t)stream.values[Telemetry::kCounterPixelFormat]).c_str(),
+		   frameRate,
+		   (unsigned long long)stream.values[Telemetry::kCounterDroppedFrames],
+		   (unsigned long long)stream.values[Telemetry::kCounterLateFrames],
+		   (unsigned long long)stream.values[Telemetry::kCounterDroppedAudioPackets],
+		   buffered,
+		   (unsigned long long)stream.values[Telemetry::kCounterQueueDepth],
+		   latency);
+}
+
+int main(int argc, char* argv[])
+{
+	long		intervalMs = 1000;
+	long		updateCount = 0;
+	int32_t		processID = 0;
+	bool		removeStale = false;
+	int			ch;
+
+	while ((ch = getopt(argc, argv, "i:n:p:ch?")) != -1)
+	{
+		switch (ch)
+		{
+			case 'i':
+				intervalMs = std::max(atol(optarg), 1L);
+				break;
+
+			case 'n':
+				updateCount = atol(optarg);
+				break;
+
+			case 'p':
+				processID = (int32_t)atol(optarg);
+				break;
+
+			case 'c':
+				removeStale = true;
+				break;
+
+			default:
+				printUsage(argv[0]);
+				return (ch == 'h') ? EXIT_SUCCESS : EXIT_FAILURE;
+		}
+	}
+
+	TelemetryReader									reader;
+	std::vector<TelemetryStreamSnapshot>			streams;
+	std::map<std::pair<int32_t, int>, PreviousValues>	previousValues;
+
+	for (long update = 0; updateCount <= 0 || update < updateCount; update++)
+	{
+		if (update > 0)
+			std::this_thread::sleep_for(std::chrono::milliseconds(intervalMs));
+
+		auto readStart = std::chrono::steady_clock::now();
+
+		reader.refresh();
+		if (removeStale)
+		{
+			int removedCount = reader.removeStaleSegments();
+			if (removedCount > 0)
+				fprintf(stderr, "Removed %d stale telemetry segments\n", removedCount);
+		}
+		reader.readStreams(streams);
+
+		double readTimeMs = std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - readStart).count();
+		uint64_t now = Telemetry::getMonotonicTime();
+
+		time_t wallTime = time(nullptr);
+		char timeString[32];
+		strftime(timeString, sizeof(timeString), "%H:%M:%S", localtime(&wallTime));
+
+		printf("%s  %zu processes, %zu streams, read in %.3f ms\n", timeString, reader.getSegmentCount(), streams.size(), readTimeMs);
+		printf("%-7s %-18s %-28s %-8s %-8s %-4s %-6s %9s %9s %9s %9s %8s %6s  %s\n",
+			   "PID", "PROCESS", "DEVICE", "STREAM", "STATE", "MODE", "FORMAT", "FRAMES/s", "DROPPED", "LATE", "AUDIODROP", "BUFFERED", "QUEUE", "LATENCY p50/p99/max (ms)");
+
+		std::map<std::pair<int32_t, int>, PreviousValues> currentValues;
+		for (auto& stream : streams)
+		{
+			if (processID != 0 && stream.processID != processID)
+				continue;
+
+			auto key = std::make_pair(stream.processID, stream.streamIndex);
+			auto iter = previousValues.find(key);
+
+			printStream(stream, (iter != previousValues.end()) ? &iter->second : nullptr, now);
+
+			PreviousValues& values = currentValues[key];
+			values.publishTime = stream.publishTime;
+			memcpy(values.values, stream.values, sizeof(values.values));
+		}
+		previousValues.swap(currentValues);
+
+		printf("\n");
+		fflush(stdout);
+	}
+
+	return EXIT_SUCCESS;
+}
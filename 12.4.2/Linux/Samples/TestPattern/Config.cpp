@@ -53,6 +53,8 @@ BMDConfig::BMDConfig() :
 	m_outputFlags(bmdVideoOutputFlagDefault),
 	m_pixelFormat(bmdFormat8BitYUV),
 	m_output444(false),
+	m_patternFrameCount(0),
+	m_watermark(false),
 	m_deckLinkName(),
 	m_displayModeName()
 {
@@ -72,7 +74,7 @@ bool BMDConfig::ParseArguments(int argc,  char** argv)
 	int		ch;
 	bool	displayHelp = false;
 
-	while ((ch = getopt(argc, argv, "d:?h3c:s:f:a:m:n:p:t:")) != -1)
+	while ((ch = getopt(argc, argv, "d:?h3c:s:f:a:m:n:p:t:w")) != -1)
 	{
 		switch (ch)
 		{
@@ -110,12 +112,27 @@ bool BMDConfig::ParseArguments(int argc,  char** argv)
 					case 0: m_pixelFormat = bmdFormat8BitYUV;  m_output444 = false; break;
 					case 1: m_pixelFormat = bmdFormat10BitYUV; m_output444 = false; break;
 					case 2: m_pixelFormat = bmdFormat10BitRGB; m_output444 = true;  break;
+					case 3: m_pixelFormat = bmdFormat12BitRGB; m_output444 = true;  break;
+					case 4: m_pixelFormat = bmdFormat8BitBGRA; m_output444 = true;  break;
 					default:
 						fprintf(stderr, "Invalid argument: Pixel format %d is not valid", atoi(optarg));
 						return false;
 				}
 				break;
 
+			case 'n':
+				m_patternFrameCount = atoi(optarg);
+				if (m_patternFrameCount <= 0)
+				{
+					fprintf(stderr, "Invalid argument: Pattern frame count must be greater than 0\n");
+					return false;
+				}
+				break;
+
+			case 'w':
+				m_watermark = true;
+				break;
+
 			case '3':
 				m_outputFlags |= bmdVideoOutputDualStream3D;
 				break;
@@ -141,6 +158,18 @@ bool BMDConfig::ParseArguments(int argc,  char** argv)
 	if (displayHelp)
 		DisplayUsage(0);
 
+	if (m_patternFrameCount > 0 && (m_outputFlags & bmdVideoOutputDualStream3D))
+	{
+		fprintf(stderr, "Moving pattern playback is not supported with 3D\n");
+		return false;
+	}
+
+	if (m_watermark && m_patternFrameCount <= 0)
+	{
+		fprintf(stderr, "Watermarking requires moving pattern playback (-n)\n");
+		return false;
+	}
+
 	// Get device and display mode names
 	IDeckLink *deckLink = GetDeckLink(m_deckLinkIndex);
 	if (deckLink != NULL)
@@ -340,9 +369,14 @@ bail:
 		"         0:  8 bit YUV (4:2:2) (default)\n"
 		"         1:  10 bit YUV (4:2:2)\n"
 		"         2:  10 bit RGB (4:4:4)\n"
+		"         3:  12 bit RGB (4:4:4)\n"
+		"         4:  8 bit BGRA (4:4:4)\n"
 		"    -c <channels>        Audio Channels (2, 8 or 16 - default is 2)\n"
 		"    -s <depth>           Audio Sample Depth (16 or 32 - default is 16)\n"
 		"    -3                   Playback Stereoscopic 3D (Requires 3D Hardware support)\n"
+		"    -n <frames>          Playback a moving pattern of <frames> distinct frames, rendered before playout\n"
+		"    -w                   Stamp a frame counter, payload CRC and send time watermark into each frame of\n"
+		"                         the moving pattern, to be checked by Capture or InputLoopThrough -w\n"
 		"\n"
 		"Output a test pattern eg:\n"
 		"\n"
@@ -379,6 +413,9 @@ void BMDConfig::DisplayConfiguration()
 		m_audioChannels,
 		m_audioSampleDepth
 	);
+
+	if (m_patternFrameCount > 0)
+		fprintf(stderr, " - Moving pattern: %d frames%s\n", m_patternFrameCount, m_watermark ? ", watermarked" : "");
 }
 
 const char* BMDConfig::GetPixelFormatName(BMDPixelFormat pixelFormat)
@@ -391,6 +428,10 @@ const char* BMDConfig::GetPixelFormatName(BMDPixelFormat pixelFormat)
 			return "10 bit YUV (4:2:2)";
 		case bmdFormat10BitRGB:
 			return "10 bit RGB (4:4:4)";
+		case bmdFormat12BitRGB:
+			return "12 bit RGB (4:4:4)";
+		case bmdFormat8BitBGRA:
+			return "8 bit BGRA (4:4:4)";
 	}
 	return "unknown";
 }
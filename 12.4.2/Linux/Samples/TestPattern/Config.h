@@ -62,6 +62,8 @@ public:
 	BMDVideoOutputFlags		m_outputFlags;
 	BMDPixelFormat			m_pixelFormat;
 	bool					m_output444;
+	int						m_patternFrameCount;
+	bool					m_watermark;
 
 	const char*				m_videoOutputFile;
 	const char*				m_audioOutputFile;
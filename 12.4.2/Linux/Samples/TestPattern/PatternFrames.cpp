@@ -0,0 +1,345 @@
+/* -LICENSE-START-
+** Copyright (c) 2018 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+#include <math.h>
+#include <stdio.h>
+#include <string.h>
+#include <algorithm>
+#include <atomic>
+#include <thread>
+#include <vector>
+
+#include "FrameRowCopy.h"
+#include "PatternFrames.h"
+#include "PatternLines.h"
+
+namespace
+{
+	// Rows rendered by a worker at a time
+	const long		kRowsPerTask = 64;
+
+	// Zone plate phase is looked up in a table of one cycle
+	const int		kZonePlatePhaseBits = 10;
+	const uint32_t	kZonePlatePhaseSteps = 1 << kZonePlatePhaseBits;
+
+	// Segments of each digit, bit 0 to 6 are segments a to g
+	const uint8_t	kDigitSegments[10] = { 0x3F, 0x06, 0x5B, 0x4F, 0x66, 0x6D, 0x7D, 0x07, 0x7F, 0x6F };
+
+	PatternColour GreyColour(uint8_t level)
+	{
+		PatternColour colour;
+		colour.y		= (uint8_t)(16 + ((uint32_t)level * 219 + 127) / 255);
+		colour.cb		= 0x80;
+		colour.cr		= 0x80;
+		colour.red		= level;
+		colour.green	= level;
+		colour.blue		= level;
+		return colour;
+	}
+
+	// Layout shared by every frame of the pool
+	struct FrameLayout
+	{
+		BMDPixelFormat				pixelFormat;
+		long						width;
+		long						height;
+		long						rowBytes;
+		uint32_t					frameCount;
+
+		long						barsEnd;
+		long						zonePlateEnd;
+		long						zonePlateCentreX;
+		long						zonePlateCentreY;
+		uint64_t					zonePlateScale;
+
+		long						counterTop;
+		long						counterLeft;
+		long						digitWidth;
+		long						digitHeight;
+		long						digitPitch;
+		long						segmentThickness;
+		int							digitCount;
+
+		std::vector<PatternColour>	zonePlateColours;
+	};
+
+	FrameLayout MakeLayout(long width, long height, long rowBytes, BMDPixelFormat pixelFormat, uint32_t frameCount)
+	{
+		FrameLayout layout;
+
+		layout.pixelFormat		= pixelFormat;
+		layout.width			= width;
+		layout.height			= height;
+		layout.rowBytes			= rowBytes;
+		layout.frameCount		= frameCount;
+
+		// Bars in the top third, the zone plate down to the last sixth and the counter below it
+		layout.barsEnd			= height / 3;
+		layout.zonePlateEnd		= (height * 5) / 6;
+
+		// The rings reach the Nyquist frequency at the corners of the zone plate, for a phase of
+		// pi * r^2 / (2 * radius) radians
+		layout.zonePlateCentreX	= width / 2;
+		layout.zonePlateCentreY	= (layout.barsEnd + layout.zonePlateEnd) / 2;
+
+		long radius = std::max(1L, lround(hypot(layout.zonePlateCentreX, layout.zonePlateEnd - layout.zonePlateCentreY)));
+		layout.zonePlateScale	= ((uint64_t)(kZonePlatePhaseSteps / 4) << 16) / radius;
+
+		layout.zonePlateColours.resize(kZonePlatePhaseSteps);
+		for (uint32_t i = 0; i < kZonePlatePhaseSteps; i++)
+		{
+			double level = 127.5 + 127.5 * cos((2.0 * M_PI * i) / kZonePlatePhaseSteps);
+			layout.zonePlateColours[i] = GreyColour((uint8_t)lround(level));
+		}
+
+		// Enough digits for the last frame number, centred in the counter band
+		layout.digitCount = 1;
+		for (uint32_t n = frameCount - 1; n >= 10; n /= 10)
+			layout.digitCount++;
+
+		long bandHeight				= height - layout.zonePlateEnd;
+		layout.digitHeight			= (bandHeight * 3) / 4;
+		layout.digitWidth			= layout.digitHeight / 2;
+		layout.digitPitch			= layout.digitWidth + layout.digitWidth / 2;
+		layout.segmentThickness		= std::max(1L, layout.digitHeight / 10);
+		layout.counterTop			= layout.zonePlateEnd + (bandHeight - layout.digitHeight) / 2;
+		layout.counterLeft			= (width - (layout.digitPitch * (layout.digitCount - 1) + layout.digitWidth)) / 2;
+
+		return layout;
+	}
+
+	void RenderBarsLine(const FrameLayout& layout, uint32_t frameIndex, PatternColour* colours)
+	{
+		// Keep the offset even so that 4:2:2 chroma never straddles a bar edge
+		long offset = (long)(((uint64_t)frameIndex * layout.width) / layout.frameCount) & ~1L;
+
+		for (long x = 0; x < layout.width; x++)
+		{
+			long pairStart = ((x & ~1L) + offset) % layout.width;
+			colours[x] = kColourBars[(pairStart * 8) / layout.width];
+		}
+	}
+
+	void RenderZonePlateLine(const FrameLayout& layout, uint32_t frameIndex, long y, PatternColour* colours)
+	{
+		// Rings move outwards by one cycle over the pool
+		uint32_t	phase = (uint32_t)(((uint64_t)frameIndex * kZonePlatePhaseSteps) / layout.frameCount);
+		long		dy = y - layout.zonePlateCentreY;
+		uint64_t	dy2 = (uint64_t)(dy * dy);
+
+		for (long x = 0; x < layout.width; x++)
+		{
+			long		dx = x - layout.zonePlateCentreX;
+			uint64_t	r2 = (uint64_t)(dx * dx) + dy2;
+			uint32_t	index = ((uint32_t)((r2 * layout.zonePlateScale) >> 16) - phase) & (kZonePlatePhaseSteps - 1);
+			colours[x] = layout.zonePlateColours[index];
+		}
+	}
+
+	bool SegmentLit(uint8_t segments, const FrameLayout& layout, long x, long y)
+	{
+		long	thickness = layout.segmentThickness;
+		long	middle = layout.digitHeight / 2;
+		bool	left = x < thickness;
+		bool	right = x >= layout.digitWidth - thickness;
+		bool	upper = y < middle;
+
+		if ((segments & 0x01) && y < thickness)										return true;	// a
+		if ((segments & 0x02) && right && upper)									return true;	// b
+		if ((segments & 0x04) && right && !upper)									return true;	// c
+		if ((segments & 0x08) && y >= layout.digitHeight - thickness)				return true;	// d
+		if ((segments & 0x10) && left && !upper)									return true;	// e
+		if ((segments & 0x20) && left && upper)										return true;	// f
+		if ((segments & 0x40) && y >= middle - thickness / 2 && y < middle + (thickness + 1) / 2)	return true;	// g
+		return false;
+	}
+
+	void RenderCounterLine(const FrameLayout& layout, uint32_t frameIndex, long y, PatternColour* colours)
+	{
+		const PatternColour&	black = kColourBars[7];
+		const PatternColour&	white = kColourBars[0];
+		long					digitY = y - layout.counterTop;
+
+		std::fill(colours, colours + layout.width, black);
+
+		if (digitY < 0 || digitY >= layout.digitHeight)
+			return;
+
+		uint32_t value = frameIndex;
+		for (int digit = layout.digitCount - 1; digit >= 0; digit--, value /= 10)
+		{
+			uint8_t	segments = kDigitSegments[value % 10];
+			long	left = layout.counterLeft + digit * layout.digitPitch;
+
+			for (long x = 0; x < layout.digitWidth; x++)
+			{
+				if (left + x >= 0 && left + x < layout.width && SegmentLit(segments, layout, x, digitY))
+					colours[left + x] = white;
+			}
+		}
+	}
+
+	// Render a run of rows of one frame
+	void RenderRows(const FrameLayout& layout, uint32_t frameIndex, uint8_t* frameBytes, long firstRow, long lastRow,
+					std::vector<PatternColour>& colours, std::vector<uint8_t>& line)
+	{
+		bool barsPacked = false;
+
+		for (long y = firstRow; y < lastRow; y++)
+		{
+			if (y < layout.barsEnd)
+			{
+				// Bar rows are all the same, pack the line once
+				if (!barsPacked)
+				{
+					RenderBarsLine(layout, frameIndex, colours.data());
+					PackPatternLine(layout.pixelFormat, colours.data(), layout.width, line.data());
+					barsPacked = true;
+				}
+			}
+			else
+			{
+				if (y < layout.zonePlateEnd)
+					RenderZonePlateLine(layout, frameIndex, y, colours.data());
+				else
+					RenderCounterLine(layout, frameIndex, y, colours.data());
+
+				PackPatternLine(layout.pixelFormat, colours.data(), layout.width, line.data());
+			}
+
+			CopyFrameRow(frameBytes + y * layout.rowBytes, line.data(), layout.rowBytes);
+		}
+
+		FinishFrameRowCopies();
+	}
+}
+
+PatternFramePool::PatternFramePool()
+{
+}
+
+PatternFramePool::~PatternFramePool()
+{
+	Clear();
+}
+
+HRESULT PatternFramePool::Render(IDeckLinkOutput* output, long width, long height, long rowBytes, BMDPixelFormat pixelFormat, uint32_t frameCount)
+{
+	HRESULT						result = E_INVALIDARG;
+	std::vector<uint8_t*>		frameBytes;
+	std::vector<std::thread>	workers;
+	std::atomic<long>			nextTask(0);
+	unsigned					workerCount;
+	long						tasksPerFrame;
+	long						taskCount;
+
+	Clear();
+
+	if (frameCount == 0 || !IsNativePatternFormat(pixelFormat))
+		goto bail;
+
+	// Allocate every frame up front, so that the workers only ever touch frame memory
+	for (uint32_t i = 0; i < frameCount; i++)
+	{
+		IDeckLinkMutableVideoFrame*	frame = NULL;
+		uint8_t*					bytes;
+
+		result = output->CreateVideoFrame(width, height, rowBytes, pixelFormat, bmdFrameFlagDefault, &frame);
+		if (result != S_OK)
+		{
+			fprintf(stderr, "Failed to create video frame %u of %u\n", i, frameCount);
+			goto bail;
+		}
+
+		m_frames.push_back(frame);
+
+		result = frame->GetBytes((void**)&bytes);
+		if (result != S_OK)
+			goto bail;
+
+		frameBytes.push_back(bytes);
+	}
+
+	{
+		const FrameLayout layout = MakeLayout(width, height, rowBytes, pixelFormat, frameCount);
+
+		// Work is handed out in bands of rows, so that short pools still use every worker
+		tasksPerFrame	= (height + kRowsPerTask - 1) / kRowsPerTask;
+		taskCount		= tasksPerFrame * frameCount;
+		workerCount		= std::max(1U, std::thread::hardware_concurrency());
+		workerCount		= (unsigned)std::min<long>(workerCount, taskCount);
+
+		for (unsigned i = 0; i < workerCount; i++)
+		{
+			workers.emplace_back([&]()
+			{
+				// Emitters write whole pixel groups, allow for the last group extending past the row
+				std::vector<PatternColour>	colours(width);
+				std::vector<uint8_t>		line(rowBytes + 64);
+
+				for (long task = nextTask++; task < taskCount; task = nextTask++)
+				{
+					uint32_t	frameIndex = (uint32_t)(task / tasksPerFrame);
+					long		firstRow = (task % tasksPerFrame) * kRowsPerTask;
+					long		lastRow = std::min(height, firstRow + kRowsPerTask);
+
+					RenderRows(layout, frameIndex, frameBytes[frameIndex], firstRow, lastRow, colours, line);
+				}
+			});
+		}
+
+		for (std::thread& worker : workers)
+			worker.join();
+	}
+
+	result = S_OK;
+
+bail:
+	if (result != S_OK)
+		Clear();
+
+	return result;
+}
+
+void PatternFramePool::Clear()
+{
+	for (IDeckLinkMutableVideoFrame* frame : m_frames)
+		frame->Release();
+	m_frames.clear();
+}
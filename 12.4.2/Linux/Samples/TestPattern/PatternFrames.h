@@ -0,0 +1,69 @@
+/* -LICENSE-START-
+** Copyright (c) 2018 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+#include "DeckLinkAPI.h"
+
+// A pool of distinct frames for sustained playout, so that every scheduled frame is read from different
+// memory as it would be for real content.  Each frame has colour bars scrolling across the top, a zone
+// plate with rings moving outwards and a frame counter.  Over the length of the pool the bars scroll one
+// full frame width and the rings move one full cycle, so playing the pool in a loop has no visible jump.
+//
+// Frames are rendered before playout on a pool of worker threads, then recycled in order as they complete,
+// so nothing is ever rendered on the scheduling path.
+class PatternFramePool
+{
+public:
+	PatternFramePool();
+	~PatternFramePool();
+
+	// Create frameCount frames on the output and render them in a native pattern format
+	HRESULT					Render(IDeckLinkOutput* output, long width, long height, long rowBytes, BMDPixelFormat pixelFormat, uint32_t frameCount);
+	void					Clear();
+
+	uint32_t				GetFrameCount() const					{ return (uint32_t)m_frames.size(); }
+	// Frame to output for a stream frame number.  The pool keeps its reference.
+	IDeckLinkVideoFrame*	GetFrame(uint64_t frameNumber) const	{ return m_frames[frameNumber % m_frames.size()]; }
+
+private:
+	std::vector<IDeckLinkMutableVideoFrame*>	m_frames;
+};
@@ -0,0 +1,316 @@
+/* -LICENSE-START-
+** Copyright (c) 2018 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include <stdint.h>
+#include <string.h>
+#include <algorithm>
+#include <memory>
+#include <mutex>
+#include <type_traits>
+#include <vector>
+
+#include "FrameRowCopy.h"
+#include "PatternLines.h"
+#include "PixelFormatTraits.h"
+
+const PatternColour kColourBars[8] =
+{
+	{ 0xEA, 0x80, 0x80, 255, 255, 255 },
+	{ 0xD2, 0x10, 0x92, 255, 255,   0 },
+	{ 0xA9, 0xA5, 0x10,   0, 255, 255 },
+	{ 0x90, 0x35, 0x22,   0, 255,   0 },
+	{ 0x6A, 0xCA, 0xDD, 255,   0, 255 },
+	{ 0x51, 0x5A, 0xEF, 255,   0,   0 },
+	{ 0x28, 0xEF, 0x6D,   0,   0, 255 },
+	{ 0x10, 0x80, 0x80,   0,   0,   0 },
+};
+
+namespace
+{
+	const uint8_t kBlackColourIndex = 7;
+
+	// A pattern line packed in an output pixel format, including any padding at the end of the row
+	struct PatternLine
+	{
+		PatternType				pattern;
+		BMDPixelFormat			pixelFormat;
+		long					width;
+		long					rowBytes;
+		std::vector<uint8_t>	bytes;
+	};
+
+	std::mutex									gPatternLineMutex;
+	std::vector<std::unique_ptr<PatternLine>>	gPatternLines;
+
+	// Component range conversions from 8-bit full range
+	inline uint32_t ToVideo10RGB(uint8_t v)		{ return 64 + ((uint32_t)v * 876 + 127) / 255; }
+	inline uint32_t ToFull12(uint8_t v)			{ return ((uint32_t)v << 4) | (v >> 4); }
+
+	// Colour of each pixel of the pattern.  Bars are assigned to pixel pairs so that 4:2:2 chroma never
+	// straddles a bar edge.
+	std::vector<PatternColour> PatternColours(PatternType pattern, long width)
+	{
+		std::vector<PatternColour> colours(width, kColourBars[kBlackColourIndex]);
+
+		if (pattern == kPatternBlack)
+			return colours;
+
+		for (long x = 0; x < width; x++)
+		{
+			long pairStart = x & ~1L;
+			if (pattern == kPatternReverseColourBars)
+				pairStart = width - 2 - pairStart;
+			colours[x] = kColourBars[(pairStart * 8) / width];
+		}
+
+		return colours;
+	}
+
+	// Each packed format is written a block of pixels at a time by the BlockEmitter of the format, with
+	// the block layout and byte order of the format as constants
+	template <BMDPixelFormat Format>
+	struct BlockEmitter;
+
+	template <>
+	struct BlockEmitter<bmdFormat8BitYUV>
+	{
+		static void Emit(const PatternColour* colours, uint8_t* block)
+		{
+			block[0] = colours[0].cb;
+			block[1] = colours[0].y;
+			block[2] = colours[0].cr;
+			block[3] = colours[1].y;
+		}
+	};
+
+	template <>
+	struct BlockEmitter<bmdFormat10BitYUV>
+	{
+		static void Emit(const PatternColour* colours, uint8_t* block)
+		{
+			const PixelByteOrder kByteOrder = PixelFormatTraits<bmdFormat10BitYUV>::kByteOrder;
+			uint32_t y[6];
+			uint32_t cb[3];
+			uint32_t cr[3];
+
+			for (int i = 0; i < 6; i++)
+				y[i] = (uint32_t)colours[i].y << 2;
+
+			for (int i = 0; i < 3; i++)
+			{
+				cb[i] = (uint32_t)colours[i * 2].cb << 2;
+				cr[i] = (uint32_t)colours[i * 2].cr << 2;
+			}
+
+			StorePixelWord<kByteOrder>(block,		cb[0] | (y[0] << 10) | (cr[0] << 20));
+			StorePixelWord<kByteOrder>(block + 4,	y[1] | (cb[1] << 10) | (y[2] << 20));
+			StorePixelWord<kByteOrder>(block + 8,	cr[1] | (y[3] << 10) | (cb[2] << 20));
+			StorePixelWord<kByteOrder>(block + 12,	y[4] | (cr[2] << 10) | (y[5] << 20));
+		}
+	};
+
+	// 8-bit RGB with the byte offset of each component
+	template <int Alpha, int Red, int Green, int Blue>
+	struct RGB8BlockEmitter
+	{
+		static void Emit(const PatternColour* colours, uint8_t* block)
+		{
+			block[Alpha]	= 255;
+			block[Red]		= colours[0].red;
+			block[Green]	= colours[0].green;
+			block[Blue]		= colours[0].blue;
+		}
+	};
+
+	template <> struct BlockEmitter<bmdFormat8BitARGB> : RGB8BlockEmitter<0, 1, 2, 3> { };
+	template <> struct BlockEmitter<bmdFormat8BitBGRA> : RGB8BlockEmitter<3, 2, 1, 0> { };
+
+	// 10-bit RGB, one pixel per 32-bit word with blue in the bits from Shift
+	template <BMDPixelFormat Format, int Shift>
+	struct RGB10BlockEmitter
+	{
+		static void Emit(const PatternColour* colours, uint8_t* block)
+		{
+			uint32_t word = (ToVideo10RGB(colours[0].red) << 20) | (ToVideo10RGB(colours[0].green) << 10) | ToVideo10RGB(colours[0].blue);
+			StorePixelWord<PixelFormatTraits<Format>::kByteOrder>(block, word << Shift);
+		}
+	};
+
+	template <> struct BlockEmitter<bmdFormat10BitRGB> : RGB10BlockEmitter<bmdFormat10BitRGB, 0> { };
+	template <> struct BlockEmitter<bmdFormat10BitRGBXLE> : RGB10BlockEmitter<bmdFormat10BitRGBXLE, 2> { };
+	template <> struct BlockEmitter<bmdFormat10BitRGBX> : RGB10BlockEmitter<bmdFormat10BitRGBX, 2> { };
+
+	// 12-bit RGB is a little-endian bit stream of R, G, B components, 8 pixels in 9 words.  The
+	// big-endian variant stores each 32-bit word byte swapped.
+	template <BMDPixelFormat Format>
+	struct RGB12BlockEmitter
+	{
+		static void Emit(const PatternColour* colours, uint8_t* block)
+		{
+			uint64_t components[25];
+
+			for (int i = 0; i < 8; i++)
+			{
+				components[i * 3]		= ToFull12(colours[i].red);
+				components[i * 3 + 1]	= ToFull12(colours[i].green);
+				components[i * 3 + 2]	= ToFull12(colours[i].blue);
+			}
+			components[24] = 0;
+
+			for (int i = 0; i < 9; i++)
+			{
+				const int first = (i * 32) / 12;
+				uint64_t run = components[first] | (components[first + 1] << 12) | (components[first + 2] << 24) | (components[first + 3] << 36);
+				StorePixelWord<PixelFormatTraits<Format>::kByteOrder>(block + i * 4, (uint32_t)(run >> ((i * 32) % 12)));
+			}
+		}
+	};
+
+	template <> struct BlockEmitter<bmdFormat12BitRGB> : RGB12BlockEmitter<bmdFormat12BitRGB> { };
+	template <> struct BlockEmitter<bmdFormat12BitRGBLE> : RGB12BlockEmitter<bmdFormat12BitRGBLE> { };
+
+	// Pixel groups are written whole, so the last group repeats the final pixel of the line
+	template <typename Traits>
+	void EmitLine(const PatternColour* colours, uint8_t* line, long width)
+	{
+		const long blocks		= width / Traits::kBlockPixels;
+		const long remainder	= width % Traits::kBlockPixels;
+
+		for (long block = 0; block < blocks; block++, colours += Traits::kBlockPixels, line += Traits::kBlockBytes)
+			BlockEmitter<Traits::kPixelFormat>::Emit(colours, line);
+
+		if (remainder > 0)
+		{
+			PatternColour lastBlock[Traits::kBlockPixels];
+			std::fill(std::copy(colours, colours + remainder, lastBlock), lastBlock + Traits::kBlockPixels, colours[remainder - 1]);
+			BlockEmitter<Traits::kPixelFormat>::Emit(lastBlock, line);
+		}
+	}
+
+	typedef void (*LineEmitter)(const PatternColour* colours, uint8_t* line, long width);
+
+	template <typename Traits>
+	LineEmitter GetLineEmitter(std::true_type)
+	{
+		return &EmitLine<Traits>;
+	}
+
+	template <typename Traits>
+	LineEmitter GetLineEmitter(std::false_type)
+	{
+		return NULL;
+	}
+
+	// Line emitter instantiated for each packed format, compressed formats have none
+	struct LineEmitterVisitor
+	{
+		template <typename Traits>
+		LineEmitter operator()(Traits) const
+		{
+			return GetLineEmitter<Traits>(std::integral_constant<bool, Traits::kPacked>());
+		}
+	};
+
+	const PatternLine* GetPatternLine(PatternType pattern, BMDPixelFormat pixelFormat, long width, long rowBytes)
+	{
+		std::lock_guard<std::mutex> lock(gPatternLineMutex);
+
+		for (const std::unique_ptr<PatternLine>& line : gPatternLines)
+		{
+			if (line->pattern == pattern && line->pixelFormat == pixelFormat && line->width == width && line->rowBytes == rowBytes)
+				return line.get();
+		}
+
+		std::unique_ptr<PatternLine> line(new PatternLine());
+		line->pattern		= pattern;
+		line->pixelFormat	= pixelFormat;
+		line->width			= width;
+		line->rowBytes		= rowBytes;
+
+		// Emitters write whole pixel groups, allow for the last group extending past the row
+		line->bytes.assign(rowBytes + 64, 0);
+
+		std::vector<PatternColour> colours = PatternColours(pattern, width);
+
+		if (!PackPatternLine(pixelFormat, colours.data(), width, line->bytes.data()))
+			return NULL;
+
+		line->bytes.resize(rowBytes);
+
+		gPatternLines.push_back(std::move(line));
+		return gPatternLines.back().get();
+	}
+}
+
+bool IsNativePatternFormat(BMDPixelFormat pixelFormat)
+{
+	return DispatchPixelFormat(pixelFormat, LineEmitterVisitor()) != NULL;
+}
+
+bool PackPatternLine(BMDPixelFormat pixelFormat, const PatternColour* colours, long width, uint8_t* line)
+{
+	LineEmitter emitLine = DispatchPixelFormat(pixelFormat, LineEmitterVisitor());
+	if (!emitLine)
+		return false;
+
+	emitLine(colours, line, width);
+	return true;
+}
+
+bool FillPattern(IDeckLinkVideoFrame* frame, PatternType pattern)
+{
+	uint8_t*	bytes;
+	long		height = frame->GetHeight();
+	long		rowBytes = frame->GetRowBytes();
+
+	if (frame->GetBytes((void**)&bytes) != S_OK)
+		return false;
+
+	const PatternLine* line = GetPatternLine(pattern, frame->GetPixelFormat(), frame->GetWidth(), rowBytes);
+	if (!line)
+		return false;
+
+	for (long y = 0; y < height; y++)
+		CopyFrameRow(bytes + y * rowBytes, line->bytes.data(), rowBytes);
+
+	FinishFrameRowCopies();
+
+	return true;
+}
@@ -0,0 +1,80 @@
+/* -LICENSE-START-
+** Copyright (c) 2018 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include "DeckLinkAPI.h"
+
+enum PatternType
+{
+	kPatternBlack				= 0,
+	kPatternColourBars			= 1,
+	kPatternReverseColourBars	= 2
+};
+
+struct PatternColour
+{
+	// 8-bit video range YCbCr
+	uint8_t		y;
+	uint8_t		cb;
+	uint8_t		cr;
+	// 8-bit full range RGB
+	uint8_t		red;
+	uint8_t		green;
+	uint8_t		blue;
+};
+
+// 100% colour bars: white, yellow, cyan, green, magenta, red, blue, black
+extern const PatternColour kColourBars[8];
+
+// Test patterns are generated as a single line packed in the output pixel format, then replicated down the
+// frame.  Lines are cached by pattern, pixel format and width, so switching back to a mode reuses them.
+
+// Pixel formats that patterns can be written in directly, without a conversion pass
+bool IsNativePatternFormat(BMDPixelFormat pixelFormat);
+
+// Fill the frame with the pattern in the frame's pixel format.  Returns false for formats that are not native.
+bool FillPattern(IDeckLinkVideoFrame* frame, PatternType pattern);
+
+// Pack a line of pixel colours in a native pixel format.  Pixel groups are written whole, so the line must
+// be sized as the rows of a frame are by GetPixelFormatRowBytes.  Returns false for formats that are not native.
+bool PackPatternLine(BMDPixelFormat pixelFormat, const PatternColour* colours, long width, uint8_t* line);
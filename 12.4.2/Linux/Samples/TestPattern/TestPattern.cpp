@@ -51,7 +51,11 @@
 #include <sys/stat.h>
 #include <fcntl.h>
 #include <arpa/inet.h>
+#include <algorithm>
+#include <chrono>
 
+#include "PatternLines.h"
+#include "PixelFormatTraits.h"
 #include "TestPattern.h"
 #include "VideoFrame3D.h"
 
@@ -121,7 +125,8 @@ TestPattern::TestPattern(BMDConfig *config) :
 	m_videoFrameBars(),
 	m_outputSignal(kOutputSignalDrop),
 	m_audioBuffer(),
-	m_audioSampleRate(bmdAudioSampleRate48kHz)
+	m_audioSampleRate(bmdAudioSampleRate48kHz),
+	m_playbackTelemetry(std::make_shared<TelemetryStream>())
 {
 }
 
@@ -168,6 +173,17 @@ bool TestPattern::Run()
 	if (m_deckLink->QueryInterface(IID_IDeckLinkConfiguration, (void**)&m_deckLinkConfiguration) != S_OK)
 		goto bail;
 
+	// Publish telemetry for monitors; buffered frame counts are polled on the publisher thread
+	if (m_telemetryPublisher.open("TestPattern"))
+	{
+		m_playbackTelemetry = m_telemetryPublisher.addStream(m_deckLink, Telemetry::StreamDirection::Playback);
+		m_playbackTelemetry->setSampler(std::bind(&TestPattern::SampleTelemetry, this, std::placeholders::_1));
+	}
+	else
+	{
+		fprintf(stderr, "Unable to create telemetry segment, telemetry will not be published\n");
+	}
+
 	// Get the display mode
 	idx = m_config->m_displayModeIndex;
 
@@ -230,6 +246,10 @@ bool TestPattern::Run()
 	printf("\n");
 
 bail:
+	// Stop the sampler before the output it polls is released
+	m_playbackTelemetry->setSampler(nullptr);
+	m_telemetryPublisher.close();
+
 	if (displayModeName != NULL)
 		free(displayModeName);
 
@@ -258,6 +278,7 @@ void TestPattern::StartRunning()
 {
 	HRESULT					result;
 	unsigned long			audioSamplesPerFrame;
+	unsigned long			prerollFrames;
 	IDeckLinkVideoFrame*	rightFrame;
 	VideoFrame3D*			frame3D;
 
@@ -285,6 +306,8 @@ void TestPattern::StartRunning()
 		goto bail;
 	}
 
+	m_playbackTelemetry->setFormat(m_displayMode->GetDisplayMode(), m_config->m_pixelFormat);
+
 	// Set the audio output mode
 	result = m_deckLinkOutput->EnableAudioOutput(bmdAudioSampleRate48kHz, m_config->m_audioSampleDepth, m_config->m_audioChannels, bmdAudioOutputStreamContinuous);
 	if (result != S_OK)
@@ -312,39 +335,70 @@ void TestPattern::StartRunning()
 	else
 		FillSine((void*)((unsigned long)m_audioBuffer + (audioSamplesPerFrame * m_config->m_audioChannels * m_config->m_audioSampleDepth / 8)), (m_audioBufferSampleLength - audioSamplesPerFrame), m_config->m_audioChannels, m_config->m_audioSampleDepth);
 
-	// Generate a frame of black
-	if (CreateFrame(&m_videoFrameBlack, FillBlack) != S_OK)
-		goto bail;
-
-	if (m_config->m_outputFlags & bmdVideoOutputDualStream3D)
+	if (m_config->m_patternFrameCount > 0)
 	{
-		frame3D = new VideoFrame3D(m_videoFrameBlack);
-		m_videoFrameBlack->Release();
-		m_videoFrameBlack = frame3D;
-		frame3D = NULL;
-	}
+		std::chrono::steady_clock::time_point renderStart = std::chrono::steady_clock::now();
 
-	// Generate a frame of colour bars
-	if (CreateFrame(&m_videoFrameBars, FillForwardColourBars) != S_OK)
-		goto bail;
+		// Render every frame of the moving pattern before playout, the completion callback only recycles them
+		if (m_framePool.Render(m_deckLinkOutput, m_frameWidth, m_frameHeight, GetPixelFormatRowBytes(m_config->m_pixelFormat, m_frameWidth), m_config->m_pixelFormat, m_config->m_patternFrameCount) != S_OK)
+		{
+			fprintf(stderr, "Failed to render moving pattern frames\n");
+			goto bail;
+		}
+
+		fprintf(stderr, "Rendered %u pattern frames in %.0f ms\n", m_framePool.GetFrameCount(),
+			std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - renderStart).count());
 
-	if (m_config->m_outputFlags & bmdVideoOutputDualStream3D)
+		// The pattern below the watermark does not change, so its CRC is taken once for each frame
+		m_payloadCRCs.clear();
+		if (m_config->m_watermark)
+		{
+			for (uint32_t i = 0; i < m_framePool.GetFrameCount(); i++)
+				m_payloadCRCs.push_back(WatermarkPayloadCRC(m_framePool.GetFrame(i)));
+		}
+	}
+	else
 	{
-		if (CreateFrame(&rightFrame, FillReverseColourBars) != S_OK)
+		// Generate a frame of black
+		if (CreateFrame(&m_videoFrameBlack, FillBlack) != S_OK)
 			goto bail;
 
-		frame3D = new VideoFrame3D(m_videoFrameBars, rightFrame);
-		m_videoFrameBars->Release();
-		rightFrame->Release();
-		m_videoFrameBars = frame3D;
-		frame3D = NULL;
+		if (m_config->m_outputFlags & bmdVideoOutputDualStream3D)
+		{
+			frame3D = new VideoFrame3D(m_videoFrameBlack);
+			m_videoFrameBlack->Release();
+			m_videoFrameBlack = frame3D;
+			frame3D = NULL;
+		}
+
+		// Generate a frame of colour bars
+		if (CreateFrame(&m_videoFrameBars, FillForwardColourBars) != S_OK)
+			goto bail;
+
+		if (m_config->m_outputFlags & bmdVideoOutputDualStream3D)
+		{
+			if (CreateFrame(&rightFrame, FillReverseColourBars) != S_OK)
+				goto bail;
+
+			frame3D = new VideoFrame3D(m_videoFrameBars, rightFrame);
+			m_videoFrameBars->Release();
+			rightFrame->Release();
+			m_videoFrameBars = frame3D;
+			frame3D = NULL;
+		}
 	}
 
-	// Begin video preroll by scheduling a second of frames in hardware
+	// Begin video preroll by scheduling a second of frames in hardware.  Watermarks are stamped as frames
+	// are scheduled, so no more than the pool is scheduled at once, and a frame has always completed before
+	// it is stamped again.
+	prerollFrames = m_framesPerSecond;
+	if (!m_payloadCRCs.empty())
+		prerollFrames = std::min<unsigned long>(prerollFrames, m_payloadCRCs.size());
+
 	m_totalFramesScheduled = 0;
 	m_totalFramesDropped = 0;
 	m_totalFramesCompleted = 0;
-	for (unsigned i = 0; i < m_framesPerSecond; i++)
+	for (unsigned i = 0; i < prerollFrames; i++)
 		ScheduleNextFrame(true);
 
 	// Begin audio preroll.  This will begin calling our audio callback, which will start the DeckLink output stream.
@@ -389,6 +443,9 @@ void TestPattern::StopRunning()
 		m_videoFrameBars->Release();
 	m_videoFrameBars = NULL;
 
+	m_framePool.Clear();
+	m_payloadCRCs.clear();
+
 	if (m_audioBuffer != NULL)
 		free(m_audioBuffer);
 	m_audioBuffer = NULL;
@@ -403,7 +460,24 @@ void TestPattern::ScheduleNextFrame(bool prerolling)
 		if (m_running == false)
 			return;
 	}
-	if (m_outputSignal == kOutputSignalPip)
+	if (m_framePool.GetFrameCount() > 0)
+	{
+		// Frames are recycled in order, each was rendered before playout started
+		IDeckLinkVideoFrame* frame = m_framePool.GetFrame(m_totalFramesScheduled);
+
+		if (!m_payloadCRCs.empty())
+		{
+			FrameWatermark watermark;
+			watermark.frameCounter	= (uint32_t)m_totalFramesScheduled;
+			watermark.payloadCRC	= m_payloadCRCs[m_totalFramesScheduled % m_payloadCRCs.size()];
+			watermark.sendTime		= GetFrameSendTime(m_totalFramesScheduled * m_frameDuration);
+			StampWatermark(frame, watermark);
+		}
+
+		if (m_deckLinkOutput->ScheduleVideoFrame(frame, (m_totalFramesScheduled * m_frameDuration), m_frameDuration, m_frameTimescale) != S_OK)
+			return;
+	}
+	else if (m_outputSignal == kOutputSignalPip)
 	{
 		if ((m_totalFramesScheduled % m_framesPerSecond) == 0)
 		{
@@ -437,6 +511,24 @@ void TestPattern::ScheduleNextFrame(bool prerolling)
 	m_totalFramesScheduled += 1;
 }
 
+BMDTimeValue TestPattern::GetFrameSendTime(BMDTimeValue streamTime)
+{
+	BMDTimeValue	currentStreamTime;
+	double			playbackSpeed;
+	BMDTimeValue	hardwareTime;
+	BMDTimeValue	timeInFrame;
+	BMDTimeValue	ticksPerFrame;
+
+	// The output time of frames scheduled before playback starts is not known yet
+	if (m_deckLinkOutput->GetScheduledStreamTime(m_frameTimescale, &currentStreamTime, &playbackSpeed) != S_OK || playbackSpeed == 0.0)
+		return kWatermarkNoTime;
+
+	if (m_deckLinkOutput->GetHardwareReferenceClock(kWatermarkTimeScale, &hardwareTime, &timeInFrame, &ticksPerFrame) != S_OK)
+		return kWatermarkNoTime;
+
+	return hardwareTime + ((streamTime - currentStreamTime) * kWatermarkTimeScale) / m_frameTimescale;
+}
+
 void TestPattern::WriteNextAudioSamples()
 {
 	unsigned int		bufferedSamples;
@@ -463,8 +555,8 @@ void TestPattern::WriteNextAudioSamples()
 HRESULT TestPattern::CreateFrame(IDeckLinkVideoFrame** frame, void (*fillFunc)(IDeckLinkVideoFrame*))
 {
 	HRESULT						result;
-	int							bytesPerRow = GetRowBytes(m_config->m_pixelFormat, m_frameWidth);
-	int							referenceBytesPerRow = GetRowBytes(bmdFormat8BitYUV, m_frameWidth);
+	int							bytesPerRow = GetPixelFormatRowBytes(m_config->m_pixelFormat, m_frameWidth);
+	int							referenceBytesPerRow = GetPixelFormatRowBytes(bmdFormat8BitYUV, m_frameWidth);
 	IDeckLinkMutableVideoFrame*	newFrame = NULL;
 	IDeckLinkMutableVideoFrame*	referenceFrame = NULL;
 	IDeckLinkVideoConversion*	frameConverter = NULL;
@@ -478,7 +570,7 @@ HRESULT TestPattern::CreateFrame(IDeckLinkVideoFrame** frame, void (*fillFunc)(I
 		goto bail;
 	}
 
-	if (m_config->m_pixelFormat == bmdFormat8BitYUV)
+	if (IsNativePatternFormat(m_config->m_pixelFormat))
 	{
 		fillFunc(newFrame);
 	}
@@ -526,6 +618,18 @@ void TestPattern::PrintStatusLine()
 		m_totalFramesScheduled, m_totalFramesCompleted, m_totalFramesDropped);
 }
 
+void TestPattern::SampleTelemetry(TelemetryStream& stream)
+{
+	uint32_t bufferedVideoFrameCount;
+	uint32_t bufferedAudioSampleFrameCount;
+
+	if (m_deckLinkOutput->GetBufferedVideoFrameCount(&bufferedVideoFrameCount) == S_OK)
+		stream.setBufferedVideoFrames(bufferedVideoFrameCount);
+
+	if (m_deckLinkOutput->GetBufferedAudioSampleFrameCount(&bufferedAudioSampleFrameCount) == S_OK)
+		stream.setBufferedAudioSampleFrames(bufferedAudioSampleFrameCount);
+}
+
 /************************* DeckLink API Delegate Methods *****************************/
 
 
@@ -555,6 +659,14 @@ HRESULT TestPattern::ScheduledFrameCompleted(IDeckLinkVideoFrame* completedFrame
 	++m_totalFramesCompleted;
 	PrintStatusLine();
 
+	if (result == bmdOutputFrameDisplayedLate)
+		m_playbackTelemetry->addLateFrames();
+	else if (result == bmdOutputFrameDropped)
+		m_playbackTelemetry->addDroppedFrames();
+
+	if (result == bmdOutputFrameCompleted || result == bmdOutputFrameDisplayedLate)
+		m_playbackTelemetry->addFramesOut();
+
 	// When a video frame has been released by the API, schedule another video frame to be output
 	ScheduleNextFrame(false);
 	return S_OK;
@@ -619,80 +731,11 @@ void FillSine(void* audioBuffer, unsigned long samplesToWrite, unsigned long cha
 
 void FillColourBars(IDeckLinkVideoFrame* theFrame, bool reverse)
 {
-	unsigned int*	nextWord;
-	unsigned long	width;
-	unsigned long	height;
-	unsigned int	bars[8] = {0xEA80EA80, 0xD292D210, 0xA910A9A5, 0x90229035, 0x6ADD6ACA, 0x51EF515A, 0x286D28EF, 0x10801080};
-
-	theFrame->GetBytes((void**)&nextWord);
-	width = theFrame->GetWidth();
-	height = theFrame->GetHeight();
-
-	if (reverse)
-	{
-		for (long y = 0; y < height; y++)
-		{
-			for (long x = width - 2; x >= 0; x -= 2)
-			{
-				*(nextWord++) = bars[(x * 8) / width];
-			}
-		}
-	}
-	else
-	{
-		for (long y = 0; y < height; y++)
-		{
-			for (long x = 0; x < width; x += 2)
-			{
-				*(nextWord++) = bars[(x * 8) / width];
-			}
-		}
-	}
+	FillPattern(theFrame, reverse ? kPatternReverseColourBars : kPatternColourBars);
 }
 
 void FillBlack(IDeckLinkVideoFrame* theFrame)
 {
-	unsigned int*	nextWord;
-	unsigned long	width;
-	unsigned long	height;
-	unsigned long	wordsRemaining;
-
-	theFrame->GetBytes((void**)&nextWord);
-	width = theFrame->GetWidth();
-	height = theFrame->GetHeight();
-
-	wordsRemaining = (width * 2 * height) / 4;
-
-	while (wordsRemaining-- > 0)
-		*(nextWord++) = 0x10801080;
-}
-
-int GetRowBytes(BMDPixelFormat pixelFormat, int frameWidth)
-{
-	int bytesPerRow;
-
-	// Refer to DeckLink SDK Manual - 2.7.4 Pixel Formats
-	switch (pixelFormat)
-	{
-	case bmdFormat8BitYUV:
-		bytesPerRow = frameWidth * 2;
-		break;
-
-	case bmdFormat10BitYUV:
-		bytesPerRow = ((frameWidth + 47) / 48) * 128;
-		break;
-
-	case bmdFormat10BitRGB:
-		bytesPerRow = ((frameWidth + 63) / 64) * 256;
-		break;
-
-	case bmdFormat8BitARGB:
-	case bmdFormat8BitBGRA:
-	default:
-		bytesPerRow = frameWidth * 4;
-		break;
-	}
-
-	return bytesPerRow;
+	FillPattern(theFrame, kPatternBlack);
 }
 
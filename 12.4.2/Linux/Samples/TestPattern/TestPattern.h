@@ -40,9 +40,13 @@
 
 #include <mutex>
 #include <condition_variable>
+#include <vector>
 
 #include "DeckLinkAPI.h"
 #include "Config.h"
+#include "DeckLinkTelemetry.h"
+#include "FrameWatermark.h"
+#include "PatternFrames.h"
 
 enum OutputSignal
 {
@@ -69,6 +73,8 @@ private:
 	unsigned long			m_framesPerSecond;
 	IDeckLinkVideoFrame*	m_videoFrameBlack;
 	IDeckLinkVideoFrame*	m_videoFrameBars;
+	PatternFramePool		m_framePool;
+	std::vector<uint32_t>	m_payloadCRCs;
 	unsigned long			m_totalFramesScheduled;
 	unsigned long			m_totalFramesDropped;
 	unsigned long			m_totalFramesCompleted;
@@ -82,15 +88,20 @@ private:
 	std::mutex				m_mutex;
 	std::condition_variable	m_stoppedCondition;
 
+	TelemetryPublisher					m_telemetryPublisher;
+	std::shared_ptr<TelemetryStream>	m_playbackTelemetry;
+
 	~TestPattern();
 
 	// Signal Generator Implementation
 	void			StartRunning();
 	void			StopRunning();
 	void			ScheduleNextFrame(bool prerolling);
+	BMDTimeValue	GetFrameSendTime(BMDTimeValue streamTime);
 	void			WriteNextAudioSamples();
 
 	void			PrintStatusLine();
+	void			SampleTelemetry(TelemetryStream& stream);
 
 public:
 	TestPattern(BMDConfig *config);
@@ -121,4 +132,3 @@ static inline void FillReverseColourBars(IDeckLinkVideoFrame* theFrame)
 	FillColourBars(theFrame, true);
 }
 void FillBlack(IDeckLinkVideoFrame* theFrame);
-int GetRowBytes(BMDPixelFormat pixelFormat, int frameWidth);
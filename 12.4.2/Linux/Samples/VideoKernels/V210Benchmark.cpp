@@ -0,0 +1,472 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+// Times the v210 row kernels for each instruction set against the scalar kernels, the threaded
+// V210Converter, and IDeckLinkVideoConversion::ConvertFrame when the driver library is present.
+// The output of each instruction set is checked against the scalar kernels before it is timed.
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <random>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include "DeckLinkAPI.h"
+#include "V210Kernels.h"
+
+namespace
+{
+	struct Resolution
+	{
+		const char*	name;
+		uint32_t	width;
+		uint32_t	height;
+	};
+
+	const Resolution kResolutions[] =
+	{
+		{ "1080p",	1920, 1080 },
+		{ "UHD",	3840, 2160 },
+		{ "8K",		7680, 4320 },
+	};
+
+	const V210KernelISA kISAs[] =
+	{
+		V210KernelISA::Scalar,
+		V210KernelISA::SSE41,
+		V210KernelISA::AVX2,
+		V210KernelISA::AVX512,
+		V210KernelISA::NEON
+	};
+
+	// Frame buffers for one resolution, in every layout converted to and from
+	struct FrameSet
+	{
+		FrameSet(uint32_t frameWidth, uint32_t frameHeight) :
+			width(frameWidth),
+			height(frameHeight),
+			v210RowBytes(V210RowBytes(frameWidth)),
+			v210(v210RowBytes * frameHeight),
+			v210Out(v210RowBytes * frameHeight),
+			y(frameWidth * frameHeight),
+			cb(frameWidth / 2 * frameHeight),
+			cr(frameWidth / 2 * frameHeight),
+			cbcr(frameWidth * ((frameHeight + 1) / 2)),
+			yuv2vuy(frameWidth * 2 * frameHeight)
+		{
+			std::mt19937 random(width * height);
+
+			// Random 10-bit samples in every word, including the padding at the end of each row
+			for (size_t i = 0; i < v210.size(); i += 4)
+			{
+				uint32_t word = random() & 0x3fffffff;
+				memcpy(&v210[i], &word, sizeof(word));
+			}
+		}
+
+		uint32_t				width;
+		uint32_t				height;
+		uint32_t				v210RowBytes;
+		std::vector<uint8_t>	v210;
+		std::vector<uint8_t>	v210Out;
+		std::vector<uint16_t>	y;
+		std::vector<uint16_t>	cb;
+		std::vector<uint16_t>	cr;
+		std::vector<uint16_t>	cbcr;
+		std::vector<uint8_t>	yuv2vuy;
+	};
+
+	struct Conversion
+	{
+		const char*	name;
+		// Converts the frame set with a converter, leaving the result in the frame set
+		std::function<void(V210Converter&, FrameSet&)>	convert;
+		// Overwrites the output, so a kernel that writes nothing does not match
+		std::function<void(FrameSet&)>	clearOutput;
+		// Compares the output with that of the reference frame set
+		std::function<bool(const FrameSet&, const FrameSet&)>	matches;
+	};
+
+	bool sameV210Pixels(const FrameSet& a, const FrameSet& b)
+	{
+		// Only compare the bytes holding pixels, as packing does not write the padding at the end of a row
+		uint32_t activeBytes = (a.width / 6) * 16 + ((a.width % 6) ? 16 : 0);
+
+		for (uint32_t row = 0; row < a.height; row++)
+		{
+			if (memcmp(&a.v210Out[row * a.v210RowBytes], &b.v210Out[row * b.v210RowBytes], activeBytes) != 0)
+				return false;
+		}
+		return true;
+	}
+
+	const Conversion kConversions[] =
+	{
+		{
+			"v210 -> planar16",
+			[](V210Converter& converter, FrameSet& f)
+			{
+				converter.v210ToPlanar16(f.v210.data(), f.v210RowBytes, f.y.data(), f.width * 2, f.cb.data(), f.cr.data(), f.width, f.width, f.height);
+			},
+			[](FrameSet& f) { std::fill(f.y.begin(), f.y.end(), 0xffff); std::fill(f.cb.begin(), f.cb.end(), 0xffff); std::fill(f.cr.begin(), f.cr.end(), 0xffff); },
+			[](const FrameSet& a, const FrameSet& b) { return a.y == b.y && a.cb == b.cb && a.cr == b.cr; }
+		},
+		{
+			"planar16 -> v210",
+			[](V210Converter& converter, FrameSet& f)
+			{
+				converter.planar16ToV210(f.y.data(), f.width * 2, f.cb.data(), f.cr.data(), f.width, f.v210Out.data(), f.v210RowBytes, f.width, f.height);
+			},
+			[](FrameSet& f) { std::fill(f.v210Out.begin(), f.v210Out.end(), 0xff); },
+			sameV210Pixels
+		},
+		{
+			"v210 -> P010",
+			[](V210Converter& converter, FrameSet& f)
+			{
+				converter.v210ToP010(f.v210.data(), f.v210RowBytes, f.y.data(), f.width * 2, f.cbcr.data(), f.width * 2, f.width, f.height);
+			},
+			[](FrameSet& f) { std::fill(f.y.begin(), f.y.end(), 0xffff); std::fill(f.cbcr.begin(), f.cbcr.end(), 0xffff); },
+			[](const FrameSet& a, const FrameSet& b) { return a.y == b.y && a.cbcr == b.cbcr; }
+		},
+		{
+			"P010 -> v210",
+			[](V210Converter& converter, FrameSet& f)
+			{
+				converter.p010ToV210(f.y.data(), f.width * 2, f.cbcr.data(), f.width * 2, f.v210Out.data(), f.v210RowBytes, f.width, f.height);
+			},
+			[](FrameSet& f) { std::fill(f.v210Out.begin(), f.v210Out.end(), 0xff); },
+			sameV210Pixels
+		},
+		{
+			"v210 -> 2vuy",
+			[](V210Converter& converter, FrameSet& f)
+			{
+				converter.v210To2vuy(f.v210.data(), f.v210RowBytes, f.yuv2vuy.data(), f.width * 2, f.width, f.height);
+			},
+			[](FrameSet& f) { std::fill(f.yuv2vuy.begin(), f.yuv2vuy.end(), 0xff); },
+			[](const FrameSet& a, const FrameSet& b) { return a.yuv2vuy == b.yuv2vuy; }
+		},
+		{
+			"2vuy -> v210",
+			[](V210Converter& converter, FrameSet& f)
+			{
+				converter.yuv2vuyToV210(f.yuv2vuy.data(), f.width * 2, f.v210Out.data(), f.v210RowBytes, f.width, f.height);
+			},
+			[](FrameSet& f) { std::fill(f.v210Out.begin(), f.v210Out.end(), 0xff); },
+			sameV210Pixels
+		},
+	};
+
+	// Frame in memory for ConvertFrame, in the style of the frame classes of the other samples
+	class BenchmarkVideoFrame : public IDeckLinkVideoFrame
+	{
+	public:
+		BenchmarkVideoFrame(long width, long height, long rowBytes, BMDPixelFormat pixelFormat, uint8_t* bytes) :
+			m_width(width), m_height(height), m_rowBytes(rowBytes), m_pixelFormat(pixelFormat), m_bytes(bytes), m_refCount(1) { }
+		virtual ~BenchmarkVideoFrame() { }
+
+		// IDeckLinkVideoFrame interface
+		virtual long			STDMETHODCALLTYPE	GetWidth(void)			{ return m_width; }
+		virtual long			STDMETHODCALLTYPE	GetHeight(void)			{ return m_height; }
+		virtual long			STDMETHODCALLTYPE	GetRowBytes(void)		{ return m_rowBytes; }
+		virtual BMDPixelFormat	STDMETHODCALLTYPE	GetPixelFormat(void)	{ return m_pixelFormat; }
+		virtual BMDFrameFlags	STDMETHODCALLTYPE	GetFlags(void)			{ return bmdFrameFlagDefault; }
+		virtual HRESULT			STDMETHODCALLTYPE	GetBytes(void** buffer)	{ *buffer = m_bytes; return S_OK; }
+
+		// Dummy implementations of remaining methods in IDeckLinkVideoFrame
+		virtual HRESULT			STDMETHODCALLTYPE	GetAncillaryData(IDeckLinkVideoFrameAncillary** ancillary) { return E_NOTIMPL; }
+		virtual HRESULT			STDMETHODCALLTYPE	GetTimecode(BMDTimecodeFormat format, IDeckLinkTimecode** timecode) { return E_NOTIMPL; }
+
+		// IUnknown interface
+		virtual HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, LPVOID *ppv)
+		{
+			CFUUIDBytes iunknown = CFUUIDGetUUIDBytes(IUnknownUUID);
+
+			if (ppv == NULL)
+				return E_INVALIDARG;
+
+			*ppv = NULL;
+
+			if (memcmp(&iid, &iunknown, sizeof(REFIID)) == 0 || memcmp(&iid, &IID_IDeckLinkVideoFrame, sizeof(REFIID)) == 0)
+			{
+				*ppv = (IDeckLinkVideoFrame*)this;
+				AddRef();
+				return S_OK;
+			}
+
+			return E_NOINTERFACE;
+		}
+
+		virtual ULONG STDMETHODCALLTYPE AddRef(void)
+		{
+			return ++m_refCount;
+		}
+
+		virtual ULONG STDMETHODCALLTYPE Release(void)
+		{
+			ULONG newRefValue = --m_refCount;
+			if (newRefValue == 0)
+				delete this;
+
+			return newRefValue;
+		}
+
+	private:
+		long					m_width;
+		long					m_height;
+		long					m_rowBytes;
+		BMDPixelFormat			m_pixelFormat;
+		uint8_t*				m_bytes;
+		std::atomic<ULONG>		m_refCount;
+	};
+
+	// Checks the kernels against the scalar kernels at a size that is not whole v210 blocks and has an odd
+	// number of rows
+	bool verifyKernels(const V210RowKernels* kernels, uint32_t width, uint32_t height)
+	{
+		V210Converter scalarConverter(1, GetV210RowKernels(V210KernelISA::Scalar));
+		V210Converter converter(1, kernels);
+		FrameSet reference(width, height);
+		FrameSet frames(width, height);
+
+		for (const Conversion& conversion : kConversions)
+		{
+			conversion.convert(scalarConverter, reference);
+			frames = reference;
+			conversion.clearOutput(frames);
+			conversion.convert(converter, frames);
+
+			if (!conversion.matches(frames, reference))
+			{
+				fprintf(stderr, "%s kernels do not match scalar for %s at %ux%u\n", kernels->name, conversion.name, width, height);
+				return false;
+			}
+		}
+		return true;
+	}
+
+	// Milliseconds per call of func, after a call to warm the caches
+	double timeMilliseconds(int iterations, const std::function<void(void)>& func)
+	{
+		func();
+
+		auto start = std::chrono::steady_clock::now();
+		for (int i = 0; i < iterations; i++)
+			func();
+		auto end = std::chrono::steady_clock::now();
+
+		return std::chrono::duration<double, std::milli>(end - start).count() / iterations;
+	}
+
+	void displayUsage(const char* program)
+	{
+		fprintf(stderr,
+			"Usage: %s [options]\n"
+			"    -i <iterations>    Frames converted for each measurement (default is 20)\n"
+			"    -t <threads>       Threads used by the threaded converter (default is one per CPU)\n",
+			program);
+	}
+}
+
+int main(int argc, char* argv[])
+{
+	int							iterations		= 20;
+	unsigned					threadCount		= 0;
+	bool						failed			= false;
+	IDeckLinkVideoConversion*	frameConverter	= NULL;
+	int							ch;
+
+	while ((ch = getopt(argc, argv, "i:t:h")) != -1)
+	{
+		switch (ch)
+		{
+			case 'i':
+				iterations = atoi(optarg);
+				break;
+			case 't':
+				threadCount = (unsigned)atoi(optarg);
+				break;
+			case 'h':
+			default:
+				displayUsage(argv[0]);
+				return 1;
+		}
+	}
+
+	if (iterations <= 0)
+	{
+		displayUsage(argv[0]);
+		return 1;
+	}
+
+	std::vector<const V210RowKernels*> kernelSets;
+	for (V210KernelISA isa : kISAs)
+	{
+		const V210RowKernels* kernels = GetV210RowKernels(isa);
+		if (kernels)
+			kernelSets.push_back(kernels);
+	}
+
+	for (const V210RowKernels* kernels : kernelSets)
+	{
+		const uint32_t verifyWidths[] = { 2, 4, 46, 718, 1918 };
+
+		for (uint32_t width : verifyWidths)
+			failed |= !verifyKernels(kernels, width, 5);
+	}
+
+	V210Converter threadedConverter(threadCount);
+
+	printf("Row kernels:");
+	for (const V210RowKernels* kernels : kernelSets)
+		printf(" %s", kernels->name);
+	printf("\nThreaded converter: %s kernels on %u threads\n", threadedConverter.getKernels()->name, threadedConverter.getThreadCount());
+
+	frameConverter = CreateVideoConversionInstance();
+	if (!frameConverter)
+		printf("ConvertFrame: not available, the DeckLink driver library was not found\n");
+
+	for (const Resolution& resolution : kResolutions)
+	{
+		FrameSet reference(resolution.width, resolution.height);
+		FrameSet frames(resolution.width, resolution.height);
+
+		printf("\n%s (%ux%u), ms per frame\n", resolution.name, resolution.width, resolution.height);
+		printf("%-18s", "");
+		for (const V210RowKernels* kernels : kernelSets)
+			printf("%10s", kernels->name);
+		printf("%10s%14s\n", "Threaded", "ConvertFrame");
+
+		// Conversions from v210 run first, so the conversions back have input
+		for (const Conversion& conversion : kConversions)
+		{
+			printf("%-18s", conversion.name);
+
+			for (const V210RowKernels* kernels : kernelSets)
+			{
+				V210Converter converter(1, kernels);
+
+				if (kernels->isa == V210KernelISA::Scalar)
+				{
+					conversion.convert(converter, reference);
+					frames = reference;
+				}
+				else
+				{
+					conversion.clearOutput(frames);
+					conversion.convert(converter, frames);
+					if (!conversion.matches(frames, reference))
+					{
+						printf("%10s", "MISMATCH");
+						failed = true;
+						continue;
+					}
+				}
+
+				printf("%10.2f", timeMilliseconds(iterations, [&]() { conversion.convert(converter, frames); }));
+				fflush(stdout);
+			}
+
+			conversion.clearOutput(frames);
+			conversion.convert(threadedConverter, frames);
+			if (conversion.matches(frames, reference))
+				printf("%10.2f", timeMilliseconds(iterations, [&]() { conversion.convert(threadedConverter, frames); }));
+			else
+			{
+				printf("%10s", "MISMATCH");
+				failed = true;
+			}
+
+			// The driver only converts between the DeckLink pixel formats
+			BMDPixelFormat srcFormat = 0;
+			BMDPixelFormat dstFormat = 0;
+			uint8_t* srcBytes = NULL;
+			uint8_t* dstBytes = NULL;
+
+			if (strcmp(conversion.name, "v210 -> 2vuy") == 0)
+			{
+				srcFormat = bmdFormat10BitYUV;
+				srcBytes = frames.v210.data();
+				dstFormat = bmdFormat8BitYUV;
+				dstBytes = frames.yuv2vuy.data();
+			}
+			else if (strcmp(conversion.name, "2vuy -> v210") == 0)
+			{
+				srcFormat = bmdFormat8BitYUV;
+				srcBytes = frames.yuv2vuy.data();
+				dstFormat = bmdFormat10BitYUV;
+				dstBytes = frames.v210Out.data();
+			}
+
+			if (frameConverter && srcBytes)
+			{
+				long srcRowBytes = (srcFormat == bmdFormat10BitYUV) ? frames.v210RowBytes : frames.width * 2;
+				long dstRowBytes = (dstFormat == bmdFormat10BitYUV) ? frames.v210RowBytes : frames.width * 2;
+				BenchmarkVideoFrame* srcFrame = new BenchmarkVideoFrame(frames.width, frames.height, srcRowBytes, srcFormat, srcBytes);
+				BenchmarkVideoFrame* dstFrame = new BenchmarkVideoFrame(frames.width, frames.height, dstRowBytes, dstFormat, dstBytes);
+
+				if (frameConverter->ConvertFrame(srcFrame, dstFrame) == S_OK)
+					printf("%14.2f", timeMilliseconds(iterations, [&]() { frameConverter->ConvertFrame(srcFrame, dstFrame); }));
+				else
+					printf("%14s", "failed");
+
+				srcFrame->Release();
+				dstFrame->Release();
+			}
+			else
+			{
+				printf("%14s", "-");
+			}
+
+			printf("\n");
+		}
+	}
+
+	if (frameConverter)
+		frameConverter->Release();
+
+	return failed ? 1 : 0;
+}
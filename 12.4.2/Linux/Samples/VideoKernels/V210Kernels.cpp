@@ -0,0 +1,295 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include <algorithm>
+#include "V210KernelsRow.h"
+
+namespace
+{
+	struct ScalarBlocks
+	{
+		static void unpack(const uint8_t* src, uint16_t* dst, size_t blockCount)
+		{
+			for (size_t i = 0; i < blockCount; i++, src += kV210BlockBytes, dst += kV210BlockSamples)
+				V210UnpackBlockScalar(src, dst);
+		}
+
+		static void pack(const uint16_t* src, uint8_t* dst, size_t blockCount)
+		{
+			for (size_t i = 0; i < blockCount; i++, src += kV210BlockSamples, dst += kV210BlockBytes)
+				V210PackBlockScalar(src, dst);
+		}
+	};
+
+	// Rows claimed by a thread at a time; small enough to balance the load across threads, large
+	// enough that the shared counter is not contended
+	const uint32_t kRowsPerChunk = 8;
+}
+
+const V210RowKernels* GetV210RowKernels(V210KernelISA isa)
+{
+	static const V210RowKernels scalarKernels = V210RowConverter<ScalarBlocks>::getKernels(V210KernelISA::Scalar, "Scalar");
+
+	switch (isa)
+	{
+		case V210KernelISA::Scalar:
+			return &scalarKernels;
+
+#if defined(__x86_64__) || defined(__i386__)
+		case V210KernelISA::SSE41:
+			return __builtin_cpu_supports("sse4.1") ? GetV210RowKernelsSSE41() : nullptr;
+
+		case V210KernelISA::AVX2:
+			return __builtin_cpu_supports("avx2") ? GetV210RowKernelsAVX2() : nullptr;
+
+		case V210KernelISA::AVX512:
+			return (__builtin_cpu_supports("avx512f") && __builtin_cpu_supports("avx512bw")) ? GetV210RowKernelsAVX512() : nullptr;
+#elif defined(__aarch64__)
+		case V210KernelISA::NEON:
+			return GetV210RowKernelsNEON();
+#endif
+
+		default:
+			return nullptr;
+	}
+}
+
+const V210RowKernels* GetV210RowKernels(void)
+{
+	static const V210RowKernels* bestKernels = []()
+	{
+		const V210KernelISA order[] = { V210KernelISA::AVX512, V210KernelISA::AVX2, V210KernelISA::SSE41, V210KernelISA::NEON };
+
+		for (V210KernelISA isa : order)
+		{
+			const V210RowKernels* kernels = GetV210RowKernels(isa);
+			if (kernels)
+				return kernels;
+		}
+
+		return GetV210RowKernels(V210KernelISA::Scalar);
+	}();
+
+	return bestKernels;
+}
+
+V210Converter::V210Converter(unsigned threadCount, const V210RowKernels* kernels) :
+	m_kernels(kernels ? kernels : GetV210RowKernels()),
+	m_stopping(false),
+	m_generation(0),
+	m_func(nullptr),
+	m_count(0),
+	m_chunkSize(kRowsPerChunk),
+	m_nextIndex(0),
+	m_activeWorkers(0)
+{
+	if (threadCount == 0)
+		threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+
+	// The calling thread takes a share of the rows, so one fewer worker is needed
+	for (unsigned i = 1; i < threadCount; i++)
+		m_workers.emplace_back(&V210Converter::workerThread, this);
+}
+
+V210Converter::~V210Converter()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_startCondition.notify_all();
+
+	for (std::thread& worker : m_workers)
+		worker.join();
+}
+
+void V210Converter::parallelFor(uint32_t count, const std::function<void(uint32_t, uint32_t)>& func)
+{
+	if (m_workers.empty() || count <= kRowsPerChunk)
+	{
+		func(0, count);
+		return;
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_func = &func;
+		m_count = count;
+		m_nextIndex = 0;
+		m_activeWorkers = (unsigned)m_workers.size();
+		m_generation++;
+	}
+	m_startCondition.notify_all();
+
+	runChunks();
+
+	// func must stay valid until every worker has stopped claiming chunks
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_doneCondition.wait(lock, [this]() { return m_activeWorkers == 0; });
+	m_func = nullptr;
+}
+
+void V210Converter::workerThread(void)
+{
+	uint64_t generation = 0;
+
+	while (true)
+	{
+		{
+			std::unique_lock<std::mutex> lock(m_mutex);
+			m_startCondition.wait(lock, [&]() { return m_stopping || m_generation != generation; });
+
+			if (m_stopping)
+				return;
+
+			generation = m_generation;
+		}
+
+		runChunks();
+
+		bool lastWorker;
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			lastWorker = (--m_activeWorkers == 0);
+		}
+
+		if (lastWorker)
+			m_doneCondition.notify_one();
+	}
+}
+
+void V210Converter::runChunks(void)
+{
+	while (true)
+	{
+		uint32_t begin = m_nextIndex.fetch_add(m_chunkSize);
+		if (begin >= m_count)
+			break;
+
+		(*m_func)(begin, std::min(begin + m_chunkSize, m_count));
+	}
+}
+
+void V210Converter::v210ToPlanar16(const uint8_t* src, size_t srcRowBytes, uint16_t* y, size_t yStride, uint16_t* cb, uint16_t* cr, size_t chromaStride, uint32_t width, uint32_t height)
+{
+	parallelFor(height, [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t row = begin; row < end; row++)
+		{
+			m_kernels->v210ToPlanar16(src + row * srcRowBytes,
+									  (uint16_t*)((uint8_t*)y + row * yStride),
+									  (uint16_t*)((uint8_t*)cb + row * chromaStride),
+									  (uint16_t*)((uint8_t*)cr + row * chromaStride),
+									  width);
+		}
+	});
+}
+
+void V210Converter::planar16ToV210(const uint16_t* y, size_t yStride, const uint16_t* cb, const uint16_t* cr, size_t chromaStride, uint8_t* dst, size_t dstRowBytes, uint32_t width, uint32_t height)
+{
+	parallelFor(height, [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t row = begin; row < end; row++)
+		{
+			m_kernels->planar16ToV210((const uint16_t*)((const uint8_t*)y + row * yStride),
+									  (const uint16_t*)((const uint8_t*)cb + row * chromaStride),
+									  (const uint16_t*)((const uint8_t*)cr + row * chromaStride),
+									  dst + row * dstRowBytes,
+									  width);
+		}
+	});
+}
+
+void V210Converter::v210ToP010(const uint8_t* src, size_t srcRowBytes, uint16_t* y, size_t yStride, uint16_t* cbcr, size_t chromaStride, uint32_t width, uint32_t height)
+{
+	// Rows are converted in pairs, sharing a row of chroma.  An odd last row is paired with itself.
+	parallelFor((height + 1) / 2, [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t pair = begin; pair < end; pair++)
+		{
+			uint32_t row0 = pair * 2;
+			uint32_t row1 = std::min(row0 + 1, height - 1);
+
+			m_kernels->v210ToP010(src + row0 * srcRowBytes,
+								  src + row1 * srcRowBytes,
+								  (uint16_t*)((uint8_t*)y + row0 * yStride),
+								  (uint16_t*)((uint8_t*)y + row1 * yStride),
+								  (uint16_t*)((uint8_t*)cbcr + pair * chromaStride),
+								  width);
+		}
+	});
+}
+
+void V210Converter::p010ToV210(const uint16_t* y, size_t yStride, const uint16_t* cbcr, size_t chromaStride, uint8_t* dst, size_t dstRowBytes, uint32_t width, uint32_t height)
+{
+	parallelFor((height + 1) / 2, [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t pair = begin; pair < end; pair++)
+		{
+			uint32_t row0 = pair * 2;
+			uint32_t row1 = std::min(row0 + 1, height - 1);
+
+			m_kernels->p010ToV210((const uint16_t*)((const uint8_t*)y + row0 * yStride),
+								  (const uint16_t*)((const uint8_t*)y + row1 * yStride),
+								  (const uint16_t*)((const uint8_t*)cbcr + pair * chromaStride),
+								  dst + row0 * dstRowBytes,
+								  dst + row1 * dstRowBytes,
+								  width);
+		}
+	});
+}
+
+void V210Converter::v210To2vuy(const uint8_t* src, size_t srcRowBytes, uint8_t* dst, size_t dstRowBytes, uint32_t width, uint32_t height)
+{
+	parallelFor(height, [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t row = begin; row < end; row++)
+			m_kernels->v210To2vuy(src + row * srcRowBytes, dst + row * dstRowBytes, width);
+	});
+}
+
+void V210Converter::yuv2vuyToV210(const uint8_t* src, size_t srcRowBytes, uint8_t* dst, size_t dstRowBytes, uint32_t width, uint32_t height)
+{
+	parallelFor(height, [&](uint32_t begin, uint32_t end)
+	{
+		for (uint32_t row = begin; row < end; row++)
+			m_kernels->yuv2vuyToV210(src + row * srcRowBytes, dst + row * dstRowBytes, width);
+	});
+}
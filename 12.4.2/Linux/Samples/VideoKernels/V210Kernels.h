@@ -0,0 +1,135 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Conversions between v210 (bmdFormat10BitYUV) and other 4:2:2 and 4:2:0 layouts, implemented in-tree
+// so they do not depend on the driver's IDeckLinkVideoConversion.  Row kernels are provided for SSE4.1,
+// AVX2, AVX-512 and NEON, selected at runtime for the host CPU, with a scalar fallback; V210Converter
+// converts whole frames by splitting rows across a pool of threads.
+//
+// Widths must be even.  Planar 16-bit samples hold 10-bit values in the low bits, and P010 samples in
+// the high bits.  Samples above 10 bits are clamped when packing to v210.
+
+enum class V210KernelISA
+{
+	Scalar,
+	SSE41,
+	AVX2,
+	AVX512,
+	NEON
+};
+
+struct V210RowKernels
+{
+	V210KernelISA	isa;
+	const char*		name;
+
+	// v210 <-> planar 16-bit Y, Cb and Cr, with chroma at half width
+	void	(*v210ToPlanar16)(const uint8_t* src, uint16_t* y, uint16_t* cb, uint16_t* cr, uint32_t width);
+	void	(*planar16ToV210)(const uint16_t* y, const uint16_t* cb, const uint16_t* cr, uint8_t* dst, uint32_t width);
+
+	// Pair of v210 rows <-> P010, with interleaved CbCr at half width and half height.  Chroma is
+	// averaged over the two rows, and repeated for both rows when packing.
+	void	(*v210ToP010)(const uint8_t* src0, const uint8_t* src1, uint16_t* y0, uint16_t* y1, uint16_t* cbcr, uint32_t width);
+	void	(*p010ToV210)(const uint16_t* y0, const uint16_t* y1, const uint16_t* cbcr, uint8_t* dst0, uint8_t* dst1, uint32_t width);
+
+	// v210 <-> 8-bit 2vuy (bmdFormat8BitYUV), rounding to 8 bits
+	void	(*v210To2vuy)(const uint8_t* src, uint8_t* dst, uint32_t width);
+	void	(*yuv2vuyToV210)(const uint8_t* src, uint8_t* dst, uint32_t width);
+};
+
+// Kernels for an instruction set, or nullptr when the CPU or build does not support it
+const V210RowKernels*	GetV210RowKernels(V210KernelISA isa);
+
+// Kernels for the widest instruction set supported by the CPU
+const V210RowKernels*	GetV210RowKernels(void);
+
+inline uint32_t V210RowBytes(uint32_t width)
+{
+	return ((width + 47) / 48) * 128;
+}
+
+class V210Converter
+{
+public:
+	// A threadCount of 0 uses one thread per CPU, including the calling thread
+	explicit V210Converter(unsigned threadCount = 0, const V210RowKernels* kernels = nullptr);
+	virtual ~V210Converter();
+
+	unsigned				getThreadCount(void) const		{ return (unsigned)m_workers.size() + 1; }
+	const V210RowKernels*	getKernels(void) const			{ return m_kernels; }
+
+	// Strides are in bytes; planar chroma and the P010 chroma plane have their own stride
+	void	v210ToPlanar16(const uint8_t* src, size_t srcRowBytes, uint16_t* y, size_t yStride, uint16_t* cb, uint16_t* cr, size_t chromaStride, uint32_t width, uint32_t height);
+	void	planar16ToV210(const uint16_t* y, size_t yStride, const uint16_t* cb, const uint16_t* cr, size_t chromaStride, uint8_t* dst, size_t dstRowBytes, uint32_t width, uint32_t height);
+	void	v210ToP010(const uint8_t* src, size_t srcRowBytes, uint16_t* y, size_t yStride, uint16_t* cbcr, size_t chromaStride, uint32_t width, uint32_t height);
+	void	p010ToV210(const uint16_t* y, size_t yStride, const uint16_t* cbcr, size_t chromaStride, uint8_t* dst, size_t dstRowBytes, uint32_t width, uint32_t height);
+	void	v210To2vuy(const uint8_t* src, size_t srcRowBytes, uint8_t* dst, size_t dstRowBytes, uint32_t width, uint32_t height);
+	void	yuv2vuyToV210(const uint8_t* src, size_t srcRowBytes, uint8_t* dst, size_t dstRowBytes, uint32_t width, uint32_t height);
+
+private:
+	// Runs func(begin, end) over [0, count) in chunks claimed by the workers and the calling thread
+	void	parallelFor(uint32_t count, const std::function<void(uint32_t, uint32_t)>& func);
+	void	workerThread(void);
+	void	runChunks(void);
+
+	const V210RowKernels*							m_kernels;
+	std::vector<std::thread>						m_workers;
+	std::mutex										m_mutex;
+	std::condition_variable							m_startCondition;
+	std::condition_variable							m_doneCondition;
+	bool											m_stopping;
+	uint64_t										m_generation;
+	const std::function<void(uint32_t, uint32_t)>*	m_func;
+	uint32_t										m_count;
+	uint32_t										m_chunkSize;
+	std::atomic<uint32_t>							m_nextIndex;
+	unsigned										m_activeWorkers;
+};
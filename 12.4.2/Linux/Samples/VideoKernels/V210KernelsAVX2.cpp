@@ -0,0 +1,124 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+// Built with -mavx2
+#include <immintrin.h>
+#include "V210KernelsRow.h"
+
+namespace
+{
+	// As SSE41Blocks, with a block in each 128-bit lane
+	struct AVX2Blocks
+	{
+		static void unpack(const uint8_t* src, uint16_t* dst, size_t blockCount)
+		{
+			const __m256i mask			= _mm256_set1_epi32(kV210MaxSample);
+			const __m256i lowToLow		= _mm256_setr_epi8(0, 1, 2, 3, -1, -1, 4, 5, 6, 7, -1, -1, 8, 9, 10, 11,
+															0, 1, 2, 3, -1, -1, 4, 5, 6, 7, -1, -1, 8, 9, 10, 11);
+			const __m256i highToLow		= _mm256_setr_epi8(-1, -1, -1, -1, 0, 1, -1, -1, -1, -1, 4, 5, -1, -1, -1, -1,
+															-1, -1, -1, -1, 0, 1, -1, -1, -1, -1, 4, 5, -1, -1, -1, -1);
+			const __m256i lowToHigh		= _mm256_setr_epi8(-1, -1, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+															-1, -1, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+			const __m256i highToHigh	= _mm256_setr_epi8(8, 9, -1, -1, -1, -1, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1,
+															8, 9, -1, -1, -1, -1, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1);
+			// The 16 and 8 bytes of samples from each lane are joined into 48 contiguous bytes
+			const __m256i join0			= _mm256_setr_epi32(0, 1, 2, 3, 0, 1, 4, 5);
+			const __m256i join1			= _mm256_setr_epi32(6, 7, 4, 5, 0, 0, 0, 0);
+			size_t i;
+
+			for (i = 0; i + 2 <= blockCount; i += 2, src += 2 * kV210BlockBytes, dst += 2 * kV210BlockSamples)
+			{
+				__m256i words	= _mm256_loadu_si256((const __m256i*)src);
+				__m256i low		= _mm256_or_si256(_mm256_and_si256(words, mask), _mm256_slli_epi32(_mm256_and_si256(_mm256_srli_epi32(words, 10), mask), 16));
+				__m256i high	= _mm256_and_si256(_mm256_srli_epi32(words, 20), mask);
+				__m256i samples0 = _mm256_or_si256(_mm256_shuffle_epi8(low, lowToLow), _mm256_shuffle_epi8(high, highToLow));
+				__m256i samples1 = _mm256_or_si256(_mm256_shuffle_epi8(low, lowToHigh), _mm256_shuffle_epi8(high, highToHigh));
+
+				_mm256_storeu_si256((__m256i*)dst, _mm256_blend_epi32(_mm256_permutevar8x32_epi32(samples0, join0), _mm256_permutevar8x32_epi32(samples1, join0), 0x30));
+				_mm_storeu_si128((__m128i*)(dst + 16), _mm256_castsi256_si128(_mm256_blend_epi32(_mm256_permutevar8x32_epi32(samples0, join1), _mm256_permutevar8x32_epi32(samples1, join1), 0x0c)));
+			}
+
+			for (; i < blockCount; i++, src += kV210BlockBytes, dst += kV210BlockSamples)
+				V210UnpackBlockScalar(src, dst);
+		}
+
+		static void pack(const uint16_t* src, uint8_t* dst, size_t blockCount)
+		{
+			const __m256i maxSample	= _mm256_set1_epi16(kV210MaxSample);
+			const __m256i first0	= _mm256_setr_epi8(0, 1, -1, -1, 6, 7, -1, -1, 12, 13, -1, -1, -1, -1, -1, -1,
+														0, 1, -1, -1, 6, 7, -1, -1, 12, 13, -1, -1, -1, -1, -1, -1);
+			const __m256i first1	= _mm256_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 2, 3, -1, -1,
+														-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 2, 3, -1, -1);
+			const __m256i second0	= _mm256_setr_epi8(2, 3, -1, -1, 8, 9, -1, -1, 14, 15, -1, -1, -1, -1, -1, -1,
+														2, 3, -1, -1, 8, 9, -1, -1, 14, 15, -1, -1, -1, -1, -1, -1);
+			const __m256i second1	= _mm256_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 4, 5, -1, -1,
+														-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 4, 5, -1, -1);
+			const __m256i third0	= _mm256_setr_epi8(4, 5, -1, -1, 10, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1,
+														4, 5, -1, -1, 10, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+			const __m256i third1	= _mm256_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, 0, 1, -1, -1, 6, 7, -1, -1,
+														-1, -1, -1, -1, -1, -1, -1, -1, 0, 1, -1, -1, 6, 7, -1, -1);
+			size_t i;
+
+			for (i = 0; i + 2 <= blockCount; i += 2, src += 2 * kV210BlockSamples, dst += 2 * kV210BlockBytes)
+			{
+				// Lane n holds samples 0-7 and 8-11 of block n
+				__m128i loadLow		= _mm_loadu_si128((const __m128i*)src);
+				__m128i loadMiddle	= _mm_loadu_si128((const __m128i*)(src + 8));
+				__m128i loadHigh	= _mm_loadu_si128((const __m128i*)(src + 16));
+				__m256i samples0	= _mm256_min_epu16(_mm256_setr_m128i(loadLow, _mm_alignr_epi8(loadHigh, loadMiddle, 8)), maxSample);
+				__m256i samples1	= _mm256_min_epu16(_mm256_setr_m128i(loadMiddle, _mm_srli_si128(loadHigh, 8)), maxSample);
+				__m256i first		= _mm256_or_si256(_mm256_shuffle_epi8(samples0, first0), _mm256_shuffle_epi8(samples1, first1));
+				__m256i second		= _mm256_or_si256(_mm256_shuffle_epi8(samples0, second0), _mm256_shuffle_epi8(samples1, second1));
+				__m256i third		= _mm256_or_si256(_mm256_shuffle_epi8(samples0, third0), _mm256_shuffle_epi8(samples1, third1));
+
+				_mm256_storeu_si256((__m256i*)dst, _mm256_or_si256(first, _mm256_or_si256(_mm256_slli_epi32(second, 10), _mm256_slli_epi32(third, 20))));
+			}
+
+			for (; i < blockCount; i++, src += kV210BlockSamples, dst += kV210BlockBytes)
+				V210PackBlockScalar(src, dst);
+		}
+	};
+}
+
+const V210RowKernels* GetV210RowKernelsAVX2(void)
+{
+	static const V210RowKernels kernels = V210RowConverter<AVX2Blocks>::getKernels(V210KernelISA::AVX2, "AVX2");
+	return &kernels;
+}
@@ -0,0 +1,115 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+// Built with -mavx512f -mavx512bw
+#include <immintrin.h>
+#include "V210KernelsRow.h"
+
+namespace
+{
+	// As SSE41Blocks, with a block in each 128-bit lane, and two-source permutes to join the lanes
+	struct AVX512Blocks
+	{
+		static void unpack(const uint8_t* src, uint16_t* dst, size_t blockCount)
+		{
+			const __m512i mask			= _mm512_set1_epi32(kV210MaxSample);
+			const __m512i lowToLow		= _mm512_broadcast_i32x4(_mm_setr_epi8(0, 1, 2, 3, -1, -1, 4, 5, 6, 7, -1, -1, 8, 9, 10, 11));
+			const __m512i highToLow		= _mm512_broadcast_i32x4(_mm_setr_epi8(-1, -1, -1, -1, 0, 1, -1, -1, -1, -1, 4, 5, -1, -1, -1, -1));
+			const __m512i lowToHigh		= _mm512_broadcast_i32x4(_mm_setr_epi8(-1, -1, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1));
+			const __m512i highToHigh	= _mm512_broadcast_i32x4(_mm_setr_epi8(8, 9, -1, -1, -1, -1, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1));
+			// The 16 and 8 bytes of samples from each lane are joined into 96 contiguous bytes
+			const __m512i join0			= _mm512_setr_epi32(0, 1, 2, 3, 16, 17, 4, 5, 6, 7, 20, 21, 8, 9, 10, 11);
+			const __m512i join1			= _mm512_setr_epi32(24, 25, 12, 13, 14, 15, 28, 29, 0, 0, 0, 0, 0, 0, 0, 0);
+			size_t i;
+
+			for (i = 0; i + 4 <= blockCount; i += 4, src += 4 * kV210BlockBytes, dst += 4 * kV210BlockSamples)
+			{
+				__m512i words		= _mm512_loadu_si512(src);
+				__m512i low			= _mm512_or_si512(_mm512_and_si512(words, mask), _mm512_slli_epi32(_mm512_and_si512(_mm512_srli_epi32(words, 10), mask), 16));
+				__m512i high		= _mm512_and_si512(_mm512_srli_epi32(words, 20), mask);
+				__m512i samples0	= _mm512_or_si512(_mm512_shuffle_epi8(low, lowToLow), _mm512_shuffle_epi8(high, highToLow));
+				__m512i samples1	= _mm512_or_si512(_mm512_shuffle_epi8(low, lowToHigh), _mm512_shuffle_epi8(high, highToHigh));
+
+				_mm512_storeu_si512(dst, _mm512_permutex2var_epi32(samples0, join0, samples1));
+				_mm256_storeu_si256((__m256i*)(dst + 32), _mm512_castsi512_si256(_mm512_permutex2var_epi32(samples0, join1, samples1)));
+			}
+
+			for (; i < blockCount; i++, src += kV210BlockBytes, dst += kV210BlockSamples)
+				V210UnpackBlockScalar(src, dst);
+		}
+
+		static void pack(const uint16_t* src, uint8_t* dst, size_t blockCount)
+		{
+			const __m512i maxSample	= _mm512_set1_epi16(kV210MaxSample);
+			const __m512i first0	= _mm512_broadcast_i32x4(_mm_setr_epi8(0, 1, -1, -1, 6, 7, -1, -1, 12, 13, -1, -1, -1, -1, -1, -1));
+			const __m512i first1	= _mm512_broadcast_i32x4(_mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 2, 3, -1, -1));
+			const __m512i second0	= _mm512_broadcast_i32x4(_mm_setr_epi8(2, 3, -1, -1, 8, 9, -1, -1, 14, 15, -1, -1, -1, -1, -1, -1));
+			const __m512i second1	= _mm512_broadcast_i32x4(_mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 4, 5, -1, -1));
+			const __m512i third0	= _mm512_broadcast_i32x4(_mm_setr_epi8(4, 5, -1, -1, 10, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1));
+			const __m512i third1	= _mm512_broadcast_i32x4(_mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, 0, 1, -1, -1, 6, 7, -1, -1));
+			// Lane n gets samples 0-7 and 8-11 of block n from the 96 bytes loaded
+			const __m512i split0	= _mm512_setr_epi32(0, 1, 2, 3, 6, 7, 8, 9, 12, 13, 14, 15, 18, 19, 20, 21);
+			const __m512i split1	= _mm512_setr_epi32(4, 5, 0, 0, 10, 11, 0, 0, 16, 17, 0, 0, 22, 23, 0, 0);
+			size_t i;
+
+			for (i = 0; i + 4 <= blockCount; i += 4, src += 4 * kV210BlockSamples, dst += 4 * kV210BlockBytes)
+			{
+				__m512i loadLow		= _mm512_loadu_si512(src);
+				__m512i loadHigh	= _mm512_castsi256_si512(_mm256_loadu_si256((const __m256i*)(src + 32)));
+				__m512i samples0	= _mm512_min_epu16(_mm512_permutex2var_epi32(loadLow, split0, loadHigh), maxSample);
+				__m512i samples1	= _mm512_min_epu16(_mm512_permutex2var_epi32(loadLow, split1, loadHigh), maxSample);
+				__m512i first		= _mm512_or_si512(_mm512_shuffle_epi8(samples0, first0), _mm512_shuffle_epi8(samples1, first1));
+				__m512i second		= _mm512_or_si512(_mm512_shuffle_epi8(samples0, second0), _mm512_shuffle_epi8(samples1, second1));
+				__m512i third		= _mm512_or_si512(_mm512_shuffle_epi8(samples0, third0), _mm512_shuffle_epi8(samples1, third1));
+
+				_mm512_storeu_si512(dst, _mm512_or_si512(first, _mm512_or_si512(_mm512_slli_epi32(second, 10), _mm512_slli_epi32(third, 20))));
+			}
+
+			for (; i < blockCount; i++, src += kV210BlockSamples, dst += kV210BlockBytes)
+				V210PackBlockScalar(src, dst);
+		}
+	};
+}
+
+const V210RowKernels* GetV210RowKernelsAVX512(void)
+{
+	static const V210RowKernels kernels = V210RowConverter<AVX512Blocks>::getKernels(V210KernelISA::AVX512, "AVX-512");
+	return &kernels;
+}
@@ -0,0 +1,101 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+// NEON is always available on AArch64
+#include <arm_neon.h>
+#include "V210KernelsRow.h"
+
+namespace
+{
+	// The three samples of each word are narrowed to 16 bits and stored interleaved, two blocks at a time
+	struct NEONBlocks
+	{
+		static void unpack(const uint8_t* src, uint16_t* dst, size_t blockCount)
+		{
+			const uint32x4_t mask = vdupq_n_u32(kV210MaxSample);
+			size_t i;
+
+			for (i = 0; i + 2 <= blockCount; i += 2, src += 2 * kV210BlockBytes, dst += 2 * kV210BlockSamples)
+			{
+				uint32x4_t words0 = vld1q_u32((const uint32_t*)src);
+				uint32x4_t words1 = vld1q_u32((const uint32_t*)(src + kV210BlockBytes));
+				uint16x8x3_t samples;
+
+				samples.val[0] = vcombine_u16(vmovn_u32(vandq_u32(words0, mask)), vmovn_u32(vandq_u32(words1, mask)));
+				samples.val[1] = vcombine_u16(vmovn_u32(vandq_u32(vshrq_n_u32(words0, 10), mask)), vmovn_u32(vandq_u32(vshrq_n_u32(words1, 10), mask)));
+				samples.val[2] = vcombine_u16(vmovn_u32(vandq_u32(vshrq_n_u32(words0, 20), mask)), vmovn_u32(vandq_u32(vshrq_n_u32(words1, 20), mask)));
+
+				vst3q_u16(dst, samples);
+			}
+
+			for (; i < blockCount; i++, src += kV210BlockBytes, dst += kV210BlockSamples)
+				V210UnpackBlockScalar(src, dst);
+		}
+
+		static void pack(const uint16_t* src, uint8_t* dst, size_t blockCount)
+		{
+			const uint16x8_t maxSample = vdupq_n_u16(kV210MaxSample);
+			size_t i;
+
+			for (i = 0; i + 2 <= blockCount; i += 2, src += 2 * kV210BlockSamples, dst += 2 * kV210BlockBytes)
+			{
+				uint16x8x3_t samples = vld3q_u16(src);
+				uint16x8_t first = vminq_u16(samples.val[0], maxSample);
+				uint16x8_t second = vminq_u16(samples.val[1], maxSample);
+				uint16x8_t third = vminq_u16(samples.val[2], maxSample);
+
+				uint32x4_t words0 = vorrq_u32(vmovl_u16(vget_low_u16(first)), vorrq_u32(vshlq_n_u32(vmovl_u16(vget_low_u16(second)), 10), vshlq_n_u32(vmovl_u16(vget_low_u16(third)), 20)));
+				uint32x4_t words1 = vorrq_u32(vmovl_u16(vget_high_u16(first)), vorrq_u32(vshlq_n_u32(vmovl_u16(vget_high_u16(second)), 10), vshlq_n_u32(vmovl_u16(vget_high_u16(third)), 20)));
+
+				vst1q_u32((uint32_t*)dst, words0);
+				vst1q_u32((uint32_t*)(dst + kV210BlockBytes), words1);
+			}
+
+			for (; i < blockCount; i++, src += kV210BlockSamples, dst += kV210BlockBytes)
+				V210PackBlockScalar(src, dst);
+		}
+	};
+}
+
+const V210RowKernels* GetV210RowKernelsNEON(void)
+{
+	static const V210RowKernels kernels = V210RowConverter<NEONBlocks>::getKernels(V210KernelISA::NEON, "NEON");
+	return &kernels;
+}
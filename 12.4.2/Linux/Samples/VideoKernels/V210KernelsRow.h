@@ -0,0 +1,294 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#pragma once
+
+// Row kernels shared by the instruction set implementations in V210Kernels*.cpp; not part of the API
+
+#include <cstring>
+#include "V210Kernels.h"
+
+// Each file that includes this header is built for a different instruction set, so everything here has
+// internal linkage (and avoids std:: templates), otherwise the linker could pick an AVX-512 build of an
+// inline function for use by the scalar kernels.
+namespace
+{
+	// One v210 block of 6 pixels in 16 bytes holds 12 samples in Cb Y Cr Y order, three to each
+	// little-endian 32-bit word
+	const uint32_t kV210BlockPixels		= 6;
+	const uint32_t kV210BlockBytes		= 16;
+	const uint32_t kV210BlockSamples	= 12;
+	const uint16_t kV210MaxSample		= 0x3ff;
+
+	inline uint32_t V210Min(uint32_t a, uint32_t b)
+	{
+		return (a < b) ? a : b;
+	}
+
+	inline void V210UnpackBlockScalar(const uint8_t* src, uint16_t* dst)
+	{
+		for (int i = 0; i < 4; i++)
+		{
+			uint32_t word = src[4 * i] | (src[4 * i + 1] << 8) | (src[4 * i + 2] << 16) | ((uint32_t)src[4 * i + 3] << 24);
+
+			dst[3 * i]		= word & kV210MaxSample;
+			dst[3 * i + 1]	= (word >> 10) & kV210MaxSample;
+			dst[3 * i + 2]	= (word >> 20) & kV210MaxSample;
+		}
+	}
+
+	inline void V210PackBlockScalar(const uint16_t* src, uint8_t* dst)
+	{
+		for (int i = 0; i < 4; i++)
+		{
+			uint32_t word = V210Min(src[3 * i], kV210MaxSample) | (V210Min(src[3 * i + 1], kV210MaxSample) << 10) | (V210Min(src[3 * i + 2], kV210MaxSample) << 20);
+
+			dst[4 * i]		= word & 0xff;
+			dst[4 * i + 1]	= (word >> 8) & 0xff;
+			dst[4 * i + 2]	= (word >> 16) & 0xff;
+			dst[4 * i + 3]	= word >> 24;
+		}
+	}
+
+	// Row kernels for an instruction set, built on its Blocks::unpack() and Blocks::pack(), which convert
+	// whole v210 blocks to and from interleaved 16-bit samples.  Each row is converted in chunks through a
+	// line buffer that stays in L1 cache, and the compiler vectorises the loops over the line buffer for
+	// the instruction set of the file that instantiates the template.
+	template <typename Blocks>
+	class V210RowConverter
+	{
+	public:
+		static V210RowKernels getKernels(V210KernelISA isa, const char* name)
+		{
+			V210RowKernels kernels;
+
+			kernels.isa				= isa;
+			kernels.name			= name;
+			kernels.v210ToPlanar16	= v210ToPlanar16;
+			kernels.planar16ToV210	= planar16ToV210;
+			kernels.v210ToP010		= v210ToP010;
+			kernels.p010ToV210		= p010ToV210;
+			kernels.v210To2vuy		= v210To2vuy;
+			kernels.yuv2vuyToV210	= yuv2vuyToV210;
+			return kernels;
+		}
+
+	private:
+		static const uint32_t kChunkPixels = 64 * kV210BlockPixels;
+
+		static void v210ToPlanar16(const uint8_t* src, uint16_t* y, uint16_t* cb, uint16_t* cr, uint32_t width)
+		{
+			alignas(64) uint16_t line[kChunkPixels * 2];
+
+			for (uint32_t x = 0; x < width; x += kChunkPixels)
+			{
+				uint32_t pixels = V210Min(width - x, kChunkPixels);
+				uint16_t* __restrict yOut = y + x;
+				uint16_t* __restrict cbOut = cb + x / 2;
+				uint16_t* __restrict crOut = cr + x / 2;
+
+				unpackChunk(src + x / kV210BlockPixels * kV210BlockBytes, line, pixels);
+
+				for (uint32_t i = 0; i < pixels / 2; i++)
+				{
+					cbOut[i]		= line[4 * i];
+					yOut[2 * i]		= line[4 * i + 1];
+					crOut[i]		= line[4 * i + 2];
+					yOut[2 * i + 1]	= line[4 * i + 3];
+				}
+			}
+		}
+
+		static void planar16ToV210(const uint16_t* y, const uint16_t* cb, const uint16_t* cr, uint8_t* dst, uint32_t width)
+		{
+			alignas(64) uint16_t line[kChunkPixels * 2];
+
+			for (uint32_t x = 0; x < width; x += kChunkPixels)
+			{
+				uint32_t pixels = V210Min(width - x, kChunkPixels);
+				const uint16_t* __restrict yIn = y + x;
+				const uint16_t* __restrict cbIn = cb + x / 2;
+				const uint16_t* __restrict crIn = cr + x / 2;
+
+				for (uint32_t i = 0; i < pixels / 2; i++)
+				{
+					line[4 * i]		= cbIn[i];
+					line[4 * i + 1]	= yIn[2 * i];
+					line[4 * i + 2]	= crIn[i];
+					line[4 * i + 3]	= yIn[2 * i + 1];
+				}
+
+				packChunk(line, dst + x / kV210BlockPixels * kV210BlockBytes, pixels);
+			}
+		}
+
+		static void v210ToP010(const uint8_t* src0, const uint8_t* src1, uint16_t* y0, uint16_t* y1, uint16_t* cbcr, uint32_t width)
+		{
+			alignas(64) uint16_t line0[kChunkPixels * 2];
+			alignas(64) uint16_t line1[kChunkPixels * 2];
+
+			for (uint32_t x = 0; x < width; x += kChunkPixels)
+			{
+				uint32_t pixels = V210Min(width - x, kChunkPixels);
+				uint16_t* __restrict y0Out = y0 + x;
+				uint16_t* __restrict y1Out = y1 + x;
+				uint16_t* __restrict cbcrOut = cbcr + x;
+
+				unpackChunk(src0 + x / kV210BlockPixels * kV210BlockBytes, line0, pixels);
+				unpackChunk(src1 + x / kV210BlockPixels * kV210BlockBytes, line1, pixels);
+
+				for (uint32_t i = 0; i < pixels / 2; i++)
+				{
+					y0Out[2 * i]		= line0[4 * i + 1] << 6;
+					y0Out[2 * i + 1]	= line0[4 * i + 3] << 6;
+					y1Out[2 * i]		= line1[4 * i + 1] << 6;
+					y1Out[2 * i + 1]	= line1[4 * i + 3] << 6;
+					cbcrOut[2 * i]		= ((line0[4 * i] + line1[4 * i] + 1) >> 1) << 6;
+					cbcrOut[2 * i + 1]	= ((line0[4 * i + 2] + line1[4 * i + 2] + 1) >> 1) << 6;
+				}
+			}
+		}
+
+		static void p010ToV210(const uint16_t* y0, const uint16_t* y1, const uint16_t* cbcr, uint8_t* dst0, uint8_t* dst1, uint32_t width)
+		{
+			alignas(64) uint16_t line0[kChunkPixels * 2];
+			alignas(64) uint16_t line1[kChunkPixels * 2];
+
+			for (uint32_t x = 0; x < width; x += kChunkPixels)
+			{
+				uint32_t pixels = V210Min(width - x, kChunkPixels);
+				const uint16_t* __restrict y0In = y0 + x;
+				const uint16_t* __restrict y1In = y1 + x;
+				const uint16_t* __restrict cbcrIn = cbcr + x;
+
+				for (uint32_t i = 0; i < pixels / 2; i++)
+				{
+					uint16_t cb = cbcrIn[2 * i] >> 6;
+					uint16_t cr = cbcrIn[2 * i + 1] >> 6;
+
+					line0[4 * i]		= cb;
+					line0[4 * i + 1]	= y0In[2 * i] >> 6;
+					line0[4 * i + 2]	= cr;
+					line0[4 * i + 3]	= y0In[2 * i + 1] >> 6;
+					line1[4 * i]		= cb;
+					line1[4 * i + 1]	= y1In[2 * i] >> 6;
+					line1[4 * i + 2]	= cr;
+					line1[4 * i + 3]	= y1In[2 * i + 1] >> 6;
+				}
+
+				packChunk(line0, dst0 + x / kV210BlockPixels * kV210BlockBytes, pixels);
+				packChunk(line1, dst1 + x / kV210BlockPixels * kV210BlockBytes, pixels);
+			}
+		}
+
+		static void v210To2vuy(const uint8_t* src, uint8_t* dst, uint32_t width)
+		{
+			alignas(64) uint16_t line[kChunkPixels * 2];
+
+			for (uint32_t x = 0; x < width; x += kChunkPixels)
+			{
+				uint32_t pixels = V210Min(width - x, kChunkPixels);
+				uint8_t* __restrict out = dst + x * 2;
+
+				unpackChunk(src + x / kV210BlockPixels * kV210BlockBytes, line, pixels);
+
+				for (uint32_t i = 0; i < pixels * 2; i++)
+					out[i] = (uint8_t)V210Min((line[i] + 2) >> 2, 0xff);
+			}
+		}
+
+		static void yuv2vuyToV210(const uint8_t* src, uint8_t* dst, uint32_t width)
+		{
+			alignas(64) uint16_t line[kChunkPixels * 2];
+
+			for (uint32_t x = 0; x < width; x += kChunkPixels)
+			{
+				uint32_t pixels = V210Min(width - x, kChunkPixels);
+				const uint8_t* __restrict in = src + x * 2;
+
+				for (uint32_t i = 0; i < pixels * 2; i++)
+					line[i] = in[i] << 2;
+
+				packChunk(line, dst + x / kV210BlockPixels * kV210BlockBytes, pixels);
+			}
+		}
+
+		static void unpackChunk(const uint8_t* src, uint16_t* line, uint32_t pixels)
+		{
+			uint32_t blockCount = pixels / kV210BlockPixels;
+
+			Blocks::unpack(src, line, blockCount);
+
+			// A row that ends part way through a block
+			if (pixels % kV210BlockPixels)
+			{
+				uint16_t block[kV210BlockSamples];
+
+				V210UnpackBlockScalar(src + blockCount * kV210BlockBytes, block);
+				memcpy(line + blockCount * kV210BlockSamples, block, (pixels % kV210BlockPixels) * 2 * sizeof(uint16_t));
+			}
+		}
+
+		static void packChunk(const uint16_t* line, uint8_t* dst, uint32_t pixels)
+		{
+			uint32_t blockCount = pixels / kV210BlockPixels;
+
+			Blocks::pack(line, dst, blockCount);
+
+			if (pixels % kV210BlockPixels)
+			{
+				uint16_t block[kV210BlockSamples] = { 0 };
+
+				memcpy(block, line + blockCount * kV210BlockSamples, (pixels % kV210BlockPixels) * 2 * sizeof(uint16_t));
+				V210PackBlockScalar(block, dst + blockCount * kV210BlockBytes);
+			}
+		}
+	};
+}
+
+// Defined in the V210Kernels*.cpp file for each instruction set, which is built with the matching
+// compiler flags; only called once the CPU is known to support the instruction set
+#if defined(__x86_64__) || defined(__i386__)
+const V210RowKernels*	GetV210RowKernelsSSE41(void);
+const V210RowKernels*	GetV210RowKernelsAVX2(void);
+const V210RowKernels*	GetV210RowKernelsAVX512(void);
+#elif defined(__aarch64__)
+const V210RowKernels*	GetV210RowKernelsNEON(void);
+#endif
@@ -0,0 +1,98 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+// Built with -msse4.1
+#include <smmintrin.h>
+#include "V210KernelsRow.h"
+
+namespace
+{
+	struct SSE41Blocks
+	{
+		// Each 32-bit word is split into its three samples, which are shuffled into sample order
+		static void unpack(const uint8_t* src, uint16_t* dst, size_t blockCount)
+		{
+			const __m128i mask		= _mm_set1_epi32(kV210MaxSample);
+			const __m128i lowToLow	= _mm_setr_epi8(0, 1, 2, 3, -1, -1, 4, 5, 6, 7, -1, -1, 8, 9, 10, 11);
+			const __m128i highToLow	= _mm_setr_epi8(-1, -1, -1, -1, 0, 1, -1, -1, -1, -1, 4, 5, -1, -1, -1, -1);
+			const __m128i lowToHigh	= _mm_setr_epi8(-1, -1, 12, 13, 14, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+			const __m128i highToHigh	= _mm_setr_epi8(8, 9, -1, -1, -1, -1, 12, 13, -1, -1, -1, -1, -1, -1, -1, -1);
+
+			for (size_t i = 0; i < blockCount; i++, src += kV210BlockBytes, dst += kV210BlockSamples)
+			{
+				__m128i words	= _mm_loadu_si128((const __m128i*)src);
+				__m128i low		= _mm_or_si128(_mm_and_si128(words, mask), _mm_slli_epi32(_mm_and_si128(_mm_srli_epi32(words, 10), mask), 16));
+				__m128i high	= _mm_and_si128(_mm_srli_epi32(words, 20), mask);
+
+				_mm_storeu_si128((__m128i*)dst, _mm_or_si128(_mm_shuffle_epi8(low, lowToLow), _mm_shuffle_epi8(high, highToLow)));
+				_mm_storel_epi64((__m128i*)(dst + 8), _mm_or_si128(_mm_shuffle_epi8(low, lowToHigh), _mm_shuffle_epi8(high, highToHigh)));
+			}
+		}
+
+		// Samples 0-7 and 8-11 are gathered into the first, second and third sample of each word
+		static void pack(const uint16_t* src, uint8_t* dst, size_t blockCount)
+		{
+			const __m128i maxSample	= _mm_set1_epi16(kV210MaxSample);
+			const __m128i first0	= _mm_setr_epi8(0, 1, -1, -1, 6, 7, -1, -1, 12, 13, -1, -1, -1, -1, -1, -1);
+			const __m128i first1	= _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 2, 3, -1, -1);
+			const __m128i second0	= _mm_setr_epi8(2, 3, -1, -1, 8, 9, -1, -1, 14, 15, -1, -1, -1, -1, -1, -1);
+			const __m128i second1	= _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 4, 5, -1, -1);
+			const __m128i third0	= _mm_setr_epi8(4, 5, -1, -1, 10, 11, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1);
+			const __m128i third1	= _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, 0, 1, -1, -1, 6, 7, -1, -1);
+
+			for (size_t i = 0; i < blockCount; i++, src += kV210BlockSamples, dst += kV210BlockBytes)
+			{
+				__m128i samples0	= _mm_min_epu16(_mm_loadu_si128((const __m128i*)src), maxSample);
+				__m128i samples1	= _mm_min_epu16(_mm_loadl_epi64((const __m128i*)(src + 8)), maxSample);
+				__m128i first		= _mm_or_si128(_mm_shuffle_epi8(samples0, first0), _mm_shuffle_epi8(samples1, first1));
+				__m128i second		= _mm_or_si128(_mm_shuffle_epi8(samples0, second0), _mm_shuffle_epi8(samples1, second1));
+				__m128i third		= _mm_or_si128(_mm_shuffle_epi8(samples0, third0), _mm_shuffle_epi8(samples1, third1));
+
+				_mm_storeu_si128((__m128i*)dst, _mm_or_si128(first, _mm_or_si128(_mm_slli_epi32(second, 10), _mm_slli_epi32(third, 20))));
+			}
+		}
+	};
+}
+
+const V210RowKernels* GetV210RowKernelsSSE41(void)
+{
+	static const V210RowKernels kernels = V210RowConverter<SSE41Blocks>::getKernels(V210KernelISA::SSE41, "SSE4.1");
+	return &kernels;
+}
@@ -0,0 +1,128 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**
+** Permission is hereby granted, free of charge, to any person or organization
+** obtaining a copy of the software and accompanying documentation (the
+** "Software") to use, reproduce, display, distribute, sub-license, execute,
+** and transmit the Software, and to prepare derivative works of the Software,
+** and to permit third-parties to whom the Software is furnished to do so, in
+** accordance with:
+**
+** (1) if the Software is obtained from Blackmagic Design, the End User License
+** Agreement for the Software Development Kit (“EULA”) available at
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+**
+** (2) if the Software is obtained from any third party, such licensing terms
+** as notified by that third party,
+**
+** and all subject to the following:
+**
+** (3) the copyright notices in the Software and this entire statement,
+** including the above license grant, this restriction and the following
+** disclaimer, must be included in all copies of the Software, in whole or in
+** part, and all derivative works of the Software, unless such copies or
+** derivative works are solely in the form of machine-executable object code
+** generated by a source language processor.
+**
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+** DEALINGS IN THE SOFTWARE.
+**
+** A copy of the Software is available free of charge at
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+**
+** -LICENSE-END-
+*/
+
+#pragma once
+
+#include <algorithm>
+#include <cstring>
+#include <vector>
+
+// FIFO of interleaved audio sample frames, used for the output audio buffer and the audio loopback
+class AudioSampleBuffer
+{
+public:
+	AudioSampleBuffer() :
+		m_readOffset(0),
+		m_bytesPerSampleFrame(0)
+	{ }
+
+	// Changing the sample frame size discards any buffered samples
+	void setSampleFrameSize(uint32_t bytesPerSampleFrame)
+	{
+		if (bytesPerSampleFrame != m_bytesPerSampleFrame)
+		{
+			clear();
+			m_bytesPerSampleFrame = bytesPerSampleFrame;
+		}
+	}
+
+	uint32_t sampleFrameSize(void) const
+	{
+		return m_bytesPerSampleFrame;
+	}
+
+	uint32_t sampleFrameCount(void) const
+	{
+		return m_bytesPerSampleFrame ? (uint32_t)((m_data.size() - m_readOffset) / m_bytesPerSampleFrame) : 0;
+	}
+
+	// Append up to the buffer capacity, returning the number of sample frames written
+	uint32_t write(const void* samples, uint32_t sampleFrameCount, uint32_t capacity)
+	{
+		uint32_t buffered	= this->sampleFrameCount();
+		uint32_t count		= (buffered < capacity) ? std::min(sampleFrameCount, capacity - buffered) : 0;
+
+		if (count == 0 || m_bytesPerSampleFrame == 0)
+			return 0;
+
+		compact();
+
+		const uint8_t* bytes = (const uint8_t*)samples;
+		m_data.insert(m_data.end(), bytes, bytes + (size_t)count * m_bytesPerSampleFrame);
+		return count;
+	}
+
+	// Remove sample frames from the buffer, padding with silence on underrun.  Returns the number of buffered frames read.
+	uint32_t read(void* samples, uint32_t sampleFrameCount)
+	{
+		uint32_t count = std::min(sampleFrameCount, this->sampleFrameCount());
+		size_t bytes = (size_t)count * m_bytesPerSampleFrame;
+
+		if (samples)
+		{
+			memcpy(samples, m_data.data() + m_readOffset, bytes);
+			memset((uint8_t*)samples + bytes, 0, ((size_t)sampleFrameCount - count) * m_bytesPerSampleFrame);
+		}
+
+		m_readOffset += bytes;
+		return count;
+	}
+
+	void clear(void)
+	{
+		m_data.clear();
+		m_readOffset = 0;
+	}
+
+private:
+	std::vector<uint8_t>	m_data;
+	size_t					m_readOffset;
+	uint32_t				m_bytesPerSampleFrame;
+
+	void compact(void)
+	{
+		// Reclaim consumed samples once they make up half of the storage
+		if (m_readOffset > 0 && m_readOffset * 2 >= m_data.size())
+		{
+			m_data.erase(m_data.begin(), m_data.begin() + m_readOffset);
+			m_readOffset = 0;
+		}
+	}
+};
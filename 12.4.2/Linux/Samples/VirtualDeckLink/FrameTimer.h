@@ -0,0 +1,130 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**
+** Permission is hereby granted, free of charge, to any person or organization
+** obtaining a copy of the software and accompanying documentation (the
+** "Software") to use, reproduce, display, distribute, sub-license, execute,
+** and transmit the Software, and to prepare derivative works of the Software,
+** and to permit third-parties to whom the Software is furnished to do so, in
+** accordance with:
+**
+** (1) if the Software is obtained from Blackmagic Design, the End User License
+** Agreement for the Software Development Kit (“EULA”) available at
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+**
+** (2) if the Software is obtained from any third party, such licensing terms
+** as notified by that third party,
+**
+** and all subject to the following:
+**
+** (3) the copyright notices in the Software and this entire statement,
+** including the above license grant, this restriction and the following
+** disclaimer, must be included in all copies of the Software, in whole or in
+** part, and all derivative works of the Software, unless such copies or
+** derivative works are solely in the form of machine-executable object code
+** generated by a source language processor.
+**
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+** DEALINGS IN THE SOFTWARE.
+**
+** A copy of the Software is available free of charge at
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+**
+** -LICENSE-END-
+*/
+
+#pragma once
+
+#include <chrono>
+#include <time.h>
+#include "DeckLinkAPI.h"
+
+// Rescale a time value between time scales without accumulating rounding error
+inline BMDTimeValue ConvertTimeValue(BMDTimeValue value, BMDTimeScale fromScale, BMDTimeScale toScale)
+{
+	if (fromScale == toScale || fromScale == 0)
+		return value;
+
+	return (BMDTimeValue)(((__int128)value * toScale) / fromScale);
+}
+
+// Hardware reference clock shared by all virtual devices, CLOCK_MONOTONIC_RAW in nanoseconds as used
+// by the samples' reference time.  Frame timing runs on steady_clock, so its time points are translated.
+inline BMDTimeValue GetReferenceClockNanoseconds(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC_RAW, &ts);
+	return (BMDTimeValue)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+inline BMDTimeValue GetReferenceClockNanoseconds(std::chrono::steady_clock::time_point time)
+{
+	auto steadyNow = std::chrono::steady_clock::now();
+	return GetReferenceClockNanoseconds() + std::chrono::duration_cast<std::chrono::nanoseconds>(time - steadyNow).count();
+}
+
+// Generates frame boundaries for a display mode.  Each deadline is calculated from the start
+// time and frame index, rather than by adding durations, so late wake-ups do not drift the cadence.
+// A clock offset runs the cadence fast (positive) or slow (negative) by parts per million, as a
+// device that is not locked to the same reference as the others.
+class FrameTimer
+{
+public:
+	using time_point = std::chrono::steady_clock::time_point;
+
+	FrameTimer() :
+		m_frameDuration(0), m_timeScale(1), m_clockOffset(0)
+	{ }
+
+	void setClockOffset(int32_t partsPerMillion)
+	{
+		m_clockOffset = partsPerMillion;
+	}
+
+	void start(BMDTimeValue frameDuration, BMDTimeScale timeScale)
+	{
+		m_frameDuration	= frameDuration;
+		m_timeScale		= timeScale;
+		m_startTime		= std::chrono::steady_clock::now();
+	}
+
+	// Start with the cadence of an existing timer, so frame boundaries coincide
+	void start(BMDTimeValue frameDuration, BMDTimeScale timeScale, time_point startTime)
+	{
+		m_frameDuration	= frameDuration;
+		m_timeScale		= timeScale;
+		m_startTime		= startTime;
+	}
+
+	// Time at which the given frame boundary occurs
+	time_point deadline(uint64_t frameIndex) const
+	{
+		__int128 nanoseconds = ((__int128)frameIndex * m_frameDuration * 1000000000 * 1000000) / ((__int128)m_timeScale * (1000000 + m_clockOffset));
+		return m_startTime + std::chrono::nanoseconds((int64_t)nanoseconds);
+	}
+
+	// Index of the frame interval containing the given time
+	uint64_t frameIndexAt(time_point time) const
+	{
+		if (time <= m_startTime || m_frameDuration == 0)
+			return 0;
+
+		__int128 nanoseconds = std::chrono::duration_cast<std::chrono::nanoseconds>(time - m_startTime).count();
+		return (uint64_t)((nanoseconds * m_timeScale * (1000000 + m_clockOffset)) / ((__int128)m_frameDuration * 1000000000 * 1000000));
+	}
+
+	BMDTimeValue	frameDuration(void) const	{ return m_frameDuration; }
+	BMDTimeScale	timeScale(void) const		{ return m_timeScale; }
+	time_point		startTime(void) const		{ return m_startTime; }
+
+private:
+	BMDTimeValue	m_frameDuration;
+	BMDTimeScale	m_timeScale;
+	int32_t			m_clockOffset;
+	time_point		m_startTime;
+};
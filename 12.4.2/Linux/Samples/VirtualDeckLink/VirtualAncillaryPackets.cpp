@@ -0,0 +1,334 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**
+** Permission is hereby granted, free of charge, to any person or organization
+** obtaining a copy of the software and accompanying documentation (the
+** "Software") to use, reproduce, display, distribute, sub-license, execute,
+** and transmit the Software, and to prepare derivative works of the Software,
+** and to permit third-parties to whom the Software is furnished to do so, in
+** accordance with:
+**
+** (1) if the Software is obtained from Blackmagic Design, the End User License
+** Agreement for the Software Development Kit (“EULA”) available at
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+**
+** (2) if the Software is obtained from any third party, such licensing terms
+** as notified by that third party,
+**
+** and all subject to the following:
+**
+** (3) the copyright notices in the Software and this entire statement,
+** including the above license grant, this restriction and the following
+** disclaimer, must be included in all copies of the Software, in whole or in
+** part, and all derivative works of the Software, unless such copies or
+** derivative works are solely in the form of machine-executable object code
+** generated by a source language processor.
+**
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+** DEALINGS IN THE SOFTWARE.
+**
+** A copy of the Software is available free of charge at
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+**
+** -LICENSE-END-
+*/
+
+#include <algorithm>
+#include "VirtualAncillaryPackets.h"
+#include "platform.h"
+
+namespace
+{
+	// Add the SMPTE ST 291 parity bits to an 8-bit user data word
+	uint16_t toAncillaryWord(uint8_t value)
+	{
+		uint16_t word	= value;
+		uint8_t parity	= value;
+
+		parity ^= parity >> 4;
+		parity ^= parity >> 2;
+		parity ^= parity >> 1;
+
+		if (parity & 1)
+			word |= 0x100;
+		else
+			word |= 0x200;
+
+		return word;
+	}
+
+	class VirtualAncillaryPacketIterator : public IDeckLinkAncillaryPacketIterator
+	{
+	public:
+		explicit VirtualAncillaryPacketIterator(const std::vector<com_ptr<IDeckLinkAncillaryPacket>>& packets) :
+			m_refCount(1),
+			m_packets(packets),
+			m_index(0)
+		{ }
+		virtual ~VirtualAncillaryPacketIterator() = default;
+
+		HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, LPVOID *ppv) override
+		{
+			if (!ppv)
+				return E_INVALIDARG;
+
+			if (iid == IID_IUnknown || iid == IID_IDeckLinkAncillaryPacketIterator)
+			{
+				*ppv = static_cast<IDeckLinkAncillaryPacketIterator*>(this);
+				AddRef();
+				return S_OK;
+			}
+
+			*ppv = nullptr;
+			return E_NOINTERFACE;
+		}
+
+		ULONG STDMETHODCALLTYPE AddRef() override
+		{
+			return ++m_refCount;
+		}
+
+		ULONG STDMETHODCALLTYPE Release() override
+		{
+			ULONG newRefValue = --m_refCount;
+			if (newRefValue == 0)
+				delete this;
+
+			return newRefValue;
+		}
+
+		HRESULT STDMETHODCALLTYPE Next(IDeckLinkAncillaryPacket** packet) override
+		{
+			if (!packet)
+				return E_INVALIDARG;
+
+			if (m_index >= m_packets.size())
+			{
+				*packet = nullptr;
+				return S_FALSE;
+			}
+
+			*packet = m_packets[m_index++].get();
+			(*packet)->AddRef();
+			return S_OK;
+		}
+
+	private:
+		std::atomic<ULONG>								m_refCount;
+		std::vector<com_ptr<IDeckLinkAncillaryPacket>>	m_packets;
+		size_t											m_index;
+	};
+}
+
+/// VirtualAncillaryPacket
+
+VirtualAncillaryPacket::VirtualAncillaryPacket(uint8_t did, uint8_t sdid, uint32_t lineNumber, uint8_t dataStreamIndex, const uint8_t* data, uint32_t size) :
+	m_refCount(1),
+	m_did(did),
+	m_sdid(sdid),
+	m_lineNumber(lineNumber),
+	m_dataStreamIndex(dataStreamIndex),
+	m_data(data, data + size)
+{
+	m_data16.reserve(size);
+	for (uint8_t value : m_data)
+		m_data16.push_back(toAncillaryWord(value));
+}
+
+HRESULT VirtualAncillaryPacket::QueryInterface(REFIID iid, LPVOID *ppv)
+{
+	if (!ppv)
+		return E_INVALIDARG;
+
+	if (iid == IID_IUnknown || iid == IID_IDeckLinkAncillaryPacket)
+	{
+		*ppv = static_cast<IDeckLinkAncillaryPacket*>(this);
+		AddRef();
+		return S_OK;
+	}
+
+	*ppv = nullptr;
+	return E_NOINTERFACE;
+}
+
+ULONG VirtualAncillaryPacket::AddRef(void)
+{
+	return ++m_refCount;
+}
+
+ULONG VirtualAncillaryPacket::Release(void)
+{
+	ULONG newRefValue = --m_refCount;
+	if (newRefValue == 0)
+		delete this;
+
+	return newRefValue;
+}
+
+HRESULT VirtualAncillaryPacket::GetBytes(BMDAncillaryPacketFormat format, const void** data, uint32_t* size)
+{
+	switch (format)
+	{
+		case bmdAncillaryPacketFormatUInt8:
+			if (data)
+				*data = m_data.data();
+			if (size)
+				*size = (uint32_t)m_data.size();
+			return S_OK;
+
+		case bmdAncillaryPacketFormatUInt16:
+			if (data)
+				*data = m_data16.data();
+			if (size)
+				*size = (uint32_t)m_data16.size();
+			return S_OK;
+
+		default:
+			return E_NOTIMPL;
+	}
+}
+
+com_ptr<IDeckLinkAncillaryPacket> VirtualAncillaryPacket::copyOf(IDeckLinkAncillaryPacket* packet)
+{
+	const void*	data = nullptr;
+	uint32_t	size = 0;
+
+	if (packet->GetBytes(bmdAncillaryPacketFormatUInt8, &data, &size) != S_OK)
+		return nullptr;
+
+	com_ptr<VirtualAncillaryPacket> copy = make_com_ptr<VirtualAncillaryPacket>(packet->GetDID(), packet->GetSDID(), packet->GetLineNumber(),
+																				packet->GetDataStreamIndex(), (const uint8_t*)data, size);
+	return com_ptr<IDeckLinkAncillaryPacket>(copy.get());
+}
+
+/// VirtualAncillaryPackets
+
+VirtualAncillaryPackets::VirtualAncillaryPackets() :
+	m_refCount(1)
+{
+}
+
+HRESULT VirtualAncillaryPackets::QueryInterface(REFIID iid, LPVOID *ppv)
+{
+	if (!ppv)
+		return E_INVALIDARG;
+
+	if (iid == IID_IUnknown || iid == IID_IDeckLinkVideoFrameAncillaryPackets)
+	{
+		*ppv = static_cast<IDeckLinkVideoFrameAncillaryPackets*>(this);
+		AddRef();
+		return S_OK;
+	}
+
+	*ppv = nullptr;
+	return E_NOINTERFACE;
+}
+
+ULONG VirtualAncillaryPackets::AddRef(void)
+{
+	return ++m_refCount;
+}
+
+ULONG VirtualAncillaryPackets::Release(void)
+{
+	ULONG newRefValue = --m_refCount;
+	if (newRefValue == 0)
+		delete this;
+
+	return newRefValue;
+}
+
+HRESULT VirtualAncillaryPackets::GetPacketIterator(IDeckLinkAncillaryPacketIterator** iterator)
+{
+	if (!iterator)
+		return E_INVALIDARG;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	*iterator = new VirtualAncillaryPacketIterator(m_packets);
+	return S_OK;
+}
+
+HRESULT VirtualAncillaryPackets::GetFirstPacketByID(uint8_t DID, uint8_t SDID, IDeckLinkAncillaryPacket** packet)
+{
+	if (!packet)
+		return E_INVALIDARG;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	for (auto& candidate : m_packets)
+	{
+		if (candidate->GetDID() == DID && candidate->GetSDID() == SDID)
+		{
+			*packet = candidate.get();
+			(*packet)->AddRef();
+			return S_OK;
+		}
+	}
+
+	*packet = nullptr;
+	return S_FALSE;
+}
+
+HRESULT VirtualAncillaryPackets::AttachPacket(IDeckLinkAncillaryPacket* packet)
+{
+	if (!packet)
+		return E_INVALIDARG;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_packets.push_back(com_ptr<IDeckLinkAncillaryPacket>(packet));
+	return S_OK;
+}
+
+HRESULT VirtualAncillaryPackets::DetachPacket(IDeckLinkAncillaryPacket* packet)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	auto iter = std::find_if(m_packets.begin(), m_packets.end(), [packet](const com_ptr<IDeckLinkAncillaryPacket>& p) { return p.get() == packet; });
+	if (iter == m_packets.end())
+		return E_INVALIDARG;
+
+	m_packets.erase(iter);
+	return S_OK;
+}
+
+HRESULT VirtualAncillaryPackets::DetachAllPackets(void)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_packets.clear();
+	return S_OK;
+}
+
+void VirtualAncillaryPackets::copyFrom(IDeckLinkVideoFrame* frame)
+{
+	com_ptr<IDeckLinkVideoFrameAncillaryPackets>	sourcePackets;
+	com_ptr<IDeckLinkAncillaryPacketIterator>		iterator;
+	com_ptr<IDeckLinkAncillaryPacket>				packet;
+	std::vector<com_ptr<IDeckLinkAncillaryPacket>>	copies;
+
+	if (frame->QueryInterface(IID_IDeckLinkVideoFrameAncillaryPackets, (void**)sourcePackets.releaseAndGetAddressOf()) == S_OK)
+	{
+		if (sourcePackets->GetPacketIterator(iterator.releaseAndGetAddressOf()) == S_OK)
+		{
+			while (iterator->Next(packet.releaseAndGetAddressOf()) == S_OK)
+			{
+				com_ptr<IDeckLinkAncillaryPacket> copy = VirtualAncillaryPacket::copyOf(packet.get());
+				if (copy)
+					copies.push_back(copy);
+			}
+		}
+	}
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_packets.swap(copies);
+}
+
+bool VirtualAncillaryPackets::empty(void)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_packets.empty();
+}
@@ -0,0 +1,107 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**
+** Permission is hereby granted, free of charge, to any person or organization
+** obtaining a copy of the software and accompanying documentation (the
+** "Software") to use, reproduce, display, distribute, sub-license, execute,
+** and transmit the Software, and to prepare derivative works of the Software,
+** and to permit third-parties to whom the Software is furnished to do so, in
+** accordance with:
+**
+** (1) if the Software is obtained from Blackmagic Design, the End User License
+** Agreement for the Software Development Kit (“EULA”) available at
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+**
+** (2) if the Software is obtained from any third party, such licensing terms
+** as notified by that third party,
+**
+** and all subject to the following:
+**
+** (3) the copyright notices in the Software and this entire statement,
+** including the above license grant, this restriction and the following
+** disclaimer, must be included in all copies of the Software, in whole or in
+** part, and all derivative works of the Software, unless such copies or
+** derivative works are solely in the form of machine-executable object code
+** generated by a source language processor.
+**
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+** DEALINGS IN THE SOFTWARE.
+**
+** A copy of the Software is available free of charge at
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+**
+** -LICENSE-END-
+*/
+
+#pragma once
+
+#include <atomic>
+#include <mutex>
+#include <vector>
+#include "DeckLinkAPI.h"
+#include "com_ptr.h"
+
+// Ancillary packet captured by a virtual input, holding a copy of the 8-bit user data words
+class VirtualAncillaryPacket : public IDeckLinkAncillaryPacket
+{
+public:
+	VirtualAncillaryPacket(uint8_t did, uint8_t sdid, uint32_t lineNumber, uint8_t dataStreamIndex, const uint8_t* data, uint32_t size);
+	virtual ~VirtualAncillaryPacket() = default;
+
+	// IUnknown interface
+	HRESULT		STDMETHODCALLTYPE QueryInterface(REFIID iid, LPVOID *ppv) override;
+	ULONG		STDMETHODCALLTYPE AddRef() override;
+	ULONG		STDMETHODCALLTYPE Release() override;
+
+	// IDeckLinkAncillaryPacket interface
+	HRESULT		STDMETHODCALLTYPE GetBytes(BMDAncillaryPacketFormat format, const void** data, uint32_t* size) override;
+	uint8_t		STDMETHODCALLTYPE GetDID(void) override				{ return m_did; }
+	uint8_t		STDMETHODCALLTYPE GetSDID(void) override			{ return m_sdid; }
+	uint32_t	STDMETHODCALLTYPE GetLineNumber(void) override		{ return m_lineNumber; }
+	uint8_t		STDMETHODCALLTYPE GetDataStreamIndex(void) override	{ return m_dataStreamIndex; }
+
+	// Copy any packet, including application implementations, through its 8-bit representation
+	static com_ptr<IDeckLinkAncillaryPacket> copyOf(IDeckLinkAncillaryPacket* packet);
+
+private:
+	std::atomic<ULONG>		m_refCount;
+	uint8_t					m_did;
+	uint8_t					m_sdid;
+	uint32_t				m_lineNumber;
+	uint8_t					m_dataStreamIndex;
+	std::vector<uint8_t>	m_data;
+	std::vector<uint16_t>	m_data16;
+};
+
+class VirtualAncillaryPackets : public IDeckLinkVideoFrameAncillaryPackets
+{
+public:
+	VirtualAncillaryPackets();
+	virtual ~VirtualAncillaryPackets() = default;
+
+	// IUnknown interface
+	HRESULT		STDMETHODCALLTYPE QueryInterface(REFIID iid, LPVOID *ppv) override;
+	ULONG		STDMETHODCALLTYPE AddRef() override;
+	ULONG		STDMETHODCALLTYPE Release() override;
+
+	// IDeckLinkVideoFrameAncillaryPackets interface
+	HRESULT		STDMETHODCALLTYPE GetPacketIterator(IDeckLinkAncillaryPacketIterator** iterator) override;
+	HRESULT		STDMETHODCALLTYPE GetFirstPacketByID(uint8_t DID, uint8_t SDID, IDeckLinkAncillaryPacket** packet) override;
+	HRESULT		STDMETHODCALLTYPE AttachPacket(IDeckLinkAncillaryPacket* packet) override;
+	HRESULT		STDMETHODCALLTYPE DetachPacket(IDeckLinkAncillaryPacket* packet) override;
+	HRESULT		STDMETHODCALLTYPE DetachAllPackets(void) override;
+
+	// Replace the packets with copies of those attached to another frame
+	void		copyFrom(IDeckLinkVideoFrame* frame);
+	bool		empty(void);
+
+private:
+	std::atomic<ULONG>									m_refCount;
+	std::mutex											m_mutex;
+	std::vector<com_ptr<IDeckLinkAncillaryPacket>>		m_packets;
+};
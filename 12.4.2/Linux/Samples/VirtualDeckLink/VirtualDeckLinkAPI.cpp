@@ -0,0 +1,286 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**
+** Permission is hereby granted, free of charge, to any person or organization
+** obtaining a copy of the software and accompanying documentation (the
+** "Software") to use, reproduce, display, distribute, sub-license, execute,
+** and transmit the Software, and to prepare derivative works of the Software,
+** and to permit third-parties to whom the Software is furnished to do so, in
+** accordance with:
+**
+** (1) if the Software is obtained from Blackmagic Design, the End User License
+** Agreement for the Software Development Kit (“EULA”) available at
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+**
+** (2) if the Software is obtained from any third party, such licensing terms
+** as notified by that third party,
+**
+** and all subject to the following:
+**
+** (3) the copyright notices in the Software and this entire statement,
+** including the above license grant, this restriction and the following
+** disclaimer, must be included in all copies of the Software, in whole or in
+** part, and all derivative works of the Software, unless such copies or
+** derivative works are solely in the form of machine-executable object code
+** generated by a source language processor.
+**
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+** DEALINGS IN THE SOFTWARE.
+**
+** A copy of the Software is available free of charge at
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+**
+** -LICENSE-END-
+*/
+
+#include <atomic>
+#include <mutex>
+#include <thread>
+#include "DeckLinkAPI.h"
+#include "DeckLinkAPIVersion.h"
+#include "VirtualAncillaryPackets.h"
+#include "VirtualDeckLinkDevice.h"
+#include "VirtualDeckLinkSettings.h"
+#include "VirtualVideoConversion.h"
+#include "com_ptr.h"
+#include "platform.h"
+
+namespace
+{
+	class VirtualDeckLinkIterator : public IDeckLinkIterator
+	{
+	public:
+		VirtualDeckLinkIterator() : m_refCount(1), m_index(0) { }
+		virtual ~VirtualDeckLinkIterator() = default;
+
+		HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, LPVOID *ppv) override
+		{
+			if (!ppv)
+				return E_INVALIDARG;
+
+			if (iid == IID_IUnknown || iid == IID_IDeckLinkIterator)
+			{
+				*ppv = static_cast<IDeckLinkIterator*>(this);
+				AddRef();
+				return S_OK;
+			}
+
+			*ppv = nullptr;
+			return E_NOINTERFACE;
+		}
+
+		ULONG STDMETHODCALLTYPE AddRef() override
+		{
+			return ++m_refCount;
+		}
+
+		ULONG STDMETHODCALLTYPE Release() override
+		{
+			ULONG newRefValue = --m_refCount;
+			if (newRefValue == 0)
+				delete this;
+
+			return newRefValue;
+		}
+
+		HRESULT STDMETHODCALLTYPE Next(IDeckLink** deckLinkInstance) override
+		{
+			if (!deckLinkInstance)
+				return E_INVALIDARG;
+
+			VirtualDeckLinkDevice* device = VirtualDeckLinkDevice::getDevice(m_index);
+			if (!device)
+			{
+				*deckLinkInstance = nullptr;
+				return S_FALSE;
+			}
+
+			m_index++;
+			device->AddRef();
+			*deckLinkInstance = device;
+			return S_OK;
+		}
+
+	private:
+		std::atomic<ULONG>	m_refCount;
+		uint32_t			m_index;
+	};
+
+	class VirtualDeckLinkDiscovery : public IDeckLinkDiscovery
+	{
+	public:
+		VirtualDeckLinkDiscovery() : m_refCount(1) { }
+
+		virtual ~VirtualDeckLinkDiscovery()
+		{
+			UninstallDeviceNotifications();
+		}
+
+		HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, LPVOID *ppv) override
+		{
+			if (!ppv)
+				return E_INVALIDARG;
+
+			if (iid == IID_IUnknown || iid == IID_IDeckLinkDiscovery)
+			{
+				*ppv = static_cast<IDeckLinkDiscovery*>(this);
+				AddRef();
+				return S_OK;
+			}
+
+			*ppv = nullptr;
+			return E_NOINTERFACE;
+		}
+
+		ULONG STDMETHODCALLTYPE AddRef() override
+		{
+			return ++m_refCount;
+		}
+
+		ULONG STDMETHODCALLTYPE Release() override
+		{
+			ULONG newRefValue = --m_refCount;
+			if (newRefValue == 0)
+				delete this;
+
+			return newRefValue;
+		}
+
+		HRESULT STDMETHODCALLTYPE InstallDeviceNotifications(IDeckLinkDeviceNotificationCallback* deviceNotificationCallback) override
+		{
+			if (!deviceNotificationCallback)
+				return E_INVALIDARG;
+
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			if (m_notificationThread.joinable())
+				return E_FAIL;
+
+			// Devices are announced from another thread, as the driver does when they are discovered
+			com_ptr<IDeckLinkDeviceNotificationCallback> callback(deviceNotificationCallback);
+			m_notificationThread = std::thread([callback]() mutable
+			{
+				for (uint32_t index = 0; index < VirtualDeckLinkSettings::get().deviceCount; index++)
+					callback->DeckLinkDeviceArrived(VirtualDeckLinkDevice::getDevice(index));
+			});
+			return S_OK;
+		}
+
+		HRESULT STDMETHODCALLTYPE UninstallDeviceNotifications(void) override
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+
+			if (m_notificationThread.joinable())
+				m_notificationThread.join();
+
+			return S_OK;
+		}
+
+	private:
+		std::atomic<ULONG>	m_refCount;
+		std::mutex			m_mutex;
+		std::thread			m_notificationThread;
+	};
+
+	class VirtualDeckLinkAPIInformation : public IDeckLinkAPIInformation
+	{
+	public:
+		VirtualDeckLinkAPIInformation() : m_refCount(1) { }
+		virtual ~VirtualDeckLinkAPIInformation() = default;
+
+		HRESULT STDMETHODCALLTYPE QueryInterface(REFIID iid, LPVOID *ppv) override
+		{
+			if (!ppv)
+				return E_INVALIDARG;
+
+			if (iid == IID_IUnknown || iid == IID_IDeckLinkAPIInformation)
+			{
+				*ppv = static_cast<IDeckLinkAPIInformation*>(this);
+				AddRef();
+				return S_OK;
+			}
+
+			*ppv = nullptr;
+			return E_NOINTERFACE;
+		}
+
+		ULONG STDMETHODCALLTYPE AddRef() override
+		{
+			return ++m_refCount;
+		}
+
+		ULONG STDMETHODCALLTYPE Release() override
+		{
+			ULONG newRefValue = --m_refCount;
+			if (newRefValue == 0)
+				delete this;
+
+			return newRefValue;
+		}
+
+		HRESULT STDMETHODCALLTYPE GetFlag(BMDDeckLinkAPIInformationID cfgID, bool* value) override
+		{
+			return E_INVALIDARG;
+		}
+
+		HRESULT STDMETHODCALLTYPE GetInt(BMDDeckLinkAPIInformationID cfgID, int64_t* value) override
+		{
+			if (!value || cfgID != BMDDeckLinkAPIVersion)
+				return E_INVALIDARG;
+
+			*value = BLACKMAGIC_DECKLINK_API_VERSION;
+			return S_OK;
+		}
+
+		HRESULT STDMETHODCALLTYPE GetFloat(BMDDeckLinkAPIInformationID cfgID, double* value) override
+		{
+			return E_INVALIDARG;
+		}
+
+		HRESULT STDMETHODCALLTYPE GetString(BMDDeckLinkAPIInformationID cfgID, const char** value) override
+		{
+			if (!value || cfgID != BMDDeckLinkAPIVersion)
+				return E_INVALIDARG;
+
+			*value = CopyString(BLACKMAGIC_DECKLINK_API_VERSION_STRING);
+			return S_OK;
+		}
+
+	private:
+		std::atomic<ULONG>	m_refCount;
+	};
+}
+
+// Entry points resolved by name in DeckLinkAPIDispatch.cpp
+extern "C"
+{
+	VIRTUAL_DECKLINK_EXPORT IDeckLinkIterator* CreateDeckLinkIteratorInstance_0004(void)
+	{
+		return new VirtualDeckLinkIterator();
+	}
+
+	VIRTUAL_DECKLINK_EXPORT IDeckLinkDiscovery* CreateDeckLinkDiscoveryInstance_0003(void)
+	{
+		return new VirtualDeckLinkDiscovery();
+	}
+
+	VIRTUAL_DECKLINK_EXPORT IDeckLinkAPIInformation* CreateDeckLinkAPIInformationInstance_0001(void)
+	{
+		return new VirtualDeckLinkAPIInformation();
+	}
+
+	VIRTUAL_DECKLINK_EXPORT IDeckLinkVideoConversion* CreateVideoConversionInstance_0001(void)
+	{
+		return new VirtualVideoConversion();
+	}
+
+	VIRTUAL_DECKLINK_EXPORT IDeckLinkVideoFrameAncillaryPackets* CreateVideoFrameAncillaryPacketsInstance_0001(void)
+	{
+		return new VirtualAncillaryPackets();
+	}
+}
@@ -0,0 +1,577 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**
+** Permission is hereby granted, free of charge, to any person or organization
+** obtaining a copy of the software and accompanying documentation (the
+** "Software") to use, reproduce, display, distribute, sub-license, execute,
+** and transmit the Software, and to prepare derivative works of the Software,
+** and to permit third-parties to whom the Software is furnished to do so, in
+** accordance with:
+**
+** (1) if the Software is obtained from Blackmagic Design, the End User License
+** Agreement for the Software Development Kit (“EULA”) available at
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+**
+** (2) if the Software is obtained from any third party, such licensing terms
+** as notified by that third party,
+**
+** and all subject to the following:
+**
+** (3) the copyright notices in the Software and this entire statement,
+** including the above license grant, this restriction and the following
+** disclaimer, must be included in all copies of the Software, in whole or in
+** part, and all derivative works of the Software, unless such copies or
+** derivative works are solely in the form of machine-executable object code
+** generated by a source language processor.
+**
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+** DEALINGS IN THE SOFTWARE.
+**
+** A copy of the Software is available free of charge at
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+**
+** -LICENSE-END-
+*/
+
+#include <cstring>
+#include <vector>
+#include "VirtualDeckLinkDevice.h"
+#include "VirtualDeckLinkInput.h"
+#include "VirtualDeckLinkOutput.h"
+#include "VirtualDeckLinkSettings.h"
+#include "VirtualDisplayMode.h"
+#include "platform.h"
+
+// Loopback audio is buffered for up to one second, beyond which the oldest output is lost
+static const uint32_t kLoopbackAudioSampleFrames = bmdAudioSampleRate48kHz;
+
+/// VirtualDeckLinkAttributes
+
+HRESULT VirtualDeckLinkAttributes::QueryInterface(REFIID iid, LPVOID *ppv)
+{
+	return m_device->QueryInterface(iid, ppv);
+}
+
+ULONG VirtualDeckLinkAttributes::AddRef(void)
+{
+	return m_device->AddRef();
+}
+
+ULONG VirtualDeckLinkAttributes::Release(void)
+{
+	return m_device->Release();
+}
+
+HRESULT VirtualDeckLinkAttributes::GetFlag(BMDDeckLinkAttributeID cfgID, bool* value)
+{
+	if (!value)
+		return E_INVALIDARG;
+
+	switch (cfgID)
+	{
+		case BMDDeckLinkSupportsInputFormatDetection:
+		case BMDDeckLinkHasReferenceInput:
+		case BMDDeckLinkSupportsColorspaceMetadata:
+		case BMDDeckLinkSupportsHighFrameRateTimecode:
+		case BMDDeckLinkSupportsSynchronizeToCaptureGroup:
+		case BMDDeckLinkSupportsSynchronizeToPlaybackGroup:
+			*value = true;
+			return S_OK;
+
+		case BMDDeckLinkSupportsInternalKeying:
+		case BMDDeckLinkSupportsExternalKeying:
+		case BMDDeckLinkHasSerialPort:
+		case BMDDeckLinkHasAnalogVideoOutputGain:
+		case BMDDeckLinkCanOnlyAdjustOverallVideoOutputGain:
+		case BMDDeckLinkHasVideoInputAntiAliasingFilter:
+		case BMDDeckLinkHasBypass:
+		case BMDDeckLinkSupportsClockTimingAdjustment:
+		case BMDDeckLinkSupportsFullFrameReferenceInputTimingOffset:
+		case BMDDeckLinkSupportsSMPTELevelAOutput:
+		case BMDDeckLinkSupportsAutoSwitchingPPsFOnInput:
+		case BMDDeckLinkSupportsDualLinkSDI:
+		case BMDDeckLinkSupportsQuadLinkSDI:
+		case BMDDeckLinkSupportsIdleOutput:
+		case BMDDeckLinkVANCRequires10BitYUVVideoFrames:
+		case BMDDeckLinkHasLTCTimecodeInput:
+		case BMDDeckLinkSupportsHDRMetadata:
+		case BMDDeckLinkSupportsHDMITimecode:
+			*value = false;
+			return S_OK;
+
+		default:
+			return E_INVALIDARG;
+	}
+}
+
+HRESULT VirtualDeckLinkAttributes::GetInt(BMDDeckLinkAttributeID cfgID, int64_t* value)
+{
+	if (!value)
+		return E_INVALIDARG;
+
+	switch (cfgID)
+	{
+		case BMDDeckLinkMaximumAudioChannels:
+			*value = 16;
+			return S_OK;
+
+		case BMDDeckLinkNumberOfSubDevices:
+			*value = 1;
+			return S_OK;
+
+		case BMDDeckLinkSubDeviceIndex:
+			*value = 0;
+			return S_OK;
+
+		case BMDDeckLinkPersistentID:
+		case BMDDeckLinkTopologicalID:
+			*value = 0x56444C00 + m_device->getIndex();
+			return S_OK;
+
+		case BMDDeckLinkDeviceGroupID:
+			*value = 0x56444C00;
+			return S_OK;
+
+		case BMDDeckLinkVideoOutputConnections:
+		case BMDDeckLinkVideoInputConnections:
+			*value = bmdVideoConnectionSDI;
+			return S_OK;
+
+		case BMDDeckLinkAudioOutputConnections:
+		case BMDDeckLinkAudioInputConnections:
+			*value = bmdAudioConnectionEmbedded;
+			return S_OK;
+
+		case BMDDeckLinkVideoIOSupport:
+			*value = bmdDeviceSupportsCapture | bmdDeviceSupportsPlayback;
+			return S_OK;
+
+		case BMDDeckLinkDeviceInterface:
+			*value = bmdDeviceInterfacePCI;
+			return S_OK;
+
+		case BMDDeckLinkProfileID:
+			*value = bmdProfileOneSubDeviceFullDuplex;
+			return S_OK;
+
+		case BMDDeckLinkDuplex:
+			*value = bmdDuplexFull;
+			return S_OK;
+
+		case BMDDeckLinkMinimumPrerollFrames:
+			*value = 1;
+			return S_OK;
+
+		default:
+			return E_INVALIDARG;
+	}
+}
+
+HRESULT VirtualDeckLinkAttributes::GetFloat(BMDDeckLinkAttributeID cfgID, double* value)
+{
+	return E_INVALIDARG;
+}
+
+HRESULT VirtualDeckLinkAttributes::GetString(BMDDeckLinkAttributeID cfgID, const char** value)
+{
+	if (!value)
+		return E_INVALIDARG;
+
+	switch (cfgID)
+	{
+		case BMDDeckLinkVendorName:
+			*value = CopyString("Blackmagic Design");
+			return S_OK;
+
+		case BMDDeckLinkModelName:
+			*value = CopyString(m_device->getModelName().c_str());
+			return S_OK;
+
+		case BMDDeckLinkDisplayName:
+			*value = CopyString(m_device->getDisplayName().c_str());
+			return S_OK;
+
+		default:
+			return E_INVALIDARG;
+	}
+}
+
+/// VirtualDeckLinkStatus
+
+HRESULT VirtualDeckLinkStatus::QueryInterface(REFIID iid, LPVOID *ppv)
+{
+	return m_device->QueryInterface(iid, ppv);
+}
+
+ULONG VirtualDeckLinkStatus::AddRef(void)
+{
+	return m_device->AddRef();
+}
+
+ULONG VirtualDeckLinkStatus::Release(void)
+{
+	return m_device->Release();
+}
+
+HRESULT VirtualDeckLinkStatus::GetFlag(BMDDeckLinkStatusID statusID, bool* value)
+{
+	if (!value)
+		return E_INVALIDARG;
+
+	switch (statusID)
+	{
+		case bmdDeckLinkStatusVideoInputSignalLocked:
+			*value = m_device->getInput()->getStatus().videoEnabled;
+			return S_OK;
+
+		case bmdDeckLinkStatusReferenceSignalLocked:
+			*value = true;
+			return S_OK;
+
+		default:
+			return E_INVALIDARG;
+	}
+}
+
+HRESULT VirtualDeckLinkStatus::GetInt(BMDDeckLinkStatusID statusID, int64_t* value)
+{
+	VirtualInputStatus	inputStatus;
+	VirtualOutputStatus	outputStatus;
+
+	if (!value)
+		return E_INVALIDARG;
+
+	switch (statusID)
+	{
+		case bmdDeckLinkStatusDetectedVideoInputMode:
+		case bmdDeckLinkStatusDetectedVideoInputFormatFlags:
+		case bmdDeckLinkStatusDetectedVideoInputFieldDominance:
+			inputStatus = m_device->getInput()->getStatus();
+			if (!inputStatus.videoEnabled)
+				return E_FAIL;
+
+			if (statusID == bmdDeckLinkStatusDetectedVideoInputMode)
+				*value = inputStatus.signalMode;
+			else if (statusID == bmdDeckLinkStatusDetectedVideoInputFormatFlags)
+				*value = inputStatus.detectedFlags;
+			else
+				*value = FindVirtualDisplayMode(inputStatus.signalMode)->fieldDominance;
+			return S_OK;
+
+		case bmdDeckLinkStatusCurrentVideoInputMode:
+		case bmdDeckLinkStatusCurrentVideoInputPixelFormat:
+		case bmdDeckLinkStatusCurrentVideoInputFlags:
+			inputStatus = m_device->getInput()->getStatus();
+			if (!inputStatus.videoEnabled)
+				return E_FAIL;
+
+			if (statusID == bmdDeckLinkStatusCurrentVideoInputMode)
+				*value = inputStatus.displayMode;
+			else if (statusID == bmdDeckLinkStatusCurrentVideoInputPixelFormat)
+				*value = inputStatus.pixelFormat;
+			else
+				*value = inputStatus.flags;
+			return S_OK;
+
+		case bmdDeckLinkStatusCurrentVideoOutputMode:
+		case bmdDeckLinkStatusCurrentVideoOutputFlags:
+		case bmdDeckLinkStatusLastVideoOutputPixelFormat:
+			outputStatus = m_device->getOutput()->getStatus();
+			if (!outputStatus.videoEnabled)
+				return E_FAIL;
+
+			if (statusID == bmdDeckLinkStatusCurrentVideoOutputMode)
+				*value = outputStatus.displayMode;
+			else if (statusID == bmdDeckLinkStatusCurrentVideoOutputFlags)
+				*value = outputStatus.flags;
+			else
+				*value = outputStatus.lastPixelFormat;
+			return S_OK;
+
+		case bmdDeckLinkStatusReferenceSignalMode:
+			*value = bmdModeUnknown;
+			return S_OK;
+
+		case bmdDeckLinkStatusReferenceSignalFlags:
+			*value = 0;
+			return S_OK;
+
+		case bmdDeckLinkStatusBusy:
+			*value = (m_device->getInput()->getStatus().videoEnabled ? bmdDeviceCaptureBusy : 0) |
+						(m_device->getOutput()->getStatus().videoEnabled ? bmdDevicePlaybackBusy : 0);
+			return S_OK;
+
+		case bmdDeckLinkStatusPCIExpressLinkWidth:
+			*value = 8;
+			return S_OK;
+
+		case bmdDeckLinkStatusPCIExpressLinkSpeed:
+			*value = 3;
+			return S_OK;
+
+		case bmdDeckLinkStatusDeviceTemperature:
+			*value = 45;
+			return S_OK;
+
+		default:
+			return E_INVALIDARG;
+	}
+}
+
+HRESULT VirtualDeckLinkStatus::GetFloat(BMDDeckLinkStatusID statusID, double* value)
+{
+	return E_INVALIDARG;
+}
+
+HRESULT VirtualDeckLinkStatus::GetString(BMDDeckLinkStatusID statusID, const char** value)
+{
+	return E_INVALIDARG;
+}
+
+HRESULT VirtualDeckLinkStatus::GetBytes(BMDDeckLinkStatusID statusID, void* buffer, uint32_t* bufferSize)
+{
+	return E_NOTIMPL;
+}
+
+/// VirtualDeckLinkConfiguration
+
+HRESULT VirtualDeckLinkConfiguration::QueryInterface(REFIID iid, LPVOID *ppv)
+{
+	return m_device->QueryInterface(iid, ppv);
+}
+
+ULONG VirtualDeckLinkConfiguration::AddRef(void)
+{
+	return m_device->AddRef();
+}
+
+ULONG VirtualDeckLinkConfiguration::Release(void)
+{
+	return m_device->Release();
+}
+
+HRESULT VirtualDeckLinkConfiguration::SetFlag(BMDDeckLinkConfigurationID cfgID, bool value)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_flags[cfgID] = value;
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkConfiguration::GetFlag(BMDDeckLinkConfigurationID cfgID, bool* value)
+{
+	if (!value)
+		return E_INVALIDARG;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto iter = m_flags.find(cfgID);
+	*value = (iter != m_flags.end()) ? iter->second : false;
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkConfiguration::SetInt(BMDDeckLinkConfigurationID cfgID, int64_t value)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_ints[cfgID] = value;
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkConfiguration::GetInt(BMDDeckLinkConfigurationID cfgID, int64_t* value)
+{
+	if (!value)
+		return E_INVALIDARG;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto iter = m_ints.find(cfgID);
+	*value = (iter != m_ints.end()) ? iter->second : 0;
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkConfiguration::SetFloat(BMDDeckLinkConfigurationID cfgID, double value)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_floats[cfgID] = value;
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkConfiguration::GetFloat(BMDDeckLinkConfigurationID cfgID, double* value)
+{
+	if (!value)
+		return E_INVALIDARG;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto iter = m_floats.find(cfgID);
+	*value = (iter != m_floats.end()) ? iter->second : 0.0;
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkConfiguration::SetString(BMDDeckLinkConfigurationID cfgID, const char* value)
+{
+	if (!value)
+		return E_INVALIDARG;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_strings[cfgID] = value;
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkConfiguration::GetString(BMDDeckLinkConfigurationID cfgID, const char** value)
+{
+	if (!value)
+		return E_INVALIDARG;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	auto iter = m_strings.find(cfgID);
+	*value = CopyString((iter != m_strings.end()) ? iter->second.c_str() : "");
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkConfiguration::WriteConfigurationToPreferences(void)
+{
+	return S_OK;
+}
+
+/// VirtualDeckLinkDevice
+
+VirtualDeckLinkDevice::VirtualDeckLinkDevice(uint32_t index) :
+	m_refCount(1),
+	m_index(index),
+	m_modelName("DeckLink Virtual"),
+	m_displayName("DeckLink Virtual (" + std::to_string(index + 1) + ")"),
+	m_loopbackAudioSampleType(bmdAudioSampleType16bitInteger),
+	m_loopbackAudioChannelCount(0)
+{
+	m_input.reset(new VirtualDeckLinkInput(this));
+	m_output.reset(new VirtualDeckLinkOutput(this));
+	m_attributes.reset(new VirtualDeckLinkAttributes(this));
+	m_status.reset(new VirtualDeckLinkStatus(this));
+	m_configuration.reset(new VirtualDeckLinkConfiguration(this));
+}
+
+VirtualDeckLinkDevice::~VirtualDeckLinkDevice()
+{
+}
+
+HRESULT VirtualDeckLinkDevice::QueryInterface(REFIID iid, LPVOID *ppv)
+{
+	if (!ppv)
+		return E_INVALIDARG;
+
+	if (iid == IID_IUnknown || iid == IID_IDeckLink)
+		*ppv = static_cast<IDeckLink*>(this);
+	else if (iid == IID_IDeckLinkInput)
+		*ppv = static_cast<IDeckLinkInput*>(m_input.get());
+	else if (iid == IID_IDeckLinkOutput)
+		*ppv = static_cast<IDeckLinkOutput*>(m_output.get());
+	else if (iid == IID_IDeckLinkProfileAttributes)
+		*ppv = static_cast<IDeckLinkProfileAttributes*>(m_attributes.get());
+	else if (iid == IID_IDeckLinkStatus)
+		*ppv = static_cast<IDeckLinkStatus*>(m_status.get());
+	else if (iid == IID_IDeckLinkConfiguration)
+		*ppv = static_cast<IDeckLinkConfiguration*>(m_configuration.get());
+	else
+	{
+		*ppv = nullptr;
+		return E_NOINTERFACE;
+	}
+
+	AddRef();
+	return S_OK;
+}
+
+ULONG VirtualDeckLinkDevice::AddRef(void)
+{
+	return ++m_refCount;
+}
+
+ULONG VirtualDeckLinkDevice::Release(void)
+{
+	// The registry holds the initial reference, so devices are never destroyed
+	return --m_refCount;
+}
+
+HRESULT VirtualDeckLinkDevice::GetModelName(const char** modelName)
+{
+	if (!modelName)
+		return E_INVALIDARG;
+
+	*modelName = CopyString(m_modelName.c_str());
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkDevice::GetDisplayName(const char** displayName)
+{
+	if (!displayName)
+		return E_INVALIDARG;
+
+	*displayName = CopyString(m_displayName.c_str());
+	return S_OK;
+}
+
+VirtualDeckLinkDevice* VirtualDeckLinkDevice::getDevice(uint32_t index)
+{
+	static std::mutex							registryMutex;
+	static std::vector<VirtualDeckLinkDevice*>	registry;
+
+	std::lock_guard<std::mutex> lock(registryMutex);
+
+	if (index >= VirtualDeckLinkSettings::get().deviceCount)
+		return nullptr;
+
+	if (registry.empty())
+		registry.resize(VirtualDeckLinkSettings::get().deviceCount, nullptr);
+
+	if (!registry[index])
+		registry[index] = new VirtualDeckLinkDevice(index);
+
+	return registry[index];
+}
+
+void VirtualDeckLinkDevice::setLoopbackFrame(IDeckLinkVideoFrame* frame)
+{
+	std::lock_guard<std::mutex> lock(m_loopbackMutex);
+	m_loopbackFrame = frame;
+}
+
+com_ptr<IDeckLinkVideoFrame> VirtualDeckLinkDevice::getLoopbackFrame(void)
+{
+	std::lock_guard<std::mutex> lock(m_loopbackMutex);
+	return m_loopbackFrame;
+}
+
+void VirtualDeckLinkDevice::writeLoopbackAudio(const void* samples, uint32_t sampleFrameCount, BMDAudioSampleType sampleType, uint32_t channelCount)
+{
+	std::lock_guard<std::mutex> lock(m_loopbackMutex);
+
+	if (sampleType != m_loopbackAudioSampleType || channelCount != m_loopbackAudioChannelCount)
+	{
+		m_loopbackAudioSampleType	= sampleType;
+		m_loopbackAudioChannelCount	= channelCount;
+		m_loopbackAudio.setSampleFrameSize((sampleType / 8) * channelCount);
+	}
+
+	// Without a reader the oldest samples are discarded to make room
+	uint32_t buffered = m_loopbackAudio.sampleFrameCount();
+	if (buffered + sampleFrameCount > kLoopbackAudioSampleFrames)
+		m_loopbackAudio.read(nullptr, buffered + sampleFrameCount - kLoopbackAudioSampleFrames);
+
+	m_loopbackAudio.write(samples, sampleFrameCount, kLoopbackAudioSampleFrames);
+}
+
+void VirtualDeckLinkDevice::readLoopbackAudio(void* samples, uint32_t sampleFrameCount, BMDAudioSampleType sampleType, uint32_t channelCount)
+{
+	std::lock_guard<std::mutex> lock(m_loopbackMutex);
+
+	// Audio output in a different format to the input is heard as silence
+	if (sampleType != m_loopbackAudioSampleType || channelCount != m_loopbackAudioChannelCount)
+	{
+		memset(samples, 0, (size_t)sampleFrameCount * (sampleType / 8) * channelCount);
+		return;
+	}
+
+	m_loopbackAudio.read(samples, sampleFrameCount);
+}
@@ -0,0 +1,181 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**
+** Permission is hereby granted, free of charge, to any person or organization
+** obtaining a copy of the software and accompanying documentation (the
+** "Software") to use, reproduce, display, distribute, sub-license, execute,
+** and transmit the Software, and to prepare derivative works of the Software,
+** and to permit third-parties to whom the Software is furnished to do so, in
+** accordance with:
+**
+** (1) if the Software is obtained from Blackmagic Design, the End User License
+** Agreement for the Software Development Kit (“EULA”) available at
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+**
+** (2) if the Software is obtained from any third party, such licensing terms
+** as notified by that third party,
+**
+** and all subject to the following:
+**
+** (3) the copyright notices in the Software and this entire statement,
+** including the above license grant, this restriction and the following
+** disclaimer, must be included in all copies of the Software, in whole or in
+** part, and all derivative works of the Software, unless such copies or
+** derivative works are solely in the form of machine-executable object code
+** generated by a source language processor.
+**
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+** DEALINGS IN THE SOFTWARE.
+**
+** A copy of the Software is available free of charge at
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+**
+** -LICENSE-END-
+*/
+
+#pragma once
+
+#include <atomic>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include "DeckLinkAPI.h"
+#include "AudioSampleBuffer.h"
+#include "com_ptr.h"
+
+class VirtualDeckLinkDevice;
+class VirtualDeckLinkInput;
+class VirtualDeckLinkOutput;
+
+// The attributes, status and configuration interfaces have identical method signatures, so each
+// is implemented by its own object.  All of them share the reference count of the owning device.
+class VirtualDeckLinkAttributes : public IDeckLinkProfileAttributes
+{
+public:
+	explicit VirtualDeckLinkAttributes(VirtualDeckLinkDevice* device) : m_device(device) { }
+	virtual ~VirtualDeckLinkAttributes() = default;
+
+	// IUnknown interface
+	HRESULT		STDMETHODCALLTYPE QueryInterface(REFIID iid, LPVOID *ppv) override;
+	ULONG		STDMETHODCALLTYPE AddRef() override;
+	ULONG		STDMETHODCALLTYPE Release() override;
+
+	// IDeckLinkProfileAttributes interface
+	HRESULT		STDMETHODCALLTYPE GetFlag(BMDDeckLinkAttributeID cfgID, bool* value) override;
+	HRESULT		STDMETHODCALLTYPE GetInt(BMDDeckLinkAttributeID cfgID, int64_t* value) override;
+	HRESULT		STDMETHODCALLTYPE GetFloat(BMDDeckLinkAttributeID cfgID, double* value) override;
+	HRESULT		STDMETHODCALLTYPE GetString(BMDDeckLinkAttributeID cfgID, const char** value) override;
+
+private:
+	VirtualDeckLinkDevice*	m_device;
+};
+
+class VirtualDeckLinkStatus : public IDeckLinkStatus
+{
+public:
+	explicit VirtualDeckLinkStatus(VirtualDeckLinkDevice* device) : m_device(device) { }
+	virtual ~VirtualDeckLinkStatus() = default;
+
+	// IUnknown interface
+	HRESULT		STDMETHODCALLTYPE QueryInterface(REFIID iid, LPVOID *ppv) override;
+	ULONG		STDMETHODCALLTYPE AddRef() override;
+	ULONG		STDMETHODCALLTYPE Release() override;
+
+	// IDeckLinkStatus interface
+	HRESULT		STDMETHODCALLTYPE GetFlag(BMDDeckLinkStatusID statusID, bool* value) override;
+	HRESULT		STDMETHODCALLTYPE GetInt(BMDDeckLinkStatusID statusID, int64_t* value) override;
+	HRESULT		STDMETHODCALLTYPE GetFloat(BMDDeckLinkStatusID statusID, double* value) override;
+	HRESULT		STDMETHODCALLTYPE GetString(BMDDeckLinkStatusID statusID, const char** value) override;
+	HRESULT		STDMETHODCALLTYPE GetBytes(BMDDeckLinkStatusID statusID, void* buffer, uint32_t* bufferSize) override;
+
+private:
+	VirtualDeckLinkDevice*	m_device;
+};
+
+class VirtualDeckLinkConfiguration : public IDeckLinkConfiguration
+{
+public:
+	explicit VirtualDeckLinkConfiguration(VirtualDeckLinkDevice* device) : m_device(device) { }
+	virtual ~VirtualDeckLinkConfiguration() = default;
+
+	// IUnknown interface
+	HRESULT		STDMETHODCALLTYPE QueryInterface(REFIID iid, LPVOID *ppv) override;
+	ULONG		STDMETHODCALLTYPE AddRef() override;
+	ULONG		STDMETHODCALLTYPE Release() override;
+
+	// IDeckLinkConfiguration interface
+	HRESULT		STDMETHODCALLTYPE SetFlag(BMDDeckLinkConfigurationID cfgID, bool value) override;
+	HRESULT		STDMETHODCALLTYPE GetFlag(BMDDeckLinkConfigurationID cfgID, bool* value) override;
+	HRESULT		STDMETHODCALLTYPE SetInt(BMDDeckLinkConfigurationID cfgID, int64_t value) override;
+	HRESULT		STDMETHODCALLTYPE GetInt(BMDDeckLinkConfigurationID cfgID, int64_t* value) override;
+	HRESULT		STDMETHODCALLTYPE SetFloat(BMDDeckLinkConfigurationID cfgID, double value) override;
+	HRESULT		STDMETHODCALLTYPE GetFloat(BMDDeckLinkConfigurationID cfgID, double* value) override;
+	HRESULT		STDMETHODCALLTYPE SetString(BMDDeckLinkConfigurationID cfgID, const char* value) override;
+	HRESULT		STDMETHODCALLTYPE GetString(BMDDeckLinkConfigurationID cfgID, const char** value) override;
+	HRESULT		STDMETHODCALLTYPE WriteConfigurationToPreferences(void) override;
+
+private:
+	VirtualDeckLinkDevice*							m_device;
+	std::mutex										m_mutex;
+	// Settings are accepted and stored, only the capture group affects the virtual hardware
+	std::map<BMDDeckLinkConfigurationID, bool>			m_flags;
+	std::map<BMDDeckLinkConfigurationID, int64_t>		m_ints;
+	std::map<BMDDeckLinkConfigurationID, double>		m_floats;
+	std::map<BMDDeckLinkConfigurationID, std::string>	m_strings;
+};
+
+class VirtualDeckLinkDevice : public IDeckLink
+{
+public:
+	explicit VirtualDeckLinkDevice(uint32_t index);
+	virtual ~VirtualDeckLinkDevice();
+
+	// IUnknown interface
+	HRESULT		STDMETHODCALLTYPE QueryInterface(REFIID iid, LPVOID *ppv) override;
+	ULONG		STDMETHODCALLTYPE AddRef() override;
+	ULONG		STDMETHODCALLTYPE Release() override;
+
+	// IDeckLink interface
+	HRESULT		STDMETHODCALLTYPE GetModelName(const char** modelName) override;
+	HRESULT		STDMETHODCALLTYPE GetDisplayName(const char** displayName) override;
+
+	// Devices are created on first use and live for the remainder of the process, like the hardware they stand in for
+	static VirtualDeckLinkDevice*	getDevice(uint32_t index);
+
+	uint32_t					getIndex(void) const		{ return m_index; }
+	const std::string&			getModelName(void) const	{ return m_modelName; }
+	const std::string&			getDisplayName(void) const	{ return m_displayName; }
+	VirtualDeckLinkInput*		getInput(void)				{ return m_input.get(); }
+	VirtualDeckLinkOutput*		getOutput(void)				{ return m_output.get(); }
+	VirtualDeckLinkConfiguration*	getConfiguration(void)	{ return m_configuration.get(); }
+
+	// Loopback from this device's output to its input
+	void							setLoopbackFrame(IDeckLinkVideoFrame* frame);
+	com_ptr<IDeckLinkVideoFrame>	getLoopbackFrame(void);
+	void							writeLoopbackAudio(const void* samples, uint32_t sampleFrameCount, BMDAudioSampleType sampleType, uint32_t channelCount);
+	void							readLoopbackAudio(void* samples, uint32_t sampleFrameCount, BMDAudioSampleType sampleType, uint32_t channelCount);
+
+private:
+	std::atomic<ULONG>								m_refCount;
+	uint32_t										m_index;
+	std::string										m_modelName;
+	std::string										m_displayName;
+	//
+	std::unique_ptr<VirtualDeckLinkInput>			m_input;
+	std::unique_ptr<VirtualDeckLinkOutput>			m_output;
+	std::unique_ptr<VirtualDeckLinkAttributes>		m_attributes;
+	std::unique_ptr<VirtualDeckLinkStatus>			m_status;
+	std::unique_ptr<VirtualDeckLinkConfiguration>	m_configuration;
+	//
+	std::mutex										m_loopbackMutex;
+	com_ptr<IDeckLinkVideoFrame>					m_loopbackFrame;
+	AudioSampleBuffer								m_loopbackAudio;
+	BMDAudioSampleType								m_loopbackAudioSampleType;
+	uint32_t										m_loopbackAudioChannelCount;
+};
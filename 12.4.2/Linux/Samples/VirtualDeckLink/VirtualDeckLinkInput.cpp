@@ -0,0 +1,607 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**
+** Permission is hereby granted, free of charge, to any person or organization
+** obtaining a copy of the software and accompanying documentation (the
+** "Software") to use, reproduce, display, distribute, sub-license, execute,
+** and transmit the Software, and to prepare derivative works of the Software,
+** and to permit third-parties to whom the Software is furnished to do so, in
+** accordance with:
+**
+** (1) if the Software is obtained from Blackmagic Design, the End User License
+** Agreement for the Software Development Kit (“EULA”) available at
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+**
+** (2) if the Software is obtained from any third party, such licensing terms
+** as notified by that third party,
+**
+** and all subject to the following:
+**
+** (3) the copyright notices in the Software and this entire statement,
+** including the above license grant, this restriction and the following
+** disclaimer, must be included in all copies of the Software, in whole or in
+** part, and all derivative works of the Software, unless such copies or
+** derivative works are solely in the form of machine-executable object code
+** generated by a source language processor.
+**
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+** DEALINGS IN THE SOFTWARE.
+**
+** A copy of the Software is available free of charge at
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+**
+** -LICENSE-END-
+*/
+
+#include <cstring>
+#include <map>
+#include <tuple>
+#include "VirtualDeckLinkInput.h"
+#include "PixelFormatTraits.h"
+#include "VirtualDeckLinkDevice.h"
+#include "VirtualDisplayMode.h"
+#include "VirtualMemoryAllocator.h"
+#include "VirtualVideoConversion.h"
+#include "VirtualVideoFrame.h"
+#include "platform.h"
+
+static const BMDTimeScale kAudioSampleRate = bmdAudioSampleRate48kHz;
+
+// Number of audio sample frames captured with a video frame, so that 29.97 and 59.94 follow the 1602/1601 sample cadence
+static inline uint32_t audioSampleFrameCount(uint64_t frameIndex, BMDTimeValue frameDuration, BMDTimeScale timeScale)
+{
+	return (uint32_t)(ConvertTimeValue((frameIndex + 1) * frameDuration, timeScale, kAudioSampleRate) -
+						ConvertTimeValue(frameIndex * frameDuration, timeScale, kAudioSampleRate));
+}
+
+// Start of the frame cadence shared by inputs of a capture group at a frame rate.  The first input to start
+// establishes it, and it is kept for the life of the process, as the group's reference is on hardware.
+static FrameTimer::time_point captureGroupStartTime(int64_t captureGroup, BMDTimeValue frameDuration, BMDTimeScale timeScale)
+{
+	static std::mutex mutex;
+	static std::map<std::tuple<int64_t, BMDTimeValue, BMDTimeScale>, FrameTimer::time_point> startTimes;
+
+	std::lock_guard<std::mutex> lock(mutex);
+	auto result = startTimes.emplace(std::make_tuple(captureGroup, frameDuration, timeScale), std::chrono::steady_clock::now());
+	return result.first->second;
+}
+
+VirtualDeckLinkInput::VirtualDeckLinkInput(VirtualDeckLinkDevice* device) :
+	m_device(device),
+	m_faultInjector(VirtualDeckLinkSettings::get().seed + device->getIndex() * 2),
+	m_defaultAllocator(make_com_ptr<VirtualMemoryAllocator>().get()),
+	m_allocator(m_defaultAllocator),
+	m_videoEnabled(false),
+	m_displayMode(bmdModeUnknown),
+	m_pixelFormat(bmdFormatUnspecified),
+	m_flags(bmdVideoInputFlagDefault),
+	m_signalMode(bmdModeUnknown),
+	m_audioEnabled(false),
+	m_audioSampleType(bmdAudioSampleType16bitInteger),
+	m_audioChannelCount(0),
+	m_streamState(StreamState::Stopped),
+	m_generation(0),
+	m_frameIndex(0),
+	m_streamFrameOffset(0),
+	m_framesSinceFormatChange(0),
+	m_formatChangeIndex(0),
+	m_callbackActive(false)
+{
+	m_frameTimer.setClockOffset(VirtualDeckLinkSettings::get().inputClockOffset);
+}
+
+HRESULT VirtualDeckLinkInput::QueryInterface(REFIID iid, LPVOID *ppv)
+{
+	return m_device->QueryInterface(iid, ppv);
+}
+
+ULONG VirtualDeckLinkInput::AddRef(void)
+{
+	return m_device->AddRef();
+}
+
+ULONG VirtualDeckLinkInput::Release(void)
+{
+	return m_device->Release();
+}
+
+HRESULT VirtualDeckLinkInput::DoesSupportVideoMode(BMDVideoConnection connection, BMDDisplayMode requestedMode, BMDPixelFormat requestedPixelFormat, BMDVideoInputConversionMode conversionMode, BMDSupportedVideoModeFlags flags, BMDDisplayMode* actualMode, bool* supported)
+{
+	const VirtualDisplayModeInfo* modeInfo = FindVirtualDisplayMode(requestedMode);
+
+	if (!supported)
+		return E_INVALIDARG;
+
+	*supported = (modeInfo != nullptr) &&
+					(connection == bmdVideoConnectionUnspecified || (connection & bmdVideoConnectionSDI)) &&
+					(conversionMode == bmdNoVideoInputConversion) &&
+					(requestedPixelFormat == bmdFormatUnspecified || IsVirtualPixelFormatSupported(requestedPixelFormat)) &&
+					(!(flags & bmdSupportedVideoModeDualStream3D) || (modeInfo->flags & bmdDisplayModeSupports3D));
+
+	if (actualMode)
+		*actualMode = *supported ? requestedMode : bmdModeUnknown;
+
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkInput::GetDisplayMode(BMDDisplayMode displayMode, IDeckLinkDisplayMode** resultDisplayMode)
+{
+	const VirtualDisplayModeInfo* modeInfo = FindVirtualDisplayMode(displayMode);
+
+	if (!resultDisplayMode)
+		return E_INVALIDARG;
+
+	if (!modeInfo)
+	{
+		*resultDisplayMode = nullptr;
+		return E_INVALIDARG;
+	}
+
+	*resultDisplayMode = new VirtualDisplayMode(*modeInfo);
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkInput::GetDisplayModeIterator(IDeckLinkDisplayModeIterator** iterator)
+{
+	if (!iterator)
+		return E_INVALIDARG;
+
+	*iterator = new VirtualDisplayModeIterator();
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkInput::SetScreenPreviewCallback(IDeckLinkScreenPreviewCallback* previewCallback)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_previewCallback = previewCallback;
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkInput::EnableVideoInput(BMDDisplayMode displayMode, BMDPixelFormat pixelFormat, BMDVideoInputFlags flags)
+{
+	const VirtualDisplayModeInfo* modeInfo = FindVirtualDisplayMode(displayMode);
+
+	if (!modeInfo || !IsVirtualPixelFormatSupported(pixelFormat))
+		return E_INVALIDARG;
+
+	// Colour bars stand in for the input signal whenever nothing is looped back, render them once per format
+	long rowBytes = GetPixelFormatRowBytes(pixelFormat, modeInfo->width);
+	std::shared_ptr<std::vector<uint8_t>> pattern = std::make_shared<std::vector<uint8_t>>((size_t)rowBytes * modeInfo->height);
+	FillVirtualColorBars(pixelFormat, pattern->data(), modeInfo->width, modeInfo->height, rowBytes);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	// As on hardware, the frame allocator is committed while video input is enabled
+	if (!m_videoEnabled)
+		m_allocator->Commit();
+
+	m_videoEnabled	= true;
+	m_displayMode	= displayMode;
+	m_pixelFormat	= pixelFormat;
+	m_flags			= flags;
+	m_signalMode	= displayMode;
+	m_pattern		= pattern;
+	m_generation++;
+
+	// Changing the display mode while streaming restarts the frame cadence at the new rate
+	if (m_streamState == StreamState::Running)
+	{
+		m_streamFrameOffset	+= m_frameIndex;
+		restartFrameCadence(modeInfo);
+	}
+
+	if (!m_thread.joinable())
+		m_thread = std::thread(&VirtualDeckLinkInput::streamThread, this);
+
+	m_condition.notify_all();
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkInput::DisableVideoInput(void)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	bool wasEnabled = m_videoEnabled;
+
+	m_videoEnabled	= false;
+	m_streamState	= StreamState::Stopped;
+	m_pattern.reset();
+	m_generation++;
+	m_condition.notify_all();
+
+	waitForCallback(lock);
+
+	if (wasEnabled)
+		m_allocator->Decommit();
+
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkInput::GetAvailableVideoFrameCount(uint32_t* availableFrameCount)
+{
+	if (!availableFrameCount)
+		return E_INVALIDARG;
+
+	// Frames are always delivered through the callback
+	*availableFrameCount = 0;
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkInput::SetVideoInputFrameMemoryAllocator(IDeckLinkMemoryAllocator* theAllocator)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (theAllocator)
+		m_allocator = theAllocator;
+	else
+		m_allocator = m_defaultAllocator;
+
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkInput::EnableAudioInput(BMDAudioSampleRate sampleRate, BMDAudioSampleType sampleType, uint32_t channelCount)
+{
+	if (sampleRate != bmdAudioSampleRate48kHz)
+		return E_INVALIDARG;
+
+	if (sampleType != bmdAudioSampleType16bitInteger && sampleType != bmdAudioSampleType32bitInteger)
+		return E_INVALIDARG;
+
+	if (channelCount != 2 && channelCount != 8 && channelCount != 16)
+		return E_INVALIDARG;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_audioEnabled		= true;
+	m_audioSampleType	= sampleType;
+	m_audioChannelCount	= channelCount;
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkInput::DisableAudioInput(void)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_audioEnabled = false;
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkInput::GetAvailableAudioSampleFrameCount(uint32_t* availableSampleFrameCount)
+{
+	if (!availableSampleFrameCount)
+		return E_INVALIDARG;
+
+	*availableSampleFrameCount = 0;
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkInput::StartStreams(void)
+{
+	const VirtualDisplayModeInfo* modeInfo;
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (!m_videoEnabled)
+		return E_FAIL;
+
+	modeInfo = FindVirtualDisplayMode(m_displayMode);
+
+	if (m_streamState == StreamState::Paused)
+	{
+		// Resume with stream time continuing from the last delivered frame
+		m_streamFrameOffset += m_frameIndex;
+	}
+	else
+	{
+		m_streamFrameOffset			= 0;
+		m_framesSinceFormatChange	= 0;
+	}
+
+	m_streamState	= StreamState::Running;
+	restartFrameCadence(modeInfo);
+	m_generation++;
+	m_condition.notify_all();
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkInput::StopStreams(void)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	m_streamState = StreamState::Stopped;
+	m_generation++;
+	m_condition.notify_all();
+
+	waitForCallback(lock);
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkInput::PauseStreams(void)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	if (m_streamState != StreamState::Running)
+		return S_OK;
+
+	m_streamState = StreamState::Paused;
+	m_generation++;
+	m_condition.notify_all();
+
+	waitForCallback(lock);
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkInput::FlushStreams(void)
+{
+	// Frames are not queued inside the driver, so there is nothing to discard
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkInput::SetCallback(IDeckLinkInputCallback* theCallback)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_callback = theCallback;
+
+	// Once cleared, the previous callback must not be called again
+	if (!theCallback)
+		waitForCallback(lock);
+
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkInput::GetHardwareReferenceClock(BMDTimeScale desiredTimeScale, BMDTimeValue* hardwareTime, BMDTimeValue* timeInFrame, BMDTimeValue* ticksPerFrame)
+{
+	FrameTimer::time_point now = std::chrono::steady_clock::now();
+
+	if (!hardwareTime || !timeInFrame || !ticksPerFrame || desiredTimeScale == 0)
+		return E_INVALIDARG;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	*hardwareTime = ConvertTimeValue(GetReferenceClockNanoseconds(now), 1000000000, desiredTimeScale);
+
+	if (m_streamState == StreamState::Running)
+	{
+		FrameTimer::time_point frameBoundary = m_frameTimer.deadline(m_frameTimer.frameIndexAt(now));
+
+		*timeInFrame	= ConvertTimeValue(std::chrono::duration_cast<std::chrono::nanoseconds>(now - frameBoundary).count(), 1000000000, desiredTimeScale);
+		*ticksPerFrame	= ConvertTimeValue(m_frameTimer.frameDuration(), m_frameTimer.timeScale(), desiredTimeScale);
+	}
+	else
+	{
+		*timeInFrame	= 0;
+		*ticksPerFrame	= 0;
+	}
+
+	return S_OK;
+}
+
+VirtualInputStatus VirtualDeckLinkInput::getStatus(void)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return { m_videoEnabled, m_displayMode, m_pixelFormat, m_flags, m_signalMode, detectedFlags() };
+}
+
+BMDDetectedVideoInputFormatFlags VirtualDeckLinkInput::detectedFlags(void) const
+{
+	// The virtual signal is always sent in the colourspace and bit depth that was requested
+	if (!IsRGBPixelFormat(m_pixelFormat))
+		return bmdDetectedVideoInputYCbCr422 | bmdDetectedVideoInput10BitDepth;
+
+	if (m_pixelFormat == bmdFormat12BitRGB || m_pixelFormat == bmdFormat12BitRGBLE)
+		return bmdDetectedVideoInputRGB444 | bmdDetectedVideoInput12BitDepth;
+
+	return bmdDetectedVideoInputRGB444 | bmdDetectedVideoInput10BitDepth;
+}
+
+void VirtualDeckLinkInput::waitForCallback(std::unique_lock<std::mutex>& lock)
+{
+	// Callbacks may stop the streams themselves, which must not wait for their own return
+	if (!isStreamThread())
+		m_condition.wait(lock, [this]{ return !m_callbackActive; });
+}
+
+void VirtualDeckLinkInput::restartFrameCadence(const VirtualDisplayModeInfo* modeInfo)
+{
+	int64_t captureGroup = 0;
+
+	// Inputs synchronised to a capture group join the group's cadence at the current frame, so frames
+	// captured at the same time on each device carry the same stream time
+	if ((m_flags & bmdVideoInputSynchronizeToCaptureGroup) &&
+		m_device->getConfiguration()->GetInt(bmdDeckLinkConfigCaptureGroup, &captureGroup) == S_OK)
+	{
+		m_frameTimer.start(modeInfo->frameDuration, modeInfo->timeScale,
+							captureGroupStartTime(captureGroup, modeInfo->frameDuration, modeInfo->timeScale));
+		m_streamFrameOffset	= 0;
+		m_frameIndex		= m_frameTimer.frameIndexAt(std::chrono::steady_clock::now());
+	}
+	else
+	{
+		m_frameTimer.start(modeInfo->frameDuration, modeInfo->timeScale);
+		m_frameIndex = 0;
+	}
+}
+
+void VirtualDeckLinkInput::streamThread(void)
+{
+	const VirtualDeckLinkSettings& settings = VirtualDeckLinkSettings::get();
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	while (true)
+	{
+		if (m_streamState != StreamState::Running || !m_videoEnabled)
+		{
+			m_condition.wait(lock);
+			continue;
+		}
+
+		// Each frame is delivered once its capture interval has completed
+		uint64_t generation = m_generation;
+		if (m_condition.wait_until(lock, m_frameTimer.deadline(m_frameIndex + 1), [&]{ return m_generation != generation; }))
+			continue;
+
+		// Frames that were not captured while the application was still handling an earlier callback are lost, as on hardware
+		uint64_t currentIndex = m_frameTimer.frameIndexAt(std::chrono::steady_clock::now());
+		if (currentIndex > m_frameIndex + 1)
+			m_frameIndex = currentIndex - 1;
+
+		uint64_t frameIndex = m_frameIndex++;
+
+		if (!m_callback)
+			continue;
+
+		if ((m_flags & bmdVideoInputEnableFormatDetection) && settings.formatChangeInterval > 0 && !settings.formatChangeModes.empty() &&
+			++m_framesSinceFormatChange >= settings.formatChangeInterval)
+		{
+			const VirtualDisplayModeInfo* modeInfo = nullptr;
+
+			m_framesSinceFormatChange = 0;
+			for (size_t i = 0; i < settings.formatChangeModes.size() && !modeInfo; i++)
+			{
+				BMDDisplayMode candidate = settings.formatChangeModes[m_formatChangeIndex++ % settings.formatChangeModes.size()];
+				if (candidate != m_signalMode)
+					modeInfo = FindVirtualDisplayMode(candidate);
+			}
+
+			if (modeInfo)
+			{
+				com_ptr<IDeckLinkInputCallback> callback = m_callback;
+
+				// The frame spanning the signal change is lost
+				m_signalMode		= modeInfo->displayMode;
+				m_callbackActive	= true;
+				lock.unlock();
+
+				deliverFormatChange(callback, modeInfo->displayMode, detectedFlags());
+
+				lock.lock();
+				m_callbackActive = false;
+				m_condition.notify_all();
+				continue;
+			}
+		}
+
+		if (m_faultInjector.shouldDrop(settings.inputDropRate))
+			continue;
+
+		FrameDelivery delivery;
+		delivery.callback			= m_callback;
+		delivery.previewCallback	= m_previewCallback;
+		delivery.allocator			= m_allocator;
+		delivery.pattern			= m_pattern;
+		delivery.displayMode		= m_displayMode;
+		delivery.pixelFormat		= m_pixelFormat;
+		delivery.frameFlags			= (m_signalMode == m_displayMode) ? bmdFrameFlagDefault : bmdFrameHasNoInputSource;
+		delivery.streamFrame		= m_streamFrameOffset + frameIndex;
+		delivery.frameArrival		= m_frameTimer.deadline(frameIndex + 1);
+		delivery.audioEnabled		= m_audioEnabled;
+		delivery.audioSampleType	= m_audioSampleType;
+		delivery.audioChannelCount	= m_audioChannelCount;
+
+		m_callbackActive = true;
+		lock.unlock();
+
+		std::chrono::microseconds jitter = m_faultInjector.jitter(settings.jitterMicroseconds);
+		if (jitter.count() > 0)
+			std::this_thread::sleep_for(jitter);
+
+		deliverFrame(delivery);
+
+		lock.lock();
+		m_callbackActive = false;
+		m_condition.notify_all();
+	}
+}
+
+void VirtualDeckLinkInput::deliverFormatChange(com_ptr<IDeckLinkInputCallback> callback, BMDDisplayMode signalMode, BMDDetectedVideoInputFormatFlags detectedFlags)
+{
+	com_ptr<IDeckLinkDisplayMode> displayMode;
+
+	if (GetDisplayMode(signalMode, displayMode.releaseAndGetAddressOf()) == S_OK)
+		callback->VideoInputFormatChanged(bmdVideoInputDisplayModeChanged, displayMode.get(), detectedFlags);
+}
+
+void VirtualDeckLinkInput::deliverFrame(FrameDelivery& delivery)
+{
+	const VirtualDeckLinkSettings&	settings = VirtualDeckLinkSettings::get();
+	const VirtualDisplayModeInfo*	modeInfo = FindVirtualDisplayMode(delivery.displayMode);
+	long							rowBytes = GetPixelFormatRowBytes(delivery.pixelFormat, modeInfo->width);
+	com_ptr<IDeckLinkAudioInputPacket>	audioPacket;
+
+	com_ptr<VirtualVideoInputFrame> videoFrame = make_com_ptr<VirtualVideoInputFrame>(modeInfo->width, modeInfo->height, rowBytes,
+																						delivery.pixelFormat, delivery.frameFlags, delivery.allocator);
+	// An allocator that has run out of buffers loses the frame
+	if (!videoFrame->hasBuffer())
+		return;
+
+	videoFrame->setStreamTime(delivery.streamFrame * modeInfo->frameDuration, modeInfo->frameDuration, modeInfo->timeScale);
+	videoFrame->setHardwareReferenceTimestamp(GetReferenceClockNanoseconds(delivery.frameArrival),
+												ConvertTimeValue(modeInfo->frameDuration, modeInfo->timeScale, 1000000000));
+
+	com_ptr<IDeckLinkVideoFrame> loopbackFrame;
+	if (settings.loopback && !(delivery.frameFlags & bmdFrameHasNoInputSource))
+		loopbackFrame = m_device->getLoopbackFrame();
+
+	if (loopbackFrame && (loopbackFrame->GetWidth() != modeInfo->width || loopbackFrame->GetHeight() != modeInfo->height ||
+							!IsVirtualPixelFormatSupported(loopbackFrame->GetPixelFormat())))
+		loopbackFrame = nullptr;
+
+	if (settings.copyFrames)
+	{
+		uint8_t* dst;
+		videoFrame->GetBytes((void**)&dst);
+
+		if (loopbackFrame)
+		{
+			uint8_t*	src;
+			long		srcRowBytes = loopbackFrame->GetRowBytes();
+
+			loopbackFrame->GetBytes((void**)&src);
+
+			if (loopbackFrame->GetPixelFormat() == delivery.pixelFormat && srcRowBytes == rowBytes)
+				memcpy(dst, src, (size_t)rowBytes * modeInfo->height);
+			else
+			{
+				for (long y = 0; y < modeInfo->height; y++)
+					ConvertVirtualLine(loopbackFrame->GetPixelFormat(), src + y * srcRowBytes, delivery.pixelFormat, dst + y * rowBytes, modeInfo->width);
+			}
+		}
+		else if (delivery.pattern)
+			memcpy(dst, delivery.pattern->data(), delivery.pattern->size());
+	}
+
+	if (loopbackFrame)
+	{
+		videoFrame->copyTimecodesFrom(loopbackFrame.get());
+		videoFrame->copyAncillaryPacketsFrom(loopbackFrame.get());
+	}
+
+	com_ptr<IDeckLinkTimecode> timecode;
+	if (videoFrame->GetTimecode(bmdTimecodeRP188Any, timecode.releaseAndGetAddressOf()) != S_OK)
+	{
+		timecode = VirtualTimecode::fromFrameCount(delivery.streamFrame, modeInfo->frameDuration, modeInfo->timeScale);
+		videoFrame->setTimecode(bmdTimecodeRP188VITC1, timecode);
+		videoFrame->setTimecode(bmdTimecodeVITC, timecode);
+	}
+
+	if (delivery.audioEnabled)
+	{
+		uint32_t sampleFrameCount		= audioSampleFrameCount(delivery.streamFrame, modeInfo->frameDuration, modeInfo->timeScale);
+		uint32_t bytesPerSampleFrame	= (delivery.audioSampleType / 8) * delivery.audioChannelCount;
+		BMDTimeValue packetTime			= ConvertTimeValue(delivery.streamFrame * modeInfo->frameDuration, modeInfo->timeScale, kAudioSampleRate);
+
+		com_ptr<VirtualAudioInputPacket> packet = make_com_ptr<VirtualAudioInputPacket>(sampleFrameCount, bytesPerSampleFrame, packetTime, kAudioSampleRate);
+		if (settings.loopback)
+			m_device->readLoopbackAudio(packet->data(), sampleFrameCount, delivery.audioSampleType, delivery.audioChannelCount);
+
+		audioPacket = com_ptr<IDeckLinkAudioInputPacket>(packet.get());
+	}
+
+	if (delivery.previewCallback)
+		delivery.previewCallback->DrawFrame(videoFrame.get());
+
+	delivery.callback->VideoInputFrameArrived(videoFrame.get(), audioPacket.get());
+}
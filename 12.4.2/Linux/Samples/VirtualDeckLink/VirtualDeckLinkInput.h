@@ -0,0 +1,168 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**
+** Permission is hereby granted, free of charge, to any person or organization
+** obtaining a copy of the software and accompanying documentation (the
+** "Software") to use, reproduce, display, distribute, sub-license, execute,
+** and transmit the Software, and to prepare derivative works of the Software,
+** and to permit third-parties to whom the Software is furnished to do so, in
+** accordance with:
+**
+** (1) if the Software is obtained from Blackmagic Design, the End User License
+** Agreement for the Software Development Kit (“EULA”) available at
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+**
+** (2) if the Software is obtained from any third party, such licensing terms
+** as notified by that third party,
+**
+** and all subject to the following:
+**
+** (3) the copyright notices in the Software and this entire statement,
+** including the above license grant, this restriction and the following
+** disclaimer, must be included in all copies of the Software, in whole or in
+** part, and all derivative works of the Software, unless such copies or
+** derivative works are solely in the form of machine-executable object code
+** generated by a source language processor.
+**
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+** DEALINGS IN THE SOFTWARE.
+**
+** A copy of the Software is available free of charge at
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+**
+** -LICENSE-END-
+*/
+
+#pragma once
+
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "DeckLinkAPI.h"
+#include "FrameTimer.h"
+#include "VirtualDeckLinkSettings.h"
+#include "com_ptr.h"
+
+class VirtualDeckLinkDevice;
+struct VirtualDisplayModeInfo;
+
+struct VirtualInputStatus
+{
+	bool								videoEnabled;
+	BMDDisplayMode						displayMode;
+	BMDPixelFormat						pixelFormat;
+	BMDVideoInputFlags					flags;
+	BMDDisplayMode						signalMode;
+	BMDDetectedVideoInputFormatFlags	detectedFlags;
+};
+
+// Capture side of a virtual device.  A streaming thread wakes at each frame boundary of the enabled
+// display mode and delivers the frame last displayed by the device's output, or colour bars when
+// nothing has been output.  Shares the reference count of the owning device.
+class VirtualDeckLinkInput : public IDeckLinkInput
+{
+public:
+	explicit VirtualDeckLinkInput(VirtualDeckLinkDevice* device);
+	virtual ~VirtualDeckLinkInput() = default;
+
+	// IUnknown interface
+	HRESULT		STDMETHODCALLTYPE QueryInterface(REFIID iid, LPVOID *ppv) override;
+	ULONG		STDMETHODCALLTYPE AddRef() override;
+	ULONG		STDMETHODCALLTYPE Release() override;
+
+	// IDeckLinkInput interface
+	HRESULT		STDMETHODCALLTYPE DoesSupportVideoMode(BMDVideoConnection connection, BMDDisplayMode requestedMode, BMDPixelFormat requestedPixelFormat, BMDVideoInputConversionMode conversionMode, BMDSupportedVideoModeFlags flags, BMDDisplayMode* actualMode, bool* supported) override;
+	HRESULT		STDMETHODCALLTYPE GetDisplayMode(BMDDisplayMode displayMode, IDeckLinkDisplayMode** resultDisplayMode) override;
+	HRESULT		STDMETHODCALLTYPE GetDisplayModeIterator(IDeckLinkDisplayModeIterator** iterator) override;
+	HRESULT		STDMETHODCALLTYPE SetScreenPreviewCallback(IDeckLinkScreenPreviewCallback* previewCallback) override;
+
+	HRESULT		STDMETHODCALLTYPE EnableVideoInput(BMDDisplayMode displayMode, BMDPixelFormat pixelFormat, BMDVideoInputFlags flags) override;
+	HRESULT		STDMETHODCALLTYPE DisableVideoInput(void) override;
+	HRESULT		STDMETHODCALLTYPE GetAvailableVideoFrameCount(uint32_t* availableFrameCount) override;
+	HRESULT		STDMETHODCALLTYPE SetVideoInputFrameMemoryAllocator(IDeckLinkMemoryAllocator* theAllocator) override;
+
+	HRESULT		STDMETHODCALLTYPE EnableAudioInput(BMDAudioSampleRate sampleRate, BMDAudioSampleType sampleType, uint32_t channelCount) override;
+	HRESULT		STDMETHODCALLTYPE DisableAudioInput(void) override;
+	HRESULT		STDMETHODCALLTYPE GetAvailableAudioSampleFrameCount(uint32_t* availableSampleFrameCount) override;
+
+	HRESULT		STDMETHODCALLTYPE StartStreams(void) override;
+	HRESULT		STDMETHODCALLTYPE StopStreams(void) override;
+	HRESULT		STDMETHODCALLTYPE PauseStreams(void) override;
+	HRESULT		STDMETHODCALLTYPE FlushStreams(void) override;
+	HRESULT		STDMETHODCALLTYPE SetCallback(IDeckLinkInputCallback* theCallback) override;
+
+	HRESULT		STDMETHODCALLTYPE GetHardwareReferenceClock(BMDTimeScale desiredTimeScale, BMDTimeValue* hardwareTime, BMDTimeValue* timeInFrame, BMDTimeValue* ticksPerFrame) override;
+
+	VirtualInputStatus	getStatus(void);
+
+private:
+	enum class StreamState
+	{
+		Stopped,
+		Running,
+		Paused
+	};
+
+	// State captured under the lock for delivery of a single frame
+	struct FrameDelivery
+	{
+		com_ptr<IDeckLinkInputCallback>			callback;
+		com_ptr<IDeckLinkScreenPreviewCallback>	previewCallback;
+		com_ptr<IDeckLinkMemoryAllocator>		allocator;
+		std::shared_ptr<std::vector<uint8_t>>	pattern;
+		BMDDisplayMode							displayMode;
+		BMDPixelFormat							pixelFormat;
+		BMDFrameFlags							frameFlags;
+		uint64_t								streamFrame;
+		FrameTimer::time_point					frameArrival;
+		bool									audioEnabled;
+		BMDAudioSampleType						audioSampleType;
+		uint32_t								audioChannelCount;
+	};
+
+	VirtualDeckLinkDevice*						m_device;
+	std::mutex									m_mutex;
+	std::condition_variable						m_condition;
+	std::thread									m_thread;
+	FaultInjector								m_faultInjector;
+	//
+	com_ptr<IDeckLinkInputCallback>				m_callback;
+	com_ptr<IDeckLinkScreenPreviewCallback>		m_previewCallback;
+	com_ptr<IDeckLinkMemoryAllocator>			m_defaultAllocator;
+	com_ptr<IDeckLinkMemoryAllocator>			m_allocator;
+	//
+	bool										m_videoEnabled;
+	BMDDisplayMode								m_displayMode;
+	BMDPixelFormat								m_pixelFormat;
+	BMDVideoInputFlags							m_flags;
+	BMDDisplayMode								m_signalMode;
+	std::shared_ptr<std::vector<uint8_t>>		m_pattern;
+	//
+	bool										m_audioEnabled;
+	BMDAudioSampleType							m_audioSampleType;
+	uint32_t									m_audioChannelCount;
+	//
+	StreamState									m_streamState;
+	uint64_t									m_generation;
+	FrameTimer									m_frameTimer;
+	uint64_t									m_frameIndex;
+	uint64_t									m_streamFrameOffset;
+	uint32_t									m_framesSinceFormatChange;
+	size_t										m_formatChangeIndex;
+	bool										m_callbackActive;
+
+	void		streamThread(void);
+	void		restartFrameCadence(const VirtualDisplayModeInfo* modeInfo);
+	void		deliverFrame(FrameDelivery& delivery);
+	void		deliverFormatChange(com_ptr<IDeckLinkInputCallback> callback, BMDDisplayMode signalMode, BMDDetectedVideoInputFormatFlags detectedFlags);
+	void		waitForCallback(std::unique_lock<std::mutex>& lock);
+	bool		isStreamThread(void) const		{ return std::this_thread::get_id() == m_thread.get_id(); }
+	BMDDetectedVideoInputFormatFlags	detectedFlags(void) const;
+};
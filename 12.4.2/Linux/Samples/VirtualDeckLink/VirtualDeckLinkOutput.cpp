@@ -0,0 +1,789 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**
+** Permission is hereby granted, free of charge, to any person or organization
+** obtaining a copy of the software and accompanying documentation (the
+** "Software") to use, reproduce, display, distribute, sub-license, execute,
+** and transmit the Software, and to prepare derivative works of the Software,
+** and to permit third-parties to whom the Software is furnished to do so, in
+** accordance with:
+**
+** (1) if the Software is obtained from Blackmagic Design, the End User License
+** Agreement for the Software Development Kit (“EULA”) available at
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+**
+** (2) if the Software is obtained from any third party, such licensing terms
+** as notified by that third party,
+**
+** and all subject to the following:
+**
+** (3) the copyright notices in the Software and this entire statement,
+** including the above license grant, this restriction and the following
+** disclaimer, must be included in all copies of the Software, in whole or in
+** part, and all derivative works of the Software, unless such copies or
+** derivative works are solely in the form of machine-executable object code
+** generated by a source language processor.
+**
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+** DEALINGS IN THE SOFTWARE.
+**
+** A copy of the Software is available free of charge at
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+**
+** -LICENSE-END-
+*/
+
+#include <algorithm>
+#include "VirtualDeckLinkOutput.h"
+#include "VirtualDeckLinkDevice.h"
+#include "VirtualDisplayMode.h"
+#include "VirtualMemoryAllocator.h"
+#include "VirtualVideoConversion.h"
+#include "VirtualVideoFrame.h"
+#include "platform.h"
+
+static const BMDTimeScale	kAudioSampleRate			= bmdAudioSampleRate48kHz;
+// Two seconds of audio may be buffered, as on hardware
+static const uint32_t		kAudioBufferSampleFrames	= 2 * bmdAudioSampleRate48kHz;
+
+VirtualDeckLinkOutput::VirtualDeckLinkOutput(VirtualDeckLinkDevice* device) :
+	m_device(device),
+	m_faultInjector(VirtualDeckLinkSettings::get().seed + device->getIndex() * 2 + 1),
+	m_defaultAllocator(make_com_ptr<VirtualMemoryAllocator>().get()),
+	m_allocator(m_defaultAllocator),
+	m_videoEnabled(false),
+	m_displayMode(bmdModeUnknown),
+	m_flags(bmdVideoOutputFlagDefault),
+	m_lastPixelFormat(bmdFormatUnspecified),
+	m_tick(0),
+	m_generation(0),
+	m_callbackActive(false),
+	m_displayedResult(bmdOutputFrameCompleted),
+	m_completionTimes(kCompletionTimeCount, CompletionTime{ nullptr, 0 }),
+	m_completionTimeIndex(0),
+	m_playbackRunning(false),
+	m_playbackStartTime(0),
+	m_playbackStartTick(0),
+	m_stopTime(0),
+	m_stopPending(false),
+	m_stopNotificationPending(false),
+	m_audioEnabled(false),
+	m_audioSampleType(bmdAudioSampleType16bitInteger),
+	m_audioChannelCount(0),
+	m_audioPreroll(false),
+	m_audioSync(false),
+	m_audioTickSampleFrameCount(0)
+{
+}
+
+HRESULT VirtualDeckLinkOutput::QueryInterface(REFIID iid, LPVOID *ppv)
+{
+	return m_device->QueryInterface(iid, ppv);
+}
+
+ULONG VirtualDeckLinkOutput::AddRef(void)
+{
+	return m_device->AddRef();
+}
+
+ULONG VirtualDeckLinkOutput::Release(void)
+{
+	return m_device->Release();
+}
+
+HRESULT VirtualDeckLinkOutput::DoesSupportVideoMode(BMDVideoConnection connection, BMDDisplayMode requestedMode, BMDPixelFormat requestedPixelFormat, BMDVideoOutputConversionMode conversionMode, BMDSupportedVideoModeFlags flags, BMDDisplayMode* actualMode, bool* supported)
+{
+	const VirtualDisplayModeInfo* modeInfo = FindVirtualDisplayMode(requestedMode);
+
+	if (!supported)
+		return E_INVALIDARG;
+
+	*supported = (modeInfo != nullptr) &&
+					(connection == bmdVideoConnectionUnspecified || (connection & bmdVideoConnectionSDI)) &&
+					(conversionMode == bmdNoVideoOutputConversion) &&
+					(requestedPixelFormat == bmdFormatUnspecified || IsVirtualPixelFormatSupported(requestedPixelFormat)) &&
+					(!(flags & bmdSupportedVideoModeDualStream3D) || (modeInfo->flags & bmdDisplayModeSupports3D));
+
+	if (actualMode)
+		*actualMode = *supported ? requestedMode : bmdModeUnknown;
+
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkOutput::GetDisplayMode(BMDDisplayMode displayMode, IDeckLinkDisplayMode** resultDisplayMode)
+{
+	const VirtualDisplayModeInfo* modeInfo = FindVirtualDisplayMode(displayMode);
+
+	if (!resultDisplayMode)
+		return E_INVALIDARG;
+
+	if (!modeInfo)
+	{
+		*resultDisplayMode = nullptr;
+		return E_INVALIDARG;
+	}
+
+	*resultDisplayMode = new VirtualDisplayMode(*modeInfo);
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkOutput::GetDisplayModeIterator(IDeckLinkDisplayModeIterator** iterator)
+{
+	if (!iterator)
+		return E_INVALIDARG;
+
+	*iterator = new VirtualDisplayModeIterator();
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkOutput::SetScreenPreviewCallback(IDeckLinkScreenPreviewCallback* previewCallback)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_previewCallback = previewCallback;
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkOutput::EnableVideoOutput(BMDDisplayMode displayMode, BMDVideoOutputFlags flags)
+{
+	const VirtualDisplayModeInfo* modeInfo = FindVirtualDisplayMode(displayMode);
+
+	if (!modeInfo)
+		return E_INVALIDARG;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (m_playbackRunning)
+		return E_ACCESSDENIED;
+
+	// As on hardware, the frame allocator is committed while video output is enabled
+	if (!m_videoEnabled)
+		m_allocator->Commit();
+
+	m_videoEnabled	= true;
+	m_displayMode	= displayMode;
+	m_flags			= flags;
+	m_tick			= 1;
+	m_frameTimer.start(modeInfo->frameDuration, modeInfo->timeScale);
+	m_generation++;
+
+	if (!m_thread.joinable())
+		m_thread = std::thread(&VirtualDeckLinkOutput::playoutThread, this);
+
+	m_condition.notify_all();
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkOutput::DisableVideoOutput(void)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	bool wasEnabled = m_videoEnabled;
+
+	m_videoEnabled		= false;
+	m_playbackRunning	= false;
+	m_stopPending		= false;
+	m_scheduledFrames.clear();
+	m_pendingCompletions.clear();
+	m_displayedFrame	= nullptr;
+	m_generation++;
+	m_condition.notify_all();
+
+	waitForCallback(lock);
+
+	if (wasEnabled)
+		m_allocator->Decommit();
+
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkOutput::SetVideoOutputFrameMemoryAllocator(IDeckLinkMemoryAllocator* theAllocator)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (theAllocator)
+		m_allocator = theAllocator;
+	else
+		m_allocator = m_defaultAllocator;
+
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkOutput::CreateVideoFrame(int32_t width, int32_t height, int32_t rowBytes, BMDPixelFormat pixelFormat, BMDFrameFlags flags, IDeckLinkMutableVideoFrame** outFrame)
+{
+	com_ptr<IDeckLinkMemoryAllocator> allocator;
+
+	if (!outFrame || width <= 0 || height <= 0 || rowBytes <= 0)
+		return E_INVALIDARG;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		allocator = m_allocator;
+	}
+
+	VirtualMutableVideoFrame* frame = new VirtualMutableVideoFrame(width, height, rowBytes, pixelFormat, flags, allocator);
+	if (!frame->hasBuffer())
+	{
+		frame->Release();
+		*outFrame = nullptr;
+		return E_OUTOFMEMORY;
+	}
+
+	*outFrame = frame;
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkOutput::CreateAncillaryData(BMDPixelFormat pixelFormat, IDeckLinkVideoFrameAncillary** outBuffer)
+{
+	// Only the packet based ancillary interface is provided
+	return E_NOTIMPL;
+}
+
+HRESULT VirtualDeckLinkOutput::DisplayVideoFrameSync(IDeckLinkVideoFrame* theFrame)
+{
+	com_ptr<IDeckLinkScreenPreviewCallback> previewCallback;
+
+	if (!theFrame)
+		return E_INVALIDARG;
+
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+
+		if (!m_videoEnabled || m_playbackRunning)
+			return E_ACCESSDENIED;
+
+		m_lastPixelFormat	= theFrame->GetPixelFormat();
+		previewCallback		= m_previewCallback;
+	}
+
+	m_device->setLoopbackFrame(theFrame);
+
+	if (previewCallback)
+		previewCallback->DrawFrame(theFrame);
+
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkOutput::ScheduleVideoFrame(IDeckLinkVideoFrame* theFrame, BMDTimeValue displayTime, BMDTimeValue displayDuration, BMDTimeScale timeScale)
+{
+	if (!theFrame || timeScale == 0)
+		return E_INVALIDARG;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (!m_videoEnabled)
+		return E_ACCESSDENIED;
+
+	// Frames are held in the display mode time scale so that each tick compares exact values
+	BMDTimeScale modeTimeScale = m_frameTimer.timeScale();
+	m_scheduledFrames.emplace(ConvertTimeValue(displayTime, timeScale, modeTimeScale),
+								ScheduledFrame{ com_ptr<IDeckLinkVideoFrame>(theFrame), ConvertTimeValue(displayDuration, timeScale, modeTimeScale) });
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkOutput::SetScheduledFrameCompletionCallback(IDeckLinkVideoOutputCallback* theCallback)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_callback = theCallback;
+
+	if (!theCallback)
+		waitForCallback(lock);
+
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkOutput::GetBufferedVideoFrameCount(uint32_t* bufferedFrameCount)
+{
+	if (!bufferedFrameCount)
+		return E_INVALIDARG;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	*bufferedFrameCount = (uint32_t)m_scheduledFrames.size();
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkOutput::EnableAudioOutput(BMDAudioSampleRate sampleRate, BMDAudioSampleType sampleType, uint32_t channelCount, BMDAudioOutputStreamType streamType)
+{
+	if (sampleRate != bmdAudioSampleRate48kHz)
+		return E_INVALIDARG;
+
+	if (sampleType != bmdAudioSampleType16bitInteger && sampleType != bmdAudioSampleType32bitInteger)
+		return E_INVALIDARG;
+
+	if (channelCount != 2 && channelCount != 8 && channelCount != 16)
+		return E_INVALIDARG;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_audioEnabled		= true;
+	m_audioSampleType	= sampleType;
+	m_audioChannelCount	= channelCount;
+	m_audioPreroll		= false;
+	m_audioSync			= false;
+	m_audioBuffer.setSampleFrameSize((sampleType / 8) * channelCount);
+	m_audioBuffer.clear();
+	m_audioTickSampleFrameCount = 0;
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkOutput::DisableAudioOutput(void)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	m_audioEnabled	= false;
+	m_audioPreroll	= false;
+	m_audioBuffer.clear();
+	m_audioTickSampleFrameCount = 0;
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkOutput::WriteAudioSamplesSync(void* buffer, uint32_t sampleFrameCount, uint32_t* sampleFramesWritten)
+{
+	if (!buffer)
+		return E_INVALIDARG;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (!m_audioEnabled)
+		return E_ACCESSDENIED;
+
+	// Synchronous audio is played out at the frame rate whether or not scheduled playback is running
+	m_audioSync = true;
+
+	uint32_t written = m_audioBuffer.write(buffer, sampleFrameCount, kAudioBufferSampleFrames);
+	if (sampleFramesWritten)
+		*sampleFramesWritten = written;
+
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkOutput::BeginAudioPreroll(void)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (!m_audioEnabled)
+		return E_ACCESSDENIED;
+
+	m_audioPreroll = true;
+	m_condition.notify_all();
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkOutput::EndAudioPreroll(void)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_audioPreroll = false;
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkOutput::ScheduleAudioSamples(void* buffer, uint32_t sampleFrameCount, BMDTimeValue streamTime, BMDTimeScale timeScale, uint32_t* sampleFramesWritten)
+{
+	if (!buffer)
+		return E_INVALIDARG;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (!m_audioEnabled)
+		return E_ACCESSDENIED;
+
+	// Samples are played contiguously, the stream time of each packet is not used to realign the audio
+	uint32_t written = m_audioBuffer.write(buffer, sampleFrameCount, kAudioBufferSampleFrames);
+	if (sampleFramesWritten)
+		*sampleFramesWritten = written;
+
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkOutput::GetBufferedAudioSampleFrameCount(uint32_t* bufferedSampleFrameCount)
+{
+	if (!bufferedSampleFrameCount)
+		return E_INVALIDARG;
+
+	FrameTimer::time_point now = std::chrono::steady_clock::now();
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	// Audio is played a frame at a time, but counted as a device does, which plays it continuously: the
+	// part of the frame being played that is still to be output remains buffered
+	uint32_t playingSampleFrameCount = 0;
+	if (m_audioTickSampleFrameCount > 0 && m_tick > 0)
+	{
+		auto frameEnd		= m_frameTimer.deadline(m_tick);
+		auto frameLength	= frameEnd - m_frameTimer.deadline(m_tick - 1);
+
+		if (now < frameEnd && frameLength.count() > 0)
+			playingSampleFrameCount = (uint32_t)std::min<int64_t>(((frameEnd - now) * m_audioTickSampleFrameCount) / frameLength, m_audioTickSampleFrameCount);
+	}
+
+	*bufferedSampleFrameCount = m_audioBuffer.sampleFrameCount() + playingSampleFrameCount;
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkOutput::FlushBufferedAudioSamples(void)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_audioBuffer.clear();
+	m_audioTickSampleFrameCount = 0;
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkOutput::SetAudioCallback(IDeckLinkAudioOutputCallback* theCallback)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_audioCallback = theCallback;
+
+	if (!theCallback)
+		waitForCallback(lock);
+
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkOutput::StartScheduledPlayback(BMDTimeValue playbackStartTime, BMDTimeScale timeScale, double playbackSpeed)
+{
+	if (timeScale == 0)
+		return E_INVALIDARG;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (!m_videoEnabled || m_playbackRunning)
+		return E_ACCESSDENIED;
+
+	// Only normal speed playback is modelled
+	if (playbackSpeed != 1.0)
+		return E_INVALIDARG;
+
+	m_playbackRunning	= true;
+	m_stopPending		= false;
+	m_playbackStartTime	= ConvertTimeValue(playbackStartTime, timeScale, m_frameTimer.timeScale());
+	m_playbackStartTick	= m_frameTimer.frameIndexAt(std::chrono::steady_clock::now()) + 1;
+	m_audioPreroll		= false;
+	m_condition.notify_all();
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkOutput::StopScheduledPlayback(BMDTimeValue stopPlaybackAtTime, BMDTimeValue* actualStopTime, BMDTimeScale timeScale)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (!m_playbackRunning)
+	{
+		if (actualStopTime)
+			*actualStopTime = 0;
+		return S_OK;
+	}
+
+	if (stopPlaybackAtTime != 0 && timeScale != 0)
+	{
+		// Stop once the given stream time is reached
+		m_stopTime		= ConvertTimeValue(stopPlaybackAtTime, timeScale, m_frameTimer.timeScale());
+		m_stopPending	= true;
+
+		if (actualStopTime)
+			*actualStopTime = stopPlaybackAtTime;
+		return S_OK;
+	}
+
+	BMDTimeValue streamTime = streamTimeAtTick(std::max(m_tick, m_playbackStartTick));
+	if (actualStopTime && timeScale != 0)
+		*actualStopTime = ConvertTimeValue(streamTime, m_frameTimer.timeScale(), timeScale);
+
+	// Immediate stop, all outstanding frames are flushed and the callbacks delivered from the playout thread
+	m_playbackRunning			= false;
+	m_stopPending				= false;
+	m_stopNotificationPending	= true;
+	flushScheduledFrames(m_pendingCompletions);
+	m_generation++;
+	m_condition.notify_all();
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkOutput::IsScheduledPlaybackRunning(bool* active)
+{
+	if (!active)
+		return E_INVALIDARG;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+	*active = m_playbackRunning;
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkOutput::GetScheduledStreamTime(BMDTimeScale desiredTimeScale, BMDTimeValue* streamTime, double* playbackSpeed)
+{
+	FrameTimer::time_point now = std::chrono::steady_clock::now();
+
+	if (!streamTime || !playbackSpeed || desiredTimeScale == 0)
+		return E_INVALIDARG;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (!m_playbackRunning || now < m_frameTimer.deadline(m_playbackStartTick))
+	{
+		*streamTime		= m_playbackRunning ? ConvertTimeValue(m_playbackStartTime, m_frameTimer.timeScale(), desiredTimeScale) : 0;
+		*playbackSpeed	= m_playbackRunning ? 1.0 : 0.0;
+		return S_OK;
+	}
+
+	// Stream time advances continuously from the frame boundary at which playback started
+	BMDTimeValue elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(now - m_frameTimer.deadline(m_playbackStartTick)).count();
+	*streamTime		= ConvertTimeValue(m_playbackStartTime, m_frameTimer.timeScale(), desiredTimeScale) + ConvertTimeValue(elapsed, 1000000000, desiredTimeScale);
+	*playbackSpeed	= 1.0;
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkOutput::GetReferenceStatus(BMDReferenceStatus* referenceStatus)
+{
+	if (!referenceStatus)
+		return E_INVALIDARG;
+
+	*referenceStatus = bmdReferenceLocked;
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkOutput::GetHardwareReferenceClock(BMDTimeScale desiredTimeScale, BMDTimeValue* hardwareTime, BMDTimeValue* timeInFrame, BMDTimeValue* ticksPerFrame)
+{
+	FrameTimer::time_point now = std::chrono::steady_clock::now();
+
+	if (!hardwareTime || !timeInFrame || !ticksPerFrame || desiredTimeScale == 0)
+		return E_INVALIDARG;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	*hardwareTime = ConvertTimeValue(GetReferenceClockNanoseconds(now), 1000000000, desiredTimeScale);
+
+	if (m_videoEnabled)
+	{
+		FrameTimer::time_point frameStart = m_frameTimer.deadline(m_frameTimer.frameIndexAt(now));
+
+		*timeInFrame	= ConvertTimeValue(std::chrono::duration_cast<std::chrono::nanoseconds>(now - frameStart).count(), 1000000000, desiredTimeScale);
+		*ticksPerFrame	= ConvertTimeValue(m_frameTimer.frameDuration(), m_frameTimer.timeScale(), desiredTimeScale);
+	}
+	else
+	{
+		*timeInFrame	= 0;
+		*ticksPerFrame	= 0;
+	}
+
+	return S_OK;
+}
+
+HRESULT VirtualDeckLinkOutput::GetFrameCompletionReferenceTimestamp(IDeckLinkVideoFrame* theFrame, BMDTimeScale desiredTimeScale, BMDTimeValue* frameCompletionTimestamp)
+{
+	if (!theFrame || !frameCompletionTimestamp || desiredTimeScale == 0)
+		return E_INVALIDARG;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	// Search newest first, as frames are commonly reused after completion
+	for (size_t i = 1; i <= kCompletionTimeCount; i++)
+	{
+		const CompletionTime& completion = m_completionTimes[(m_completionTimeIndex + kCompletionTimeCount - i) % kCompletionTimeCount];
+		if (completion.frame == theFrame)
+		{
+			*frameCompletionTimestamp = ConvertTimeValue(completion.timestampNanoseconds, 1000000000, desiredTimeScale);
+			return S_OK;
+		}
+	}
+
+	return E_FAIL;
+}
+
+VirtualOutputStatus VirtualDeckLinkOutput::getStatus(void)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return { m_videoEnabled, m_displayMode, m_flags, m_lastPixelFormat };
+}
+
+BMDTimeValue VirtualDeckLinkOutput::streamTimeAtTick(uint64_t tick) const
+{
+	return m_playbackStartTime + (BMDTimeValue)(tick - m_playbackStartTick) * m_frameTimer.frameDuration();
+}
+
+void VirtualDeckLinkOutput::flushScheduledFrames(std::vector<FrameCompletion>& completions)
+{
+	if (m_displayedFrame)
+		completions.push_back({ m_displayedFrame, m_displayedResult });
+
+	for (auto& scheduled : m_scheduledFrames)
+		completions.push_back({ scheduled.second.frame, bmdOutputFrameFlushed });
+
+	m_displayedFrame = nullptr;
+	m_scheduledFrames.clear();
+}
+
+void VirtualDeckLinkOutput::recordCompletionTime(IDeckLinkVideoFrame* frame, BMDTimeValue timestampNanoseconds)
+{
+	m_completionTimes[m_completionTimeIndex] = { frame, timestampNanoseconds };
+	m_completionTimeIndex = (m_completionTimeIndex + 1) % kCompletionTimeCount;
+}
+
+void VirtualDeckLinkOutput::waitForCallback(std::unique_lock<std::mutex>& lock)
+{
+	// Callbacks may stop playback themselves, which must not wait for their own return
+	if (!isPlayoutThread())
+		m_condition.wait(lock, [this]{ return !m_callbackActive; });
+}
+
+void VirtualDeckLinkOutput::playoutThread(void)
+{
+	const VirtualDeckLinkSettings& settings = VirtualDeckLinkSettings::get();
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	while (true)
+	{
+		std::vector<FrameCompletion>			completions;
+		com_ptr<IDeckLinkVideoFrame>			displayedFrame;
+		bool									playbackStopped = false;
+		bool									renderAudio		= false;
+		bool									audioPreroll	= false;
+
+		if (!m_videoEnabled)
+		{
+			m_condition.wait(lock);
+			continue;
+		}
+
+		if (m_stopNotificationPending)
+		{
+			// Deliver the completions of an immediate stop without waiting for the next frame boundary
+			completions.swap(m_pendingCompletions);
+			m_stopNotificationPending	= false;
+			playbackStopped				= true;
+		}
+		else
+		{
+			uint64_t generation = m_generation;
+			if (m_condition.wait_until(lock, m_frameTimer.deadline(m_tick), [&]{ return m_generation != generation; }))
+				continue;
+
+			// A late wake-up skips the missed frame boundaries, frames due in between are dropped below
+			uint64_t firstTick = m_tick;
+			uint64_t tick = std::max(m_tick, m_frameTimer.frameIndexAt(std::chrono::steady_clock::now()));
+			BMDTimeValue tickTimestamp = GetReferenceClockNanoseconds(m_frameTimer.deadline(tick));
+			m_tick = tick + 1;
+
+			if (m_playbackRunning && tick >= m_playbackStartTick)
+			{
+				BMDTimeValue streamTime = streamTimeAtTick(tick);
+
+				if (m_stopPending && streamTime >= m_stopTime)
+				{
+					m_playbackRunning	= false;
+					m_stopPending		= false;
+					playbackStopped		= true;
+					flushScheduledFrames(completions);
+				}
+				else
+				{
+					// Frames whose display period has passed without being shown are dropped
+					while (!m_scheduledFrames.empty() && m_scheduledFrames.begin()->first + m_scheduledFrames.begin()->second.duration <= streamTime)
+					{
+						completions.push_back({ m_scheduledFrames.begin()->second.frame, bmdOutputFrameDropped });
+						m_scheduledFrames.erase(m_scheduledFrames.begin());
+					}
+
+					if (!m_scheduledFrames.empty() && m_scheduledFrames.begin()->first <= streamTime)
+					{
+						auto next = m_scheduledFrames.begin();
+						com_ptr<IDeckLinkVideoFrame> frame = next->second.frame;
+						BMDOutputFrameCompletionResult result = (next->first == streamTime) ? bmdOutputFrameCompleted : bmdOutputFrameDisplayedLate;
+						m_scheduledFrames.erase(next);
+
+						if (m_faultInjector.shouldDrop(settings.outputDropRate))
+							completions.push_back({ frame, bmdOutputFrameDropped });
+						else
+						{
+							// The frame being replaced completes now with the result determined when it was displayed
+							if (m_displayedFrame)
+								completions.push_back({ m_displayedFrame, m_displayedResult });
+
+							m_displayedFrame	= frame;
+							m_displayedResult	= result;
+							m_lastPixelFormat	= frame->GetPixelFormat();
+							displayedFrame		= frame;
+						}
+					}
+
+					for (const FrameCompletion& completion : completions)
+						recordCompletionTime(completion.frame.get(), tickTimestamp);
+				}
+			}
+
+			m_audioTickSampleFrameCount = 0;
+
+			if (m_audioEnabled)
+			{
+				// Play out one frame of audio at each frame boundary while playback is running or samples are written synchronously.
+				// Audio plays on through the boundaries missed by a late wake-up, so their frames are played out as well.
+				if ((m_playbackRunning && tick >= m_playbackStartTick) || m_audioSync)
+				{
+					uint64_t		audioTick				= m_audioSync ? firstTick : std::max(firstTick, m_playbackStartTick);
+					BMDTimeValue	frameTime				= (BMDTimeValue)tick * m_frameTimer.frameDuration();
+					uint32_t		tickSampleFrameCount	= (uint32_t)(ConvertTimeValue(frameTime + m_frameTimer.frameDuration(), m_frameTimer.timeScale(), kAudioSampleRate) -
+																	ConvertTimeValue(frameTime, m_frameTimer.timeScale(), kAudioSampleRate));
+					uint32_t		sampleFrameCount		= (uint32_t)(ConvertTimeValue(frameTime + m_frameTimer.frameDuration(), m_frameTimer.timeScale(), kAudioSampleRate) -
+																	ConvertTimeValue((BMDTimeValue)audioTick * m_frameTimer.frameDuration(), m_frameTimer.timeScale(), kAudioSampleRate));
+
+					m_audioTickBuffer.resize((size_t)sampleFrameCount * m_audioBuffer.sampleFrameSize());
+					m_audioTickSampleFrameCount = std::min(m_audioBuffer.read(m_audioTickBuffer.data(), sampleFrameCount), tickSampleFrameCount);
+
+					if (settings.loopback)
+						m_device->writeLoopbackAudio(m_audioTickBuffer.data(), sampleFrameCount, m_audioSampleType, m_audioChannelCount);
+
+					renderAudio = m_playbackRunning;
+				}
+				else if (m_audioPreroll)
+				{
+					renderAudio		= true;
+					audioPreroll	= true;
+				}
+			}
+		}
+
+		com_ptr<IDeckLinkVideoOutputCallback>	callback		= m_callback;
+		com_ptr<IDeckLinkAudioOutputCallback>	audioCallback	= renderAudio ? m_audioCallback : nullptr;
+		com_ptr<IDeckLinkScreenPreviewCallback>	previewCallback	= displayedFrame ? m_previewCallback : nullptr;
+
+		if (completions.empty() && !playbackStopped && !displayedFrame && !audioCallback)
+			continue;
+
+		m_callbackActive = true;
+		lock.unlock();
+
+		if (displayedFrame)
+		{
+			if (settings.loopback)
+				m_device->setLoopbackFrame(displayedFrame.get());
+
+			if (previewCallback)
+				previewCallback->DrawFrame(displayedFrame.get());
+		}
+
+		std::chrono::microseconds jitter = m_faultInjector.jitter(settings.jitterMicroseconds);
+		if (jitter.count() > 0)
+			std::this_thread::sleep_for(jitter);
+
+		if (callback)
+		{
+			for (const FrameCompletion& completion : completions)
+				callback->ScheduledFrameCompleted(completion.frame.get(), completion.result);
+
+			if (playbackStopped)
+				callback->ScheduledPlaybackHasStopped();
+		}
+
+		if (audioCallback)
+			audioCallback->RenderAudioSamples(audioPreroll);
+
+		// Release the completed frames before taking the lock, their destructors may call back into the API
+		completions.clear();
+		displayedFrame = nullptr;
+
+		lock.lock();
+		m_callbackActive = false;
+		m_condition.notify_all();
+	}
+}
@@ -0,0 +1,189 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**
+** Permission is hereby granted, free of charge, to any person or organization
+** obtaining a copy of the software and accompanying documentation (the
+** "Software") to use, reproduce, display, distribute, sub-license, execute,
+** and transmit the Software, and to prepare derivative works of the Software,
+** and to permit third-parties to whom the Software is furnished to do so, in
+** accordance with:
+**
+** (1) if the Software is obtained from Blackmagic Design, the End User License
+** Agreement for the Software Development Kit (“EULA”) available at
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+**
+** (2) if the Software is obtained from any third party, such licensing terms
+** as notified by that third party,
+**
+** and all subject to the following:
+**
+** (3) the copyright notices in the Software and this entire statement,
+** including the above license grant, this restriction and the following
+** disclaimer, must be included in all copies of the Software, in whole or in
+** part, and all derivative works of the Software, unless such copies or
+** derivative works are solely in the form of machine-executable object code
+** generated by a source language processor.
+**
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+** DEALINGS IN THE SOFTWARE.
+**
+** A copy of the Software is available free of charge at
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+**
+** -LICENSE-END-
+*/
+
+#pragma once
+
+#include <condition_variable>
+#include <map>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "DeckLinkAPI.h"
+#include "AudioSampleBuffer.h"
+#include "FrameTimer.h"
+#include "VirtualDeckLinkSettings.h"
+#include "com_ptr.h"
+
+class VirtualDeckLinkDevice;
+
+struct VirtualOutputStatus
+{
+	bool				videoEnabled;
+	BMDDisplayMode		displayMode;
+	BMDVideoOutputFlags	flags;
+	BMDPixelFormat		lastPixelFormat;
+};
+
+// Playback side of a virtual device.  A playout thread ticks at each frame boundary of the enabled
+// display mode, displays the scheduled frame due at that stream time and completes the previous one.
+// Displayed frames and audio are passed to the device loopback.  Shares the reference count of the
+// owning device.
+class VirtualDeckLinkOutput : public IDeckLinkOutput
+{
+public:
+	explicit VirtualDeckLinkOutput(VirtualDeckLinkDevice* device);
+	virtual ~VirtualDeckLinkOutput() = default;
+
+	// IUnknown interface
+	HRESULT		STDMETHODCALLTYPE QueryInterface(REFIID iid, LPVOID *ppv) override;
+	ULONG		STDMETHODCALLTYPE AddRef() override;
+	ULONG		STDMETHODCALLTYPE Release() override;
+
+	// IDeckLinkOutput interface
+	HRESULT		STDMETHODCALLTYPE DoesSupportVideoMode(BMDVideoConnection connection, BMDDisplayMode requestedMode, BMDPixelFormat requestedPixelFormat, BMDVideoOutputConversionMode conversionMode, BMDSupportedVideoModeFlags flags, BMDDisplayMode* actualMode, bool* supported) override;
+	HRESULT		STDMETHODCALLTYPE GetDisplayMode(BMDDisplayMode displayMode, IDeckLinkDisplayMode** resultDisplayMode) override;
+	HRESULT		STDMETHODCALLTYPE GetDisplayModeIterator(IDeckLinkDisplayModeIterator** iterator) override;
+	HRESULT		STDMETHODCALLTYPE SetScreenPreviewCallback(IDeckLinkScreenPreviewCallback* previewCallback) override;
+
+	HRESULT		STDMETHODCALLTYPE EnableVideoOutput(BMDDisplayMode displayMode, BMDVideoOutputFlags flags) override;
+	HRESULT		STDMETHODCALLTYPE DisableVideoOutput(void) override;
+	HRESULT		STDMETHODCALLTYPE SetVideoOutputFrameMemoryAllocator(IDeckLinkMemoryAllocator* theAllocator) override;
+	HRESULT		STDMETHODCALLTYPE CreateVideoFrame(int32_t width, int32_t height, int32_t rowBytes, BMDPixelFormat pixelFormat, BMDFrameFlags flags, IDeckLinkMutableVideoFrame** outFrame) override;
+	HRESULT		STDMETHODCALLTYPE CreateAncillaryData(BMDPixelFormat pixelFormat, IDeckLinkVideoFrameAncillary** outBuffer) override;
+	HRESULT		STDMETHODCALLTYPE DisplayVideoFrameSync(IDeckLinkVideoFrame* theFrame) override;
+	HRESULT		STDMETHODCALLTYPE ScheduleVideoFrame(IDeckLinkVideoFrame* theFrame, BMDTimeValue displayTime, BMDTimeValue displayDuration, BMDTimeScale timeScale) override;
+	HRESULT		STDMETHODCALLTYPE SetScheduledFrameCompletionCallback(IDeckLinkVideoOutputCallback* theCallback) override;
+	HRESULT		STDMETHODCALLTYPE GetBufferedVideoFrameCount(uint32_t* bufferedFrameCount) override;
+
+	HRESULT		STDMETHODCALLTYPE EnableAudioOutput(BMDAudioSampleRate sampleRate, BMDAudioSampleType sampleType, uint32_t channelCount, BMDAudioOutputStreamType streamType) override;
+	HRESULT		STDMETHODCALLTYPE DisableAudioOutput(void) override;
+	HRESULT		STDMETHODCALLTYPE WriteAudioSamplesSync(void* buffer, uint32_t sampleFrameCount, uint32_t* sampleFramesWritten) override;
+	HRESULT		STDMETHODCALLTYPE BeginAudioPreroll(void) override;
+	HRESULT		STDMETHODCALLTYPE EndAudioPreroll(void) override;
+	HRESULT		STDMETHODCALLTYPE ScheduleAudioSamples(void* buffer, uint32_t sampleFrameCount, BMDTimeValue streamTime, BMDTimeScale timeScale, uint32_t* sampleFramesWritten) override;
+	HRESULT		STDMETHODCALLTYPE GetBufferedAudioSampleFrameCount(uint32_t* bufferedSampleFrameCount) override;
+	HRESULT		STDMETHODCALLTYPE FlushBufferedAudioSamples(void) override;
+	HRESULT		STDMETHODCALLTYPE SetAudioCallback(IDeckLinkAudioOutputCallback* theCallback) override;
+
+	HRESULT		STDMETHODCALLTYPE StartScheduledPlayback(BMDTimeValue playbackStartTime, BMDTimeScale timeScale, double playbackSpeed) override;
+	HRESULT		STDMETHODCALLTYPE StopScheduledPlayback(BMDTimeValue stopPlaybackAtTime, BMDTimeValue* actualStopTime, BMDTimeScale timeScale) override;
+	HRESULT		STDMETHODCALLTYPE IsScheduledPlaybackRunning(bool* active) override;
+	HRESULT		STDMETHODCALLTYPE GetScheduledStreamTime(BMDTimeScale desiredTimeScale, BMDTimeValue* streamTime, double* playbackSpeed) override;
+	HRESULT		STDMETHODCALLTYPE GetReferenceStatus(BMDReferenceStatus* referenceStatus) override;
+
+	HRESULT		STDMETHODCALLTYPE GetHardwareReferenceClock(BMDTimeScale desiredTimeScale, BMDTimeValue* hardwareTime, BMDTimeValue* timeInFrame, BMDTimeValue* ticksPerFrame) override;
+	HRESULT		STDMETHODCALLTYPE GetFrameCompletionReferenceTimestamp(IDeckLinkVideoFrame* theFrame, BMDTimeScale desiredTimeScale, BMDTimeValue* frameCompletionTimestamp) override;
+
+	VirtualOutputStatus	getStatus(void);
+
+private:
+	struct ScheduledFrame
+	{
+		com_ptr<IDeckLinkVideoFrame>	frame;
+		BMDTimeValue					duration;
+	};
+
+	struct FrameCompletion
+	{
+		com_ptr<IDeckLinkVideoFrame>	frame;
+		BMDOutputFrameCompletionResult	result;
+	};
+
+	struct CompletionTime
+	{
+		IDeckLinkVideoFrame*			frame;
+		BMDTimeValue					timestampNanoseconds;
+	};
+
+	// Keep completion times for recently completed frames, enough to cover any callback latency
+	static const size_t kCompletionTimeCount = 64;
+
+	VirtualDeckLinkDevice*								m_device;
+	std::mutex											m_mutex;
+	std::condition_variable								m_condition;
+	std::thread											m_thread;
+	FaultInjector										m_faultInjector;
+	//
+	com_ptr<IDeckLinkVideoOutputCallback>				m_callback;
+	com_ptr<IDeckLinkAudioOutputCallback>				m_audioCallback;
+	com_ptr<IDeckLinkScreenPreviewCallback>				m_previewCallback;
+	com_ptr<IDeckLinkMemoryAllocator>					m_defaultAllocator;
+	com_ptr<IDeckLinkMemoryAllocator>					m_allocator;
+	//
+	bool												m_videoEnabled;
+	BMDDisplayMode										m_displayMode;
+	BMDVideoOutputFlags									m_flags;
+	BMDPixelFormat										m_lastPixelFormat;
+	FrameTimer											m_frameTimer;
+	uint64_t											m_tick;
+	uint64_t											m_generation;
+	bool												m_callbackActive;
+	//
+	// Scheduled frames keyed by display time in the display mode time scale
+	std::multimap<BMDTimeValue, ScheduledFrame>			m_scheduledFrames;
+	com_ptr<IDeckLinkVideoFrame>						m_displayedFrame;
+	BMDOutputFrameCompletionResult						m_displayedResult;
+	std::vector<FrameCompletion>						m_pendingCompletions;
+	std::vector<CompletionTime>							m_completionTimes;
+	size_t												m_completionTimeIndex;
+	//
+	bool												m_playbackRunning;
+	BMDTimeValue										m_playbackStartTime;
+	uint64_t											m_playbackStartTick;
+	BMDTimeValue										m_stopTime;
+	bool												m_stopPending;
+	bool												m_stopNotificationPending;
+	//
+	bool												m_audioEnabled;
+	BMDAudioSampleType									m_audioSampleType;
+	uint32_t											m_audioChannelCount;
+	bool												m_audioPreroll;
+	bool												m_audioSync;
+	AudioSampleBuffer									m_audioBuffer;
+	std::vector<uint8_t>								m_audioTickBuffer;
+	uint32_t											m_audioTickSampleFrameCount;	// Samples playing since the last frame boundary
+
+	void		playoutThread(void);
+	void		flushScheduledFrames(std::vector<FrameCompletion>& completions);
+	void		recordCompletionTime(IDeckLinkVideoFrame* frame, BMDTimeValue timestampNanoseconds);
+	void		waitForCallback(std::unique_lock<std::mutex>& lock);
+	bool		isPlayoutThread(void) const		{ return std::this_thread::get_id() == m_thread.get_id(); }
+	BMDTimeValue	streamTimeAtTick(uint64_t tick) const;
+};
@@ -0,0 +1,157 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**
+** Permission is hereby granted, free of charge, to any person or organization
+** obtaining a copy of the software and accompanying documentation (the
+** "Software") to use, reproduce, display, distribute, sub-license, execute,
+** and transmit the Software, and to prepare derivative works of the Software,
+** and to permit third-parties to whom the Software is furnished to do so, in
+** accordance with:
+**
+** (1) if the Software is obtained from Blackmagic Design, the End User License
+** Agreement for the Software Development Kit (“EULA”) available at
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+**
+** (2) if the Software is obtained from any third party, such licensing terms
+** as notified by that third party,
+**
+** and all subject to the following:
+**
+** (3) the copyright notices in the Software and this entire statement,
+** including the above license grant, this restriction and the following
+** disclaimer, must be included in all copies of the Software, in whole or in
+** part, and all derivative works of the Software, unless such copies or
+** derivative works are solely in the form of machine-executable object code
+** generated by a source language processor.
+**
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+** DEALINGS IN THE SOFTWARE.
+**
+** A copy of the Software is available free of charge at
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+**
+** -LICENSE-END-
+*/
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <string>
+#include "VirtualDeckLinkSettings.h"
+
+static const uint32_t kDefaultDeviceCount	= 2;
+static const uint32_t kMaximumDeviceCount	= 64;
+static const int32_t kMaximumClockOffset	= 100000;
+
+static const char* getVariable(const char* name)
+{
+	const char* value = getenv(name);
+	return (value && *value) ? value : nullptr;
+}
+
+static uint32_t getUnsigned(const char* name, uint32_t defaultValue)
+{
+	const char* value = getVariable(name);
+	return value ? (uint32_t)strtoul(value, nullptr, 0) : defaultValue;
+}
+
+static int32_t getSigned(const char* name, int32_t defaultValue)
+{
+	const char* value = getVariable(name);
+	return value ? (int32_t)strtol(value, nullptr, 0) : defaultValue;
+}
+
+static double getProbability(const char* name)
+{
+	const char*	value		= getVariable(name);
+	double		probability	= value ? strtod(value, nullptr) : 0.0;
+
+	if (probability < 0.0)
+		return 0.0;
+	if (probability > 1.0)
+		return 1.0;
+	return probability;
+}
+
+static BMDDisplayMode fourCC(const std::string& code)
+{
+	uint32_t value = 0;
+
+	// Display modes are identified by their four-character code, short codes are padded with spaces (eg 'pal ')
+	for (size_t i = 0; i < 4; i++)
+		value = (value << 8) | (uint8_t)(i < code.size() ? code[i] : ' ');
+
+	return (BMDDisplayMode)value;
+}
+
+static std::vector<BMDDisplayMode> getDisplayModes(const char* name, const char* defaultValue)
+{
+	std::vector<BMDDisplayMode>	modes;
+	const char*					value = getVariable(name);
+	std::string					list(value ? value : defaultValue);
+	size_t						start = 0;
+
+	while (start <= list.size())
+	{
+		size_t end = list.find(',', start);
+		if (end == std::string::npos)
+			end = list.size();
+
+		if (end > start)
+			modes.push_back(fourCC(list.substr(start, end - start)));
+
+		start = end + 1;
+	}
+
+	return modes;
+}
+
+const VirtualDeckLinkSettings& VirtualDeckLinkSettings::get(void)
+{
+	static const VirtualDeckLinkSettings settings = []
+	{
+		VirtualDeckLinkSettings s;
+
+		s.deviceCount			= getUnsigned("VIRTUAL_DECKLINK_DEVICES", kDefaultDeviceCount);
+		s.jitterMicroseconds	= getUnsigned("VIRTUAL_DECKLINK_JITTER_US", 0);
+		s.inputDropRate			= getProbability("VIRTUAL_DECKLINK_INPUT_DROP_RATE");
+		s.outputDropRate		= getProbability("VIRTUAL_DECKLINK_OUTPUT_DROP_RATE");
+		s.formatChangeInterval	= getUnsigned("VIRTUAL_DECKLINK_FORMAT_CHANGE_FRAMES", 0);
+		s.formatChangeModes		= getDisplayModes("VIRTUAL_DECKLINK_FORMAT_CHANGE_MODES", "Hp25,Hp30");
+		s.loopback				= getUnsigned("VIRTUAL_DECKLINK_LOOPBACK", 1) != 0;
+		s.inputClockOffset		= getSigned("VIRTUAL_DECKLINK_INPUT_CLOCK_PPM", 0);
+		s.copyFrames			= getUnsigned("VIRTUAL_DECKLINK_COPY_FRAMES", 1) != 0;
+		s.seed					= getUnsigned("VIRTUAL_DECKLINK_SEED", 1);
+
+		if (s.deviceCount > kMaximumDeviceCount)
+			s.deviceCount = kMaximumDeviceCount;
+
+		// Keep the frame clock within 10% of nominal
+		s.inputClockOffset = std::max(std::min(s.inputClockOffset, kMaximumClockOffset), -kMaximumClockOffset);
+
+		return s;
+	}();
+
+	return settings;
+}
+
+bool FaultInjector::shouldDrop(double rate)
+{
+	if (rate <= 0.0)
+		return false;
+
+	return std::uniform_real_distribution<double>(0.0, 1.0)(m_generator) < rate;
+}
+
+std::chrono::microseconds FaultInjector::jitter(uint32_t maximumMicroseconds)
+{
+	if (maximumMicroseconds == 0)
+		return std::chrono::microseconds(0);
+
+	return std::chrono::microseconds(std::uniform_int_distribution<uint32_t>(0, maximumMicroseconds)(m_generator));
+}
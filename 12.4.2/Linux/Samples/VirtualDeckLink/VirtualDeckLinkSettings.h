@@ -0,0 +1,91 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**
+** Permission is hereby granted, free of charge, to any person or organization
+** obtaining a copy of the software and accompanying documentation (the
+** "Software") to use, reproduce, display, distribute, sub-license, execute,
+** and transmit the Software, and to prepare derivative works of the Software,
+** and to permit third-parties to whom the Software is furnished to do so, in
+** accordance with:
+**
+** (1) if the Software is obtained from Blackmagic Design, the End User License
+** Agreement for the Software Development Kit (“EULA”) available at
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+**
+** (2) if the Software is obtained from any third party, such licensing terms
+** as notified by that third party,
+**
+** and all subject to the following:
+**
+** (3) the copyright notices in the Software and this entire statement,
+** including the above license grant, this restriction and the following
+** disclaimer, must be included in all copies of the Software, in whole or in
+** part, and all derivative works of the Software, unless such copies or
+** derivative works are solely in the form of machine-executable object code
+** generated by a source language processor.
+**
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+** DEALINGS IN THE SOFTWARE.
+**
+** A copy of the Software is available free of charge at
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+**
+** -LICENSE-END-
+*/
+
+#pragma once
+
+#include <chrono>
+#include <random>
+#include <vector>
+
+#include "DeckLinkAPI.h"
+
+// The virtual driver is configured with environment variables, read once when the library is first used:
+//
+//   DECKLINK_API_LIBRARY                    Path to this library, honoured by DeckLinkAPIDispatch.cpp
+//   VIRTUAL_DECKLINK_DEVICES                Number of devices to enumerate (default 2)
+//   VIRTUAL_DECKLINK_JITTER_US              Maximum random delay added to each callback, in microseconds (default 0)
+//   VIRTUAL_DECKLINK_INPUT_DROP_RATE        Probability (0.0-1.0) that a captured frame is not delivered (default 0)
+//   VIRTUAL_DECKLINK_OUTPUT_DROP_RATE       Probability (0.0-1.0) that a scheduled frame completes as dropped (default 0)
+//   VIRTUAL_DECKLINK_FORMAT_CHANGE_FRAMES   Frames between injected input format changes, 0 to disable (default 0)
+//   VIRTUAL_DECKLINK_FORMAT_CHANGE_MODES    Comma separated display mode four-character codes to cycle through (default Hp25,Hp30)
+//   VIRTUAL_DECKLINK_LOOPBACK               Route each device's output back to its input, 0 to disable (default 1)
+//   VIRTUAL_DECKLINK_INPUT_CLOCK_PPM        Offset of the input frame clock from the output's, in parts per million,
+//                                           as an input that is not locked to the output's reference (default 0)
+//   VIRTUAL_DECKLINK_COPY_FRAMES            Copy pixel data into captured frames, 0 to skip the copy for load tests (default 1)
+//   VIRTUAL_DECKLINK_SEED                   Seed for the jitter and drop generators (default 1)
+
+struct VirtualDeckLinkSettings
+{
+	uint32_t					deviceCount;
+	uint32_t					jitterMicroseconds;
+	double						inputDropRate;
+	double						outputDropRate;
+	uint32_t					formatChangeInterval;
+	std::vector<BMDDisplayMode>	formatChangeModes;
+	bool						loopback;
+	int32_t						inputClockOffset;
+	bool						copyFrames;
+	uint32_t					seed;
+
+	static const VirtualDeckLinkSettings& get(void);
+};
+
+// Random source for injected faults, one per streaming thread so that runs are repeatable for a given seed
+class FaultInjector
+{
+public:
+	explicit FaultInjector(uint32_t seed) : m_generator(seed) { }
+
+	bool						shouldDrop(double rate);
+	std::chrono::microseconds	jitter(uint32_t maximumMicroseconds);
+
+private:
+	std::mt19937				m_generator;
+};
@@ -0,0 +1,306 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**
+** Permission is hereby granted, free of charge, to any person or organization
+** obtaining a copy of the software and accompanying documentation (the
+** "Software") to use, reproduce, display, distribute, sub-license, execute,
+** and transmit the Software, and to prepare derivative works of the Software,
+** and to permit third-parties to whom the Software is furnished to do so, in
+** accordance with:
+**
+** (1) if the Software is obtained from Blackmagic Design, the End User License
+** Agreement for the Software Development Kit (“EULA”) available at
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+**
+** (2) if the Software is obtained from any third party, such licensing terms
+** as notified by that third party,
+**
+** and all subject to the following:
+**
+** (3) the copyright notices in the Software and this entire statement,
+** including the above license grant, this restriction and the following
+** disclaimer, must be included in all copies of the Software, in whole or in
+** part, and all derivative works of the Software, unless such copies or
+** derivative works are solely in the form of machine-executable object code
+** generated by a source language processor.
+**
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+** DEALINGS IN THE SOFTWARE.
+**
+** A copy of the Software is available free of charge at
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+**
+** -LICENSE-END-
+*/
+
+#include "VirtualDisplayMode.h"
+#include "platform.h"
+
+static const BMDDisplayModeFlags kSDFlags	= bmdDisplayModeColorspaceRec601;
+static const BMDDisplayModeFlags kHDFlags	= bmdDisplayModeColorspaceRec709;
+static const BMDDisplayModeFlags kHD3DFlags	= bmdDisplayModeColorspaceRec709 | bmdDisplayModeSupports3D;
+static const BMDDisplayModeFlags kUHDFlags	= bmdDisplayModeColorspaceRec709 | bmdDisplayModeColorspaceRec2020;
+
+static const std::vector<VirtualDisplayModeInfo> kDisplayModes =
+{
+	// SD Modes
+	{ bmdModeNTSC,				"NTSC",				720,	486,	1001,	30000,	bmdLowerFieldFirst,		kSDFlags },
+	{ bmdModeNTSC2398,			"NTSC 23.98",		720,	486,	1001,	24000,	bmdLowerFieldFirst,		kSDFlags },
+	{ bmdModePAL,				"PAL",				720,	576,	1000,	25000,	bmdUpperFieldFirst,		kSDFlags },
+	{ bmdModeNTSCp,				"NTSC Progressive",	720,	486,	1001,	60000,	bmdProgressiveFrame,	kSDFlags },
+	{ bmdModePALp,				"PAL Progressive",	720,	576,	1000,	50000,	bmdProgressiveFrame,	kSDFlags },
+
+	// HD 1080 Modes
+	{ bmdModeHD1080p2398,		"1080p23.98",		1920,	1080,	1001,	24000,	bmdProgressiveFrame,	kHD3DFlags },
+	{ bmdModeHD1080p24,			"1080p24",			1920,	1080,	1000,	24000,	bmdProgressiveFrame,	kHD3DFlags },
+	{ bmdModeHD1080p25,			"1080p25",			1920,	1080,	1000,	25000,	bmdProgressiveFrame,	kHD3DFlags },
+	{ bmdModeHD1080p2997,		"1080p29.97",		1920,	1080,	1001,	30000,	bmdProgressiveFrame,	kHD3DFlags },
+	{ bmdModeHD1080p30,			"1080p30",			1920,	1080,	1000,	30000,	bmdProgressiveFrame,	kHD3DFlags },
+	{ bmdModeHD1080p4795,		"1080p47.95",		1920,	1080,	1001,	48000,	bmdProgressiveFrame,	kHDFlags },
+	{ bmdModeHD1080p48,			"1080p48",			1920,	1080,	1000,	48000,	bmdProgressiveFrame,	kHDFlags },
+	{ bmdModeHD1080p50,			"1080p50",			1920,	1080,	1000,	50000,	bmdProgressiveFrame,	kHDFlags },
+	{ bmdModeHD1080p5994,		"1080p59.94",		1920,	1080,	1001,	60000,	bmdProgressiveFrame,	kHDFlags },
+	{ bmdModeHD1080p6000,		"1080p60",			1920,	1080,	1000,	60000,	bmdProgressiveFrame,	kHDFlags },
+	{ bmdModeHD1080p9590,		"1080p95.90",		1920,	1080,	1001,	96000,	bmdProgressiveFrame,	kHDFlags },
+	{ bmdModeHD1080p96,			"1080p96",			1920,	1080,	1000,	96000,	bmdProgressiveFrame,	kHDFlags },
+	{ bmdModeHD1080p100,		"1080p100",			1920,	1080,	1000,	100000,	bmdProgressiveFrame,	kHDFlags },
+	{ bmdModeHD1080p11988,		"1080p119.88",		1920,	1080,	1001,	120000,	bmdProgressiveFrame,	kHDFlags },
+	{ bmdModeHD1080p120,		"1080p120",			1920,	1080,	1000,	120000,	bmdProgressiveFrame,	kHDFlags },
+	{ bmdModeHD1080i50,			"1080i50",			1920,	1080,	1000,	25000,	bmdUpperFieldFirst,		kHD3DFlags },
+	{ bmdModeHD1080i5994,		"1080i59.94",		1920,	1080,	1001,	30000,	bmdUpperFieldFirst,		kHD3DFlags },
+	{ bmdModeHD1080i6000,		"1080i60",			1920,	1080,	1000,	30000,	bmdUpperFieldFirst,		kHD3DFlags },
+
+	// HD 720 Modes
+	{ bmdModeHD720p50,			"720p50",			1280,	720,	1000,	50000,	bmdProgressiveFrame,	kHD3DFlags },
+	{ bmdModeHD720p5994,		"720p59.94",		1280,	720,	1001,	60000,	bmdProgressiveFrame,	kHD3DFlags },
+	{ bmdModeHD720p60,			"720p60",			1280,	720,	1000,	60000,	bmdProgressiveFrame,	kHD3DFlags },
+
+	// 2K Modes
+	{ bmdMode2k2398,			"2K 23.98",			2048,	1556,	1001,	24000,	bmdProgressiveSegmentedFrame,	kHDFlags },
+	{ bmdMode2k24,				"2K 24",			2048,	1556,	1000,	24000,	bmdProgressiveSegmentedFrame,	kHDFlags },
+	{ bmdMode2k25,				"2K 25",			2048,	1556,	1000,	25000,	bmdProgressiveSegmentedFrame,	kHDFlags },
+
+	// 2K DCI Modes
+	{ bmdMode2kDCI2398,			"2K DCI 23.98",		2048,	1080,	1001,	24000,	bmdProgressiveFrame,	kHDFlags },
+	{ bmdMode2kDCI24,			"2K DCI 24",		2048,	1080,	1000,	24000,	bmdProgressiveFrame,	kHDFlags },
+	{ bmdMode2kDCI25,			"2K DCI 25",		2048,	1080,	1000,	25000,	bmdProgressiveFrame,	kHDFlags },
+	{ bmdMode2kDCI2997,			"2K DCI 29.97",		2048,	1080,	1001,	30000,	bmdProgressiveFrame,	kHDFlags },
+	{ bmdMode2kDCI30,			"2K DCI 30",		2048,	1080,	1000,	30000,	bmdProgressiveFrame,	kHDFlags },
+	{ bmdMode2kDCI4795,			"2K DCI 47.95",		2048,	1080,	1001,	48000,	bmdProgressiveFrame,	kHDFlags },
+	{ bmdMode2kDCI48,			"2K DCI 48",		2048,	1080,	1000,	48000,	bmdProgressiveFrame,	kHDFlags },
+	{ bmdMode2kDCI50,			"2K DCI 50",		2048,	1080,	1000,	50000,	bmdProgressiveFrame,	kHDFlags },
+	{ bmdMode2kDCI5994,			"2K DCI 59.94",		2048,	1080,	1001,	60000,	bmdProgressiveFrame,	kHDFlags },
+	{ bmdMode2kDCI60,			"2K DCI 60",		2048,	1080,	1000,	60000,	bmdProgressiveFrame,	kHDFlags },
+	{ bmdMode2kDCI9590,			"2K DCI 95.90",		2048,	1080,	1001,	96000,	bmdProgressiveFrame,	kHDFlags },
+	{ bmdMode2kDCI96,			"2K DCI 96",		2048,	1080,	1000,	96000,	bmdProgressiveFrame,	kHDFlags },
+	{ bmdMode2kDCI100,			"2K DCI 100",		2048,	1080,	1000,	100000,	bmdProgressiveFrame,	kHDFlags },
+	{ bmdMode2kDCI11988,		"2K DCI 119.88",	2048,	1080,	1001,	120000,	bmdProgressiveFrame,	kHDFlags },
+	{ bmdMode2kDCI120,			"2K DCI 120",		2048,	1080,	1000,	120000,	bmdProgressiveFrame,	kHDFlags },
+
+	// 4K UHD Modes
+	{ bmdMode4K2160p2398,		"2160p23.98",		3840,	2160,	1001,	24000,	bmdProgressiveFrame,	kUHDFlags },
+	{ bmdMode4K2160p24,			"2160p24",			3840,	2160,	1000,	24000,	bmdProgressiveFrame,	kUHDFlags },
+	{ bmdMode4K2160p25,			"2160p25",			3840,	2160,	1000,	25000,	bmdProgressiveFrame,	kUHDFlags },
+	{ bmdMode4K2160p2997,		"2160p29.97",		3840,	2160,	1001,	30000,	bmdProgressiveFrame,	kUHDFlags },
+	{ bmdMode4K2160p30,			"2160p30",			3840,	2160,	1000,	30000,	bmdProgressiveFrame,	kUHDFlags },
+	{ bmdMode4K2160p4795,		"2160p47.95",		3840,	2160,	1001,	48000,	bmdProgressiveFrame,	kUHDFlags },
+	{ bmdMode4K2160p48,			"2160p48",			3840,	2160,	1000,	48000,	bmdProgressiveFrame,	kUHDFlags },
+	{ bmdMode4K2160p50,			"2160p50",			3840,	2160,	1000,	50000,	bmdProgressiveFrame,	kUHDFlags },
+	{ bmdMode4K2160p5994,		"2160p59.94",		3840,	2160,	1001,	60000,	bmdProgressiveFrame,	kUHDFlags },
+	{ bmdMode4K2160p60,			"2160p60",			3840,	2160,	1000,	60000,	bmdProgressiveFrame,	kUHDFlags },
+	{ bmdMode4K2160p9590,		"2160p95.90",		3840,	2160,	1001,	96000,	bmdProgressiveFrame,	kUHDFlags },
+	{ bmdMode4K2160p96,			"2160p96",			3840,	2160,	1000,	96000,	bmdProgressiveFrame,	kUHDFlags },
+	{ bmdMode4K2160p100,		"2160p100",			3840,	2160,	1000,	100000,	bmdProgressiveFrame,	kUHDFlags },
+	{ bmdMode4K2160p11988,		"2160p119.88",		3840,	2160,	1001,	120000,	bmdProgressiveFrame,	kUHDFlags },
+	{ bmdMode4K2160p120,		"2160p120",			3840,	2160,	1000,	120000,	bmdProgressiveFrame,	kUHDFlags },
+
+	// 4K DCI Modes
+	{ bmdMode4kDCI2398,			"4K DCI 23.98",		4096,	2160,	1001,	24000,	bmdProgressiveFrame,	kUHDFlags },
+	{ bmdMode4kDCI24,			"4K DCI 24",		4096,	2160,	1000,	24000,	bmdProgressiveFrame,	kUHDFlags },
+	{ bmdMode4kDCI25,			"4K DCI 25",		4096,	2160,	1000,	25000,	bmdProgressiveFrame,	kUHDFlags },
+	{ bmdMode4kDCI2997,			"4K DCI 29.97",		4096,	2160,	1001,	30000,	bmdProgressiveFrame,	kUHDFlags },
+	{ bmdMode4kDCI30,			"4K DCI 30",		4096,	2160,	1000,	30000,	bmdProgressiveFrame,	kUHDFlags },
+	{ bmdMode4kDCI4795,			"4K DCI 47.95",		4096,	2160,	1001,	48000,	bmdProgressiveFrame,	kUHDFlags },
+	{ bmdMode4kDCI48,			"4K DCI 48",		4096,	2160,	1000,	48000,	bmdProgressiveFrame,	kUHDFlags },
+	{ bmdMode4kDCI50,			"4K DCI 50",		4096,	2160,	1000,	50000,	bmdProgressiveFrame,	kUHDFlags },
+	{ bmdMode4kDCI5994,			"4K DCI 59.94",		4096,	2160,	1001,	60000,	bmdProgressiveFrame,	kUHDFlags },
+	{ bmdMode4kDCI60,			"4K DCI 60",		4096,	2160,	1000,	60000,	bmdProgressiveFrame,	kUHDFlags },
+	{ bmdMode4kDCI9590,			"4K DCI 95.90",		4096,	2160,	1001,	96000,	bmdProgressiveFrame,	kUHDFlags },
+	{ bmdMode4kDCI96,			"4K DCI 96",		4096,	2160,	1000,	96000,	bmdProgressiveFrame,	kUHDFlags },
+	{ bmdMode4kDCI100,			"4K DCI 100",		4096,	2160,	1000,	100000,	bmdProgressiveFrame,	kUHDFlags },
+	{ bmdMode4kDCI11988,		"4K DCI 119.88",	4096,	2160,	1001,	120000,	bmdProgressiveFrame,	kUHDFlags },
+	{ bmdMode4kDCI120,			"4K DCI 120",		4096,	2160,	1000,	120000,	bmdProgressiveFrame,	kUHDFlags },
+
+	// 8K UHD Modes
+	{ bmdMode8K4320p2398,		"4320p23.98",		7680,	4320,	1001,	24000,	bmdProgressiveFrame,	kUHDFlags },
+	{ bmdMode8K4320p24,			"4320p24",			7680,	4320,	1000,	24000,	bmdProgressiveFrame,	kUHDFlags },
+	{ bmdMode8K4320p25,			"4320p25",			7680,	4320,	1000,	25000,	bmdProgressiveFrame,	kUHDFlags },
+	{ bmdMode8K4320p2997,		"4320p29.97",		7680,	4320,	1001,	30000,	bmdProgressiveFrame,	kUHDFlags },
+	{ bmdMode8K4320p30,			"4320p30",			7680,	4320,	1000,	30000,	bmdProgressiveFrame,	kUHDFlags },
+	{ bmdMode8K4320p4795,		"4320p47.95",		7680,	4320,	1001,	48000,	bmdProgressiveFrame,	kUHDFlags },
+	{ bmdMode8K4320p48,			"4320p48",			7680,	4320,	1000,	48000,	bmdProgressiveFrame,	kUHDFlags },
+	{ bmdMode8K4320p50,			"4320p50",			7680,	4320,	1000,	50000,	bmdProgressiveFrame,	kUHDFlags },
+	{ bmdMode8K4320p5994,		"4320p59.94",		7680,	4320,	1001,	60000,	bmdProgressiveFrame,	kUHDFlags },
+	{ bmdMode8K4320p60,			"4320p60",			7680,	4320,	1000,	60000,	bmdProgressiveFrame,	kUHDFlags },
+
+	// 8K DCI Modes
+	{ bmdMode8kDCI2398,			"8K DCI 23.98",		8192,	4320,	1001,	24000,	bmdProgressiveFrame,	kUHDFlags },
+	{ bmdMode8kDCI24,			"8K DCI 24",		8192,	4320,	1000,	24000,	bmdProgressiveFrame,	kUHDFlags },
+	{ bmdMode8kDCI25,			"8K DCI 25",		8192,	4320,	1000,	25000,	bmdProgressiveFrame,	kUHDFlags },
+	{ bmdMode8kDCI2997,			"8K DCI 29.97",		8192,	4320,	1001,	30000,	bmdProgressiveFrame,	kUHDFlags },
+	{ bmdMode8kDCI30,			"8K DCI 30",		8192,	4320,	1000,	30000,	bmdProgressiveFrame,	kUHDFlags },
+	{ bmdMode8kDCI4795,			"8K DCI 47.95",		8192,	4320,	1001,	48000,	bmdProgressiveFrame,	kUHDFlags },
+	{ bmdMode8kDCI48,			"8K DCI 48",		8192,	4320,	1000,	48000,	bmdProgressiveFrame,	kUHDFlags },
+	{ bmdMode8kDCI50,			"8K DCI 50",		8192,	4320,	1000,	50000,	bmdProgressiveFrame,	kUHDFlags },
+	{ bmdMode8kDCI5994,			"8K DCI 59.94",		8192,	4320,	1001,	60000,	bmdProgressiveFrame,	kUHDFlags },
+	{ bmdMode8kDCI60,			"8K DCI 60",		8192,	4320,	1000,	60000,	bmdProgressiveFrame,	kUHDFlags },
+
+	// PC Modes
+	{ bmdMode640x480p60,		"640x480p60",		640,	480,	1000,	60000,	bmdProgressiveFrame,	kSDFlags },
+	{ bmdMode800x600p60,		"800x600p60",		800,	600,	1000,	60000,	bmdProgressiveFrame,	kSDFlags },
+	{ bmdMode1440x900p50,		"1440x900p50",		1440,	900,	1000,	50000,	bmdProgressiveFrame,	kHDFlags },
+	{ bmdMode1440x900p60,		"1440x900p60",		1440,	900,	1000,	60000,	bmdProgressiveFrame,	kHDFlags },
+	{ bmdMode1440x1080p50,		"1440x1080p50",		1440,	1080,	1000,	50000,	bmdProgressiveFrame,	kHDFlags },
+	{ bmdMode1440x1080p60,		"1440x1080p60",		1440,	1080,	1000,	60000,	bmdProgressiveFrame,	kHDFlags },
+	{ bmdMode1600x1200p50,		"1600x1200p50",		1600,	1200,	1000,	50000,	bmdProgressiveFrame,	kHDFlags },
+	{ bmdMode1600x1200p60,		"1600x1200p60",		1600,	1200,	1000,	60000,	bmdProgressiveFrame,	kHDFlags },
+	{ bmdMode1920x1200p50,		"1920x1200p50",		1920,	1200,	1000,	50000,	bmdProgressiveFrame,	kHDFlags },
+	{ bmdMode1920x1200p60,		"1920x1200p60",		1920,	1200,	1000,	60000,	bmdProgressiveFrame,	kHDFlags },
+	{ bmdMode1920x1440p50,		"1920x1440p50",		1920,	1440,	1000,	50000,	bmdProgressiveFrame,	kHDFlags },
+	{ bmdMode1920x1440p60,		"1920x1440p60",		1920,	1440,	1000,	60000,	bmdProgressiveFrame,	kHDFlags },
+	{ bmdMode2560x1440p50,		"2560x1440p50",		2560,	1440,	1000,	50000,	bmdProgressiveFrame,	kHDFlags },
+	{ bmdMode2560x1440p60,		"2560x1440p60",		2560,	1440,	1000,	60000,	bmdProgressiveFrame,	kHDFlags },
+	{ bmdMode2560x1600p50,		"2560x1600p50",		2560,	1600,	1000,	50000,	bmdProgressiveFrame,	kHDFlags },
+	{ bmdMode2560x1600p60,		"2560x1600p60",		2560,	1600,	1000,	60000,	bmdProgressiveFrame,	kHDFlags },
+};
+
+const std::vector<VirtualDisplayModeInfo>& GetVirtualDisplayModes(void)
+{
+	return kDisplayModes;
+}
+
+const VirtualDisplayModeInfo* FindVirtualDisplayMode(BMDDisplayMode displayMode)
+{
+	for (auto& info : kDisplayModes)
+	{
+		if (info.displayMode == displayMode)
+			return &info;
+	}
+
+	return nullptr;
+}
+
+/// VirtualDisplayMode
+
+VirtualDisplayMode::VirtualDisplayMode(const VirtualDisplayModeInfo& info) :
+	m_refCount(1),
+	m_info(info)
+{
+}
+
+HRESULT VirtualDisplayMode::QueryInterface(REFIID iid, LPVOID *ppv)
+{
+	if (!ppv)
+		return E_INVALIDARG;
+
+	if (iid == IID_IUnknown || iid == IID_IDeckLinkDisplayMode)
+	{
+		*ppv = static_cast<IDeckLinkDisplayMode*>(this);
+		AddRef();
+		return S_OK;
+	}
+
+	*ppv = nullptr;
+	return E_NOINTERFACE;
+}
+
+ULONG VirtualDisplayMode::AddRef(void)
+{
+	return ++m_refCount;
+}
+
+ULONG VirtualDisplayMode::Release(void)
+{
+	ULONG newRefValue = --m_refCount;
+	if (newRefValue == 0)
+		delete this;
+
+	return newRefValue;
+}
+
+HRESULT VirtualDisplayMode::GetName(const char** name)
+{
+	if (!name)
+		return E_INVALIDARG;
+
+	*name = CopyString(m_info.name);
+	return S_OK;
+}
+
+HRESULT VirtualDisplayMode::GetFrameRate(BMDTimeValue* frameDuration, BMDTimeScale* timeScale)
+{
+	if (!frameDuration || !timeScale)
+		return E_INVALIDARG;
+
+	*frameDuration	= m_info.frameDuration;
+	*timeScale		= m_info.timeScale;
+	return S_OK;
+}
+
+/// VirtualDisplayModeIterator
+
+VirtualDisplayModeIterator::VirtualDisplayModeIterator() :
+	m_refCount(1),
+	m_index(0)
+{
+}
+
+HRESULT VirtualDisplayModeIterator::QueryInterface(REFIID iid, LPVOID *ppv)
+{
+	if (!ppv)
+		return E_INVALIDARG;
+
+	if (iid == IID_IUnknown || iid == IID_IDeckLinkDisplayModeIterator)
+	{
+		*ppv = static_cast<IDeckLinkDisplayModeIterator*>(this);
+		AddRef();
+		return S_OK;
+	}
+
+	*ppv = nullptr;
+	return E_NOINTERFACE;
+}
+
+ULONG VirtualDisplayModeIterator::AddRef(void)
+{
+	return ++m_refCount;
+}
+
+ULONG VirtualDisplayModeIterator::Release(void)
+{
+	ULONG newRefValue = --m_refCount;
+	if (newRefValue == 0)
+		delete this;
+
+	return newRefValue;
+}
+
+HRESULT VirtualDisplayModeIterator::Next(IDeckLinkDisplayMode** deckLinkDisplayMode)
+{
+	if (!deckLinkDisplayMode)
+		return E_INVALIDARG;
+
+	if (m_index >= kDisplayModes.size())
+	{
+		*deckLinkDisplayMode = nullptr;
+		return S_FALSE;
+	}
+
+	*deckLinkDisplayMode = new VirtualDisplayMode(kDisplayModes[m_index++]);
+	return S_OK;
+}
@@ -0,0 +1,105 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**
+** Permission is hereby granted, free of charge, to any person or organization
+** obtaining a copy of the software and accompanying documentation (the
+** "Software") to use, reproduce, display, distribute, sub-license, execute,
+** and transmit the Software, and to prepare derivative works of the Software,
+** and to permit third-parties to whom the Software is furnished to do so, in
+** accordance with:
+**
+** (1) if the Software is obtained from Blackmagic Design, the End User License
+** Agreement for the Software Development Kit (“EULA”) available at
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+**
+** (2) if the Software is obtained from any third party, such licensing terms
+** as notified by that third party,
+**
+** and all subject to the following:
+**
+** (3) the copyright notices in the Software and this entire statement,
+** including the above license grant, this restriction and the following
+** disclaimer, must be included in all copies of the Software, in whole or in
+** part, and all derivative works of the Software, unless such copies or
+** derivative works are solely in the form of machine-executable object code
+** generated by a source language processor.
+**
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+** DEALINGS IN THE SOFTWARE.
+**
+** A copy of the Software is available free of charge at
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+**
+** -LICENSE-END-
+*/
+
+#pragma once
+
+#include <atomic>
+#include <cstddef>
+#include <vector>
+#include "DeckLinkAPI.h"
+
+struct VirtualDisplayModeInfo
+{
+	BMDDisplayMode		displayMode;
+	const char*			name;
+	long				width;
+	long				height;
+	BMDTimeValue		frameDuration;
+	BMDTimeScale		timeScale;
+	BMDFieldDominance	fieldDominance;
+	BMDDisplayModeFlags	flags;
+};
+
+const std::vector<VirtualDisplayModeInfo>&	GetVirtualDisplayModes(void);
+const VirtualDisplayModeInfo*				FindVirtualDisplayMode(BMDDisplayMode displayMode);
+
+class VirtualDisplayMode : public IDeckLinkDisplayMode
+{
+public:
+	explicit VirtualDisplayMode(const VirtualDisplayModeInfo& info);
+	virtual ~VirtualDisplayMode() = default;
+
+	// IUnknown interface
+	HRESULT				STDMETHODCALLTYPE QueryInterface(REFIID iid, LPVOID *ppv) override;
+	ULONG				STDMETHODCALLTYPE AddRef() override;
+	ULONG				STDMETHODCALLTYPE Release() override;
+
+	// IDeckLinkDisplayMode interface
+	HRESULT				STDMETHODCALLTYPE GetName(const char** name) override;
+	BMDDisplayMode		STDMETHODCALLTYPE GetDisplayMode(void) override		{ return m_info.displayMode; }
+	long				STDMETHODCALLTYPE GetWidth(void) override			{ return m_info.width; }
+	long				STDMETHODCALLTYPE GetHeight(void) override			{ return m_info.height; }
+	HRESULT				STDMETHODCALLTYPE GetFrameRate(BMDTimeValue* frameDuration, BMDTimeScale* timeScale) override;
+	BMDFieldDominance	STDMETHODCALLTYPE GetFieldDominance(void) override	{ return m_info.fieldDominance; }
+	BMDDisplayModeFlags	STDMETHODCALLTYPE GetFlags(void) override			{ return m_info.flags; }
+
+private:
+	std::atomic<ULONG>				m_refCount;
+	const VirtualDisplayModeInfo&	m_info;
+};
+
+class VirtualDisplayModeIterator : public IDeckLinkDisplayModeIterator
+{
+public:
+	VirtualDisplayModeIterator();
+	virtual ~VirtualDisplayModeIterator() = default;
+
+	// IUnknown interface
+	HRESULT				STDMETHODCALLTYPE QueryInterface(REFIID iid, LPVOID *ppv) override;
+	ULONG				STDMETHODCALLTYPE AddRef() override;
+	ULONG				STDMETHODCALLTYPE Release() override;
+
+	// IDeckLinkDisplayModeIterator interface
+	HRESULT				STDMETHODCALLTYPE Next(IDeckLinkDisplayMode** deckLinkDisplayMode) override;
+
+private:
+	std::atomic<ULONG>	m_refCount;
+	size_t				m_index;
+};
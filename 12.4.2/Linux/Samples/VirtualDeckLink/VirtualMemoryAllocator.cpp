@@ -0,0 +1,156 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**
+** Permission is hereby granted, free of charge, to any person or organization
+** obtaining a copy of the software and accompanying documentation (the
+** "Software") to use, reproduce, display, distribute, sub-license, execute,
+** and transmit the Software, and to prepare derivative works of the Software,
+** and to permit third-parties to whom the Software is furnished to do so, in
+** accordance with:
+**
+** (1) if the Software is obtained from Blackmagic Design, the End User License
+** Agreement for the Software Development Kit (“EULA”) available at
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+**
+** (2) if the Software is obtained from any third party, such licensing terms
+** as notified by that third party,
+**
+** and all subject to the following:
+**
+** (3) the copyright notices in the Software and this entire statement,
+** including the above license grant, this restriction and the following
+** disclaimer, must be included in all copies of the Software, in whole or in
+** part, and all derivative works of the Software, unless such copies or
+** derivative works are solely in the form of machine-executable object code
+** generated by a source language processor.
+**
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+** DEALINGS IN THE SOFTWARE.
+**
+** A copy of the Software is available free of charge at
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+**
+** -LICENSE-END-
+*/
+
+#include <cstdlib>
+#include "VirtualMemoryAllocator.h"
+#include "platform.h"
+
+static const size_t kBufferAlignment		= 4096;
+static const size_t kMaximumPooledBuffers	= 16;
+
+VirtualMemoryAllocator::VirtualMemoryAllocator() :
+	m_refCount(1)
+{
+}
+
+VirtualMemoryAllocator::~VirtualMemoryAllocator()
+{
+	freeUnusedBuffers();
+}
+
+HRESULT VirtualMemoryAllocator::QueryInterface(REFIID iid, LPVOID *ppv)
+{
+	if (!ppv)
+		return E_INVALIDARG;
+
+	if (iid == IID_IUnknown || iid == IID_IDeckLinkMemoryAllocator)
+	{
+		*ppv = static_cast<IDeckLinkMemoryAllocator*>(this);
+		AddRef();
+		return S_OK;
+	}
+
+	*ppv = nullptr;
+	return E_NOINTERFACE;
+}
+
+ULONG VirtualMemoryAllocator::AddRef(void)
+{
+	return ++m_refCount;
+}
+
+ULONG VirtualMemoryAllocator::Release(void)
+{
+	ULONG newRefValue = --m_refCount;
+	if (newRefValue == 0)
+		delete this;
+
+	return newRefValue;
+}
+
+HRESULT VirtualMemoryAllocator::AllocateBuffer(uint32_t bufferSize, void** allocatedBuffer)
+{
+	void* buffer = nullptr;
+
+	if (!allocatedBuffer)
+		return E_INVALIDARG;
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	for (auto iter = m_freeBuffers.begin(); iter != m_freeBuffers.end(); ++iter)
+	{
+		if (m_bufferSizes[*iter] == bufferSize)
+		{
+			*allocatedBuffer = *iter;
+			m_freeBuffers.erase(iter);
+			return S_OK;
+		}
+	}
+
+	if (posix_memalign(&buffer, kBufferAlignment, bufferSize) != 0)
+		return E_OUTOFMEMORY;
+
+	m_bufferSizes[buffer] = bufferSize;
+	*allocatedBuffer = buffer;
+	return S_OK;
+}
+
+HRESULT VirtualMemoryAllocator::ReleaseBuffer(void* buffer)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (m_bufferSizes.find(buffer) == m_bufferSizes.end())
+		return E_INVALIDARG;
+
+	if (m_freeBuffers.size() >= kMaximumPooledBuffers)
+	{
+		// Evict the oldest buffer, which after a display mode change is the least likely to be reused
+		void* oldestBuffer = m_freeBuffers.front();
+		m_freeBuffers.erase(m_freeBuffers.begin());
+		m_bufferSizes.erase(oldestBuffer);
+		free(oldestBuffer);
+	}
+
+	m_freeBuffers.push_back(buffer);
+	return S_OK;
+}
+
+HRESULT VirtualMemoryAllocator::Commit(void)
+{
+	return S_OK;
+}
+
+HRESULT VirtualMemoryAllocator::Decommit(void)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	freeUnusedBuffers();
+	return S_OK;
+}
+
+void VirtualMemoryAllocator::freeUnusedBuffers(void)
+{
+	for (void* buffer : m_freeBuffers)
+	{
+		m_bufferSizes.erase(buffer);
+		free(buffer);
+	}
+
+	m_freeBuffers.clear();
+}
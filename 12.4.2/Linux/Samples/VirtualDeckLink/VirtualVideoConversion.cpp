@@ -0,0 +1,512 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**
+** Permission is hereby granted, free of charge, to any person or organization
+** obtaining a copy of the software and accompanying documentation (the
+** "Software") to use, reproduce, display, distribute, sub-license, execute,
+** and transmit the Software, and to prepare derivative works of the Software,
+** and to permit third-parties to whom the Software is furnished to do so, in
+** accordance with:
+**
+** (1) if the Software is obtained from Blackmagic Design, the End User License
+** Agreement for the Software Development Kit (“EULA”) available at
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+**
+** (2) if the Software is obtained from any third party, such licensing terms
+** as notified by that third party,
+**
+** and all subject to the following:
+**
+** (3) the copyright notices in the Software and this entire statement,
+** including the above license grant, this restriction and the following
+** disclaimer, must be included in all copies of the Software, in whole or in
+** part, and all derivative works of the Software, unless such copies or
+** derivative works are solely in the form of machine-executable object code
+** generated by a source language processor.
+**
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+** DEALINGS IN THE SOFTWARE.
+**
+** A copy of the Software is available free of charge at
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+**
+** -LICENSE-END-
+*/
+
+#include <algorithm>
+#include <cstring>
+#include <type_traits>
+#include <vector>
+#include "PixelFormatTraits.h"
+#include "VirtualVideoConversion.h"
+#include "platform.h"
+
+namespace
+{
+	// Intermediate 4:4:4 pixel with 16-bit components.  YCbCr pixels hold video range values
+	// (Y 16-235, CbCr 16-240 scaled by 256), RGB pixels hold full range values (0-65535).
+	struct Pixel
+	{
+		uint16_t c0;
+		uint16_t c1;
+		uint16_t c2;
+	};
+
+	const long kSDMaximumWidth = 720;
+
+	// 75% colour bars as 8-bit YCbCr: white, yellow, cyan, green, magenta, red, blue, black
+	const uint8_t kColorBars[8][3] =
+	{
+		{ 180, 128, 128 },
+		{ 168,  44, 136 },
+		{ 145, 147,  44 },
+		{ 134,  63,  52 },
+		{  63, 193, 204 },
+		{  51, 109, 212 },
+		{  28, 212, 120 },
+		{  16, 128, 128 },
+	};
+
+	// Component range conversions to and from the 16-bit intermediate
+	inline uint16_t fromFull8(uint32_t v)		{ return (uint16_t)(v * 257); }
+	inline uint16_t fromFull12(uint32_t v)		{ return (uint16_t)((v << 4) | (v >> 8)); }
+	inline uint16_t fromVideo10RGB(uint32_t v)
+	{
+		int32_t value = ((int32_t)v - 64) * 65535 / 876;
+		return (uint16_t)std::min(std::max(value, 0), 65535);
+	}
+	inline uint16_t fromYUV8(uint32_t v)		{ return (uint16_t)(v << 8); }
+	inline uint16_t fromYUV10(uint32_t v)		{ return (uint16_t)(v << 6); }
+
+	inline uint32_t toFull8(uint16_t v)			{ return ((uint32_t)v * 255 + 32767) / 65535; }
+	inline uint32_t toFull12(uint16_t v)		{ return ((uint32_t)v * 4095 + 32767) / 65535; }
+	inline uint32_t toVideo10RGB(uint16_t v)	{ return 64 + ((uint32_t)v * 876 + 32767) / 65535; }
+	inline uint32_t toYUV8(uint16_t v)			{ return std::min<uint32_t>(((uint32_t)v + 128) >> 8, 255); }
+	inline uint32_t toYUV10(uint16_t v)			{ return std::min<uint32_t>(((uint32_t)v + 32) >> 6, 1023); }
+	inline uint16_t averageChroma(uint16_t a, uint16_t b)	{ return (uint16_t)(((uint32_t)a + b + 1) / 2); }
+
+	inline uint16_t clamp16(double value)
+	{
+		return (uint16_t)std::min(std::max(value * 65535.0 + 0.5, 0.0), 65535.0);
+	}
+
+	struct Coefficients
+	{
+		double kr;
+		double kb;
+	};
+
+	const Coefficients kRec601 = { 0.299,  0.114  };
+	const Coefficients kRec709 = { 0.2126, 0.0722 };
+
+	void convertYUVToRGB(Pixel* line, long width, const Coefficients& k)
+	{
+		const double kg = 1.0 - k.kr - k.kb;
+
+		for (long x = 0; x < width; x++)
+		{
+			Pixel&	p	= line[x];
+			double	y	= ((double)p.c0 - 4096.0) / 56064.0;
+			double	cb	= ((double)p.c1 - 32768.0) / 57344.0;
+			double	cr	= ((double)p.c2 - 32768.0) / 57344.0;
+
+			p.c0 = clamp16(y + 2.0 * (1.0 - k.kr) * cr);
+			p.c1 = clamp16(y - (2.0 * k.kb * (1.0 - k.kb) / kg) * cb - (2.0 * k.kr * (1.0 - k.kr) / kg) * cr);
+			p.c2 = clamp16(y + 2.0 * (1.0 - k.kb) * cb);
+		}
+	}
+
+	void convertRGBToYUV(Pixel* line, long width, const Coefficients& k)
+	{
+		const double kg = 1.0 - k.kr - k.kb;
+
+		for (long x = 0; x < width; x++)
+		{
+			Pixel&	p	= line[x];
+			double	r	= p.c0 / 65535.0;
+			double	g	= p.c1 / 65535.0;
+			double	b	= p.c2 / 65535.0;
+			double	y	= k.kr * r + kg * g + k.kb * b;
+			double	cb	= (b - y) / (2.0 * (1.0 - k.kb));
+			double	cr	= (r - y) / (2.0 * (1.0 - k.kr));
+
+			p.c0 = (uint16_t)std::min(std::max(4096.0 + y * 56064.0 + 0.5, 0.0), 65535.0);
+			p.c1 = (uint16_t)std::min(std::max(32768.0 + cb * 57344.0 + 0.5, 0.0), 65535.0);
+			p.c2 = (uint16_t)std::min(std::max(32768.0 + cr * 57344.0 + 0.5, 0.0), 65535.0);
+		}
+	}
+
+	// Packed formats are converted a block of pixels at a time by the BlockCodec of the format.  Each
+	// block has a fixed layout, so the codecs are straight-line code with the byte order of the format
+	// resolved at compile time.
+	template <BMDPixelFormat Format>
+	struct BlockCodec;
+
+	template <>
+	struct BlockCodec<bmdFormat8BitYUV>
+	{
+		static void decode(const uint8_t* src, Pixel* pixels)
+		{
+			pixels[0] = { fromYUV8(src[1]), fromYUV8(src[0]), fromYUV8(src[2]) };
+			pixels[1] = { fromYUV8(src[3]), fromYUV8(src[0]), fromYUV8(src[2]) };
+		}
+
+		static void encode(const Pixel* pixels, uint8_t* dst)
+		{
+			dst[0] = (uint8_t)toYUV8(averageChroma(pixels[0].c1, pixels[1].c1));
+			dst[1] = (uint8_t)toYUV8(pixels[0].c0);
+			dst[2] = (uint8_t)toYUV8(averageChroma(pixels[0].c2, pixels[1].c2));
+			dst[3] = (uint8_t)toYUV8(pixels[1].c0);
+		}
+	};
+
+	template <>
+	struct BlockCodec<bmdFormat10BitYUV>
+	{
+		typedef PixelFormatTraits<bmdFormat10BitYUV> Traits;
+
+		static void decode(const uint8_t* src, Pixel* pixels)
+		{
+			uint32_t w0 = LoadPixelWord<Traits::kByteOrder>(src);
+			uint32_t w1 = LoadPixelWord<Traits::kByteOrder>(src + 4);
+			uint32_t w2 = LoadPixelWord<Traits::kByteOrder>(src + 8);
+			uint32_t w3 = LoadPixelWord<Traits::kByteOrder>(src + 12);
+
+			uint16_t cb[3]	= { fromYUV10(w0 & 0x3FF), fromYUV10((w1 >> 10) & 0x3FF), fromYUV10((w2 >> 20) & 0x3FF) };
+			uint16_t cr[3]	= { fromYUV10((w0 >> 20) & 0x3FF), fromYUV10(w2 & 0x3FF), fromYUV10((w3 >> 10) & 0x3FF) };
+
+			pixels[0] = { fromYUV10((w0 >> 10) & 0x3FF), cb[0], cr[0] };
+			pixels[1] = { fromYUV10(w1 & 0x3FF), cb[0], cr[0] };
+			pixels[2] = { fromYUV10((w1 >> 20) & 0x3FF), cb[1], cr[1] };
+			pixels[3] = { fromYUV10((w2 >> 10) & 0x3FF), cb[1], cr[1] };
+			pixels[4] = { fromYUV10(w3 & 0x3FF), cb[2], cr[2] };
+			pixels[5] = { fromYUV10((w3 >> 20) & 0x3FF), cb[2], cr[2] };
+		}
+
+		static void encode(const Pixel* pixels, uint8_t* dst)
+		{
+			uint32_t y[6];
+			uint32_t cb[3];
+			uint32_t cr[3];
+
+			for (int i = 0; i < 6; i++)
+				y[i] = toYUV10(pixels[i].c0);
+
+			for (int i = 0; i < 3; i++)
+			{
+				cb[i] = toYUV10(averageChroma(pixels[i * 2].c1, pixels[i * 2 + 1].c1));
+				cr[i] = toYUV10(averageChroma(pixels[i * 2].c2, pixels[i * 2 + 1].c2));
+			}
+
+			StorePixelWord<Traits::kByteOrder>(dst,		cb[0] | (y[0] << 10) | (cr[0] << 20));
+			StorePixelWord<Traits::kByteOrder>(dst + 4,	y[1] | (cb[1] << 10) | (y[2] << 20));
+			StorePixelWord<Traits::kByteOrder>(dst + 8,	cr[1] | (y[3] << 10) | (cb[2] << 20));
+			StorePixelWord<Traits::kByteOrder>(dst + 12,	y[4] | (cr[2] << 10) | (y[5] << 20));
+		}
+	};
+
+	// 8-bit RGB, one pixel per block with the byte offset of each component
+	template <int Alpha, int Red, int Green, int Blue>
+	struct RGB8BlockCodec
+	{
+		static void decode(const uint8_t* src, Pixel* pixels)
+		{
+			pixels[0] = { fromFull8(src[Red]), fromFull8(src[Green]), fromFull8(src[Blue]) };
+		}
+
+		static void encode(const Pixel* pixels, uint8_t* dst)
+		{
+			dst[Alpha]	= 0xFF;
+			dst[Red]	= (uint8_t)toFull8(pixels[0].c0);
+			dst[Green]	= (uint8_t)toFull8(pixels[0].c1);
+			dst[Blue]	= (uint8_t)toFull8(pixels[0].c2);
+		}
+	};
+
+	template <> struct BlockCodec<bmdFormat8BitARGB> : RGB8BlockCodec<0, 1, 2, 3> { };
+	template <> struct BlockCodec<bmdFormat8BitBGRA> : RGB8BlockCodec<3, 2, 1, 0> { };
+
+	// 10-bit RGB, one pixel per 32-bit word with blue in the bits from Shift
+	template <BMDPixelFormat Format, int Shift>
+	struct RGB10BlockCodec
+	{
+		typedef PixelFormatTraits<Format> Traits;
+
+		static void decode(const uint8_t* src, Pixel* pixels)
+		{
+			uint32_t word = LoadPixelWord<Traits::kByteOrder>(src);
+			pixels[0] = { fromVideo10RGB((word >> (Shift + 20)) & 0x3FF), fromVideo10RGB((word >> (Shift + 10)) & 0x3FF), fromVideo10RGB((word >> Shift) & 0x3FF) };
+		}
+
+		static void encode(const Pixel* pixels, uint8_t* dst)
+		{
+			StorePixelWord<Traits::kByteOrder>(dst, (toVideo10RGB(pixels[0].c0) << (Shift + 20)) | (toVideo10RGB(pixels[0].c1) << (Shift + 10)) | (toVideo10RGB(pixels[0].c2) << Shift));
+		}
+	};
+
+	template <> struct BlockCodec<bmdFormat10BitRGB> : RGB10BlockCodec<bmdFormat10BitRGB, 0> { };
+	template <> struct BlockCodec<bmdFormat10BitRGBXLE> : RGB10BlockCodec<bmdFormat10BitRGBXLE, 2> { };
+	template <> struct BlockCodec<bmdFormat10BitRGBX> : RGB10BlockCodec<bmdFormat10BitRGBX, 2> { };
+
+	// 12-bit RGB is a little-endian bit stream of R, G, B components, 8 pixels in 9 words.  The
+	// big-endian variant stores each 32-bit word byte swapped.  Component positions are constant, so
+	// each is extracted from the pair of words it lies in.
+	template <BMDPixelFormat Format>
+	struct RGB12BlockCodec
+	{
+		typedef PixelFormatTraits<Format> Traits;
+
+		static void decode(const uint8_t* src, Pixel* pixels)
+		{
+			uint32_t words[10];
+			uint16_t components[24];
+
+			for (int i = 0; i < 9; i++)
+				words[i] = LoadPixelWord<Traits::kByteOrder>(src + i * 4);
+			words[9] = 0;
+
+			for (int i = 0; i < 24; i++)
+			{
+				const int bit = i * 12;
+				uint64_t pair = (uint64_t)words[bit / 32] | ((uint64_t)words[bit / 32 + 1] << 32);
+				components[i] = (uint16_t)((pair >> (bit % 32)) & 0xFFF);
+			}
+
+			for (int i = 0; i < 8; i++)
+				pixels[i] = { fromFull12(components[i * 3]), fromFull12(components[i * 3 + 1]), fromFull12(components[i * 3 + 2]) };
+		}
+
+		static void encode(const Pixel* pixels, uint8_t* dst)
+		{
+			uint64_t components[25];
+
+			for (int i = 0; i < 8; i++)
+			{
+				components[i * 3]		= toFull12(pixels[i].c0);
+				components[i * 3 + 1]	= toFull12(pixels[i].c1);
+				components[i * 3 + 2]	= toFull12(pixels[i].c2);
+			}
+			components[24] = 0;
+
+			for (int i = 0; i < 9; i++)
+			{
+				const int first = (i * 32) / 12;
+				uint64_t run = components[first] | (components[first + 1] << 12) | (components[first + 2] << 24) | (components[first + 3] << 36);
+				StorePixelWord<Traits::kByteOrder>(dst + i * 4, (uint32_t)(run >> ((i * 32) % 12)));
+			}
+		}
+	};
+
+	template <> struct BlockCodec<bmdFormat12BitRGB> : RGB12BlockCodec<bmdFormat12BitRGB> { };
+	template <> struct BlockCodec<bmdFormat12BitRGBLE> : RGB12BlockCodec<bmdFormat12BitRGBLE> { };
+
+	// Lines are a run of whole blocks followed by a partial block, which is converted through scratch
+	// pixels so that the loop over whole blocks has no edge checks
+	template <typename Traits>
+	void decodeLine(const uint8_t* src, Pixel* line, long width)
+	{
+		const long blocks		= width / Traits::kBlockPixels;
+		const long remainder	= width % Traits::kBlockPixels;
+
+		for (long block = 0; block < blocks; block++, src += Traits::kBlockBytes, line += Traits::kBlockPixels)
+			BlockCodec<Traits::kPixelFormat>::decode(src, line);
+
+		if (remainder > 0)
+		{
+			Pixel pixels[Traits::kBlockPixels];
+			BlockCodec<Traits::kPixelFormat>::decode(src, pixels);
+			std::copy(pixels, pixels + remainder, line);
+		}
+	}
+
+	template <typename Traits>
+	void encodeLine(const Pixel* line, uint8_t* dst, long width)
+	{
+		const long blocks		= width / Traits::kBlockPixels;
+		const long remainder	= width % Traits::kBlockPixels;
+
+		for (long block = 0; block < blocks; block++, dst += Traits::kBlockBytes, line += Traits::kBlockPixels)
+			BlockCodec<Traits::kPixelFormat>::encode(line, dst);
+
+		if (remainder > 0)
+		{
+			// Pixel groups are written whole, so the last group repeats the final pixel of the line
+			Pixel pixels[Traits::kBlockPixels];
+			std::fill(std::copy(line, line + remainder, pixels), pixels + Traits::kBlockPixels, line[remainder - 1]);
+			BlockCodec<Traits::kPixelFormat>::encode(pixels, dst);
+		}
+	}
+
+	struct LineCodec
+	{
+		void	(*decode)(const uint8_t* src, Pixel* line, long width);
+		void	(*encode)(const Pixel* line, uint8_t* dst, long width);
+		bool	rgb;
+	};
+
+	template <typename Traits>
+	LineCodec makeLineCodec(std::true_type)
+	{
+		return { &decodeLine<Traits>, &encodeLine<Traits>, Traits::kRGB };
+	}
+
+	template <typename Traits>
+	LineCodec makeLineCodec(std::false_type)
+	{
+		return { nullptr, nullptr, false };
+	}
+
+	// Line kernels instantiated for each packed format, compressed formats have no kernels
+	struct LineCodecVisitor
+	{
+		template <typename Traits>
+		LineCodec operator()(Traits) const
+		{
+			return makeLineCodec<Traits>(std::integral_constant<bool, Traits::kPacked>());
+		}
+	};
+
+	inline LineCodec getLineCodec(BMDPixelFormat pixelFormat)
+	{
+		return DispatchPixelFormat(pixelFormat, LineCodecVisitor());
+	}
+}
+
+bool IsVirtualPixelFormatSupported(BMDPixelFormat pixelFormat)
+{
+	return getLineCodec(pixelFormat).decode != nullptr;
+}
+
+void ConvertVirtualLine(BMDPixelFormat srcPixelFormat, const void* srcLine, BMDPixelFormat dstPixelFormat, void* dstLine, long width)
+{
+	thread_local std::vector<Pixel> line;
+
+	LineCodec srcCodec = getLineCodec(srcPixelFormat);
+	LineCodec dstCodec = getLineCodec(dstPixelFormat);
+
+	if (width <= 0 || !srcCodec.decode || !dstCodec.encode)
+		return;
+
+	if ((long)line.size() < width)
+		line.resize(width);
+
+	srcCodec.decode((const uint8_t*)srcLine, line.data(), width);
+
+	if (srcCodec.rgb != dstCodec.rgb)
+	{
+		const Coefficients& coefficients = (width <= kSDMaximumWidth) ? kRec601 : kRec709;
+		if (srcCodec.rgb)
+			convertRGBToYUV(line.data(), width, coefficients);
+		else
+			convertYUVToRGB(line.data(), width, coefficients);
+	}
+
+	dstCodec.encode(line.data(), (uint8_t*)dstLine, width);
+}
+
+void FillVirtualColorBars(BMDPixelFormat pixelFormat, void* buffer, long width, long height, long rowBytes)
+{
+	std::vector<Pixel>	line(width);
+	uint8_t*			firstRow = (uint8_t*)buffer;
+	LineCodec			codec = getLineCodec(pixelFormat);
+
+	if (width <= 0 || height <= 0 || !codec.encode)
+		return;
+
+	for (long x = 0; x < width; x++)
+	{
+		const uint8_t* bar = kColorBars[(x * 8) / width];
+		line[x] = { fromYUV8(bar[0]), fromYUV8(bar[1]), fromYUV8(bar[2]) };
+	}
+
+	if (codec.rgb)
+		convertYUVToRGB(line.data(), width, (width <= kSDMaximumWidth) ? kRec601 : kRec709);
+
+	// Bars are vertically uniform, so render one line and replicate it
+	codec.encode(line.data(), firstRow, width);
+
+	for (long y = 1; y < height; y++)
+		memcpy(firstRow + y * rowBytes, firstRow, rowBytes);
+}
+
+/// VirtualVideoConversion
+
+VirtualVideoConversion::VirtualVideoConversion() :
+	m_refCount(1)
+{
+}
+
+HRESULT VirtualVideoConversion::QueryInterface(REFIID iid, LPVOID *ppv)
+{
+	if (!ppv)
+		return E_INVALIDARG;
+
+	if (iid == IID_IUnknown || iid == IID_IDeckLinkVideoConversion)
+	{
+		*ppv = static_cast<IDeckLinkVideoConversion*>(this);
+		AddRef();
+		return S_OK;
+	}
+
+	*ppv = nullptr;
+	return E_NOINTERFACE;
+}
+
+ULONG VirtualVideoConversion::AddRef(void)
+{
+	return ++m_refCount;
+}
+
+ULONG VirtualVideoConversion::Release(void)
+{
+	ULONG newRefValue = --m_refCount;
+	if (newRefValue == 0)
+		delete this;
+
+	return newRefValue;
+}
+
+HRESULT VirtualVideoConversion::ConvertFrame(IDeckLinkVideoFrame* srcFrame, IDeckLinkVideoFrame* dstFrame)
+{
+	uint8_t*	srcBytes;
+	uint8_t*	dstBytes;
+
+	if (!srcFrame || !dstFrame)
+		return E_INVALIDARG;
+
+	long			width			= srcFrame->GetWidth();
+	long			height			= srcFrame->GetHeight();
+	long			srcRowBytes		= srcFrame->GetRowBytes();
+	long			dstRowBytes		= dstFrame->GetRowBytes();
+	BMDPixelFormat	srcPixelFormat	= srcFrame->GetPixelFormat();
+	BMDPixelFormat	dstPixelFormat	= dstFrame->GetPixelFormat();
+
+	// Scaling is not supported, only pixel format conversion
+	if (dstFrame->GetWidth() != width || dstFrame->GetHeight() != height)
+		return E_INVALIDARG;
+
+	if (!IsVirtualPixelFormatSupported(srcPixelFormat) || !IsVirtualPixelFormatSupported(dstPixelFormat))
+		return E_NOTIMPL;
+
+	if (srcFrame->GetBytes((void**)&srcBytes) != S_OK || dstFrame->GetBytes((void**)&dstBytes) != S_OK)
+		return E_FAIL;
+
+	if (srcPixelFormat == dstPixelFormat)
+	{
+		long lineBytes = std::min(srcRowBytes, dstRowBytes);
+		for (long y = 0; y < height; y++)
+			memcpy(dstBytes + y * dstRowBytes, srcBytes + y * srcRowBytes, lineBytes);
+	}
+	else
+	{
+		for (long y = 0; y < height; y++)
+			ConvertVirtualLine(srcPixelFormat, srcBytes + y * srcRowBytes, dstPixelFormat, dstBytes + y * dstRowBytes, width);
+	}
+
+	return S_OK;
+}
@@ -0,0 +1,321 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**
+** Permission is hereby granted, free of charge, to any person or organization
+** obtaining a copy of the software and accompanying documentation (the
+** "Software") to use, reproduce, display, distribute, sub-license, execute,
+** and transmit the Software, and to prepare derivative works of the Software,
+** and to permit third-parties to whom the Software is furnished to do so, in
+** accordance with:
+**
+** (1) if the Software is obtained from Blackmagic Design, the End User License
+** Agreement for the Software Development Kit (“EULA”) available at
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+**
+** (2) if the Software is obtained from any third party, such licensing terms
+** as notified by that third party,
+**
+** and all subject to the following:
+**
+** (3) the copyright notices in the Software and this entire statement,
+** including the above license grant, this restriction and the following
+** disclaimer, must be included in all copies of the Software, in whole or in
+** part, and all derivative works of the Software, unless such copies or
+** derivative works are solely in the form of machine-executable object code
+** generated by a source language processor.
+**
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+** DEALINGS IN THE SOFTWARE.
+**
+** A copy of the Software is available free of charge at
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+**
+** -LICENSE-END-
+*/
+
+#include <cstdio>
+#include "FrameTimer.h"
+#include "VirtualVideoFrame.h"
+
+static inline uint32_t toBCD(uint8_t value)
+{
+	return ((value / 10) << 4) | (value % 10);
+}
+
+/// VirtualTimecode
+
+VirtualTimecode::VirtualTimecode(uint8_t hours, uint8_t minutes, uint8_t seconds, uint8_t frames, BMDTimecodeFlags flags, BMDTimecodeUserBits userBits) :
+	m_refCount(1),
+	m_hours(hours),
+	m_minutes(minutes),
+	m_seconds(seconds),
+	m_frames(frames),
+	m_flags(flags),
+	m_userBits(userBits)
+{
+}
+
+HRESULT VirtualTimecode::QueryInterface(REFIID iid, LPVOID *ppv)
+{
+	if (!ppv)
+		return E_INVALIDARG;
+
+	if (iid == IID_IUnknown || iid == IID_IDeckLinkTimecode)
+	{
+		*ppv = static_cast<IDeckLinkTimecode*>(this);
+		AddRef();
+		return S_OK;
+	}
+
+	*ppv = nullptr;
+	return E_NOINTERFACE;
+}
+
+ULONG VirtualTimecode::AddRef(void)
+{
+	return ++m_refCount;
+}
+
+ULONG VirtualTimecode::Release(void)
+{
+	ULONG newRefValue = --m_refCount;
+	if (newRefValue == 0)
+		delete this;
+
+	return newRefValue;
+}
+
+BMDTimecodeBCD VirtualTimecode::GetBCD(void)
+{
+	return (toBCD(m_hours) << 24) | (toBCD(m_minutes) << 16) | (toBCD(m_seconds) << 8) | toBCD(m_frames);
+}
+
+HRESULT VirtualTimecode::GetComponents(uint8_t* hours, uint8_t* minutes, uint8_t* seconds, uint8_t* frames)
+{
+	if (!hours || !minutes || !seconds || !frames)
+		return E_INVALIDARG;
+
+	*hours		= m_hours;
+	*minutes	= m_minutes;
+	*seconds	= m_seconds;
+	*frames		= m_frames;
+	return S_OK;
+}
+
+HRESULT VirtualTimecode::GetString(const char** timecode)
+{
+	char timecodeString[16];
+
+	if (!timecode)
+		return E_INVALIDARG;
+
+	snprintf(timecodeString, sizeof(timecodeString), "%02u:%02u:%02u%c%02u",
+			m_hours, m_minutes, m_seconds, (m_flags & bmdTimecodeIsDropFrame) ? ';' : ':', m_frames);
+
+	*timecode = CopyString(timecodeString);
+	return S_OK;
+}
+
+HRESULT VirtualTimecode::GetTimecodeUserBits(BMDTimecodeUserBits* userBits)
+{
+	if (!userBits)
+		return E_INVALIDARG;
+
+	*userBits = m_userBits;
+	return S_OK;
+}
+
+com_ptr<IDeckLinkTimecode> VirtualTimecode::fromFrameCount(uint64_t frameCount, BMDTimeValue frameDuration, BMDTimeScale timeScale)
+{
+	// Timecode counts whole frames per second, so 29.97 and 59.94 count 30 and 60 frames
+	uint64_t framesPerSecond	= (uint64_t)((timeScale + frameDuration - 1) / frameDuration);
+	uint64_t totalSeconds		= frameCount / framesPerSecond;
+
+	return com_ptr<IDeckLinkTimecode>(IID_IDeckLinkTimecode,
+										make_com_ptr<VirtualTimecode>((uint8_t)((totalSeconds / 3600) % 24), (uint8_t)((totalSeconds / 60) % 60),
+																		(uint8_t)(totalSeconds % 60), (uint8_t)(frameCount % framesPerSecond),
+																		(BMDTimecodeFlags)bmdTimecodeFlagDefault, (BMDTimecodeUserBits)0));
+}
+
+/// VirtualMutableVideoFrame
+
+VirtualMutableVideoFrame::VirtualMutableVideoFrame(long width, long height, long rowBytes, BMDPixelFormat pixelFormat, BMDFrameFlags flags, com_ptr<IDeckLinkMemoryAllocator> allocator) :
+	VirtualVideoFrameBase<IDeckLinkMutableVideoFrame>(width, height, rowBytes, pixelFormat, flags, allocator)
+{
+}
+
+bool VirtualMutableVideoFrame::queryFrameInterface(REFIID iid, LPVOID *ppv)
+{
+	if (iid == IID_IDeckLinkMutableVideoFrame)
+	{
+		*ppv = static_cast<IDeckLinkMutableVideoFrame*>(this);
+		return true;
+	}
+
+	return false;
+}
+
+HRESULT VirtualMutableVideoFrame::SetFlags(BMDFrameFlags newFlags)
+{
+	m_flags = newFlags;
+	return S_OK;
+}
+
+HRESULT VirtualMutableVideoFrame::SetTimecode(BMDTimecodeFormat format, IDeckLinkTimecode* timecode)
+{
+	if (!timecode)
+		return E_INVALIDARG;
+
+	setTimecode(format, com_ptr<IDeckLinkTimecode>(timecode));
+	return S_OK;
+}
+
+HRESULT VirtualMutableVideoFrame::SetTimecodeFromComponents(BMDTimecodeFormat format, uint8_t hours, uint8_t minutes, uint8_t seconds, uint8_t frames, BMDTimecodeFlags flags)
+{
+	setTimecode(format, com_ptr<IDeckLinkTimecode>(IID_IDeckLinkTimecode, make_com_ptr<VirtualTimecode>(hours, minutes, seconds, frames, flags, (BMDTimecodeUserBits)0)));
+	return S_OK;
+}
+
+HRESULT VirtualMutableVideoFrame::SetAncillaryData(IDeckLinkVideoFrameAncillary* ancillary)
+{
+	// Only the packet based ancillary interface is provided
+	return E_NOTIMPL;
+}
+
+HRESULT VirtualMutableVideoFrame::SetTimecodeUserBits(BMDTimecodeFormat format, BMDTimecodeUserBits userBits)
+{
+	for (auto& entry : m_timecodes)
+	{
+		if (entry.format == format)
+		{
+			uint8_t hours, minutes, seconds, frames;
+
+			entry.timecode->GetComponents(&hours, &minutes, &seconds, &frames);
+			entry.timecode = com_ptr<IDeckLinkTimecode>(IID_IDeckLinkTimecode, make_com_ptr<VirtualTimecode>(hours, minutes, seconds, frames, entry.timecode->GetFlags(), userBits));
+			return S_OK;
+		}
+	}
+
+	// User bits can only be set once a timecode for the format has been set
+	return E_FAIL;
+}
+
+/// VirtualVideoInputFrame
+
+VirtualVideoInputFrame::VirtualVideoInputFrame(long width, long height, long rowBytes, BMDPixelFormat pixelFormat, BMDFrameFlags flags, com_ptr<IDeckLinkMemoryAllocator> allocator) :
+	VirtualVideoFrameBase<IDeckLinkVideoInputFrame>(width, height, rowBytes, pixelFormat, flags, allocator),
+	m_streamTime(0),
+	m_streamDuration(0),
+	m_streamTimeScale(1),
+	m_hardwareTime(0),
+	m_hardwareDuration(0)
+{
+}
+
+bool VirtualVideoInputFrame::queryFrameInterface(REFIID iid, LPVOID *ppv)
+{
+	if (iid == IID_IDeckLinkVideoInputFrame)
+	{
+		*ppv = static_cast<IDeckLinkVideoInputFrame*>(this);
+		return true;
+	}
+
+	return false;
+}
+
+HRESULT VirtualVideoInputFrame::GetStreamTime(BMDTimeValue* frameTime, BMDTimeValue* frameDuration, BMDTimeScale timeScale)
+{
+	if (!frameTime || !frameDuration || timeScale == 0)
+		return E_INVALIDARG;
+
+	*frameTime		= ConvertTimeValue(m_streamTime, m_streamTimeScale, timeScale);
+	*frameDuration	= ConvertTimeValue(m_streamDuration, m_streamTimeScale, timeScale);
+	return S_OK;
+}
+
+HRESULT VirtualVideoInputFrame::GetHardwareReferenceTimestamp(BMDTimeScale timeScale, BMDTimeValue* frameTime, BMDTimeValue* frameDuration)
+{
+	if (!frameTime || !frameDuration || timeScale == 0)
+		return E_INVALIDARG;
+
+	*frameTime		= ConvertTimeValue(m_hardwareTime, 1000000000, timeScale);
+	*frameDuration	= ConvertTimeValue(m_hardwareDuration, 1000000000, timeScale);
+	return S_OK;
+}
+
+void VirtualVideoInputFrame::setStreamTime(BMDTimeValue frameTime, BMDTimeValue frameDuration, BMDTimeScale timeScale)
+{
+	m_streamTime		= frameTime;
+	m_streamDuration	= frameDuration;
+	m_streamTimeScale	= timeScale;
+}
+
+void VirtualVideoInputFrame::setHardwareReferenceTimestamp(BMDTimeValue frameTimeNanoseconds, BMDTimeValue frameDurationNanoseconds)
+{
+	m_hardwareTime		= frameTimeNanoseconds;
+	m_hardwareDuration	= frameDurationNanoseconds;
+}
+
+/// VirtualAudioInputPacket
+
+VirtualAudioInputPacket::VirtualAudioInputPacket(long sampleFrameCount, uint32_t bytesPerSampleFrame, BMDTimeValue packetTime, BMDTimeScale packetTimeScale) :
+	m_refCount(1),
+	m_sampleFrameCount(sampleFrameCount),
+	m_packetTime(packetTime),
+	m_packetTimeScale(packetTimeScale),
+	m_buffer((size_t)sampleFrameCount * bytesPerSampleFrame, 0)
+{
+}
+
+HRESULT VirtualAudioInputPacket::QueryInterface(REFIID iid, LPVOID *ppv)
+{
+	if (!ppv)
+		return E_INVALIDARG;
+
+	if (iid == IID_IUnknown || iid == IID_IDeckLinkAudioInputPacket)
+	{
+		*ppv = static_cast<IDeckLinkAudioInputPacket*>(this);
+		AddRef();
+		return S_OK;
+	}
+
+	*ppv = nullptr;
+	return E_NOINTERFACE;
+}
+
+ULONG VirtualAudioInputPacket::AddRef(void)
+{
+	return ++m_refCount;
+}
+
+ULONG VirtualAudioInputPacket::Release(void)
+{
+	ULONG newRefValue = --m_refCount;
+	if (newRefValue == 0)
+		delete this;
+
+	return newRefValue;
+}
+
+HRESULT VirtualAudioInputPacket::GetBytes(void** buffer)
+{
+	if (!buffer)
+		return E_INVALIDARG;
+
+	*buffer = m_buffer.data();
+	return S_OK;
+}
+
+HRESULT VirtualAudioInputPacket::GetPacketTime(BMDTimeValue* packetTime, BMDTimeScale timeScale)
+{
+	if (!packetTime || timeScale == 0)
+		return E_INVALIDARG;
+
+	*packetTime = ConvertTimeValue(m_packetTime, m_packetTimeScale, timeScale);
+	return S_OK;
+}
@@ -0,0 +1,343 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**
+** Permission is hereby granted, free of charge, to any person or organization
+** obtaining a copy of the software and accompanying documentation (the
+** "Software") to use, reproduce, display, distribute, sub-license, execute,
+** and transmit the Software, and to prepare derivative works of the Software,
+** and to permit third-parties to whom the Software is furnished to do so, in
+** accordance with:
+**
+** (1) if the Software is obtained from Blackmagic Design, the End User License
+** Agreement for the Software Development Kit (“EULA”) available at
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+**
+** (2) if the Software is obtained from any third party, such licensing terms
+** as notified by that third party,
+**
+** and all subject to the following:
+**
+** (3) the copyright notices in the Software and this entire statement,
+** including the above license grant, this restriction and the following
+** disclaimer, must be included in all copies of the Software, in whole or in
+** part, and all derivative works of the Software, unless such copies or
+** derivative works are solely in the form of machine-executable object code
+** generated by a source language processor.
+**
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE,
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+** DEALINGS IN THE SOFTWARE.
+**
+** A copy of the Software is available free of charge at
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+**
+** -LICENSE-END-
+*/
+
+#pragma once
+
+#include <atomic>
+#include <vector>
+#include "DeckLinkAPI.h"
+#include "VirtualAncillaryPackets.h"
+#include "com_ptr.h"
+#include "platform.h"
+
+class VirtualTimecode : public IDeckLinkTimecode
+{
+public:
+	VirtualTimecode(uint8_t hours, uint8_t minutes, uint8_t seconds, uint8_t frames, BMDTimecodeFlags flags, BMDTimecodeUserBits userBits);
+	virtual ~VirtualTimecode() = default;
+
+	// IUnknown interface
+	HRESULT				STDMETHODCALLTYPE QueryInterface(REFIID iid, LPVOID *ppv) override;
+	ULONG				STDMETHODCALLTYPE AddRef() override;
+	ULONG				STDMETHODCALLTYPE Release() override;
+
+	// IDeckLinkTimecode interface
+	BMDTimecodeBCD		STDMETHODCALLTYPE GetBCD(void) override;
+	HRESULT				STDMETHODCALLTYPE GetComponents(uint8_t* hours, uint8_t* minutes, uint8_t* seconds, uint8_t* frames) override;
+	HRESULT				STDMETHODCALLTYPE GetString(const char** timecode) override;
+	BMDTimecodeFlags	STDMETHODCALLTYPE GetFlags(void) override			{ return m_flags; }
+	HRESULT				STDMETHODCALLTYPE GetTimecodeUserBits(BMDTimecodeUserBits* userBits) override;
+
+	// Non-drop frame timecode for a frame count at the given frame rate
+	static com_ptr<IDeckLinkTimecode> fromFrameCount(uint64_t frameCount, BMDTimeValue frameDuration, BMDTimeScale timeScale);
+
+private:
+	std::atomic<ULONG>	m_refCount;
+	uint8_t				m_hours;
+	uint8_t				m_minutes;
+	uint8_t				m_seconds;
+	uint8_t				m_frames;
+	BMDTimecodeFlags	m_flags;
+	BMDTimecodeUserBits	m_userBits;
+};
+
+// Implements IDeckLinkVideoFrame for both the mutable output frames and the captured input frames
+template<typename T>
+class VirtualVideoFrameBase : public T
+{
+public:
+	VirtualVideoFrameBase(long width, long height, long rowBytes, BMDPixelFormat pixelFormat, BMDFrameFlags flags, com_ptr<IDeckLinkMemoryAllocator> allocator);
+	virtual ~VirtualVideoFrameBase();
+
+	// IUnknown interface
+	HRESULT			STDMETHODCALLTYPE QueryInterface(REFIID iid, LPVOID *ppv) override;
+	ULONG			STDMETHODCALLTYPE AddRef() override;
+	ULONG			STDMETHODCALLTYPE Release() override;
+
+	// IDeckLinkVideoFrame interface
+	long			STDMETHODCALLTYPE GetWidth(void) override			{ return m_width; }
+	long			STDMETHODCALLTYPE GetHeight(void) override			{ return m_height; }
+	long			STDMETHODCALLTYPE GetRowBytes(void) override		{ return m_rowBytes; }
+	BMDPixelFormat	STDMETHODCALLTYPE GetPixelFormat(void) override		{ return m_pixelFormat; }
+	BMDFrameFlags	STDMETHODCALLTYPE GetFlags(void) override			{ return m_flags; }
+	HRESULT			STDMETHODCALLTYPE GetBytes(void** buffer) override;
+	HRESULT			STDMETHODCALLTYPE GetTimecode(BMDTimecodeFormat format, IDeckLinkTimecode** timecode) override;
+	HRESULT			STDMETHODCALLTYPE GetAncillaryData(IDeckLinkVideoFrameAncillary** ancillary) override;
+
+	bool			hasBuffer(void) const	{ return m_buffer != nullptr; }
+	void			setTimecode(BMDTimecodeFormat format, com_ptr<IDeckLinkTimecode> timecode);
+	void			copyTimecodesFrom(IDeckLinkVideoFrame* frame);
+	void			copyAncillaryPacketsFrom(IDeckLinkVideoFrame* frame) { m_ancillaryPackets->copyFrom(frame); }
+
+protected:
+	struct TimecodeEntry
+	{
+		BMDTimecodeFormat			format;
+		com_ptr<IDeckLinkTimecode>	timecode;
+	};
+
+	virtual bool	queryFrameInterface(REFIID iid, LPVOID *ppv) = 0;
+
+	std::atomic<ULONG>					m_refCount;
+	long								m_width;
+	long								m_height;
+	long								m_rowBytes;
+	BMDPixelFormat						m_pixelFormat;
+	BMDFrameFlags						m_flags;
+	void*								m_buffer;
+	com_ptr<IDeckLinkMemoryAllocator>	m_allocator;
+	com_ptr<VirtualAncillaryPackets>	m_ancillaryPackets;
+	std::vector<TimecodeEntry>			m_timecodes;
+};
+
+class VirtualMutableVideoFrame : public VirtualVideoFrameBase<IDeckLinkMutableVideoFrame>
+{
+public:
+	VirtualMutableVideoFrame(long width, long height, long rowBytes, BMDPixelFormat pixelFormat, BMDFrameFlags flags, com_ptr<IDeckLinkMemoryAllocator> allocator);
+	virtual ~VirtualMutableVideoFrame() = default;
+
+	// IDeckLinkMutableVideoFrame interface
+	HRESULT			STDMETHODCALLTYPE SetFlags(BMDFrameFlags newFlags) override;
+	HRESULT			STDMETHODCALLTYPE SetTimecode(BMDTimecodeFormat format, IDeckLinkTimecode* timecode) override;
+	HRESULT			STDMETHODCALLTYPE SetTimecodeFromComponents(BMDTimecodeFormat format, uint8_t hours, uint8_t minutes, uint8_t seconds, uint8_t frames, BMDTimecodeFlags flags) override;
+	HRESULT			STDMETHODCALLTYPE SetAncillaryData(IDeckLinkVideoFrameAncillary* ancillary) override;
+	HRESULT			STDMETHODCALLTYPE SetTimecodeUserBits(BMDTimecodeFormat format, BMDTimecodeUserBits userBits) override;
+
+protected:
+	bool			queryFrameInterface(REFIID iid, LPVOID *ppv) override;
+};
+
+class VirtualVideoInputFrame : public VirtualVideoFrameBase<IDeckLinkVideoInputFrame>
+{
+public:
+	VirtualVideoInputFrame(long width, long height, long rowBytes, BMDPixelFormat pixelFormat, BMDFrameFlags flags, com_ptr<IDeckLinkMemoryAllocator> allocator);
+	virtual ~VirtualVideoInputFrame() = default;
+
+	// IDeckLinkVideoInputFrame interface
+	HRESULT			STDMETHODCALLTYPE GetStreamTime(BMDTimeValue* frameTime, BMDTimeValue* frameDuration, BMDTimeScale timeScale) override;
+	HRESULT			STDMETHODCALLTYPE GetHardwareReferenceTimestamp(BMDTimeScale timeScale, BMDTimeValue* frameTime, BMDTimeValue* frameDuration) override;
+
+	void			setStreamTime(BMDTimeValue frameTime, BMDTimeValue frameDuration, BMDTimeScale timeScale);
+	void			setHardwareReferenceTimestamp(BMDTimeValue frameTimeNanoseconds, BMDTimeValue frameDurationNanoseconds);
+
+protected:
+	bool			queryFrameInterface(REFIID iid, LPVOID *ppv) override;
+
+private:
+	BMDTimeValue	m_streamTime;
+	BMDTimeValue	m_streamDuration;
+	BMDTimeScale	m_streamTimeScale;
+	BMDTimeValue	m_hardwareTime;
+	BMDTimeValue	m_hardwareDuration;
+};
+
+class VirtualAudioInputPacket : public IDeckLinkAudioInputPacket
+{
+public:
+	VirtualAudioInputPacket(long sampleFrameCount, uint32_t bytesPerSampleFrame, BMDTimeValue packetTime, BMDTimeScale packetTimeScale);
+	virtual ~VirtualAudioInputPacket() = default;
+
+	// IUnknown interface
+	HRESULT			STDMETHODCALLTYPE QueryInterface(REFIID iid, LPVOID *ppv) override;
+	ULONG			STDMETHODCALLTYPE AddRef() override;
+	ULONG			STDMETHODCALLTYPE Release() override;
+
+	// IDeckLinkAudioInputPacket interface
+	long			STDMETHODCALLTYPE GetSampleFrameCount(void) override	{ return m_sampleFrameCount; }
+	HRESULT			STDMETHODCALLTYPE GetBytes(void** buffer) override;
+	HRESULT			STDMETHODCALLTYPE GetPacketTime(BMDTimeValue* packetTime, BMDTimeScale timeScale) override;
+
+	uint8_t*		data(void)		{ return m_buffer.data(); }
+	size_t			size(void)		{ return m_buffer.size(); }
+
+private:
+	std::atomic<ULONG>		m_refCount;
+	long					m_sampleFrameCount;
+	BMDTimeValue			m_packetTime;
+	BMDTimeScale			m_packetTimeScale;
+	std::vector<uint8_t>	m_buffer;
+};
+
+/// VirtualVideoFrameBase
+
+template<typename T>
+VirtualVideoFrameBase<T>::VirtualVideoFrameBase(long width, long height, long rowBytes, BMDPixelFormat pixelFormat, BMDFrameFlags flags, com_ptr<IDeckLinkMemoryAllocator> allocator) :
+	m_refCount(1),
+	m_width(width),
+	m_height(height),
+	m_rowBytes(rowBytes),
+	m_pixelFormat(pixelFormat),
+	m_flags(flags),
+	m_buffer(nullptr),
+	m_allocator(allocator),
+	m_ancillaryPackets(make_com_ptr<VirtualAncillaryPackets>())
+{
+	if (m_allocator->AllocateBuffer((uint32_t)(rowBytes * height), &m_buffer) != S_OK)
+		m_buffer = nullptr;
+}
+
+template<typename T>
+VirtualVideoFrameBase<T>::~VirtualVideoFrameBase()
+{
+	if (m_buffer)
+		m_allocator->ReleaseBuffer(m_buffer);
+}
+
+template<typename T>
+HRESULT VirtualVideoFrameBase<T>::QueryInterface(REFIID iid, LPVOID *ppv)
+{
+	if (!ppv)
+		return E_INVALIDARG;
+
+	if (iid == IID_IUnknown || iid == IID_IDeckLinkVideoFrame)
+	{
+		*ppv = static_cast<IDeckLinkVideoFrame*>(this);
+		AddRef();
+		return S_OK;
+	}
+
+	if (iid == IID_IDeckLinkVideoFrameAncillaryPackets)
+	{
+		*ppv = static_cast<IDeckLinkVideoFrameAncillaryPackets*>(m_ancillaryPackets.get());
+		m_ancillaryPackets->AddRef();
+		return S_OK;
+	}
+
+	if (queryFrameInterface(iid, ppv))
+	{
+		AddRef();
+		return S_OK;
+	}
+
+	*ppv = nullptr;
+	return E_NOINTERFACE;
+}
+
+template<typename T>
+ULONG VirtualVideoFrameBase<T>::AddRef(void)
+{
+	return ++m_refCount;
+}
+
+template<typename T>
+ULONG VirtualVideoFrameBase<T>::Release(void)
+{
+	ULONG newRefValue = --m_refCount;
+	if (newRefValue == 0)
+		delete this;
+
+	return newRefValue;
+}
+
+template<typename T>
+HRESULT VirtualVideoFrameBase<T>::GetBytes(void** buffer)
+{
+	if (!buffer)
+		return E_INVALIDARG;
+
+	*buffer = m_buffer;
+	return m_buffer ? S_OK : E_FAIL;
+}
+
+template<typename T>
+HRESULT VirtualVideoFrameBase<T>::GetTimecode(BMDTimecodeFormat format, IDeckLinkTimecode** timecode)
+{
+	if (!timecode)
+		return E_INVALIDARG;
+
+	for (auto& entry : m_timecodes)
+	{
+		bool matches = (entry.format == format);
+
+		if (format == bmdTimecodeRP188Any)
+			matches = (entry.format == bmdTimecodeRP188VITC1) || (entry.format == bmdTimecodeRP188VITC2) ||
+						(entry.format == bmdTimecodeRP188LTC) || (entry.format == bmdTimecodeRP188HighFrameRate);
+
+		if (matches)
+		{
+			*timecode = entry.timecode.get();
+			(*timecode)->AddRef();
+			return S_OK;
+		}
+	}
+
+	*timecode = nullptr;
+	return S_FALSE;
+}
+
+template<typename T>
+HRESULT VirtualVideoFrameBase<T>::GetAncillaryData(IDeckLinkVideoFrameAncillary** ancillary)
+{
+	// Only the packet based ancillary interface is provided
+	return E_NOTIMPL;
+}
+
+template<typename T>
+void VirtualVideoFrameBase<T>::setTimecode(BMDTimecodeFormat format, com_ptr<IDeckLinkTimecode> timecode)
+{
+	for (auto& entry : m_timecodes)
+	{
+		if (entry.format == format)
+		{
+			entry.timecode = timecode;
+			return;
+		}
+	}
+
+	m_timecodes.push_back({ format, timecode });
+}
+
+template<typename T>
+void VirtualVideoFrameBase<T>::copyTimecodesFrom(IDeckLinkVideoFrame* frame)
+{
+	static const BMDTimecodeFormat kTimecodeFormats[] =
+	{
+		bmdTimecodeRP188VITC1, bmdTimecodeRP188VITC2, bmdTimecodeRP188LTC, bmdTimecodeRP188HighFrameRate,
+		bmdTimecodeVITC, bmdTimecodeVITCField2, bmdTimecodeSerial
+	};
+
+	com_ptr<IDeckLinkTimecode> timecode;
+
+	for (BMDTimecodeFormat format : kTimecodeFormats)
+	{
+		if (frame->GetTimecode(format, timecode.releaseAndGetAddressOf()) == S_OK && timecode)
+			setTimecode(format, timecode);
+	}
+}
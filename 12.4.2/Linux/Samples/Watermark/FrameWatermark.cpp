@@ -0,0 +1,574 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#include <algorithm>
+#include <cstring>
+#if defined(__aarch64__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+#include "FrameWatermark.h"
+#include "FrameWatermarkKernels.h"
+#include "PixelFormatTraits.h"
+
+namespace
+{
+	// Fields are drawn most significant bit first: magic, frame counter, send time, payload CRC and a
+	// check of the preceding fields
+	const uint16_t	kWatermarkMagic				= 0xDB5A;
+	const size_t	kWatermarkBytes				= 20;
+	const size_t	kWatermarkCheckedBytes		= kWatermarkBytes - 2;
+	const long		kWatermarkBits				= kWatermarkBytes * 8;
+
+	// A counter further behind the previous one than this is taken to be the output restarting its count
+	const int32_t	kMaxReorderDistance			= 64;
+
+	// CRC-32C (Castagnoli), reflected polynomial
+	const uint32_t	kCRC32CPolynomial			= 0x82F63B78;
+
+	struct CRC32CTables
+	{
+		uint32_t	table[8][256];
+
+		CRC32CTables()
+		{
+			for (uint32_t i = 0; i < 256; i++)
+			{
+				uint32_t crc = i;
+				for (int bit = 0; bit < 8; bit++)
+					crc = (crc >> 1) ^ ((crc & 1) ? kCRC32CPolynomial : 0);
+				table[0][i] = crc;
+			}
+
+			for (uint32_t i = 0; i < 256; i++)
+			{
+				for (int slice = 1; slice < 8; slice++)
+					table[slice][i] = (table[slice - 1][i] >> 8) ^ table[0][table[slice - 1][i] & 0xFF];
+			}
+		}
+	};
+
+	const CRC32CTables& GetCRC32CTables(void)
+	{
+		static const CRC32CTables tables;
+		return tables;
+	}
+
+	// Slicing-by-8, for CPUs without a CRC instruction
+	uint32_t ScalarCRC32C(uint32_t crc, const uint8_t* data, size_t length)
+	{
+		const CRC32CTables&	tables = GetCRC32CTables();
+		size_t				i = 0;
+
+		crc = ~crc;
+
+		for (; i + 8 <= length; i += 8)
+		{
+			uint32_t low	= crc ^ ((uint32_t)data[i] | ((uint32_t)data[i + 1] << 8) | ((uint32_t)data[i + 2] << 16) | ((uint32_t)data[i + 3] << 24));
+			uint32_t high	= (uint32_t)data[i + 4] | ((uint32_t)data[i + 5] << 8) | ((uint32_t)data[i + 6] << 16) | ((uint32_t)data[i + 7] << 24);
+
+			crc =	tables.table[7][low & 0xFF] ^ tables.table[6][(low >> 8) & 0xFF] ^
+					tables.table[5][(low >> 16) & 0xFF] ^ tables.table[4][low >> 24] ^
+					tables.table[3][high & 0xFF] ^ tables.table[2][(high >> 8) & 0xFF] ^
+					tables.table[1][(high >> 16) & 0xFF] ^ tables.table[0][high >> 24];
+		}
+
+		for (; i < length; i++)
+			crc = (crc >> 8) ^ tables.table[0][(crc ^ data[i]) & 0xFF];
+
+		return ~crc;
+	}
+
+	void ScalarCRC32CRows(const uint8_t* rows, size_t rowBytes, size_t length, uint32_t count, uint32_t* crcs)
+	{
+		for (uint32_t row = 0; row < count; row++)
+			crcs[row] = ScalarCRC32C(0, rows + row * rowBytes, length);
+	}
+
+	const WatermarkCRCKernels* GetWatermarkCRCKernels(void)
+	{
+		static const WatermarkCRCKernels	scalarKernels = { "Scalar", ScalarCRC32C, ScalarCRC32CRows };
+		static const WatermarkCRCKernels*	bestKernels = []()
+		{
+#if defined(__x86_64__) || defined(__i386__)
+			if (__builtin_cpu_supports("sse4.2"))
+				return GetWatermarkCRCKernelsSSE42();
+#elif defined(__aarch64__)
+			if (getauxval(AT_HWCAP) & HWCAP_CRC32)
+				return GetWatermarkCRCKernelsARMv8();
+#endif
+			return &scalarKernels;
+		}();
+
+		return bestKernels;
+	}
+
+	inline uint32_t ReadLE32(const uint8_t* p)
+	{
+		return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+	}
+
+	inline uint32_t ReadBE32(const uint8_t* p)
+	{
+		return ((uint32_t)p[0] << 24) | ((uint32_t)p[1] << 16) | ((uint32_t)p[2] << 8) | (uint32_t)p[3];
+	}
+
+	inline void WriteLE32(uint8_t* p, uint32_t value)
+	{
+		p[0] = (uint8_t)value;
+		p[1] = (uint8_t)(value >> 8);
+		p[2] = (uint8_t)(value >> 16);
+		p[3] = (uint8_t)(value >> 24);
+	}
+
+	inline void WriteBE32(uint8_t* p, uint32_t value)
+	{
+		p[0] = (uint8_t)(value >> 24);
+		p[1] = (uint8_t)(value >> 16);
+		p[2] = (uint8_t)(value >> 8);
+		p[3] = (uint8_t)value;
+	}
+
+	// Pack a row of black (0) and white (1) pixels in legal levels
+	void PackWatermarkRow(BMDPixelFormat pixelFormat, const std::vector<uint8_t>& levels, uint8_t* row)
+	{
+		long	width = (long)levels.size();
+		auto	level = [&](long x) -> bool { return x < width && levels[x]; };
+
+		switch (pixelFormat)
+		{
+			case bmdFormat8BitYUV:
+				for (long x = 0; x < width; x += 2, row += 4)
+				{
+					row[0] = 0x80;
+					row[1] = level(x) ? 235 : 16;
+					row[2] = 0x80;
+					row[3] = level(x + 1) ? 235 : 16;
+				}
+				break;
+
+			case bmdFormat10BitYUV:
+				for (long x = 0; x < width; x += 6, row += 16)
+				{
+					uint32_t y[6];
+					for (long i = 0; i < 6; i++)
+						y[i] = level(x + i) ? 940 : 64;
+
+					WriteLE32(row,		512 | (y[0] << 10) | (512 << 20));
+					WriteLE32(row + 4,	y[1] | (512 << 10) | (y[2] << 20));
+					WriteLE32(row + 8,	512 | (y[3] << 10) | (512 << 20));
+					WriteLE32(row + 12,	y[4] | (512 << 10) | (y[5] << 20));
+				}
+				break;
+
+			case bmdFormat10BitRGB:
+				for (long x = 0; x < width; x++, row += 4)
+				{
+					uint32_t value = level(x) ? 940 : 64;
+					WriteBE32(row, (value << 20) | (value << 10) | value);
+				}
+				break;
+
+			case bmdFormat12BitRGB:
+			case bmdFormat12BitRGBLE:
+				// Little-endian bit stream of R, G, B components, 8 pixels in 9 words
+				for (long x = 0; x < width; x += 8)
+				{
+					uint64_t	accumulator = 0;
+					int			bits = 0;
+
+					for (long i = 0; i < 24; i++)
+					{
+						accumulator |= (uint64_t)(level(x + i / 3) ? 0xFFF : 0) << bits;
+						bits += 12;
+						if (bits >= 32)
+						{
+							if (pixelFormat == bmdFormat12BitRGB)
+								WriteBE32(row, (uint32_t)accumulator);
+							else
+								WriteLE32(row, (uint32_t)accumulator);
+							row += 4;
+							accumulator >>= 32;
+							bits -= 32;
+						}
+					}
+				}
+				break;
+
+			case bmdFormat8BitARGB:
+			case bmdFormat8BitBGRA:
+				for (long x = 0; x < width; x++, row += 4)
+				{
+					uint8_t value = level(x) ? 255 : 0;
+					row[0] = (pixelFormat == bmdFormat8BitARGB) ? 255 : value;
+					row[1] = value;
+					row[2] = value;
+					row[3] = (pixelFormat == bmdFormat8BitARGB) ? value : 255;
+				}
+				break;
+
+			default:
+				break;
+		}
+	}
+
+	// Luma, or green for RGB formats, of a pixel compared against mid grey
+	bool ReadWatermarkPixel(BMDPixelFormat pixelFormat, const uint8_t* row, long x)
+	{
+		switch (pixelFormat)
+		{
+			case bmdFormat8BitYUV:
+				return row[x * 2 + 1] >= 0x80;
+
+			case bmdFormat10BitYUV:
+			{
+				// Word and shift of each of the 6 luma samples in a group
+				static const uint8_t kWord[6]	= { 0, 1, 1, 2, 3, 3 };
+				static const uint8_t kShift[6]	= { 10, 0, 20, 10, 0, 20 };
+				long i = x % 6;
+				return ((ReadLE32(row + (x / 6) * 16 + kWord[i] * 4) >> kShift[i]) & 0x3FF) >= 0x200;
+			}
+
+			case bmdFormat10BitRGB:
+				return ((ReadBE32(row + x * 4) >> 10) & 0x3FF) >= 0x200;
+
+			case bmdFormat12BitRGB:
+			case bmdFormat12BitRGBLE:
+			{
+				const uint8_t*	group = row + (x / 8) * 36;
+				int				bitOffset = ((int)(x % 8) * 3 + 1) * 12;
+				int				word = bitOffset / 32;
+				int				shift = bitOffset % 32;
+				uint64_t		value;
+
+				if (pixelFormat == bmdFormat12BitRGB)
+					value = ReadBE32(group + word * 4) | ((shift > 20) ? (uint64_t)ReadBE32(group + word * 4 + 4) << 32 : 0);
+				else
+					value = ReadLE32(group + word * 4) | ((shift > 20) ? (uint64_t)ReadLE32(group + word * 4 + 4) << 32 : 0);
+
+				return ((value >> shift) & 0xFFF) >= 0x800;
+			}
+
+			case bmdFormat8BitARGB:
+				return row[x * 4 + 2] >= 0x80;
+
+			case bmdFormat8BitBGRA:
+				return row[x * 4 + 1] >= 0x80;
+
+			default:
+				return false;
+		}
+	}
+
+	void SerializeWatermark(const FrameWatermark& watermark, uint8_t* bytes)
+	{
+		uint64_t sendTime = (uint64_t)watermark.sendTime;
+
+		bytes[0] = (uint8_t)(kWatermarkMagic >> 8);
+		bytes[1] = (uint8_t)kWatermarkMagic;
+		WriteBE32(bytes + 2, watermark.frameCounter);
+		WriteBE32(bytes + 6, (uint32_t)(sendTime >> 32));
+		WriteBE32(bytes + 10, (uint32_t)sendTime);
+		WriteBE32(bytes + 14, watermark.payloadCRC);
+
+		uint32_t check = GetWatermarkCRCKernels()->crc32c(0, bytes, kWatermarkCheckedBytes);
+		bytes[18] = (uint8_t)(check >> 8);
+		bytes[19] = (uint8_t)check;
+	}
+
+	// Cells must be at least two pixels wide so that no cell shares all its 4:2:2 chroma with another
+	long WatermarkCellWidth(long width)
+	{
+		long cellWidth = width / kWatermarkBits;
+		return (cellWidth >= 2) ? cellWidth : 0;
+	}
+
+	bool GetFrameLayout(IDeckLinkVideoFrame* frame, uint8_t** bytes, long* cellWidth)
+	{
+		if (!IsWatermarkPixelFormat(frame->GetPixelFormat()) || frame->GetHeight() < kWatermarkRows)
+			return false;
+
+		if (frame->GetRowBytes() < GetPixelFormatActiveRowBytes(frame->GetPixelFormat(), frame->GetWidth()))
+			return false;
+
+		*cellWidth = WatermarkCellWidth(frame->GetWidth());
+		if (*cellWidth == 0)
+			return false;
+
+		return frame->GetBytes((void**)bytes) == S_OK;
+	}
+}
+
+bool IsWatermarkPixelFormat(BMDPixelFormat pixelFormat)
+{
+	switch (pixelFormat)
+	{
+		case bmdFormat8BitYUV:
+		case bmdFormat10BitYUV:
+		case bmdFormat10BitRGB:
+		case bmdFormat12BitRGB:
+		case bmdFormat12BitRGBLE:
+		case bmdFormat8BitARGB:
+		case bmdFormat8BitBGRA:
+			return true;
+
+		default:
+			return false;
+	}
+}
+
+uint32_t WatermarkPayloadCRC(IDeckLinkVideoFrame* frame)
+{
+	const WatermarkCRCKernels*	kernels = GetWatermarkCRCKernels();
+	uint8_t*					bytes;
+	long						height = frame->GetHeight();
+	long						rowBytes = frame->GetRowBytes();
+	size_t						activeRowBytes = std::min<size_t>(GetPixelFormatActiveRowBytes(frame->GetPixelFormat(), frame->GetWidth()), rowBytes);
+
+	if (height <= kWatermarkRows || activeRowBytes == 0 || frame->GetBytes((void**)&bytes) != S_OK)
+		return 0;
+
+	std::vector<uint32_t> rowCRCs(height - kWatermarkRows);
+	kernels->crc32cRows(bytes + kWatermarkRows * rowBytes, rowBytes, activeRowBytes, (uint32_t)rowCRCs.size(), rowCRCs.data());
+
+	return kernels->crc32c(0, (const uint8_t*)rowCRCs.data(), rowCRCs.size() * sizeof(uint32_t));
+}
+
+bool StampWatermark(IDeckLinkVideoFrame* frame, const FrameWatermark& watermark)
+{
+	uint8_t*				bytes;
+	long					cellWidth;
+	uint8_t					serialized[kWatermarkBytes];
+
+	if (!GetFrameLayout(frame, &bytes, &cellWidth))
+		return false;
+
+	SerializeWatermark(watermark, serialized);
+
+	// Pixels right of the last cell are black
+	std::vector<uint8_t> levels(frame->GetWidth(), 0);
+	for (long bit = 0; bit < kWatermarkBits; bit++)
+	{
+		if (serialized[bit / 8] & (0x80 >> (bit % 8)))
+			std::fill(levels.begin() + bit * cellWidth, levels.begin() + (bit + 1) * cellWidth, 1);
+	}
+
+	// Every watermark row is the same
+	long rowBytes = frame->GetRowBytes();
+	PackWatermarkRow(frame->GetPixelFormat(), levels, bytes);
+	for (long y = 1; y < kWatermarkRows; y++)
+		memcpy(bytes + y * rowBytes, bytes, GetPixelFormatActiveRowBytes(frame->GetPixelFormat(), frame->GetWidth()));
+
+	return true;
+}
+
+bool ReadWatermark(IDeckLinkVideoFrame* frame, FrameWatermark* watermark)
+{
+	uint8_t*				bytes;
+	long					cellWidth;
+	uint8_t					serialized[kWatermarkBytes] = {};
+
+	if (!GetFrameLayout(frame, &bytes, &cellWidth))
+		return false;
+
+	// Sample the middle of each cell, away from its edges
+	const uint8_t* row = bytes + (kWatermarkRows / 2) * frame->GetRowBytes();
+	for (long bit = 0; bit < kWatermarkBits; bit++)
+	{
+		if (ReadWatermarkPixel(frame->GetPixelFormat(), row, bit * cellWidth + cellWidth / 2))
+			serialized[bit / 8] |= 0x80 >> (bit % 8);
+	}
+
+	uint32_t check = GetWatermarkCRCKernels()->crc32c(0, serialized, kWatermarkCheckedBytes);
+	if (serialized[0] != (uint8_t)(kWatermarkMagic >> 8) || serialized[1] != (uint8_t)kWatermarkMagic ||
+		serialized[18] != (uint8_t)(check >> 8) || serialized[19] != (uint8_t)check)
+		return false;
+
+	watermark->frameCounter	= ReadBE32(serialized + 2);
+	watermark->sendTime		= (BMDTimeValue)(((uint64_t)ReadBE32(serialized + 6) << 32) | ReadBE32(serialized + 10));
+	watermark->payloadCRC	= ReadBE32(serialized + 14);
+	return true;
+}
+
+const char* GetWatermarkCRCKernelName(void)
+{
+	return GetWatermarkCRCKernels()->name;
+}
+
+WatermarkChecker::WatermarkChecker(unsigned threadCount, unsigned maxPendingFrames) :
+	m_maxPendingFrames(std::max(maxPendingFrames, 1u)),
+	m_busyWorkers(0),
+	m_stopping(false),
+	m_statistics(),
+	m_haveLastCounter(false),
+	m_lastCounter(0)
+{
+	if (threadCount == 0)
+		threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+
+	for (unsigned i = 0; i < threadCount; i++)
+		m_workers.emplace_back(&WatermarkChecker::workerThread, this);
+}
+
+WatermarkChecker::~WatermarkChecker()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_stopping = true;
+	}
+	m_pendingCondition.notify_all();
+
+	// Workers check the frames still queued before they stop, releasing them
+	for (std::thread& worker : m_workers)
+		worker.join();
+}
+
+void WatermarkChecker::checkFrame(IDeckLinkVideoFrame* frame, BMDTimeValue arrivalTime)
+{
+	FrameWatermark	watermark;
+	bool			marked = ReadWatermark(frame, &watermark);
+
+	std::lock_guard<std::mutex> lock(m_mutex);
+
+	if (!marked)
+	{
+		m_statistics.framesUnmarked++;
+		return;
+	}
+
+	m_statistics.framesChecked++;
+
+	if (m_haveLastCounter)
+	{
+		int32_t delta = (int32_t)(watermark.frameCounter - m_lastCounter);
+
+		if (delta == 0)
+		{
+			m_statistics.framesRepeated++;
+		}
+		else if (delta < 0 && delta > -kMaxReorderDistance)
+		{
+			// The frame was counted as dropped when the counter skipped past it
+			m_statistics.framesReordered++;
+			if (m_statistics.framesDropped > 0)
+				m_statistics.framesDropped--;
+		}
+		else
+		{
+			if (delta > 0)
+				m_statistics.framesDropped += delta - 1;
+			m_lastCounter = watermark.frameCounter;
+		}
+	}
+	else
+	{
+		m_haveLastCounter = true;
+		m_lastCounter = watermark.frameCounter;
+	}
+
+	if (watermark.sendTime != kWatermarkNoTime && arrivalTime != kWatermarkNoTime)
+	{
+		BMDTimeValue latency = arrivalTime - watermark.sendTime;
+
+		if (m_statistics.latencySampleCount == 0 || latency < m_statistics.latencyMin)
+			m_statistics.latencyMin = latency;
+		if (m_statistics.latencySampleCount == 0 || latency > m_statistics.latencyMax)
+			m_statistics.latencyMax = latency;
+		m_statistics.latencyTotal += latency;
+		m_statistics.latencySampleCount++;
+	}
+
+	if (m_pendingFrames.size() >= m_maxPendingFrames)
+	{
+		m_statistics.framesUnverified++;
+		return;
+	}
+
+	frame->AddRef();
+	m_pendingFrames.push_back({ frame, watermark.payloadCRC });
+	m_pendingCondition.notify_one();
+}
+
+void WatermarkChecker::flush(void)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_idleCondition.wait(lock, [this]() { return m_pendingFrames.empty() && m_busyWorkers == 0; });
+}
+
+WatermarkStatistics WatermarkChecker::getStatistics(void)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_statistics;
+}
+
+void WatermarkChecker::reset(void)
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_statistics = WatermarkStatistics();
+	m_haveLastCounter = false;
+}
+
+void WatermarkChecker::workerThread(void)
+{
+	std::unique_lock<std::mutex> lock(m_mutex);
+
+	while (true)
+	{
+		m_pendingCondition.wait(lock, [this]() { return m_stopping || !m_pendingFrames.empty(); });
+
+		if (m_pendingFrames.empty())
+			return;
+
+		PendingFrame pending = m_pendingFrames.front();
+		m_pendingFrames.pop_front();
+		m_busyWorkers++;
+
+		lock.unlock();
+		bool corrupted = (WatermarkPayloadCRC(pending.frame) != pending.payloadCRC);
+		pending.frame->Release();
+		lock.lock();
+
+		if (corrupted)
+			m_statistics.framesCorrupted++;
+
+		if (--m_busyWorkers == 0 && m_pendingFrames.empty())
+			m_idleCondition.notify_all();
+	}
+}
@@ -0,0 +1,147 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+#pragma once
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "DeckLinkAPI.h"
+
+// Watermark stamped into each output frame, so that a capture of the output can prove that every frame
+// arrived intact and in order.  It carries a frame counter, a CRC of the frame below the watermark and
+// the time the frame was due on the output.
+//
+// The watermark is drawn as black and white cells across the top kWatermarkRows rows of the frame, in
+// legal video levels, so that it survives SDI and any 4:2:2 or 4:4:4 pixel format the samples use.  The
+// cells are read back from the middle row, and a check field rejects frames without a watermark.
+//
+// Times are on the DeckLink hardware reference clock, shared by the inputs and outputs of the system,
+// so a capture measures the latency from the start of the frame on the output to the start of the
+// frame on the input.
+
+const long			kWatermarkRows			= 4;
+const BMDTimeScale	kWatermarkTimeScale		= 1000000;
+const BMDTimeValue	kWatermarkNoTime		= 0;
+
+struct FrameWatermark
+{
+	uint32_t		frameCounter;
+	uint32_t		payloadCRC;			// WatermarkPayloadCRC of the frame
+	BMDTimeValue	sendTime;			// Start of the frame on the output, or kWatermarkNoTime when unknown
+};
+
+// Pixel formats that can carry a watermark
+bool			IsWatermarkPixelFormat(BMDPixelFormat pixelFormat);
+
+// CRC-32C of each row below the watermark, up to the last pixel so that padding is ignored, followed by
+// CRC-32C of the row CRCs.  Rows are independent, so the hardware CRC kernels checksum several at once.
+uint32_t		WatermarkPayloadCRC(IDeckLinkVideoFrame* frame);
+
+// Write or read the watermark rows of a frame.  Both return false if the pixel format is not supported,
+// and ReadWatermark also returns false when the frame has no valid watermark.
+bool			StampWatermark(IDeckLinkVideoFrame* frame, const FrameWatermark& watermark);
+bool			ReadWatermark(IDeckLinkVideoFrame* frame, FrameWatermark* watermark);
+
+// Name of the CRC kernels chosen for the CPU
+const char*		GetWatermarkCRCKernelName(void);
+
+struct WatermarkStatistics
+{
+	uint64_t		framesChecked;		// Frames with a watermark
+	uint64_t		framesUnmarked;		// Frames without a valid watermark
+	uint64_t		framesDropped;		// Frames missing from the counter sequence
+	uint64_t		framesRepeated;		// Frames with the same counter as the previous frame
+	uint64_t		framesReordered;	// Frames with a counter behind the previous frame
+	uint64_t		framesCorrupted;	// Frames whose payload CRC does not match the watermark
+	uint64_t		framesUnverified;	// Frames not CRC checked because checking fell behind capture
+	// Glass-to-glass latency in kWatermarkTimeScale units, of frames with a send time
+	uint64_t		latencySampleCount;
+	BMDTimeValue	latencyMin;
+	BMDTimeValue	latencyMax;
+	BMDTimeValue	latencyTotal;
+};
+
+// Checks the watermark of captured frames.  The counter sequence and latency are checked on the calling
+// thread, which only reads the watermark rows.  Payload CRCs are checked by a pool of threads, each taking
+// a whole frame, so that checking keeps up with capture at 8K; the frames are referenced until checked.
+class WatermarkChecker
+{
+public:
+	// A threadCount of 0 uses one thread per CPU.  Frames arriving while maxPendingFrames are waiting to
+	// be checked are counted as unverified rather than holding more capture buffers.
+	explicit WatermarkChecker(unsigned threadCount = 0, unsigned maxPendingFrames = 8);
+	virtual ~WatermarkChecker();
+
+	// arrivalTime is the hardware reference time of the start of the frame on the input, in
+	// kWatermarkTimeScale units, or kWatermarkNoTime when unknown
+	void					checkFrame(IDeckLinkVideoFrame* frame, BMDTimeValue arrivalTime);
+
+	// Wait until every queued frame has been CRC checked
+	void					flush(void);
+
+	WatermarkStatistics		getStatistics(void);
+	void					reset(void);
+
+private:
+	struct PendingFrame
+	{
+		IDeckLinkVideoFrame*	frame;
+		uint32_t				payloadCRC;
+	};
+
+	void					workerThread(void);
+
+	std::mutex							m_mutex;
+	std::condition_variable				m_pendingCondition;
+	std::condition_variable				m_idleCondition;
+	std::vector<std::thread>			m_workers;
+	std::deque<PendingFrame>			m_pendingFrames;
+	unsigned							m_maxPendingFrames;
+	unsigned							m_busyWorkers;
+	bool								m_stopping;
+	//
+	WatermarkStatistics					m_statistics;
+	bool								m_haveLastCounter;
+	uint32_t							m_lastCounter;
+};
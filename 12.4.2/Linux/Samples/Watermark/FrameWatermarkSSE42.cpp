@@ -0,0 +1,113 @@
+/* -LICENSE-START-
+** Copyright (c) 2022 Blackmagic Design
+**  
+** Permission is hereby granted, free of charge, to any person or organization 
+** obtaining a copy of the software and accompanying documentation (the 
+** "Software") to use, reproduce, display, distribute, sub-license, execute, 
+** and transmit the Software, and to prepare derivative works of the Software, 
+** and to permit third-parties to whom the Software is furnished to do so, in 
+** accordance with:
+** 
+** (1) if the Software is obtained from Blackmagic Design, the End User License 
+** Agreement for the Software Development Kit (“EULA”) available at 
+** https://www.blackmagicdesign.com/EULA/DeckLinkSDK; or
+** 
+** (2) if the Software is obtained from any third party, such licensing terms 
+** as notified by that third party,
+** 
+** and all subject to the following:
+** 
+** (3) the copyright notices in the Software and this entire statement, 
+** including the above license grant, this restriction and the following 
+** disclaimer, must be included in all copies of the Software, in whole or in 
+** part, and all derivative works of the Software, unless such copies or 
+** derivative works are solely in the form of machine-executable object code 
+** generated by a source language processor.
+** 
+** (4) THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS 
+** OR IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY, 
+** FITNESS FOR A PARTICULAR PURPOSE, TITLE AND NON-INFRINGEMENT. IN NO EVENT 
+** SHALL THE COPYRIGHT HOLDERS OR ANYONE DISTRIBUTING THE SOFTWARE BE LIABLE 
+** FOR ANY DAMAGES OR OTHER LIABILITY, WHETHER IN CONTRACT, TORT OR OTHERWISE, 
+** ARISING FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER 
+** DEALINGS IN THE SOFTWARE.
+** 
+** A copy of the Software is available free of charge at 
+** https://www.blackmagicdesign.com/desktopvideo_sdk under the EULA.
+** 
+** -LICENSE-END-
+*/
+
+// Built with -msse4.2
+#include <cstring>
+#include <nmmintrin.h>
+#include "FrameWatermarkKernels.h"
+
+namespace
+{
+	inline uint64_t Load64(const uint8_t* p)
+	{
+		uint64_t value;
+		memcpy(&value, p, sizeof(value));
+		return value;
+	}
+
+	uint32_t CRC32C(uint32_t crc, const uint8_t* data, size_t length)
+	{
+		uint64_t	value = ~crc;
+		size_t		i = 0;
+
+		for (; i + 8 <= length; i += 8)
+			value = _mm_crc32_u64(value, Load64(data + i));
+
+		for (; i < length; i++)
+			value = _mm_crc32_u8((uint32_t)value, data[i]);
+
+		return ~(uint32_t)value;
+	}
+
+	// The CRC instruction has a latency of three cycles and a throughput of one, so three rows are
+	// checksummed together to keep it busy
+	void CRC32CRows(const uint8_t* rows, size_t rowBytes, size_t length, uint32_t count, uint32_t* crcs)
+	{
+		uint32_t row = 0;
+
+		for (; row + 3 <= count; row += 3)
+		{
+			const uint8_t*	p0 = rows + row * rowBytes;
+			const uint8_t*	p1 = p0 + rowBytes;
+			const uint8_t*	p2 = p1 + rowBytes;
+			uint64_t		crc0 = 0xFFFFFFFF;
+			uint64_t		crc1 = 0xFFFFFFFF;
+			uint64_t		crc2 = 0xFFFFFFFF;
+			size_t			i = 0;
+
+			for (; i + 8 <= length; i += 8)
+			{
+				crc0 = _mm_crc32_u64(crc0, Load64(p0 + i));
+				crc1 = _mm_crc32_u64(crc1, Load64(p1 + i));
+				crc2 = _mm_crc32_u64(crc2, Load64(p2 + i));
+			}
+
+			for (; i < length; i++)
+			{
+				crc0 = _mm_crc32_u8((uint32_t)crc0, p0[i]);
+				crc1 = _mm_crc32_u8((uint32_t)crc1, p1[i]);
+				crc2 = _mm_crc32_u8((uint32_t)crc2, p2[i]);
+			}
+
+			crcs[row]		= ~(uint32_t)crc0;
+			crcs[row + 1]	= ~(uint32_t)crc1;
+			crcs[row + 2]	= ~(uint32_t)crc2;
+		}
+
+		for (; row < count; row++)
+			crcs[row] = CRC32C(0, rows + row * rowBytes, length);
+	}
+}
+
+const WatermarkCRCKernels* GetWatermarkCRCKernelsSSE42(void)
+{
+	static const WatermarkCRCKernels kernels = { "SSE4.2", CRC32C, CRC32CRows };
+	return &kernels;
+}
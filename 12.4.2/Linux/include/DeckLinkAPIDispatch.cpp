@@ -39,12 +39,14 @@
 **/
 
 #include <stdio.h>
+#include <stdlib.h>
 #include <pthread.h>
 #include <dlfcn.h>
 
 #include "DeckLinkAPI.h"
 
 #define kDeckLinkAPI_Name "libDeckLinkAPI.so"
+#define kDeckLinkAPI_PathVariable "DECKLINK_API_LIBRARY"
 #define KDeckLinkPreviewAPI_Name "libDeckLinkPreviewAPI.so"
 
 typedef IDeckLinkIterator* (*CreateIteratorFunc)(void);
@@ -71,8 +73,14 @@ static CreateVideoFrameAncillaryPacketsInstanceFunc	gCreateVideoFrameAncillaryPa
 static void	InitDeckLinkAPI (void)
 {
 	void *libraryHandle;
+	const char *libraryName;
 	
-	libraryHandle = dlopen(kDeckLinkAPI_Name, RTLD_NOW|RTLD_GLOBAL);
+	// Allow an alternative driver library, such as the VirtualDeckLink sample, to be loaded in place of the installed one
+	libraryName = getenv(kDeckLinkAPI_PathVariable);
+	if (!libraryName || !*libraryName)
+		libraryName = kDeckLinkAPI_Name;
+	
+	libraryHandle = dlopen(libraryName, RTLD_NOW|RTLD_GLOBAL);
 	if (!libraryHandle)
 	{
 		fprintf(stderr, "%s\n", dlerror());